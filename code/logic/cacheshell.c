@@ -23,6 +23,7 @@
  * -----------------------------------------------------------------------------
  */
 #include "fossil/crabdb/cacheshell.h"
+#include "fossil/crabdb/hash.h"
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -71,8 +72,8 @@ typedef CRITICAL_SECTION pthread_mutex_t;
  *       +-----------+      +-----------+      +-----------+
  *
  * Hash Function:
- *   FNV-1a (32 or 64-bit) plus extra avalanche mixing for better
- *   distribution. Final index = hash % bucket_count.
+ *   fossil_bluecrab_hash64 (shared fast hash, see hash.c), truncated to
+ *   size_t. Final index = hash % bucket_count.
  *
  * TTL / Expiration:
  *   - When fetched:
@@ -212,36 +213,9 @@ static char *cacheshell_strdup(const char *s) {
     return copy;
 }
 
-// Enhanced hash: FNV-1a with architecture-aware final mixing (avalanche).
-// Keeps speed while improving distribution over classic djb2.
+// Bucket hash: shared fast hash (in-memory only, never persisted).
 static size_t fossil_cache_hash(const char *key) {
-#if SIZE_MAX > 0xFFFFFFFFu  // 64-bit size_t
-    uint64_t h = 1469598103934665603ull;          // FNV-1a 64-bit offset
-    while (*key) {
-        h ^= (uint8_t)*key++;
-        h *= 1099511628211ull;                   // FNV prime
-    }
-    // Mix (inspired by SplitMix64 / Murmur finalizers)
-    h ^= h >> 32;
-    h *= 0x9e3779b97f4a7c15ull;
-    h ^= h >> 29;
-    h *= 0x94d049bb133111ebull;
-    h ^= h >> 32;
-    return (size_t)h;
-#else // 32-bit size_t
-    uint32_t h = 2166136261u;                    // FNV-1a 32-bit offset
-    while (*key) {
-        h ^= (uint8_t)*key++;
-        h *= 16777619u;                          // FNV prime
-    }
-    // Final avalanche (MurMur / Jenkins style)
-    h ^= h >> 15;
-    h *= 0x85ebca6bu;
-    h ^= h >> 13;
-    h *= 0xc2b2ae35u;
-    h ^= h >> 16;
-    return (size_t)h;
-#endif
+    return (size_t)fossil_bluecrab_hash64(key, strlen(key), 0);
 }
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -26,7 +26,10 @@
 #define FOSSIL_CRABDB_FRAMEWORK_H
 
 #include "cacheshell.h"
+#include "hash.h"
 #include "myshell.h"
 #include "noshell.h"
+#include "query.h"
+#include "scan.h"
 
 #endif /* FOSSIL_CRABDB_FRAMEWORK_H */
@@ -0,0 +1,168 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#ifndef FOSSIL_CRABDB_HASH_H
+#define FOSSIL_CRABDB_HASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ===========================================================
+// Fast Hash (in-memory tables)
+// ===========================================================
+
+/**
+ * @brief Computes the fast 64-bit hash of a byte range.
+ *
+ * Short inputs take a multiply-fold path; inputs longer than 256 bytes are
+ * folded 64 bytes at a time into eight accumulators using SSE2, AVX2 or NEON
+ * when available. Every path produces the same value on every platform.
+ *
+ * The value is not stable across library versions and must never be written
+ * to disk; use fossil_bluecrab_hash64_legacy for persisted hashes.
+ *
+ * @param data          Bytes to hash (may be NULL when len is 0).
+ * @param len           Number of bytes.
+ * @param seed          Seed value (0 for the default).
+ * @return              64-bit hash.
+ */
+uint64_t fossil_bluecrab_hash64(const void *data, size_t len, uint64_t seed);
+
+/**
+ * @brief Hashes a batch of keys with the fast hash.
+ *
+ * @param keys          Array of key pointers.
+ * @param lens          Array of key lengths, or NULL to use strlen on each key.
+ * @param count         Number of keys.
+ * @param seed          Seed value (0 for the default).
+ * @param out           Output array receiving count hashes.
+ */
+void fossil_bluecrab_hash64_batch(const char *const *keys, const size_t *lens, size_t count, uint64_t seed, uint64_t *out);
+
+/**
+ * @brief Portable scalar implementation of fossil_bluecrab_hash64.
+ *
+ * Always returns the same value as fossil_bluecrab_hash64; exposed so the
+ * vector paths can be checked against it.
+ *
+ * @param data          Bytes to hash (may be NULL when len is 0).
+ * @param len           Number of bytes.
+ * @param seed          Seed value (0 for the default).
+ * @return              64-bit hash.
+ */
+uint64_t fossil_bluecrab_hash64_reference(const void *data, size_t len, uint64_t seed);
+
+/**
+ * @brief Returns the name of the accumulate kernel in use ("avx2", "sse2", "neon" or "scalar").
+ */
+const char *fossil_bluecrab_hash_backend(void);
+
+// ===========================================================
+// Legacy Hash (on-disk format)
+// ===========================================================
+
+/**
+ * @brief Computes the MurmurHash64A-style hash used by the on-disk formats.
+ *
+ * Bit-compatible with the record, commit and document hashes written by
+ * MyShell and NoShell; existing files keep verifying.
+ *
+ * @param data          Bytes to hash (may be NULL when len is 0).
+ * @param len           Number of bytes.
+ * @return              64-bit hash.
+ */
+uint64_t fossil_bluecrab_hash64_legacy(const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#include <string>
+#include <vector>
+
+namespace fossil {
+
+    namespace bluecrab {
+
+        /**
+         * @brief Static C++ wrappers around the hashing module.
+         */
+        class Hash {
+        public:
+            /**
+             * @brief Fast in-memory hash of a string.
+             * @param data Input bytes.
+             * @param seed Seed value.
+             * @return 64-bit hash.
+             */
+            static uint64_t fast(const std::string& data, uint64_t seed = 0) {
+                return fossil_bluecrab_hash64(data.data(), data.size(), seed);
+            }
+
+            /**
+             * @brief Fast hash of many strings at once.
+             * @param keys Input strings.
+             * @param seed Seed value.
+             * @return One hash per input, in order.
+             */
+            static std::vector<uint64_t> batch(const std::vector<std::string>& keys, uint64_t seed = 0) {
+                std::vector<const char*> ptrs(keys.size());
+                std::vector<size_t> lens(keys.size());
+                for (size_t i = 0; i < keys.size(); ++i) {
+                    ptrs[i] = keys[i].data();
+                    lens[i] = keys[i].size();
+                }
+                std::vector<uint64_t> out(keys.size());
+                fossil_bluecrab_hash64_batch(ptrs.data(), lens.data(), keys.size(), seed, out.data());
+                return out;
+            }
+
+            /**
+             * @brief On-disk compatible hash of a string.
+             * @param data Input bytes.
+             * @return 64-bit hash.
+             */
+            static uint64_t legacy(const std::string& data) {
+                return fossil_bluecrab_hash64_legacy(data.data(), data.size());
+            }
+
+            /**
+             * @brief Name of the accumulate kernel in use.
+             */
+            static std::string backend() {
+                return fossil_bluecrab_hash_backend();
+            }
+        };
+
+    } // namespace bluecrab
+
+} // namespace fossil
+
+#endif
+
+#endif /* FOSSIL_CRABDB_HASH_H */
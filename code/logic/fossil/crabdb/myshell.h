@@ -169,8 +169,16 @@ typedef struct fossil_bluecrab_myshell_t {
     char    *branch;              /**< Current branch name. */
     uint64_t commit_head;         /**< Current commit head hash. */
     bool     is_open;             /**< Indicates if the DB is currently open. */
-    void    *cache;               /**< Pointer to cache structure (if any). */
-    void    *lock;                /**< Pointer to lock/mutex (if any). */
+    void    *cache;               /**< Hot-key LRU value cache (NULL if disabled). */
+    void    *lock;                /**< Handle lock taken by every call (see o-Async). */
+    void    *stage;               /**< In-memory staging area, flushed on commit. */
+    void    *txn;                 /**< Pending transaction operations (NULL if none active). */
+    void    *commit_index;        /**< Offsets of commit lines, kept across rewrites and in the sidecar (NULL until built). */
+    size_t   validated_size;      /**< Leading bytes known to pass FSON type validation. */
+    size_t   record_count;        /**< Number of lines within validated_size. */
+    void    *durability;          /**< Durability policy state (NULL = flush per operation). */
+    void    *async;               /**< Async submission state (NULL until first submit). */
+    void    *indexes;             /**< Secondary value indexes (NULL if none). */
     int      error_code;          /**< Last error code encountered. */
 
     /* Git-like chain fields for commit/branch management */
@@ -186,7 +194,9 @@ typedef struct fossil_bluecrab_myshell_t {
 /**
  * o-Open/create/close
  * Opens an existing database file, creates a new database file, or closes a database handle.
- * Time Complexity: O(1) for handle allocation, O(n) for file scan (n = file size).
+ * If the `<path>.meta` sidecar written by the last close still matches the file,
+ * only bytes appended after that close are type-checked.
+ * Time Complexity: O(1) for a cleanly closed file, O(a) for a appended bytes, O(n) otherwise.
  * @param path Path to the database file.
  * @param err Output parameter for error code.
  * @return Pointer to fossil_bluecrab_myshell_t database handle, or NULL on failure.
@@ -205,8 +215,9 @@ fossil_bluecrab_myshell_t *fossil_myshell_create(const char *path, fossil_bluecr
 
 /**
  * o-Close
- * Closes the database handle and releases resources.
- * Time Complexity: O(1).
+ * Closes the database handle, writes the `<path>.meta` validation sidecar,
+ * and releases resources.
+ * Time Complexity: O(a) (a = bytes written since open), O(n) after a rewrite.
  * @param db Pointer to fossil_bluecrab_myshell_t database handle.
  */
 void fossil_myshell_close(fossil_bluecrab_myshell_t *db);
@@ -226,7 +237,7 @@ fossil_bluecrab_myshell_error_t fossil_myshell_put(fossil_bluecrab_myshell_t *db
 /**
  * o-Record CRUD (key/value, git-like chain)
  * Retrieves the value for a given key from the database.
- * Time Complexity: O(n) (n = number of records).
+ * Time Complexity: O(n) (n = number of records); O(1) average on a cache hit.
  * @param db Database handle.
  * @param key Key string.
  * @param out_value Output buffer for value.
@@ -245,10 +256,380 @@ fossil_bluecrab_myshell_error_t fossil_myshell_get(fossil_bluecrab_myshell_t *db
  */
 fossil_bluecrab_myshell_error_t fossil_myshell_del(fossil_bluecrab_myshell_t *db, const char *key);
 
+/**
+ * o-Query
+ * Callback type for query results. Columns not named in the SELECT list are NULL.
+ * @param key Record key (or NULL).
+ * @param type FSON type name (or NULL).
+ * @param value Record value (or NULL).
+ * @param user User data pointer.
+ * @return True to continue, false to stop the query.
+ */
+typedef bool (*fossil_myshell_row_cb)(const char *key, const char *type, const char *value, void *user);
+
+/**
+ * o-Query
+ * Runs a SQL-like query over the records, e.g.
+ * "SELECT key, value WHERE type = 'i32' AND value > 100 LIMIT 50".
+ * Supports SELECT of key/value/type (or *), an optional FROM name, WHERE with
+ * = != <> < <= > >= LIKE combined by AND/OR/NOT and parentheses, and LIMIT.
+ * Predicates are evaluated inside the record scan and the scan stops as soon
+ * as LIMIT rows were delivered (or a key equality matched). Staged entries and
+ * pending transaction writes are not visible.
+ * Time Complexity: O(n) (n = number of records), less with LIMIT.
+ * @param db Database handle.
+ * @param sql Query text.
+ * @param cb Row callback.
+ * @param user User data pointer.
+ * @return Error code (FOSSIL_MYSHELL_ERROR_INVALID_QUERY on a syntax error).
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_query(fossil_bluecrab_myshell_t *db, const char *sql, fossil_myshell_row_cb cb, void *user);
+
+/**
+ * o-Aggregates
+ * Aggregate operation for fossil_myshell_aggregate.
+ */
+typedef enum {
+    FOSSIL_MYSHELL_AGG_COUNT = 0,  /**< Number of matching values. */
+    FOSSIL_MYSHELL_AGG_SUM,        /**< Sum (integer sums wrap modulo 2^64). */
+    FOSSIL_MYSHELL_AGG_MIN,        /**< Smallest value. */
+    FOSSIL_MYSHELL_AGG_MAX,        /**< Largest value. */
+    FOSSIL_MYSHELL_AGG_AVG         /**< Arithmetic mean (in f64). */
+} fossil_myshell_agg_op_t;
+
+/**
+ * o-Aggregates
+ * Aggregate result. Every field is filled; read the one matching the type:
+ * i64 for signed integers, u64 for unsigned integers, f64 for floats and AVG.
+ */
+typedef struct {
+    uint64_t count;   /**< Number of values aggregated. */
+    int64_t  i64;     /**< Result as signed integer. */
+    uint64_t u64;     /**< Result as unsigned integer. */
+    double   f64;     /**< Result as floating point. */
+} fossil_myshell_agg_result_t;
+
+/**
+ * o-Aggregates
+ * Computes COUNT/SUM/MIN/MAX/AVG over the values of records whose key starts
+ * with key_prefix and whose FSON type is 'type' (i8..i64, u8..u64, f32, f64).
+ * Values are decoded into columnar batches and reduced with SIMD kernels
+ * (SSE2/SSE4.2 or NEON, scalar otherwise). Values that don't parse as the
+ * type are skipped. Pending transaction writes are not visible.
+ * Time Complexity: O(n) (n = number of records).
+ * @param db Database handle.
+ * @param key_prefix Key prefix filter (NULL or "" for all keys).
+ * @param type FSON numeric type name.
+ * @param op Aggregate operation.
+ * @param result Output result.
+ * @return Error code (FOSSIL_MYSHELL_ERROR_NOT_FOUND for MIN/MAX/AVG with no values,
+ *         FOSSIL_MYSHELL_ERROR_INVALID_TYPE for non-numeric types).
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_aggregate(
+    fossil_bluecrab_myshell_t *db,
+    const char *key_prefix,
+    const char *type,
+    fossil_myshell_agg_op_t op,
+    fossil_myshell_agg_result_t *result
+);
+
+/**
+ * o-Indexes
+ * Extractor callback for secondary indexes. Writes the value to index for a
+ * record into out (NUL-terminated).
+ * @param key Record key.
+ * @param type FSON type name.
+ * @param value Record value.
+ * @param out Output buffer.
+ * @param out_size Size of output buffer.
+ * @param user User data pointer given to fossil_myshell_create_index.
+ * @return True to index the record, false to leave it out.
+ */
+typedef bool (*fossil_myshell_index_extractor_t)(const char *key, const char *type, const char *value, char *out, size_t out_size, void *user);
+
+/**
+ * o-Indexes
+ * Built-in extractor that indexes one top-level member of an FSON object
+ * value such as `{ user: cstr: "alice", age: i32: 30 }`. Pass the member name
+ * as the user pointer of fossil_myshell_create_index.
+ * Time Complexity: O(m) (m = value length).
+ */
+bool fossil_myshell_index_fson_field(const char *key, const char *type, const char *value, char *out, size_t out_size, void *user);
+
+/**
+ * o-Indexes
+ * Creates a secondary index from record values (or what extractor derives
+ * from them) to keys. The index is kept up to date by put, del and
+ * transaction commit on this handle, and saved to "<path>.<name>.idx" on
+ * close. Creating the same index after reopening loads that file when the
+ * database is unchanged and the extractor is the same (NULL, or
+ * fossil_myshell_index_fson_field on the same member), and rebuilds it with
+ * one scan otherwise. Indexes with any other extractor are rebuilt on every
+ * create; see fossil_myshell_create_index_versioned to let them load.
+ * Values that parse as numbers order numerically, before all other values.
+ * Time Complexity: O(n log n) to build, O(1) to load per entry. The index
+ * is a sorted array, so each indexed put or del then adds O(k) (k = index
+ * entries) to shift it; lookups stay O(log k).
+ * @param db Database handle.
+ * @param name Index name (letters, digits, '_' and '-').
+ * @param type_filter Only index records of this FSON type (NULL for all).
+ * @param extractor Value extractor (NULL to index the whole value).
+ * @param user User data pointer passed to extractor.
+ * @return Error code (FOSSIL_MYSHELL_ERROR_ALREADY_EXISTS if the name is taken).
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_create_index(
+    fossil_bluecrab_myshell_t *db,
+    const char *name,
+    const char *type_filter,
+    fossil_myshell_index_extractor_t extractor,
+    void *user
+);
+
+/**
+ * o-Indexes
+ * Same as fossil_myshell_create_index, with a version tag for a custom
+ * extractor. A saved index is loaded only when it was built with the same
+ * tag, so change the tag whenever the extractor's output changes. The tag
+ * is ignored for the built-in extractors.
+ * Time Complexity: O(n log n) to build, O(1) to load per entry.
+ * @param db Database handle.
+ * @param name Index name (letters, digits, '_' and '-').
+ * @param type_filter Only index records of this FSON type (NULL for all).
+ * @param extractor Value extractor (NULL to index the whole value).
+ * @param user User data pointer passed to extractor.
+ * @param version Extractor version tag without whitespace (NULL to never load a saved index).
+ * @return Error code (FOSSIL_MYSHELL_ERROR_ALREADY_EXISTS if the name is taken).
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_create_index_versioned(
+    fossil_bluecrab_myshell_t *db,
+    const char *name,
+    const char *type_filter,
+    fossil_myshell_index_extractor_t extractor,
+    void *user,
+    const char *version
+);
+
+/**
+ * o-Indexes
+ * Drops an index and deletes its saved file.
+ * Time Complexity: O(k) (k = index entries).
+ * @param db Database handle.
+ * @param name Index name.
+ * @return Error code (FOSSIL_MYSHELL_ERROR_NOT_FOUND if there is no such index).
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_drop_index(fossil_bluecrab_myshell_t *db, const char *name);
+
+/**
+ * o-Indexes
+ * Invokes cb(key, type, indexed_value) for every key whose indexed value
+ * equals value (numerically for numbers).
+ * Time Complexity: O(log k + matches).
+ * @param db Database handle.
+ * @param name Index name.
+ * @param value Value to look up.
+ * @param cb Row callback; return false to stop.
+ * @param user User data pointer.
+ * @return Error code (FOSSIL_MYSHELL_ERROR_NOT_FOUND if there is no such index).
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_index_lookup(fossil_bluecrab_myshell_t *db, const char *name, const char *value, fossil_myshell_row_cb cb, void *user);
+
+/**
+ * o-Indexes
+ * Invokes cb(key, type, indexed_value) in index order for every entry with
+ * min_value <= indexed value <= max_value. NULL bounds are open.
+ * Time Complexity: O(log k + matches).
+ * @param db Database handle.
+ * @param name Index name.
+ * @param min_value Lower bound (inclusive) or NULL.
+ * @param max_value Upper bound (inclusive) or NULL.
+ * @param cb Row callback; return false to stop.
+ * @param user User data pointer.
+ * @return Error code (FOSSIL_MYSHELL_ERROR_NOT_FOUND if there is no such index).
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_index_range(
+    fossil_bluecrab_myshell_t *db,
+    const char *name,
+    const char *min_value,
+    const char *max_value,
+    fossil_myshell_row_cb cb,
+    void *user
+);
+
+/**
+ * o-Transactions
+ * Begins a transaction. Subsequent fossil_myshell_txn_put/txn_del calls are
+ * buffered in memory and applied together by fossil_myshell_txn_commit with a
+ * single rewrite and one fsync, then an atomic rename over the database file:
+ * either every operation lands or none do. While a transaction is active,
+ * fossil_myshell_get sees its pending writes.
+ * Time Complexity: O(1)
+ * @param db Database handle.
+ * @return Error code (FOSSIL_MYSHELL_ERROR_CONCURRENCY if one is already active).
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_txn_begin(fossil_bluecrab_myshell_t *db);
+
+/**
+ * o-Transactions
+ * Buffers an insert/update of a key/value record in the active transaction.
+ * Time Complexity: O(1) average.
+ * @param db Database handle.
+ * @param key Key string.
+ * @param type Type string (FSON type).
+ * @param value Value string.
+ * @return Error code.
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_txn_put(fossil_bluecrab_myshell_t *db, const char *key, const char *type, const char *value);
+
+/**
+ * o-Transactions
+ * Buffers a delete of a key in the active transaction. Deleting a key that
+ * does not exist at commit time is not an error.
+ * Time Complexity: O(1) average.
+ * @param db Database handle.
+ * @param key Key string.
+ * @return Error code.
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_txn_del(fossil_bluecrab_myshell_t *db, const char *key);
+
+/**
+ * o-Transactions
+ * Applies all buffered operations atomically and ends the transaction.
+ * On failure the database file is unchanged and the transaction is discarded.
+ * Time Complexity: O(n + t) (n = number of records, t = buffered operations).
+ * @param db Database handle.
+ * @return Error code (FOSSIL_MYSHELL_ERROR_TRANSACTION_FAILED on failure).
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_txn_commit(fossil_bluecrab_myshell_t *db);
+
+/**
+ * o-Transactions
+ * Discards all buffered operations and ends the transaction.
+ * Time Complexity: O(t) (t = buffered operations).
+ * @param db Database handle.
+ * @return Error code.
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_txn_rollback(fossil_bluecrab_myshell_t *db);
+
+/**
+ * o-Cache
+ * Enables, resizes, or disables (max_bytes == 0) a bounded LRU cache of
+ * values on the handle. Hits in fossil_myshell_get skip the file scan; put,
+ * del and transaction commits invalidate the affected keys. Writes made
+ * through other handles on the same file are not observed.
+ * Time Complexity: O(e) for evicting down to the new size, O(1) otherwise.
+ * @param db Database handle.
+ * @param max_bytes Upper bound on cached keys, values and entry overhead.
+ * @return Error code.
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_cache_enable(fossil_bluecrab_myshell_t *db, size_t max_bytes);
+
+/**
+ * o-Cache
+ * Reports the cache hit/miss counters accumulated by fossil_myshell_get.
+ * Time Complexity: O(1)
+ * @param db Database handle.
+ * @param hits Output for hit count (may be NULL).
+ * @param misses Output for miss count (may be NULL).
+ * @return Error code (FOSSIL_MYSHELL_ERROR_NOT_FOUND if the cache is disabled).
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_cache_stats(fossil_bluecrab_myshell_t *db, uint64_t *hits, uint64_t *misses);
+
+/**
+ * o-Async
+ * Completion callback for submitted requests. For gets, value holds the
+ * result on success (NULL otherwise); for puts it is the value written.
+ * Both pointers are only valid for the duration of the call.
+ * @param err Result of the operation.
+ * @param key Key the request was submitted for.
+ * @param value Value string (see above).
+ * @param user User data pointer given at submission.
+ */
+typedef void (*fossil_myshell_async_cb)(fossil_bluecrab_myshell_error_t err, const char *key, const char *value, void *user);
+
+/**
+ * o-Async
+ * Queues a get on the shared worker pool and returns immediately.
+ * Gets on a handle run concurrently with each other; puts run one at a
+ * time in submission order, and a get sees every put submitted before it.
+ * Every function on a handle takes the handle's lock, so the synchronous
+ * API may be used while requests are in flight.
+ * Time Complexity: O(1) to submit; the get itself is O(n).
+ * @param db Database handle.
+ * @param key Key string.
+ * @param cb Completion callback (may be NULL).
+ * @param user User data pointer passed to cb.
+ * @return Error code for the submission itself.
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_submit_get(fossil_bluecrab_myshell_t *db, const char *key, fossil_myshell_async_cb cb, void *user);
+
+/**
+ * o-Async
+ * Queues a put on the shared worker pool and returns immediately.
+ * The type is validated at submission.
+ * Time Complexity: O(1) to submit; the put itself is O(n).
+ * @param db Database handle.
+ * @param key Key string.
+ * @param type Type string (FSON type).
+ * @param value Value string.
+ * @param cb Completion callback (may be NULL).
+ * @param user User data pointer passed to cb.
+ * @return Error code for the submission itself.
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_submit_put(fossil_bluecrab_myshell_t *db, const char *key, const char *type, const char *value, fossil_myshell_async_cb cb, void *user);
+
+/**
+ * o-Async
+ * Invokes callbacks for requests that have completed so far, without blocking.
+ * Time Complexity: O(c) (c = completed requests).
+ * @param db Database handle.
+ * @return Number of callbacks invoked.
+ */
+size_t fossil_myshell_async_poll(fossil_bluecrab_myshell_t *db);
+
+/**
+ * o-Async
+ * Blocks until every submitted request has completed, then invokes their callbacks.
+ * Closing a handle does the same implicitly.
+ * Time Complexity: O(q) (q = outstanding requests).
+ * @param db Database handle.
+ * @return Number of callbacks invoked.
+ */
+size_t fossil_myshell_async_wait(fossil_bluecrab_myshell_t *db);
+
+/**
+ * o-Durability
+ * How hard writes are pushed towards stable storage.
+ */
+typedef enum {
+    FOSSIL_MYSHELL_DURABILITY_NONE = 0,  /**< Leave writes in stdio buffers; rewrites are not fsynced. */
+    FOSSIL_MYSHELL_DURABILITY_FLUSH,     /**< Flush to the OS after every operation (default). */
+    FOSSIL_MYSHELL_DURABILITY_FSYNC,     /**< Also sync (fdatasync where available) on every commit, merge and rewrite. */
+    FOSSIL_MYSHELL_DURABILITY_PERIODIC   /**< Flush per operation; a background thread syncs every interval_ms. */
+} fossil_bluecrab_myshell_durability_t;
+
+/**
+ * o-Durability
+ * Sets the durability policy of the handle. PERIODIC starts a background
+ * thread that calls fdatasync (fsync where unavailable, FlushFileBuffers on
+ * Windows) at most once per interval when something was written; it is
+ * stopped, after a final sync, by changing the mode or closing the handle.
+ * Time Complexity: O(1)
+ * @param db Database handle.
+ * @param mode Durability mode.
+ * @param interval_ms Sync interval for PERIODIC (ignored otherwise, must be > 0).
+ * @return Error code.
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_set_durability(
+    fossil_bluecrab_myshell_t *db,
+    fossil_bluecrab_myshell_durability_t mode,
+    unsigned interval_ms
+);
+
 /**
  * o-Commit/branch
- * Commits the current changes to the database with a message.
- * Time Complexity: O(1) for metadata update.
+ * Commits the current changes to the database with a message. Staged entries
+ * are written ahead of the commit line in the same append and then cleared.
+ * Time Complexity: O(1) for metadata update, O(s) for flushing (s = number of staged records).
  * @param db Database handle.
  * @param message Commit message.
  * @return Error code.
@@ -298,8 +679,9 @@ fossil_bluecrab_myshell_error_t fossil_myshell_revert(fossil_bluecrab_myshell_t
 
 /**
  * o-Staging area
- * Stages a key/value pair for the next commit.
- * Time Complexity: O(1) for append, O(n) for update (n = number of staged records).
+ * Stages a key/value pair for the next commit. The staging area is kept in
+ * memory on the handle and only persisted by fossil_myshell_commit.
+ * Time Complexity: O(1) average.
  * @param db Database handle.
  * @param key Key string.
  * @param type Type string (FSON type).
@@ -309,9 +691,9 @@ fossil_bluecrab_myshell_error_t fossil_myshell_revert(fossil_bluecrab_myshell_t
 fossil_bluecrab_myshell_error_t fossil_myshell_stage(fossil_bluecrab_myshell_t *db, const char *key, const char *type, const char *value);
 
 /**
- * o-Staging area 
+ * o-Staging area
  * Unstages a key/value pair from the staging area.
- * Time Complexity: O(n) (n = number of staged records).
+ * Time Complexity: O(1) average.
  * @param db Database handle.
  * @param key Key string.
  * @return Error code.
@@ -351,6 +733,42 @@ typedef bool (*fossil_myshell_commit_cb)(const char *commit_hash, const char *me
  */
 fossil_bluecrab_myshell_error_t fossil_myshell_log(fossil_bluecrab_myshell_t *db, fossil_myshell_commit_cb cb, void *user);
 
+/**
+ * o-History iteration
+ * Direction for fossil_myshell_log_range.
+ */
+typedef enum {
+    FOSSIL_MYSHELL_LOG_BACKWARD = 0,  /**< Newest to oldest. */
+    FOSSIL_MYSHELL_LOG_FORWARD        /**< Oldest to newest. */
+} fossil_myshell_log_direction_t;
+
+/**
+ * o-History iteration
+ * Visits at most 'limit' commits starting at from_commit (inclusive), walking
+ * in the given direction. A NULL from_commit starts at the newest commit when
+ * walking backward and at the oldest when walking forward; a limit of 0 means
+ * no limit. Commits are located through an offset index that is built once,
+ * extended over appended bytes, carried through put/del rewrites and saved
+ * in the `.meta` sidecar on close.
+ * Time Complexity: O(limit) once the index exists, O(n) for the first call on
+ * a database without one.
+ * @param db Database handle.
+ * @param from_commit Hex commit hash to start at, or NULL.
+ * @param limit Maximum number of commits to visit (0 = all).
+ * @param direction FOSSIL_MYSHELL_LOG_BACKWARD or FOSSIL_MYSHELL_LOG_FORWARD.
+ * @param cb Callback function.
+ * @param user User data pointer.
+ * @return Error code (FOSSIL_MYSHELL_ERROR_NOT_FOUND if from_commit is unknown).
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_log_range(
+    fossil_bluecrab_myshell_t *db,
+    const char *from_commit,
+    size_t limit,
+    fossil_myshell_log_direction_t direction,
+    fossil_myshell_commit_cb cb,
+    void *user
+);
+
 /**
  * o-Backup/restore
  * Creates a backup of the database file.
@@ -405,6 +823,85 @@ const char *fossil_myshell_errstr(fossil_bluecrab_myshell_error_t err);
  */
 fossil_bluecrab_myshell_error_t fossil_myshell_check_integrity(fossil_bluecrab_myshell_t *db);
 
+/**
+ * o-Sharding
+ * Sharded database handle. Keys are routed by myshell_hash64(key) % nshards
+ * to the files <dir>/shard-NNNN.myshell; each shard has its own lock and
+ * write path, so writers on different shards never wait on each other.
+ * The shard count is recorded in <dir>/shards.manifest on first open and
+ * cannot change afterwards (keys would route to the wrong file).
+ * Handles are thread-safe: any thread may call the sharded functions.
+ */
+typedef struct fossil_bluecrab_myshell_sharded_t {
+    char    *dir;                           /**< Directory holding the shard files. */
+    size_t   nshards;                       /**< Number of shards. */
+    fossil_bluecrab_myshell_t **shards;     /**< Per-shard database handles. */
+    void    *locks;                         /**< Per-shard mutexes. */
+} fossil_bluecrab_myshell_sharded_t;
+
+/**
+ * o-Sharding
+ * Opens (or creates) a sharded database in 'dir'. The directory is created
+ * if missing. Shards are opened in parallel.
+ * Time Complexity: O(n / p) (n = records, p = parallel shards).
+ * @param dir Directory path.
+ * @param nshards Number of shards (1..1024), or 0 to use the recorded count.
+ * @param err Output parameter for error code (FOSSIL_MYSHELL_ERROR_SCHEMA_MISMATCH
+ *            if nshards differs from the recorded count).
+ * @return Sharded handle, or NULL on failure.
+ */
+fossil_bluecrab_myshell_sharded_t *fossil_myshell_open_sharded(const char *dir, size_t nshards, fossil_bluecrab_myshell_error_t *err);
+
+/**
+ * o-Sharding
+ * Closes every shard and releases the sharded handle.
+ * @param db Sharded handle.
+ */
+void fossil_myshell_close_sharded(fossil_bluecrab_myshell_sharded_t *db);
+
+/**
+ * o-Sharding
+ * Returns the shard index a key routes to.
+ * Time Complexity: O(k) (k = key length).
+ * @param db Sharded handle.
+ * @param key Key.
+ * @return Shard index, or 0 for invalid arguments.
+ */
+size_t fossil_myshell_sharded_shard_of(const fossil_bluecrab_myshell_sharded_t *db, const char *key);
+
+/**
+ * o-Sharding
+ * Record CRUD on the shard owning 'key'; only that shard is locked.
+ * Same semantics and complexity as fossil_myshell_put/get/del on one shard.
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_sharded_put(fossil_bluecrab_myshell_sharded_t *db, const char *key, const char *type, const char *value);
+fossil_bluecrab_myshell_error_t fossil_myshell_sharded_get(fossil_bluecrab_myshell_sharded_t *db, const char *key, char *out_value, size_t out_size);
+fossil_bluecrab_myshell_error_t fossil_myshell_sharded_del(fossil_bluecrab_myshell_sharded_t *db, const char *key);
+
+/**
+ * o-Sharding
+ * Runs a fossil_myshell_query SELECT over all shards in parallel. A key
+ * equality is routed to its single shard. Callbacks are serialized but
+ * rows arrive in no particular order across shards; LIMIT applies to the
+ * combined result. The callback must not write to the sharded handle.
+ * Time Complexity: O(n / p).
+ * @param db Sharded handle.
+ * @param sql Query text.
+ * @param cb Row callback; return false to stop.
+ * @param user User data.
+ * @return Error code.
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_sharded_query(fossil_bluecrab_myshell_sharded_t *db, const char *sql, fossil_myshell_row_cb cb, void *user);
+
+/**
+ * o-Sharding
+ * Runs fossil_myshell_check_integrity on all shards in parallel.
+ * Time Complexity: O(n / p).
+ * @param db Sharded handle.
+ * @return First failing shard's error code, or FOSSIL_MYSHELL_ERROR_SUCCESS.
+ */
+fossil_bluecrab_myshell_error_t fossil_myshell_sharded_check_integrity(fossil_bluecrab_myshell_sharded_t *db);
+
 #ifdef __cplusplus
 }
 #include <utility>
@@ -452,7 +949,7 @@ namespace fossil {
             /**
              * o-Open
              * Opens an existing database file.
-             * Time Complexity: O(1) for handle allocation, O(n) for file scan.
+             * Time Complexity: O(1) for a cleanly closed file, O(n) for a full scan.
              */
             explicit MyShell(const std::string& path, fossil_bluecrab_myshell_error_t& err) {
                 db_ = fossil_myshell_open(path.c_str(), &err);
@@ -520,6 +1017,187 @@ namespace fossil {
                 return fossil_myshell_del(db_, key.c_str());
             }
 
+            /**
+             * o-Query
+             * Runs a SQL-like SELECT over the records.
+             * Time Complexity: O(n), less with LIMIT.
+             */
+            fossil_bluecrab_myshell_error_t query(const std::string& sql, fossil_myshell_row_cb cb, void* user) {
+                return fossil_myshell_query(db_, sql.c_str(), cb, user);
+            }
+
+            /**
+             * o-Aggregates
+             * COUNT/SUM/MIN/MAX/AVG over numeric records with the given key prefix and type.
+             * Time Complexity: O(n)
+             */
+            fossil_bluecrab_myshell_error_t aggregate(const std::string& key_prefix, const std::string& type,
+                                                      fossil_myshell_agg_op_t op, fossil_myshell_agg_result_t& result) {
+                return fossil_myshell_aggregate(db_, key_prefix.c_str(), type.c_str(), op, &result);
+            }
+
+            /**
+             * o-Indexes (create_index)
+             * Creates a secondary value index ("" type_filter = all types).
+             * Time Complexity: O(n log n) to build.
+             */
+            fossil_bluecrab_myshell_error_t create_index(const std::string& name, const std::string& type_filter,
+                                                         fossil_myshell_index_extractor_t extractor = nullptr,
+                                                         void* user = nullptr) {
+                return fossil_myshell_create_index(db_, name.c_str(), type_filter.empty() ? nullptr : type_filter.c_str(),
+                                                   extractor, user);
+            }
+
+            /**
+             * o-Indexes (create_index_versioned)
+             * Creates an index whose custom extractor is identified by version across runs.
+             * Time Complexity: O(n log n) to build.
+             */
+            fossil_bluecrab_myshell_error_t create_index_versioned(const std::string& name, const std::string& type_filter,
+                                                                   fossil_myshell_index_extractor_t extractor, void* user,
+                                                                   const std::string& version) {
+                return fossil_myshell_create_index_versioned(db_, name.c_str(), type_filter.empty() ? nullptr : type_filter.c_str(),
+                                                             extractor, user, version.c_str());
+            }
+
+            /**
+             * o-Indexes (drop_index)
+             * Drops an index and deletes its saved file.
+             */
+            fossil_bluecrab_myshell_error_t drop_index(const std::string& name) {
+                return fossil_myshell_drop_index(db_, name.c_str());
+            }
+
+            /**
+             * o-Indexes (index_lookup)
+             * Visits the keys whose indexed value equals value.
+             * Time Complexity: O(log k + matches)
+             */
+            fossil_bluecrab_myshell_error_t index_lookup(const std::string& name, const std::string& value,
+                                                         fossil_myshell_row_cb cb, void* user) {
+                return fossil_myshell_index_lookup(db_, name.c_str(), value.c_str(), cb, user);
+            }
+
+            /**
+             * o-Indexes (index_range)
+             * Visits entries with min_value <= indexed value <= max_value ("" = open bound).
+             * Time Complexity: O(log k + matches)
+             */
+            fossil_bluecrab_myshell_error_t index_range(const std::string& name, const std::string& min_value,
+                                                        const std::string& max_value, fossil_myshell_row_cb cb, void* user) {
+                return fossil_myshell_index_range(db_, name.c_str(), min_value.empty() ? nullptr : min_value.c_str(),
+                                                  max_value.empty() ? nullptr : max_value.c_str(), cb, user);
+            }
+
+            /**
+             * o-Transactions (begin)
+             * Begins a transaction; writes are buffered until txn_commit.
+             * Time Complexity: O(1)
+             */
+            fossil_bluecrab_myshell_error_t txn_begin() {
+                return fossil_myshell_txn_begin(db_);
+            }
+
+            /**
+             * o-Transactions (put)
+             * Buffers an insert/update in the active transaction.
+             * Time Complexity: O(1) average.
+             */
+            fossil_bluecrab_myshell_error_t txn_put(const std::string& key, const std::string& type, const std::string& value) {
+                return fossil_myshell_txn_put(db_, key.c_str(), type.c_str(), value.c_str());
+            }
+
+            /**
+             * o-Transactions (del)
+             * Buffers a delete in the active transaction.
+             * Time Complexity: O(1) average.
+             */
+            fossil_bluecrab_myshell_error_t txn_del(const std::string& key) {
+                return fossil_myshell_txn_del(db_, key.c_str());
+            }
+
+            /**
+             * o-Transactions (commit)
+             * Applies all buffered operations atomically.
+             * Time Complexity: O(n + t)
+             */
+            fossil_bluecrab_myshell_error_t txn_commit() {
+                return fossil_myshell_txn_commit(db_);
+            }
+
+            /**
+             * o-Transactions (rollback)
+             * Discards all buffered operations.
+             * Time Complexity: O(t)
+             */
+            fossil_bluecrab_myshell_error_t txn_rollback() {
+                return fossil_myshell_txn_rollback(db_);
+            }
+
+            /**
+             * o-Cache (enable)
+             * Enables, resizes, or disables (0) the hot-key value cache.
+             * Time Complexity: O(1) amortized.
+             */
+            fossil_bluecrab_myshell_error_t cache_enable(size_t max_bytes) {
+                return fossil_myshell_cache_enable(db_, max_bytes);
+            }
+
+            /**
+             * o-Cache (stats)
+             * Retrieves the cache hit/miss counters.
+             * Time Complexity: O(1)
+             */
+            fossil_bluecrab_myshell_error_t cache_stats(uint64_t& hits, uint64_t& misses) {
+                return fossil_myshell_cache_stats(db_, &hits, &misses);
+            }
+
+            /**
+             * o-Durability (set_durability)
+             * Sets the fsync policy of the handle.
+             * Time Complexity: O(1)
+             */
+            fossil_bluecrab_myshell_error_t set_durability(fossil_bluecrab_myshell_durability_t mode, unsigned interval_ms = 0) {
+                return fossil_myshell_set_durability(db_, mode, interval_ms);
+            }
+
+            /**
+             * o-Async (submit_get)
+             * Queues a get; the callback runs from async_poll/async_wait.
+             * Time Complexity: O(1) to submit.
+             */
+            fossil_bluecrab_myshell_error_t submit_get(const std::string& key, fossil_myshell_async_cb cb, void* user) {
+                return fossil_myshell_submit_get(db_, key.c_str(), cb, user);
+            }
+
+            /**
+             * o-Async (submit_put)
+             * Queues a put; the callback runs from async_poll/async_wait.
+             * Time Complexity: O(1) to submit.
+             */
+            fossil_bluecrab_myshell_error_t submit_put(const std::string& key, const std::string& type, const std::string& value,
+                                                       fossil_myshell_async_cb cb, void* user) {
+                return fossil_myshell_submit_put(db_, key.c_str(), type.c_str(), value.c_str(), cb, user);
+            }
+
+            /**
+             * o-Async (async_poll)
+             * Runs callbacks for completed requests without blocking.
+             * Time Complexity: O(c)
+             */
+            size_t async_poll() {
+                return fossil_myshell_async_poll(db_);
+            }
+
+            /**
+             * o-Async (async_wait)
+             * Waits for all outstanding requests and runs their callbacks.
+             * Time Complexity: O(q)
+             */
+            size_t async_wait() {
+                return fossil_myshell_async_wait(db_);
+            }
+
             /**
              * o-Commit
              * Commits the current changes to the database with a message.
@@ -568,7 +1246,7 @@ namespace fossil {
             /**
              * o-Staging (stage)
              * Stages a key/value pair for the next commit.
-             * Time Complexity: O(1) for append, O(n) for update.
+             * Time Complexity: O(1) average.
              */
             fossil_bluecrab_myshell_error_t stage(const std::string& key, const std::string& type, const std::string& value) {
                 return fossil_myshell_stage(db_, key.c_str(), type.c_str(), value.c_str());
@@ -577,7 +1255,7 @@ namespace fossil {
             /**
              * o-Staging (unstage)
              * Unstages a key/value pair from the staging area.
-             * Time Complexity: O(n)
+             * Time Complexity: O(1) average.
              */
             fossil_bluecrab_myshell_error_t unstage(const std::string& key) {
                 return fossil_myshell_unstage(db_, key.c_str());
@@ -601,6 +1279,18 @@ namespace fossil {
                 return fossil_myshell_log(db_, cb, user);
             }
 
+            /**
+             * o-History iteration (log_range)
+             * Visits at most 'limit' commits from from_commit ("" = newest/oldest).
+             * Time Complexity: O(limit) once the commit index is built.
+             */
+            fossil_bluecrab_myshell_error_t log_range(const std::string& from_commit, size_t limit,
+                                                      fossil_myshell_log_direction_t direction,
+                                                      fossil_myshell_commit_cb cb, void* user) {
+                return fossil_myshell_log_range(db_, from_commit.empty() ? nullptr : from_commit.c_str(),
+                                                limit, direction, cb, user);
+            }
+
             /**
              * o-Backup
              * Creates a backup of the database file.
@@ -680,6 +1370,116 @@ namespace fossil {
             fossil_bluecrab_myshell_t* db_;
         };
 
+        /**
+         * o-Sharding
+         * RAII wrapper for a hash-sharded MyShell database. Unlike MyShell,
+         * a ShardedMyShell may be used from several threads at once.
+         */
+        class ShardedMyShell {
+        public:
+            ShardedMyShell(const ShardedMyShell&) = delete;
+            ShardedMyShell& operator=(const ShardedMyShell&) = delete;
+            ShardedMyShell(ShardedMyShell&& other) noexcept : db_(std::exchange(other.db_, nullptr)) {}
+            ShardedMyShell& operator=(ShardedMyShell&& other) noexcept {
+                if (this != &other) {
+                    close();
+                    db_ = std::exchange(other.db_, nullptr);
+                }
+                return *this;
+            }
+
+            /**
+             * o-Sharding (open)
+             * Opens or creates the sharded database in dir.
+             * Time Complexity: O(n / p)
+             */
+            ShardedMyShell(const std::string& dir, size_t nshards, fossil_bluecrab_myshell_error_t& err) {
+                db_ = fossil_myshell_open_sharded(dir.c_str(), nshards, &err);
+            }
+
+            ~ShardedMyShell() { close(); }
+
+            /**
+             * o-Sharding (close)
+             */
+            void close() {
+                if (db_) {
+                    fossil_myshell_close_sharded(db_);
+                    db_ = nullptr;
+                }
+            }
+
+            /**
+             * o-Sharding (put)
+             * Time Complexity: O(n / s)
+             */
+            fossil_bluecrab_myshell_error_t put(const std::string& key, const std::string& type, const std::string& value) {
+                return fossil_myshell_sharded_put(db_, key.c_str(), type.c_str(), value.c_str());
+            }
+
+            /**
+             * o-Sharding (get)
+             * Time Complexity: O(n / s)
+             */
+            fossil_bluecrab_myshell_error_t get(const std::string& key, std::string& out_value) {
+                char buffer[1024];
+                fossil_bluecrab_myshell_error_t err = fossil_myshell_sharded_get(db_, key.c_str(), buffer, sizeof(buffer));
+                if (err == FOSSIL_MYSHELL_ERROR_SUCCESS) {
+                    out_value = buffer;
+                }
+                return err;
+            }
+
+            /**
+             * o-Sharding (del)
+             * Time Complexity: O(n / s)
+             */
+            fossil_bluecrab_myshell_error_t del(const std::string& key) {
+                return fossil_myshell_sharded_del(db_, key.c_str());
+            }
+
+            /**
+             * o-Sharding (query)
+             * Time Complexity: O(n / p)
+             */
+            fossil_bluecrab_myshell_error_t query(const std::string& sql, fossil_myshell_row_cb cb, void* user) {
+                return fossil_myshell_sharded_query(db_, sql.c_str(), cb, user);
+            }
+
+            /**
+             * o-Sharding (check_integrity)
+             * Time Complexity: O(n / p)
+             */
+            fossil_bluecrab_myshell_error_t check_integrity() {
+                return fossil_myshell_sharded_check_integrity(db_);
+            }
+
+            /**
+             * o-Sharding (shard_of)
+             */
+            size_t shard_of(const std::string& key) const {
+                return fossil_myshell_sharded_shard_of(db_, key.c_str());
+            }
+
+            /**
+             * o-Sharding (shard_count)
+             */
+            size_t shard_count() const { return db_ ? db_->nshards : 0; }
+
+            /**
+             * o-Utility (is_open)
+             */
+            bool is_open() const { return db_ != nullptr; }
+
+            /**
+             * o-Utility (handle)
+             */
+            fossil_bluecrab_myshell_sharded_t* handle() const { return db_; }
+
+        private:
+            fossil_bluecrab_myshell_sharded_t* db_;
+        };
+
     } // namespace bluecrab
 
 } // namespace fossil
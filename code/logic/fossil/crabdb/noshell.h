@@ -168,6 +168,11 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_insert(const char *file_
 
 /**
  * @brief Inserts a document and returns a unique internal ID.
+ *
+ * The ID is the document's content hash unless a live document already
+ * holds it (an updated document keeps its original ID, and a text file
+ * keeps every copy of a document inserted twice); the insert then takes
+ * the next free ID.
  * 
  * @param file_name     The database file name (.crabdb enforced).
  * @param document      The document string to insert.
@@ -181,6 +186,11 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_insert_with_id(const cha
 
 /**
  * @brief Finds a document based on a query string.
+ *
+ * A query starting with WHERE is a structured query over the document's
+ * fields (see fossil_bluecrab_noshell_query_compile); any other query is
+ * matched as a substring of the whole line. The same applies to update and
+ * remove.
  * 
  * @param file_name     The database file name.
  * @param query         The query string to search.
@@ -201,8 +211,57 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_find(const char *file_na
  */
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_find_cb(const char *file_name, bool (*cb)(const char *document, void *userdata), void *userdata);
 
+/**
+ * @brief Delivery order for fossil_bluecrab_noshell_find_cb_parallel.
+ */
+typedef enum {
+    FOSSIL_NOSHELL_SCAN_ORDERED,    /**< Callback runs on the calling thread, in file order. */
+    FOSSIL_NOSHELL_SCAN_UNORDERED   /**< Callback runs on the workers, concurrently and in any order. */
+} fossil_bluecrab_noshell_scan_mode_t;
+
+/**
+ * @brief Finds documents with a callback, scanning the file on worker threads.
+ *
+ * The file is split into newline-aligned chunks that workers scan in
+ * parallel, filtering live documents with query (substring or
+ * `WHERE ...`, as in fossil_bluecrab_noshell_find) before the callback
+ * sees them. In ORDERED mode the callback runs on the calling thread in
+ * file order; in UNORDERED mode it runs on the workers and must be
+ * thread-safe. Returning true from the callback stops the scan; in
+ * UNORDERED mode calls already under way on other workers still finish.
+ *
+ * @param file_name     The database file name.
+ * @param query         Optional filter evaluated on the workers (NULL or "" = every document).
+ * @param mode          FOSSIL_NOSHELL_SCAN_ORDERED or FOSSIL_NOSHELL_SCAN_UNORDERED.
+ * @param threads       Number of workers, including the caller (0 = default of 4, at most 16).
+ * @param cb            Callback for each matching document; return true to stop.
+ * @param userdata      Optional user data passed to the callback.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS if a callback stopped the scan,
+ *                      FOSSIL_NOSHELL_ERROR_NOT_FOUND if none did, otherwise error code.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_find_cb_parallel(const char *file_name, const char *query, fossil_bluecrab_noshell_scan_mode_t mode, size_t threads, bool (*cb)(const char *document, void *userdata), void *userdata);
+
+/**
+ * @brief Finds a document by its ID (as returned by insert_with_id or the iteration helpers).
+ *
+ * Uses the document id index: an open handle's table if the path has one,
+ * otherwise a per-path table cached in the process and rebuilt only when
+ * the file changes. The lookup is O(1) once the index is built.
+ *
+ * @param file_name     The database file name.
+ * @param id            16-hex-digit document ID.
+ * @param result        Buffer receiving the document line.
+ * @param buffer_size   Size of the result buffer.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS, or FOSSIL_NOSHELL_ERROR_NOT_FOUND.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_find_by_id(const char *file_name, const char *id, char *result, size_t buffer_size);
+
 /**
  * @brief Updates a document in the database based on a query string.
+ *
+ * Nothing is rewritten: each matching document gets its new version
+ * appended, keeping the old #id=, followed by a tombstone. See
+ * fossil_bluecrab_noshell_compact.
  * 
  * @param file_name     The database file name.
  * @param query         Query string to locate document(s).
@@ -215,6 +274,9 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_update(const char *file_
 
 /**
  * @brief Removes a document from the database based on a query string.
+ *
+ * Each matching document gets a tombstone appended; the file is not
+ * rewritten. See fossil_bluecrab_noshell_compact.
  * 
  * @param file_name     The database file name.
  * @param query         Query string to locate document(s) to remove.
@@ -222,6 +284,196 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_update(const char *file_
  */
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_remove(const char *file_name, const char *query);
 
+/**
+ * @brief Rewrites the database without removed and superseded documents.
+ *
+ * update and remove append "#del=<offset>,<length> #id=<id>" tombstones
+ * instead of rewriting the file; readers skip the lines they name.
+ * Compaction streams the live lines to a temporary file renamed over the
+ * original, dropping the tombstones. It runs on its own after an update
+ * or remove once dead bytes make up more than half of a file of at least
+ * 64 KiB; call this to force it.
+ *
+ * @param file_name     The database file name.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_compact(const char *file_name);
+
+// ===========================================================
+// Structured Queries
+// ===========================================================
+
+/**
+ * @brief Compiled structured query.
+ */
+typedef struct fossil_bluecrab_noshell_query_t fossil_bluecrab_noshell_query_t;
+
+/**
+ * @brief Compiles a structured query, e.g.
+ *
+ *   WHERE name = 'ann' AND (age >= 30 OR role LIKE 'admin%')
+ *
+ * Fields name members of the FSON body ("{ name: cstr: \"ann\", ... }");
+ * dotted names reach into nested objects, and _id / _type read the #id= /
+ * #type= tags. Operators: = != <> < <= > >= LIKE, combined with AND, OR,
+ * NOT and parentheses. Numbers compare numerically; a missing field fails
+ * every comparison. The leading WHERE is optional here.
+ *
+ * @param expr          Query text.
+ * @param err           Optional output error code (FOSSIL_NOSHELL_ERROR_INVALID_QUERY on a syntax error).
+ * @return              Compiled query, or NULL on failure.
+ */
+fossil_bluecrab_noshell_query_t *fossil_bluecrab_noshell_query_compile(const char *expr, fossil_bluecrab_noshell_error_t *err);
+
+/**
+ * @brief Evaluates a compiled query against one document line.
+ *
+ * Only the fields the query names are parsed, and evaluation stops at the
+ * first predicate that decides the result.
+ *
+ * @param query         Compiled query.
+ * @param document      Document line as stored (body plus tags).
+ * @return              true if the document matches.
+ */
+bool fossil_bluecrab_noshell_query_match(const fossil_bluecrab_noshell_query_t *query, const char *document);
+
+/**
+ * @brief Frees a compiled query (NULL is ignored).
+ *
+ * @param query         Query to free.
+ */
+void fossil_bluecrab_noshell_query_free(fossil_bluecrab_noshell_query_t *query);
+
+// ===========================================================
+// Secondary Field Indexes
+// ===========================================================
+
+/**
+ * @brief Kind of secondary field index.
+ */
+typedef enum {
+    FOSSIL_NOSHELL_INDEX_HASH,      /**< Equality lookups. */
+    FOSSIL_NOSHELL_INDEX_ORDERED,   /**< Equality and numeric range lookups. */
+    FOSSIL_NOSHELL_INDEX_TEXT       /**< Trigram index for substring, LIKE and string equality lookups. */
+} fossil_bluecrab_noshell_index_kind_t;
+
+/**
+ * @brief Creates an index on one document field of a database file.
+ *
+ * The index lives in memory for the life of the process and is built
+ * immediately. Inserts, updates and removes only append to the file (new
+ * lines and tombstones), so the index picks them up incrementally; lines
+ * retired by a tombstone are skipped at lookup. Rewrites of the file
+ * (compaction, restore, delete and re-create) rebuild it on next use.
+ * Structured finds (WHERE ...) whose top-level AND terms include an
+ * equality on an indexed field, or a numeric range on an ordered one, read
+ * only the candidate documents instead of scanning the file.
+ *
+ * A TEXT index maps every 3-byte sequence of the field to a compressed
+ * list of the documents containing it, and answers LIKE patterns (through
+ * their longest literal run) and string equality on that field. With
+ * field_path "*" it indexes whole document lines and answers plain
+ * substring finds. Queries need at least 3 literal bytes to use it.
+ *
+ * @param file_name     The database file name.
+ * @param field_path    Field as named in queries (dotted for nested objects, or _id / _type);
+ *                      "*" for a TEXT index over whole lines.
+ * @param kind          FOSSIL_NOSHELL_INDEX_HASH, FOSSIL_NOSHELL_INDEX_ORDERED or
+ *                      FOSSIL_NOSHELL_INDEX_TEXT; "*" is accepted only with FOSSIL_NOSHELL_INDEX_TEXT.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS, FOSSIL_NOSHELL_ERROR_ALREADY_EXISTS if the field
+ *                      is already indexed, FOSSIL_NOSHELL_ERROR_UNSUPPORTED for "*" with another
+ *                      kind, otherwise error code.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_create_index(const char *file_name, const char *field_path, fossil_bluecrab_noshell_index_kind_t kind);
+
+/**
+ * @brief Drops the index on a field.
+ *
+ * @param file_name     The database file name.
+ * @param field_path    Indexed field.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS, or FOSSIL_NOSHELL_ERROR_NOT_FOUND if there is no such index.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_drop_index(const char *file_name, const char *field_path);
+
+// ===========================================================
+// Persistent Handles
+// ===========================================================
+
+/**
+ * @brief Open database handle.
+ *
+ * Keeps the file open between operations, together with a read buffer and
+ * an in-memory table of document offsets and ids. Handles are shared per
+ * path: opening a path that is already open returns the same handle with
+ * its reference count raised. Changes made to the file by the path-based
+ * functions are noticed (size or mtime change) and the table is rebuilt.
+ * A handle may be used from several threads; operations are serialized.
+ */
+typedef struct fossil_bluecrab_noshell_t {
+    char    *path;              /**< Path to the database file. */
+    FILE    *file;              /**< File kept open for the life of the handle. */
+    size_t   file_size;         /**< File size as last seen by the handle. */
+    time_t   last_modified;     /**< File mtime as last seen by the handle. */
+    size_t   refs;              /**< Number of opens sharing this handle. */
+    bool     is_open;           /**< Indicates if the handle is usable. */
+    void    *state;             /**< Buffers, document table and lock. */
+} fossil_bluecrab_noshell_t;
+
+/**
+ * @brief Opens a handle on an existing database file.
+ *
+ * @param file_name     The database file name (.noshell enforced).
+ * @param err           Optional output error code.
+ * @return              Handle, or NULL on failure.
+ */
+fossil_bluecrab_noshell_t *fossil_bluecrab_noshell_open(const char *file_name, fossil_bluecrab_noshell_error_t *err);
+
+/**
+ * @brief Releases one reference to a handle; the last close frees it.
+ *
+ * @param db            Handle to close.
+ */
+void fossil_bluecrab_noshell_close(fossil_bluecrab_noshell_t *db);
+
+/**
+ * @brief Handle variants of the document operations.
+ *
+ * Same matching rules, line format and results as the file-name functions
+ * above, without reopening the file or rescanning it for iteration and
+ * counting.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_insert(fossil_bluecrab_noshell_t *db, const char *document, const char *param_list, const char *type);
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_insert_with_id(fossil_bluecrab_noshell_t *db, const char *document, const char *param_list, const char *type, char *out_id, size_t id_size);
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_find(fossil_bluecrab_noshell_t *db, const char *query, char *result, size_t buffer_size, const char *type_id);
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_find_by_id(fossil_bluecrab_noshell_t *db, const char *id, char *result, size_t buffer_size);
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_find_cb(fossil_bluecrab_noshell_t *db, bool (*cb)(const char *document, void *userdata), void *userdata);
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_update(fossil_bluecrab_noshell_t *db, const char *query, const char *new_document, const char *param_list, const char *type_id);
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_remove(fossil_bluecrab_noshell_t *db, const char *query);
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_first_document(fossil_bluecrab_noshell_t *db, char *id_buffer, size_t buffer_size);
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_next_document(fossil_bluecrab_noshell_t *db, const char *prev_id, char *id_buffer, size_t buffer_size);
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_count_documents(fossil_bluecrab_noshell_t *db, size_t *count);
+
+/**
+ * @brief Appends many documents to the database with a single write.
+ *
+ * Every document is validated and hashed first (on worker threads for
+ * large batches); if any is rejected, nothing is written. Ids are then
+ * claimed in batch order as fossil_bluecrab_noshell_insert_with_id does,
+ * so equal documents in one batch get distinct ids. The lines, in
+ * the format fossil_bluecrab_noshell_handle_insert writes, are formatted
+ * into one buffer and appended with one write and one durability step.
+ *
+ * @param db            Handle from fossil_bluecrab_noshell_open.
+ * @param documents     The documents to insert.
+ * @param count         Number of documents.
+ * @param param_list    Optional FSON parameter list added to every document (can be NULL).
+ * @param type          Document type of every document.
+ * @param out_ids       Optional; receives the id of each document, in order.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS on success, FOSSIL_NOSHELL_ERROR_INVALID_TYPE
+ *                      if the type or any document is invalid, otherwise error code.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_insert_many(fossil_bluecrab_noshell_t *db, const char *const *documents, size_t count, const char *param_list, const char *type, char (*out_ids)[17]);
+
 // ===========================================================
 // Database Management
 // ===========================================================
@@ -250,6 +502,104 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_open_database(const char
  */
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_delete_database(const char *file_name);
 
+/**
+ * @brief Durability policies for writes to a database file.
+ */
+typedef enum {
+    FOSSIL_NOSHELL_DURABILITY_NONE = 0,  /**< No extra work (each operation still closes the file). */
+    FOSSIL_NOSHELL_DURABILITY_FLUSH,     /**< Flush to the OS on every operation (default). */
+    FOSSIL_NOSHELL_DURABILITY_FSYNC,     /**< fdatasync/fsync after every write. */
+    FOSSIL_NOSHELL_DURABILITY_PERIODIC   /**< A background thread syncs every interval_ms when dirty. */
+} fossil_bluecrab_noshell_durability_t;
+
+/**
+ * @brief Sets the durability policy for a database file.
+ *
+ * Settings are process-wide and keyed by the file, not the spelling of
+ * its path ("db.noshell" and "./db.noshell" share one). PERIODIC starts a
+ * background thread for the file; it is stopped, after a final sync, when
+ * the mode is changed again.
+ *
+ * @param file_name     The database file name.
+ * @param mode          Durability mode.
+ * @param interval_ms   Sync interval for PERIODIC (must be > 0, ignored otherwise).
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_set_durability(const char *file_name, fossil_bluecrab_noshell_durability_t mode, unsigned interval_ms);
+
+/**
+ * @brief Gets the durability policy for a database file.
+ *
+ * @param file_name     The database file name.
+ * @return              The configured mode, or FOSSIL_NOSHELL_DURABILITY_FLUSH if none was set.
+ */
+fossil_bluecrab_noshell_durability_t fossil_bluecrab_noshell_get_durability(const char *file_name);
+
+// ===========================================================
+// Async Submission
+// ===========================================================
+
+/**
+ * @brief Completion callback for submitted requests.
+ *
+ * @param err           Result of the operation.
+ * @param result        Matching document line for finds, new document ID for
+ *                      inserts; NULL on failure. Valid only during the call.
+ * @param user          User data pointer given at submission.
+ */
+typedef void (*fossil_bluecrab_noshell_async_cb)(fossil_bluecrab_noshell_error_t err, const char *result, void *user);
+
+/**
+ * @brief Queues a find on the shared worker pool and returns immediately.
+ *
+ * Finds run concurrently, on one file or many. Inserts on a file run one
+ * at a time in submission order, and a find sees every insert submitted
+ * before it. Avoid synchronous writes to the same file while its requests
+ * are in flight.
+ *
+ * @param file_name     The database file name.
+ * @param query         Query string to search for.
+ * @param type_id       Optional FSON type filter (may be NULL).
+ * @param cb            Completion callback (may be NULL).
+ * @param user          User data pointer passed to cb.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS if queued, otherwise error code.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_submit_find(const char *file_name, const char *query, const char *type_id, fossil_bluecrab_noshell_async_cb cb, void *user);
+
+/**
+ * @brief Queues an insert on the shared worker pool and returns immediately.
+ *
+ * @param file_name     The database file name.
+ * @param document      FSON document to insert.
+ * @param param_list    Optional parameter list (may be NULL).
+ * @param type          FSON type name.
+ * @param cb            Completion callback (may be NULL), receives the new document ID.
+ * @param user          User data pointer passed to cb.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS if queued, otherwise error code.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_submit_insert(const char *file_name, const char *document, const char *param_list, const char *type, fossil_bluecrab_noshell_async_cb cb, void *user);
+
+/**
+ * @brief Invokes callbacks for requests that have completed so far, without blocking.
+ *
+ * @return              Number of callbacks invoked.
+ */
+size_t fossil_bluecrab_noshell_async_poll(void);
+
+/**
+ * @brief Blocks until every submitted request has completed, then invokes their callbacks.
+ *
+ * @return              Number of callbacks invoked.
+ */
+size_t fossil_bluecrab_noshell_async_wait(void);
+
+/**
+ * @brief Completes all outstanding requests and waits for the pool's workers to exit.
+ *
+ * Idle workers also exit on their own; this only makes it immediate.
+ */
+void fossil_bluecrab_noshell_async_shutdown(void);
+
 /**
  * @brief Locks the database file for exclusive access.
  * 
@@ -305,6 +655,158 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_restore_database(const c
  */
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_verify_database(const char *file_name);
 
+// ===========================================================
+// Binary FSON (FSON-B)
+// ===========================================================
+
+/**
+ * @brief Writes a binary FSON-B image of a database file.
+ *
+ * The image holds the header lines and live documents. Document bodies
+ * are encoded with type tags, a file-wide field-name dictionary and
+ * offset tables, so fields are reached without parsing text. Documents
+ * whose text would not decode back byte for byte are kept as text.
+ *
+ * @param file_name     The database file name.
+ * @param binary_file   The image file path.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_export_binary(const char *file_name, const char *binary_file);
+
+/**
+ * @brief Writes a database file back from an FSON-B image.
+ *
+ * The result is byte for byte what compacting the exported file gives.
+ *
+ * @param binary_file   The image file path.
+ * @param file_name     The database file to (over)write.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_import_binary(const char *binary_file, const char *file_name);
+
+/**
+ * @brief Calls cb with each document of an FSON-B image matching query.
+ *
+ * WHERE queries are evaluated on the binary encoding; other queries are
+ * substring matches on the document text. Documents are passed as the
+ * same text lines find_cb passes.
+ *
+ * @param binary_file   The image file path.
+ * @param query         Query, or NULL / "" for every document.
+ * @param cb            Callback; returning true stops the scan.
+ * @param userdata      Passed to cb.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS if cb stopped the scan,
+ *                      FOSSIL_NOSHELL_ERROR_NOT_FOUND at the end, otherwise error code.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_binary_find_cb(const char *binary_file, const char *query, bool (*cb)(const char *document, void *userdata), void *userdata);
+
+/**
+ * @brief Reads one field of a document in an FSON-B image.
+ *
+ * @param binary_file   The image file path.
+ * @param id            Document id (16 hex digits).
+ * @param field         Field name, dotted for nested objects.
+ * @param value         Output buffer; quotes are stripped like in WHERE queries.
+ * @param buffer_size   Size of value.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS on success,
+ *                      FOSSIL_NOSHELL_ERROR_NOT_FOUND if the document or field is missing,
+ *                      otherwise error code.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_binary_get_field(const char *binary_file, const char *id, const char *field, char *value, size_t buffer_size);
+
+// ===========================================================
+// LSM Engine
+// ===========================================================
+
+/** Number of levels of an LSM database (level 0 plus sorted levels). */
+#define FOSSIL_NOSHELL_LSM_LEVELS 8
+
+/**
+ * Tuning of an LSM database. Zero fields take the default.
+ */
+typedef struct {
+    size_t   memtable_bytes;    // memtable size that triggers a flush (4 MiB)
+    size_t   segment_bytes;     // target size of compacted segments (2 MiB)
+    size_t   level0_segments;   // level-0 segments that trigger a compaction (4)
+    size_t   level_ratio;       // size ratio between adjacent levels (10)
+    unsigned bloom_bits;        // bloom filter bits per key (10)
+} fossil_bluecrab_noshell_lsm_options_t;
+
+/**
+ * Shape of an LSM database, for monitoring and tests.
+ */
+typedef struct {
+    size_t memtable_entries;                            // active and flushing memtables
+    size_t memtable_bytes;
+    size_t segments[FOSSIL_NOSHELL_LSM_LEVELS];
+    size_t level_bytes[FOSSIL_NOSHELL_LSM_LEVELS];
+    size_t flushes;                                     // since the database was opened
+    size_t compactions;
+} fossil_bluecrab_noshell_lsm_info_t;
+
+/**
+ * @brief Switches a database file to the LSM engine.
+ *
+ * Live documents move into sorted segment files next to the database; the
+ * file keeps only its header. A document written without an #id= (as older
+ * versions of update did), or whose id an earlier live document already
+ * carries, is given the next free id on the way. From then on insert, find,
+ * find_cb, find_by_id, update, remove, iteration, counts, stats, backup and
+ * compact work through the engine: writes go to a write-ahead log and an
+ * in-memory table, which is flushed to immutable segments and merged into
+ * levels by a background thread. Documents are keyed by id, so iteration is
+ * in id order. An updated document keeps its original id; an insert whose
+ * content hash names a taken id, including the same document inserted
+ * again, gets the next free id instead, as in a plain text file.
+ * Handles, cursors, field indexes and binary export are not available on
+ * an LSM database. Calling it again only replaces the options.
+ *
+ * @param file_name     The database file name.
+ * @param options       Tuning, or NULL for the defaults.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS on success,
+ *                      FOSSIL_NOSHELL_ERROR_LOCKED while a handle on the file is open.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_lsm_enable(const char *file_name, const fossil_bluecrab_noshell_lsm_options_t *options);
+
+/**
+ * @brief Writes an LSM database back as a plain text file and removes the engine files.
+ *
+ * @param file_name     The database file name.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS on success (also when the file is not an LSM database).
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_lsm_disable(const char *file_name);
+
+/**
+ * @brief Writes the memtable of an LSM database out as a segment and empties its log.
+ *
+ * @param file_name     The database file name.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS on success,
+ *                      FOSSIL_NOSHELL_ERROR_UNSUPPORTED if the file is not an LSM database.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_lsm_flush(const char *file_name);
+
+/**
+ * @brief Reports memtable, level and activity counts of an LSM database.
+ *
+ * @param file_name     The database file name.
+ * @param info          Output counts.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS on success,
+ *                      FOSSIL_NOSHELL_ERROR_UNSUPPORTED if the file is not an LSM database.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_lsm_info(const char *file_name, fossil_bluecrab_noshell_lsm_info_t *info);
+
+/**
+ * @brief Closes the engine of an LSM database in this process.
+ *
+ * The engine is opened by the first call that needs it and stays open
+ * (with its background thread) until this call, lsm_disable or
+ * delete_database. Closing flushes the memtable.
+ *
+ * @param file_name     The database file name.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_lsm_close(const char *file_name);
+
 // ===========================================================
 // Iteration Helpers
 // ===========================================================
@@ -321,6 +823,9 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_first_document(const cha
 
 /**
  * @brief Gets the next document ID after a previous one.
+ *
+ * O(1) through the document id index (see fossil_bluecrab_noshell_find_by_id),
+ * so a full first/next walk reads the file at most once.
  * 
  * @param file_name     The database file name.
  * @param prev_id       The previous document ID.
@@ -330,6 +835,80 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_first_document(const cha
  */
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_next_document(const char *file_name, const char *prev_id, char *id_buffer, size_t buffer_size);
 
+// ===========================================================
+// Cursors
+// ===========================================================
+
+/**
+ * @brief Non-owning view of part of a document line (not NUL-terminated).
+ */
+typedef struct {
+    const char *data;           /**< First byte of the view. */
+    size_t      length;         /**< Number of bytes in the view. */
+} fossil_bluecrab_noshell_view_t;
+
+/**
+ * @brief One document as returned by a cursor.
+ *
+ * The views point into the cursor's buffer and stay valid until the next
+ * call on the same cursor or until it is closed.
+ */
+typedef struct {
+    fossil_bluecrab_noshell_view_t document;  /**< FSON body (and param_list), without the #type/#id tags. */
+    fossil_bluecrab_noshell_view_t type;      /**< Value of #type=, empty if absent. */
+    fossil_bluecrab_noshell_view_t id;        /**< Value of #id=, empty if absent (e.g. updated lines). */
+} fossil_bluecrab_noshell_entry_t;
+
+/**
+ * @brief Forward cursor over the documents of a database file.
+ *
+ * Keeps its own file open and positioned, so walking the whole file reads
+ * it exactly once. The cursor sees the file as it grows through appends;
+ * a rewrite (update/remove) replaces the file and is not seen by cursors
+ * already open.
+ */
+typedef struct fossil_bluecrab_noshell_cursor_t fossil_bluecrab_noshell_cursor_t;
+
+/**
+ * @brief Opens a cursor positioned before the first document.
+ *
+ * @param file_name     The database file name (.noshell enforced).
+ * @param type_id       Optional FSON type; only documents with this #type= are returned.
+ * @param err           Optional output error code.
+ * @return              Cursor, or NULL on failure.
+ */
+fossil_bluecrab_noshell_cursor_t *fossil_bluecrab_noshell_cursor_open(const char *file_name, const char *type_id, fossil_bluecrab_noshell_error_t *err);
+
+/**
+ * @brief Advances the cursor by one document.
+ *
+ * @param cursor        Cursor to advance.
+ * @param entry         Receives views of the document, its type and its id.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS, or FOSSIL_NOSHELL_ERROR_NOT_FOUND at the end.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_cursor_next(fossil_bluecrab_noshell_cursor_t *cursor, fossil_bluecrab_noshell_entry_t *entry);
+
+/**
+ * @brief Fetches up to max_entries documents in one call.
+ *
+ * All returned views stay valid together until the next call on the cursor.
+ *
+ * @param cursor        Cursor to advance.
+ * @param entries       Array of at least max_entries entries.
+ * @param max_entries   Batch size.
+ * @param fetched       Optional output: number of entries filled.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS if at least one entry was filled,
+ *                      FOSSIL_NOSHELL_ERROR_NOT_FOUND at the end.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_cursor_next_batch(fossil_bluecrab_noshell_cursor_t *cursor, fossil_bluecrab_noshell_entry_t *entries, size_t max_entries, size_t *fetched);
+
+/**
+ * @brief Closes a cursor and frees its buffers.
+ *
+ * @param cursor        Cursor to close (NULL is ignored).
+ */
+void fossil_bluecrab_noshell_cursor_close(fossil_bluecrab_noshell_cursor_t *cursor);
+
 // ===========================================================
 // Metadata Helpers
 // ===========================================================
@@ -343,6 +922,36 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_next_document(const char
  */
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_count_documents(const char *file_name, size_t *count);
 
+/** Number of FSON types counted in fossil_bluecrab_noshell_stats_t::type_counts. */
+#define FOSSIL_NOSHELL_STATS_TYPES (NOSHELL_FSON_TYPE_DURATION + 1)
+
+/**
+ * Document and space statistics of a database file. type_counts is indexed
+ * by fossil_bluecrab_noshell_fson_type_t; documents whose #type= is not an
+ * FSON type count only toward documents.
+ */
+typedef struct {
+    size_t documents;                                   // live documents with an #id=
+    size_t file_size;
+    size_t live_bytes;                                  // file_size - dead_bytes
+    size_t dead_bytes;                                  // tombstones and the lines they retire
+    size_t type_counts[FOSSIL_NOSHELL_STATS_TYPES];
+} fossil_bluecrab_noshell_stats_t;
+
+/**
+ * @brief Reads document, byte and per-type counts of a database file.
+ *
+ * The counts are kept in a "<file>.meta" sidecar and brought up to date
+ * by reading only what was appended since it was last written, so the
+ * cost follows the amount of change rather than the size of the file.
+ * count_documents reads the same counts.
+ *
+ * @param file_name     The database file name.
+ * @param stats         Output statistics.
+ * @return              FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+ */
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_stats(const char *file_name, fossil_bluecrab_noshell_stats_t *stats);
+
 /**
  * @brief Gets the size of the database file in bytes.
  * 
@@ -374,7 +983,10 @@ bool fossil_bluecrab_noshell_validate_document(const char *document);
 
 #ifdef __cplusplus
 }
+#include <span>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace fossil {
 
@@ -439,6 +1051,50 @@ namespace fossil {
                 return err;
             }
 
+            /**
+             * @brief Scans the file on worker threads; see fossil_bluecrab_noshell_find_cb_parallel.
+             */
+            static fossil_bluecrab_noshell_error_t find_cb_parallel(const std::string& file_name, const std::string& query, fossil_bluecrab_noshell_scan_mode_t mode, size_t threads, bool (*cb)(const char* document, void* userdata), void* userdata) {
+                return fossil_bluecrab_noshell_find_cb_parallel(file_name.c_str(), query.c_str(), mode, threads, cb, userdata);
+            }
+
+            /**
+             * @brief Creates a hash or ordered index on a document field.
+             * @param file_name The database file name.
+             * @param field_path Field as named in structured queries.
+             * @param kind Index kind.
+             * @return Error code indicating success or failure.
+             */
+            static fossil_bluecrab_noshell_error_t create_index(const std::string& file_name, const std::string& field_path, fossil_bluecrab_noshell_index_kind_t kind) {
+                return fossil_bluecrab_noshell_create_index(file_name.c_str(), field_path.c_str(), kind);
+            }
+
+            /**
+             * @brief Drops the index on a document field.
+             * @param file_name The database file name.
+             * @param field_path Indexed field.
+             * @return Error code indicating success or failure.
+             */
+            static fossil_bluecrab_noshell_error_t drop_index(const std::string& file_name, const std::string& field_path) {
+                return fossil_bluecrab_noshell_drop_index(file_name.c_str(), field_path.c_str());
+            }
+
+            /**
+             * @brief Finds a document by its ID.
+             * @param file_name The database file name.
+             * @param id Document ID.
+             * @param result Output string for the found document.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t find_by_id(const std::string& file_name, const std::string& id, std::string& result) {
+                char buffer[1024] = {0};
+                fossil_bluecrab_noshell_error_t err = fossil_bluecrab_noshell_find_by_id(file_name.c_str(), id.c_str(), buffer, sizeof(buffer));
+                if (err == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+                    result = buffer;
+                }
+                return err;
+            }
+
             /**
              * @brief Updates a document in the database based on a query string.
              * @param file_name The database file name.
@@ -464,6 +1120,15 @@ namespace fossil {
                 return fossil_bluecrab_noshell_remove(file_name.c_str(), query.c_str());
             }
 
+            /**
+             * @brief Rewrites the database without removed and superseded documents.
+             * @param file_name The database file name.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t compact(const std::string& file_name) {
+                return fossil_bluecrab_noshell_compact(file_name.c_str());
+            }
+
             /**
              * @brief Creates a new database file.
              * @param file_name The database file name (.crabdb enforced).
@@ -491,6 +1156,69 @@ namespace fossil {
                 return fossil_bluecrab_noshell_delete_database(file_name.c_str());
             }
 
+            /**
+             * @brief Sets the durability policy for a database file.
+             * @param file_name The database file name.
+             * @param mode Durability mode.
+             * @param interval_ms Sync interval for PERIODIC.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t set_durability(const std::string& file_name, fossil_bluecrab_noshell_durability_t mode, unsigned interval_ms = 0) {
+                return fossil_bluecrab_noshell_set_durability(file_name.c_str(), mode, interval_ms);
+            }
+
+            /**
+             * @brief Gets the durability policy for a database file.
+             * @param file_name The database file name.
+             * @return The configured durability mode.
+             */
+            static fossil_bluecrab_noshell_durability_t get_durability(const std::string& file_name) {
+                return fossil_bluecrab_noshell_get_durability(file_name.c_str());
+            }
+
+            /**
+             * @brief Queues a find; the callback runs from async_poll/async_wait.
+             * @param file_name The database file name.
+             * @param query Query string.
+             * @param type_id Optional FSON type filter ("" for none).
+             * @param cb Completion callback.
+             * @param user User data pointer.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS if queued, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t submit_find(const std::string& file_name, const std::string& query, const std::string& type_id, fossil_bluecrab_noshell_async_cb cb, void* user) {
+                return fossil_bluecrab_noshell_submit_find(file_name.c_str(), query.c_str(), type_id.empty() ? nullptr : type_id.c_str(), cb, user);
+            }
+
+            /**
+             * @brief Queues an insert; the callback receives the new document ID.
+             * @param file_name The database file name.
+             * @param document FSON document.
+             * @param param_list Optional parameter list ("" for none).
+             * @param type FSON type name.
+             * @param cb Completion callback.
+             * @param user User data pointer.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS if queued, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t submit_insert(const std::string& file_name, const std::string& document, const std::string& param_list, const std::string& type, fossil_bluecrab_noshell_async_cb cb, void* user) {
+                return fossil_bluecrab_noshell_submit_insert(file_name.c_str(), document.c_str(), param_list.empty() ? nullptr : param_list.c_str(), type.c_str(), cb, user);
+            }
+
+            /**
+             * @brief Runs callbacks for completed requests without blocking.
+             * @return Number of callbacks invoked.
+             */
+            static size_t async_poll() {
+                return fossil_bluecrab_noshell_async_poll();
+            }
+
+            /**
+             * @brief Waits for all outstanding requests and runs their callbacks.
+             * @return Number of callbacks invoked.
+             */
+            static size_t async_wait() {
+                return fossil_bluecrab_noshell_async_wait();
+            }
+
             /**
              * @brief Locks the database file for exclusive access.
              * @param file_name The database file name.
@@ -547,6 +1275,96 @@ namespace fossil {
                 return fossil_bluecrab_noshell_verify_database(file_name.c_str());
             }
 
+            /**
+             * @brief Writes a binary FSON-B image of a database file.
+             * @param file_name The database file name.
+             * @param binary_file The image file path.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t export_binary(const std::string& file_name, const std::string& binary_file) {
+                return fossil_bluecrab_noshell_export_binary(file_name.c_str(), binary_file.c_str());
+            }
+
+            /**
+             * @brief Writes a database file back from an FSON-B image.
+             * @param binary_file The image file path.
+             * @param file_name The database file to (over)write.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t import_binary(const std::string& binary_file, const std::string& file_name) {
+                return fossil_bluecrab_noshell_import_binary(binary_file.c_str(), file_name.c_str());
+            }
+
+            /**
+             * @brief Scans an FSON-B image; see fossil_bluecrab_noshell_binary_find_cb.
+             */
+            static fossil_bluecrab_noshell_error_t binary_find_cb(const std::string& binary_file, const std::string& query, bool (*cb)(const char* document, void* userdata), void* userdata) {
+                return fossil_bluecrab_noshell_binary_find_cb(binary_file.c_str(), query.c_str(), cb, userdata);
+            }
+
+            /**
+             * @brief Reads one field of a document in an FSON-B image.
+             * @param binary_file The image file path.
+             * @param id Document id.
+             * @param field Field name, dotted for nested objects.
+             * @param value Output string.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t binary_get_field(const std::string& binary_file, const std::string& id, const std::string& field, std::string& value) {
+                char buffer[1024] = {0};
+                fossil_bluecrab_noshell_error_t rc = fossil_bluecrab_noshell_binary_get_field(binary_file.c_str(), id.c_str(), field.c_str(), buffer, sizeof(buffer));
+                if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+                    value = buffer;
+                return rc;
+            }
+
+            /**
+             * @brief Switches a database file to the LSM engine.
+             * @param file_name The database file name.
+             * @param options Tuning, or nullptr for the defaults.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t lsm_enable(const std::string& file_name, const fossil_bluecrab_noshell_lsm_options_t* options = nullptr) {
+                return fossil_bluecrab_noshell_lsm_enable(file_name.c_str(), options);
+            }
+
+            /**
+             * @brief Writes an LSM database back as a plain text file.
+             * @param file_name The database file name.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t lsm_disable(const std::string& file_name) {
+                return fossil_bluecrab_noshell_lsm_disable(file_name.c_str());
+            }
+
+            /**
+             * @brief Writes the memtable of an LSM database out as a segment.
+             * @param file_name The database file name.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t lsm_flush(const std::string& file_name) {
+                return fossil_bluecrab_noshell_lsm_flush(file_name.c_str());
+            }
+
+            /**
+             * @brief Reports memtable, level and activity counts of an LSM database.
+             * @param file_name The database file name.
+             * @param info Reference to the counts to fill.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t lsm_info(const std::string& file_name, fossil_bluecrab_noshell_lsm_info_t& info) {
+                return fossil_bluecrab_noshell_lsm_info(file_name.c_str(), &info);
+            }
+
+            /**
+             * @brief Closes the engine of an LSM database in this process.
+             * @param file_name The database file name.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t lsm_close(const std::string& file_name) {
+                return fossil_bluecrab_noshell_lsm_close(file_name.c_str());
+            }
+
             /**
              * @brief Gets the first document ID in the database.
              * @param file_name The database file name.
@@ -588,6 +1406,16 @@ namespace fossil {
                 return fossil_bluecrab_noshell_count_documents(file_name.c_str(), &count);
             }
 
+            /**
+             * @brief Reads document, byte and per-type counts of a database file.
+             * @param file_name The database file name.
+             * @param stats Reference to the statistics to fill.
+             * @return FOSSIL_NOSHELL_ERROR_SUCCESS on success, otherwise error code.
+             */
+            static fossil_bluecrab_noshell_error_t stats(const std::string& file_name, fossil_bluecrab_noshell_stats_t& stats) {
+                return fossil_bluecrab_noshell_stats(file_name.c_str(), &stats);
+            }
+
             /**
              * @brief Gets the size of the database file in bytes.
              * @param file_name The database file name.
@@ -615,6 +1443,245 @@ namespace fossil {
             static bool validate_document(const std::string& document) {
                 return fossil_bluecrab_noshell_validate_document(document.c_str());
             }
+
+            /**
+             * @brief RAII handle on an open database file.
+             *
+             * Wraps fossil_bluecrab_noshell_open/close; the document methods
+             * mirror the static ones without the file name argument.
+             */
+            class Handle {
+            public:
+                Handle(const std::string& file_name, fossil_bluecrab_noshell_error_t& err)
+                    : db_(fossil_bluecrab_noshell_open(file_name.c_str(), &err)) {}
+                ~Handle() { close(); }
+
+                Handle(const Handle&) = delete;
+                Handle& operator=(const Handle&) = delete;
+                Handle(Handle&& other) noexcept : db_(other.db_) { other.db_ = nullptr; }
+                Handle& operator=(Handle&& other) noexcept {
+                    if (this != &other) {
+                        close();
+                        db_ = other.db_;
+                        other.db_ = nullptr;
+                    }
+                    return *this;
+                }
+
+                /**
+                 * @brief Releases the handle early.
+                 */
+                void close() {
+                    if (db_) {
+                        fossil_bluecrab_noshell_close(db_);
+                        db_ = nullptr;
+                    }
+                }
+
+                bool is_open() const { return db_ != nullptr; }
+                fossil_bluecrab_noshell_t* get() const { return db_; }
+
+                fossil_bluecrab_noshell_error_t insert(const std::string& document, const std::string& param_list = "", const std::string& type = "") {
+                    const char* param = param_list.empty() ? nullptr : param_list.c_str();
+                    const char* type_str = type.empty() ? nullptr : type.c_str();
+                    return fossil_bluecrab_noshell_handle_insert(db_, document.c_str(), param, type_str);
+                }
+
+                fossil_bluecrab_noshell_error_t insert_with_id(const std::string& document, const std::string& param_list, const std::string& type, std::string& out_id) {
+                    char id_buf[64] = {0};
+                    const char* param = param_list.empty() ? nullptr : param_list.c_str();
+                    const char* type_str = type.empty() ? nullptr : type.c_str();
+                    fossil_bluecrab_noshell_error_t err = fossil_bluecrab_noshell_handle_insert_with_id(db_, document.c_str(), param, type_str, id_buf, sizeof(id_buf));
+                    if (err == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+                        out_id = id_buf;
+                    }
+                    return err;
+                }
+
+                /**
+                 * @brief Appends all documents with a single write; see fossil_bluecrab_noshell_handle_insert_many.
+                 * @param out_ids If given, receives the id of each document, in order.
+                 */
+                fossil_bluecrab_noshell_error_t insert_many(std::span<const std::string> documents, const std::string& param_list, const std::string& type, std::vector<std::string>* out_ids = nullptr) {
+                    std::vector<const char*> docs;
+                    docs.reserve(documents.size());
+                    for (const auto& document : documents) {
+                        docs.push_back(document.c_str());
+                    }
+                    std::vector<char> ids(out_ids ? documents.size() * 17 : 0);
+                    const char* param = param_list.empty() ? nullptr : param_list.c_str();
+                    const char* type_str = type.empty() ? nullptr : type.c_str();
+                    fossil_bluecrab_noshell_error_t err = fossil_bluecrab_noshell_handle_insert_many(
+                        db_, docs.data(), docs.size(), param, type_str,
+                        out_ids ? reinterpret_cast<char (*)[17]>(ids.data()) : nullptr);
+                    if (err == FOSSIL_NOSHELL_ERROR_SUCCESS && out_ids) {
+                        out_ids->clear();
+                        for (size_t i = 0; i < documents.size(); ++i) {
+                            out_ids->emplace_back(&ids[i * 17]);
+                        }
+                    }
+                    return err;
+                }
+
+                fossil_bluecrab_noshell_error_t find(const std::string& query, std::string& result, const std::string& type_id = "") {
+                    char buffer[1024] = {0};
+                    const char* type_str = type_id.empty() ? nullptr : type_id.c_str();
+                    fossil_bluecrab_noshell_error_t err = fossil_bluecrab_noshell_handle_find(db_, query.c_str(), buffer, sizeof(buffer), type_str);
+                    if (err == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+                        result = buffer;
+                    }
+                    return err;
+                }
+
+                fossil_bluecrab_noshell_error_t find_by_id(const std::string& id, std::string& result) {
+                    char buffer[1024] = {0};
+                    fossil_bluecrab_noshell_error_t err = fossil_bluecrab_noshell_handle_find_by_id(db_, id.c_str(), buffer, sizeof(buffer));
+                    if (err == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+                        result = buffer;
+                    }
+                    return err;
+                }
+
+                fossil_bluecrab_noshell_error_t find_cb(bool (*cb)(const char* document, void* userdata), void* userdata) {
+                    return fossil_bluecrab_noshell_handle_find_cb(db_, cb, userdata);
+                }
+
+                fossil_bluecrab_noshell_error_t update(const std::string& query, const std::string& new_document, const std::string& param_list = "", const std::string& type_id = "") {
+                    const char* param = param_list.empty() ? nullptr : param_list.c_str();
+                    const char* type_str = type_id.empty() ? nullptr : type_id.c_str();
+                    return fossil_bluecrab_noshell_handle_update(db_, query.c_str(), new_document.c_str(), param, type_str);
+                }
+
+                fossil_bluecrab_noshell_error_t remove(const std::string& query) {
+                    return fossil_bluecrab_noshell_handle_remove(db_, query.c_str());
+                }
+
+                fossil_bluecrab_noshell_error_t first_document(std::string& id) {
+                    char id_buf[64] = {0};
+                    fossil_bluecrab_noshell_error_t err = fossil_bluecrab_noshell_handle_first_document(db_, id_buf, sizeof(id_buf));
+                    if (err == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+                        id = id_buf;
+                    }
+                    return err;
+                }
+
+                fossil_bluecrab_noshell_error_t next_document(const std::string& prev_id, std::string& id) {
+                    char id_buf[64] = {0};
+                    fossil_bluecrab_noshell_error_t err = fossil_bluecrab_noshell_handle_next_document(db_, prev_id.c_str(), id_buf, sizeof(id_buf));
+                    if (err == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+                        id = id_buf;
+                    }
+                    return err;
+                }
+
+                fossil_bluecrab_noshell_error_t count_documents(size_t& count) {
+                    return fossil_bluecrab_noshell_handle_count_documents(db_, &count);
+                }
+
+            private:
+                fossil_bluecrab_noshell_t* db_;
+            };
+
+            /**
+             * @brief RAII wrapper around a compiled structured query.
+             */
+            class Query {
+            public:
+                Query(const std::string& expr, fossil_bluecrab_noshell_error_t& err)
+                    : q_(fossil_bluecrab_noshell_query_compile(expr.c_str(), &err)) {}
+
+                ~Query() {
+                    fossil_bluecrab_noshell_query_free(q_);
+                }
+
+                Query(const Query&) = delete;
+                Query& operator=(const Query&) = delete;
+
+                bool is_valid() const { return q_ != nullptr; }
+
+                bool matches(const std::string& document) const {
+                    return fossil_bluecrab_noshell_query_match(q_, document.c_str());
+                }
+
+            private:
+                fossil_bluecrab_noshell_query_t* q_;
+            };
+
+            /**
+             * @brief One document from a Cursor; views are valid until the
+             * cursor's next call.
+             */
+            struct Entry {
+                std::string_view document;
+                std::string_view type;
+                std::string_view id;
+            };
+
+            /**
+             * @brief RAII wrapper around a forward document cursor.
+             */
+            class Cursor {
+            public:
+                Cursor(const std::string& file_name, fossil_bluecrab_noshell_error_t& err, const std::string& type_id = "")
+                    : cur_(fossil_bluecrab_noshell_cursor_open(file_name.c_str(), type_id.empty() ? nullptr : type_id.c_str(), &err)) {}
+
+                ~Cursor() {
+                    fossil_bluecrab_noshell_cursor_close(cur_);
+                }
+
+                Cursor(const Cursor&) = delete;
+                Cursor& operator=(const Cursor&) = delete;
+
+                Cursor(Cursor&& other) noexcept : cur_(other.cur_) {
+                    other.cur_ = nullptr;
+                }
+
+                Cursor& operator=(Cursor&& other) noexcept {
+                    if (this != &other) {
+                        fossil_bluecrab_noshell_cursor_close(cur_);
+                        cur_ = other.cur_;
+                        other.cur_ = nullptr;
+                    }
+                    return *this;
+                }
+
+                bool is_open() const { return cur_ != nullptr; }
+
+                fossil_bluecrab_noshell_error_t next(Entry& entry) {
+                    fossil_bluecrab_noshell_entry_t raw;
+                    fossil_bluecrab_noshell_error_t err = fossil_bluecrab_noshell_cursor_next(cur_, &raw);
+                    if (err == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+                        entry = to_entry(raw);
+                    }
+                    return err;
+                }
+
+                fossil_bluecrab_noshell_error_t next_batch(std::vector<Entry>& entries, size_t max_entries) {
+                    entries.clear();
+                    if (max_entries == 0) {
+                        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+                    }
+                    raw_.resize(max_entries);
+                    size_t fetched = 0;
+                    fossil_bluecrab_noshell_error_t err = fossil_bluecrab_noshell_cursor_next_batch(cur_, raw_.data(), max_entries, &fetched);
+                    for (size_t i = 0; i < fetched; ++i) {
+                        entries.push_back(to_entry(raw_[i]));
+                    }
+                    return err;
+                }
+
+            private:
+                static Entry to_entry(const fossil_bluecrab_noshell_entry_t& raw) {
+                    return Entry{
+                        std::string_view(raw.document.data, raw.document.length),
+                        std::string_view(raw.type.data, raw.type.length),
+                        std::string_view(raw.id.data, raw.id.length)
+                    };
+                }
+
+                fossil_bluecrab_noshell_cursor_t* cur_;
+                std::vector<fossil_bluecrab_noshell_entry_t> raw_;
+            };
         };
 
     } // namespace bluecrab
@@ -0,0 +1,181 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#ifndef FOSSIL_CRABDB_QUERY_H
+#define FOSSIL_CRABDB_QUERY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ===========================================================
+// Query Lexer and WHERE Parser
+// ===========================================================
+
+/*
+ * The WHERE grammar shared by MyShell and NoShell:
+ *
+ *   or_expr   := and_expr (OR and_expr)*
+ *   and_expr  := unary (AND unary)*
+ *   unary     := NOT unary | '(' or_expr ')' | field op literal
+ *   op        := = | != | <> | < | <= | > | >= | LIKE
+ *   literal   := 'text' | "text" | number | bareword
+ *
+ * Keywords are case-insensitive; a quote inside a quoted literal is written
+ * twice. What a field is (a fixed column, a dotted document path) is up to
+ * each shell, which parses it with a callback, as are the identifier
+ * characters and symbols its lexer accepts.
+ */
+
+typedef enum {
+    FOSSIL_QUERY_TOK_END,
+    FOSSIL_QUERY_TOK_IDENT,
+    FOSSIL_QUERY_TOK_STRING,
+    FOSSIL_QUERY_TOK_NUMBER,
+    FOSSIL_QUERY_TOK_SYMBOL,
+    FOSSIL_QUERY_TOK_ERROR
+} fossil_bluecrab_query_tok_t;
+
+typedef enum {
+    FOSSIL_QUERY_CMP_EQ,
+    FOSSIL_QUERY_CMP_NE,
+    FOSSIL_QUERY_CMP_LT,
+    FOSSIL_QUERY_CMP_LE,
+    FOSSIL_QUERY_CMP_GT,
+    FOSSIL_QUERY_CMP_GE,
+    FOSSIL_QUERY_CMP_LIKE
+} fossil_bluecrab_query_cmp_t;
+
+typedef enum {
+    FOSSIL_QUERY_PRED_CMP,
+    FOSSIL_QUERY_PRED_AND,
+    FOSSIL_QUERY_PRED_OR,
+    FOSSIL_QUERY_PRED_NOT
+} fossil_bluecrab_query_pred_kind_t;
+
+/**
+ * @brief What a shell's lexer accepts beyond the common tokens.
+ */
+typedef struct {
+    const char *ident_chars;          /**< Characters allowed in identifiers besides letters, digits and '_' ("" for none). */
+    const char *symbols;              /**< One-character symbols; "!=", "<>", "<=" and ">=" are always recognised. */
+} fossil_bluecrab_query_syntax_t;
+
+typedef struct {
+    const fossil_bluecrab_query_syntax_t *syntax;
+    const char *cur;                  /**< Next unread character. */
+    fossil_bluecrab_query_tok_t kind; /**< Current token. */
+    const char *start;
+    size_t len;
+    bool oom;                         /**< Set when an allocation failed while parsing. */
+} fossil_bluecrab_query_lexer_t;
+
+typedef struct fossil_bluecrab_query_pred_t {
+    fossil_bluecrab_query_pred_kind_t kind;
+    int column;                       /**< CMP: a shell's fixed column, when it has them. */
+    char *field;                      /**< CMP: a shell's field name, when it has them (freed with the tree). */
+    fossil_bluecrab_query_cmp_t op;
+    char *literal;                    /**< Quotes stripped. */
+    bool numeric;                     /**< Literal was a number token. */
+    bool integral;                    /**< ... and an integer. */
+    long long ival;
+    double dval;
+    struct fossil_bluecrab_query_pred_t *left;   /**< AND/OR/NOT operand. */
+    struct fossil_bluecrab_query_pred_t *right;  /**< AND/OR operand. */
+} fossil_bluecrab_query_pred_t;
+
+/**
+ * @brief Parses the field of a comparison at the current token into pred.
+ *
+ * Consumes the field's tokens and returns true, or returns false on a syntax
+ * error (setting lx->oom when it was an allocation that failed).
+ */
+typedef bool (*fossil_bluecrab_query_field_fn)(fossil_bluecrab_query_lexer_t *lx, fossil_bluecrab_query_pred_t *pred);
+
+/**
+ * @brief Starts lexing text and reads the first token.
+ */
+void fossil_bluecrab_query_lex_init(fossil_bluecrab_query_lexer_t *lx, const char *text, const fossil_bluecrab_query_syntax_t *syntax);
+
+/**
+ * @brief Advances to the next token.
+ */
+void fossil_bluecrab_query_lex_next(fossil_bluecrab_query_lexer_t *lx);
+
+/**
+ * @brief True if the current token is the keyword or symbol word (case-insensitive).
+ */
+bool fossil_bluecrab_query_lex_is(const fossil_bluecrab_query_lexer_t *lx, const char *word);
+
+/**
+ * @brief Consumes the current token if it is word.
+ */
+bool fossil_bluecrab_query_lex_accept(fossil_bluecrab_query_lexer_t *lx, const char *word);
+
+/**
+ * @brief Parses or_expr at the current token.
+ *
+ * @param lx            Lexer positioned after WHERE.
+ * @param field         Parses the field of each comparison.
+ * @return              Predicate tree, or NULL on a syntax error or when out of memory (lx->oom).
+ */
+fossil_bluecrab_query_pred_t *fossil_bluecrab_query_parse_where(fossil_bluecrab_query_lexer_t *lx, fossil_bluecrab_query_field_fn field);
+
+/**
+ * @brief Frees a predicate tree (NULL is ignored).
+ */
+void fossil_bluecrab_query_pred_free(fossil_bluecrab_query_pred_t *pred);
+
+/**
+ * @brief Parses a complete number (surrounding blanks allowed), preferring an exact integer.
+ */
+bool fossil_bluecrab_query_parse_number(const char *s, bool *integral, long long *ival, double *dval);
+
+/**
+ * @brief Matches len bytes of s against a LIKE pattern ('%' any run, '_' any byte).
+ */
+bool fossil_bluecrab_query_like(const char *s, size_t len, const char *pattern);
+
+/**
+ * @brief Applies a comparison predicate to a field value.
+ *
+ * Numeric literals compare numerically against values that are numbers;
+ * a value that is not a number fails every ordering against one. Other
+ * literals compare bytewise.
+ *
+ * @param pred          FOSSIL_QUERY_PRED_CMP node.
+ * @param value         Field value, quotes already stripped.
+ * @param len           Value length.
+ * @return              Whether the comparison holds.
+ */
+bool fossil_bluecrab_query_compare(const fossil_bluecrab_query_pred_t *pred, const char *value, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FOSSIL_CRABDB_QUERY_H */
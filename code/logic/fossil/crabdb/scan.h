@@ -0,0 +1,144 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#ifndef FOSSIL_CRABDB_SCAN_H
+#define FOSSIL_CRABDB_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ===========================================================
+// Line and Field Scanning
+// ===========================================================
+
+/**
+ * @brief Finds the first occurrence of a byte in a range.
+ *
+ * Compares 16 or 32 bytes per step with SSE2, AVX2 or NEON when available.
+ *
+ * @param data          Bytes to search (may be NULL when len is 0).
+ * @param len           Number of bytes.
+ * @param c             Byte to find.
+ * @return              Pointer to the first match, or NULL.
+ */
+const char *fossil_bluecrab_scan_byte(const char *data, size_t len, char c);
+
+/**
+ * @brief Finds the first newline in a range; fossil_bluecrab_scan_byte with '\n'.
+ */
+const char *fossil_bluecrab_scan_newline(const char *data, size_t len);
+
+/**
+ * @brief Finds the first occurrence of a short needle (such as a "#id=" tag) in a range.
+ *
+ * Candidate positions are those where the needle's first two bytes match,
+ * tested a whole vector at a time; only candidates are compared in full.
+ *
+ * @param data          Bytes to search (may be NULL when len is 0).
+ * @param len           Number of bytes.
+ * @param needle        Bytes to find.
+ * @param needle_len    Needle length (0 matches at data).
+ * @return              Pointer to the first match, or NULL.
+ */
+const char *fossil_bluecrab_scan_find(const char *data, size_t len, const char *needle, size_t needle_len);
+
+/**
+ * @brief Parses up to 16 leading hex digits (either case) as a 64-bit value.
+ *
+ * Sixteen digits, the width of every hash and id the shells write, are
+ * decoded in one vector step; shorter runs fall back to a scalar loop.
+ * Reads at most len bytes.
+ *
+ * @param text          Text starting with the digits.
+ * @param len           Bytes readable at text.
+ * @param out           Receives the value (0 when no digits).
+ * @return              Number of digits consumed (0 to 16).
+ */
+size_t fossil_bluecrab_scan_hex64(const char *text, size_t len, uint64_t *out);
+
+/**
+ * @brief Returns the name of the byte-compare kernel in use ("avx2", "sse2", "neon" or "scalar").
+ */
+const char *fossil_bluecrab_scan_backend(void);
+
+#ifdef __cplusplus
+}
+#include <string>
+#include <string_view>
+
+namespace fossil {
+
+    namespace bluecrab {
+
+        /**
+         * @brief Static C++ wrappers around the scanning module.
+         */
+        class Scan {
+        public:
+            /**
+             * @brief Position of the first c in text, or std::string_view::npos.
+             */
+            static size_t find_byte(std::string_view text, char c) {
+                const char* hit = fossil_bluecrab_scan_byte(text.data(), text.size(), c);
+                return hit ? static_cast<size_t>(hit - text.data()) : std::string_view::npos;
+            }
+
+            /**
+             * @brief Position of the first needle in text, or std::string_view::npos.
+             */
+            static size_t find(std::string_view text, std::string_view needle) {
+                const char* hit = fossil_bluecrab_scan_find(text.data(), text.size(), needle.data(), needle.size());
+                return hit ? static_cast<size_t>(hit - text.data()) : std::string_view::npos;
+            }
+
+            /**
+             * @brief Parses up to 16 leading hex digits.
+             * @param text Text starting with the digits.
+             * @param out  Receives the value.
+             * @return Number of digits consumed.
+             */
+            static size_t hex64(std::string_view text, uint64_t& out) {
+                return fossil_bluecrab_scan_hex64(text.data(), text.size(), &out);
+            }
+
+            /**
+             * @brief Name of the byte-compare kernel in use.
+             */
+            static std::string backend() {
+                return fossil_bluecrab_scan_backend();
+            }
+        };
+
+    } // namespace bluecrab
+
+} // namespace fossil
+
+#endif
+
+#endif /* FOSSIL_CRABDB_SCAN_H */
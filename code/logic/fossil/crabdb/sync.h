@@ -0,0 +1,108 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#ifndef FOSSIL_CRABDB_SYNC_H
+#define FOSSIL_CRABDB_SYNC_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ===========================================================
+// Durability Helpers
+// ===========================================================
+
+/*
+ * One sync policy for every shell: a sync forces a file's data, and the
+ * metadata needed to read it back (its size), to stable storage. That is
+ * fdatasync where the platform has it, fsync elsewhere, _commit or
+ * FlushFileBuffers on Windows. Timestamps are not worth a second journal
+ * write to either shell.
+ */
+
+/**
+ * @brief Flushes fp's stdio buffer and syncs the file.
+ *
+ * @return              0 on success, -1 on failure.
+ */
+int fossil_bluecrab_sync_file(FILE *fp);
+
+/**
+ * @brief Syncs the file at path through a descriptor of its own (ignored if it cannot be opened).
+ */
+void fossil_bluecrab_sync_path(const char *path);
+
+/**
+ * @brief Makes a rename into path durable by syncing its parent directory.
+ *
+ * A no-op on Windows, where MOVEFILE_WRITE_THROUGH covers the rename.
+ *
+ * @return              0 on success, -1 when the directory could not be opened or synced.
+ */
+int fossil_bluecrab_sync_parent_dir(const char *path);
+
+/**
+ * @brief Background syncer behind the PERIODIC durability modes.
+ *
+ * Every interval_ms the worker syncs the file by path if a write was marked
+ * since its last pass. Syncing through its own descriptor means it never
+ * races with the writer reopening or replacing its stream.
+ */
+typedef struct {
+    char    *path;
+    unsigned interval_ms;
+    bool     dirty;
+    bool     stop;
+    fossil_bluecrab_thread_mutex_t mutex;
+    fossil_bluecrab_thread_cond_t  cond;
+    fossil_bluecrab_thread_t       thread;
+} fossil_bluecrab_sync_worker_t;
+
+/**
+ * @brief Starts a periodic syncer for path.
+ *
+ * @return              The worker, or NULL when out of memory or the thread could not start.
+ */
+fossil_bluecrab_sync_worker_t *fossil_bluecrab_sync_worker_start(const char *path, unsigned interval_ms);
+
+/**
+ * @brief Notes a write for the next pass.
+ */
+void fossil_bluecrab_sync_worker_mark(fossil_bluecrab_sync_worker_t *w);
+
+/**
+ * @brief Stops the worker, syncs a pending write one last time and frees it (NULL is ignored).
+ */
+void fossil_bluecrab_sync_worker_stop(fossil_bluecrab_sync_worker_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FOSSIL_CRABDB_SYNC_H */
@@ -0,0 +1,166 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#ifndef FOSSIL_CRABDB_THREAD_H
+#define FOSSIL_CRABDB_THREAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ===========================================================
+// Threads, Mutexes and Condition Variables
+// ===========================================================
+
+/*
+ * Thin wrappers over Win32 critical sections, condition variables and
+ * threads, or their pthread counterparts, shared by the shells' background
+ * workers (durability, asynchronous writes, compaction) and their
+ * parallel scans.
+ *
+ * A thread function is declared with FOSSIL_THREAD_FN(name), takes
+ * `void *arg` and ends with FOSSIL_THREAD_RETURN.
+ */
+
+#if defined(_WIN32) || defined(_WIN64)
+typedef CRITICAL_SECTION   fossil_bluecrab_thread_mutex_t;
+typedef CONDITION_VARIABLE fossil_bluecrab_thread_cond_t;
+typedef HANDLE             fossil_bluecrab_thread_t;
+typedef DWORD              fossil_bluecrab_thread_id_t;
+typedef LPTHREAD_START_ROUTINE fossil_bluecrab_thread_fn;
+#define FOSSIL_THREAD_FN(name) static DWORD WINAPI name(LPVOID arg)
+#define FOSSIL_THREAD_RETURN   return 0
+#else
+typedef pthread_mutex_t fossil_bluecrab_thread_mutex_t;
+typedef pthread_cond_t  fossil_bluecrab_thread_cond_t;
+typedef pthread_t       fossil_bluecrab_thread_t;
+typedef pthread_t       fossil_bluecrab_thread_id_t;
+typedef void *(*fossil_bluecrab_thread_fn)(void *);
+#define FOSSIL_THREAD_FN(name) static void *name(void *arg)
+#define FOSSIL_THREAD_RETURN   return NULL
+#endif
+
+void fossil_bluecrab_thread_mutex_init(fossil_bluecrab_thread_mutex_t *m);
+void fossil_bluecrab_thread_mutex_destroy(fossil_bluecrab_thread_mutex_t *m);
+void fossil_bluecrab_thread_mutex_lock(fossil_bluecrab_thread_mutex_t *m);
+void fossil_bluecrab_thread_mutex_unlock(fossil_bluecrab_thread_mutex_t *m);
+
+void fossil_bluecrab_thread_cond_init(fossil_bluecrab_thread_cond_t *c);
+void fossil_bluecrab_thread_cond_destroy(fossil_bluecrab_thread_cond_t *c);
+void fossil_bluecrab_thread_cond_broadcast(fossil_bluecrab_thread_cond_t *c);
+void fossil_bluecrab_thread_cond_signal(fossil_bluecrab_thread_cond_t *c);
+void fossil_bluecrab_thread_cond_wait(fossil_bluecrab_thread_cond_t *c, fossil_bluecrab_thread_mutex_t *m);
+
+/**
+ * @brief Waits on c for at most ms milliseconds (spurious and early wakeups allowed).
+ */
+void fossil_bluecrab_thread_cond_timedwait(fossil_bluecrab_thread_cond_t *c, fossil_bluecrab_thread_mutex_t *m, unsigned ms);
+
+/**
+ * @brief Starts fn(arg) on a new thread.
+ *
+ * @return              True if the thread is running; it must be joined.
+ */
+bool fossil_bluecrab_thread_start(fossil_bluecrab_thread_t *t, fossil_bluecrab_thread_fn fn, void *arg);
+
+/**
+ * @brief Waits for a started thread to finish and releases it.
+ */
+void fossil_bluecrab_thread_join(fossil_bluecrab_thread_t t);
+
+/**
+ * @brief Lets a started thread release itself when it ends; it must not be joined.
+ */
+void fossil_bluecrab_thread_detach(fossil_bluecrab_thread_t t);
+
+/**
+ * @brief Identifies the calling thread.
+ */
+fossil_bluecrab_thread_id_t fossil_bluecrab_thread_self(void);
+
+/**
+ * @brief True if id is the calling thread's.
+ */
+bool fossil_bluecrab_thread_is_self(fossil_bluecrab_thread_id_t id);
+
+/**
+ * @brief Number of processors online, at least 1.
+ */
+size_t fossil_bluecrab_thread_cpu_count(void);
+
+/**
+ * @brief Atomically adds one to *counter.
+ *
+ * @return              The value before the increment.
+ */
+size_t fossil_bluecrab_thread_fetch_inc(volatile size_t *counter);
+
+// ===========================================================
+// Shared Worker Pool
+// ===========================================================
+
+/*
+ * One process-wide pool runs the shells' asynchronous requests. Workers
+ * start as tasks arrive, up to one per processor and at most
+ * FOSSIL_BLUECRAB_POOL_MAX, and exit once they find no work after
+ * FOSSIL_BLUECRAB_POOL_IDLE_MS, so an idle process keeps no threads.
+ * Tasks start in submission order but run concurrently; a caller that
+ * needs ordering queues its own work and submits one task at a time.
+ */
+
+#define FOSSIL_BLUECRAB_POOL_MAX     16
+#define FOSSIL_BLUECRAB_POOL_IDLE_MS 1000
+
+typedef void (*fossil_bluecrab_task_fn)(void *arg);
+
+/**
+ * @brief Queues fn(arg) on the shared pool.
+ *
+ * @return              False if the task could not be queued (out of
+ *                      memory, or no worker could be started).
+ */
+bool fossil_bluecrab_pool_submit(fossil_bluecrab_task_fn fn, void *arg);
+
+/**
+ * @brief Waits until every queued task has run and every worker has exited.
+ *
+ * Tasks submitted meanwhile are run too; the pool starts again on the next
+ * submission.
+ */
+void fossil_bluecrab_pool_quiesce(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FOSSIL_CRABDB_THREAD_H */
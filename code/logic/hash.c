@@ -0,0 +1,441 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include "fossil/crabdb/hash.h"
+
+/**
+ * @brief Shared 64-bit hashing for the BlueCrab shells.
+ *
+ * Two families live here:
+ *
+ *   Legacy (fossil_bluecrab_hash64_legacy):
+ *     MurmurHash64A-style, 8-byte stride, fixed seed. This is the value
+ *     written to disk as MyShell "#hash=" / commit hashes and NoShell
+ *     document IDs, so it must never change.
+ *
+ *   Fast (fossil_bluecrab_hash64):
+ *     For in-memory tables only.
+ *       len <= 256 : wyhash-style 64x64->128 multiply-fold, three
+ *                    independent lanes over 48-byte chunks.
+ *       len  > 256 : xxh3-style accumulator. Eight 64-bit lanes absorb
+ *                    64-byte stripes:
+ *
+ *                      dk        = data[i] ^ secret[s + i]
+ *                      acc[i]   += lo32(dk) * hi32(dk)
+ *                      acc[i^1] += data[i]
+ *
+ *                    Every 16 stripes (1 KiB) the lanes are scrambled;
+ *                    the final (possibly overlapping) stripe is absorbed
+ *                    and the lanes are folded into one 64-bit result.
+ *
+ *     The stripe kernel maps directly onto 32x32->64 vector multiplies:
+ *     _mm_mul_epu32 (SSE2), _mm256_mul_epu32 (AVX2) or vmlal_u32 (NEON).
+ *     AVX2 is picked at load time on GCC/Clang x86 builds. All kernels
+ *     and the scalar reference produce identical values; inputs are read
+ *     little-endian so results also match across platforms.
+ *
+ *     Define FOSSIL_BLUECRAB_HASH_SCALAR to build without vector kernels.
+ */
+
+#if !defined(FOSSIL_BLUECRAB_HASH_SCALAR) && \
+    (!defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#if !defined(__AVX2__) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define FOSSIL_HASH_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define FOSSIL_HASH_HAVE_AVX2 1
+#include <immintrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define FOSSIL_HASH_HAVE_AVX2 1
+#define FOSSIL_HASH_AVX2_RUNTIME 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define FOSSIL_HASH_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64) && !defined(__SIZEOF_INT128__)
+#include <intrin.h>
+#pragma intrinsic(_umul128)
+#endif
+
+#define HASH_SHORT_MAX        256
+#define HASH_STRIPE_LEN       64
+#define HASH_STRIPES_PER_BLOCK 16
+#define HASH_BLOCK_LEN        (HASH_STRIPE_LEN * HASH_STRIPES_PER_BLOCK)
+#define HASH_SCRAMBLE_KEY     16
+#define HASH_LAST_STRIPE_KEY  13
+
+#define HASH_P32_1 0x9E3779B1ULL
+#define HASH_P32_2 0x85EBCA77ULL
+#define HASH_P32_3 0xC2B2AE3DULL
+#define HASH_P64_1 0x9E3779B185EBCA87ULL
+#define HASH_P64_2 0xC2B2AE3D27D4EB4FULL
+#define HASH_P64_3 0x165667B19E3779F9ULL
+#define HASH_P64_4 0x85EBCA77C2B2AE63ULL
+#define HASH_P64_5 0x27D4EB2F165667C5ULL
+
+/** Key material: stripe s of a block uses entries [s, s + 8). */
+static const uint64_t hash_secret[24] = {
+    0x9d36b63b98532013ULL, 0xefc47c28ba2d69e1ULL, 0x127f732426d21935ULL, 0xee5fc7478cacc1a1ULL,
+    0x7518aa69da1b136fULL, 0xd4bf07e534ec8402ULL, 0xc20489dd9015e8e0ULL, 0x41eef98220f977d4ULL,
+    0xaa0e26968da5b33dULL, 0xc8599ff72cafacf2ULL, 0x60b6100d62d6bd88ULL, 0xff9b1ee636cd0d42ULL,
+    0x6fd4f8a0667421c7ULL, 0x8c21f6cc394cbe63ULL, 0x11d15a25ce2d7954ULL, 0x781c795506f6fe32ULL,
+    0x24c1943cbf79a7baULL, 0x35c603fce3be4966ULL, 0x8bbae169b0c27dc5ULL, 0x2252cfa787ec7535ULL,
+    0x0e23004c239e1aa7ULL, 0xf8c09afb9f5adeb7ULL, 0xf394efb4d32b8d16ULL, 0x8f0dbd1e6ac824fbULL,
+};
+
+typedef void (*hash_accumulate_fn)(uint64_t *acc, const uint8_t *p, size_t nstripes, const uint64_t *secret);
+
+// ===========================================================
+// Primitives
+// ===========================================================
+
+static inline uint64_t hash_read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint64_t hash_read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+/** 64x64 -> 128 multiply; low half into *a, high half into *b. */
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 hash_u128;
+#endif
+
+static inline void hash_mum(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+    hash_u128 r = (hash_u128)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+    hash_mum(&a, &b);
+    return a ^ b;
+}
+
+// ===========================================================
+// Short Inputs (<= 256 bytes)
+// ===========================================================
+
+static uint64_t hash_short(const uint8_t *p, size_t len, uint64_t seed) {
+    uint64_t a, b;
+    seed ^= hash_mix(seed ^ hash_secret[0], hash_secret[1]);
+    if (len <= 16) {
+        if (len >= 4) {
+            size_t shift = (len >> 3) << 2;
+            a = (hash_read32(p) << 32) | hash_read32(p + shift);
+            b = (hash_read32(p + len - 4) << 32) | hash_read32(p + len - 4 - shift);
+        } else if (len > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = hash_mix(hash_read64(p) ^ hash_secret[1], hash_read64(p + 8) ^ seed);
+                see1 = hash_mix(hash_read64(p + 16) ^ hash_secret[2], hash_read64(p + 24) ^ see1);
+                see2 = hash_mix(hash_read64(p + 32) ^ hash_secret[3], hash_read64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = hash_mix(hash_read64(p) ^ hash_secret[1], hash_read64(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = hash_read64(p + i - 16);
+        b = hash_read64(p + i - 8);
+    }
+    a ^= hash_secret[1];
+    b ^= seed;
+    hash_mum(&a, &b);
+    return hash_mix(a ^ hash_secret[0] ^ (uint64_t)len, b ^ hash_secret[1]);
+}
+
+// ===========================================================
+// Stripe Kernels (> 256 bytes)
+// ===========================================================
+
+static void hash_accumulate_scalar(uint64_t *acc, const uint8_t *p, size_t nstripes, const uint64_t *secret) {
+    for (size_t s = 0; s < nstripes; ++s) {
+        const uint8_t *in = p + s * HASH_STRIPE_LEN;
+        const uint64_t *key = secret + s;
+        for (size_t i = 0; i < 8; ++i) {
+            uint64_t v = hash_read64(in + i * 8);
+            uint64_t dk = v ^ key[i];
+            acc[i ^ 1] += v;
+            acc[i] += (dk & 0xFFFFFFFFULL) * (dk >> 32);
+        }
+    }
+}
+
+#ifdef FOSSIL_HASH_HAVE_SSE2
+static void hash_accumulate_sse2(uint64_t *acc, const uint8_t *p, size_t nstripes, const uint64_t *secret) {
+    __m128i a[4];
+    for (size_t i = 0; i < 4; ++i)
+        a[i] = _mm_loadu_si128((const __m128i *)(acc + i * 2));
+    for (size_t s = 0; s < nstripes; ++s) {
+        const uint8_t *in = p + s * HASH_STRIPE_LEN;
+        const uint64_t *key = secret + s;
+        for (size_t i = 0; i < 4; ++i) {
+            __m128i d  = _mm_loadu_si128((const __m128i *)(in + i * 16));
+            __m128i dk = _mm_xor_si128(d, _mm_loadu_si128((const __m128i *)(key + i * 2)));
+            __m128i hi = _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1));
+            __m128i product = _mm_mul_epu32(dk, hi);
+            __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+            a[i] = _mm_add_epi64(a[i], _mm_add_epi64(product, swapped));
+        }
+    }
+    for (size_t i = 0; i < 4; ++i)
+        _mm_storeu_si128((__m128i *)(acc + i * 2), a[i]);
+}
+#endif
+
+#ifdef FOSSIL_HASH_HAVE_AVX2
+#ifdef FOSSIL_HASH_AVX2_RUNTIME
+__attribute__((target("avx2")))
+#endif
+static void hash_accumulate_avx2(uint64_t *acc, const uint8_t *p, size_t nstripes, const uint64_t *secret) {
+    __m256i a0 = _mm256_loadu_si256((const __m256i *)acc);
+    __m256i a1 = _mm256_loadu_si256((const __m256i *)(acc + 4));
+    for (size_t s = 0; s < nstripes; ++s) {
+        const uint8_t *in = p + s * HASH_STRIPE_LEN;
+        const uint64_t *key = secret + s;
+        __m256i d0  = _mm256_loadu_si256((const __m256i *)in);
+        __m256i d1  = _mm256_loadu_si256((const __m256i *)(in + 32));
+        __m256i dk0 = _mm256_xor_si256(d0, _mm256_loadu_si256((const __m256i *)key));
+        __m256i dk1 = _mm256_xor_si256(d1, _mm256_loadu_si256((const __m256i *)(key + 4)));
+        __m256i p0  = _mm256_mul_epu32(dk0, _mm256_shuffle_epi32(dk0, _MM_SHUFFLE(0, 3, 0, 1)));
+        __m256i p1  = _mm256_mul_epu32(dk1, _mm256_shuffle_epi32(dk1, _MM_SHUFFLE(0, 3, 0, 1)));
+        a0 = _mm256_add_epi64(a0, _mm256_add_epi64(p0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2))));
+        a1 = _mm256_add_epi64(a1, _mm256_add_epi64(p1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+    _mm256_storeu_si256((__m256i *)acc, a0);
+    _mm256_storeu_si256((__m256i *)(acc + 4), a1);
+}
+#endif
+
+#ifdef FOSSIL_HASH_HAVE_NEON
+static void hash_accumulate_neon(uint64_t *acc, const uint8_t *p, size_t nstripes, const uint64_t *secret) {
+    uint64x2_t a[4];
+    for (size_t i = 0; i < 4; ++i)
+        a[i] = vld1q_u64(acc + i * 2);
+    for (size_t s = 0; s < nstripes; ++s) {
+        const uint8_t *in = p + s * HASH_STRIPE_LEN;
+        const uint64_t *key = secret + s;
+        for (size_t i = 0; i < 4; ++i) {
+            uint64x2_t d  = vreinterpretq_u64_u8(vld1q_u8(in + i * 16));
+            uint64x2_t dk = veorq_u64(d, vld1q_u64(key + i * 2));
+            a[i] = vaddq_u64(a[i], vextq_u64(d, d, 1));
+            a[i] = vmlal_u32(a[i], vmovn_u64(dk), vshrn_n_u64(dk, 32));
+        }
+    }
+    for (size_t i = 0; i < 4; ++i)
+        vst1q_u64(acc + i * 2, a[i]);
+}
+#endif
+
+#if defined(FOSSIL_HASH_AVX2_RUNTIME)
+/*
+ * The CPU is asked once, when the library loads; kernel selection only
+ * reads the answer. Hashes taken before that (from another constructor)
+ * use the baseline kernel, which returns the same values.
+ */
+static bool hash_cpu_avx2 = false;
+
+__attribute__((constructor))
+static void hash_detect_cpu(void) {
+    __builtin_cpu_init();
+    hash_cpu_avx2 = __builtin_cpu_supports("avx2") != 0;
+}
+#endif
+
+static hash_accumulate_fn hash_select_kernel(const char **name) {
+#if defined(FOSSIL_HASH_HAVE_AVX2) && !defined(FOSSIL_HASH_AVX2_RUNTIME)
+    if (name) *name = "avx2";
+    return hash_accumulate_avx2;
+#else
+#if defined(FOSSIL_HASH_AVX2_RUNTIME)
+    if (hash_cpu_avx2) {
+        if (name) *name = "avx2";
+        return hash_accumulate_avx2;
+    }
+#endif
+#if defined(FOSSIL_HASH_HAVE_SSE2)
+    if (name) *name = "sse2";
+    return hash_accumulate_sse2;
+#elif defined(FOSSIL_HASH_HAVE_NEON)
+    if (name) *name = "neon";
+    return hash_accumulate_neon;
+#else
+    if (name) *name = "scalar";
+    return hash_accumulate_scalar;
+#endif
+#endif
+}
+
+static void hash_scramble(uint64_t *acc) {
+    const uint64_t *key = hash_secret + HASH_SCRAMBLE_KEY;
+    for (size_t i = 0; i < 8; ++i) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= key[i];
+        acc[i] = a * HASH_P32_1;
+    }
+}
+
+static uint64_t hash_long(const uint8_t *p, size_t len, uint64_t seed, hash_accumulate_fn accumulate) {
+    uint64_t acc[8] = {
+        HASH_P32_3, HASH_P64_1, HASH_P64_2, HASH_P64_3,
+        HASH_P64_4, HASH_P32_2, HASH_P64_5, HASH_P32_1
+    };
+    for (size_t i = 0; i < 8; ++i)
+        acc[i] += (i & 1) ? (uint64_t)0 - seed : seed;
+
+    size_t blocks = (len - 1) / HASH_BLOCK_LEN;
+    for (size_t b = 0; b < blocks; ++b) {
+        accumulate(acc, p + b * HASH_BLOCK_LEN, HASH_STRIPES_PER_BLOCK, hash_secret);
+        hash_scramble(acc);
+    }
+    size_t tail_stripes = ((len - 1) - blocks * HASH_BLOCK_LEN) / HASH_STRIPE_LEN;
+    accumulate(acc, p + blocks * HASH_BLOCK_LEN, tail_stripes, hash_secret);
+    accumulate(acc, p + len - HASH_STRIPE_LEN, 1, hash_secret + HASH_LAST_STRIPE_KEY);
+
+    uint64_t r = (uint64_t)len * HASH_P64_1 ^ seed;
+    for (size_t i = 0; i < 4; ++i)
+        r += hash_mix(acc[2 * i] ^ hash_secret[3 + 2 * i], acc[2 * i + 1] ^ hash_secret[4 + 2 * i]);
+    r ^= r >> 37;
+    r *= HASH_P64_3;
+    r ^= r >> 32;
+    return r;
+}
+
+// ===========================================================
+// Public API
+// ===========================================================
+
+uint64_t fossil_bluecrab_hash64(const void *data, size_t len, uint64_t seed) {
+    const uint8_t *p = (const uint8_t *)data;
+    if (len <= HASH_SHORT_MAX)
+        return hash_short(p, len, seed);
+    return hash_long(p, len, seed, hash_select_kernel(NULL));
+}
+
+uint64_t fossil_bluecrab_hash64_reference(const void *data, size_t len, uint64_t seed) {
+    const uint8_t *p = (const uint8_t *)data;
+    if (len <= HASH_SHORT_MAX)
+        return hash_short(p, len, seed);
+    return hash_long(p, len, seed, hash_accumulate_scalar);
+}
+
+void fossil_bluecrab_hash64_batch(const char *const *keys, const size_t *lens, size_t count, uint64_t seed, uint64_t *out) {
+    if (!keys || !out) return;
+    hash_accumulate_fn accumulate = NULL;
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t *p = (const uint8_t *)keys[i];
+        size_t len = lens ? lens[i] : (p ? strlen((const char *)p) : 0);
+        if (len <= HASH_SHORT_MAX) {
+            out[i] = hash_short(p, len, seed);
+        } else {
+            if (!accumulate) accumulate = hash_select_kernel(NULL);
+            out[i] = hash_long(p, len, seed, accumulate);
+        }
+    }
+}
+
+const char *fossil_bluecrab_hash_backend(void) {
+    const char *name = "scalar";
+    hash_select_kernel(&name);
+    return name;
+}
+
+uint64_t fossil_bluecrab_hash64_legacy(const void *data, size_t len) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t hash = 0xe17a1465ULL ^ (len * m);
+
+    const uint8_t *p = (const uint8_t *)data;
+    const uint8_t *end = p + (len & ~(size_t)0x7);
+
+    while (p != end) {
+        uint64_t k;
+        memcpy(&k, p, sizeof(uint64_t));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        hash ^= k;
+        hash *= m;
+        p += 8;
+    }
+
+    switch (len & 7) {
+        case 7: hash ^= (uint64_t)p[6] << 48; /* fall through */
+        case 6: hash ^= (uint64_t)p[5] << 40; /* fall through */
+        case 5: hash ^= (uint64_t)p[4] << 32; /* fall through */
+        case 4: hash ^= (uint64_t)p[3] << 24; /* fall through */
+        case 3: hash ^= (uint64_t)p[2] << 16; /* fall through */
+        case 2: hash ^= (uint64_t)p[1] << 8;  /* fall through */
+        case 1: hash ^= (uint64_t)p[0];
+                hash *= m;
+    }
+
+    hash ^= hash >> r;
+    hash *= m;
+    hash ^= hash >> r;
+    return hash;
+}
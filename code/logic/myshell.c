@@ -22,7 +22,36 @@
  * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
  * -----------------------------------------------------------------------------
  */
+#if !defined(_WIN32) && !defined(_WIN64) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
 #include "fossil/crabdb/myshell.h"
+#include "fossil/crabdb/hash.h"
+#include "fossil/crabdb/query.h"
+#include "fossil/crabdb/scan.h"
+#include "fossil/crabdb/sync.h"
+#include "fossil/crabdb/thread.h"
+#include <stdarg.h>
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MYSHELL_HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined(__SSE4_2__)
+#define MYSHELL_HAVE_SSE42 1
+#include <nmmintrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define MYSHELL_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
 
 /**
  * @brief Implements the core logic for the Fossil BlueCrab .myshell file database.
@@ -42,6 +71,8 @@
  * - Branches are recorded as: `#branch HASH BRANCHNAME #type=enum`
  * - Tags are recorded as: `#tag HASH TAGNAME #type=enum`
  * - Staged changes are recorded as: `#stage key=value #type=TYPE #hash=KEYHASH`
+ *   - The staging area is kept in memory on the handle and written out, right
+ *     before the `#commit` line, by `fossil_myshell_commit`.
  * - Merges are recorded as: `#merge HASH SOURCEBRANCH MESSAGE TIMESTAMP #type=enum`
  * - Backups include a header: `#backup_hash=HASH`
  * - FSON type system header: `#fson_types=null,bool,i8,i16,i32,i64,u8,u16,u32,u64,f32,f64,oct,hex,bin,char,cstr,array,object,enum,datetime,duration`
@@ -94,14 +125,23 @@
  * ```
  *
  * ## Main Functions
- * - `myshell_hash64`: Computes a 64-bit hash for strings (MurmurHash3 variant).
+ * - `myshell_hash64`: Computes the on-disk 64-bit hash for strings (shared legacy hash).
  * - `fossil_myshell_open`: Opens an existing .myshell database file.
  * - `fossil_myshell_create`: Creates a new .myshell database file.
  * - `fossil_myshell_close`: Closes and frees resources for a database.
  * - `fossil_myshell_put`: Inserts or updates a key-value pair (with FSON type and hash).
  * - `fossil_myshell_get`: Retrieves the value for a given key.
  * - `fossil_myshell_del`: Deletes a key-value pair.
+ * - `fossil_myshell_query`: Runs a SQL-like SELECT over the records.
+ * - `fossil_myshell_aggregate`: COUNT/SUM/MIN/MAX/AVG over numeric records, reduced in batches.
+ * - `fossil_myshell_create_index`, `fossil_myshell_create_index_versioned`, `fossil_myshell_index_lookup`,
+ *   `fossil_myshell_index_range`, `fossil_myshell_drop_index`: Secondary value indexes (hash + ordered),
+ *   saved as `<path>.<name>.idx`.
+ * - `fossil_myshell_txn_begin`, `fossil_myshell_txn_put`, `fossil_myshell_txn_del`,
+ *   `fossil_myshell_txn_commit`, `fossil_myshell_txn_rollback`: Atomic multi-key transactions.
+ * - `fossil_myshell_cache_enable`, `fossil_myshell_cache_stats`: Optional hot-key LRU value cache.
  * - `fossil_myshell_commit`: Records a commit with a message.
+ * - `fossil_myshell_log_range`: Pages through commits, newest first by default.
  * - `fossil_myshell_branch`: Creates or switches to a branch.
  * - `fossil_myshell_checkout`: Checks out a branch or commit.
  * - `fossil_myshell_merge`: Merges a branch with a commit message.
@@ -114,13 +154,35 @@
  * - `fossil_myshell_restore`: Restores a database from backup.
  * - `fossil_myshell_errstr`: Converts error codes to strings.
  * - `fossil_myshell_check_integrity`: Verifies file and commit integrity.
+ * - `fossil_myshell_open_sharded`, `fossil_myshell_sharded_put/get/del/query/check_integrity`:
+ *   Hash-sharded database over N files in a directory, one lock per shard.
  *
  * ## Error Handling
  * All functions return a `fossil_bluecrab_myshell_error_t` code indicating success or the type of error.
  *
  * ## Usage Notes
  * - Only files with the ".myshell" extension are supported.
- * - All operations are performed directly on the file; there is no in-memory caching.
+ * - All operations are performed directly on the file; only the staging area and
+ *   pending transaction operations are kept in memory.
+ * - Staged entries that are never committed are discarded when the handle is closed.
+ * - The optional value cache only sees writes made through the same handle.
+ * - `fossil_myshell_query` runs a small SQL subset (SELECT key/value/type, WHERE with
+ *   = != < <= > >= LIKE, AND/OR/NOT, LIMIT) over the records in the file; predicates
+ *   are evaluated in the scan loop and the scan stops once LIMIT rows were delivered.
+ *   Staged entries and pending transaction writes are not visible to queries.
+ * - `fossil_myshell_submit_get` / `fossil_myshell_submit_put` queue work on a
+ *   shared worker pool: gets run concurrently, puts on a handle run in order;
+ *   completions are delivered by `fossil_myshell_async_poll` /
+ *   `fossil_myshell_async_wait` on the caller's thread. Every call takes the
+ *   handle's lock, so synchronous calls may interleave with queued work.
+ * - `fossil_myshell_set_durability` picks how hard writes are pushed to disk:
+ *   NONE, FLUSH (default, flush per operation), FSYNC (per commit) or PERIODIC
+ *   (fdatasync/fsync every N ms from a background thread).
+ * - Closing a handle writes `<path>.meta`, which lets the next open skip type
+ *   validation of everything but bytes appended after the close.
+ * - Rewrites (put, del, transaction commit) go through a temp file that is renamed
+ *   over the database, so a crash leaves either the old or new contents; FSYNC mode
+ *   also syncs the temp file and the parent directory around the rename.
  * - Integrity of data is ensured via hashes for keys and commits.
  * - The API is designed for simple versioned key-value storage with basic VCS-like features.
  * - The FSON type system is enforced for all key-value and metadata entries.
@@ -172,48 +234,1995 @@ static char *myshell_strdup(const char *s) {
 }
 
 /**
- * Advanced 64-bit hash algorithm for strings (MurmurHash3 variant).
- * Returns a 64-bit hash value for the given input string.
+ * 64-bit string hash used for on-disk hashes. Delegates to the shared
+ * legacy hash so values already written to files keep matching.
  */
 uint64_t myshell_hash64(const char *str) {
     if (!str) return 0;
-    uint64_t seed = 0xe17a1465ULL;
-    uint64_t m = 0xc6a4a7935bd1e995ULL;
-    int r = 47;
-    size_t len = strlen(str);
-    uint64_t hash = seed ^ (len * m);
-
-    const uint8_t *data = (const uint8_t *)str;
-    const uint8_t *end = data + (len & ~0x7);
-
-    while (data != end) {
-        uint64_t k;
-        memcpy(&k, data, sizeof(uint64_t));
-        k *= m;
-        k ^= k >> r;
-        k *= m;
-        hash ^= k;
-        hash *= m;
-        data += 8;
-    }
-
-    switch (len & 7) {
-        case 7: hash ^= (uint64_t)data[6] << 48; /* fall through */
-        case 6: hash ^= (uint64_t)data[5] << 40; /* fall through */
-        case 5: hash ^= (uint64_t)data[4] << 32; /* fall through */
-        case 4: hash ^= (uint64_t)data[3] << 24; /* fall through */
-        case 3: hash ^= (uint64_t)data[2] << 16; /* fall through */
-        case 2: hash ^= (uint64_t)data[1] << 8;  /* fall through */
-        case 1: hash ^= (uint64_t)data[0];
-                hash *= m;
-    }
-
-    hash ^= hash >> r;
-    hash *= m;
-    hash ^= hash >> r;
+    return fossil_bluecrab_hash64_legacy(str, strlen(str));
+}
+
+/**
+ * Finds a "#tag=" marker in line[0..len) with the shared scan kernels.
+ */
+static char *myshell_find_tag(char *line, size_t len, const char *tag) {
+    return (char *)fossil_bluecrab_scan_find(line, len, tag, strlen(tag));
+}
+
+/**
+ * Reads the hex value after a "#hash=" marker; 'end' bounds the line.
+ */
+static uint64_t myshell_read_hash(const char *hash_comment, const char *end) {
+    uint64_t hash = 0;
+    const char *digits = hash_comment + 6;
+    if (digits < end)
+        fossil_bluecrab_scan_hex64(digits, (size_t)(end - digits), &hash);
     return hash;
 }
 
+// ===========================================================
+// Internal Key/Value Map (staging area, transactions)
+// ===========================================================
+
+/**
+ * Chained hash map from key to a typed value. Entries are also linked in
+ * insertion order so that flushing them to disk is deterministic.
+ */
+typedef struct myshell_kv_entry_t {
+    char    *key;
+    char    *value;
+    fossil_bluecrab_myshell_fson_type_t type;
+    uint64_t hash;                          // myshell_hash64(key), same as #hash= on disk
+    bool     deleted;                       // pending delete (transactions)
+    bool     applied;                       // matched an on-disk record while rewriting
+    struct myshell_kv_entry_t *next;        // bucket chain
+    struct myshell_kv_entry_t *order_prev;  // insertion order
+    struct myshell_kv_entry_t *order_next;
+} myshell_kv_entry_t;
+
+typedef struct {
+    myshell_kv_entry_t **buckets;
+    size_t bucket_count;
+    size_t count;
+    myshell_kv_entry_t *head;
+    myshell_kv_entry_t *tail;
+} myshell_kvmap_t;
+
+static myshell_kvmap_t *myshell_kvmap_new(void) {
+    myshell_kvmap_t *map = (myshell_kvmap_t *)calloc(1, sizeof(myshell_kvmap_t));
+    if (!map) return NULL;
+    map->bucket_count = 64;
+    map->buckets = (myshell_kv_entry_t **)calloc(map->bucket_count, sizeof(myshell_kv_entry_t *));
+    if (!map->buckets) {
+        free(map);
+        return NULL;
+    }
+    return map;
+}
+
+static void myshell_kvmap_free_entry(myshell_kv_entry_t *entry) {
+    free(entry->key);
+    free(entry->value);
+    free(entry);
+}
+
+static void myshell_kvmap_clear(myshell_kvmap_t *map) {
+    if (!map) return;
+    myshell_kv_entry_t *entry = map->head;
+    while (entry) {
+        myshell_kv_entry_t *next = entry->order_next;
+        myshell_kvmap_free_entry(entry);
+        entry = next;
+    }
+    memset(map->buckets, 0, map->bucket_count * sizeof(myshell_kv_entry_t *));
+    map->count = 0;
+    map->head = NULL;
+    map->tail = NULL;
+}
+
+static void myshell_kvmap_free(myshell_kvmap_t *map) {
+    if (!map) return;
+    myshell_kvmap_clear(map);
+    free(map->buckets);
+    free(map);
+}
+
+static myshell_kv_entry_t *myshell_kvmap_find(const myshell_kvmap_t *map, const char *key, uint64_t hash) {
+    if (!map) return NULL;
+    myshell_kv_entry_t *entry = map->buckets[hash % map->bucket_count];
+    while (entry) {
+        if (entry->hash == hash && strcmp(entry->key, key) == 0)
+            return entry;
+        entry = entry->next;
+    }
+    return NULL;
+}
+
+static void myshell_kvmap_grow(myshell_kvmap_t *map) {
+    size_t new_count = map->bucket_count * 2;
+    myshell_kv_entry_t **buckets = (myshell_kv_entry_t **)calloc(new_count, sizeof(myshell_kv_entry_t *));
+    if (!buckets) return; // keep the current table, chains just get longer
+    for (myshell_kv_entry_t *entry = map->head; entry; entry = entry->order_next) {
+        size_t index = entry->hash % new_count;
+        entry->next = buckets[index];
+        buckets[index] = entry;
+    }
+    free(map->buckets);
+    map->buckets = buckets;
+    map->bucket_count = new_count;
+}
+
+/**
+ * Inserts or replaces the value stored for key.
+ * Returns false on allocation failure (the map is left unchanged).
+ */
+static bool myshell_kvmap_set(myshell_kvmap_t *map, const char *key, uint64_t hash,
+                              fossil_bluecrab_myshell_fson_type_t type, const char *value) {
+    char *value_copy = myshell_strdup(value ? value : "");
+    if (!value_copy) return false;
+
+    myshell_kv_entry_t *entry = myshell_kvmap_find(map, key, hash);
+    if (entry) {
+        free(entry->value);
+        entry->value = value_copy;
+        entry->type = type;
+        entry->deleted = false;
+        return true;
+    }
+
+    entry = (myshell_kv_entry_t *)calloc(1, sizeof(myshell_kv_entry_t));
+    if (!entry) {
+        free(value_copy);
+        return false;
+    }
+    entry->key = myshell_strdup(key);
+    if (!entry->key) {
+        free(value_copy);
+        free(entry);
+        return false;
+    }
+    entry->value = value_copy;
+    entry->type = type;
+    entry->hash = hash;
+
+    if (map->count >= map->bucket_count)
+        myshell_kvmap_grow(map);
+
+    size_t index = hash % map->bucket_count;
+    entry->next = map->buckets[index];
+    map->buckets[index] = entry;
+
+    entry->order_prev = map->tail;
+    if (map->tail)
+        map->tail->order_next = entry;
+    else
+        map->head = entry;
+    map->tail = entry;
+    map->count++;
+    return true;
+}
+
+/**
+ * Records a pending delete for key, replacing any pending value.
+ */
+static bool myshell_kvmap_set_deleted(myshell_kvmap_t *map, const char *key, uint64_t hash) {
+    if (!myshell_kvmap_set(map, key, hash, MYSHELL_FSON_TYPE_NULL, ""))
+        return false;
+    myshell_kvmap_find(map, key, hash)->deleted = true;
+    return true;
+}
+
+static bool myshell_kvmap_remove(myshell_kvmap_t *map, const char *key, uint64_t hash) {
+    if (!map) return false;
+    size_t index = hash % map->bucket_count;
+    myshell_kv_entry_t *prev = NULL;
+    myshell_kv_entry_t *entry = map->buckets[index];
+    while (entry) {
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+            if (prev)
+                prev->next = entry->next;
+            else
+                map->buckets[index] = entry->next;
+
+            if (entry->order_prev)
+                entry->order_prev->order_next = entry->order_next;
+            else
+                map->head = entry->order_next;
+            if (entry->order_next)
+                entry->order_next->order_prev = entry->order_prev;
+            else
+                map->tail = entry->order_prev;
+
+            myshell_kvmap_free_entry(entry);
+            map->count--;
+            return true;
+        }
+        prev = entry;
+        entry = entry->next;
+    }
+    return false;
+}
+
+// ===========================================================
+// Internal Write Buffer
+// ===========================================================
+
+typedef struct {
+    char  *data;
+    size_t len;
+    size_t cap;
+} myshell_buf_t;
+
+/**
+ * Appends formatted text to the buffer, growing it as needed.
+ */
+static bool myshell_buf_printf(myshell_buf_t *buf, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    va_list copy;
+    va_copy(copy, args);
+    int needed = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+    if (needed < 0) {
+        va_end(args);
+        return false;
+    }
+    if (buf->len + (size_t)needed + 1 > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 256;
+        while (buf->len + (size_t)needed + 1 > cap) cap *= 2;
+        char *data = (char *)realloc(buf->data, cap);
+        if (!data) {
+            va_end(args);
+            return false;
+        }
+        buf->data = data;
+        buf->cap = cap;
+    }
+    vsnprintf(buf->data + buf->len, buf->cap - buf->len, fmt, args);
+    va_end(args);
+    buf->len += (size_t)needed;
+    return true;
+}
+
+/**
+ * Moves entry to the tail of the insertion-order list.
+ */
+static void myshell_kvmap_touch(myshell_kvmap_t *map, myshell_kv_entry_t *entry) {
+    if (map->tail == entry) return;
+    if (entry->order_prev)
+        entry->order_prev->order_next = entry->order_next;
+    else
+        map->head = entry->order_next;
+    entry->order_next->order_prev = entry->order_prev;
+
+    entry->order_prev = map->tail;
+    entry->order_next = NULL;
+    map->tail->order_next = entry;
+    map->tail = entry;
+}
+
+// ===========================================================
+// Internal Hot-Key Cache
+// ===========================================================
+
+/**
+ * Bounded LRU cache of key -> value, attached to db->cache. The kv map's
+ * insertion-order list doubles as the recency list: head is the least
+ * recently used entry and is evicted first.
+ */
+typedef struct {
+    myshell_kvmap_t *map;
+    size_t   max_bytes;
+    size_t   bytes;
+    uint64_t hits;
+    uint64_t misses;
+} myshell_cache_t;
+
+static size_t myshell_cache_entry_size(const char *key, const char *value) {
+    return sizeof(myshell_kv_entry_t) + strlen(key) + strlen(value) + 2;
+}
+
+static void myshell_cache_free(myshell_cache_t *cache) {
+    if (!cache) return;
+    myshell_kvmap_free(cache->map);
+    free(cache);
+}
+
+static void myshell_cache_evict(myshell_cache_t *cache, size_t max_bytes) {
+    while (cache->bytes > max_bytes && cache->map->head) {
+        myshell_kv_entry_t *lru = cache->map->head;
+        cache->bytes -= myshell_cache_entry_size(lru->key, lru->value);
+        myshell_kvmap_remove(cache->map, lru->key, lru->hash);
+    }
+}
+
+static void myshell_cache_invalidate(myshell_cache_t *cache, const char *key, uint64_t hash) {
+    if (!cache) return;
+    myshell_kv_entry_t *entry = myshell_kvmap_find(cache->map, key, hash);
+    if (entry) {
+        cache->bytes -= myshell_cache_entry_size(entry->key, entry->value);
+        myshell_kvmap_remove(cache->map, key, hash);
+    }
+}
+
+static void myshell_cache_insert(myshell_cache_t *cache, const char *key, uint64_t hash, const char *value) {
+    size_t size = myshell_cache_entry_size(key, value);
+    if (size > cache->max_bytes) return;
+    myshell_cache_invalidate(cache, key, hash);
+    myshell_cache_evict(cache, cache->max_bytes - size);
+    if (myshell_kvmap_set(cache->map, key, hash, MYSHELL_FSON_TYPE_CSTR, value))
+        cache->bytes += size;
+}
+
+// ===========================================================
+// Internal Commit Offset Index
+// ===========================================================
+
+/**
+ * Offsets of `#commit` lines in file order, attached to db->commit_index.
+ * Commits are only ever appended, so the index is extended by scanning the
+ * bytes past 'scanned'. myshell_apply notes the new offsets while it copies
+ * the file, and the `.meta` sidecar carries the index across close and open,
+ * so it is built by a full scan at most once per database.
+ */
+typedef struct {
+    long     offset;
+    uint64_t hash;
+} myshell_commit_ref_t;
+
+typedef struct {
+    myshell_commit_ref_t *items;
+    size_t count;
+    size_t capacity;
+    long   scanned;
+} myshell_commit_index_t;
+
+static void myshell_commit_index_free(myshell_commit_index_t *index) {
+    if (!index) return;
+    free(index->items);
+    free(index);
+}
+
+/**
+ * Records the `#commit` line at 'offset' if 'line' is one. Returns false only
+ * when the index cannot grow.
+ */
+static bool myshell_commit_index_note(myshell_commit_index_t *index, long offset, const char *line, size_t len) {
+    if (len < 8 || strncmp(line, "#commit ", 8) != 0)
+        return true;
+    if (index->count == index->capacity) {
+        size_t new_cap = index->capacity ? index->capacity * 2 : 64;
+        myshell_commit_ref_t *items = (myshell_commit_ref_t *)realloc(index->items, new_cap * sizeof(myshell_commit_ref_t));
+        if (!items) return false;
+        index->items = items;
+        index->capacity = new_cap;
+    }
+    myshell_commit_ref_t *ref = &index->items[index->count++];
+    ref->offset = offset;
+    ref->hash = 0;
+    fossil_bluecrab_scan_hex64(line + 8, len - 8, &ref->hash);
+    return true;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_commit_index_sync(fossil_bluecrab_myshell_t *db, myshell_commit_index_t **out) {
+    myshell_commit_index_t *index = (myshell_commit_index_t *)db->commit_index;
+    if (!index) {
+        index = (myshell_commit_index_t *)calloc(1, sizeof(myshell_commit_index_t));
+        if (!index) return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+        db->commit_index = index;
+    }
+
+    if (fseek(db->file, index->scanned, SEEK_SET) != 0) {
+        return FOSSIL_MYSHELL_ERROR_IO;
+    }
+    char line[1024];
+    bool line_start = true;
+    long pos = index->scanned;
+    while (fgets(line, sizeof(line), db->file)) {
+        size_t len = strlen(line);
+        bool complete = len > 0 && line[len - 1] == '\n';
+        if (!complete && feof(db->file)) {
+            break; // partial trailing line, pick it up on the next sync
+        }
+        if (line_start && !myshell_commit_index_note(index, pos, line, len)) {
+            return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+        }
+        pos += (long)len;
+        line_start = complete;
+        if (complete) {
+            index->scanned = pos;
+        }
+    }
+    if (ferror(db->file)) {
+        return FOSSIL_MYSHELL_ERROR_IO;
+    }
+    *out = index;
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
+
+/**
+ * Parses one `#commit` line and passes it to cb, verifying the commit hash.
+ * Sets *stop when the callback asks to end the iteration.
+ */
+static fossil_bluecrab_myshell_error_t myshell_log_emit(const char *line, fossil_myshell_commit_cb cb, void *user, bool *stop) {
+    char hash_str[17] = {0};
+    char message[512] = {0};
+    long long timestamp = 0;
+    char type_name[32] = {0};
+    int n = sscanf(line, "#commit %16s %511[^\n] %lld #type=%31s", hash_str, message, &timestamp, type_name);
+
+    // FSON type system: parse type if present, default to ENUM
+    // (commit_type is not used, so skip parsing)
+
+    if (n >= 3) {
+        uint64_t parsed_hash = 0;
+        sscanf(hash_str, "%" SCNx64, &parsed_hash);
+        char commit_data[1024];
+        snprintf(commit_data, sizeof(commit_data), "%s:%lld", message, timestamp);
+        uint64_t computed_hash = myshell_hash64(commit_data);
+        if (parsed_hash != computed_hash) {
+            return FOSSIL_MYSHELL_ERROR_INTEGRITY;
+        }
+        // Optionally, you could pass commit_type to the callback if its signature supports it
+        *stop = !cb(hash_str, message, user);
+    } else if (n == 2) {
+        *stop = !cb(hash_str, message, user);
+    } else {
+        return FOSSIL_MYSHELL_ERROR_PARSE_FAILED;
+    }
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
+
+// ===========================================================
+// Internal File Helpers
+// ===========================================================
+
+/**
+ * Atomically replaces target with source (rename over the existing file).
+ */
+static int myshell_replace_file(const char *source, const char *target) {
+#if defined(_WIN32) || defined(_WIN64)
+    return MoveFileExA(source, target, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+#else
+    return rename(source, target);
+#endif
+}
+
+static bool myshell_lookup_type(const char *type_name, fossil_bluecrab_myshell_fson_type_t *out_type) {
+    for (size_t i = 0; i <= MYSHELL_FSON_TYPE_DURATION; ++i) {
+        if (strcmp(type_name, myshell_fson_type_names[i]) == 0) {
+            if (out_type) *out_type = (fossil_bluecrab_myshell_fson_type_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ===========================================================
+// Internal Durability
+// ===========================================================
+
+/**
+ * Durability state attached to db->durability (NULL means the default,
+ * FOSSIL_MYSHELL_DURABILITY_FLUSH). PERIODIC mode runs a background syncer
+ * from sync.c on the path; syncing by path means it never races with the
+ * handle reopening db->file after a rewrite.
+ */
+typedef struct {
+    fossil_bluecrab_myshell_durability_t mode;
+    fossil_bluecrab_sync_worker_t *worker;  // PERIODIC only
+} myshell_durability_t;
+
+static fossil_bluecrab_myshell_durability_t myshell_durability_mode(const fossil_bluecrab_myshell_t *db) {
+    const myshell_durability_t *d = (const myshell_durability_t *)db->durability;
+    return d ? d->mode : FOSSIL_MYSHELL_DURABILITY_FLUSH;
+}
+
+/**
+ * Stops the periodic worker (if any) and frees the durability state. Pending
+ * dirty data is synced one last time so closing a PERIODIC handle loses nothing.
+ */
+static void myshell_durability_free(myshell_durability_t *d) {
+    if (!d) return;
+    fossil_bluecrab_sync_worker_stop(d->worker);
+    free(d);
+}
+
+/**
+ * Applies the durability policy after a write. commit_point marks operations
+ * that complete a commit (commit, merge, rewrites) as opposed to plain appends.
+ */
+static fossil_bluecrab_myshell_error_t myshell_durable(fossil_bluecrab_myshell_t *db, bool commit_point) {
+    myshell_durability_t *d = (myshell_durability_t *)db->durability;
+    switch (myshell_durability_mode(db)) {
+        case FOSSIL_MYSHELL_DURABILITY_NONE:
+            return FOSSIL_MYSHELL_ERROR_SUCCESS;
+        case FOSSIL_MYSHELL_DURABILITY_FSYNC:
+            if (commit_point) {
+                return fossil_bluecrab_sync_file(db->file) == 0 ? FOSSIL_MYSHELL_ERROR_SUCCESS : FOSSIL_MYSHELL_ERROR_IO;
+            }
+            break;
+        case FOSSIL_MYSHELL_DURABILITY_PERIODIC:
+            fossil_bluecrab_sync_worker_mark(d->worker);
+            break;
+        case FOSSIL_MYSHELL_DURABILITY_FLUSH:
+        default:
+            break;
+    }
+    return fflush(db->file) == 0 ? FOSSIL_MYSHELL_ERROR_SUCCESS : FOSSIL_MYSHELL_ERROR_IO;
+}
+
+// ===========================================================
+// Handle Lock
+// ===========================================================
+
+/**
+ * db->lock. Every public function on a handle takes it exclusively, and
+ * re-entrantly for the owning thread, so callbacks may call back into the
+ * handle and async requests can run beside the caller's synchronous calls.
+ * Async gets take it shared: they read through a stream of their own and
+ * touch the value cache under cache_mutex, so several can run at once. A
+ * waiting exclusive caller holds off new shared ones.
+ */
+typedef struct {
+    fossil_bluecrab_thread_mutex_t mutex;
+    fossil_bluecrab_thread_cond_t  cond;
+    fossil_bluecrab_thread_id_t    owner;
+    size_t   depth;                     // exclusive holds by owner
+    size_t   readers;
+    size_t   writers_waiting;
+    fossil_bluecrab_thread_mutex_t cache_mutex;
+} myshell_lock_t;
+
+static myshell_lock_t *myshell_lock_new(void) {
+    myshell_lock_t *l = (myshell_lock_t *)calloc(1, sizeof(myshell_lock_t));
+    if (!l) return NULL;
+    fossil_bluecrab_thread_mutex_init(&l->mutex);
+    fossil_bluecrab_thread_cond_init(&l->cond);
+    fossil_bluecrab_thread_mutex_init(&l->cache_mutex);
+    return l;
+}
+
+static void myshell_lock_free(myshell_lock_t *l) {
+    if (!l) return;
+    fossil_bluecrab_thread_mutex_destroy(&l->cache_mutex);
+    fossil_bluecrab_thread_cond_destroy(&l->cond);
+    fossil_bluecrab_thread_mutex_destroy(&l->mutex);
+    free(l);
+}
+
+static void myshell_lock(fossil_bluecrab_myshell_t *db) {
+    myshell_lock_t *l = db ? (myshell_lock_t *)db->lock : NULL;
+    if (!l) return;
+    fossil_bluecrab_thread_mutex_lock(&l->mutex);
+    if (l->depth > 0 && fossil_bluecrab_thread_is_self(l->owner)) {
+        l->depth++;
+    } else {
+        l->writers_waiting++;
+        while (l->depth > 0 || l->readers > 0) {
+            fossil_bluecrab_thread_cond_wait(&l->cond, &l->mutex);
+        }
+        l->writers_waiting--;
+        l->owner = fossil_bluecrab_thread_self();
+        l->depth = 1;
+    }
+    fossil_bluecrab_thread_mutex_unlock(&l->mutex);
+}
+
+static void myshell_unlock(fossil_bluecrab_myshell_t *db) {
+    myshell_lock_t *l = db ? (myshell_lock_t *)db->lock : NULL;
+    if (!l) return;
+    fossil_bluecrab_thread_mutex_lock(&l->mutex);
+    if (--l->depth == 0) {
+        fossil_bluecrab_thread_cond_broadcast(&l->cond);
+    }
+    fossil_bluecrab_thread_mutex_unlock(&l->mutex);
+}
+
+static void myshell_lock_shared(fossil_bluecrab_myshell_t *db) {
+    myshell_lock_t *l = (myshell_lock_t *)db->lock;
+    fossil_bluecrab_thread_mutex_lock(&l->mutex);
+    while (l->depth > 0 || l->writers_waiting > 0) {
+        fossil_bluecrab_thread_cond_wait(&l->cond, &l->mutex);
+    }
+    l->readers++;
+    fossil_bluecrab_thread_mutex_unlock(&l->mutex);
+}
+
+static void myshell_unlock_shared(fossil_bluecrab_myshell_t *db) {
+    myshell_lock_t *l = (myshell_lock_t *)db->lock;
+    fossil_bluecrab_thread_mutex_lock(&l->mutex);
+    if (--l->readers == 0) {
+        fossil_bluecrab_thread_cond_broadcast(&l->cond);
+    }
+    fossil_bluecrab_thread_mutex_unlock(&l->mutex);
+}
+
+// ===========================================================
+// Internal Async Queue
+// ===========================================================
+
+/**
+ * Per-handle submission state attached to db->async; the requests run on
+ * the shared pool (thread.h). A get with nothing queued ahead of it goes
+ * to the pool directly and runs under the shared handle lock, beside other
+ * gets. Puts, and gets submitted while puts are pending, wait on the
+ * handle's ordered queue, which one pool task at a time drains: it runs
+ * each put and hands each get to the pool, so a get sees every put
+ * submitted before it. Completed requests collect on the done list and
+ * their callbacks only run from fossil_myshell_async_poll/async_wait on
+ * the caller's thread.
+ */
+typedef enum {
+    MYSHELL_ASYNC_GET,
+    MYSHELL_ASYNC_PUT
+} myshell_async_op_t;
+
+struct myshell_async_t;
+
+typedef struct myshell_async_req_t {
+    myshell_async_op_t op;
+    struct myshell_async_t *q;
+    char    *key;
+    char    *type;
+    char    *value;                     // PUT input, GET output
+    fossil_bluecrab_myshell_error_t result;
+    fossil_myshell_async_cb cb;
+    void    *user;
+    struct myshell_async_req_t *next;
+} myshell_async_req_t;
+
+typedef struct myshell_async_t {
+    fossil_bluecrab_myshell_t *db;
+    fossil_bluecrab_thread_mutex_t  mutex;
+    fossil_bluecrab_thread_cond_t   cond;
+    size_t   in_flight;                 // submitted, not yet completed
+    bool     draining;                  // a pool task owns the ordered queue
+    myshell_async_req_t *queue_head, *queue_tail;
+    myshell_async_req_t *done_head, *done_tail;
+} myshell_async_t;
+
+static void myshell_async_req_free(myshell_async_req_t *req) {
+    free(req->key);
+    free(req->type);
+    free(req->value);
+    free(req);
+}
+
+static fossil_bluecrab_myshell_error_t myshell_scan_get(FILE *file, const char *key, uint64_t key_hash, char *out_value, size_t out_size);
+
+/**
+ * fossil_myshell_get for a pool worker: the shared lock keeps writers out
+ * while the file is read through a private stream.
+ */
+static fossil_bluecrab_myshell_error_t myshell_async_get(fossil_bluecrab_myshell_t *db, const char *key, char *out_value, size_t out_size) {
+    myshell_lock_t *l = (myshell_lock_t *)db->lock;
+    uint64_t key_hash = myshell_hash64(key);
+    fossil_bluecrab_myshell_error_t rc = FOSSIL_MYSHELL_ERROR_NOT_FOUND;
+    bool done = false;
+
+    myshell_lock_shared(db);
+    myshell_kv_entry_t *pending = myshell_kvmap_find((myshell_kvmap_t *)db->txn, key, key_hash);
+    if (pending) {
+        done = true;
+        if (!pending->deleted && strlen(pending->value) >= out_size) {
+            rc = FOSSIL_MYSHELL_ERROR_BUFFER_TOO_SMALL;
+        } else if (!pending->deleted) {
+            memcpy(out_value, pending->value, strlen(pending->value) + 1);
+            rc = FOSSIL_MYSHELL_ERROR_SUCCESS;
+        }
+    }
+    myshell_cache_t *cache = (myshell_cache_t *)db->cache;
+    if (!done && cache) {
+        fossil_bluecrab_thread_mutex_lock(&l->cache_mutex);
+        myshell_kv_entry_t *cached = myshell_kvmap_find(cache->map, key, key_hash);
+        if (cached) {
+            done = true;
+            if (strlen(cached->value) >= out_size) {
+                rc = FOSSIL_MYSHELL_ERROR_BUFFER_TOO_SMALL;
+            } else {
+                memcpy(out_value, cached->value, strlen(cached->value) + 1);
+                myshell_kvmap_touch(cache->map, cached);
+                cache->hits++;
+                rc = FOSSIL_MYSHELL_ERROR_SUCCESS;
+            }
+        } else {
+            cache->misses++;
+        }
+        fossil_bluecrab_thread_mutex_unlock(&l->cache_mutex);
+    }
+    if (!done) {
+        FILE *file = fopen(db->path, "rb");
+        rc = file ? myshell_scan_get(file, key, key_hash, out_value, out_size) : FOSSIL_MYSHELL_ERROR_IO;
+        if (file) fclose(file);
+        if (cache && rc == FOSSIL_MYSHELL_ERROR_SUCCESS && strlen(out_value) + 1 < out_size) {
+            fossil_bluecrab_thread_mutex_lock(&l->cache_mutex);
+            myshell_cache_insert(cache, key, key_hash, out_value);
+            fossil_bluecrab_thread_mutex_unlock(&l->cache_mutex);
+        }
+    }
+    myshell_unlock_shared(db);
+    return rc;
+}
+
+static void myshell_async_run(fossil_bluecrab_myshell_t *db, myshell_async_req_t *req) {
+    if (req->op == MYSHELL_ASYNC_PUT) {
+        req->result = fossil_myshell_put(db, req->key, req->type, req->value);
+        return;
+    }
+    // Grow the value buffer until it fits (records are lines of at most 1 KiB today)
+    size_t size = 256;
+    for (;;) {
+        char *buf = (char *)malloc(size);
+        if (!buf) {
+            req->result = FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+            return;
+        }
+        req->result = myshell_async_get(db, req->key, buf, size);
+        if (req->result == FOSSIL_MYSHELL_ERROR_BUFFER_TOO_SMALL && size < (1u << 20)) {
+            free(buf);
+            size *= 2;
+            continue;
+        }
+        if (req->result == FOSSIL_MYSHELL_ERROR_SUCCESS) {
+            req->value = buf;
+        } else {
+            free(buf);
+        }
+        return;
+    }
+}
+
+/** Runs req and moves it to the done list; req->q may be freed after this. */
+static void myshell_async_complete(myshell_async_req_t *req) {
+    myshell_async_t *q = req->q;
+    myshell_async_run(q->db, req);
+    fossil_bluecrab_thread_mutex_lock(&q->mutex);
+    req->next = NULL;
+    if (q->done_tail) q->done_tail->next = req; else q->done_head = req;
+    q->done_tail = req;
+    q->in_flight--;
+    fossil_bluecrab_thread_cond_broadcast(&q->cond);
+    fossil_bluecrab_thread_mutex_unlock(&q->mutex);
+}
+
+static void myshell_async_task(void *arg) {
+    myshell_async_complete((myshell_async_req_t *)arg);
+}
+
+/** Pool task that owns the ordered queue until it is empty. */
+static void myshell_async_drain(void *arg) {
+    myshell_async_t *q = (myshell_async_t *)arg;
+    fossil_bluecrab_thread_mutex_lock(&q->mutex);
+    while (q->queue_head) {
+        myshell_async_req_t *req = q->queue_head;
+        q->queue_head = req->next;
+        if (!q->queue_head) q->queue_tail = NULL;
+        fossil_bluecrab_thread_mutex_unlock(&q->mutex);
+
+        if (req->op == MYSHELL_ASYNC_PUT || !fossil_bluecrab_pool_submit(myshell_async_task, req)) {
+            myshell_async_complete(req);
+        }
+
+        fossil_bluecrab_thread_mutex_lock(&q->mutex);
+    }
+    q->draining = false;
+    fossil_bluecrab_thread_cond_broadcast(&q->cond);
+    fossil_bluecrab_thread_mutex_unlock(&q->mutex);
+}
+
+static fossil_bluecrab_myshell_error_t myshell_async_submit(fossil_bluecrab_myshell_t *db, myshell_async_req_t *req) {
+    myshell_lock(db);
+    myshell_async_t *q = (myshell_async_t *)db->async;
+    if (!q) {
+        q = (myshell_async_t *)calloc(1, sizeof(myshell_async_t));
+        if (!q) {
+            myshell_unlock(db);
+            return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+        }
+        q->db = db;
+        fossil_bluecrab_thread_mutex_init(&q->mutex);
+        fossil_bluecrab_thread_cond_init(&q->cond);
+        db->async = q;
+    }
+    myshell_unlock(db);
+    req->q = q;
+
+    fossil_bluecrab_thread_mutex_lock(&q->mutex);
+    q->in_flight++;
+    if (req->op == MYSHELL_ASYNC_GET && !q->draining) {
+        fossil_bluecrab_thread_mutex_unlock(&q->mutex);
+        if (fossil_bluecrab_pool_submit(myshell_async_task, req)) {
+            return FOSSIL_MYSHELL_ERROR_SUCCESS;
+        }
+        fossil_bluecrab_thread_mutex_lock(&q->mutex);
+        q->in_flight--;
+        fossil_bluecrab_thread_cond_broadcast(&q->cond);
+        fossil_bluecrab_thread_mutex_unlock(&q->mutex);
+        return FOSSIL_MYSHELL_ERROR_IO;
+    }
+    if (q->queue_tail) q->queue_tail->next = req; else q->queue_head = req;
+    q->queue_tail = req;
+    if (!q->draining) {
+        q->draining = true;
+        if (!fossil_bluecrab_pool_submit(myshell_async_drain, q)) {
+            // req is alone in the queue: nothing was draining it
+            q->queue_head = q->queue_tail = NULL;
+            q->draining = false;
+            q->in_flight--;
+            fossil_bluecrab_thread_cond_broadcast(&q->cond);
+            fossil_bluecrab_thread_mutex_unlock(&q->mutex);
+            return FOSSIL_MYSHELL_ERROR_IO;
+        }
+    }
+    fossil_bluecrab_thread_mutex_unlock(&q->mutex);
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
+
+/**
+ * Invokes callbacks for completed requests, optionally waiting until nothing
+ * is in flight first. Returns the number of callbacks invoked.
+ */
+static size_t myshell_async_dispatch(myshell_async_t *q, bool wait_all) {
+    fossil_bluecrab_thread_mutex_lock(&q->mutex);
+    while (wait_all && (q->in_flight > 0 || q->draining)) {
+        fossil_bluecrab_thread_cond_wait(&q->cond, &q->mutex);
+    }
+    myshell_async_req_t *done = q->done_head;
+    q->done_head = q->done_tail = NULL;
+    fossil_bluecrab_thread_mutex_unlock(&q->mutex);
+
+    size_t count = 0;
+    while (done) {
+        myshell_async_req_t *next = done->next;
+        if (done->cb) {
+            done->cb(done->result, done->key, done->value, done->user);
+        }
+        myshell_async_req_free(done);
+        done = next;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Finishes every outstanding request (callbacks included); no pool task
+ * refers to q afterwards.
+ */
+static void myshell_async_free(myshell_async_t *q) {
+    if (!q) return;
+    // Callbacks may submit more requests
+    while (myshell_async_dispatch(q, true) > 0) {
+    }
+    fossil_bluecrab_thread_cond_destroy(&q->cond);
+    fossil_bluecrab_thread_mutex_destroy(&q->mutex);
+    free(q);
+}
+
+/**
+ * "<path><suffix>", sized from the path: a fixed buffer would truncate a long
+ * path, possibly onto the database itself.
+ */
+static char *myshell_sidecar_path(const char *path, const char *suffix) {
+    size_t len = strlen(path) + strlen(suffix) + 1;
+    char *out = (char *)malloc(len);
+    if (out)
+        snprintf(out, len, "%s%s", path, suffix);
+    return out;
+}
+
+/**
+ * Rewrites the database applying every pending operation in ops: records
+ * whose key has a pending value are replaced in place, records whose key is
+ * pending deletion are dropped, and values for keys that were not found are
+ * appended at the end. The result is written to a temp file, synced once when
+ * durability is FSYNC and renamed over the database, so either all operations
+ * land or none do.
+ *
+ * Each op's 'applied' flag tells whether it matched an existing record. When
+ * require_match is set and no op matched, the database is left untouched and
+ * FOSSIL_MYSHELL_ERROR_NOT_FOUND is returned.
+ */
+static void myshell_index_apply(fossil_bluecrab_myshell_t *db, myshell_kvmap_t *ops);
+
+static fossil_bluecrab_myshell_error_t myshell_apply(fossil_bluecrab_myshell_t *db, myshell_kvmap_t *ops, bool require_match) {
+    for (myshell_kv_entry_t *op = ops->head; op; op = op->order_next) {
+        op->applied = false;
+        myshell_cache_invalidate((myshell_cache_t *)db->cache, op->key, op->hash);
+    }
+
+    char *temp_path = myshell_sidecar_path(db->path, ".tmp");
+    FILE *temp_file = temp_path ? fopen(temp_path, "wb") : NULL;
+    if (!temp_file) {
+        free(temp_path);
+        return FOSSIL_MYSHELL_ERROR_IO;
+    }
+
+    // Commit lines are copied unchanged, so their new offsets are noted on
+    // the way through instead of rescanning the rewritten file
+    myshell_commit_index_t *commits = (myshell_commit_index_t *)calloc(1, sizeof(myshell_commit_index_t));
+    long out_pos = 0;
+    bool line_start = true;
+
+    fseek(db->file, 0, SEEK_SET);
+    char line[1024];
+    bool matched = false;
+    bool write_failed = false;
+    while (fgets(line, sizeof(line), db->file)) {
+        size_t len = strlen(line);
+        char *line_end = line + len;
+        char *eq = (char *)fossil_bluecrab_scan_byte(line, len, '=');
+        if (eq) {
+            *eq = '\0';
+            char *hash_comment = myshell_find_tag(eq + 1, (size_t)(line_end - eq - 1), "#hash=");
+            uint64_t line_hash = 0;
+            if (hash_comment) {
+                line_hash = myshell_read_hash(hash_comment, line_end);
+            } else {
+                line_hash = fossil_bluecrab_hash64_legacy(line, (size_t)(eq - line));
+            }
+            myshell_kv_entry_t *op = myshell_kvmap_find(ops, line, line_hash);
+            if (op && op->deleted) {
+                // Only drop records whose FSON type (if any) is valid
+                char *type_comment = myshell_find_tag(eq + 1, (size_t)(line_end - eq - 1), "#type=");
+                bool valid_type = true;
+                if (hash_comment && type_comment) {
+                    char type_name[32] = {0};
+                    int i = 0;
+                    type_comment += 6;
+                    while (type_comment[i] && !isspace((unsigned char)type_comment[i]) && type_comment[i] != '#' && i < 31) {
+                        type_name[i] = type_comment[i];
+                        i++;
+                    }
+                    type_name[i] = '\0';
+                    valid_type = myshell_lookup_type(type_name, NULL);
+                }
+                if (valid_type) {
+                    op->applied = true;
+                    matched = true;
+                    continue;
+                }
+            } else if (op) {
+                int n = fprintf(temp_file, "%s=%s #type=%s #hash=%016" PRIx64 "\n",
+                                op->key, op->value, myshell_fson_type_to_string(op->type), op->hash);
+                if (n < 0)
+                    write_failed = true;
+                else
+                    out_pos += n;
+                line_start = true;
+                op->applied = true;
+                matched = true;
+                continue;
+            }
+            *eq = '='; // Restore
+        }
+        if (commits && line_start && !myshell_commit_index_note(commits, out_pos, line, len)) {
+            myshell_commit_index_free(commits);
+            commits = NULL;
+        }
+        if (fputs(line, temp_file) == EOF)
+            write_failed = true;
+        out_pos += (long)len;
+        line_start = len > 0 && line[len - 1] == '\n';
+    }
+    // A partial trailing line is left for myshell_commit_index_sync to judge
+    if (commits && !line_start) {
+        myshell_commit_index_free(commits);
+        commits = NULL;
+    }
+    if (commits)
+        commits->scanned = out_pos;
+
+    if (require_match && !matched) {
+        myshell_commit_index_free(commits);
+        fclose(temp_file);
+        remove(temp_path);
+        free(temp_path);
+        return FOSSIL_MYSHELL_ERROR_NOT_FOUND;
+    }
+
+    // Append values for keys that were not already present
+    for (myshell_kv_entry_t *op = ops->head; op; op = op->order_next) {
+        if (op->deleted || op->applied)
+            continue;
+        if (fprintf(temp_file, "%s=%s #type=%s #hash=%016" PRIx64 "\n",
+                    op->key, op->value, myshell_fson_type_to_string(op->type), op->hash) < 0)
+            write_failed = true;
+    }
+
+    // Only FSYNC pays for a sync here; PERIODIC leaves it to its worker
+    fossil_bluecrab_myshell_durability_t mode = myshell_durability_mode(db);
+    bool sync_failed = mode == FOSSIL_MYSHELL_DURABILITY_FSYNC ? fossil_bluecrab_sync_file(temp_file) != 0 : fflush(temp_file) != 0;
+    if (ferror(db->file) || write_failed || sync_failed) {
+        myshell_commit_index_free(commits);
+        fclose(temp_file);
+        remove(temp_path);
+        free(temp_path);
+        return FOSSIL_MYSHELL_ERROR_IO;
+    }
+    if (fclose(temp_file) != 0) {
+        myshell_commit_index_free(commits);
+        remove(temp_path);
+        free(temp_path);
+        return FOSSIL_MYSHELL_ERROR_IO;
+    }
+
+    fclose(db->file);
+    int replaced = myshell_replace_file(temp_path, db->path);
+    if (replaced != 0)
+        remove(temp_path);
+    free(temp_path);
+    if (replaced != 0) {
+        myshell_commit_index_free(commits);
+        db->file = fopen(db->path, "rb+");
+        return FOSSIL_MYSHELL_ERROR_IO;
+    }
+    myshell_commit_index_free((myshell_commit_index_t *)db->commit_index);
+    db->commit_index = commits;
+
+    bool dir_sync_failed = mode == FOSSIL_MYSHELL_DURABILITY_FSYNC && fossil_bluecrab_sync_parent_dir(db->path) != 0;
+
+    db->file = fopen(db->path, "rb+");
+    if (!db->file) {
+        db->is_open = false;
+        return FOSSIL_MYSHELL_ERROR_IO;
+    }
+    if (mode == FOSSIL_MYSHELL_DURABILITY_PERIODIC)
+        fossil_bluecrab_sync_worker_mark(((myshell_durability_t *)db->durability)->worker);
+
+    fseek(db->file, 0, SEEK_END);
+    db->file_size = (size_t)ftell(db->file);
+    db->last_modified = time(NULL);
+    // Revalidated in full when the sidecar is next written
+    db->validated_size = 0;
+    db->record_count = 0;
+    myshell_index_apply(db, ops);
+    // The rename stands either way; only its durability is in doubt
+    return dir_sync_failed ? FOSSIL_MYSHELL_ERROR_IO : FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
+
+// ===========================================================
+// Internal Validation Sidecar
+// ===========================================================
+
+/**
+ * On close, "<path>.meta" records how much of the file is known to be valid
+ * so the next open can skip re-checking it:
+ *   `#myshell_meta size=SIZE mtime=MTIME records=LINES tail=HASH`
+ * where HASH is myshell_hash64 of the (up to) 4 KiB that precede SIZE. Open
+ * trusts the sidecar only when the tail hash still matches; bytes appended
+ * after SIZE are validated normally.
+ *
+ * When the handle has a commit index it follows as
+ *   `#myshell_commits count=N scanned=SCANNED`
+ * and N `OFFSET HASH` lines, so log_range does not rescan after reopening.
+ */
+#define MYSHELL_META_WINDOW 4096
+
+typedef struct {
+    size_t    size;
+    long long mtime;
+    size_t    records;
+    uint64_t  tail;
+} myshell_meta_t;
+
+static bool myshell_meta_tail_hash(FILE *file, size_t size, uint64_t *out) {
+    char window[MYSHELL_META_WINDOW + 1];
+    size_t len = size < MYSHELL_META_WINDOW ? size : MYSHELL_META_WINDOW;
+    if (fseek(file, (long)(size - len), SEEK_SET) != 0)
+        return false;
+    if (fread(window, 1, len, file) != len)
+        return false;
+    window[len] = '\0';
+    *out = myshell_hash64(window);
+    return true;
+}
+
+/**
+ * Reads the commit section that may follow the sidecar header. Returns NULL
+ * when it is absent, malformed or reaches past 'size'.
+ */
+static myshell_commit_index_t *myshell_meta_read_commits(FILE *fp, size_t size) {
+    unsigned long long count = 0;
+    long scanned = 0;
+    if (fscanf(fp, " #myshell_commits count=%llu scanned=%ld", &count, &scanned) != 2 ||
+        scanned < 0 || (size_t)scanned > size)
+        return NULL;
+    myshell_commit_index_t *index = (myshell_commit_index_t *)calloc(1, sizeof(myshell_commit_index_t));
+    if (!index) return NULL;
+    index->scanned = scanned;
+    if (count > 0) {
+        index->items = (myshell_commit_ref_t *)malloc((size_t)count * sizeof(myshell_commit_ref_t));
+        index->capacity = index->items ? (size_t)count : 0;
+    }
+    while (index->count < index->capacity) {
+        myshell_commit_ref_t *ref = &index->items[index->count];
+        if (fscanf(fp, " %ld %" SCNx64, &ref->offset, &ref->hash) != 2 ||
+            ref->offset < 0 || ref->offset >= scanned ||
+            (index->count > 0 && ref->offset <= index->items[index->count - 1].offset))
+            break;
+        index->count++;
+    }
+    if (index->count != count) {
+        myshell_commit_index_free(index);
+        return NULL;
+    }
+    return index;
+}
+
+/**
+ * Reads the sidecar header and, when 'commits' is given, the commit index
+ * stored with it (*commits is NULL if there is none).
+ */
+static bool myshell_meta_read(const char *path, myshell_meta_t *meta, myshell_commit_index_t **commits) {
+    if (commits) *commits = NULL;
+    char *meta_path = myshell_sidecar_path(path, ".meta");
+    FILE *fp = meta_path ? fopen(meta_path, "rb") : NULL;
+    free(meta_path);
+    if (!fp) return false;
+    unsigned long long size = 0, records = 0;
+    int n = fscanf(fp, "#myshell_meta size=%llu mtime=%lld records=%llu tail=%" SCNx64,
+                   &size, &meta->mtime, &records, &meta->tail);
+    meta->size = (size_t)size;
+    meta->records = (size_t)records;
+    if (n == 4 && commits)
+        *commits = myshell_meta_read_commits(fp, meta->size);
+    fclose(fp);
+    return n == 4;
+}
+
+/**
+ * Checks #type= hints on every line from offset 'from' to EOF, adding the
+ * number of lines seen to *records.
+ */
+static bool myshell_validate_lines(FILE *file, long from, size_t *records) {
+    if (fseek(file, from, SEEK_SET) != 0)
+        return false;
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        if (strchr(line, '\n'))
+            (*records)++;
+        char *type_comment = strstr(line, "#type=");
+        if (type_comment) {
+            type_comment += 6;
+            char type_name[32] = {0};
+            int i = 0;
+            while (type_comment[i] && !isspace((unsigned char)type_comment[i]) && type_comment[i] != '#' && i < 31) {
+                type_name[i] = type_comment[i];
+                i++;
+            }
+            type_name[i] = '\0';
+            if (!myshell_lookup_type(type_name, NULL))
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Brings db->validated_size up to the end of the file and writes the sidecar.
+ * Any failure just removes the sidecar so the next open validates in full.
+ */
+static void myshell_meta_write(fossil_bluecrab_myshell_t *db) {
+    char *meta_path = myshell_sidecar_path(db->path, ".meta");
+    if (!meta_path) return;
+
+    myshell_meta_t meta = {0};
+    struct stat st;
+    bool ok = fflush(db->file) == 0 && stat(db->path, &st) == 0;
+    if (ok) {
+        meta.size = (size_t)st.st_size;
+        meta.mtime = (long long)st.st_mtime;
+        ok = meta.size >= db->validated_size;
+    }
+    if (ok && meta.size > db->validated_size) {
+        ok = myshell_validate_lines(db->file, (long)db->validated_size, &db->record_count);
+        db->validated_size = meta.size;
+    }
+    ok = ok && myshell_meta_tail_hash(db->file, meta.size, &meta.tail);
+
+    // Only an index the handle already has is saved; building one here would
+    // cost a full scan on every close
+    myshell_commit_index_t *commits = NULL;
+    if (ok && db->commit_index && myshell_commit_index_sync(db, &commits) != FOSSIL_MYSHELL_ERROR_SUCCESS)
+        commits = NULL;
+
+    FILE *fp = ok ? fopen(meta_path, "wb") : NULL;
+    if (!fp) {
+        remove(meta_path);
+        free(meta_path);
+        return;
+    }
+    int n = fprintf(fp, "#myshell_meta size=%llu mtime=%lld records=%llu tail=%016" PRIx64 "\n",
+                    (unsigned long long)meta.size, meta.mtime, (unsigned long long)db->record_count, meta.tail);
+    if (n >= 0 && commits && (size_t)commits->scanned <= meta.size) {
+        n = fprintf(fp, "#myshell_commits count=%llu scanned=%ld\n",
+                    (unsigned long long)commits->count, commits->scanned);
+        for (size_t i = 0; n >= 0 && i < commits->count; ++i) {
+            n = fprintf(fp, "%ld %016" PRIx64 "\n", commits->items[i].offset, commits->items[i].hash);
+        }
+    }
+    if (fclose(fp) != 0 || n < 0) {
+        remove(meta_path);
+    }
+    free(meta_path);
+}
+
+// ===========================================================
+// Internal Query Engine
+// ===========================================================
+
+/*
+ * Grammar (keywords are case-insensitive):
+ *
+ *   query     := SELECT columns [FROM name] [WHERE or_expr] [LIMIT n] [';']
+ *   columns   := '*' | column (',' column)*
+ *   column    := key | value | type
+ *   or_expr   := and_expr (OR and_expr)*
+ *   and_expr  := unary (AND unary)*
+ *   unary     := NOT unary | '(' or_expr ')' | column op literal
+ *   op        := = | != | <> | < | <= | > | >= | LIKE
+ *   literal   := 'text' | "text" | number | bareword
+ *
+ * The WHERE clause goes through the parser in query.c, shared with NoShell,
+ * with the columns as its fields. The compiled predicate tree is evaluated
+ * against each record while it is still in the scanner's line buffer, so
+ * rows that don't match are never copied or handed to the callback. Numeric
+ * literals compare numerically (rows whose value is not a number fail
+ * ordering predicates); text literals compare bytewise. LIKE supports '%'
+ * and '_' wildcards.
+ */
+
+enum {
+    MYSHELL_COL_KEY   = 1,
+    MYSHELL_COL_VALUE = 2,
+    MYSHELL_COL_TYPE  = 4
+};
+
+typedef struct {
+    unsigned columns;
+    fossil_bluecrab_query_pred_t *where;
+    bool has_limit;
+    size_t limit;
+    const char *point_key;            // top-level "key = literal": at most one row
+} myshell_query_t;
+
+typedef struct {
+    const char *key;
+    const char *type;
+    const char *value;
+} myshell_record_t;
+
+static const fossil_bluecrab_query_syntax_t myshell_query_syntax = { "", "=<>(),*;" };
+
+static int myshell_lex_column(fossil_bluecrab_query_lexer_t *lx) {
+    int column = fossil_bluecrab_query_lex_is(lx, "key")   ? MYSHELL_COL_KEY
+               : fossil_bluecrab_query_lex_is(lx, "value") ? MYSHELL_COL_VALUE
+               : fossil_bluecrab_query_lex_is(lx, "type")  ? MYSHELL_COL_TYPE : 0;
+    if (column) fossil_bluecrab_query_lex_next(lx);
+    return column;
+}
+
+/** WHERE fields are the record columns. */
+static bool myshell_query_field(fossil_bluecrab_query_lexer_t *lx, fossil_bluecrab_query_pred_t *pred) {
+    pred->column = myshell_lex_column(lx);
+    return pred->column != 0;
+}
+
+/**
+ * Finds "key = literal" among the top-level AND terms. Numeric literals
+ * do not count: "key = 1" matches "1", "1.0" and "01" alike, so it names
+ * no single key.
+ */
+static const char *myshell_query_point_key(const fossil_bluecrab_query_pred_t *pred) {
+    if (!pred) return NULL;
+    if (pred->kind == FOSSIL_QUERY_PRED_CMP)
+        return (pred->column == MYSHELL_COL_KEY && pred->op == FOSSIL_QUERY_CMP_EQ && !pred->numeric) ? pred->literal : NULL;
+    if (pred->kind != FOSSIL_QUERY_PRED_AND) return NULL;
+    const char *key = myshell_query_point_key(pred->left);
+    return key ? key : myshell_query_point_key(pred->right);
+}
+
+static void myshell_query_free(myshell_query_t *q) {
+    fossil_bluecrab_query_pred_free(q->where);
+    memset(q, 0, sizeof(*q));
+}
+
+static fossil_bluecrab_myshell_error_t myshell_query_parse(const char *sql, myshell_query_t *q) {
+    memset(q, 0, sizeof(*q));
+    fossil_bluecrab_query_lexer_t lx;
+    fossil_bluecrab_query_lex_init(&lx, sql, &myshell_query_syntax);
+
+    if (!fossil_bluecrab_query_lex_accept(&lx, "SELECT"))
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    if (fossil_bluecrab_query_lex_accept(&lx, "*")) {
+        q->columns = MYSHELL_COL_KEY | MYSHELL_COL_VALUE | MYSHELL_COL_TYPE;
+    } else {
+        do {
+            int column = myshell_lex_column(&lx);
+            if (!column) return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+            q->columns |= (unsigned)column;
+        } while (fossil_bluecrab_query_lex_accept(&lx, ","));
+    }
+
+    if (fossil_bluecrab_query_lex_accept(&lx, "FROM")) {
+        if (lx.kind != FOSSIL_QUERY_TOK_IDENT) return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+        fossil_bluecrab_query_lex_next(&lx);
+    }
+
+    if (fossil_bluecrab_query_lex_accept(&lx, "WHERE")) {
+        q->where = fossil_bluecrab_query_parse_where(&lx, myshell_query_field);
+        if (!q->where)
+            return lx.oom ? FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY : FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+        q->point_key = myshell_query_point_key(q->where);
+    }
+
+    if (fossil_bluecrab_query_lex_accept(&lx, "LIMIT")) {
+        bool integral = false;
+        long long n = 0;
+        double d = 0;
+        char digits[32];
+        if (lx.kind != FOSSIL_QUERY_TOK_NUMBER || lx.len >= sizeof(digits)) {
+            myshell_query_free(q);
+            return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+        }
+        memcpy(digits, lx.start, lx.len);
+        digits[lx.len] = '\0';
+        if (!fossil_bluecrab_query_parse_number(digits, &integral, &n, &d) || !integral || n < 0) {
+            myshell_query_free(q);
+            return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+        }
+        q->has_limit = true;
+        q->limit = (size_t)n;
+        fossil_bluecrab_query_lex_next(&lx);
+    }
+
+    fossil_bluecrab_query_lex_accept(&lx, ";");
+    if (lx.kind != FOSSIL_QUERY_TOK_END) {
+        myshell_query_free(q);
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
+
+/** SQL LIKE: '%' matches any run, '_' any single character. */
+static bool myshell_pred_eval(const fossil_bluecrab_query_pred_t *pred, const myshell_record_t *rec) {
+    switch (pred->kind) {
+        case FOSSIL_QUERY_PRED_AND: return myshell_pred_eval(pred->left, rec) && myshell_pred_eval(pred->right, rec);
+        case FOSSIL_QUERY_PRED_OR:  return myshell_pred_eval(pred->left, rec) || myshell_pred_eval(pred->right, rec);
+        case FOSSIL_QUERY_PRED_NOT: return !myshell_pred_eval(pred->left, rec);
+        case FOSSIL_QUERY_PRED_CMP: break;
+    }
+
+    const char *field = pred->column == MYSHELL_COL_KEY ? rec->key
+                      : pred->column == MYSHELL_COL_TYPE ? rec->type : rec->value;
+    return fossil_bluecrab_query_compare(pred, field, strlen(field));
+}
+
+/**
+ * Splits a "key=value #type=T #hash=H" line in place. Metadata lines
+ * (leading '#') and lines without '=' are not records.
+ */
+static bool myshell_record_parse(char *line, myshell_record_t *rec) {
+    if (line[0] == '#') return false;
+    size_t len = strlen(line);
+    char *eq = (char *)fossil_bluecrab_scan_byte(line, len, '=');
+    if (!eq) return false;
+    *eq = '\0';
+    char *value = eq + 1;
+    size_t value_len = len - (size_t)(value - line);
+
+    char *type_comment = myshell_find_tag(value, value_len, "#type=");
+    char *hash_comment = type_comment ? NULL : myshell_find_tag(value, value_len, "#hash=");
+    char *value_end = type_comment ? type_comment : hash_comment ? hash_comment : (char *)fossil_bluecrab_scan_byte(value, value_len, '#');
+    if (!value_end) value_end = value + value_len;
+
+    rec->type = "";
+    if (type_comment) {
+        char *type = type_comment + 6;
+        type[strcspn(type, " \t\r\n")] = '\0';
+        rec->type = type;
+    }
+    while (value_end > value && (value_end[-1] == '\n' || value_end[-1] == '\r' || value_end[-1] == ' '))
+        value_end--;
+    *value_end = '\0';
+
+    rec->key = line;
+    rec->value = value;
+    return true;
+}
+
+// ===========================================================
+// Internal Secondary Indexes
+// ===========================================================
+
+/*
+ * Each index keeps two structures:
+ *   forward  key -> indexed value (myshell_kvmap_t); finds the old entry
+ *            when a key is rewritten or deleted.
+ *   entries  (value, key) pairs sorted by value, then key. Values that parse
+ *            as numbers order numerically and before all other values, which
+ *            order with strcmp. Equality and range lookups binary-search it.
+ *            Builds and loads append and sort once, but a single write finds
+ *            its slot by binary search and then memmoves the entries behind
+ *            it, so keeping an index current costs O(k) per indexed put or
+ *            del (k = entries). The shift is one flat copy of small
+ *            fixed-size entries, which stays well below the cost of the
+ *            write itself for indexes that fit in memory.
+ *
+ * myshell_apply (put, del, txn commit) feeds every successful write through
+ * myshell_index_apply. On close each index is saved to "<path>.<name>.idx":
+ *   `#myshell_index name=NAME type=TYPE extractor=ID size=SIZE mtime=MTIME tail=HASH count=N`
+ * followed by N lines `TYPE VLEN KLEN VALUEKEY`. ID names what produced the
+ * values: `whole`, `fson:FIELD` for the built-in field extractor, or
+ * `custom:VERSION` for a caller's extractor with a version tag. create_index
+ * reuses the file when NAME, TYPE and ID match and SIZE/MTIME/TAIL still
+ * describe the database, and rebuilds it otherwise. An untagged custom
+ * extractor has no ID, so its index is never saved or loaded.
+ */
+#define MYSHELL_INDEX_VALUE_MAX 1024
+#define MYSHELL_INDEX_NAME_MAX  64
+#define MYSHELL_INDEX_ID_MAX    255
+
+typedef struct {
+    char *value;
+    char *key;
+    fossil_bluecrab_myshell_fson_type_t type;
+    bool numeric;
+    bool integral;
+    long long ival;
+    double dval;
+} myshell_index_entry_t;
+
+typedef struct myshell_index_t {
+    char *name;
+    char *type_filter;                         // NULL = every type
+    fossil_myshell_index_extractor_t extractor; // NULL = whole value
+    void *user;
+    char *identity;                            // NULL = not persisted
+    myshell_kvmap_t *forward;
+    myshell_index_entry_t *entries;
+    size_t count;
+    size_t capacity;
+    struct myshell_index_t *next;
+} myshell_index_t;
+
+static void myshell_index_classify(myshell_index_entry_t *entry) {
+    entry->numeric = fossil_bluecrab_query_parse_number(entry->value, &entry->integral, &entry->ival, &entry->dval) &&
+                     (entry->integral || entry->dval == entry->dval);  // NaN orders as text
+}
+
+/** Orders by value only; equal numbers compare equal whatever their spelling. */
+static int myshell_index_cmp_value(const myshell_index_entry_t *a, const myshell_index_entry_t *b) {
+    if (a->numeric && b->numeric) {
+        if (a->integral && b->integral)
+            return (a->ival > b->ival) - (a->ival < b->ival);
+        return (a->dval > b->dval) - (a->dval < b->dval);
+    }
+    if (a->numeric != b->numeric)
+        return a->numeric ? -1 : 1;
+    return strcmp(a->value, b->value);
+}
+
+static int myshell_index_cmp(const void *lhs, const void *rhs) {
+    const myshell_index_entry_t *a = (const myshell_index_entry_t *)lhs;
+    const myshell_index_entry_t *b = (const myshell_index_entry_t *)rhs;
+    int c = myshell_index_cmp_value(a, b);
+    if (c == 0) c = strcmp(a->value, b->value);
+    if (c == 0) c = strcmp(a->key, b->key);
+    return c;
+}
+
+/** First position whose entry is not less than probe (by value only if !full). */
+static size_t myshell_index_lower_bound(const myshell_index_t *idx, const myshell_index_entry_t *probe, bool full) {
+    size_t lo = 0, hi = idx->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = full ? myshell_index_cmp(&idx->entries[mid], probe)
+                     : myshell_index_cmp_value(&idx->entries[mid], probe);
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void myshell_index_free(myshell_index_t *idx) {
+    if (!idx) return;
+    for (size_t i = 0; i < idx->count; ++i) {
+        free(idx->entries[i].value);
+        free(idx->entries[i].key);
+    }
+    free(idx->entries);
+    myshell_kvmap_free(idx->forward);
+    free(idx->name);
+    free(idx->type_filter);
+    free(idx->identity);
+    free(idx);
+}
+
+/** "<path>.<name>.idx", allocated like myshell_sidecar_path. */
+static char *myshell_index_path(const char *path, const char *name) {
+    size_t len = strlen(path) + strlen(name) + sizeof("..idx");
+    char *out = (char *)malloc(len);
+    if (out)
+        snprintf(out, len, "%s.%s.idx", path, name);
+    return out;
+}
+
+static myshell_index_t *myshell_index_find(const fossil_bluecrab_myshell_t *db, const char *name) {
+    for (myshell_index_t *idx = (myshell_index_t *)db->indexes; idx; idx = idx->next) {
+        if (strcmp(idx->name, name) == 0)
+            return idx;
+    }
+    return NULL;
+}
+
+/** Appends without keeping order; callers sort afterwards. */
+static bool myshell_index_push(myshell_index_t *idx, const char *key, fossil_bluecrab_myshell_fson_type_t type, const char *value) {
+    if (idx->count == idx->capacity) {
+        size_t capacity = idx->capacity ? idx->capacity * 2 : 64;
+        myshell_index_entry_t *grown = (myshell_index_entry_t *)realloc(idx->entries, capacity * sizeof(*grown));
+        if (!grown) return false;
+        idx->entries = grown;
+        idx->capacity = capacity;
+    }
+    myshell_index_entry_t *entry = &idx->entries[idx->count];
+    entry->value = myshell_strdup(value);
+    entry->key = myshell_strdup(key);
+    entry->type = type;
+    if (!entry->value || !entry->key ||
+        !myshell_kvmap_set(idx->forward, key, myshell_hash64(key), type, value)) {
+        free(entry->value);
+        free(entry->key);
+        return false;
+    }
+    myshell_index_classify(entry);
+    idx->count++;
+    return true;
+}
+
+static void myshell_index_remove_key(myshell_index_t *idx, const char *key, uint64_t hash) {
+    myshell_kv_entry_t *old = myshell_kvmap_find(idx->forward, key, hash);
+    if (!old) return;
+    myshell_index_entry_t probe = { old->value, (char *)key, old->type, false, false, 0, 0 };
+    myshell_index_classify(&probe);
+    size_t pos = myshell_index_lower_bound(idx, &probe, true);
+    if (pos < idx->count && myshell_index_cmp(&idx->entries[pos], &probe) == 0) {
+        free(idx->entries[pos].value);
+        free(idx->entries[pos].key);
+        memmove(&idx->entries[pos], &idx->entries[pos + 1], (idx->count - pos - 1) * sizeof(*idx->entries));
+        idx->count--;
+    }
+    myshell_kvmap_remove(idx->forward, key, hash);
+}
+
+/** Runs the type filter and extractor; false if the record is not indexed. */
+static bool myshell_index_extract(const myshell_index_t *idx, const char *key, const char *type,
+                                  const char *value, char *out, size_t out_size) {
+    if (idx->type_filter && strcmp(idx->type_filter, type) != 0)
+        return false;
+    if (!idx->extractor) {
+        if (strlen(value) >= out_size) return false;
+        strcpy(out, value);
+        return true;
+    }
+    out[0] = '\0';
+    return idx->extractor(key, type, value, out, out_size, idx->user);
+}
+
+static bool myshell_index_upsert(myshell_index_t *idx, const char *key, uint64_t hash,
+                                 fossil_bluecrab_myshell_fson_type_t type, const char *value) {
+    myshell_index_remove_key(idx, key, hash);
+    char extracted[MYSHELL_INDEX_VALUE_MAX];
+    if (!myshell_index_extract(idx, key, myshell_fson_type_to_string(type), value, extracted, sizeof(extracted)))
+        return true;
+    if (!myshell_index_push(idx, key, type, extracted))
+        return false;
+    // Move the appended entry into place (O(k), see the section comment)
+    myshell_index_entry_t entry = idx->entries[idx->count - 1];
+    size_t pos = myshell_index_lower_bound(idx, &entry, true);
+    if (pos < idx->count - 1) {
+        memmove(&idx->entries[pos + 1], &idx->entries[pos], (idx->count - 1 - pos) * sizeof(*idx->entries));
+        idx->entries[pos] = entry;
+    }
+    return true;
+}
+
+static void myshell_index_apply(fossil_bluecrab_myshell_t *db, myshell_kvmap_t *ops) {
+    for (myshell_index_t *idx = (myshell_index_t *)db->indexes; idx; idx = idx->next) {
+        for (myshell_kv_entry_t *op = ops->head; op; op = op->order_next) {
+            if (op->deleted) {
+                if (op->applied)
+                    myshell_index_remove_key(idx, op->key, op->hash);
+            } else if (!myshell_index_upsert(idx, op->key, op->hash, op->type, op->value)) {
+                // Out of memory: drop the key rather than leave a stale value behind
+                myshell_index_remove_key(idx, op->key, op->hash);
+            }
+        }
+    }
+}
+
+static fossil_bluecrab_myshell_error_t myshell_index_build(fossil_bluecrab_myshell_t *db, myshell_index_t *idx) {
+    char line[1024];
+    char extracted[MYSHELL_INDEX_VALUE_MAX];
+    fseek(db->file, 0, SEEK_SET);
+    while (fgets(line, sizeof(line), db->file)) {
+        myshell_record_t rec;
+        fossil_bluecrab_myshell_fson_type_t type;
+        if (!myshell_record_parse(line, &rec) || !myshell_lookup_type(rec.type, &type))
+            continue;
+        uint64_t hash = myshell_hash64(rec.key);
+        if (myshell_kvmap_find(idx->forward, rec.key, hash))
+            continue;  // first record wins, as in get
+        if (!myshell_index_extract(idx, rec.key, rec.type, rec.value, extracted, sizeof(extracted)))
+            continue;
+        if (!myshell_index_push(idx, rec.key, type, extracted))
+            return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    qsort(idx->entries, idx->count, sizeof(*idx->entries), myshell_index_cmp);
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
+
+/** Current size/mtime/tail of the database, as recorded in index files. */
+static bool myshell_index_stamp(fossil_bluecrab_myshell_t *db, myshell_meta_t *stamp) {
+    struct stat st;
+    if (fflush(db->file) != 0 || stat(db->path, &st) != 0)
+        return false;
+    stamp->size = (size_t)st.st_size;
+    stamp->mtime = (long long)st.st_mtime;
+    return myshell_meta_tail_hash(db->file, stamp->size, &stamp->tail);
+}
+
+static bool myshell_index_load(fossil_bluecrab_myshell_t *db, myshell_index_t *idx) {
+    char *idx_path = myshell_index_path(db->path, idx->name);
+    FILE *fp = idx_path ? fopen(idx_path, "rb") : NULL;
+    free(idx_path);
+    if (!fp) return false;
+
+    myshell_meta_t stamp = {0}, saved = {0};
+    char name[MYSHELL_INDEX_NAME_MAX + 1] = {0}, type[32] = {0}, identity[MYSHELL_INDEX_ID_MAX + 1] = {0};
+    unsigned long long size = 0, count = 0;
+    bool ok = idx->identity &&
+              fscanf(fp, "#myshell_index name=%64s type=%31s extractor=%255s size=%llu mtime=%lld tail=%" SCNx64 " count=%llu",
+                     name, type, identity, &size, &saved.mtime, &saved.tail, &count) == 7 &&
+              myshell_index_stamp(db, &stamp) &&
+              strcmp(name, idx->name) == 0 &&
+              strcmp(type, idx->type_filter ? idx->type_filter : "*") == 0 &&
+              strcmp(identity, idx->identity) == 0 &&
+              (size_t)size == stamp.size && saved.mtime == stamp.mtime && saved.tail == stamp.tail;
+
+    char *value = NULL, *key = NULL;
+    for (unsigned long long i = 0; ok && i < count; ++i) {
+        char type_name[32];
+        size_t vlen = 0, klen = 0;
+        fossil_bluecrab_myshell_fson_type_t entry_type;
+        // Exactly one separator: values and keys may start with whitespace
+        ok = fscanf(fp, " %31s %zu %zu", type_name, &vlen, &klen) == 3 && fgetc(fp) == ' ' &&
+             myshell_lookup_type(type_name, &entry_type) &&
+             vlen < MYSHELL_INDEX_VALUE_MAX && klen < MYSHELL_INDEX_VALUE_MAX;
+        if (!ok) break;
+        value = (char *)malloc(vlen + 1);
+        key = (char *)malloc(klen + 1);
+        ok = value && key && fread(value, 1, vlen, fp) == vlen && fread(key, 1, klen, fp) == klen;
+        if (ok) {
+            value[vlen] = '\0';
+            key[klen] = '\0';
+            ok = myshell_index_push(idx, key, entry_type, value);
+        }
+        free(value);
+        free(key);
+        value = key = NULL;
+    }
+    fclose(fp);
+
+    if (!ok) {
+        // Leave an empty index behind for the rebuild
+        for (size_t i = 0; i < idx->count; ++i) {
+            free(idx->entries[i].value);
+            free(idx->entries[i].key);
+        }
+        idx->count = 0;
+        myshell_kvmap_clear(idx->forward);
+        return false;
+    }
+    qsort(idx->entries, idx->count, sizeof(*idx->entries), myshell_index_cmp);
+    return true;
+}
+
+static void myshell_index_save(fossil_bluecrab_myshell_t *db, const myshell_index_t *idx) {
+    char *idx_path = myshell_index_path(db->path, idx->name);
+    if (!idx_path) return;
+    myshell_meta_t stamp = {0};
+    FILE *fp = idx->identity && myshell_index_stamp(db, &stamp) ? fopen(idx_path, "wb") : NULL;
+    if (!fp) {
+        remove(idx_path);
+        free(idx_path);
+        return;
+    }
+    bool ok = fprintf(fp, "#myshell_index name=%s type=%s extractor=%s size=%llu mtime=%lld tail=%016" PRIx64 " count=%llu\n",
+                      idx->name, idx->type_filter ? idx->type_filter : "*", idx->identity, (unsigned long long)stamp.size,
+                      stamp.mtime, stamp.tail, (unsigned long long)idx->count) > 0;
+    for (size_t i = 0; ok && i < idx->count; ++i) {
+        const myshell_index_entry_t *e = &idx->entries[i];
+        ok = fprintf(fp, "%s %zu %zu %s%s\n", myshell_fson_type_to_string(e->type),
+                     strlen(e->value), strlen(e->key), e->value, e->key) > 0;
+    }
+    if (fclose(fp) != 0 || !ok) {
+        remove(idx_path);
+    }
+    free(idx_path);
+}
+
+/**
+ * Names the extractor for the index file header (see above), or NULL when it
+ * cannot be named: an untagged custom extractor, or an id that would not
+ * survive the header's whitespace-separated format.
+ */
+static char *myshell_index_identity(fossil_myshell_index_extractor_t extractor, void *user, const char *version) {
+    const char *prefix, *tail;
+    if (!extractor) {
+        prefix = "whole";
+        tail = "";
+    } else if (extractor == fossil_myshell_index_fson_field) {
+        if (!user) return NULL;
+        prefix = "fson:";
+        tail = (const char *)user;
+    } else {
+        if (!version) return NULL;
+        prefix = "custom:";
+        tail = version;
+    }
+    size_t prefix_len = strlen(prefix), tail_len = strlen(tail);
+    if (prefix_len + tail_len > MYSHELL_INDEX_ID_MAX) return NULL;
+    for (size_t i = 0; i < tail_len; ++i) {
+        if (isspace((unsigned char)tail[i])) return NULL;
+    }
+    char *identity = (char *)malloc(prefix_len + tail_len + 1);
+    if (!identity) return NULL;
+    memcpy(identity, prefix, prefix_len);
+    memcpy(identity + prefix_len, tail, tail_len + 1);
+    return identity;
+}
+
+static bool myshell_index_name_valid(const char *name) {
+    size_t len = strlen(name);
+    if (len == 0 || len > MYSHELL_INDEX_NAME_MAX) return false;
+    for (size_t i = 0; i < len; ++i) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_' && name[i] != '-')
+            return false;
+    }
+    return true;
+}
+
+// ===========================================================
+// Internal Aggregates
+// ===========================================================
+
+/*
+ * Matching values are decoded into fixed-size columns (int64 or double) and
+ * each full column is reduced by a batch kernel, so the per-record work in
+ * the scan loop is just the prefix/type test and number decoding.
+ *
+ * Unsigned values are stored biased (x ^ 2^63) so one signed min/max kernel
+ * serves both; the bias is removed when results are merged. Integer sums
+ * wrap modulo 2^64. Floating-point sums are accumulated in vector lanes and
+ * may differ from a strictly sequential sum in the last bits.
+ */
+#define MYSHELL_AGG_BATCH 1024
+#define MYSHELL_AGG_BIAS  0x8000000000000000ULL
+
+typedef enum {
+    MYSHELL_AGG_SIGNED,
+    MYSHELL_AGG_UNSIGNED,
+    MYSHELL_AGG_FLOAT
+} myshell_agg_kind_t;
+
+typedef struct {
+    myshell_agg_kind_t kind;
+    fossil_myshell_agg_op_t op;
+    size_t n;
+    int64_t ints[MYSHELL_AGG_BATCH];
+    double floats[MYSHELL_AGG_BATCH];
+
+    uint64_t count;
+    uint64_t isum;            // wrapping sum of the (biased) integer column
+    int64_t imin, imax;
+    double fsum, fmin, fmax;
+} myshell_agg_t;
+
+static uint64_t myshell_sum_i64(const int64_t *v, size_t n) {
+    size_t i = 0;
+    uint64_t total = 0;
+#if defined(MYSHELL_HAVE_SSE2)
+    __m128i a0 = _mm_setzero_si128(), a1 = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        a0 = _mm_add_epi64(a0, _mm_loadu_si128((const __m128i *)(v + i)));
+        a1 = _mm_add_epi64(a1, _mm_loadu_si128((const __m128i *)(v + i + 2)));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(a0, a1));
+    total = lanes[0] + lanes[1];
+#elif defined(MYSHELL_HAVE_NEON)
+    int64x2_t a0 = vdupq_n_s64(0), a1 = vdupq_n_s64(0);
+    for (; i + 4 <= n; i += 4) {
+        a0 = vaddq_s64(a0, vld1q_s64(v + i));
+        a1 = vaddq_s64(a1, vld1q_s64(v + i + 2));
+    }
+    int64x2_t a = vaddq_s64(a0, a1);
+    total = (uint64_t)vgetq_lane_s64(a, 0) + (uint64_t)vgetq_lane_s64(a, 1);
+#endif
+    for (; i < n; ++i)
+        total += (uint64_t)v[i];
+    return total;
+}
+
+static void myshell_minmax_i64(const int64_t *v, size_t n, int64_t *out_min, int64_t *out_max) {
+    size_t i = 0;
+    int64_t mn = v[0], mx = v[0];
+#if defined(MYSHELL_HAVE_SSE42)
+    __m128i vmin = _mm_set1_epi64x(mn), vmax = vmin;
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(v + i));
+        vmin = _mm_blendv_epi8(vmin, x, _mm_cmpgt_epi64(vmin, x));
+        vmax = _mm_blendv_epi8(vmax, x, _mm_cmpgt_epi64(x, vmax));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, vmin);
+    mn = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    _mm_storeu_si128((__m128i *)lanes, vmax);
+    mx = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+#elif defined(MYSHELL_HAVE_NEON)
+    int64x2_t vmin = vdupq_n_s64(mn), vmax = vmin;
+    for (; i + 2 <= n; i += 2) {
+        int64x2_t x = vld1q_s64(v + i);
+        vmin = vbslq_s64(vcgtq_s64(vmin, x), x, vmin);
+        vmax = vbslq_s64(vcgtq_s64(x, vmax), x, vmax);
+    }
+    int64_t l0 = vgetq_lane_s64(vmin, 0), l1 = vgetq_lane_s64(vmin, 1);
+    mn = l0 < l1 ? l0 : l1;
+    l0 = vgetq_lane_s64(vmax, 0);
+    l1 = vgetq_lane_s64(vmax, 1);
+    mx = l0 > l1 ? l0 : l1;
+#else
+    // Four independent lanes keep the compare chains short
+    int64_t m0 = mn, m1 = mn, m2 = mn, m3 = mn, x0 = mx, x1 = mx, x2 = mx, x3 = mx;
+    for (; i + 4 <= n; i += 4) {
+        m0 = v[i] < m0 ? v[i] : m0;             x0 = v[i] > x0 ? v[i] : x0;
+        m1 = v[i + 1] < m1 ? v[i + 1] : m1;     x1 = v[i + 1] > x1 ? v[i + 1] : x1;
+        m2 = v[i + 2] < m2 ? v[i + 2] : m2;     x2 = v[i + 2] > x2 ? v[i + 2] : x2;
+        m3 = v[i + 3] < m3 ? v[i + 3] : m3;     x3 = v[i + 3] > x3 ? v[i + 3] : x3;
+    }
+    m0 = m0 < m1 ? m0 : m1;  m2 = m2 < m3 ? m2 : m3;  mn = m0 < m2 ? m0 : m2;
+    x0 = x0 > x1 ? x0 : x1;  x2 = x2 > x3 ? x2 : x3;  mx = x0 > x2 ? x0 : x2;
+#endif
+    for (; i < n; ++i) {
+        if (v[i] < mn) mn = v[i];
+        if (v[i] > mx) mx = v[i];
+    }
+    *out_min = mn;
+    *out_max = mx;
+}
+
+static double myshell_sum_f64(const double *v, size_t n) {
+    size_t i = 0;
+    double total = 0.0;
+#if defined(MYSHELL_HAVE_SSE2)
+    __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+    for (; i + 4 <= n; i += 4) {
+        a0 = _mm_add_pd(a0, _mm_loadu_pd(v + i));
+        a1 = _mm_add_pd(a1, _mm_loadu_pd(v + i + 2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(a0, a1));
+    total = lanes[0] + lanes[1];
+#elif defined(MYSHELL_HAVE_NEON)
+    float64x2_t a0 = vdupq_n_f64(0.0), a1 = vdupq_n_f64(0.0);
+    for (; i + 4 <= n; i += 4) {
+        a0 = vaddq_f64(a0, vld1q_f64(v + i));
+        a1 = vaddq_f64(a1, vld1q_f64(v + i + 2));
+    }
+    total = vaddvq_f64(vaddq_f64(a0, a1));
+#endif
+    for (; i < n; ++i)
+        total += v[i];
+    return total;
+}
+
+static void myshell_minmax_f64(const double *v, size_t n, double *out_min, double *out_max) {
+    size_t i = 0;
+    double mn = v[0], mx = v[0];
+#if defined(MYSHELL_HAVE_SSE2)
+    __m128d vmin = _mm_set1_pd(mn), vmax = vmin;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(v + i);
+        vmin = _mm_min_pd(vmin, x);
+        vmax = _mm_max_pd(vmax, x);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, vmin);
+    mn = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    _mm_storeu_pd(lanes, vmax);
+    mx = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+#elif defined(MYSHELL_HAVE_NEON)
+    float64x2_t vmin = vdupq_n_f64(mn), vmax = vmin;
+    for (; i + 2 <= n; i += 2) {
+        float64x2_t x = vld1q_f64(v + i);
+        vmin = vminq_f64(vmin, x);
+        vmax = vmaxq_f64(vmax, x);
+    }
+    mn = vminvq_f64(vmin);
+    mx = vmaxvq_f64(vmax);
+#endif
+    for (; i < n; ++i) {
+        if (v[i] < mn) mn = v[i];
+        if (v[i] > mx) mx = v[i];
+    }
+    *out_min = mn;
+    *out_max = mx;
+}
+
+/** Reduces the buffered column into the running totals. */
+static void myshell_agg_flush(myshell_agg_t *agg) {
+    size_t n = agg->n;
+    if (n == 0) return;
+    bool first = agg->count == 0;
+    agg->count += n;
+    agg->n = 0;
+    if (agg->op == FOSSIL_MYSHELL_AGG_COUNT) return;
+
+    if (agg->kind == MYSHELL_AGG_FLOAT) {
+        if (agg->op == FOSSIL_MYSHELL_AGG_SUM || agg->op == FOSSIL_MYSHELL_AGG_AVG) {
+            agg->fsum += myshell_sum_f64(agg->floats, n);
+        } else {
+            double mn, mx;
+            myshell_minmax_f64(agg->floats, n, &mn, &mx);
+            if (first || mn < agg->fmin) agg->fmin = mn;
+            if (first || mx > agg->fmax) agg->fmax = mx;
+        }
+    } else {
+        if (agg->op == FOSSIL_MYSHELL_AGG_SUM || agg->op == FOSSIL_MYSHELL_AGG_AVG) {
+            agg->isum += myshell_sum_i64(agg->ints, n);
+            // AVG also needs a sum that does not wrap
+            if (agg->op == FOSSIL_MYSHELL_AGG_AVG) {
+                for (size_t i = 0; i < n; ++i) {
+                    agg->fsum += agg->kind == MYSHELL_AGG_UNSIGNED
+                        ? (double)((uint64_t)agg->ints[i] ^ MYSHELL_AGG_BIAS) : (double)agg->ints[i];
+                }
+            }
+        } else {
+            int64_t mn, mx;
+            myshell_minmax_i64(agg->ints, n, &mn, &mx);
+            if (first || mn < agg->imin) agg->imin = mn;
+            if (first || mx > agg->imax) agg->imax = mx;
+        }
+    }
+}
+
+/** Decodes a decimal integer without the locale/errno overhead of strtoll. */
+static bool myshell_agg_parse_int(const char *s, bool is_unsigned, int64_t *out) {
+    bool neg = false;
+    if (*s == '-' || *s == '+') {
+        neg = *s == '-';
+        s++;
+    }
+    if (!isdigit((unsigned char)*s)) return false;
+    uint64_t v = 0;
+    while (isdigit((unsigned char)*s)) {
+        uint64_t d = (uint64_t)(*s++ - '0');
+        if (v > (UINT64_MAX - d) / 10) return false;
+        v = v * 10 + d;
+    }
+    if (*s != '\0') return false;
+    if (is_unsigned) {
+        if (neg && v != 0) return false;
+        *out = (int64_t)(v ^ MYSHELL_AGG_BIAS);
+        return true;
+    }
+    if (neg ? v > MYSHELL_AGG_BIAS : v >= MYSHELL_AGG_BIAS) return false;
+    *out = neg ? (int64_t)(0 - v) : (int64_t)v;
+    return true;
+}
+
 fossil_bluecrab_myshell_t *fossil_myshell_open(const char *path, fossil_bluecrab_myshell_error_t *err) {
     if (!path) {
         if (err) *err = FOSSIL_MYSHELL_ERROR_INVALID_FILE;
@@ -251,167 +2260,918 @@ fossil_bluecrab_myshell_t *fossil_myshell_open(const char *path, fossil_bluecrab
     db->file = file;
     db->is_open = true;
 
-    if (fseek(file, 0, SEEK_END) != 0) {
-        free(db->path);
-        free(db);
-        fclose(file);
-        if (err) *err = FOSSIL_MYSHELL_ERROR_IO;
-        return NULL;
+    if (fseek(file, 0, SEEK_END) != 0) {
+        free(db->path);
+        free(db);
+        fclose(file);
+        if (err) *err = FOSSIL_MYSHELL_ERROR_IO;
+        return NULL;
+    }
+    db->file_size = (size_t)ftell(file);
+    if (fseek(file, 0, SEEK_SET) != 0) {
+        free(db->path);
+        free(db);
+        fclose(file);
+        if (err) *err = FOSSIL_MYSHELL_ERROR_IO;
+        return NULL;
+    }
+
+    struct stat st;
+    if (stat(path, &st) == 0)
+        db->last_modified = st.st_mtime;
+    else
+        db->last_modified = 0;
+
+    db->commit_head = myshell_hash64(path);
+    db->error_code = FOSSIL_MYSHELL_ERROR_SUCCESS;
+
+    // FSON type system: check that all #type=... fields match known types.
+    // A sidecar from a clean close vouches for the prefix it describes, so
+    // only bytes appended since then need to be scanned.
+    myshell_meta_t meta;
+    myshell_commit_index_t *commits = NULL;
+    uint64_t tail = 0;
+    long validate_from = 0;
+    if (myshell_meta_read(path, &meta, &commits) && meta.size <= db->file_size &&
+        (meta.size < db->file_size || meta.mtime == (long long)db->last_modified) &&
+        myshell_meta_tail_hash(file, meta.size, &tail) && tail == meta.tail) {
+        validate_from = (long)meta.size;
+        db->record_count = meta.records;
+        // Commits appended since then are picked up by the next sync
+        db->commit_index = commits;
+        commits = NULL;
+    }
+    myshell_commit_index_free(commits);
+    if (!myshell_validate_lines(file, validate_from, &db->record_count)) {
+        myshell_commit_index_free((myshell_commit_index_t *)db->commit_index);
+        free(db->path);
+        free(db);
+        fclose(file);
+        if (err) *err = FOSSIL_MYSHELL_ERROR_CONFIG_INVALID;
+        return NULL;
+    }
+    db->validated_size = db->file_size;
+    fseek(file, 0, SEEK_SET);
+
+    db->lock = myshell_lock_new();
+    if (!db->lock) {
+        myshell_commit_index_free((myshell_commit_index_t *)db->commit_index);
+        free(db->path);
+        free(db);
+        fclose(file);
+        if (err) *err = FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+        return NULL;
+    }
+
+    if (err) *err = FOSSIL_MYSHELL_ERROR_SUCCESS;
+    return db;
+}
+
+fossil_bluecrab_myshell_t *fossil_myshell_create(const char *path, fossil_bluecrab_myshell_error_t *err) {
+    if (!path) {
+        if (err) *err = FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+        return NULL;
+    }
+
+    // Enforce .myshell extension
+    const char *ext = strrchr(path, '.');
+    if (!ext || strcmp(ext, ".myshell") != 0) {
+        if (err) *err = FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+        return NULL;
+    }
+
+    // Check if file already exists
+    FILE *check = fopen(path, "rb");
+    if (check) {
+        fclose(check);
+        if (err) *err = FOSSIL_MYSHELL_ERROR_ALREADY_EXISTS;
+        return NULL;
+    }
+
+    FILE *file = fopen(path, "wb+");
+    if (!file) {
+        if (err) *err = FOSSIL_MYSHELL_ERROR_IO;
+        return NULL;
+    }
+
+    // Drop any validation sidecar left behind by an earlier file at this path
+    char *meta_path = myshell_sidecar_path(path, ".meta");
+    if (meta_path) remove(meta_path);
+    free(meta_path);
+
+    // Write FSON type system header for new file
+    fprintf(file, "#fson_types=");
+    for (size_t i = 0; i <= MYSHELL_FSON_TYPE_DURATION; ++i) {
+        fprintf(file, "%s", myshell_fson_type_names[i]);
+        if (i < MYSHELL_FSON_TYPE_DURATION) fprintf(file, ",");
+    }
+    fprintf(file, "\n");
+
+    fossil_bluecrab_myshell_t *db = (fossil_bluecrab_myshell_t *)calloc(1, sizeof(fossil_bluecrab_myshell_t));
+    if (!db) {
+        fclose(file);
+        if (err) *err = FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+        return NULL;
+    }
+
+    db->path = myshell_strdup(path);
+    if (!db->path) {
+        fclose(file);
+        free(db);
+        if (err) *err = FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+        return NULL;
+    }
+
+    db->file = file;
+    db->is_open = true;
+    fseek(file, 0, SEEK_END);
+    db->file_size = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    db->validated_size = db->file_size;
+    db->record_count = 1;
+    db->last_modified = time(NULL);
+    db->commit_head = myshell_hash64(path);
+    db->error_code = FOSSIL_MYSHELL_ERROR_SUCCESS;
+
+    db->lock = myshell_lock_new();
+    if (!db->lock) {
+        free(db->path);
+        free(db);
+        fclose(file);
+        if (err) *err = FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+        return NULL;
+    }
+
+    if (err) *err = FOSSIL_MYSHELL_ERROR_SUCCESS;
+    return db;
+}
+
+void fossil_myshell_close(fossil_bluecrab_myshell_t *db) {
+    if (db) {
+        if (db->async) {
+            myshell_async_free((myshell_async_t *)db->async);
+            db->async = NULL;
+        }
+        if (db->file) {
+            if (db->is_open && db->path) {
+                myshell_meta_write(db);
+                for (myshell_index_t *idx = (myshell_index_t *)db->indexes; idx; idx = idx->next) {
+                    myshell_index_save(db, idx);
+                }
+            }
+            fclose(db->file);
+            db->file = NULL;
+        }
+        if (db->path) {
+            free(db->path);
+            db->path = NULL;
+        }
+        if (db->branch) {
+            free(db->branch);
+            db->branch = NULL;
+        }
+        if (db->author) {
+            free(db->author);
+            db->author = NULL;
+        }
+        if (db->commit_message) {
+            free(db->commit_message);
+            db->commit_message = NULL;
+        }
+        if (db->parent_branch) {
+            free(db->parent_branch);
+            db->parent_branch = NULL;
+        }
+        if (db->stage) {
+            myshell_kvmap_free((myshell_kvmap_t *)db->stage);
+            db->stage = NULL;
+        }
+        if (db->txn) {
+            myshell_kvmap_free((myshell_kvmap_t *)db->txn);
+            db->txn = NULL;
+        }
+        if (db->cache) {
+            myshell_cache_free((myshell_cache_t *)db->cache);
+            db->cache = NULL;
+        }
+        if (db->commit_index) {
+            myshell_commit_index_free((myshell_commit_index_t *)db->commit_index);
+            db->commit_index = NULL;
+        }
+        if (db->durability) {
+            myshell_durability_free((myshell_durability_t *)db->durability);
+            db->durability = NULL;
+        }
+        while (db->indexes) {
+            myshell_index_t *idx = (myshell_index_t *)db->indexes;
+            db->indexes = idx->next;
+            myshell_index_free(idx);
+        }
+        myshell_lock_free((myshell_lock_t *)db->lock);
+        free(db);
+    }
+}
+
+static fossil_bluecrab_myshell_error_t myshell_put(fossil_bluecrab_myshell_t *db, const char *key, const char *type, const char *value) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!key || !type || !value) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+    if (key[0] == '\0' || type[0] == '\0') {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+
+    // Validate type against FSON type system
+    fossil_bluecrab_myshell_fson_type_t type_id = MYSHELL_FSON_TYPE_NULL;
+    bool valid_type = false;
+    for (size_t i = 0; i <= MYSHELL_FSON_TYPE_DURATION; ++i) {
+        if (strcmp(type, myshell_fson_type_names[i]) == 0) {
+            type_id = (fossil_bluecrab_myshell_fson_type_t)i;
+            valid_type = true;
+            break;
+        }
+    }
+    if (!valid_type) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_TYPE;
+    }
+
+    myshell_kvmap_t *ops = myshell_kvmap_new();
+    if (!ops || !myshell_kvmap_set(ops, key, myshell_hash64(key), type_id, value)) {
+        myshell_kvmap_free(ops);
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    fossil_bluecrab_myshell_error_t rc = myshell_apply(db, ops, false);
+    myshell_kvmap_free(ops);
+    return rc;
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_put(fossil_bluecrab_myshell_t *db, const char *key, const char *type, const char *value) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_put(db, key, type, value);
+    myshell_unlock(db);
+    return rc;
+}
+
+/**
+ * Scans the database file for key and copies its value into out_value.
+ */
+static fossil_bluecrab_myshell_error_t myshell_scan_get(
+    FILE *file,
+    const char *key,
+    uint64_t key_hash,
+    char *out_value,
+    size_t out_size
+) {
+    fseek(file, 0, SEEK_SET);
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        size_t len = strlen(line);
+        char *line_end = line + len;
+        char *eq = (char *)fossil_bluecrab_scan_byte(line, len, '=');
+        if (eq) {
+            *eq = '\0';
+            char *hash_comment = myshell_find_tag(eq + 1, (size_t)(line_end - eq - 1), "#hash=");
+            char *type_comment = myshell_find_tag(eq + 1, (size_t)(line_end - eq - 1), "#type=");
+            if (hash_comment) {
+                uint64_t file_hash = myshell_read_hash(hash_comment, line_end);
+                if (strcmp(line, key) == 0 && file_hash == key_hash) {
+                    // Extract value (between '=' and #type or #hash)
+                    size_t value_len = 0;
+                    if (type_comment && type_comment > eq + 1) {
+                        value_len = type_comment - (eq + 1);
+                    } else {
+                        value_len = hash_comment - (eq + 1);
+                    }
+                    // Trim trailing whitespace/newline from value_len
+                    while (value_len > 0 && ((eq + 1)[value_len - 1] == '\n' || (eq + 1)[value_len - 1] == ' ')) {
+                        value_len--;
+                    }
+                    if (value_len >= out_size) {
+                        *eq = '='; // Restore
+                        return FOSSIL_MYSHELL_ERROR_BUFFER_TOO_SMALL;
+                    }
+                    strncpy(out_value, eq + 1, value_len);
+                    out_value[value_len] = '\0';
+                    *eq = '='; // Restore
+                    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+                }
+            } else {
+                if (strcmp(line, key) == 0) {
+                    // Extract value (up to end or comment)
+                    size_t value_len = out_size - 1;
+                    char *comment = strchr(eq + 1, '#');
+                    if (comment) {
+                        value_len = comment - (eq + 1);
+                        // Trim trailing whitespace/newline from value_len
+                        while (value_len > 0 && ((eq + 1)[value_len - 1] == '\n' || (eq + 1)[value_len - 1] == ' ')) {
+                            value_len--;
+                        }
+                        if (value_len >= out_size) {
+                            *eq = '='; // Restore
+                            return FOSSIL_MYSHELL_ERROR_BUFFER_TOO_SMALL;
+                        }
+                    }
+                    strncpy(out_value, eq + 1, value_len);
+                    out_value[value_len] = '\0';
+                    *eq = '='; // Restore
+                    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+                }
+            }
+            *eq = '='; // Restore
+        }
+    }
+
+    return FOSSIL_MYSHELL_ERROR_NOT_FOUND;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_get(
+    fossil_bluecrab_myshell_t *db,
+    const char *key,
+    char *out_value,
+    size_t out_size
+) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!key || !out_value || out_size == 0) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+    if (key[0] == '\0') {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+
+    uint64_t key_hash = myshell_hash64(key);
+
+    // An active transaction sees its own pending writes
+    myshell_kv_entry_t *pending = myshell_kvmap_find((myshell_kvmap_t *)db->txn, key, key_hash);
+    if (pending) {
+        if (pending->deleted) {
+            return FOSSIL_MYSHELL_ERROR_NOT_FOUND;
+        }
+        size_t value_len = strlen(pending->value);
+        if (value_len >= out_size) {
+            return FOSSIL_MYSHELL_ERROR_BUFFER_TOO_SMALL;
+        }
+        memcpy(out_value, pending->value, value_len + 1);
+        return FOSSIL_MYSHELL_ERROR_SUCCESS;
+    }
+
+    myshell_cache_t *cache = (myshell_cache_t *)db->cache;
+    if (cache) {
+        myshell_kv_entry_t *cached = myshell_kvmap_find(cache->map, key, key_hash);
+        if (cached) {
+            size_t value_len = strlen(cached->value);
+            if (value_len >= out_size) {
+                return FOSSIL_MYSHELL_ERROR_BUFFER_TOO_SMALL;
+            }
+            memcpy(out_value, cached->value, value_len + 1);
+            myshell_kvmap_touch(cache->map, cached);
+            cache->hits++;
+            return FOSSIL_MYSHELL_ERROR_SUCCESS;
+        }
+        cache->misses++;
+    }
+
+    fossil_bluecrab_myshell_error_t rc = myshell_scan_get(db->file, key, key_hash, out_value, out_size);
+    // A value filling the whole buffer may have been truncated; don't cache it
+    if (cache && rc == FOSSIL_MYSHELL_ERROR_SUCCESS && strlen(out_value) + 1 < out_size) {
+        myshell_cache_insert(cache, key, key_hash, out_value);
+    }
+    return rc;
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_get(
+    fossil_bluecrab_myshell_t *db,
+    const char *key,
+    char *out_value,
+    size_t out_size
+) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_get(db, key, out_value, out_size);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_del(fossil_bluecrab_myshell_t *db, const char *key) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!key || key[0] == '\0') {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+
+    // Rewrite excluding the deleted key (matching key, hash, and type)
+    myshell_kvmap_t *ops = myshell_kvmap_new();
+    if (!ops || !myshell_kvmap_set_deleted(ops, key, myshell_hash64(key))) {
+        myshell_kvmap_free(ops);
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    fossil_bluecrab_myshell_error_t rc = myshell_apply(db, ops, true);
+    myshell_kvmap_free(ops);
+    return rc;
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_del(fossil_bluecrab_myshell_t *db, const char *key) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_del(db, key);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_query(
+    fossil_bluecrab_myshell_t *db,
+    const char *sql,
+    fossil_myshell_row_cb cb,
+    void *user
+) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!sql || !cb) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+
+    myshell_query_t q;
+    fossil_bluecrab_myshell_error_t rc = myshell_query_parse(sql, &q);
+    if (rc != FOSSIL_MYSHELL_ERROR_SUCCESS) {
+        return rc;
+    }
+
+    // Keys are unique, so an equality on key can match at most one row
+    size_t limit = q.has_limit ? q.limit : SIZE_MAX;
+    if (q.point_key && limit > 1) {
+        limit = 1;
+    }
+
+    size_t emitted = 0;
+    char line[1024];
+    fseek(db->file, 0, SEEK_SET);
+    while (emitted < limit && fgets(line, sizeof(line), db->file)) {
+        myshell_record_t rec;
+        if (!myshell_record_parse(line, &rec)) {
+            continue;
+        }
+        if (q.point_key && strcmp(rec.key, q.point_key) != 0) {
+            continue;
+        }
+        if (q.where && !myshell_pred_eval(q.where, &rec)) {
+            continue;
+        }
+        emitted++;
+        if (!cb((q.columns & MYSHELL_COL_KEY) ? rec.key : NULL,
+                (q.columns & MYSHELL_COL_TYPE) ? rec.type : NULL,
+                (q.columns & MYSHELL_COL_VALUE) ? rec.value : NULL,
+                user)) {
+            break;
+        }
+    }
+
+    myshell_query_free(&q);
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_query(
+    fossil_bluecrab_myshell_t *db,
+    const char *sql,
+    fossil_myshell_row_cb cb,
+    void *user
+) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_query(db, sql, cb, user);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_aggregate(
+    fossil_bluecrab_myshell_t *db,
+    const char *key_prefix,
+    const char *type,
+    fossil_myshell_agg_op_t op,
+    fossil_myshell_agg_result_t *result
+) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!type || !result || op < FOSSIL_MYSHELL_AGG_COUNT || op > FOSSIL_MYSHELL_AGG_AVG) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+    fossil_bluecrab_myshell_fson_type_t type_id;
+    if (!myshell_lookup_type(type, &type_id)) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_TYPE;
+    }
+    myshell_agg_kind_t kind;
+    switch (type_id) {
+        case MYSHELL_FSON_TYPE_I8: case MYSHELL_FSON_TYPE_I16:
+        case MYSHELL_FSON_TYPE_I32: case MYSHELL_FSON_TYPE_I64:
+            kind = MYSHELL_AGG_SIGNED;
+            break;
+        case MYSHELL_FSON_TYPE_U8: case MYSHELL_FSON_TYPE_U16:
+        case MYSHELL_FSON_TYPE_U32: case MYSHELL_FSON_TYPE_U64:
+            kind = MYSHELL_AGG_UNSIGNED;
+            break;
+        case MYSHELL_FSON_TYPE_F32: case MYSHELL_FSON_TYPE_F64:
+            kind = MYSHELL_AGG_FLOAT;
+            break;
+        default:
+            return FOSSIL_MYSHELL_ERROR_INVALID_TYPE;
+    }
+
+    myshell_agg_t *agg = (myshell_agg_t *)calloc(1, sizeof(*agg));
+    if (!agg) {
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    agg->kind = kind;
+    agg->op = op;
+
+    size_t prefix_len = key_prefix ? strlen(key_prefix) : 0;
+    char line[1024];
+    fseek(db->file, 0, SEEK_SET);
+    while (fgets(line, sizeof(line), db->file)) {
+        // Cheap rejections before the line is split
+        if (prefix_len && strncmp(line, key_prefix, prefix_len) != 0) {
+            continue;
+        }
+        myshell_record_t rec;
+        if (!myshell_record_parse(line, &rec) || strcmp(rec.type, type) != 0) {
+            continue;
+        }
+        if (kind == MYSHELL_AGG_FLOAT) {
+            char *end = NULL;
+            double v = strtod(rec.value, &end);
+            if (end == rec.value || *end != '\0' || v != v) {
+                continue;
+            }
+            agg->floats[agg->n++] = v;
+        } else if (!myshell_agg_parse_int(rec.value, kind == MYSHELL_AGG_UNSIGNED, &agg->ints[agg->n++])) {
+            agg->n--;
+            continue;
+        }
+        if (agg->n == MYSHELL_AGG_BATCH) {
+            myshell_agg_flush(agg);
+        }
     }
-    db->file_size = (size_t)ftell(file);
-    if (fseek(file, 0, SEEK_SET) != 0) {
-        free(db->path);
-        free(db);
-        fclose(file);
-        if (err) *err = FOSSIL_MYSHELL_ERROR_IO;
-        return NULL;
+    myshell_agg_flush(agg);
+
+    memset(result, 0, sizeof(*result));
+    result->count = agg->count;
+    fossil_bluecrab_myshell_error_t rc = FOSSIL_MYSHELL_ERROR_SUCCESS;
+    if (agg->count == 0 && op != FOSSIL_MYSHELL_AGG_COUNT && op != FOSSIL_MYSHELL_AGG_SUM) {
+        rc = FOSSIL_MYSHELL_ERROR_NOT_FOUND;
+    } else if (op == FOSSIL_MYSHELL_AGG_COUNT) {
+        result->i64 = (int64_t)agg->count;
+        result->u64 = agg->count;
+        result->f64 = (double)agg->count;
+    } else if (kind == MYSHELL_AGG_FLOAT) {
+        result->f64 = op == FOSSIL_MYSHELL_AGG_SUM ? agg->fsum
+                    : op == FOSSIL_MYSHELL_AGG_MIN ? agg->fmin
+                    : op == FOSSIL_MYSHELL_AGG_MAX ? agg->fmax
+                    : agg->fsum / (double)agg->count;
+        result->i64 = (int64_t)result->f64;
+        result->u64 = result->f64 > 0 ? (uint64_t)result->f64 : 0;
+    } else if (op == FOSSIL_MYSHELL_AGG_AVG) {
+        result->f64 = agg->fsum / (double)agg->count;
+        result->i64 = (int64_t)result->f64;
+        result->u64 = result->f64 > 0 ? (uint64_t)result->f64 : 0;
+    } else {
+        uint64_t bits = op == FOSSIL_MYSHELL_AGG_SUM ? agg->isum
+                      : op == FOSSIL_MYSHELL_AGG_MIN ? (uint64_t)agg->imin : (uint64_t)agg->imax;
+        if (kind == MYSHELL_AGG_UNSIGNED) {
+            // Min/max were taken on biased values; a sum carries count * 2^63
+            bits ^= op == FOSSIL_MYSHELL_AGG_SUM ? ((agg->count & 1) ? MYSHELL_AGG_BIAS : 0) : MYSHELL_AGG_BIAS;
+            result->u64 = bits;
+            result->i64 = (int64_t)bits;
+            result->f64 = (double)bits;
+        } else {
+            result->i64 = (int64_t)bits;
+            result->u64 = bits;
+            result->f64 = (double)(int64_t)bits;
+        }
     }
+    free(agg);
+    return rc;
+}
 
-    struct stat st;
-    if (stat(path, &st) == 0)
-        db->last_modified = st.st_mtime;
-    else
-        db->last_modified = 0;
+fossil_bluecrab_myshell_error_t fossil_myshell_aggregate(
+    fossil_bluecrab_myshell_t *db,
+    const char *key_prefix,
+    const char *type,
+    fossil_myshell_agg_op_t op,
+    fossil_myshell_agg_result_t *result
+) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_aggregate(db, key_prefix, type, op, result);
+    myshell_unlock(db);
+    return rc;
+}
 
-    db->commit_head = myshell_hash64(path);
-    db->error_code = FOSSIL_MYSHELL_ERROR_SUCCESS;
+bool fossil_myshell_index_fson_field(
+    const char *key,
+    const char *type,
+    const char *value,
+    char *out,
+    size_t out_size,
+    void *user
+) {
+    (void)key;
+    (void)type;
+    const char *field = (const char *)user;
+    if (!field || !value || !out || out_size == 0) {
+        return false;
+    }
+    size_t field_len = strlen(field);
+
+    // Walk the top level of "{ name: type: value, ... }" looking for field
+    const char *p = value;
+    int depth = 0;
+    bool at_member = true;
+    while (*p) {
+        char c = *p;
+        if (c == '"') {
+            for (p++; *p && *p != '"'; p++) {
+                if (*p == '\\' && p[1]) p++;
+            }
+            if (*p) p++;
+            at_member = false;
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            depth++;
+            at_member = depth == 1;
+            p++;
+            continue;
+        }
+        if (c == '}' || c == ']') {
+            depth--;
+            p++;
+            continue;
+        }
+        if (c == ',' && depth == 1) {
+            at_member = true;
+            p++;
+            continue;
+        }
+        if (isspace((unsigned char)c) || !at_member || depth != 1) {
+            if (!isspace((unsigned char)c)) at_member = false;
+            p++;
+            continue;
+        }
 
-    // FSON type system: scan file for type hints and validate
-    // (optional: could build a type map or validate lines)
-    // For now, just check that all #type=... fields match known types
-    fseek(file, 0, SEEK_SET);
-    char line[1024];
-    while (fgets(line, sizeof(line), file)) {
-        char *type_comment = strstr(line, "#type=");
-        if (type_comment) {
-            type_comment += 6;
-            char type_name[32] = {0};
-            int i = 0;
-            while (type_comment[i] && !isspace((unsigned char)type_comment[i]) && type_comment[i] != '#' && i < 31) {
-                type_name[i] = type_comment[i];
-                i++;
+        // p is at the start of a member name
+        const char *name = p;
+        while (*p && *p != ':' && *p != ',' && *p != '}' && !isspace((unsigned char)*p)) p++;
+        size_t name_len = (size_t)(p - name);
+        while (isspace((unsigned char)*p)) p++;
+        at_member = false;
+        if (*p != ':' || name_len != field_len || strncmp(name, field, field_len) != 0) {
+            continue;
+        }
+        p++;
+        while (isspace((unsigned char)*p)) p++;
+
+        // Skip an FSON type tag ("i32:", "cstr:", ...)
+        const char *tag = p;
+        while (isalnum((unsigned char)*p)) p++;
+        char tag_name[32];
+        size_t tag_len = (size_t)(p - tag);
+        const char *after_tag = p;
+        while (isspace((unsigned char)*after_tag)) after_tag++;
+        if (tag_len > 0 && tag_len < sizeof(tag_name) && *after_tag == ':') {
+            memcpy(tag_name, tag, tag_len);
+            tag_name[tag_len] = '\0';
+            if (myshell_lookup_type(tag_name, NULL)) {
+                p = after_tag + 1;
+                while (isspace((unsigned char)*p)) p++;
+            } else {
+                p = tag;
             }
-            type_name[i] = '\0';
-            bool valid_type = false;
-            for (size_t j = 0; j <= MYSHELL_FSON_TYPE_DURATION; ++j) {
-                if (strcmp(type_name, myshell_fson_type_names[j]) == 0) {
-                    valid_type = true;
-                    break;
-                }
+        } else {
+            p = tag;
+        }
+
+        const char *start = p, *end;
+        if (*p == '"') {
+            start = ++p;
+            while (*p && *p != '"') {
+                if (*p == '\\' && p[1]) p++;
+                p++;
             }
-            if (!valid_type) {
-                free(db->path);
-                free(db);
-                fclose(file);
-                if (err) *err = FOSSIL_MYSHELL_ERROR_CONFIG_INVALID;
-                return NULL;
+            end = p;
+        } else {
+            int nested = 0;
+            while (*p && !(nested == 0 && (*p == ',' || *p == '}'))) {
+                if (*p == '{' || *p == '[') nested++;
+                else if (*p == '}' || *p == ']') nested--;
+                p++;
             }
+            end = p;
+            while (end > start && isspace((unsigned char)end[-1])) end--;
         }
+        size_t len = (size_t)(end - start);
+        if (len >= out_size) {
+            return false;
+        }
+        memcpy(out, start, len);
+        out[len] = '\0';
+        return true;
     }
-    fseek(file, 0, SEEK_SET);
+    return false;
+}
 
-    if (err) *err = FOSSIL_MYSHELL_ERROR_SUCCESS;
-    return db;
+fossil_bluecrab_myshell_error_t fossil_myshell_create_index(
+    fossil_bluecrab_myshell_t *db,
+    const char *name,
+    const char *type_filter,
+    fossil_myshell_index_extractor_t extractor,
+    void *user
+) {
+    return fossil_myshell_create_index_versioned(db, name, type_filter, extractor, user, NULL);
 }
 
-fossil_bluecrab_myshell_t *fossil_myshell_create(const char *path, fossil_bluecrab_myshell_error_t *err) {
-    if (!path) {
-        if (err) *err = FOSSIL_MYSHELL_ERROR_INVALID_FILE;
-        return NULL;
+static fossil_bluecrab_myshell_error_t myshell_create_index_versioned(
+    fossil_bluecrab_myshell_t *db,
+    const char *name,
+    const char *type_filter,
+    fossil_myshell_index_extractor_t extractor,
+    void *user,
+    const char *version
+) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
-
-    // Enforce .myshell extension
-    const char *ext = strrchr(path, '.');
-    if (!ext || strcmp(ext, ".myshell") != 0) {
-        if (err) *err = FOSSIL_MYSHELL_ERROR_INVALID_FILE;
-        return NULL;
+    if (!name || !myshell_index_name_valid(name)) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
     }
-
-    // Check if file already exists
-    FILE *check = fopen(path, "rb");
-    if (check) {
-        fclose(check);
-        if (err) *err = FOSSIL_MYSHELL_ERROR_ALREADY_EXISTS;
-        return NULL;
+    if (type_filter && !myshell_lookup_type(type_filter, NULL)) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_TYPE;
     }
-
-    FILE *file = fopen(path, "wb+");
-    if (!file) {
-        if (err) *err = FOSSIL_MYSHELL_ERROR_IO;
-        return NULL;
+    if (myshell_index_find(db, name)) {
+        return FOSSIL_MYSHELL_ERROR_ALREADY_EXISTS;
     }
 
-    // Write FSON type system header for new file
-    fprintf(file, "#fson_types=");
-    for (size_t i = 0; i <= MYSHELL_FSON_TYPE_DURATION; ++i) {
-        fprintf(file, "%s", myshell_fson_type_names[i]);
-        if (i < MYSHELL_FSON_TYPE_DURATION) fprintf(file, ",");
+    myshell_index_t *idx = (myshell_index_t *)calloc(1, sizeof(*idx));
+    if (!idx) {
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    idx->name = myshell_strdup(name);
+    idx->type_filter = type_filter ? myshell_strdup(type_filter) : NULL;
+    idx->forward = myshell_kvmap_new();
+    idx->extractor = extractor;
+    idx->user = user;
+    idx->identity = myshell_index_identity(extractor, user, version);  // NULL just rebuilds every run
+    if (!idx->name || (type_filter && !idx->type_filter) || !idx->forward) {
+        myshell_index_free(idx);
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
     }
-    fprintf(file, "\n");
 
-    fossil_bluecrab_myshell_t *db = (fossil_bluecrab_myshell_t *)calloc(1, sizeof(fossil_bluecrab_myshell_t));
-    if (!db) {
-        fclose(file);
-        if (err) *err = FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
-        return NULL;
+    if (!myshell_index_load(db, idx)) {
+        fossil_bluecrab_myshell_error_t rc = myshell_index_build(db, idx);
+        if (rc != FOSSIL_MYSHELL_ERROR_SUCCESS) {
+            myshell_index_free(idx);
+            return rc;
+        }
     }
 
-    db->path = myshell_strdup(path);
-    if (!db->path) {
-        fclose(file);
-        free(db);
-        if (err) *err = FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
-        return NULL;
+    idx->next = (myshell_index_t *)db->indexes;
+    db->indexes = idx;
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_create_index_versioned(
+    fossil_bluecrab_myshell_t *db,
+    const char *name,
+    const char *type_filter,
+    fossil_myshell_index_extractor_t extractor,
+    void *user,
+    const char *version
+) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_create_index_versioned(db, name, type_filter, extractor, user, version);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_drop_index(fossil_bluecrab_myshell_t *db, const char *name) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!name) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+    myshell_index_t **link = (myshell_index_t **)&db->indexes;
+    while (*link && strcmp((*link)->name, name) != 0) {
+        link = &(*link)->next;
+    }
+    if (!*link) {
+        return FOSSIL_MYSHELL_ERROR_NOT_FOUND;
     }
+    myshell_index_t *idx = *link;
+    *link = idx->next;
 
-    db->file = file;
-    db->is_open = true;
-    fseek(file, 0, SEEK_END);
-    db->file_size = (size_t)ftell(file);
-    fseek(file, 0, SEEK_SET);
-    db->last_modified = time(NULL);
-    db->commit_head = myshell_hash64(path);
-    db->error_code = FOSSIL_MYSHELL_ERROR_SUCCESS;
+    char *idx_path = myshell_index_path(db->path, idx->name);
+    if (idx_path) remove(idx_path);
+    free(idx_path);
+    myshell_index_free(idx);
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
 
-    if (err) *err = FOSSIL_MYSHELL_ERROR_SUCCESS;
-    return db;
+fossil_bluecrab_myshell_error_t fossil_myshell_drop_index(fossil_bluecrab_myshell_t *db, const char *name) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_drop_index(db, name);
+    myshell_unlock(db);
+    return rc;
 }
 
-void fossil_myshell_close(fossil_bluecrab_myshell_t *db) {
-    if (db) {
-        if (db->file) {
-            fclose(db->file);
-            db->file = NULL;
-        }
-        if (db->path) {
-            free(db->path);
-            db->path = NULL;
-        }
-        if (db->branch) {
-            free(db->branch);
-            db->branch = NULL;
-        }
-        if (db->author) {
-            free(db->author);
-            db->author = NULL;
-        }
-        if (db->commit_message) {
-            free(db->commit_message);
-            db->commit_message = NULL;
+static fossil_bluecrab_myshell_error_t myshell_index_range(
+    fossil_bluecrab_myshell_t *db,
+    const char *name,
+    const char *min_value,
+    const char *max_value,
+    fossil_myshell_row_cb cb,
+    void *user
+) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!name || !cb) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+    myshell_index_t *idx = myshell_index_find(db, name);
+    if (!idx) {
+        return FOSSIL_MYSHELL_ERROR_NOT_FOUND;
+    }
+
+    myshell_index_entry_t lo = { (char *)min_value, (char *)"", MYSHELL_FSON_TYPE_NULL, false, false, 0, 0 };
+    myshell_index_entry_t hi = { (char *)max_value, (char *)"", MYSHELL_FSON_TYPE_NULL, false, false, 0, 0 };
+    if (min_value) myshell_index_classify(&lo);
+    if (max_value) myshell_index_classify(&hi);
+
+    for (size_t i = min_value ? myshell_index_lower_bound(idx, &lo, false) : 0; i < idx->count; ++i) {
+        const myshell_index_entry_t *e = &idx->entries[i];
+        if (max_value && myshell_index_cmp_value(e, &hi) > 0) {
+            break;
         }
-        if (db->parent_branch) {
-            free(db->parent_branch);
-            db->parent_branch = NULL;
+        if (!cb(e->key, myshell_fson_type_to_string(e->type), e->value, user)) {
+            break;
         }
-        free(db);
     }
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_put(fossil_bluecrab_myshell_t *db, const char *key, const char *type, const char *value) {
+fossil_bluecrab_myshell_error_t fossil_myshell_index_range(
+    fossil_bluecrab_myshell_t *db,
+    const char *name,
+    const char *min_value,
+    const char *max_value,
+    fossil_myshell_row_cb cb,
+    void *user
+) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_index_range(db, name, min_value, max_value, cb, user);
+    myshell_unlock(db);
+    return rc;
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_index_lookup(
+    fossil_bluecrab_myshell_t *db,
+    const char *name,
+    const char *value,
+    fossil_myshell_row_cb cb,
+    void *user
+) {
+    if (!value) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+    return fossil_myshell_index_range(db, name, value, value, cb, user);
+}
+
+static fossil_bluecrab_myshell_error_t myshell_txn_begin(fossil_bluecrab_myshell_t *db) {
     if (!db || !db->is_open) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
-    if (!key || !type || !value) {
+    if (db->txn) {
+        return FOSSIL_MYSHELL_ERROR_CONCURRENCY;
+    }
+    db->txn = myshell_kvmap_new();
+    if (!db->txn) {
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_txn_begin(fossil_bluecrab_myshell_t *db) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_txn_begin(db);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_txn_put(fossil_bluecrab_myshell_t *db, const char *key, const char *type, const char *value) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!db->txn || !key || !type || !value) {
         return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
     }
     if (key[0] == '\0' || type[0] == '\0') {
@@ -420,165 +3180,198 @@ fossil_bluecrab_myshell_error_t fossil_myshell_put(fossil_bluecrab_myshell_t *db
 
     // Validate type against FSON type system
     fossil_bluecrab_myshell_fson_type_t type_id = MYSHELL_FSON_TYPE_NULL;
-    bool valid_type = false;
-    for (size_t i = 0; i <= MYSHELL_FSON_TYPE_DURATION; ++i) {
-        if (strcmp(type, myshell_fson_type_names[i]) == 0) {
-            type_id = (fossil_bluecrab_myshell_fson_type_t)i;
-            valid_type = true;
-            break;
-        }
-    }
-    if (!valid_type) {
+    if (!myshell_lookup_type(type, &type_id)) {
         return FOSSIL_MYSHELL_ERROR_INVALID_TYPE;
     }
 
-    uint64_t key_hash = myshell_hash64(key);
+    if (!myshell_kvmap_set((myshell_kvmap_t *)db->txn, key, myshell_hash64(key), type_id, value)) {
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
 
-    fseek(db->file, 0, SEEK_SET);
-    char temp_path[256];
-    snprintf(temp_path, sizeof(temp_path), "%s.tmp", db->path);
-    FILE *temp_file = fopen(temp_path, "wb");
-    if (!temp_file) {
-        return FOSSIL_MYSHELL_ERROR_IO;
+fossil_bluecrab_myshell_error_t fossil_myshell_txn_put(fossil_bluecrab_myshell_t *db, const char *key, const char *type, const char *value) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_txn_put(db, key, type, value);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_txn_del(fossil_bluecrab_myshell_t *db, const char *key) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!db->txn || !key || key[0] == '\0') {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+    if (!myshell_kvmap_set_deleted((myshell_kvmap_t *)db->txn, key, myshell_hash64(key))) {
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
     }
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
 
-    char line[1024];
-    bool updated = false;
-    while (fgets(line, sizeof(line), db->file)) {
-        char *eq = strchr(line, '=');
-        if (eq) {
-            *eq = '\0';
-            char *hash_comment = strstr(eq + 1, "#hash=");
-            if (hash_comment) {
-                uint64_t file_hash = 0;
-                sscanf(hash_comment, "#hash=%" SCNx64, &file_hash);
-                if (strcmp(line, key) == 0 && file_hash == key_hash) {
-                    // Overwrite with new value and type
-                    fprintf(temp_file, "%s=%s #type=%s #hash=%016" PRIx64 "\n", key, value, myshell_fson_type_to_string(type_id), key_hash);
-                    updated = true;
-                    *eq = '='; // Restore
-                    continue;
-                }
-            } else {
-                if (strcmp(line, key) == 0) {
-                    // Overwrite with new value and type
-                    fprintf(temp_file, "%s=%s #type=%s #hash=%016" PRIx64 "\n", key, value, myshell_fson_type_to_string(type_id), key_hash);
-                    updated = true;
-                    *eq = '='; // Restore
-                    continue;
-                }
-            }
-            *eq = '='; // Restore
-        }
-        fputs(line, temp_file);
+fossil_bluecrab_myshell_error_t fossil_myshell_txn_del(fossil_bluecrab_myshell_t *db, const char *key) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_txn_del(db, key);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_txn_commit(fossil_bluecrab_myshell_t *db) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!db->txn) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
     }
 
-    if (!updated) {
-        // Add new entry with FSON type and hash
-        fprintf(temp_file, "%s=%s #type=%s #hash=%016" PRIx64 "\n", key, value, myshell_fson_type_to_string(type_id), key_hash);
+    myshell_kvmap_t *ops = (myshell_kvmap_t *)db->txn;
+    db->txn = NULL;
+
+    fossil_bluecrab_myshell_error_t rc = FOSSIL_MYSHELL_ERROR_SUCCESS;
+    if (ops->count > 0) {
+        rc = myshell_apply(db, ops, false);
     }
+    myshell_kvmap_free(ops);
+    return rc == FOSSIL_MYSHELL_ERROR_SUCCESS ? rc : FOSSIL_MYSHELL_ERROR_TRANSACTION_FAILED;
+}
 
-    fclose(temp_file);
-    fclose(db->file);
+fossil_bluecrab_myshell_error_t fossil_myshell_txn_commit(fossil_bluecrab_myshell_t *db) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_txn_commit(db);
+    myshell_unlock(db);
+    return rc;
+}
 
-    if (remove(db->path) != 0) {
-        remove(temp_path);
-        return FOSSIL_MYSHELL_ERROR_IO;
+static fossil_bluecrab_myshell_error_t myshell_txn_rollback(fossil_bluecrab_myshell_t *db) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
-    if (rename(temp_path, db->path) != 0) {
-        return FOSSIL_MYSHELL_ERROR_IO;
+    if (!db->txn) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+    myshell_kvmap_free((myshell_kvmap_t *)db->txn);
+    db->txn = NULL;
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_txn_rollback(fossil_bluecrab_myshell_t *db) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_txn_rollback(db);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_cache_enable(fossil_bluecrab_myshell_t *db, size_t max_bytes) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
 
-    db->file = fopen(db->path, "rb+");
-    if (!db->file) {
-        return FOSSIL_MYSHELL_ERROR_IO;
+    myshell_cache_t *cache = (myshell_cache_t *)db->cache;
+    if (max_bytes == 0) {
+        myshell_cache_free(cache);
+        db->cache = NULL;
+        return FOSSIL_MYSHELL_ERROR_SUCCESS;
     }
 
-    db->file_size = (size_t)ftell(db->file);
-    db->last_modified = time(NULL);
+    if (!cache) {
+        cache = (myshell_cache_t *)calloc(1, sizeof(myshell_cache_t));
+        if (!cache) {
+            return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+        }
+        cache->map = myshell_kvmap_new();
+        if (!cache->map) {
+            free(cache);
+            return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+        }
+        db->cache = cache;
+    }
+    cache->max_bytes = max_bytes;
+    myshell_cache_evict(cache, max_bytes);
     return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_get(
+fossil_bluecrab_myshell_error_t fossil_myshell_cache_enable(fossil_bluecrab_myshell_t *db, size_t max_bytes) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_cache_enable(db, max_bytes);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_cache_stats(fossil_bluecrab_myshell_t *db, uint64_t *hits, uint64_t *misses) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!db->cache) {
+        return FOSSIL_MYSHELL_ERROR_NOT_FOUND;
+    }
+    myshell_cache_t *cache = (myshell_cache_t *)db->cache;
+    if (hits) *hits = cache->hits;
+    if (misses) *misses = cache->misses;
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_cache_stats(fossil_bluecrab_myshell_t *db, uint64_t *hits, uint64_t *misses) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_cache_stats(db, hits, misses);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_set_durability(
     fossil_bluecrab_myshell_t *db,
-    const char *key,
-    char *out_value,
-    size_t out_size
+    fossil_bluecrab_myshell_durability_t mode,
+    unsigned interval_ms
 ) {
     if (!db || !db->is_open) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
-    if (!key || !out_value || out_size == 0) {
+    if (mode < FOSSIL_MYSHELL_DURABILITY_NONE || mode > FOSSIL_MYSHELL_DURABILITY_PERIODIC) {
         return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
     }
-    if (key[0] == '\0') {
+    if (mode == FOSSIL_MYSHELL_DURABILITY_PERIODIC && interval_ms == 0) {
         return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
     }
 
-    uint64_t key_hash = myshell_hash64(key);
+    // Flush whatever the previous mode left buffered, then replace the state
+    fflush(db->file);
+    myshell_durability_free((myshell_durability_t *)db->durability);
+    db->durability = NULL;
 
-    fseek(db->file, 0, SEEK_SET);
-    char line[1024];
-    while (fgets(line, sizeof(line), db->file)) {
-        char *eq = strchr(line, '=');
-        if (eq) {
-            *eq = '\0';
-            char *hash_comment = strstr(eq + 1, "#hash=");
-            char *type_comment = strstr(eq + 1, "#type=");
-            if (hash_comment) {
-                uint64_t file_hash = 0;
-                sscanf(hash_comment, "#hash=%" SCNx64, &file_hash);
-                if (strcmp(line, key) == 0 && file_hash == key_hash) {
-                    // Extract value (between '=' and #type or #hash)
-                    size_t value_len = 0;
-                    if (type_comment && type_comment > eq + 1) {
-                        value_len = type_comment - (eq + 1);
-                    } else {
-                        value_len = hash_comment - (eq + 1);
-                    }
-                    // Trim trailing whitespace/newline from value_len
-                    while (value_len > 0 && ((eq + 1)[value_len - 1] == '\n' || (eq + 1)[value_len - 1] == ' ')) {
-                        value_len--;
-                    }
-                    if (value_len >= out_size) {
-                        *eq = '='; // Restore
-                        return FOSSIL_MYSHELL_ERROR_BUFFER_TOO_SMALL;
-                    }
-                    strncpy(out_value, eq + 1, value_len);
-                    out_value[value_len] = '\0';
-                    *eq = '='; // Restore
-                    return FOSSIL_MYSHELL_ERROR_SUCCESS;
-                }
-            } else {
-                if (strcmp(line, key) == 0) {
-                    // Extract value (up to end or comment)
-                    size_t value_len = out_size - 1;
-                    char *comment = strchr(eq + 1, '#');
-                    if (comment) {
-                        value_len = comment - (eq + 1);
-                        // Trim trailing whitespace/newline from value_len
-                        while (value_len > 0 && ((eq + 1)[value_len - 1] == '\n' || (eq + 1)[value_len - 1] == ' ')) {
-                            value_len--;
-                        }
-                        if (value_len >= out_size) {
-                            *eq = '='; // Restore
-                            return FOSSIL_MYSHELL_ERROR_BUFFER_TOO_SMALL;
-                        }
-                    }
-                    strncpy(out_value, eq + 1, value_len);
-                    out_value[value_len] = '\0';
-                    *eq = '='; // Restore
-                    return FOSSIL_MYSHELL_ERROR_SUCCESS;
-                }
-            }
-            *eq = '='; // Restore
+    myshell_durability_t *d = (myshell_durability_t *)calloc(1, sizeof(myshell_durability_t));
+    if (!d) {
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    d->mode = mode;
+    if (mode == FOSSIL_MYSHELL_DURABILITY_PERIODIC) {
+        d->worker = fossil_bluecrab_sync_worker_start(db->path, interval_ms);
+        if (!d->worker) {
+            free(d);
+            return FOSSIL_MYSHELL_ERROR_IO;
         }
     }
 
-    return FOSSIL_MYSHELL_ERROR_NOT_FOUND;
+    db->durability = d;
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_del(fossil_bluecrab_myshell_t *db, const char *key) {
+fossil_bluecrab_myshell_error_t fossil_myshell_set_durability(
+    fossil_bluecrab_myshell_t *db,
+    fossil_bluecrab_myshell_durability_t mode,
+    unsigned interval_ms
+) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_set_durability(db, mode, interval_ms);
+    myshell_unlock(db);
+    return rc;
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_submit_get(
+    fossil_bluecrab_myshell_t *db,
+    const char *key,
+    fossil_myshell_async_cb cb,
+    void *user
+) {
     if (!db || !db->is_open) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
@@ -586,103 +3379,81 @@ fossil_bluecrab_myshell_error_t fossil_myshell_del(fossil_bluecrab_myshell_t *db
         return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
     }
 
-    uint64_t key_hash = myshell_hash64(key);
+    myshell_async_req_t *req = (myshell_async_req_t *)calloc(1, sizeof(myshell_async_req_t));
+    if (!req) {
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    req->op = MYSHELL_ASYNC_GET;
+    req->key = myshell_strdup(key);
+    req->cb = cb;
+    req->user = user;
+    if (!req->key) {
+        myshell_async_req_free(req);
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
 
-    // Read all lines, rewrite excluding the deleted key (matching both key, hash, and type)
-    fseek(db->file, 0, SEEK_SET);
-    char temp_path[256];
-    snprintf(temp_path, sizeof(temp_path), "%s.tmp", db->path);
-    FILE *temp_file = fopen(temp_path, "wb");
-    if (!temp_file) {
-        return FOSSIL_MYSHELL_ERROR_IO;
+    fossil_bluecrab_myshell_error_t rc = myshell_async_submit(db, req);
+    if (rc != FOSSIL_MYSHELL_ERROR_SUCCESS) {
+        myshell_async_req_free(req);
     }
+    return rc;
+}
 
-    char line[1024];
-    bool found = false;
-    while (fgets(line, sizeof(line), db->file)) {
-        char *eq = strchr(line, '=');
-        if (eq) {
-            *eq = '\0';
-            char *hash_comment = strstr(eq + 1, "#hash=");
-            char *type_comment = strstr(eq + 1, "#type=");
-            if (hash_comment) {
-                uint64_t file_hash = 0;
-                sscanf(hash_comment, "#hash=%" SCNx64, &file_hash);
-                if (strcmp(line, key) == 0 && file_hash == key_hash) {
-                    // Optionally validate type against FSON type system
-                    if (type_comment) {
-                        char type_name[32] = {0};
-                        int i = 0;
-                        type_comment += 6;
-                        while (type_comment[i] && !isspace((unsigned char)type_comment[i]) && type_comment[i] != '#' && i < 31) {
-                            type_name[i] = type_comment[i];
-                            i++;
-                        }
-                        type_name[i] = '\0';
-                        bool valid_type = false;
-                        for (size_t j = 0; j <= MYSHELL_FSON_TYPE_DURATION; ++j) {
-                            if (strcmp(type_name, myshell_fson_type_names[j]) == 0) {
-                                valid_type = true;
-                                break;
-                            }
-                        }
-                        // If type is valid, skip line (delete)
-                        if (valid_type) {
-                            found = true;
-                            *eq = '='; // Restore
-                            continue;
-                        }
-                    } else {
-                        // No type info, still skip line
-                        found = true;
-                        *eq = '='; // Restore
-                        continue;
-                    }
-                }
-            } else {
-                if (strcmp(line, key) == 0) {
-                    found = true; // Skip this line
-                    *eq = '='; // Restore
-                    continue;
-                }
-            }
-            *eq = '='; // Restore
-        }
-        fputs(line, temp_file);
+fossil_bluecrab_myshell_error_t fossil_myshell_submit_put(
+    fossil_bluecrab_myshell_t *db,
+    const char *key,
+    const char *type,
+    const char *value,
+    fossil_myshell_async_cb cb,
+    void *user
+) {
+    if (!db || !db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!key || !type || !value || key[0] == '\0' || type[0] == '\0') {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+    if (!myshell_lookup_type(type, NULL)) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_TYPE;
     }
 
-    fclose(temp_file);
-    fclose(db->file);
+    myshell_async_req_t *req = (myshell_async_req_t *)calloc(1, sizeof(myshell_async_req_t));
+    if (!req) {
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    req->op = MYSHELL_ASYNC_PUT;
+    req->key = myshell_strdup(key);
+    req->type = myshell_strdup(type);
+    req->value = myshell_strdup(value);
+    req->cb = cb;
+    req->user = user;
+    if (!req->key || !req->type || !req->value) {
+        myshell_async_req_free(req);
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
 
-    if (found) {
-        if (remove(db->path) != 0) {
-            remove(temp_path);
-            db->file = fopen(db->path, "rb+");
-            if (!db->file) return FOSSIL_MYSHELL_ERROR_IO;
-            return FOSSIL_MYSHELL_ERROR_IO;
-        }
-        if (rename(temp_path, db->path) != 0) {
-            db->file = fopen(db->path, "rb+");
-            if (!db->file) return FOSSIL_MYSHELL_ERROR_IO;
-            return FOSSIL_MYSHELL_ERROR_IO;
-        }
-        db->file = fopen(db->path, "rb+");
-        if (!db->file) {
-            return FOSSIL_MYSHELL_ERROR_IO;
-        }
-        db->last_modified = time(NULL);
-        return FOSSIL_MYSHELL_ERROR_SUCCESS;
-    } else {
-        remove(temp_path); // No change
-        db->file = fopen(db->path, "rb+");
-        if (!db->file) {
-            return FOSSIL_MYSHELL_ERROR_IO;
-        }
-        return FOSSIL_MYSHELL_ERROR_NOT_FOUND;
+    fossil_bluecrab_myshell_error_t rc = myshell_async_submit(db, req);
+    if (rc != FOSSIL_MYSHELL_ERROR_SUCCESS) {
+        myshell_async_req_free(req);
     }
+    return rc;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_commit(fossil_bluecrab_myshell_t *db, const char *message) {
+size_t fossil_myshell_async_poll(fossil_bluecrab_myshell_t *db) {
+    if (!db || !db->async) {
+        return 0;
+    }
+    return myshell_async_dispatch((myshell_async_t *)db->async, false);
+}
+
+size_t fossil_myshell_async_wait(fossil_bluecrab_myshell_t *db) {
+    if (!db || !db->async) {
+        return 0;
+    }
+    return myshell_async_dispatch((myshell_async_t *)db->async, true);
+}
+
+static fossil_bluecrab_myshell_error_t myshell_commit(fossil_bluecrab_myshell_t *db, const char *message) {
     if (!db) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
@@ -732,25 +3503,54 @@ fossil_bluecrab_myshell_error_t fossil_myshell_commit(fossil_bluecrab_myshell_t
 
     db->next_commit_hash = 0;
 
+    // Flush the in-memory staging area ahead of the commit line so that the
+    // whole commit lands in the file with a single append.
+    myshell_buf_t buf = {0};
+    myshell_kvmap_t *stage = (myshell_kvmap_t *)db->stage;
+    for (myshell_kv_entry_t *entry = stage ? stage->head : NULL; entry; entry = entry->order_next) {
+        if (!myshell_buf_printf(&buf, "#stage %s=%s #type=%s #hash=%016" PRIx64 "\n",
+                                entry->key, entry->value, myshell_fson_type_to_string(entry->type), entry->hash)) {
+            free(buf.data);
+            return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+        }
+    }
+    // FSON v2: commit lines can optionally include a #type=enum for commit type
+    // For compatibility, always append #type=enum to commit lines
+    if (!myshell_buf_printf(&buf, "#commit %016" PRIx64 " %s %lld #type=%s\n",
+                            db->commit_head, message, (long long)db->commit_timestamp,
+                            myshell_fson_type_to_string(MYSHELL_FSON_TYPE_ENUM))) {
+        free(buf.data);
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
+
     // Write commit info to the file for history (simple append)
     if (fseek(db->file, 0, SEEK_END) != 0) {
+        free(buf.data);
         return FOSSIL_MYSHELL_ERROR_IO;
     }
-    // FSON v2: commit lines can optionally include a #type=enum for commit type
-    // For compatibility, always append #type=enum to commit lines
-    if (fprintf(db->file, "#commit %016" PRIx64 " %s %lld #type=%s\n",
-                    db->commit_head, message, (long long)db->commit_timestamp,
-                    myshell_fson_type_to_string(MYSHELL_FSON_TYPE_ENUM)) < 0) {
+    if (fwrite(buf.data, 1, buf.len, db->file) != buf.len) {
+        free(buf.data);
+        return FOSSIL_MYSHELL_ERROR_IO;
+    }
+    free(buf.data);
+    myshell_kvmap_clear(stage);
+    if (myshell_durable(db, true) != FOSSIL_MYSHELL_ERROR_SUCCESS) {
         return FOSSIL_MYSHELL_ERROR_IO;
     }
-    fflush(db->file);
 
     db->last_modified = time(NULL);
 
     return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_branch(fossil_bluecrab_myshell_t *db, const char *branch_name) {
+fossil_bluecrab_myshell_error_t fossil_myshell_commit(fossil_bluecrab_myshell_t *db, const char *message) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_commit(db, message);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_branch(fossil_bluecrab_myshell_t *db, const char *branch_name) {
     if (!db) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
@@ -796,7 +3596,9 @@ fossil_bluecrab_myshell_error_t fossil_myshell_branch(fossil_bluecrab_myshell_t
     if (fprintf(db->file, "#branch %016" PRIx64 " %s #type=%s\n", db->commit_head, branch_name, myshell_fson_type_to_string(type_id)) < 0) {
         return FOSSIL_MYSHELL_ERROR_IO;
     }
-    fflush(db->file);
+    if (myshell_durable(db, false) != FOSSIL_MYSHELL_ERROR_SUCCESS) {
+        return FOSSIL_MYSHELL_ERROR_IO;
+    }
 
     db->last_modified = time(NULL);
 
@@ -814,7 +3616,14 @@ fossil_bluecrab_myshell_error_t fossil_myshell_branch(fossil_bluecrab_myshell_t
     return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_checkout(fossil_bluecrab_myshell_t *db, const char *branch_or_commit) {
+fossil_bluecrab_myshell_error_t fossil_myshell_branch(fossil_bluecrab_myshell_t *db, const char *branch_name) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_branch(db, branch_name);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_checkout(fossil_bluecrab_myshell_t *db, const char *branch_or_commit) {
     if (!db) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
@@ -880,7 +3689,14 @@ fossil_bluecrab_myshell_error_t fossil_myshell_checkout(fossil_bluecrab_myshell_
     return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_merge(fossil_bluecrab_myshell_t *db, const char *source_branch, const char *message) {
+fossil_bluecrab_myshell_error_t fossil_myshell_checkout(fossil_bluecrab_myshell_t *db, const char *branch_or_commit) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_checkout(db, branch_or_commit);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_merge(fossil_bluecrab_myshell_t *db, const char *source_branch, const char *message) {
     if (!db) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
@@ -960,14 +3776,23 @@ fossil_bluecrab_myshell_error_t fossil_myshell_merge(fossil_bluecrab_myshell_t *
         fprintf(db->file, "#merge %016" PRIx64 " %s %s %lld #type=%s\n",
                 db->commit_head, found_branch_name, message, (long long)db->commit_timestamp,
                 myshell_fson_type_to_string(branch_type));
-        fflush(db->file);
+        if (myshell_durable(db, true) != FOSSIL_MYSHELL_ERROR_SUCCESS) {
+            return FOSSIL_MYSHELL_ERROR_IO;
+        }
     }
 
     db->last_modified = time(NULL);
     return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_revert(fossil_bluecrab_myshell_t *db, const char *commit_hash) {
+fossil_bluecrab_myshell_error_t fossil_myshell_merge(fossil_bluecrab_myshell_t *db, const char *source_branch, const char *message) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_merge(db, source_branch, message);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_revert(fossil_bluecrab_myshell_t *db, const char *commit_hash) {
     if (!db) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
@@ -1029,7 +3854,14 @@ fossil_bluecrab_myshell_error_t fossil_myshell_revert(fossil_bluecrab_myshell_t
     return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_stage(fossil_bluecrab_myshell_t *db, const char *key, const char *type, const char *value) {
+fossil_bluecrab_myshell_error_t fossil_myshell_revert(fossil_bluecrab_myshell_t *db, const char *commit_hash) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_revert(db, commit_hash);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_stage(fossil_bluecrab_myshell_t *db, const char *key, const char *type, const char *value) {
     if (!db || !db->is_open) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
@@ -1054,71 +3886,31 @@ fossil_bluecrab_myshell_error_t fossil_myshell_stage(fossil_bluecrab_myshell_t *
         return FOSSIL_MYSHELL_ERROR_CONFIG_INVALID;
     }
 
-    uint64_t key_hash = myshell_hash64(key);
-
-    // Remove any previous staged entry for this key before adding new
-    fseek(db->file, 0, SEEK_SET);
-    char temp_path[256];
-    snprintf(temp_path, sizeof(temp_path), "%s.tmp", db->path);
-    FILE *temp_file = fopen(temp_path, "wb");
-    if (!temp_file) {
-        return FOSSIL_MYSHELL_ERROR_IO;
-    }
-
-    char line[1024];
-    while (fgets(line, sizeof(line), db->file)) {
-        if (strncmp(line, "#stage ", 7) == 0) {
-            char *eq = strchr(line + 7, '=');
-            if (eq) {
-                *eq = '\0';
-                char *hash_comment = strstr(eq + 1, "#hash=");
-                if (hash_comment) {
-                    uint64_t file_hash = 0;
-                    sscanf(hash_comment, "#hash=%" SCNx64, &file_hash);
-                    if (strcmp(line + 7, key) == 0 && file_hash == key_hash) {
-                        *eq = '='; // Restore
-                        continue;
-                    }
-                } else {
-                    if (strcmp(line + 7, key) == 0) {
-                        *eq = '='; // Restore
-                        continue;
-                    }
-                }
-                *eq = '='; // Restore
-            }
+    // The staging area lives in memory until the next commit; a previous
+    // staged entry for the same key is simply replaced.
+    if (!db->stage) {
+        db->stage = myshell_kvmap_new();
+        if (!db->stage) {
+            return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
         }
-        fputs(line, temp_file);
-    }
-
-    // Add new staged entry at the end, using FSON type system
-    fprintf(temp_file, "#stage %s=%s #type=%s #hash=%016" PRIx64 "\n", key, value, myshell_fson_type_to_string(type_id), key_hash);
-
-    fclose(temp_file);
-    fclose(db->file);
-
-    if (remove(db->path) != 0) {
-        remove(temp_path);
-        db->file = fopen(db->path, "rb+");
-        if (!db->file) return FOSSIL_MYSHELL_ERROR_IO;
-        return FOSSIL_MYSHELL_ERROR_IO;
-    }
-    if (rename(temp_path, db->path) != 0) {
-        db->file = fopen(db->path, "rb+");
-        if (!db->file) return FOSSIL_MYSHELL_ERROR_IO;
-        return FOSSIL_MYSHELL_ERROR_IO;
     }
-
-    db->file = fopen(db->path, "rb+");
-    if (!db->file) {
-        return FOSSIL_MYSHELL_ERROR_IO;
+
+    uint64_t key_hash = myshell_hash64(key);
+    if (!myshell_kvmap_set((myshell_kvmap_t *)db->stage, key, key_hash, type_id, value)) {
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
     }
 
-    db->last_modified = time(NULL);
     return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_unstage(fossil_bluecrab_myshell_t *db, const char *key) {
+fossil_bluecrab_myshell_error_t fossil_myshell_stage(fossil_bluecrab_myshell_t *db, const char *key, const char *type, const char *value) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_stage(db, key, type, value);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_unstage(fossil_bluecrab_myshell_t *db, const char *key) {
     if (!db || !db->is_open) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
@@ -1127,88 +3919,21 @@ fossil_bluecrab_myshell_error_t fossil_myshell_unstage(fossil_bluecrab_myshell_t
     }
 
     uint64_t key_hash = myshell_hash64(key);
-
-    // Read all lines, rewrite excluding the unstaged key (matching key, hash, and FSON type)
-    fseek(db->file, 0, SEEK_SET);
-    char temp_path[256];
-    snprintf(temp_path, sizeof(temp_path), "%s.tmp", db->path);
-    FILE *temp_file = fopen(temp_path, "wb");
-    if (!temp_file) {
-        return FOSSIL_MYSHELL_ERROR_IO;
-    }
-
-    char line[1024];
-    bool found = false;
-    while (fgets(line, sizeof(line), db->file)) {
-        if (strncmp(line, "#stage ", 7) == 0) {
-            char *eq = strchr(line + 7, '=');
-            if (eq) {
-                *eq = '\0';
-                char *hash_comment = strstr(eq + 1, "#hash=");
-                char *type_comment = strstr(eq + 1, "#type=");
-                bool valid_type = false;
-                if (type_comment) {
-                    char type_name[32] = {0};
-                    int i = 0;
-                    type_comment += 6;
-                    while (type_comment[i] && !isspace((unsigned char)type_comment[i]) && type_comment[i] != '#' && i < 31) {
-                        type_name[i] = type_comment[i];
-                        i++;
-                    }
-                    type_name[i] = '\0';
-                    for (size_t j = 0; j <= MYSHELL_FSON_TYPE_DURATION; ++j) {
-                        if (strcmp(type_name, myshell_fson_type_names[j]) == 0) {
-                            valid_type = true;
-                            break;
-                        }
-                    }
-                }
-                if (hash_comment) {
-                    uint64_t file_hash = 0;
-                    sscanf(hash_comment, "#hash=%" SCNx64, &file_hash);
-                    if (strcmp(line + 7, key) == 0 && file_hash == key_hash && (type_comment == NULL || valid_type)) {
-                        found = true; // Skip this line
-                        *eq = '='; // Restore
-                        continue;
-                    }
-                } else {
-                    if (strcmp(line + 7, key) == 0 && (type_comment == NULL || valid_type)) {
-                        found = true; // Skip this line
-                        *eq = '='; // Restore
-                        continue;
-                    }
-                }
-                *eq = '='; // Restore
-            }
-        }
-        fputs(line, temp_file);
-    }
-
-    fclose(temp_file);
-    fclose(db->file);
-
-    if (found) {
-        if (remove(db->path) != 0) {
-            remove(temp_path);
-            db->file = fopen(db->path, "rb+");
-            if (!db->file) return FOSSIL_MYSHELL_ERROR_IO;
-            return FOSSIL_MYSHELL_ERROR_IO;
-        }
-        if (rename(temp_path, db->path) != 0) {
-            db->file = fopen(db->path, "rb+");
-            if (!db->file) return FOSSIL_MYSHELL_ERROR_IO;
-        }
+    if (!myshell_kvmap_remove((myshell_kvmap_t *)db->stage, key, key_hash)) {
+        return FOSSIL_MYSHELL_ERROR_NOT_FOUND;
     }
 
-    db->file = fopen(db->path, "rb+");
-    if (!db->file) {
-        return FOSSIL_MYSHELL_ERROR_IO;
-    }
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
 
-    return found ? FOSSIL_MYSHELL_ERROR_SUCCESS : FOSSIL_MYSHELL_ERROR_NOT_FOUND;
+fossil_bluecrab_myshell_error_t fossil_myshell_unstage(fossil_bluecrab_myshell_t *db, const char *key) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_unstage(db, key);
+    myshell_unlock(db);
+    return rc;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_tag(fossil_bluecrab_myshell_t *db, const char *commit_hash, const char *tag_name) {
+static fossil_bluecrab_myshell_error_t myshell_tag(fossil_bluecrab_myshell_t *db, const char *commit_hash, const char *tag_name) {
     if (!db) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
@@ -1260,14 +3985,23 @@ fossil_bluecrab_myshell_error_t fossil_myshell_tag(fossil_bluecrab_myshell_t *db
     if (fprintf(db->file, "#tag %016" PRIx64 " %s #type=%s\n", hash, tag_name, myshell_fson_type_to_string(commit_type)) < 0) {
         return FOSSIL_MYSHELL_ERROR_IO;
     }
-    fflush(db->file);
+    if (myshell_durable(db, false) != FOSSIL_MYSHELL_ERROR_SUCCESS) {
+        return FOSSIL_MYSHELL_ERROR_IO;
+    }
 
     db->last_modified = time(NULL);
 
     return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_log(fossil_bluecrab_myshell_t *db, fossil_myshell_commit_cb cb, void *user) {
+fossil_bluecrab_myshell_error_t fossil_myshell_tag(fossil_bluecrab_myshell_t *db, const char *commit_hash, const char *tag_name) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_tag(db, commit_hash, tag_name);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_log(fossil_bluecrab_myshell_t *db, fossil_myshell_commit_cb cb, void *user) {
     if (!db) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
@@ -1285,43 +4019,114 @@ fossil_bluecrab_myshell_error_t fossil_myshell_log(fossil_bluecrab_myshell_t *db
     char line[1024];
     while (fgets(line, sizeof(line), db->file)) {
         if (strncmp(line, "#commit ", 8) == 0) {
-            char hash_str[17] = {0};
-            char message[512] = {0};
-            long long timestamp = 0;
-            char type_name[32] = {0};
-            int n = sscanf(line, "#commit %16s %511[^\n] %lld #type=%31s", hash_str, message, &timestamp, type_name);
+            bool stop = false;
+            fossil_bluecrab_myshell_error_t rc = myshell_log_emit(line, cb, user, &stop);
+            if (rc != FOSSIL_MYSHELL_ERROR_SUCCESS) {
+                return rc;
+            }
+            if (stop) {
+                return FOSSIL_MYSHELL_ERROR_SUCCESS;
+            }
+        }
+    }
 
-            // FSON type system: parse type if present, default to ENUM
-            // (commit_type is not used, so skip parsing)
+    return FOSSIL_MYSHELL_ERROR_SUCCESS;
+}
 
-            if (n >= 3) {
-                uint64_t parsed_hash = 0;
-                sscanf(hash_str, "%" SCNx64, &parsed_hash);
-                char commit_data[1024];
-                snprintf(commit_data, sizeof(commit_data), "%s:%lld", message, timestamp);
-                uint64_t computed_hash = myshell_hash64(commit_data);
-                if (parsed_hash == computed_hash) {
-                    // Optionally, you could pass commit_type to the callback if its signature supports it
-                    if (!cb(hash_str, message, user)) {
-                        return FOSSIL_MYSHELL_ERROR_SUCCESS;
-                    }
-                } else {
-                    return FOSSIL_MYSHELL_ERROR_INTEGRITY;
-                }
-            } else if (n == 2) {
-                if (!cb(hash_str, message, user)) {
-                    return FOSSIL_MYSHELL_ERROR_SUCCESS;
-                }
-            } else {
-                return FOSSIL_MYSHELL_ERROR_PARSE_FAILED;
+fossil_bluecrab_myshell_error_t fossil_myshell_log(fossil_bluecrab_myshell_t *db, fossil_myshell_commit_cb cb, void *user) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_log(db, cb, user);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_log_range(
+    fossil_bluecrab_myshell_t *db,
+    const char *from_commit,
+    size_t limit,
+    fossil_myshell_log_direction_t direction,
+    fossil_myshell_commit_cb cb,
+    void *user
+) {
+    if (!db) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!db->is_open) {
+        return FOSSIL_MYSHELL_ERROR_LOCKED;
+    }
+    if (!cb) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+    if (direction != FOSSIL_MYSHELL_LOG_BACKWARD && direction != FOSSIL_MYSHELL_LOG_FORWARD) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+
+    myshell_commit_index_t *index = NULL;
+    fossil_bluecrab_myshell_error_t rc = myshell_commit_index_sync(db, &index);
+    if (rc != FOSSIL_MYSHELL_ERROR_SUCCESS) {
+        return rc;
+    }
+    if (index->count == 0) {
+        return from_commit ? FOSSIL_MYSHELL_ERROR_NOT_FOUND : FOSSIL_MYSHELL_ERROR_SUCCESS;
+    }
+
+    // Locate the starting commit (newest for backward, oldest for forward)
+    size_t start = direction == FOSSIL_MYSHELL_LOG_BACKWARD ? index->count - 1 : 0;
+    if (from_commit) {
+        uint64_t wanted = 0;
+        if (sscanf(from_commit, "%" SCNx64, &wanted) != 1) {
+            return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+        }
+        bool found = false;
+        for (size_t i = index->count; i-- > 0;) {
+            if (index->items[i].hash == wanted) {
+                start = i;
+                found = true;
+                break;
             }
         }
+        if (!found) {
+            return FOSSIL_MYSHELL_ERROR_NOT_FOUND;
+        }
+    }
+
+    size_t emitted = 0;
+    char line[1024];
+    for (size_t i = start; i < index->count && (limit == 0 || emitted < limit); ++emitted) {
+        if (fseek(db->file, index->items[i].offset, SEEK_SET) != 0 || !fgets(line, sizeof(line), db->file)) {
+            return FOSSIL_MYSHELL_ERROR_IO;
+        }
+        bool stop = false;
+        rc = myshell_log_emit(line, cb, user, &stop);
+        if (rc != FOSSIL_MYSHELL_ERROR_SUCCESS || stop) {
+            return rc;
+        }
+        if (direction == FOSSIL_MYSHELL_LOG_BACKWARD) {
+            if (i == 0) break;
+            i--;
+        } else {
+            i++;
+        }
     }
 
     return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_backup(fossil_bluecrab_myshell_t *db, const char *backup_path) {
+fossil_bluecrab_myshell_error_t fossil_myshell_log_range(
+    fossil_bluecrab_myshell_t *db,
+    const char *from_commit,
+    size_t limit,
+    fossil_myshell_log_direction_t direction,
+    fossil_myshell_commit_cb cb,
+    void *user
+) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_log_range(db, from_commit, limit, direction, cb, user);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_backup(fossil_bluecrab_myshell_t *db, const char *backup_path) {
     if (!db || !db->is_open) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
@@ -1369,6 +4174,13 @@ fossil_bluecrab_myshell_error_t fossil_myshell_backup(fossil_bluecrab_myshell_t
     return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
 
+fossil_bluecrab_myshell_error_t fossil_myshell_backup(fossil_bluecrab_myshell_t *db, const char *backup_path) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_backup(db, backup_path);
+    myshell_unlock(db);
+    return rc;
+}
+
 fossil_bluecrab_myshell_error_t fossil_myshell_restore(const char *backup_path, const char *target_path) {
     if (!backup_path || !target_path) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
@@ -1492,7 +4304,7 @@ const char *fossil_myshell_errstr(fossil_bluecrab_myshell_error_t err) {
     }
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_check_integrity(fossil_bluecrab_myshell_t *db) {
+static fossil_bluecrab_myshell_error_t myshell_check_integrity(fossil_bluecrab_myshell_t *db) {
     if (!db || !db->is_open) {
         return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
     }
@@ -1570,11 +4382,13 @@ fossil_bluecrab_myshell_error_t fossil_myshell_check_integrity(fossil_bluecrab_m
         }
         // Key-value integrity: check hash and FSON type
         else {
-            char *eq = strchr(line, '=');
+            size_t len = strlen(line);
+            char *line_end = line + len;
+            char *eq = (char *)fossil_bluecrab_scan_byte(line, len, '=');
             if (eq) {
                 *eq = '\0';
-                char *hash_comment = strstr(eq + 1, "#hash=");
-                char *type_comment = strstr(eq + 1, "#type=");
+                char *hash_comment = myshell_find_tag(eq + 1, (size_t)(line_end - eq - 1), "#hash=");
+                char *type_comment = myshell_find_tag(eq + 1, (size_t)(line_end - eq - 1), "#type=");
                 if (type_comment) {
                     type_comment += 6;
                     char type_name[32] = {0};
@@ -1597,9 +4411,8 @@ fossil_bluecrab_myshell_error_t fossil_myshell_check_integrity(fossil_bluecrab_m
                     }
                 }
                 if (hash_comment) {
-                    uint64_t file_hash = 0;
-                    sscanf(hash_comment, "#hash=%" SCNx64, &file_hash);
-                    uint64_t key_hash = myshell_hash64(line);
+                    uint64_t file_hash = myshell_read_hash(hash_comment, line_end);
+                    uint64_t key_hash = fossil_bluecrab_hash64_legacy(line, (size_t)(eq - line));
                     if (file_hash != key_hash) {
                         *eq = '='; // Restore
                         return FOSSIL_MYSHELL_ERROR_INTEGRITY;
@@ -1613,7 +4426,14 @@ fossil_bluecrab_myshell_error_t fossil_myshell_check_integrity(fossil_bluecrab_m
     return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
 
-fossil_bluecrab_myshell_error_t fossil_myshell_diff(
+fossil_bluecrab_myshell_error_t fossil_myshell_check_integrity(fossil_bluecrab_myshell_t *db) {
+    myshell_lock(db);
+    fossil_bluecrab_myshell_error_t rc = myshell_check_integrity(db);
+    myshell_unlock(db);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_diff(
     const fossil_bluecrab_myshell_t *db1,
     const fossil_bluecrab_myshell_t *db2,
     char *out_diff,
@@ -1760,3 +4580,371 @@ fossil_bluecrab_myshell_error_t fossil_myshell_diff(
 
     return FOSSIL_MYSHELL_ERROR_SUCCESS;
 }
+
+fossil_bluecrab_myshell_error_t fossil_myshell_diff(
+    const fossil_bluecrab_myshell_t *db1,
+    const fossil_bluecrab_myshell_t *db2,
+    char *out_diff,
+    size_t out_size
+) {
+    // Both handles, in a fixed order so two opposite diffs cannot deadlock
+    fossil_bluecrab_myshell_t *first = (fossil_bluecrab_myshell_t *)(db1 < db2 ? db1 : db2);
+    fossil_bluecrab_myshell_t *second = (fossil_bluecrab_myshell_t *)(db1 < db2 ? db2 : db1);
+    myshell_lock(first);
+    myshell_lock(second);
+    fossil_bluecrab_myshell_error_t rc = myshell_diff(db1, db2, out_diff, out_size);
+    myshell_unlock(second);
+    myshell_unlock(first);
+    return rc;
+}
+
+// ===========================================================
+// Sharded Databases
+// ===========================================================
+
+#define MYSHELL_SHARDS_MAX      1024
+#define MYSHELL_SHARDS_MANIFEST "shards.manifest"
+
+#define MYSHELL_SHARDS_THREADS  16
+
+/**
+ * Per-shard work shared by a fixed set of workers, which take shard
+ * indices from 'next' until none are left. A worker holds the shard's
+ * mutex for the duration of fn, so a scan never interleaves with a write
+ * on that shard.
+ */
+typedef struct {
+    fossil_bluecrab_myshell_sharded_t *db;
+    fossil_bluecrab_myshell_error_t (*fn)(fossil_bluecrab_myshell_sharded_t *db, size_t shard, void *arg);
+    void  *arg;
+    volatile size_t next;
+    fossil_bluecrab_myshell_error_t *rcs;   // one per shard
+} myshell_shard_work_t;
+
+static fossil_bluecrab_thread_mutex_t *myshell_shard_lock(fossil_bluecrab_myshell_sharded_t *db, size_t shard) {
+    return &((fossil_bluecrab_thread_mutex_t *)db->locks)[shard];
+}
+
+FOSSIL_THREAD_FN(myshell_shard_worker) {
+    myshell_shard_work_t *work = (myshell_shard_work_t *)arg;
+    for (;;) {
+        size_t shard = fossil_bluecrab_thread_fetch_inc(&work->next);
+        if (shard >= work->db->nshards)
+            break;
+        fossil_bluecrab_thread_mutex_lock(myshell_shard_lock(work->db, shard));
+        work->rcs[shard] = work->fn(work->db, shard, work->arg);
+        fossil_bluecrab_thread_mutex_unlock(myshell_shard_lock(work->db, shard));
+    }
+    FOSSIL_THREAD_RETURN;
+}
+
+/**
+ * Runs fn on every shard using at most one worker per processor (and no
+ * more than MYSHELL_SHARDS_THREADS), the calling thread among them. If no
+ * extra thread starts, the calling thread does all the work. Returns the
+ * first failing shard's code in shard order.
+ */
+static fossil_bluecrab_myshell_error_t myshell_shards_parallel(
+    fossil_bluecrab_myshell_sharded_t *db,
+    fossil_bluecrab_myshell_error_t (*fn)(fossil_bluecrab_myshell_sharded_t *db, size_t shard, void *arg),
+    void *arg
+) {
+    myshell_shard_work_t work = {0};
+    work.db = db;
+    work.fn = fn;
+    work.arg = arg;
+    work.rcs = (fossil_bluecrab_myshell_error_t *)calloc(db->nshards, sizeof(*work.rcs));
+    if (!work.rcs)
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+
+    size_t workers = fossil_bluecrab_thread_cpu_count();
+    if (workers > MYSHELL_SHARDS_THREADS)
+        workers = MYSHELL_SHARDS_THREADS;
+    if (workers > db->nshards)
+        workers = db->nshards;
+
+    fossil_bluecrab_thread_t threads[MYSHELL_SHARDS_THREADS];
+    bool started[MYSHELL_SHARDS_THREADS] = {false};
+    for (size_t i = 1; i < workers; ++i)
+        started[i] = fossil_bluecrab_thread_start(&threads[i], myshell_shard_worker, &work);
+    myshell_shard_worker(&work);
+    for (size_t i = 1; i < workers; ++i) {
+        if (started[i])
+            fossil_bluecrab_thread_join(threads[i]);
+    }
+
+    fossil_bluecrab_myshell_error_t rc = FOSSIL_MYSHELL_ERROR_SUCCESS;
+    for (size_t i = 0; i < db->nshards && rc == FOSSIL_MYSHELL_ERROR_SUCCESS; ++i)
+        rc = work.rcs[i];
+    free(work.rcs);
+    return rc;
+}
+
+static int myshell_make_dir(const char *dir) {
+#if defined(_WIN32) || defined(_WIN64)
+    if (CreateDirectoryA(dir, NULL) || GetLastError() == ERROR_ALREADY_EXISTS)
+        return 0;
+    return -1;
+#else
+    if (mkdir(dir, 0755) == 0 || errno == EEXIST)
+        return 0;
+    return -1;
+#endif
+}
+
+static char *myshell_shard_path(const char *dir, const char *name) {
+    size_t len = strlen(dir) + strlen(name) + 2;
+    char *path = (char *)malloc(len);
+    if (path) {
+        snprintf(path, len, "%s/%s", dir, name);
+    }
+    return path;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_shard_open_one(fossil_bluecrab_myshell_sharded_t *db, size_t shard, void *arg) {
+    (void)arg;
+    char name[32];
+    snprintf(name, sizeof(name), "shard-%04zu.myshell", shard);
+    char *path = myshell_shard_path(db->dir, name);
+    if (!path) {
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    fossil_bluecrab_myshell_error_t rc = FOSSIL_MYSHELL_ERROR_SUCCESS;
+    db->shards[shard] = fossil_myshell_open(path, &rc);
+    if (!db->shards[shard] && rc == FOSSIL_MYSHELL_ERROR_FILE_NOT_FOUND) {
+        db->shards[shard] = fossil_myshell_create(path, &rc);
+    }
+    free(path);
+    return db->shards[shard] ? FOSSIL_MYSHELL_ERROR_SUCCESS : rc;
+}
+
+/**
+ * Reads the recorded shard count, or writes 'nshards' if the directory has
+ * no manifest yet. On return *count holds the count to use.
+ */
+static fossil_bluecrab_myshell_error_t myshell_shards_manifest(const char *dir, size_t nshards, size_t *count) {
+    char *path = myshell_shard_path(dir, MYSHELL_SHARDS_MANIFEST);
+    if (!path) {
+        return FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+    }
+
+    fossil_bluecrab_myshell_error_t rc = FOSSIL_MYSHELL_ERROR_SUCCESS;
+    FILE *file = fopen(path, "rb");
+    if (file) {
+        size_t recorded = 0;
+        if (fscanf(file, "#myshell_shards count=%zu", &recorded) != 1 ||
+            recorded == 0 || recorded > MYSHELL_SHARDS_MAX) {
+            rc = FOSSIL_MYSHELL_ERROR_CORRUPTED;
+        } else if (nshards && nshards != recorded) {
+            rc = FOSSIL_MYSHELL_ERROR_SCHEMA_MISMATCH;
+        } else {
+            *count = recorded;
+        }
+        fclose(file);
+    } else if (nshards == 0) {
+        rc = FOSSIL_MYSHELL_ERROR_CONFIG_INVALID;
+    } else {
+        file = fopen(path, "wb");
+        if (!file || fprintf(file, "#myshell_shards count=%zu\n", nshards) < 0 || fossil_bluecrab_sync_file(file) != 0) {
+            rc = FOSSIL_MYSHELL_ERROR_IO;
+        } else {
+            *count = nshards;
+        }
+        if (file) fclose(file);
+    }
+    free(path);
+    return rc;
+}
+
+fossil_bluecrab_myshell_sharded_t *fossil_myshell_open_sharded(const char *dir, size_t nshards, fossil_bluecrab_myshell_error_t *err) {
+    if (!dir || !*dir || nshards > MYSHELL_SHARDS_MAX) {
+        if (err) *err = FOSSIL_MYSHELL_ERROR_CONFIG_INVALID;
+        return NULL;
+    }
+    if (myshell_make_dir(dir) != 0) {
+        if (err) *err = FOSSIL_MYSHELL_ERROR_IO;
+        return NULL;
+    }
+
+    size_t count = 0;
+    fossil_bluecrab_myshell_error_t rc = myshell_shards_manifest(dir, nshards, &count);
+    if (rc != FOSSIL_MYSHELL_ERROR_SUCCESS) {
+        if (err) *err = rc;
+        return NULL;
+    }
+
+    fossil_bluecrab_myshell_sharded_t *db = (fossil_bluecrab_myshell_sharded_t *)calloc(1, sizeof(*db));
+    if (!db) {
+        if (err) *err = FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+        return NULL;
+    }
+    db->nshards = count;
+    db->dir = myshell_strdup(dir);
+    db->shards = (fossil_bluecrab_myshell_t **)calloc(count, sizeof(*db->shards));
+    fossil_bluecrab_thread_mutex_t *locks = (fossil_bluecrab_thread_mutex_t *)calloc(count, sizeof(*locks));
+    if (!db->dir || !db->shards || !locks) {
+        free(db->dir);
+        free(db->shards);
+        free(locks);
+        free(db);
+        if (err) *err = FOSSIL_MYSHELL_ERROR_OUT_OF_MEMORY;
+        return NULL;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        fossil_bluecrab_thread_mutex_init(&locks[i]);
+    }
+    db->locks = locks;
+
+    // Opening validates each shard file, so it is a scan worth spreading out
+    rc = myshell_shards_parallel(db, myshell_shard_open_one, NULL);
+    if (rc != FOSSIL_MYSHELL_ERROR_SUCCESS) {
+        fossil_myshell_close_sharded(db);
+        if (err) *err = rc;
+        return NULL;
+    }
+    if (err) *err = FOSSIL_MYSHELL_ERROR_SUCCESS;
+    return db;
+}
+
+void fossil_myshell_close_sharded(fossil_bluecrab_myshell_sharded_t *db) {
+    if (!db) return;
+    for (size_t i = 0; i < db->nshards; ++i) {
+        if (db->shards[i]) {
+            fossil_myshell_close(db->shards[i]);
+        }
+        fossil_bluecrab_thread_mutex_destroy(myshell_shard_lock(db, i));
+    }
+    free(db->locks);
+    free(db->shards);
+    free(db->dir);
+    free(db);
+}
+
+size_t fossil_myshell_sharded_shard_of(const fossil_bluecrab_myshell_sharded_t *db, const char *key) {
+    if (!db || !key || db->nshards == 0) {
+        return 0;
+    }
+    return (size_t)(myshell_hash64(key) % db->nshards);
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_sharded_put(fossil_bluecrab_myshell_sharded_t *db, const char *key, const char *type, const char *value) {
+    if (!db) return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    if (!key) return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    size_t shard = fossil_myshell_sharded_shard_of(db, key);
+    fossil_bluecrab_thread_mutex_lock(myshell_shard_lock(db, shard));
+    fossil_bluecrab_myshell_error_t rc = fossil_myshell_put(db->shards[shard], key, type, value);
+    fossil_bluecrab_thread_mutex_unlock(myshell_shard_lock(db, shard));
+    return rc;
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_sharded_get(fossil_bluecrab_myshell_sharded_t *db, const char *key, char *out_value, size_t out_size) {
+    if (!db) return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    if (!key) return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    size_t shard = fossil_myshell_sharded_shard_of(db, key);
+    fossil_bluecrab_thread_mutex_lock(myshell_shard_lock(db, shard));
+    fossil_bluecrab_myshell_error_t rc = fossil_myshell_get(db->shards[shard], key, out_value, out_size);
+    fossil_bluecrab_thread_mutex_unlock(myshell_shard_lock(db, shard));
+    return rc;
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_sharded_del(fossil_bluecrab_myshell_sharded_t *db, const char *key) {
+    if (!db) return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    if (!key) return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    size_t shard = fossil_myshell_sharded_shard_of(db, key);
+    fossil_bluecrab_thread_mutex_lock(myshell_shard_lock(db, shard));
+    fossil_bluecrab_myshell_error_t rc = fossil_myshell_del(db->shards[shard], key);
+    fossil_bluecrab_thread_mutex_unlock(myshell_shard_lock(db, shard));
+    return rc;
+}
+
+/**
+ * Query state shared by the shard scanners. The user callback runs under
+ * 'mutex', so it is never entered concurrently, and 'emitted' enforces the
+ * LIMIT over the merged rows.
+ */
+typedef struct {
+    const char *sql;
+    fossil_myshell_row_cb cb;
+    void   *user;
+    size_t  limit;
+    size_t  emitted;
+    bool    stop;
+    fossil_bluecrab_thread_mutex_t mutex;
+} myshell_shard_query_t;
+
+static bool myshell_shard_query_row(const char *key, const char *type, const char *value, void *user) {
+    myshell_shard_query_t *sq = (myshell_shard_query_t *)user;
+    fossil_bluecrab_thread_mutex_lock(&sq->mutex);
+    bool more = !sq->stop && sq->emitted < sq->limit;
+    if (more) {
+        sq->emitted++;
+        more = sq->cb(key, type, value, sq->user) && sq->emitted < sq->limit;
+        if (!more) {
+            sq->stop = true;
+        }
+    }
+    fossil_bluecrab_thread_mutex_unlock(&sq->mutex);
+    return more;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_shard_query_one(fossil_bluecrab_myshell_sharded_t *db, size_t shard, void *arg) {
+    myshell_shard_query_t *sq = (myshell_shard_query_t *)arg;
+    fossil_bluecrab_thread_mutex_lock(&sq->mutex);
+    bool stop = sq->stop;
+    fossil_bluecrab_thread_mutex_unlock(&sq->mutex);
+    if (stop) {
+        return FOSSIL_MYSHELL_ERROR_SUCCESS;
+    }
+    return fossil_myshell_query(db->shards[shard], sq->sql, myshell_shard_query_row, sq);
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_sharded_query(fossil_bluecrab_myshell_sharded_t *db, const char *sql, fossil_myshell_row_cb cb, void *user) {
+    if (!db) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    if (!sql || !cb) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_QUERY;
+    }
+
+    // Parse once up front: rejects bad SQL before any thread starts and
+    // exposes LIMIT and a routable key equality
+    myshell_query_t q;
+    fossil_bluecrab_myshell_error_t rc = myshell_query_parse(sql, &q);
+    if (rc != FOSSIL_MYSHELL_ERROR_SUCCESS) {
+        return rc;
+    }
+
+    myshell_shard_query_t sq;
+    sq.sql = sql;
+    sq.cb = cb;
+    sq.user = user;
+    sq.limit = q.has_limit ? q.limit : SIZE_MAX;
+    sq.emitted = 0;
+    sq.stop = sq.limit == 0;
+    fossil_bluecrab_thread_mutex_init(&sq.mutex);
+
+    if (q.point_key) {
+        size_t shard = fossil_myshell_sharded_shard_of(db, q.point_key);
+        fossil_bluecrab_thread_mutex_lock(myshell_shard_lock(db, shard));
+        rc = myshell_shard_query_one(db, shard, &sq);
+        fossil_bluecrab_thread_mutex_unlock(myshell_shard_lock(db, shard));
+    } else {
+        rc = myshell_shards_parallel(db, myshell_shard_query_one, &sq);
+    }
+
+    fossil_bluecrab_thread_mutex_destroy(&sq.mutex);
+    myshell_query_free(&q);
+    return rc;
+}
+
+static fossil_bluecrab_myshell_error_t myshell_shard_check_one(fossil_bluecrab_myshell_sharded_t *db, size_t shard, void *arg) {
+    (void)arg;
+    return fossil_myshell_check_integrity(db->shards[shard]);
+}
+
+fossil_bluecrab_myshell_error_t fossil_myshell_sharded_check_integrity(fossil_bluecrab_myshell_sharded_t *db) {
+    if (!db) {
+        return FOSSIL_MYSHELL_ERROR_INVALID_FILE;
+    }
+    return myshell_shards_parallel(db, myshell_shard_check_one, NULL);
+}
@@ -22,7 +22,38 @@
  * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
  * -----------------------------------------------------------------------------
  */
+#if !defined(_WIN32) && !defined(_WIN64) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+#if !defined(_WIN32) && !defined(_WIN64) && !defined(_XOPEN_SOURCE)
+#define _XOPEN_SOURCE 700               // realpath
+#endif
 #include "fossil/crabdb/noshell.h"
+#include "fossil/crabdb/hash.h"
+#include "fossil/crabdb/query.h"
+#include "fossil/crabdb/scan.h"
+#include "fossil/crabdb/sync.h"
+#include "fossil/crabdb/thread.h"
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#endif
+
+// Vector kernels for posting-list intersection (text indexes). Define
+// FOSSIL_BLUECRAB_NOSHELL_SCALAR to build without them.
+#if !defined(FOSSIL_BLUECRAB_NOSHELL_SCALAR)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NOSHELL_HAVE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define NOSHELL_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
 
 /**
  * @brief Implements the core logic for the Fossil BlueCrab .noshell file database.
@@ -101,15 +132,22 @@
  * ```
  *
  * ## Main Functions
- * - `noshell_hash64`: Computes a 64-bit hash for strings (MurmurHash3 variant).
+ * - `noshell_hash64`: Computes the on-disk 64-bit hash for strings (shared legacy hash).
  * - `fossil_bluecrab_noshell_open_database`: Opens an existing .noshell database file.
  * - `fossil_bluecrab_noshell_create_database`: Creates a new .noshell database file.
  * - `fossil_bluecrab_noshell_delete_database`: Deletes a database file.
  * - `fossil_bluecrab_noshell_insert`: Inserts a document.
  * - `fossil_bluecrab_noshell_insert_with_id`: Inserts a document and returns its ID.
- * - `fossil_bluecrab_noshell_find`: Finds a document by query.
- * - `fossil_bluecrab_noshell_update`: Updates a document.
- * - `fossil_bluecrab_noshell_remove`: Removes a document.
+ * - `fossil_bluecrab_noshell_handle_insert_many`: Validates and hashes a batch (in parallel when large) and appends it with one write.
+ * - `fossil_bluecrab_noshell_find`: Finds a document by query (substring, or `WHERE field op value ...`).
+ * - `fossil_bluecrab_noshell_find_cb_parallel`: Scans newline-aligned chunks on worker threads, ordered or unordered.
+ * - `fossil_bluecrab_noshell_query_compile` / `_match` / `_free`: Structured queries compiled once.
+ * - `fossil_bluecrab_noshell_create_index` / `_drop_index`: In-memory hash, ordered or trigram
+ *   text index on a document field (or the whole line), kept current across writes and used by finds.
+ * - `fossil_bluecrab_noshell_find_by_id`: Finds a document by ID through the document id index.
+ * - `fossil_bluecrab_noshell_update`: Updates a document (appends a tombstone and the new version).
+ * - `fossil_bluecrab_noshell_remove`: Removes a document (appends a tombstone).
+ * - `fossil_bluecrab_noshell_compact`: Rewrites the file without retired documents and tombstones.
  * - `fossil_bluecrab_noshell_backup_database`: Creates a backup of the database.
  * - `fossil_bluecrab_noshell_restore_database`: Restores a database from backup.
  * - `fossil_bluecrab_noshell_verify_database`: Verifies file and document integrity.
@@ -119,13 +157,28 @@
  * - `fossil_bluecrab_noshell_get_file_size`: Gets the database file size.
  * - `fossil_bluecrab_noshell_validate_extension`: Validates file extension.
  * - `fossil_bluecrab_noshell_validate_document`: Validates document format.
+ * - `fossil_bluecrab_noshell_open` / `fossil_bluecrab_noshell_close`: Persistent handles; the
+ *   `fossil_bluecrab_noshell_handle_*` functions run the document operations on an open handle.
+ * - `fossil_bluecrab_noshell_cursor_open` / `_next` / `_next_batch` / `_close`: Forward cursor
+ *   returning document, type and id as views into its own buffer.
+ * - `fossil_bluecrab_noshell_lsm_enable` / `_disable`: Moves a database into (or back out of)
+ *   an LSM tree of sorted segments keyed by id; the file-name functions route to it.
  *
  * ## Error Handling
  * All functions return a `fossil_bluecrab_noshell_error_t` code indicating success or the type of error.
  *
  * ## Usage Notes
  * - Only files with the ".noshell" extension are supported.
- * - All operations are performed directly on the file; there is no in-memory caching.
+ * - The file-name functions open, scan and close the file on every call. A handle from
+ *   `fossil_bluecrab_noshell_open` keeps the file, a read buffer and a document table
+ *   (offset and id per document) between calls, and is shared by every open of the same path.
+ * - `fossil_bluecrab_noshell_submit_find` / `fossil_bluecrab_noshell_submit_insert`
+ *   queue work on a shared worker pool: finds run concurrently, inserts on a file
+ *   run in order; callbacks run from `fossil_bluecrab_noshell_async_poll` /
+ *   `fossil_bluecrab_noshell_async_wait`.
+ * - `fossil_bluecrab_noshell_set_durability` selects, per file, between flushing
+ *   on every operation (default, since each operation closes the file), fsync
+ *   after every write, or a background fdatasync/fsync every N ms.
  * - Integrity of data is ensured via hashes for keys and documents.
  * - The API is designed for simple key-value storage with basic integrity features.
  * - The FSON type system is enforced for all key-value and metadata entries.
@@ -171,46 +224,1015 @@ static char *noshell_strdup(const char *s) {
 }
 
 /**
- * Advanced 64-bit hash algorithm for strings (MurmurHash3 variant).
- * Returns a 64-bit hash value for the given input string.
+ * Canonical absolute form of a path, the key of per-file state: the same
+ * file reached as "db.noshell", "./db.noshell" or through a symlink gets
+ * one key. A file that does not exist yet resolves through its directory.
+ * Returns a malloc'd string (a plain copy when nothing resolves).
+ */
+static char *noshell_canonical_path(const char *file_name) {
+#if defined(_WIN32) || defined(_WIN64)
+    char *full = _fullpath(NULL, file_name, 0);
+    return full ? full : noshell_strdup(file_name);
+#else
+    char *full = realpath(file_name, NULL);
+    if (full)
+        return full;
+    const char *slash = strrchr(file_name, '/');
+    char *dir_name = slash ? noshell_strdup(file_name) : NULL;
+    if (dir_name)
+        dir_name[slash == file_name ? 1 : slash - file_name] = '\0';
+    char *dir = realpath(slash ? (dir_name ? dir_name : "/") : ".", NULL);
+    free(dir_name);
+    if (!dir)
+        return noshell_strdup(file_name);
+    const char *base = slash ? slash + 1 : file_name;
+    size_t dir_len = strlen(dir), size = dir_len + strlen(base) + 2;
+    char *joined = (char *)malloc(size);
+    if (joined)
+        snprintf(joined, size, "%s%s%s", dir, dir_len && dir[dir_len - 1] == '/' ? "" : "/", base);
+    free(dir);
+    return joined;
+#endif
+}
+
+/**
+ * 64-bit string hash used for on-disk hashes. Delegates to the shared
+ * legacy hash so values already written to files keep matching.
  */
 uint64_t noshell_hash64(const char *str) {
     if (!str) return 0;
-    uint64_t seed = 0xe17a1465ULL;
-    uint64_t m = 0xc6a4a7935bd1e995ULL;
-    int r = 47;
-    size_t len = strlen(str);
-    uint64_t hash = seed ^ (len * m);
-
-    const uint8_t *data = (const uint8_t *)str;
-    const uint8_t *end = data + (len & ~0x7);
-
-    while (data != end) {
-        uint64_t k;
-        memcpy(&k, data, sizeof(uint64_t));
-        k *= m;
-        k ^= k >> r;
-        k *= m;
-        hash ^= k;
-        hash *= m;
-        data += 8;
-    }
-
-    switch (len & 7) {
-        case 7: hash ^= (uint64_t)data[6] << 48; /* fall through */
-        case 6: hash ^= (uint64_t)data[5] << 40; /* fall through */
-        case 5: hash ^= (uint64_t)data[4] << 32; /* fall through */
-        case 4: hash ^= (uint64_t)data[3] << 24; /* fall through */
-        case 3: hash ^= (uint64_t)data[2] << 16; /* fall through */
-        case 2: hash ^= (uint64_t)data[1] << 8;  /* fall through */
-        case 1: hash ^= (uint64_t)data[0];
-                hash *= m;
-    }
-
-    hash ^= hash >> r;
-    hash *= m;
-    hash ^= hash >> r;
-    return hash;
+    return fossil_bluecrab_hash64_legacy(str, strlen(str));
+}
+
+// Document id index (see "Document Id Index" below)
+typedef struct noshell_id_cache_t noshell_id_cache_t;
+static void noshell_id_cache_free(noshell_id_cache_t *c);
+static fossil_bluecrab_noshell_error_t noshell_path_step(const char *file_name, const char *prev_id, char *id_buffer, size_t buffer_size);
+static fossil_bluecrab_noshell_error_t noshell_path_find_by_id(const char *file_name, const char *id, char *result, size_t buffer_size);
+
+// Secondary field indexes (see "Secondary Field Indexes" below)
+typedef struct noshell_index_set_t noshell_index_set_t;
+
+// Line helpers (see "Persistent Handles" below)
+static bool noshell_is_document(const char *line);
+static size_t noshell_getline(FILE *fp, char **line, size_t *cap);
+
+// Tombstones (see "Tombstones and Compaction" below)
+typedef struct {
+    uint64_t *slots;        // dead line offset + 1, 0 = empty
+    size_t    slot_count;   // power of two, or 0
+    size_t    count;
+    uint64_t  dead_bytes;   // tombstone lines plus the lines they name
+} noshell_tombs_t;
+
+static fossil_bluecrab_noshell_error_t noshell_tombs_load(const char *file_name, FILE *fp, noshell_tombs_t *out);
+static bool noshell_tombs_has(const noshell_tombs_t *t, uint64_t offset);
+static void noshell_tombs_free(noshell_tombs_t *t);
+static bool noshell_tomb_parse(const char *line, uint64_t *offset, uint64_t *length);
+typedef struct noshell_tomb_cache_t noshell_tomb_cache_t;
+static void noshell_tomb_cache_free(noshell_tomb_cache_t *c);
+static bool noshell_copy_live(FILE *in, FILE *out, const noshell_tombs_t *tombs);
+
+// Document statistics (see "Document Statistics" below)
+typedef struct {
+    uint64_t size;          // bytes covered by the counts
+    uint64_t tail;
+    uint64_t docs;
+    uint64_t dead_bytes;
+    uint64_t types[FOSSIL_NOSHELL_STATS_TYPES];
+} noshell_meta_t;
+
+static fossil_bluecrab_noshell_error_t noshell_meta_load(const char *file_name, noshell_meta_t *out);
+static char *noshell_meta_path(const char *file_name, const char *suffix);
+
+// ===========================================================
+// Line Reader
+// ===========================================================
+
+#define NOSHELL_READER_BLOCK (64 * 1024)
+
+/**
+ * Block line reader for the full-file scans: reads NOSHELL_READER_BLOCK
+ * bytes at a time and splits lines with the vector newline search. Each
+ * line is handed out in place, newline included, NUL-terminated by
+ * borrowing the first byte of the next line (restored on the next call).
+ */
+typedef struct {
+    FILE   *fp;
+    char   *buf;            // cap + 1 bytes
+    size_t  cap;
+    size_t  begin;          // unread bytes are buf[begin..end)
+    size_t  end;
+    size_t  held;           // byte under the current terminator, or SIZE_MAX
+    char    saved;
+    bool    eof;
+} noshell_reader_t;
+
+static void noshell_reader_init(noshell_reader_t *r, FILE *fp) {
+    memset(r, 0, sizeof(*r));
+    r->fp = fp;
+    r->held = SIZE_MAX;
+}
+
+static void noshell_reader_free(noshell_reader_t *r) {
+    free(r->buf);
+    r->buf = NULL;
+}
+
+/**
+ * Returns the next line and its length (newline included), or NULL at end
+ * of file or when out of memory.
+ */
+static char *noshell_reader_next(noshell_reader_t *r, size_t *len) {
+    if (r->held != SIZE_MAX) {
+        r->buf[r->held] = r->saved;
+        r->held = SIZE_MAX;
+    }
+    size_t searched = 0;    // bytes after begin already known to hold no newline
+    for (;;) {
+        const char *nl = r->buf ? fossil_bluecrab_scan_newline(r->buf + r->begin + searched, r->end - r->begin - searched) : NULL;
+        if (nl || (r->eof && r->begin < r->end)) {
+            char *line = r->buf + r->begin;
+            size_t n = nl ? (size_t)(nl - line) + 1 : r->end - r->begin;
+            r->begin += n;
+            if (r->begin < r->end) {
+                r->held = r->begin;
+                r->saved = r->buf[r->begin];
+            }
+            r->buf[r->begin] = '\0';
+            *len = n;
+            return line;
+        }
+        if (r->eof)
+            return NULL;
+
+        searched = r->end - r->begin;
+        if (r->begin > 0) {
+            memmove(r->buf, r->buf + r->begin, searched);
+            r->end = searched;
+            r->begin = 0;
+        }
+        if (r->end == r->cap) {
+            size_t cap = r->cap ? r->cap * 2 : NOSHELL_READER_BLOCK;
+            char *grown = (char *)realloc(r->buf, cap + 1);
+            if (!grown)
+                return NULL;
+            r->buf = grown;
+            r->cap = cap;
+        }
+        size_t got = fread(r->buf + r->end, 1, r->cap - r->end, r->fp);
+        r->end += got;
+        if (got == 0)
+            r->eof = true;
+    }
+}
+
+// ===========================================================
+// Per-File State
+// ===========================================================
+
+/**
+ * Everything NoShell keeps about a file between calls (durability policy,
+ * open handle, document id cache, field indexes, LSM store, tombstone set)
+ * hangs off one entry of a process-wide registry keyed by canonical path,
+ * so "db.noshell" and "./db.noshell" share it. The registry lock guards
+ * the list, reference counts and write counters; each slot is guarded by
+ * a mutex of the entry, so work on different files never serialises. Lock
+ * order: handle, lsm_mutex, store, mutex, tomb_mutex, registry.
+ *
+ * An entry lives while it is referenced: by a caller between
+ * noshell_file_acquire and noshell_file_release, and by an open handle,
+ * an open LSM store, field indexes or a non-default durability policy.
+ * Unreferenced entries past the NOSHELL_FILE_CACHE_MAX most recently used
+ * are freed with their caches.
+ *
+ * Caches never need to be told about appends (they catch up from their
+ * stamps), but anything else that changes the file must go through
+ * noshell_file_invalidate: it counts as a rewrite, after which field
+ * indexes and tombstone sets rescan from the start, id caches rebuild
+ * and the statistics sidecar is removed.
+ */
+typedef struct noshell_file_t {
+    char    *key;                   // canonical path
+    struct noshell_file_t *next;    // most recently used first
+    size_t   refs;
+    uint64_t writes;                // writes through this library
+    uint64_t rewritten;             // writes as of the last rewrite
+    fossil_bluecrab_thread_mutex_t mutex;
+    fossil_bluecrab_noshell_durability_t durability;
+    fossil_bluecrab_sync_worker_t *syncer;  // PERIODIC only
+    fossil_bluecrab_noshell_t *handle;
+    noshell_id_cache_t  *ids;
+    noshell_index_set_t *indexes;
+    fossil_bluecrab_thread_mutex_t lsm_mutex;
+    struct noshell_lsm_t *lsm;
+    fossil_bluecrab_thread_mutex_t tomb_mutex;
+    noshell_tomb_cache_t *tombs;
+} noshell_file_t;
+
+#define NOSHELL_FILE_CACHE_MAX 8
+
+static noshell_file_t *noshell_files = NULL;
+#if defined(_WIN32) || defined(_WIN64)
+static SRWLOCK noshell_files_lock = SRWLOCK_INIT;
+#define NOSHELL_FILES_LOCK()   AcquireSRWLockExclusive(&noshell_files_lock)
+#define NOSHELL_FILES_UNLOCK() ReleaseSRWLockExclusive(&noshell_files_lock)
+#else
+static pthread_mutex_t noshell_files_lock = PTHREAD_MUTEX_INITIALIZER;
+#define NOSHELL_FILES_LOCK()   pthread_mutex_lock(&noshell_files_lock)
+#define NOSHELL_FILES_UNLOCK() pthread_mutex_unlock(&noshell_files_lock)
+#endif
+
+static void noshell_file_free(noshell_file_t *f) {
+    noshell_id_cache_free(f->ids);
+    noshell_tomb_cache_free(f->tombs);
+    fossil_bluecrab_thread_mutex_destroy(&f->mutex);
+    fossil_bluecrab_thread_mutex_destroy(&f->lsm_mutex);
+    fossil_bluecrab_thread_mutex_destroy(&f->tomb_mutex);
+    free(f->key);
+    free(f);
+}
+
+/**
+ * Returns the entry of file_name with a reference taken, creating it on
+ * first use, or NULL when out of memory.
+ */
+static noshell_file_t *noshell_file_acquire(const char *file_name) {
+    char *key = noshell_canonical_path(file_name);
+    if (!key)
+        return NULL;
+    NOSHELL_FILES_LOCK();
+    noshell_file_t **link = &noshell_files;
+    while (*link && strcmp((*link)->key, key) != 0)
+        link = &(*link)->next;
+    noshell_file_t *f = *link;
+    if (f) {
+        *link = f->next;
+        free(key);
+    } else {
+        f = (noshell_file_t *)calloc(1, sizeof(*f));
+        if (!f) {
+            NOSHELL_FILES_UNLOCK();
+            free(key);
+            return NULL;
+        }
+        f->key = key;
+        f->durability = FOSSIL_NOSHELL_DURABILITY_FLUSH;
+        fossil_bluecrab_thread_mutex_init(&f->mutex);
+        fossil_bluecrab_thread_mutex_init(&f->lsm_mutex);
+        fossil_bluecrab_thread_mutex_init(&f->tomb_mutex);
+
+        // Drop unreferenced entries past the most recently used ones
+        size_t depth = 1;
+        for (link = &noshell_files; *link;) {
+            noshell_file_t *old = *link;
+            if (++depth > NOSHELL_FILE_CACHE_MAX && old->refs == 0) {
+                *link = old->next;
+                noshell_file_free(old);
+            } else {
+                link = &old->next;
+            }
+        }
+    }
+    f->refs++;
+    f->next = noshell_files;
+    noshell_files = f;
+    NOSHELL_FILES_UNLOCK();
+    return f;
+}
+
+/** Takes another reference on an entry the caller holds. */
+static void noshell_file_retain(noshell_file_t *f) {
+    NOSHELL_FILES_LOCK();
+    f->refs++;
+    NOSHELL_FILES_UNLOCK();
+}
+
+static void noshell_file_release(noshell_file_t *f) {
+    if (!f) return;
+    NOSHELL_FILES_LOCK();
+    f->refs--;
+    NOSHELL_FILES_UNLOCK();
+}
+
+/**
+ * Reads the write counters of f. A cache stamped with writes is current
+ * as far as this library knows while writes is unchanged, and may catch
+ * up incrementally while rewritten stays at or below its stamp.
+ */
+static void noshell_file_counters(noshell_file_t *f, uint64_t *writes, uint64_t *rewritten) {
+    NOSHELL_FILES_LOCK();
+    if (writes) *writes = f->writes;
+    if (rewritten) *rewritten = f->rewritten;
+    NOSHELL_FILES_UNLOCK();
+}
+
+/**
+ * Records that file_name was created, removed, restored over or rewritten
+ * (anything but an append); see "Per-File State".
+ */
+static void noshell_file_invalidate(const char *file_name) {
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    char *meta = noshell_meta_path(file_name, ".meta");
+    if (f) {
+        fossil_bluecrab_thread_mutex_lock(&f->mutex);
+        NOSHELL_FILES_LOCK();
+        f->rewritten = ++f->writes;
+        NOSHELL_FILES_UNLOCK();
+    }
+    if (meta)
+        remove(meta);
+    if (f) {
+        fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+        noshell_file_release(f);
+    }
+    free(meta);
+}
+
+// ===========================================================
+// Durability Registry
+// ===========================================================
+
+/**
+ * NoShell has no handles, so the durability policy lives in the file's
+ * registry entry. Files without a setting use the default
+ * (FOSSIL_NOSHELL_DURABILITY_FLUSH). In PERIODIC mode the entry owns a
+ * background syncer from sync.c that syncs the file by path every
+ * interval_ms when a write happened since its last pass.
+ */
+
+/**
+ * Applies the durability policy of file_name to fp after a write, before
+ * the caller closes it. Every NoShell write is its own commit, so this is
+ * also where the write is counted (which drops cached document ids). The
+ * _locked form is for callers already holding the entry's mutex.
+ */
+static fossil_bluecrab_noshell_error_t noshell_durable_locked(noshell_file_t *f, FILE *fp) {
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    NOSHELL_FILES_LOCK();
+    f->writes++;
+    NOSHELL_FILES_UNLOCK();
+    if (f->durability == FOSSIL_NOSHELL_DURABILITY_FSYNC) {
+        if (fossil_bluecrab_sync_file(fp) != 0)
+            rc = FOSSIL_NOSHELL_ERROR_IO;
+    } else if (f->durability == FOSSIL_NOSHELL_DURABILITY_PERIODIC) {
+        fossil_bluecrab_sync_worker_mark(f->syncer);
+    }
+    return rc;
+}
+
+static fossil_bluecrab_noshell_error_t noshell_durable(const char *file_name, FILE *fp) {
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_thread_mutex_lock(&f->mutex);
+    fossil_bluecrab_noshell_error_t rc = noshell_durable_locked(f, fp);
+    fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+    noshell_file_release(f);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_set_durability(
+    const char *file_name,
+    fossil_bluecrab_noshell_durability_t mode,
+    unsigned interval_ms
+) {
+    if (!file_name)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    if (!fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    if (mode < FOSSIL_NOSHELL_DURABILITY_NONE || mode > FOSSIL_NOSHELL_DURABILITY_PERIODIC)
+        return FOSSIL_NOSHELL_ERROR_INVALID_QUERY;
+    if (mode == FOSSIL_NOSHELL_DURABILITY_PERIODIC && interval_ms == 0)
+        return FOSSIL_NOSHELL_ERROR_INVALID_QUERY;
+
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_sync_worker_t *syncer = NULL;
+    if (mode == FOSSIL_NOSHELL_DURABILITY_PERIODIC) {
+        syncer = fossil_bluecrab_sync_worker_start(f->key, interval_ms);
+        if (!syncer) {
+            noshell_file_release(f);
+            return FOSSIL_NOSHELL_ERROR_IO;
+        }
+    }
+
+    // A non-default policy keeps the entry; the old syncer is joined outside the lock
+    fossil_bluecrab_thread_mutex_lock(&f->mutex);
+    bool was_set = f->durability != FOSSIL_NOSHELL_DURABILITY_FLUSH;
+    bool is_set = mode != FOSSIL_NOSHELL_DURABILITY_FLUSH;
+    fossil_bluecrab_sync_worker_t *old = f->syncer;
+    f->durability = mode;
+    f->syncer = syncer;
+    fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+    fossil_bluecrab_sync_worker_stop(old);
+    if (is_set && !was_set)
+        noshell_file_retain(f);
+    else if (was_set && !is_set)
+        noshell_file_release(f);
+    noshell_file_release(f);
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+fossil_bluecrab_noshell_durability_t fossil_bluecrab_noshell_get_durability(const char *file_name) {
+    fossil_bluecrab_noshell_durability_t mode = FOSSIL_NOSHELL_DURABILITY_FLUSH;
+    if (!file_name)
+        return mode;
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f)
+        return mode;
+    fossil_bluecrab_thread_mutex_lock(&f->mutex);
+    mode = f->durability;
+    fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+    noshell_file_release(f);
+    return mode;
+}
+
+// ===========================================================
+// Async Submission
+// ===========================================================
+
+/**
+ * Requests run on the shared pool (thread.h). A find for a file with no
+ * inserts pending goes to the pool directly, so finds on one file run
+ * concurrently. Inserts, and finds submitted while inserts are pending,
+ * wait on the file's "lane", which one pool task drains: it runs each
+ * insert and hands each find to the pool, so inserts on a file land in
+ * submission order and a find sees every insert submitted before it. A
+ * lane exists only while it has work. Completed requests collect on one
+ * process-wide list and their callbacks run from
+ * fossil_bluecrab_noshell_async_poll/async_wait on the caller's thread.
+ */
+typedef enum {
+    NOSHELL_ASYNC_FIND,
+    NOSHELL_ASYNC_INSERT
+} noshell_async_op_t;
+
+typedef struct noshell_async_req_t {
+    noshell_async_op_t op;
+    char    *path;                      // canonical file name
+    char    *arg;                       // query or document
+    char    *param_list;
+    char    *type;
+    char     result[1024];              // found line or new document id
+    fossil_bluecrab_noshell_error_t status;
+    fossil_bluecrab_noshell_async_cb cb;
+    void    *user;
+    struct noshell_async_req_t *next;
+} noshell_async_req_t;
+
+typedef struct noshell_async_lane_t {
+    char    *path;
+    noshell_async_req_t *queue_head, *queue_tail;
+    struct noshell_async_lane_t *next;
+} noshell_async_lane_t;
+
+static struct {
+    bool     initialized;
+    size_t   in_flight;
+    fossil_bluecrab_thread_mutex_t mutex;
+    fossil_bluecrab_thread_cond_t  cond;
+    noshell_async_lane_t *lanes;
+    noshell_async_req_t *done_head, *done_tail;
+} noshell_async;
+
+static void noshell_async_req_free(noshell_async_req_t *req) {
+    free(req->path);
+    free(req->arg);
+    free(req->param_list);
+    free(req->type);
+    free(req);
+}
+
+/** Runs req and moves it to the done list. */
+static void noshell_async_complete(noshell_async_req_t *req) {
+    if (req->op == NOSHELL_ASYNC_FIND) {
+        req->status = fossil_bluecrab_noshell_find(req->path, req->arg, req->result, sizeof(req->result), req->type);
+    } else {
+        req->status = fossil_bluecrab_noshell_insert_with_id(req->path, req->arg, req->param_list, req->type,
+                                                             req->result, sizeof(req->result));
+    }
+
+    fossil_bluecrab_thread_mutex_lock(&noshell_async.mutex);
+    req->next = NULL;
+    if (noshell_async.done_tail) noshell_async.done_tail->next = req; else noshell_async.done_head = req;
+    noshell_async.done_tail = req;
+    noshell_async.in_flight--;
+    fossil_bluecrab_thread_cond_broadcast(&noshell_async.cond);
+    fossil_bluecrab_thread_mutex_unlock(&noshell_async.mutex);
+}
+
+static void noshell_async_task(void *arg) {
+    noshell_async_complete((noshell_async_req_t *)arg);
+}
+
+/** Pool task that drains a lane, then removes it. */
+static void noshell_async_drain(void *arg) {
+    noshell_async_lane_t *lane = (noshell_async_lane_t *)arg;
+    fossil_bluecrab_thread_mutex_lock(&noshell_async.mutex);
+    while (lane->queue_head) {
+        noshell_async_req_t *req = lane->queue_head;
+        lane->queue_head = req->next;
+        if (!lane->queue_head) lane->queue_tail = NULL;
+        fossil_bluecrab_thread_mutex_unlock(&noshell_async.mutex);
+
+        if (req->op == NOSHELL_ASYNC_INSERT || !fossil_bluecrab_pool_submit(noshell_async_task, req))
+            noshell_async_complete(req);
+
+        fossil_bluecrab_thread_mutex_lock(&noshell_async.mutex);
+    }
+    noshell_async_lane_t **link = &noshell_async.lanes;
+    while (*link != lane) link = &(*link)->next;
+    *link = lane->next;
+    fossil_bluecrab_thread_mutex_unlock(&noshell_async.mutex);
+    free(lane->path);
+    free(lane);
+}
+
+static fossil_bluecrab_noshell_error_t noshell_async_submit(const char *file_name, noshell_async_req_t *req) {
+    // Lanes are keyed like per-file state, so aliases of a file share one
+    req->path = noshell_canonical_path(file_name);
+    if (!req->path)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    NOSHELL_FILES_LOCK();
+    if (!noshell_async.initialized) {
+        fossil_bluecrab_thread_mutex_init(&noshell_async.mutex);
+        fossil_bluecrab_thread_cond_init(&noshell_async.cond);
+        noshell_async.initialized = true;
+    }
+    NOSHELL_FILES_UNLOCK();
+
+    fossil_bluecrab_thread_mutex_lock(&noshell_async.mutex);
+    noshell_async_lane_t *lane = noshell_async.lanes;
+    while (lane && strcmp(lane->path, req->path) != 0) lane = lane->next;
+    noshell_async.in_flight++;
+
+    bool queued;
+    if (!lane && req->op == NOSHELL_ASYNC_FIND) {
+        fossil_bluecrab_thread_mutex_unlock(&noshell_async.mutex);
+        queued = fossil_bluecrab_pool_submit(noshell_async_task, req);
+        fossil_bluecrab_thread_mutex_lock(&noshell_async.mutex);
+    } else if (lane) {
+        lane->queue_tail->next = req;
+        lane->queue_tail = req;
+        queued = true;
+    } else {
+        lane = (noshell_async_lane_t *)calloc(1, sizeof(noshell_async_lane_t));
+        char *path = lane ? noshell_strdup(req->path) : NULL;
+        queued = path && fossil_bluecrab_pool_submit(noshell_async_drain, lane);
+        if (queued) {
+            lane->path = path;
+            lane->queue_head = lane->queue_tail = req;
+            lane->next = noshell_async.lanes;
+            noshell_async.lanes = lane;
+        } else {
+            free(path);
+            free(lane);
+        }
+    }
+    if (!queued) {
+        noshell_async.in_flight--;
+        fossil_bluecrab_thread_cond_broadcast(&noshell_async.cond);
+    }
+    fossil_bluecrab_thread_mutex_unlock(&noshell_async.mutex);
+    return queued ? FOSSIL_NOSHELL_ERROR_SUCCESS : FOSSIL_NOSHELL_ERROR_IO;
+}
+
+static size_t noshell_async_dispatch(bool wait_all) {
+    NOSHELL_FILES_LOCK();
+    bool initialized = noshell_async.initialized;
+    NOSHELL_FILES_UNLOCK();
+    if (!initialized)
+        return 0;
+
+    fossil_bluecrab_thread_mutex_lock(&noshell_async.mutex);
+    while (wait_all && noshell_async.in_flight > 0) {
+        fossil_bluecrab_thread_cond_wait(&noshell_async.cond, &noshell_async.mutex);
+    }
+    noshell_async_req_t *done = noshell_async.done_head;
+    noshell_async.done_head = noshell_async.done_tail = NULL;
+    fossil_bluecrab_thread_mutex_unlock(&noshell_async.mutex);
+
+    size_t count = 0;
+    while (done) {
+        noshell_async_req_t *next = done->next;
+        if (done->cb) {
+            done->cb(done->status, done->status == FOSSIL_NOSHELL_ERROR_SUCCESS ? done->result : NULL, done->user);
+        }
+        noshell_async_req_free(done);
+        done = next;
+        count++;
+    }
+    return count;
+}
+
+static noshell_async_req_t *noshell_async_req_new(noshell_async_op_t op, const char *arg, const char *param_list,
+                                                  const char *type, fossil_bluecrab_noshell_async_cb cb, void *user) {
+    noshell_async_req_t *req = (noshell_async_req_t *)calloc(1, sizeof(noshell_async_req_t));
+    if (!req) return NULL;
+    req->op = op;
+    req->cb = cb;
+    req->user = user;
+    req->arg = noshell_strdup(arg);
+    req->param_list = param_list ? noshell_strdup(param_list) : NULL;
+    req->type = type ? noshell_strdup(type) : NULL;
+    if (!req->arg || (param_list && !req->param_list) || (type && !req->type)) {
+        noshell_async_req_free(req);
+        return NULL;
+    }
+    return req;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_submit_find(
+    const char *file_name,
+    const char *query,
+    const char *type_id,
+    fossil_bluecrab_noshell_async_cb cb,
+    void *user
+) {
+    if (!file_name || !query)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    if (!fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_async_req_t *req = noshell_async_req_new(NOSHELL_ASYNC_FIND, query, NULL, type_id, cb, user);
+    if (!req)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_noshell_error_t rc = noshell_async_submit(file_name, req);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        noshell_async_req_free(req);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_submit_insert(
+    const char *file_name,
+    const char *document,
+    const char *param_list,
+    const char *type,
+    fossil_bluecrab_noshell_async_cb cb,
+    void *user
+) {
+    if (!file_name || !document || !type)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    if (!fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_async_req_t *req = noshell_async_req_new(NOSHELL_ASYNC_INSERT, document, param_list, type, cb, user);
+    if (!req)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_noshell_error_t rc = noshell_async_submit(file_name, req);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        noshell_async_req_free(req);
+    return rc;
+}
+
+size_t fossil_bluecrab_noshell_async_poll(void) {
+    return noshell_async_dispatch(false);
+}
+
+size_t fossil_bluecrab_noshell_async_wait(void) {
+    return noshell_async_dispatch(true);
+}
+
+void fossil_bluecrab_noshell_async_shutdown(void) {
+    NOSHELL_FILES_LOCK();
+    bool initialized = noshell_async.initialized;
+    NOSHELL_FILES_UNLOCK();
+    if (!initialized)
+        return;
+
+    // Callbacks may submit more requests
+    while (noshell_async_dispatch(true) > 0) {
+    }
+    fossil_bluecrab_pool_quiesce();
+}
+
+// ===========================================================
+// Structured Queries
+// ===========================================================
+
+/*
+ * Queries passed to find/update/remove are plain substrings of the line
+ * unless they start with WHERE, in which case they are compiled once per
+ * call into a predicate tree and evaluated against the document's fields:
+ *
+ *   query     := WHERE or_expr
+ *   or_expr   := and_expr (OR and_expr)*
+ *   and_expr  := unary (AND unary)*
+ *   unary     := NOT unary | '(' or_expr ')' | field op literal
+ *   field     := name ('.' name)* | _id | _type
+ *   op        := = | != | <> | < | <= | > | >= | LIKE
+ *   literal   := 'text' | "text" | number | bareword
+ *
+ * Fields are looked up lazily in the FSON body ("{ key: type: value, ... }",
+ * dotted names descend into nested objects), stopping at the first key that
+ * matches, so a predicate never parses more of the line than it needs and
+ * AND/OR stop at the first predicate that decides the result. _id and _type
+ * read the #id= / #type= tags after the body. A missing field fails every
+ * comparison. Numbers compare numerically, everything else (quotes
+ * stripped) with byte order; LIKE supports '%' and '_'. The lexer and
+ * parser are the ones in query.c, shared with MyShell; NoShell adds '.'
+ * to identifiers and parses fields as names.
+ */
+
+struct fossil_bluecrab_noshell_query_t {
+    fossil_bluecrab_query_pred_t *where;
+};
+
+static char *noshell_strndup(const char *s, size_t n) {
+    char *copy = (char *)malloc(n + 1);
+    if (copy) {
+        memcpy(copy, s, n);
+        copy[n] = '\0';
+    }
+    return copy;
+}
+
+static const fossil_bluecrab_query_syntax_t noshell_query_syntax = { ".", "=<>()" };
+
+/** WHERE fields are dotted document paths (or the _id / _type tags). */
+static bool noshell_query_field(fossil_bluecrab_query_lexer_t *lx, fossil_bluecrab_query_pred_t *pred) {
+    if (lx->kind != FOSSIL_QUERY_TOK_IDENT || fossil_bluecrab_query_lex_is(lx, "AND") || fossil_bluecrab_query_lex_is(lx, "OR"))
+        return false;
+    if (lx->start[lx->len - 1] == '.')
+        return false;
+    pred->field = noshell_strndup(lx->start, lx->len);
+    if (!pred->field) {
+        lx->oom = true;
+        return false;
+    }
+    fossil_bluecrab_query_lex_next(lx);
+    return true;
+}
+
+/** True if the query text starts with the WHERE keyword. */
+static bool noshell_query_is_structured(const char *query) {
+    fossil_bluecrab_query_lexer_t lx;
+    fossil_bluecrab_query_lex_init(&lx, query, &noshell_query_syntax);
+    return fossil_bluecrab_query_lex_is(&lx, "WHERE");
+}
+
+fossil_bluecrab_noshell_query_t *fossil_bluecrab_noshell_query_compile(const char *expr, fossil_bluecrab_noshell_error_t *err) {
+    if (!expr) {
+        if (err) *err = FOSSIL_NOSHELL_ERROR_INVALID_QUERY;
+        return NULL;
+    }
+
+    fossil_bluecrab_query_lexer_t lx;
+    fossil_bluecrab_query_lex_init(&lx, expr, &noshell_query_syntax);
+    fossil_bluecrab_query_lex_accept(&lx, "WHERE");
+    fossil_bluecrab_query_pred_t *where = fossil_bluecrab_query_parse_where(&lx, noshell_query_field);
+    fossil_bluecrab_noshell_query_t *q = NULL;
+    if (where && lx.kind == FOSSIL_QUERY_TOK_END)
+        q = (fossil_bluecrab_noshell_query_t *)calloc(1, sizeof(*q));
+    if (!q) {
+        bool oom = lx.oom || (where && lx.kind == FOSSIL_QUERY_TOK_END);
+        fossil_bluecrab_query_pred_free(where);
+        if (err) *err = oom ? FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY : FOSSIL_NOSHELL_ERROR_INVALID_QUERY;
+        return NULL;
+    }
+    q->where = where;
+    if (err) *err = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    return q;
+}
+
+void fossil_bluecrab_noshell_query_free(fossil_bluecrab_noshell_query_t *query) {
+    if (!query) return;
+    fossil_bluecrab_query_pred_free(query->where);
+    free(query);
+}
+
+/**
+ * Skips one FSON value starting at p (object, array, quoted string or bare
+ * scalar) and returns the first character after it. Bare scalars end at
+ * ',', a closing bracket or the end of the line.
+ */
+static const char *noshell_fson_skip_value(const char *p) {
+    if (*p == '"' || *p == '\'') {
+        char quote = *p++;
+        while (*p && *p != quote) {
+            if (*p == '\\' && p[1]) p++;
+            p++;
+        }
+        return *p ? p + 1 : p;
+    }
+    if (*p == '{' || *p == '[') {
+        int depth = 0;
+        while (*p) {
+            if (*p == '"' || *p == '\'') {
+                p = noshell_fson_skip_value(p);
+                continue;
+            }
+            if (*p == '{' || *p == '[') depth++;
+            else if (*p == '}' || *p == ']') {
+                if (--depth == 0) return p + 1;
+            }
+            p++;
+        }
+        return p;
+    }
+    while (*p && *p != ',' && *p != '}' && *p != ']' && *p != '\n' && *p != '\r') p++;
+    return p;
+}
+
+/**
+ * Finds the member named by 'path' (dotted for nested objects) in the
+ * object at 'obj' and returns its value, without the FSON type annotation,
+ * as a view. Members before the match are skipped without being parsed.
+ */
+static bool noshell_fson_lookup(const char *obj, const char *path, const char **value, size_t *value_len) {
+    const char *p = obj;
+    while (isspace((unsigned char)*p)) p++;
+    if (*p != '{')
+        return false;
+    p++;
+
+    size_t seg_len = strcspn(path, ".");
+    for (;;) {
+        while (isspace((unsigned char)*p) || *p == ',') p++;
+        if (*p == '\0' || *p == '}')
+            return false;
+
+        // Key: quoted or bare up to ':'
+        const char *key = p;
+        size_t key_len;
+        if (*p == '"' || *p == '\'') {
+            const char *end = noshell_fson_skip_value(p);
+            key = p + 1;
+            key_len = end > key ? (size_t)(end - key) - (end[-1] == *p ? 1 : 0) : 0;
+            p = end;
+        } else {
+            while (*p && *p != ':' && !isspace((unsigned char)*p) && *p != ',' && *p != '}') p++;
+            key_len = (size_t)(p - key);
+        }
+        while (isspace((unsigned char)*p)) p++;
+        if (*p != ':')
+            return false;
+        p++;
+        while (isspace((unsigned char)*p)) p++;
+
+        // Optional "type:" annotation
+        const char *ann = p;
+        while (isalnum((unsigned char)*ann)) ann++;
+        if (ann > p && *ann == ':') {
+            char type_name[16];
+            size_t n = (size_t)(ann - p);
+            if (n < sizeof(type_name)) {
+                memcpy(type_name, p, n);
+                type_name[n] = '\0';
+                for (size_t i = 0; i <= NOSHELL_FSON_TYPE_DURATION; ++i) {
+                    if (strcmp(type_name, noshell_fson_type_names[i]) == 0) {
+                        p = ann + 1;
+                        while (isspace((unsigned char)*p)) p++;
+                        break;
+                    }
+                }
+            }
+        }
+
+        const char *end = noshell_fson_skip_value(p);
+        if (key_len == seg_len && strncmp(key, path, seg_len) == 0) {
+            if (path[seg_len] == '.')
+                return noshell_fson_lookup(p, path + seg_len + 1, value, value_len);
+            while (end > p && isspace((unsigned char)end[-1])) end--;
+            *value = p;
+            *value_len = (size_t)(end - p);
+            return true;
+        }
+        if (end == p)
+            return false;
+        p = end;
+    }
+}
+
+/** Value of a #name= tag after the document body. */
+static bool noshell_line_tag(const char *line, const char *tag, const char **value, size_t *value_len) {
+    while (isspace((unsigned char)*line)) line++;
+    const char *pos = strstr(noshell_fson_skip_value(line), tag);
+    if (!pos)
+        return false;
+    *value = pos + strlen(tag);
+    *value_len = strcspn(*value, " \t\r\n");
+    return true;
+}
+
+/** Drops the quotes around a quoted value view. */
+static void noshell_strip_quotes(const char **value, size_t *len) {
+    if (*len >= 2 && ((*value)[0] == '"' || (*value)[0] == '\'') && (*value)[*len - 1] == (*value)[0]) {
+        (*value)++;
+        *len -= 2;
+    }
+}
+
+/**
+ * Value of a query field in a document line as a view, quotes stripped:
+ * _id / _type read the tags, anything else the FSON body.
+ */
+static bool noshell_field_value(const char *line, const char *field, const char **value, size_t *len) {
+    bool found = strcmp(field, "_id") == 0   ? noshell_line_tag(line, "#id=", value, len)
+               : strcmp(field, "_type") == 0 ? noshell_line_tag(line, "#type=", value, len)
+               : noshell_fson_lookup(line, field, value, len);
+    if (found)
+        noshell_strip_quotes(value, len);
+    return found;
+}
+
+static bool noshell_pred_eval(const fossil_bluecrab_query_pred_t *pred, const char *line) {
+    switch (pred->kind) {
+        case FOSSIL_QUERY_PRED_AND: return noshell_pred_eval(pred->left, line) && noshell_pred_eval(pred->right, line);
+        case FOSSIL_QUERY_PRED_OR:  return noshell_pred_eval(pred->left, line) || noshell_pred_eval(pred->right, line);
+        case FOSSIL_QUERY_PRED_NOT: return !noshell_pred_eval(pred->left, line);
+        case FOSSIL_QUERY_PRED_CMP: break;
+    }
+
+    const char *value = NULL;
+    size_t len = 0;
+    if (!noshell_field_value(line, pred->field, &value, &len))
+        return false;
+    return fossil_bluecrab_query_compare(pred, value, len);
+}
+
+bool fossil_bluecrab_noshell_query_match(const fossil_bluecrab_noshell_query_t *query, const char *document) {
+    if (!query || !document)
+        return false;
+    return noshell_pred_eval(query->where, document);
+}
+
+/**
+ * Query as used by find/update/remove: compiled when it starts with WHERE,
+ * otherwise the legacy substring match over the whole line.
+ */
+typedef struct {
+    const char *text;
+    fossil_bluecrab_noshell_query_t *compiled;
+} noshell_matcher_t;
+
+static fossil_bluecrab_noshell_error_t noshell_matcher_init(noshell_matcher_t *m, const char *query) {
+    m->text = query;
+    m->compiled = NULL;
+    if (!noshell_query_is_structured(query))
+        return FOSSIL_NOSHELL_ERROR_SUCCESS;
+    fossil_bluecrab_noshell_error_t rc;
+    m->compiled = fossil_bluecrab_noshell_query_compile(query, &rc);
+    return rc;
+}
+
+static bool noshell_matcher_test(const noshell_matcher_t *m, const char *line) {
+    return m->compiled ? noshell_pred_eval(m->compiled->where, line) : strstr(line, m->text) != NULL;
+}
+
+static void noshell_matcher_free(noshell_matcher_t *m) {
+    fossil_bluecrab_noshell_query_free(m->compiled);
+    m->compiled = NULL;
+}
+
+// Secondary field indexes (see the end of the file)
+static fossil_bluecrab_noshell_error_t noshell_index_find(const char *file_name, FILE *fp, const noshell_matcher_t *matcher, const char *type_tag, char *result, size_t buffer_size);
+
+// Tombstones and compaction (see the end of the file)
+typedef bool (*noshell_line_fn)(void *ctx, uint64_t offset, const char *line, size_t len);
+static fossil_bluecrab_noshell_error_t noshell_tomb_apply(
+    const char *file_name, FILE *fp, const noshell_matcher_t *matcher, const char *type_tag,
+    const char *new_body, noshell_line_fn keep, void *keep_ctx, bool *compact);
+static fossil_bluecrab_noshell_error_t noshell_handle_compact(fossil_bluecrab_noshell_t *db);
+
+// Text-mode insert by file name (see "Document Id Index (file-name API)")
+static fossil_bluecrab_noshell_error_t noshell_path_append(const char *file_name, const char *document, const char *param_list, const char *type, uint64_t *id);
+
+// LSM engine (see the end of the file)
+typedef struct noshell_lsm_t noshell_lsm_t;
+static fossil_bluecrab_noshell_error_t noshell_lsm_acquire(const char *file_name, noshell_lsm_t **out);
+static void noshell_lsm_release(noshell_lsm_t *s);
+static void noshell_lsm_drop(const char *file_name);
+static bool noshell_lsm_enabled(const char *file_name);
+static fossil_bluecrab_noshell_error_t noshell_lsm_insert(noshell_lsm_t *s, const char *document, const char *param_list, const char *type, uint64_t *id);
+static fossil_bluecrab_noshell_error_t noshell_lsm_find(noshell_lsm_t *s, const noshell_matcher_t *matcher, const char *type_tag, char *result, size_t buffer_size);
+static fossil_bluecrab_noshell_error_t noshell_lsm_find_cb(noshell_lsm_t *s, const noshell_matcher_t *matcher, bool (*cb)(const char *document, void *userdata), void *userdata);
+static fossil_bluecrab_noshell_error_t noshell_lsm_find_by_id(noshell_lsm_t *s, const char *id, char *result, size_t buffer_size);
+static fossil_bluecrab_noshell_error_t noshell_lsm_apply(noshell_lsm_t *s, const noshell_matcher_t *matcher, const char *type_tag, const char *new_body);
+static fossil_bluecrab_noshell_error_t noshell_lsm_step(noshell_lsm_t *s, const char *prev_id, char *id_buffer, size_t buffer_size);
+static fossil_bluecrab_noshell_error_t noshell_lsm_stats(noshell_lsm_t *s, noshell_meta_t *meta, uint64_t *disk_bytes);
+static fossil_bluecrab_noshell_error_t noshell_lsm_compact(noshell_lsm_t *s);
+static fossil_bluecrab_noshell_error_t noshell_lsm_write_text(noshell_lsm_t *s, FILE *out);
+
+/**
+ * The line update writes in place of a matching document, without its
+ * newline or #id= (the retired line's id is appended): new_document, then
+ * param_list and #type= when given. Returns a malloc'd string.
+ */
+static char *noshell_version_body(const char *new_document, const char *param_list, const char *type_id) {
+    bool has_params = param_list && strlen(param_list) > 0;
+    bool has_type = type_id && strlen(type_id) > 0;
+    size_t size = strlen(new_document) + (has_params ? strlen(param_list) + 1 : 0) +
+                  (has_type ? strlen(type_id) + 7 : 0) + 1;
+    char *body = (char *)malloc(size);
+    if (!body)
+        return NULL;
+    snprintf(body, size, "%s%s%s%s%s", new_document,
+             has_params ? " " : "", has_params ? param_list : "",
+             has_type ? " #type=" : "", has_type ? type_id : "");
+    return body;
 }
 
 // ===========================================================
@@ -249,19 +1271,17 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_insert(
     // Generate document ID using hash64 of document string (FSON object)
     uint64_t doc_id = noshell_hash64(document);
 
-    FILE *fp = fopen(file_name, "a");
-    if (!fp)
-        return FOSSIL_NOSHELL_ERROR_IO;
-
-    // Optionally append param_list if provided, always append #type=TYPE and #id=ID
-    if (param_list && strlen(param_list) > 0) {
-        fprintf(fp, "%s %s #type=%s #id=%016" PRIx64 "\n", document, param_list, type, doc_id);
-    } else {
-        fprintf(fp, "%s #type=%s #id=%016" PRIx64 "\n", document, type, doc_id);
+    noshell_lsm_t *lsm;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_acquire(file_name, &lsm);
+    if (lsm) {
+        rc = noshell_lsm_insert(lsm, document, param_list, type, &doc_id);
+        noshell_lsm_release(lsm);
     }
+    if (lsm || rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
 
-    fclose(fp);
-    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+    // Appends param_list if provided, always #type=TYPE and #id=ID
+    return noshell_path_append(file_name, document, param_list, type, &doc_id);
 }
 
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_insert_with_id(
@@ -299,20 +1319,22 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_insert_with_id(
     uint64_t doc_id = noshell_hash64(document);
     snprintf(out_id, id_size, "%016" PRIx64, doc_id);
 
-    FILE *fp = fopen(file_name, "a");
-    if (!fp)
-        return FOSSIL_NOSHELL_ERROR_IO;
+    noshell_lsm_t *lsm;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_acquire(file_name, &lsm);
+    if (lsm) {
+        rc = noshell_lsm_insert(lsm, document, param_list, type, &doc_id);
+        noshell_lsm_release(lsm);
+        snprintf(out_id, id_size, "%016" PRIx64, doc_id);
+    }
+    if (lsm || rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
 
     // Write document in FSON format, append param_list, #type and #id
-    if (param_list && strlen(param_list) > 0) {
-        fprintf(fp, "%s %s #type=%s #id=%s\n", document, param_list, type, out_id);
-    } else {
-        fprintf(fp, "%s #type=%s #id=%s\n", document, type, out_id);
-    }
-
-    fclose(fp);
-    return FOSSIL_NOSHELL_ERROR_SUCCESS;
-}
+    rc = noshell_path_append(file_name, document, param_list, type, &doc_id);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+        snprintf(out_id, id_size, "%016" PRIx64, doc_id);
+    return rc;
+}
 
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_find(
     const char *file_name,
@@ -340,36 +1362,78 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_find(
             return FOSSIL_NOSHELL_ERROR_INVALID_TYPE;
     }
 
-    FILE *fp = fopen(file_name, "r");
-    if (!fp)
+    noshell_matcher_t matcher;
+    fossil_bluecrab_noshell_error_t rc = noshell_matcher_init(&matcher, query);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+
+    char type_tag[32] = {0};
+    if (type_id && strlen(type_id) > 0)
+        snprintf(type_tag, sizeof(type_tag), "#type=%s", type_id);
+    noshell_lsm_t *lsm;
+    rc = noshell_lsm_acquire(file_name, &lsm);
+    if (lsm) {
+        rc = noshell_lsm_find(lsm, &matcher, type_tag, result, buffer_size);
+        noshell_lsm_release(lsm);
+    }
+    if (lsm || rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_matcher_free(&matcher);
+        return rc;
+    }
+
+    // A structured query on an indexed field reads only the candidates
+    rc = noshell_index_find(file_name, NULL, &matcher, type_tag, result, buffer_size);
+    if (rc != FOSSIL_NOSHELL_ERROR_UNSUPPORTED) {
+        noshell_matcher_free(&matcher);
+        return rc;
+    }
+
+    FILE *fp = fopen(file_name, "rb");
+    if (!fp) {
+        noshell_matcher_free(&matcher);
         return FOSSIL_NOSHELL_ERROR_IO;
+    }
+    noshell_tombs_t tombs;
+    rc = noshell_tombs_load(file_name, fp, &tombs);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        fclose(fp);
+        noshell_matcher_free(&matcher);
+        return rc;
+    }
 
-    char line[1024];
-    while (fgets(line, sizeof(line), fp)) {
-        // Skip header lines
+    rc = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    fseek(fp, 0, SEEK_SET);
+    size_t type_tag_len = strlen(type_tag);
+    noshell_reader_t reader;
+    noshell_reader_init(&reader, fp);
+    char *line;
+    size_t len;
+    uint64_t offset = 0;
+    while ((line = noshell_reader_next(&reader, &len)) != NULL) {
+        uint64_t at = offset;
+        offset += len;
+        // Skip header lines and tombstones
         if (line[0] == '#')
             continue;
-        // Only consider FSON-formatted lines (start with '{' or '[' after whitespace)
-        char *p = line;
-        while (isspace((unsigned char)*p)) p++;
-        if (*p != '{' && *p != '[')
+        // Only consider live FSON-formatted lines (start with '{' or '[' after whitespace)
+        if (!noshell_is_document(line) || noshell_tombs_has(&tombs, at))
             continue;
-        if (strstr(line, query)) {
-            if (type_id && strlen(type_id) > 0) {
-                // Check for type match in line
-                char type_tag[32];
-                snprintf(type_tag, sizeof(type_tag), "#type=%s", type_id);
-                if (!strstr(line, type_tag)) continue;
-            }
+        if (noshell_matcher_test(&matcher, line)) {
+            // Check for type match in line
+            if (type_tag_len && !fossil_bluecrab_scan_find(line, len, type_tag, type_tag_len))
+                continue;
             strncpy(result, line, buffer_size - 1);
             result[buffer_size - 1] = '\0';
-            fclose(fp);
-            return FOSSIL_NOSHELL_ERROR_SUCCESS;
+            rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+            break;
         }
     }
 
+    noshell_reader_free(&reader);
+    noshell_tombs_free(&tombs);
     fclose(fp);
-    return FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    noshell_matcher_free(&matcher);
+    return rc;
 }
 
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_find_cb(
@@ -383,17 +1447,37 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_find_cb(
     if (!fossil_bluecrab_noshell_validate_extension(file_name))
         return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
 
-    FILE *fp = fopen(file_name, "r");
+    noshell_lsm_t *lsm;
+    fossil_bluecrab_noshell_error_t result = noshell_lsm_acquire(file_name, &lsm);
+    if (lsm) {
+        result = noshell_lsm_find_cb(lsm, NULL, cb, userdata);
+        noshell_lsm_release(lsm);
+    }
+    if (lsm || result != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return result;
+
+    FILE *fp = fopen(file_name, "rb");
     if (!fp)
         return FOSSIL_NOSHELL_ERROR_IO;
+    noshell_tombs_t tombs;
+    result = noshell_tombs_load(file_name, fp, &tombs);
+    if (result != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        fclose(fp);
+        return result;
+    }
 
-    char line[1024];
-    fossil_bluecrab_noshell_error_t result = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
-    while (fgets(line, sizeof(line), fp)) {
-        // Only consider FSON-formatted lines (start with '{' or '[' after whitespace)
-        char *p = line;
-        while (isspace((unsigned char)*p)) p++;
-        if (*p != '{' && *p != '[')
+    result = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    fseek(fp, 0, SEEK_SET);
+    noshell_reader_t reader;
+    noshell_reader_init(&reader, fp);
+    char *line;
+    size_t len;
+    uint64_t offset = 0;
+    while ((line = noshell_reader_next(&reader, &len)) != NULL) {
+        uint64_t at = offset;
+        offset += len;
+        // Only consider live FSON-formatted lines (start with '{' or '[' after whitespace)
+        if (!noshell_is_document(line) || noshell_tombs_has(&tombs, at))
             continue;
         if (cb(line, userdata)) {
             result = FOSSIL_NOSHELL_ERROR_SUCCESS;
@@ -401,10 +1485,322 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_find_cb(
         }
     }
 
+    noshell_reader_free(&reader);
+    noshell_tombs_free(&tombs);
     fclose(fp);
     return result;
 }
 
+/**
+ * Parallel scan: the file is read in windows of one slice per worker, each
+ * window cut at its last newline (the rest carries over) and each slice
+ * cut at a newline too. Workers filter their slice's live documents with
+ * the matcher. Unordered scans call the callback right there; ordered
+ * scans record the hits and the calling thread delivers them slice by
+ * slice, so callbacks see documents in file order.
+ */
+#define NOSHELL_SCAN_SLICE       (1024 * 1024)
+#define NOSHELL_SCAN_THREADS     4
+#define NOSHELL_SCAN_MAX_THREADS 16
+
+typedef struct {
+    const noshell_matcher_t *matcher;   // NULL = every live document
+    const noshell_tombs_t   *tombs;
+    bool  (*cb)(const char *document, void *userdata);
+    void   *userdata;
+    bool    ordered;
+    fossil_bluecrab_thread_mutex_t mutex;              // guards stop
+    bool    stop;                       // a callback returned true
+} noshell_scan_t;
+
+typedef struct {
+    noshell_scan_t *scan;
+    const char *data;                   // slice within the window
+    size_t      size;
+    uint64_t    base;                   // file offset of data
+    char       *line;                   // NUL-terminated copy of the current line
+    size_t      line_cap;
+    size_t     *hits;                   // ordered: start/length pairs within data
+    size_t      hit_count;
+    size_t      hit_cap;
+    bool        failed;
+} noshell_scan_part_t;
+
+static bool noshell_scan_copy(noshell_scan_part_t *part, const char *at, size_t len) {
+    if (part->line_cap < len + 1) {
+        size_t cap = part->line_cap ? part->line_cap : 1024;
+        while (cap < len + 1)
+            cap *= 2;
+        char *grown = (char *)realloc(part->line, cap);
+        if (!grown)
+            return false;
+        part->line = grown;
+        part->line_cap = cap;
+    }
+    memcpy(part->line, at, len);
+    part->line[len] = '\0';
+    return true;
+}
+
+static bool noshell_scan_stopped(noshell_scan_t *scan) {
+    fossil_bluecrab_thread_mutex_lock(&scan->mutex);
+    bool stop = scan->stop;
+    fossil_bluecrab_thread_mutex_unlock(&scan->mutex);
+    return stop;
+}
+
+static void noshell_scan_slice(noshell_scan_part_t *part) {
+    noshell_scan_t *scan = part->scan;
+    part->hit_count = 0;
+    part->failed = false;
+    size_t pos = 0;
+    while (pos < part->size) {
+        const char *at = part->data + pos;
+        const char *nl = fossil_bluecrab_scan_newline(at, part->size - pos);
+        size_t len = nl ? (size_t)(nl - at) + 1 : part->size - pos;
+        size_t start = pos;
+        pos += len;
+        if (noshell_tombs_has(scan->tombs, part->base + start))
+            continue;
+        if (!noshell_scan_copy(part, at, len)) {
+            part->failed = true;
+            return;
+        }
+        if (!noshell_is_document(part->line))
+            continue;
+        if (scan->matcher && !noshell_matcher_test(scan->matcher, part->line))
+            continue;
+
+        if (scan->ordered) {
+            if (part->hit_count + 2 > part->hit_cap) {
+                size_t cap = part->hit_cap ? part->hit_cap * 2 : 64;
+                size_t *grown = (size_t *)realloc(part->hits, cap * sizeof(*grown));
+                if (!grown) {
+                    part->failed = true;
+                    return;
+                }
+                part->hits = grown;
+                part->hit_cap = cap;
+            }
+            part->hits[part->hit_count++] = start;
+            part->hits[part->hit_count++] = len;
+        } else {
+            if (noshell_scan_stopped(scan))
+                return;
+            if (scan->cb(part->line, scan->userdata)) {
+                fossil_bluecrab_thread_mutex_lock(&scan->mutex);
+                scan->stop = true;
+                fossil_bluecrab_thread_mutex_unlock(&scan->mutex);
+                return;
+            }
+        }
+    }
+}
+
+FOSSIL_THREAD_FN(noshell_scan_worker) {
+    noshell_scan_slice((noshell_scan_part_t *)arg);
+    FOSSIL_THREAD_RETURN;
+}
+
+/**
+ * Splits window[0..size) into up to part_count newline-aligned slices and
+ * scans them, part 0 (and any part whose thread failed to start) on the
+ * caller. Returns the number of parts used.
+ */
+static size_t noshell_scan_window(noshell_scan_part_t *parts, size_t part_count, const char *window, size_t size, uint64_t base) {
+    size_t used = 0, from = 0;
+    for (size_t i = 0; i < part_count && from < size; ++i) {
+        size_t to = size * (i + 1) / part_count;
+        if (to < from)
+            to = from;
+        if (i + 1 == part_count || to >= size) {
+            to = size;
+        } else {
+            const char *nl = fossil_bluecrab_scan_newline(window + to, size - to);
+            to = nl ? (size_t)(nl - window) + 1 : size;
+        }
+        parts[i].data = window + from;
+        parts[i].size = to - from;
+        parts[i].base = base + from;
+        from = to;
+        used++;
+    }
+
+    fossil_bluecrab_thread_t threads[NOSHELL_SCAN_MAX_THREADS];
+    bool started[NOSHELL_SCAN_MAX_THREADS] = {false};
+    for (size_t i = 1; i < used; ++i)
+        started[i] = fossil_bluecrab_thread_start(&threads[i], noshell_scan_worker, &parts[i]);
+    for (size_t i = 0; i < used; ++i) {
+        if (i == 0 || !started[i])
+            noshell_scan_slice(&parts[i]);
+    }
+    for (size_t i = 1; i < used; ++i) {
+        if (started[i])
+            fossil_bluecrab_thread_join(threads[i]);
+    }
+    return used;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_find_cb_parallel(
+    const char *file_name,
+    const char *query,
+    fossil_bluecrab_noshell_scan_mode_t mode,
+    size_t threads,
+    bool (*cb)(const char *document, void *userdata),
+    void *userdata
+) {
+    if (!file_name || !cb)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    if (mode != FOSSIL_NOSHELL_SCAN_ORDERED && mode != FOSSIL_NOSHELL_SCAN_UNORDERED)
+        return FOSSIL_NOSHELL_ERROR_INVALID_QUERY;
+
+    if (!fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_matcher_t matcher = {0};
+    bool filtered = query && *query;
+    if (filtered) {
+        fossil_bluecrab_noshell_error_t rc = noshell_matcher_init(&matcher, query);
+        if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+            return rc;
+    }
+
+    // An LSM store is scanned in id order by the calling thread
+    noshell_lsm_t *lsm;
+    fossil_bluecrab_noshell_error_t routed = noshell_lsm_acquire(file_name, &lsm);
+    if (lsm) {
+        routed = noshell_lsm_find_cb(lsm, filtered ? &matcher : NULL, cb, userdata);
+        noshell_lsm_release(lsm);
+    }
+    if (lsm || routed != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_matcher_free(&matcher);
+        return routed;
+    }
+
+    FILE *fp = fopen(file_name, "rb");
+    if (!fp) {
+        noshell_matcher_free(&matcher);
+        return FOSSIL_NOSHELL_ERROR_IO;
+    }
+    noshell_tombs_t tombs;
+    fossil_bluecrab_noshell_error_t result = noshell_tombs_load(file_name, fp, &tombs);
+    if (result != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        fclose(fp);
+        noshell_matcher_free(&matcher);
+        return result;
+    }
+    fseek(fp, 0, SEEK_SET);
+
+    if (threads == 0)
+        threads = NOSHELL_SCAN_THREADS;
+    if (threads > NOSHELL_SCAN_MAX_THREADS)
+        threads = NOSHELL_SCAN_MAX_THREADS;
+
+    noshell_scan_t scan = {0};
+    scan.matcher = filtered ? &matcher : NULL;
+    scan.tombs = &tombs;
+    scan.cb = cb;
+    scan.userdata = userdata;
+    scan.ordered = mode == FOSSIL_NOSHELL_SCAN_ORDERED;
+    fossil_bluecrab_thread_mutex_init(&scan.mutex);
+
+    noshell_scan_part_t parts[NOSHELL_SCAN_MAX_THREADS];
+    memset(parts, 0, sizeof(parts));
+    for (size_t i = 0; i < threads; ++i)
+        parts[i].scan = &scan;
+
+    size_t cap = threads * NOSHELL_SCAN_SLICE;
+    char *window = (char *)malloc(cap);
+    size_t carry = 0;
+    uint64_t base = 0;
+    bool found = false;
+    result = window ? FOSSIL_NOSHELL_ERROR_SUCCESS : FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+
+    while (result == FOSSIL_NOSHELL_ERROR_SUCCESS && !found) {
+        size_t n = fread(window + carry, 1, cap - carry, fp);
+        size_t total = carry + n;
+        bool eof = n < cap - carry;
+        if (ferror(fp)) {
+            result = FOSSIL_NOSHELL_ERROR_IO;
+            break;
+        }
+        if (total == 0)
+            break;
+
+        size_t end = total;
+        if (!eof) {
+            while (end > 0 && window[end - 1] != '\n')
+                end--;
+            if (end == 0) {
+                // One line fills the window; widen it and read on
+                char *grown = (char *)realloc(window, cap * 2);
+                if (!grown) {
+                    result = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+                    break;
+                }
+                window = grown;
+                cap *= 2;
+                carry = total;
+                continue;
+            }
+        }
+
+        size_t used = noshell_scan_window(parts, threads, window, end, base);
+        for (size_t i = 0; i < used; ++i) {
+            if (parts[i].failed)
+                result = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        }
+        if (scan.ordered) {
+            for (size_t i = 0; i < used && !found && result == FOSSIL_NOSHELL_ERROR_SUCCESS; ++i) {
+                noshell_scan_part_t *part = &parts[i];
+                for (size_t h = 0; h < part->hit_count && !found; h += 2) {
+                    if (!noshell_scan_copy(part, part->data + part->hits[h], part->hits[h + 1])) {
+                        result = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+                        break;
+                    }
+                    found = cb(part->line, userdata);
+                }
+            }
+        } else {
+            found = scan.stop;
+        }
+
+        memmove(window, window + end, total - end);
+        carry = total - end;
+        base += end;
+        if (eof)
+            break;
+    }
+
+    for (size_t i = 0; i < threads; ++i) {
+        free(parts[i].line);
+        free(parts[i].hits);
+    }
+    free(window);
+    fossil_bluecrab_thread_mutex_destroy(&scan.mutex);
+    noshell_tombs_free(&tombs);
+    fclose(fp);
+    noshell_matcher_free(&matcher);
+    if (result != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return result;
+    return found ? FOSSIL_NOSHELL_ERROR_SUCCESS : FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_find_by_id(
+    const char *file_name,
+    const char *id,
+    char *result,
+    size_t buffer_size
+) {
+    if (!file_name || !id || !result || buffer_size == 0)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    if (!fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    return noshell_path_find_by_id(file_name, id, result, buffer_size);
+}
+
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_update(
     const char *file_name,
     const char *query,
@@ -437,98 +1833,42 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_update(
     if (*doc_ptr != '{' && *doc_ptr != '[')
         return FOSSIL_NOSHELL_ERROR_INVALID_TYPE;
 
-    FILE *fp = fopen(file_name, "r");
-    if (!fp)
-        return FOSSIL_NOSHELL_ERROR_IO;
-
-    // Read all lines into memory
-    char **lines = NULL;
-    size_t count = 0, cap = 0;
-    char buf[1024];
-    bool updated = false;
-
-    while (fgets(buf, sizeof(buf), fp)) {
-        // Only update FSON-formatted lines that match the query and (if provided) type_id
-        char *p = buf;
-        while (isspace((unsigned char)*p)) p++;
-        if ((*p == '{' || *p == '[') && strstr(buf, query)) {
-            if (type_id && strlen(type_id) > 0) {
-                char type_tag[32];
-                snprintf(type_tag, sizeof(type_tag), "#type=%s", type_id);
-                if (!strstr(buf, type_tag)) {
-                    // Not matching type, keep original line
-                    if (count == cap) {
-                        cap = cap ? cap * 2 : 16;
-                        lines = (char **)realloc(lines, cap * sizeof(char *));
-                        if (!lines) {
-                            fclose(fp);
-                            return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
-                        }
-                    }
-                    lines[count++] = noshell_strdup(buf);
-                    continue;
-                }
-            }
-            // Replace line with new_document (+ param_list if provided) and #type if type_id is given
-            char new_line[1024];
-            if (param_list && strlen(param_list) > 0) {
-                if (type_id && strlen(type_id) > 0)
-                    snprintf(new_line, sizeof(new_line), "%s %s #type=%s\n", new_document, param_list, type_id);
-                else
-                    snprintf(new_line, sizeof(new_line), "%s %s\n", new_document, param_list);
-            } else {
-                if (type_id && strlen(type_id) > 0)
-                    snprintf(new_line, sizeof(new_line), "%s #type=%s\n", new_document, type_id);
-                else
-                    snprintf(new_line, sizeof(new_line), "%s\n", new_document);
-            }
-
-            if (count == cap) {
-                cap = cap ? cap * 2 : 16;
-                lines = (char **)realloc(lines, cap * sizeof(char *));
-                if (!lines) {
-                    fclose(fp);
-                    return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
-                }
-            }
-            lines[count++] = noshell_strdup(new_line);
-            updated = true;
-        } else {
-            if (count == cap) {
-                cap = cap ? cap * 2 : 16;
-                lines = (char **)realloc(lines, cap * sizeof(char *));
-                if (!lines) {
-                    fclose(fp);
-                    return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
-                }
-            }
-            lines[count++] = noshell_strdup(buf);
-        }
+    noshell_matcher_t matcher;
+    fossil_bluecrab_noshell_error_t rc = noshell_matcher_init(&matcher, query);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+
+    char type_tag[32] = {0};
+    if (type_id && strlen(type_id) > 0)
+        snprintf(type_tag, sizeof(type_tag), "#type=%s", type_id);
+    char *body = noshell_version_body(new_document, param_list, type_id);
+    noshell_lsm_t *lsm = NULL;
+    rc = body ? noshell_lsm_acquire(file_name, &lsm) : FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    if (lsm) {
+        rc = noshell_lsm_apply(lsm, &matcher, type_tag, body);
+        noshell_lsm_release(lsm);
     }
-    fclose(fp);
-
-    if (!updated) {
-        // No matching document found
-        for (size_t i = 0; i < count; ++i) free(lines[i]);
-        free(lines);
-        return FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    if (lsm || rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        free(body);
+        noshell_matcher_free(&matcher);
+        return rc;
     }
-
-    // Write all lines back to file
-    fp = fopen(file_name, "w");
+    FILE *fp = fopen(file_name, "rb+");
     if (!fp) {
-        for (size_t i = 0; i < count; ++i) free(lines[i]);
-        free(lines);
+        free(body);
+        noshell_matcher_free(&matcher);
         return FOSSIL_NOSHELL_ERROR_IO;
     }
-    for (size_t i = 0; i < count; ++i) {
-        fputs(lines[i], fp);
-        free(lines[i]);
-    }
-    free(lines);
-    fclose(fp);
 
-    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+    // Tombstone and new version appended per match; nothing is rewritten
+    bool compact = false;
+    rc = noshell_tomb_apply(file_name, fp, &matcher, type_tag, body, NULL, NULL, &compact);
+    fclose(fp);
+    free(body);
+    noshell_matcher_free(&matcher);
+    if (compact)
+        fossil_bluecrab_noshell_compact(file_name);
+    return rc;
 }
 
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_remove(const char *file_name, const char *query) {
@@ -538,55 +1878,36 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_remove(const char *file_
     if (!fossil_bluecrab_noshell_validate_extension(file_name))
         return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
 
-    FILE *fp = fopen(file_name, "r");
-    if (!fp)
-        return FOSSIL_NOSHELL_ERROR_IO;
-
-    char **lines = NULL;
-    size_t count = 0, cap = 0;
-    char buf[1024];
-    bool removed = false;
+    noshell_matcher_t matcher;
+    fossil_bluecrab_noshell_error_t rc = noshell_matcher_init(&matcher, query);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
 
-    while (fgets(buf, sizeof(buf), fp)) {
-        // Only remove FSON-formatted lines (start with '{' or '[' after whitespace) that match the query
-        char *p = buf;
-        while (isspace((unsigned char)*p)) p++;
-        if ((*p == '{' || *p == '[') && strstr(buf, query)) {
-            removed = true;
-            continue; // Skip this line (remove)
-        }
-        if (count == cap) {
-            cap = cap ? cap * 2 : 16;
-            lines = (char **)realloc(lines, cap * sizeof(char *));
-            if (!lines) {
-                fclose(fp);
-                return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
-            }
-        }
-        lines[count++] = noshell_strdup(buf);
+    noshell_lsm_t *lsm;
+    rc = noshell_lsm_acquire(file_name, &lsm);
+    if (lsm) {
+        rc = noshell_lsm_apply(lsm, &matcher, "", NULL);
+        noshell_lsm_release(lsm);
     }
-    fclose(fp);
-
-    if (!removed) {
-        for (size_t i = 0; i < count; ++i) free(lines[i]);
-        free(lines);
-        return FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    if (lsm || rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_matcher_free(&matcher);
+        return rc;
     }
 
-    fp = fopen(file_name, "w");
+    FILE *fp = fopen(file_name, "rb+");
     if (!fp) {
-        for (size_t i = 0; i < count; ++i) free(lines[i]);
-        free(lines);
+        noshell_matcher_free(&matcher);
         return FOSSIL_NOSHELL_ERROR_IO;
     }
-    for (size_t i = 0; i < count; ++i) {
-        fputs(lines[i], fp);
-        free(lines[i]);
-    }
-    free(lines);
-    fclose(fp);
 
-    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+    // One tombstone appended per match; nothing is rewritten
+    bool compact = false;
+    rc = noshell_tomb_apply(file_name, fp, &matcher, "", NULL, NULL, NULL, &compact);
+    fclose(fp);
+    noshell_matcher_free(&matcher);
+    if (compact)
+        fossil_bluecrab_noshell_compact(file_name);
+    return rc;
 }
 
 // ===========================================================
@@ -600,6 +1921,9 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_create_database(const ch
     if (!fossil_bluecrab_noshell_validate_extension(file_name))
         return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
 
+    // A fresh database is plain text
+    noshell_lsm_drop(file_name);
+
     FILE *fp = fopen(file_name, "w");
     if (!fp)
         return FOSSIL_NOSHELL_ERROR_IO;
@@ -608,9 +1932,11 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_create_database(const ch
     fprintf(fp, "#fson_types=null,bool,i8,i16,i32,i64,u8,u16,u32,u64,f32,f64,oct,hex,bin,char,cstr,array,object,enum,datetime,duration\n");
     // Write an empty FSON object as the initial content
     fprintf(fp, "{ }\n");
+    fossil_bluecrab_noshell_error_t rc = noshell_durable(file_name, fp);
     fclose(fp);
+    noshell_file_invalidate(file_name);
 
-    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+    return rc;
 }
 
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_open_database(const char *file_name) {
@@ -635,6 +1961,16 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_open_database(const char
         return FOSSIL_NOSHELL_ERROR_SCHEMA_MISMATCH;
     }
 
+    // The documents of an LSM database live in its store
+    noshell_lsm_t *lsm;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_acquire(file_name, &lsm);
+    if (lsm)
+        noshell_lsm_release(lsm);
+    if (lsm || rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        fclose(fp);
+        return rc;
+    }
+
     // Check that the next non-header line is a valid FSON object or array
     int found = 0;
     while (fgets(buf, sizeof(buf), fp)) {
@@ -674,6 +2010,8 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_delete_database(const ch
     }
     fclose(fp);
 
+    noshell_lsm_drop(file_name);
+    noshell_file_invalidate(file_name);
     if (remove(file_name) == 0)
         return FOSSIL_NOSHELL_ERROR_SUCCESS;
     else
@@ -748,33 +2086,44 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_backup_database(const ch
         !fossil_bluecrab_noshell_validate_extension(backup_file))
         return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
 
-    FILE *src = fopen(source_file, "r");
+    // An LSM database backs up to a plain text file
+    noshell_lsm_t *lsm;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_acquire(source_file, &lsm);
+    if (lsm) {
+        FILE *dst = fopen(backup_file, "wb");
+        rc = dst ? noshell_lsm_write_text(lsm, dst) : FOSSIL_NOSHELL_ERROR_IO;
+        if (dst && fclose(dst) != 0)
+            rc = FOSSIL_NOSHELL_ERROR_IO;
+        noshell_lsm_release(lsm);
+        return rc == FOSSIL_NOSHELL_ERROR_SUCCESS ? rc : FOSSIL_NOSHELL_ERROR_BACKUP_FAILED;
+    }
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return FOSSIL_NOSHELL_ERROR_BACKUP_FAILED;
+
+    FILE *src = fopen(source_file, "rb");
     if (!src)
         return FOSSIL_NOSHELL_ERROR_IO;
-
-    FILE *dst = fopen(backup_file, "w");
-    if (!dst) {
+    noshell_tombs_t tombs;
+    if (noshell_tombs_load(source_file, src, &tombs) != FOSSIL_NOSHELL_ERROR_SUCCESS) {
         fclose(src);
         return FOSSIL_NOSHELL_ERROR_IO;
     }
 
-    char line[4096];
-    while (fgets(line, sizeof(line), src)) {
-        // Only backup header lines and FSON-formatted documents (start with '{' or '[' after whitespace)
-        char *p = line;
-        while (isspace((unsigned char)*p)) p++;
-        if (line[0] == '#' || *p == '{' || *p == '[') {
-            if (fputs(line, dst) == EOF) {
-                fclose(src);
-                fclose(dst);
-                return FOSSIL_NOSHELL_ERROR_BACKUP_FAILED;
-            }
-        }
+    FILE *dst = fopen(backup_file, "wb");
+    if (!dst) {
+        noshell_tombs_free(&tombs);
+        fclose(src);
+        return FOSSIL_NOSHELL_ERROR_IO;
     }
 
+    // Only backup header lines and live FSON-formatted documents; the
+    // backup comes out compacted
+    bool copied = noshell_copy_live(src, dst, &tombs);
+    noshell_tombs_free(&tombs);
     fclose(src);
-    fclose(dst);
-    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+    if (fclose(dst) != 0)
+        copied = false;
+    return copied ? FOSSIL_NOSHELL_ERROR_SUCCESS : FOSSIL_NOSHELL_ERROR_BACKUP_FAILED;
 }
 
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_restore_database(const char *backup_file, const char *destination_file) {
@@ -785,33 +2134,31 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_restore_database(const c
         !fossil_bluecrab_noshell_validate_extension(destination_file))
         return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
 
-    FILE *src = fopen(backup_file, "r");
+    FILE *src = fopen(backup_file, "rb");
     if (!src)
         return FOSSIL_NOSHELL_ERROR_IO;
-
-    FILE *dst = fopen(destination_file, "w");
-    if (!dst) {
+    noshell_tombs_t tombs;
+    if (noshell_tombs_load(backup_file, src, &tombs) != FOSSIL_NOSHELL_ERROR_SUCCESS) {
         fclose(src);
         return FOSSIL_NOSHELL_ERROR_IO;
     }
 
-    char line[4096];
-    while (fgets(line, sizeof(line), src)) {
-        // Only restore header lines and FSON-formatted documents (start with '{' or '[' after whitespace)
-        char *p = line;
-        while (isspace((unsigned char)*p)) p++;
-        if (line[0] == '#' || *p == '{' || *p == '[') {
-            if (fputs(line, dst) == EOF) {
-                fclose(src);
-                fclose(dst);
-                return FOSSIL_NOSHELL_ERROR_RESTORE_FAILED;
-            }
-        }
+    noshell_lsm_drop(destination_file);
+    FILE *dst = fopen(destination_file, "wb");
+    if (!dst) {
+        noshell_tombs_free(&tombs);
+        fclose(src);
+        return FOSSIL_NOSHELL_ERROR_IO;
     }
 
+    // Only restore header lines and live FSON-formatted documents
+    bool copied = noshell_copy_live(src, dst, &tombs);
+    noshell_tombs_free(&tombs);
     fclose(src);
-    fclose(dst);
-    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+    if (fclose(dst) != 0)
+        copied = false;
+    noshell_file_invalidate(destination_file);
+    return copied ? FOSSIL_NOSHELL_ERROR_SUCCESS : FOSSIL_NOSHELL_ERROR_RESTORE_FAILED;
 }
 
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_verify_database(const char *file_name) {
@@ -821,15 +2168,30 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_verify_database(const ch
     if (!fossil_bluecrab_noshell_validate_extension(file_name))
         return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
 
-    FILE *fp = fopen(file_name, "r");
+    // Segments are checked when the store opens; the anchor holds no documents
+    noshell_lsm_t *lsm;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_acquire(file_name, &lsm);
+    if (lsm)
+        noshell_lsm_release(lsm);
+    if (lsm || rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+
+    FILE *fp = fopen(file_name, "rb");
     if (!fp)
         return FOSSIL_NOSHELL_ERROR_IO;
 
-    char line[1024];
-    while (fgets(line, sizeof(line), fp)) {
-        // Skip header lines
-        if (line[0] == '#')
+    noshell_reader_t reader;
+    noshell_reader_init(&reader, fp);
+    char *line;
+    size_t len;
+    while (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && (line = noshell_reader_next(&reader, &len)) != NULL) {
+        // Skip header lines; tombstones must at least parse
+        if (line[0] == '#') {
+            uint64_t dead_at, dead_len;
+            if (strncmp(line, "#del=", 5) == 0 && !noshell_tomb_parse(line, &dead_at, &dead_len))
+                rc = FOSSIL_NOSHELL_ERROR_CORRUPTED;
             continue;
+        }
 
         // Only check FSON-formatted lines (start with '{' or '[' after whitespace)
         char *p = line;
@@ -838,34 +2200,25 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_verify_database(const ch
             continue;
 
         // Find "#hash=" in line
-        char *hash_pos = strstr(line, "#hash=");
+        const char *hash_pos = fossil_bluecrab_scan_find(line, len, "#hash=", 6);
         if (hash_pos) {
-            // Find key part (first field before ':')
-            char *key_start = p;
-            char *colon = strchr(key_start, ':');
+            // Key part is everything before the first ':'
+            const char *colon = fossil_bluecrab_scan_byte(p, len - (size_t)(p - line), ':');
             if (!colon) continue;
-            size_t key_len = colon - key_start;
-            char key[256];
-            if (key_len >= sizeof(key)) continue;
-            strncpy(key, key_start, key_len);
-            key[key_len] = '\0';
-
-            // Compute hash
-            uint64_t expected_hash = noshell_hash64(key);
-
-            // Extract hash from line
-            char hash_str[17] = {0};
-            strncpy(hash_str, hash_pos + 6, 16);
-            uint64_t actual_hash = strtoull(hash_str, NULL, 16);
-
-            if (expected_hash != actual_hash) {
-                fclose(fp);
-                return FOSSIL_NOSHELL_ERROR_CORRUPTED;
-            }
+            size_t key_len = (size_t)(colon - p);
+            if (key_len >= 256) continue;
+
+            uint64_t expected_hash = fossil_bluecrab_hash64_legacy(p, key_len);
+            uint64_t actual_hash;
+            hash_pos += 6;
+            fossil_bluecrab_scan_hex64(hash_pos, len - (size_t)(hash_pos - line), &actual_hash);
+            if (expected_hash != actual_hash)
+                rc = FOSSIL_NOSHELL_ERROR_CORRUPTED;
         }
     }
+    noshell_reader_free(&reader);
     fclose(fp);
-    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+    return rc;
 }
 
 // ===========================================================
@@ -879,30 +2232,8 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_first_document(const cha
     if (!fossil_bluecrab_noshell_validate_extension(file_name))
         return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
 
-    FILE *fp = fopen(file_name, "r");
-    if (!fp)
-        return FOSSIL_NOSHELL_ERROR_IO;
-
-    char line[1024];
-    while (fgets(line, sizeof(line), fp)) {
-        // Skip header lines
-        if (line[0] == '#')
-            continue;
-        // Only consider FSON-formatted lines (start with '{' or '[' after whitespace)
-        char *p = line;
-        while (isspace((unsigned char)*p)) p++;
-        if ((*p == '{' || *p == '[')) {
-            char *id_pos = strstr(line, "#id=");
-            if (id_pos) {
-                strncpy(id_buffer, id_pos + 4, 16);
-                id_buffer[16] = '\0';
-                fclose(fp);
-                return FOSSIL_NOSHELL_ERROR_SUCCESS;
-            }
-        }
-    }
-    fclose(fp);
-    return FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    // Served from the document id index; the file is only read when it changed
+    return noshell_path_step(file_name, NULL, id_buffer, buffer_size);
 }
 
 fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_next_document(
@@ -917,39 +2248,7 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_next_document(
     if (!fossil_bluecrab_noshell_validate_extension(file_name))
         return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
 
-    FILE *fp = fopen(file_name, "r");
-    if (!fp)
-        return FOSSIL_NOSHELL_ERROR_IO;
-
-    char line[1024];
-    bool found_prev = false;
-    while (fgets(line, sizeof(line), fp)) {
-        // Skip header lines
-        if (line[0] == '#')
-            continue;
-        // Only consider FSON-formatted lines (start with '{' or '[' after whitespace)
-        char *p = line;
-        while (isspace((unsigned char)*p)) p++;
-        if (*p == '{' || *p == '[') {
-            char *id_pos = strstr(line, "#id=");
-            if (id_pos) {
-                char curr_id[17] = {0};
-                strncpy(curr_id, id_pos + 4, 16);
-                curr_id[16] = '\0';
-                if (found_prev) {
-                    strncpy(id_buffer, curr_id, 16);
-                    id_buffer[16] = '\0';
-                    fclose(fp);
-                    return FOSSIL_NOSHELL_ERROR_SUCCESS;
-                }
-                if (strncmp(curr_id, prev_id, 16) == 0) {
-                    found_prev = true;
-                }
-            }
-        }
-    }
-    fclose(fp);
-    return FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    return noshell_path_step(file_name, prev_id, id_buffer, buffer_size);
 }
 
 // ===========================================================
@@ -963,25 +2262,53 @@ fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_count_documents(const ch
     if (!fossil_bluecrab_noshell_validate_extension(file_name))
         return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
 
-    FILE *fp = fopen(file_name, "r");
-    if (!fp)
-        return FOSSIL_NOSHELL_ERROR_IO;
-
-    size_t doc_count = 0;
-    char line[1024];
-    while (fgets(line, sizeof(line), fp)) {
-        // Skip header lines
-        if (line[0] == '#')
-            continue;
-        // Only count FSON-formatted lines (start with '{' or '[' after whitespace) and containing "#id="
-        char *p = line;
-        while (isspace((unsigned char)*p)) p++;
-        if ((*p == '{' || *p == '[') && strstr(line, "#id="))
-            doc_count++;
+    // Live documents with an #id=, kept by the statistics sidecar
+    noshell_meta_t meta;
+    noshell_lsm_t *lsm;
+    uint64_t disk_bytes;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_acquire(file_name, &lsm);
+    if (lsm) {
+        rc = noshell_lsm_stats(lsm, &meta, &disk_bytes);
+        noshell_lsm_release(lsm);
+    } else if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        rc = noshell_meta_load(file_name, &meta);
     }
-    fclose(fp);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
 
-    *count = doc_count;
+    *count = (size_t)meta.docs;
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_stats(const char *file_name, fossil_bluecrab_noshell_stats_t *stats) {
+    if (!file_name || !stats)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    if (!fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_meta_t meta;
+    noshell_lsm_t *lsm;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_acquire(file_name, &lsm);
+    if (lsm) {
+        // Every file of the store; whatever is not a live line is overhead
+        uint64_t disk_bytes = 0;
+        rc = noshell_lsm_stats(lsm, &meta, &disk_bytes);
+        noshell_lsm_release(lsm);
+        meta.dead_bytes = disk_bytes > meta.size ? disk_bytes - meta.size : 0;
+        meta.size = meta.dead_bytes + meta.size;
+    } else if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        rc = noshell_meta_load(file_name, &meta);
+    }
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+
+    stats->documents = (size_t)meta.docs;
+    stats->file_size = (size_t)meta.size;
+    stats->dead_bytes = (size_t)meta.dead_bytes;
+    stats->live_bytes = (size_t)(meta.size - meta.dead_bytes);
+    for (size_t i = 0; i < FOSSIL_NOSHELL_STATS_TYPES; ++i)
+        stats->type_counts[i] = (size_t)meta.types[i];
     return FOSSIL_NOSHELL_ERROR_SUCCESS;
 }
 
@@ -1068,3 +2395,6097 @@ bool fossil_bluecrab_noshell_validate_document(const char *document) {
 
     return true;
 }
+
+// ===========================================================
+// Persistent Handles
+// ===========================================================
+
+/**
+ * Document table entry: where a document line starts, how long it is, and
+ * its #id= value (has_id is false for lines written without one, e.g. by
+ * update).
+ */
+typedef struct {
+    uint64_t offset;
+    size_t   length;
+    uint64_t id;
+    bool     has_id;
+} noshell_doc_ref_t;
+
+/**
+ * Document table: one entry per document line in file order, plus an
+ * open-addressing map from #id= to the first entry carrying it (the entry
+ * a scan from the top would hit first). Ids are already hashes, so the
+ * map uses their low bits directly.
+ */
+typedef struct {
+    noshell_doc_ref_t *docs;
+    size_t   count;
+    size_t   cap;
+    size_t   id_count;      // entries with has_id (what count_documents reports)
+    size_t  *slots;         // entry index + 1, 0 = empty
+    size_t   slot_count;    // power of two, or 0
+    size_t   mapped;        // occupied slots
+} noshell_doc_table_t;
+
+typedef struct {
+    fossil_bluecrab_thread_mutex_t     mutex;
+    noshell_file_t     *file;          // registry entry, referenced while open
+    uint64_t            dev;           // identity of the file db->file has open
+    uint64_t            ino;
+    char               *read_buf;      // installed on db->file with setvbuf
+    char               *line;          // reusable line buffer
+    size_t              line_cap;
+    noshell_doc_table_t table;
+} noshell_handle_state_t;
+
+#define NOSHELL_READ_BUFFER (64 * 1024)
+#define NOSHELL_NO_DOC      ((size_t)-1)
+
+static bool noshell_type_valid(const char *type) {
+    for (size_t i = 0; i <= NOSHELL_FSON_TYPE_DURATION; ++i) {
+        if (strcmp(type, noshell_fson_type_names[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Returns true if the line is an FSON document line ('{' or '[' after
+ * leading whitespace), the same test every file-name function applies.
+ */
+static bool noshell_is_document(const char *line) {
+    while (isspace((unsigned char)*line)) line++;
+    return *line == '{' || *line == '[';
+}
+
+static bool noshell_line_id(const char *line, size_t len, uint64_t *id) {
+    const char *id_pos = fossil_bluecrab_scan_find(line, len, "#id=", 4);
+    if (!id_pos)
+        return false;
+    id_pos += 4;
+    fossil_bluecrab_scan_hex64(id_pos, len - (size_t)(id_pos - line), id);
+    return true;
+}
+
+static uint64_t noshell_parse_id(const char *id) {
+    uint64_t value;
+    fossil_bluecrab_scan_hex64(id, strnlen(id, 16), &value);
+    return value;
+}
+
+/**
+ * Reads one whole line (any length) into *line at offset 'start', growing
+ * the buffer as needed; bytes before 'start' are preserved. Returns the
+ * line's length including the newline, or 0 at end of file.
+ */
+static size_t noshell_getline_at(FILE *fp, char **line, size_t *cap, size_t start) {
+    size_t len = 0;
+    for (;;) {
+        if (*cap < start + len + 2) {
+            size_t grown_cap = *cap ? *cap * 2 : 1024;
+            while (grown_cap < start + len + 2)
+                grown_cap *= 2;
+            char *grown = (char *)realloc(*line, grown_cap);
+            if (!grown)
+                return 0;
+            *line = grown;
+            *cap = grown_cap;
+        }
+        char *at = *line + start;
+        if (!fgets(at + len, (int)(*cap - start - len), fp))
+            break;
+        len += strlen(at + len);
+        if (len > 0 && at[len - 1] == '\n')
+            break;
+    }
+    if (*line)
+        (*line)[start + len] = '\0';
+    return len;
+}
+
+/**
+ * Reads one whole line (any length) into *line, growing it as needed.
+ * Returns its length including the newline, or 0 at end of file.
+ */
+static size_t noshell_getline(FILE *fp, char **line, size_t *cap) {
+    return noshell_getline_at(fp, line, cap, 0);
+}
+
+static void noshell_table_reset(noshell_doc_table_t *t) {
+    t->count = 0;
+    t->id_count = 0;
+    t->mapped = 0;
+    if (t->slots)
+        memset(t->slots, 0, t->slot_count * sizeof(*t->slots));
+}
+
+static void noshell_table_free(noshell_doc_table_t *t) {
+    free(t->docs);
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+static size_t noshell_table_find(const noshell_doc_table_t *t, uint64_t id) {
+    if (!t->slot_count)
+        return NOSHELL_NO_DOC;
+    size_t mask = t->slot_count - 1;
+    for (size_t i = (size_t)id & mask;; i = (i + 1) & mask) {
+        size_t slot = t->slots[i];
+        if (slot == 0)
+            return NOSHELL_NO_DOC;
+        if (t->docs[slot - 1].id == id)
+            return slot - 1;
+    }
+}
+
+/**
+ * Maps entry idx's id unless an earlier entry already owns it. Keeps the
+ * map at most half full.
+ */
+static bool noshell_table_map(noshell_doc_table_t *t, size_t idx) {
+    if ((t->mapped + 1) * 2 > t->slot_count) {
+        size_t slot_count = t->slot_count ? t->slot_count * 2 : 64;
+        size_t *slots = (size_t *)calloc(slot_count, sizeof(*slots));
+        if (!slots)
+            return false;
+        size_t mask = slot_count - 1;
+        for (size_t i = 0; i < t->slot_count; ++i) {
+            size_t slot = t->slots[i];
+            if (!slot) continue;
+            size_t j = (size_t)t->docs[slot - 1].id & mask;
+            while (slots[j]) j = (j + 1) & mask;
+            slots[j] = slot;
+        }
+        free(t->slots);
+        t->slots = slots;
+        t->slot_count = slot_count;
+    }
+    uint64_t id = t->docs[idx].id;
+    size_t mask = t->slot_count - 1;
+    size_t i = (size_t)id & mask;
+    while (t->slots[i]) {
+        if (t->docs[t->slots[i] - 1].id == id)
+            return true;
+        i = (i + 1) & mask;
+    }
+    t->slots[i] = idx + 1;
+    t->mapped++;
+    return true;
+}
+
+static noshell_doc_ref_t *noshell_table_add(noshell_doc_table_t *t) {
+    if (t->count == t->cap) {
+        size_t cap = t->cap ? t->cap * 2 : 64;
+        noshell_doc_ref_t *grown = (noshell_doc_ref_t *)realloc(t->docs, cap * sizeof(*grown));
+        if (!grown)
+            return NULL;
+        t->docs = grown;
+        t->cap = cap;
+    }
+    return &t->docs[t->count++];
+}
+
+/**
+ * Records the ref just filled in by noshell_table_add.
+ */
+static bool noshell_table_commit(noshell_doc_table_t *t) {
+    if (!t->docs[t->count - 1].has_id)
+        return true;
+    t->id_count++;
+    return noshell_table_map(t, t->count - 1);
+}
+
+static bool noshell_table_push(noshell_doc_table_t *t, uint64_t offset, const char *line, size_t length) {
+    if (!noshell_is_document(line))
+        return true;
+    noshell_doc_ref_t *ref = noshell_table_add(t);
+    if (!ref)
+        return false;
+    ref->offset = offset;
+    ref->length = length;
+    ref->has_id = noshell_line_id(line, length, &ref->id);
+    return noshell_table_commit(t);
+}
+
+/**
+ * Index of the first entry after 'from' (NOSHELL_NO_DOC = from the start)
+ * that has an id.
+ */
+static size_t noshell_table_next(const noshell_doc_table_t *t, size_t from) {
+    for (size_t i = from == NOSHELL_NO_DOC ? 0 : from + 1; i < t->count; ++i) {
+        if (t->docs[i].has_id)
+            return i;
+    }
+    return NOSHELL_NO_DOC;
+}
+
+/**
+ * First id from 'id' up that no live document in the table holds. Updates
+ * keep a document's original id, so an insert's content hash may already
+ * belong to a different document; inserts move on to the next free id,
+ * the same rule LSM inserts follow.
+ */
+static uint64_t noshell_table_free_id(const noshell_doc_table_t *t, uint64_t id) {
+    while (noshell_table_find(t, id) != NOSHELL_NO_DOC)
+        id++;
+    return id;
+}
+
+/**
+ * Rebuilds the table from fp (positioned anywhere), leaving out the lines
+ * named in tombs. With require_header the first line must be the
+ * #fson_types= header.
+ */
+static fossil_bluecrab_noshell_error_t noshell_table_load(noshell_doc_table_t *t, FILE *fp, char **line, size_t *cap, bool require_header, const noshell_tombs_t *tombs) {
+    noshell_table_reset(t);
+    fseek(fp, 0, SEEK_SET);
+    uint64_t offset = 0;
+    if (require_header) {
+        size_t len = noshell_getline(fp, line, cap);
+        if (len == 0)
+            return FOSSIL_NOSHELL_ERROR_CORRUPTED;
+        if (strncmp(*line, "#fson_types=", 12) != 0)
+            return FOSSIL_NOSHELL_ERROR_SCHEMA_MISMATCH;
+        offset = len;
+    }
+
+    size_t len;
+    while ((len = noshell_getline(fp, line, cap)) > 0) {
+        if (!noshell_tombs_has(tombs, offset) && !noshell_table_push(t, offset, *line, len))
+            return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        offset += len;
+    }
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+/** noshell_line_fn recording each line in a document table. */
+static bool noshell_table_keep(void *ctx, uint64_t offset, const char *line, size_t len) {
+    return noshell_table_push((noshell_doc_table_t *)ctx, offset, line, len);
+}
+
+static void noshell_handle_stamp(fossil_bluecrab_noshell_t *db) {
+    noshell_handle_state_t *st = (noshell_handle_state_t *)db->state;
+    struct stat sb;
+    if (stat(db->path, &sb) == 0) {
+        db->file_size = (size_t)sb.st_size;
+        db->last_modified = sb.st_mtime;
+    }
+#if defined(_WIN32) || defined(_WIN64)
+    st->dev = st->ino = 0;          // no inode numbers; open files cannot be renamed over
+#else
+    if (fstat(fileno(db->file), &sb) == 0) {
+        st->dev = (uint64_t)sb.st_dev;
+        st->ino = (uint64_t)sb.st_ino;
+    }
+#endif
+}
+
+/**
+ * (Re)opens the file and rebuilds the document table from scratch.
+ */
+static fossil_bluecrab_noshell_error_t noshell_handle_load(fossil_bluecrab_noshell_t *db) {
+    noshell_handle_state_t *st = (noshell_handle_state_t *)db->state;
+    if (db->file) {
+        fclose(db->file);
+        db->file = NULL;
+    }
+    db->file = fopen(db->path, "rb+");
+    if (!db->file)
+        return FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND;
+    setvbuf(db->file, st->read_buf, _IOFBF, NOSHELL_READ_BUFFER);
+
+    noshell_tombs_t tombs;
+    fossil_bluecrab_noshell_error_t rc = noshell_tombs_load(db->path, db->file, &tombs);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+        rc = noshell_table_load(&st->table, db->file, &st->line, &st->line_cap, true, &tombs);
+    noshell_tombs_free(&tombs);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+        noshell_handle_stamp(db);
+    return rc;
+}
+
+/**
+ * Locks the handle and picks up changes made behind its back (by the
+ * file-name functions or another process): a different file at the path
+ * (a compaction renamed a new one over it) reopens it, and any size or
+ * mtime difference rebuilds the table.
+ */
+static fossil_bluecrab_noshell_error_t noshell_handle_enter(fossil_bluecrab_noshell_t *db) {
+    if (!db || !db->is_open)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    noshell_handle_state_t *st = (noshell_handle_state_t *)db->state;
+    fossil_bluecrab_thread_mutex_lock(&st->mutex);
+    struct stat sb;
+    if (stat(db->path, &sb) != 0) {
+        fossil_bluecrab_thread_mutex_unlock(&st->mutex);
+        return FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND;
+    }
+    bool replaced = (uint64_t)sb.st_ino != st->ino || (uint64_t)sb.st_dev != st->dev;
+    if (replaced || (size_t)sb.st_size != db->file_size || sb.st_mtime != db->last_modified) {
+        fossil_bluecrab_noshell_error_t rc = noshell_handle_load(db);
+        if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+            fossil_bluecrab_thread_mutex_unlock(&st->mutex);
+            return rc;
+        }
+    }
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+static void noshell_handle_leave(fossil_bluecrab_noshell_t *db) {
+    fossil_bluecrab_thread_mutex_unlock(&((noshell_handle_state_t *)db->state)->mutex);
+}
+
+static void noshell_handle_free(fossil_bluecrab_noshell_t *db) {
+    if (!db) return;
+    noshell_handle_state_t *st = (noshell_handle_state_t *)db->state;
+    if (db->file)
+        fclose(db->file);
+    if (st) {
+        fossil_bluecrab_thread_mutex_destroy(&st->mutex);
+        noshell_file_release(st->file);
+        free(st->read_buf);
+        free(st->line);
+        noshell_table_free(&st->table);
+        free(st);
+    }
+    free(db->path);
+    free(db);
+}
+
+fossil_bluecrab_noshell_t *fossil_bluecrab_noshell_open(const char *file_name, fossil_bluecrab_noshell_error_t *err) {
+    if (!file_name || !fossil_bluecrab_noshell_validate_extension(file_name)) {
+        if (err) *err = FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+        return NULL;
+    }
+    // Handles index the text file; an LSM store keeps its own tables
+    if (noshell_lsm_enabled(file_name)) {
+        if (err) *err = FOSSIL_NOSHELL_ERROR_UNSUPPORTED;
+        return NULL;
+    }
+
+    // One handle per file: the entry's slot, with refs under its mutex
+    noshell_file_t *file = noshell_file_acquire(file_name);
+    if (!file) {
+        if (err) *err = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        return NULL;
+    }
+    fossil_bluecrab_thread_mutex_lock(&file->mutex);
+    if (file->handle) {
+        fossil_bluecrab_noshell_t *db = file->handle;
+        db->refs++;
+        fossil_bluecrab_thread_mutex_unlock(&file->mutex);
+        noshell_file_release(file);
+        if (err) *err = FOSSIL_NOSHELL_ERROR_SUCCESS;
+        return db;
+    }
+
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_noshell_t *db = (fossil_bluecrab_noshell_t *)calloc(1, sizeof(*db));
+    noshell_handle_state_t *st = (noshell_handle_state_t *)calloc(1, sizeof(*st));
+    if (db && st) {
+        db->state = st;
+        fossil_bluecrab_thread_mutex_init(&st->mutex);
+        db->path = noshell_strdup(file_name);
+        st->read_buf = (char *)malloc(NOSHELL_READ_BUFFER);
+    } else {
+        free(st);
+    }
+    if (db && db->path && db->state && ((noshell_handle_state_t *)db->state)->read_buf) {
+        rc = noshell_handle_load(db);
+    }
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        fossil_bluecrab_thread_mutex_unlock(&file->mutex);
+        noshell_handle_free(db);
+        noshell_file_release(file);
+        if (err) *err = rc;
+        return NULL;
+    }
+
+    db->refs = 1;
+    db->is_open = true;
+    st->file = file; // the handle keeps the entry's reference
+    file->handle = db;
+    fossil_bluecrab_thread_mutex_unlock(&file->mutex);
+    if (err) *err = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    return db;
+}
+
+void fossil_bluecrab_noshell_close(fossil_bluecrab_noshell_t *db) {
+    if (!db) return;
+    noshell_file_t *file = ((noshell_handle_state_t *)db->state)->file;
+    fossil_bluecrab_thread_mutex_lock(&file->mutex);
+    if (--db->refs > 0) {
+        fossil_bluecrab_thread_mutex_unlock(&file->mutex);
+        return;
+    }
+    file->handle = NULL;
+    fossil_bluecrab_thread_mutex_unlock(&file->mutex);
+    noshell_handle_free(db);
+}
+
+/**
+ * Appends one document line and records it in the table.
+ */
+static fossil_bluecrab_noshell_error_t noshell_handle_append(
+    fossil_bluecrab_noshell_t *db,
+    const char *document,
+    const char *param_list,
+    const char *type,
+    uint64_t *out_id
+) {
+    if (!document || !type)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    if (!noshell_type_valid(type) || !noshell_is_document(document))
+        return FOSSIL_NOSHELL_ERROR_INVALID_TYPE;
+
+    fossil_bluecrab_noshell_error_t rc = noshell_handle_enter(db);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+    noshell_handle_state_t *st = (noshell_handle_state_t *)db->state;
+
+    uint64_t doc_id = noshell_table_free_id(&st->table, noshell_hash64(document));
+    int n;
+    if (fseek(db->file, 0, SEEK_END) != 0) {
+        n = -1;
+    } else if (param_list && strlen(param_list) > 0) {
+        n = fprintf(db->file, "%s %s #type=%s #id=%016" PRIx64 "\n", document, param_list, type, doc_id);
+    } else {
+        n = fprintf(db->file, "%s #type=%s #id=%016" PRIx64 "\n", document, type, doc_id);
+    }
+    if (n < 0 || fflush(db->file) != 0) {
+        // Partial writes leave the table stale; force a rebuild next time
+        db->file_size = (size_t)-1;
+        noshell_handle_leave(db);
+        return FOSSIL_NOSHELL_ERROR_IO;
+    }
+    rc = noshell_durable(db->path, db->file);
+
+    noshell_doc_ref_t *ref = noshell_table_add(&st->table);
+    if (ref) {
+        ref->offset = db->file_size;
+        ref->length = (size_t)n;
+        ref->id = doc_id;
+        ref->has_id = true;
+    }
+    if (!ref || !noshell_table_commit(&st->table)) {
+        db->file_size = (size_t)-1;
+        noshell_handle_leave(db);
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    noshell_handle_stamp(db);
+
+    noshell_handle_leave(db);
+    if (out_id) *out_id = doc_id;
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_insert(
+    fossil_bluecrab_noshell_t *db,
+    const char *document,
+    const char *param_list,
+    const char *type
+) {
+    return noshell_handle_append(db, document, param_list, type, NULL);
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_insert_with_id(
+    fossil_bluecrab_noshell_t *db,
+    const char *document,
+    const char *param_list,
+    const char *type,
+    char *out_id,
+    size_t id_size
+) {
+    if (!out_id || id_size < 17)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    uint64_t doc_id = 0;
+    fossil_bluecrab_noshell_error_t rc = noshell_handle_append(db, document, param_list, type, &doc_id);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+        snprintf(out_id, id_size, "%016" PRIx64, doc_id);
+    return rc;
+}
+
+/**
+ * Batch insert works in two passes over the documents: validate, hash and
+ * measure each one, then, once line offsets are known and each hash has
+ * been turned into a free id under the handle, format every line into its
+ * slot of one buffer. Both passes split the batch across worker
+ * threads when it is large enough to pay for them.
+ */
+#define NOSHELL_BATCH_PARALLEL_MIN 4096
+#define NOSHELL_BATCH_THREADS      4
+
+typedef struct {
+    const char *const *documents;
+    size_t        begin;
+    size_t        end;
+    uint64_t     *ids;
+    size_t       *lengths;      // document lengths
+    bool          valid;
+    // Formatting pass
+    char         *out;
+    const size_t *starts;       // line offsets in out
+    const char   *params;       // param_list, or ""
+    size_t        params_len;
+    const char   *type;
+    size_t        type_len;
+} noshell_batch_part_t;
+
+static void noshell_batch_measure(noshell_batch_part_t *part) {
+    part->valid = true;
+    for (size_t i = part->begin; i < part->end; ++i) {
+        const char *doc = part->documents[i];
+        if (!doc || !noshell_is_document(doc)) {
+            part->valid = false;
+            return;
+        }
+        part->lengths[i] = strlen(doc);
+        part->ids[i] = fossil_bluecrab_hash64_legacy(doc, part->lengths[i]);
+    }
+}
+
+/** "<document>[ <params>] #type=<type> #id=<16 hex>\n", as insert writes it. */
+static void noshell_batch_format(noshell_batch_part_t *part) {
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = part->begin; i < part->end; ++i) {
+        char *p = part->out + part->starts[i];
+        memcpy(p, part->documents[i], part->lengths[i]);
+        p += part->lengths[i];
+        if (part->params_len) {
+            *p++ = ' ';
+            memcpy(p, part->params, part->params_len);
+            p += part->params_len;
+        }
+        memcpy(p, " #type=", 7);
+        p += 7;
+        memcpy(p, part->type, part->type_len);
+        p += part->type_len;
+        memcpy(p, " #id=", 5);
+        p += 5;
+        for (int shift = 60; shift >= 0; shift -= 4)
+            *p++ = hex[(part->ids[i] >> shift) & 0xF];
+        *p = '\n';
+    }
+}
+
+FOSSIL_THREAD_FN(noshell_batch_measure_worker) {
+    noshell_batch_measure((noshell_batch_part_t *)arg);
+    FOSSIL_THREAD_RETURN;
+}
+
+FOSSIL_THREAD_FN(noshell_batch_format_worker) {
+    noshell_batch_format((noshell_batch_part_t *)arg);
+    FOSSIL_THREAD_RETURN;
+}
+
+/**
+ * Runs one pass over parts[0..n): parts 1.. on worker threads, part 0 (and
+ * any part whose thread failed to start) on the caller.
+ */
+static void noshell_batch_run(noshell_batch_part_t *parts, size_t n, bool format) {
+    fossil_bluecrab_thread_t threads[NOSHELL_BATCH_THREADS];
+    bool started[NOSHELL_BATCH_THREADS] = {false};
+    for (size_t i = 1; i < n; ++i) {
+        started[i] = fossil_bluecrab_thread_start(&threads[i], format ? noshell_batch_format_worker : noshell_batch_measure_worker, &parts[i]);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (i == 0 || !started[i]) {
+            if (format) noshell_batch_format(&parts[i]);
+            else noshell_batch_measure(&parts[i]);
+        }
+    }
+    for (size_t i = 1; i < n; ++i) {
+        if (started[i]) fossil_bluecrab_thread_join(threads[i]);
+    }
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_insert_many(
+    fossil_bluecrab_noshell_t *db,
+    const char *const *documents,
+    size_t count,
+    const char *param_list,
+    const char *type,
+    char (*out_ids)[17]
+) {
+    if (!documents || !type)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    if (!noshell_type_valid(type))
+        return FOSSIL_NOSHELL_ERROR_INVALID_TYPE;
+    if (!db || !db->is_open)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    if (count == 0)
+        return FOSSIL_NOSHELL_ERROR_SUCCESS;
+
+    uint64_t *ids = (uint64_t *)malloc(count * sizeof(*ids));
+    size_t *lengths = (size_t *)malloc(count * sizeof(*lengths));
+    size_t *starts = (size_t *)malloc((count + 1) * sizeof(*starts));
+    if (!ids || !lengths || !starts) {
+        free(ids);
+        free(lengths);
+        free(starts);
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    }
+
+    noshell_batch_part_t parts[NOSHELL_BATCH_THREADS];
+    size_t part_count = count >= NOSHELL_BATCH_PARALLEL_MIN ? NOSHELL_BATCH_THREADS : 1;
+    for (size_t i = 0; i < part_count; ++i) {
+        noshell_batch_part_t *part = &parts[i];
+        memset(part, 0, sizeof(*part));
+        part->documents = documents;
+        part->begin = count * i / part_count;
+        part->end = count * (i + 1) / part_count;
+        part->ids = ids;
+        part->lengths = lengths;
+        part->starts = starts;
+        part->params = param_list ? param_list : "";
+        part->params_len = strlen(part->params);
+        part->type = type;
+        part->type_len = strlen(type);
+    }
+
+    // Nothing is written unless every document passes
+    noshell_batch_run(parts, part_count, false);
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    for (size_t i = 0; i < part_count; ++i) {
+        if (!parts[i].valid)
+            rc = FOSSIL_NOSHELL_ERROR_INVALID_TYPE;
+    }
+
+    char *out = NULL;
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        size_t fixed = (parts[0].params_len ? parts[0].params_len + 1 : 0) + 7 + parts[0].type_len + 5 + 16 + 1;
+        starts[0] = 0;
+        for (size_t i = 0; i < count; ++i)
+            starts[i + 1] = starts[i] + lengths[i] + fixed;
+        out = (char *)malloc(starts[count]);
+        if (!out)
+            rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+        rc = noshell_handle_enter(db);
+
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        // Ids are claimed in batch order, so a later copy sees an earlier one's
+        noshell_handle_state_t *st = (noshell_handle_state_t *)db->state;
+        uint64_t base = db->file_size;
+        for (size_t i = 0; i < count; ++i) {
+            ids[i] = noshell_table_free_id(&st->table, ids[i]);
+            noshell_doc_ref_t *ref = noshell_table_add(&st->table);
+            if (ref) {
+                ref->offset = base + starts[i];
+                ref->length = starts[i + 1] - starts[i];
+                ref->id = ids[i];
+                ref->has_id = true;
+            }
+            if (!ref || !noshell_table_commit(&st->table)) {
+                rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+        }
+        bool written = false;
+        if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+            for (size_t i = 0; i < part_count; ++i)
+                parts[i].out = out;
+            noshell_batch_run(parts, part_count, true);
+            written = fseek(db->file, 0, SEEK_END) == 0 &&
+                      fwrite(out, 1, starts[count], db->file) == starts[count] &&
+                      fflush(db->file) == 0;
+            rc = written ? noshell_durable(db->path, db->file) : FOSSIL_NOSHELL_ERROR_IO;
+        }
+        // The table already lists the batch; without the write it is stale
+        if (written)
+            noshell_handle_stamp(db);
+        else
+            db->file_size = (size_t)-1;
+        noshell_handle_leave(db);
+    }
+
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && out_ids) {
+        for (size_t i = 0; i < count; ++i)
+            snprintf(out_ids[i], sizeof(out_ids[i]), "%016" PRIx64, ids[i]);
+    }
+    free(out);
+    free(ids);
+    free(lengths);
+    free(starts);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_find(
+    fossil_bluecrab_noshell_t *db,
+    const char *query,
+    char *result,
+    size_t buffer_size,
+    const char *type_id
+) {
+    if (!query || !result || buffer_size == 0)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    if (type_id && strlen(type_id) > 0 && !noshell_type_valid(type_id))
+        return FOSSIL_NOSHELL_ERROR_INVALID_TYPE;
+
+    noshell_matcher_t matcher;
+    fossil_bluecrab_noshell_error_t rc = noshell_matcher_init(&matcher, query);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+    rc = noshell_handle_enter(db);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_matcher_free(&matcher);
+        return rc;
+    }
+    noshell_handle_state_t *st = (noshell_handle_state_t *)db->state;
+
+    char type_tag[32] = {0};
+    if (type_id && strlen(type_id) > 0)
+        snprintf(type_tag, sizeof(type_tag), "#type=%s", type_id);
+
+    rc = noshell_index_find(db->path, db->file, &matcher, type_tag, result, buffer_size);
+    if (rc != FOSSIL_NOSHELL_ERROR_UNSUPPORTED) {
+        noshell_handle_leave(db);
+        noshell_matcher_free(&matcher);
+        return rc;
+    }
+
+    noshell_tombs_t tombs;
+    rc = noshell_tombs_load(db->path, db->file, &tombs);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_handle_leave(db);
+        noshell_matcher_free(&matcher);
+        return rc;
+    }
+
+    rc = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    fseek(db->file, 0, SEEK_SET);
+    uint64_t offset = 0;
+    size_t len;
+    while ((len = noshell_getline(db->file, &st->line, &st->line_cap)) > 0) {
+        uint64_t at = offset;
+        offset += len;
+        if (st->line[0] == '#' || !noshell_is_document(st->line) || noshell_tombs_has(&tombs, at))
+            continue;
+        if (!noshell_matcher_test(&matcher, st->line))
+            continue;
+        if (type_tag[0] && !strstr(st->line, type_tag))
+            continue;
+        strncpy(result, st->line, buffer_size - 1);
+        result[buffer_size - 1] = '\0';
+        rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+        break;
+    }
+    noshell_tombs_free(&tombs);
+    noshell_handle_leave(db);
+    noshell_matcher_free(&matcher);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_find_cb(
+    fossil_bluecrab_noshell_t *db,
+    bool (*cb)(const char *document, void *userdata),
+    void *userdata
+) {
+    if (!cb)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    fossil_bluecrab_noshell_error_t rc = noshell_handle_enter(db);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+    noshell_handle_state_t *st = (noshell_handle_state_t *)db->state;
+    noshell_tombs_t tombs;
+    rc = noshell_tombs_load(db->path, db->file, &tombs);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_handle_leave(db);
+        return rc;
+    }
+
+    rc = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    fseek(db->file, 0, SEEK_SET);
+    uint64_t offset = 0;
+    size_t len;
+    while ((len = noshell_getline(db->file, &st->line, &st->line_cap)) > 0) {
+        uint64_t at = offset;
+        offset += len;
+        if (!noshell_is_document(st->line) || noshell_tombs_has(&tombs, at))
+            continue;
+        if (cb(st->line, userdata)) {
+            rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+            break;
+        }
+    }
+    noshell_tombs_free(&tombs);
+    noshell_handle_leave(db);
+    return rc;
+}
+
+/**
+ * update/remove through an entered handle: noshell_tomb_apply on the
+ * handle's stream, with the document table rebuilt from the same pass.
+ */
+static fossil_bluecrab_noshell_error_t noshell_handle_retire(
+    fossil_bluecrab_noshell_t *db,
+    const noshell_matcher_t *matcher,
+    const char *type_tag,
+    const char *new_body
+) {
+    noshell_handle_state_t *st = (noshell_handle_state_t *)db->state;
+    noshell_table_reset(&st->table);
+    bool compact = false;
+    fossil_bluecrab_noshell_error_t rc = noshell_tomb_apply(db->path, db->file, matcher, type_tag, new_body,
+                                                            noshell_table_keep, &st->table, &compact);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS || rc == FOSSIL_NOSHELL_ERROR_NOT_FOUND) {
+        noshell_handle_stamp(db);
+    } else {
+        // Table was partly rebuilt; reload on next entry
+        db->file_size = (size_t)-1;
+    }
+    if (compact)
+        noshell_handle_compact(db);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_update(
+    fossil_bluecrab_noshell_t *db,
+    const char *query,
+    const char *new_document,
+    const char *param_list,
+    const char *type_id
+) {
+    if (!query || !new_document)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    bool has_type = type_id && strlen(type_id) > 0;
+    if (has_type && !noshell_type_valid(type_id))
+        return FOSSIL_NOSHELL_ERROR_INVALID_TYPE;
+    if (!noshell_is_document(new_document))
+        return FOSSIL_NOSHELL_ERROR_INVALID_TYPE;
+
+    char type_tag[32] = {0};
+    if (has_type)
+        snprintf(type_tag, sizeof(type_tag), "#type=%s", type_id);
+
+    noshell_matcher_t matcher;
+    fossil_bluecrab_noshell_error_t rc = noshell_matcher_init(&matcher, query);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+    // Same new version as fossil_bluecrab_noshell_update
+    char *body = noshell_version_body(new_document, param_list, type_id);
+    rc = body ? noshell_handle_enter(db) : FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        rc = noshell_handle_retire(db, &matcher, type_tag, body);
+        noshell_handle_leave(db);
+    }
+    free(body);
+    noshell_matcher_free(&matcher);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_remove(fossil_bluecrab_noshell_t *db, const char *query) {
+    if (!query)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_matcher_t matcher;
+    fossil_bluecrab_noshell_error_t rc = noshell_matcher_init(&matcher, query);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+    rc = noshell_handle_enter(db);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        rc = noshell_handle_retire(db, &matcher, "", NULL);
+        noshell_handle_leave(db);
+    }
+    noshell_matcher_free(&matcher);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_first_document(fossil_bluecrab_noshell_t *db, char *id_buffer, size_t buffer_size) {
+    if (!id_buffer || buffer_size < 17)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    fossil_bluecrab_noshell_error_t rc = noshell_handle_enter(db);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+    noshell_handle_state_t *st = (noshell_handle_state_t *)db->state;
+
+    size_t first = noshell_table_next(&st->table, NOSHELL_NO_DOC);
+    rc = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    if (first != NOSHELL_NO_DOC) {
+        snprintf(id_buffer, buffer_size, "%016" PRIx64, st->table.docs[first].id);
+        rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    }
+    noshell_handle_leave(db);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_next_document(
+    fossil_bluecrab_noshell_t *db,
+    const char *prev_id,
+    char *id_buffer,
+    size_t buffer_size
+) {
+    if (!prev_id || !id_buffer || buffer_size < 17)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    uint64_t prev = noshell_parse_id(prev_id);
+
+    fossil_bluecrab_noshell_error_t rc = noshell_handle_enter(db);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+    noshell_handle_state_t *st = (noshell_handle_state_t *)db->state;
+
+    // Map lookup plus a step forward; the file is not touched
+    size_t at = noshell_table_find(&st->table, prev);
+    size_t next = at == NOSHELL_NO_DOC ? NOSHELL_NO_DOC : noshell_table_next(&st->table, at);
+    rc = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    if (next != NOSHELL_NO_DOC) {
+        snprintf(id_buffer, buffer_size, "%016" PRIx64, st->table.docs[next].id);
+        rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    }
+    noshell_handle_leave(db);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_count_documents(fossil_bluecrab_noshell_t *db, size_t *count) {
+    if (!count)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    fossil_bluecrab_noshell_error_t rc = noshell_handle_enter(db);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+    noshell_handle_state_t *st = (noshell_handle_state_t *)db->state;
+    *count = st->table.id_count;
+    noshell_handle_leave(db);
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_handle_find_by_id(
+    fossil_bluecrab_noshell_t *db,
+    const char *id,
+    char *result,
+    size_t buffer_size
+) {
+    if (!id || !result || buffer_size == 0)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    fossil_bluecrab_noshell_error_t rc = noshell_handle_enter(db);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+    noshell_handle_state_t *st = (noshell_handle_state_t *)db->state;
+
+    size_t at = noshell_table_find(&st->table, noshell_parse_id(id));
+    rc = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    if (at != NOSHELL_NO_DOC &&
+        fseek(db->file, (long)st->table.docs[at].offset, SEEK_SET) == 0 &&
+        noshell_getline(db->file, &st->line, &st->line_cap) > 0) {
+        strncpy(result, st->line, buffer_size - 1);
+        result[buffer_size - 1] = '\0';
+        rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    }
+    noshell_handle_leave(db);
+    return rc;
+}
+
+// ===========================================================
+// Document Id Index (file-name API)
+// ===========================================================
+
+/**
+ * The file-name functions have no handle to keep a table in, so the file's
+ * registry entry caches one (under the entry mutex; see "Per-File State").
+ * It is rebuilt lazily when the file's size or mtime changed or when a
+ * write through this library was counted since it was built. If a handle
+ * is open on the path, its table is used instead.
+ */
+struct noshell_id_cache_t {
+    size_t   file_size;
+    time_t   last_modified;
+    uint64_t writes;                       // registry write count when built
+    bool     valid;
+    noshell_doc_table_t table;
+};
+
+static void noshell_id_cache_free(noshell_id_cache_t *c) {
+    if (!c) return;
+    noshell_table_free(&c->table);
+    free(c);
+}
+
+/**
+ * Returns an open handle on file_name with an extra reference, or NULL.
+ */
+static fossil_bluecrab_noshell_t *noshell_handle_borrow(const char *file_name) {
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f)
+        return NULL;
+    fossil_bluecrab_thread_mutex_lock(&f->mutex);
+    fossil_bluecrab_noshell_t *db = f->handle;
+    if (db)
+        db->refs++;
+    fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+    noshell_file_release(f);
+    return db;
+}
+
+/**
+ * Brings the id cache of f up to date with the file and returns it. Call
+ * with the entry mutex held.
+ */
+static fossil_bluecrab_noshell_error_t noshell_id_cache_get(noshell_file_t *f, noshell_id_cache_t **out) {
+    struct stat sb;
+    if (stat(f->key, &sb) != 0)
+        return FOSSIL_NOSHELL_ERROR_IO;
+    if (!f->ids && !(f->ids = (noshell_id_cache_t *)calloc(1, sizeof(*f->ids))))
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    noshell_id_cache_t *c = f->ids;
+
+    uint64_t writes;
+    noshell_file_counters(f, &writes, NULL);
+    if (!c->valid || c->writes != writes || (size_t)sb.st_size != c->file_size || sb.st_mtime != c->last_modified) {
+        FILE *fp = fopen(f->key, "rb");
+        if (!fp)
+            return FOSSIL_NOSHELL_ERROR_IO;
+        char *line = NULL;
+        size_t cap = 0;
+        noshell_tombs_t tombs;
+        fossil_bluecrab_noshell_error_t rc = noshell_tombs_load(f->key, fp, &tombs);
+        if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+            rc = noshell_table_load(&c->table, fp, &line, &cap, false, &tombs);
+        noshell_tombs_free(&tombs);
+        free(line);
+        fclose(fp);
+        c->valid = rc == FOSSIL_NOSHELL_ERROR_SUCCESS;
+        if (!c->valid)
+            return rc;
+        c->file_size = (size_t)sb.st_size;
+        c->last_modified = sb.st_mtime;
+        c->writes = writes;
+    }
+    *out = c;
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+static fossil_bluecrab_noshell_error_t noshell_path_step(const char *file_name, const char *prev_id, char *id_buffer, size_t buffer_size) {
+    noshell_lsm_t *lsm;
+    fossil_bluecrab_noshell_error_t routed = noshell_lsm_acquire(file_name, &lsm);
+    if (lsm) {
+        routed = noshell_lsm_step(lsm, prev_id, id_buffer, buffer_size);
+        noshell_lsm_release(lsm);
+    }
+    if (lsm || routed != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return routed;
+
+    fossil_bluecrab_noshell_t *db = noshell_handle_borrow(file_name);
+    if (db) {
+        fossil_bluecrab_noshell_error_t rc = prev_id
+            ? fossil_bluecrab_noshell_handle_next_document(db, prev_id, id_buffer, buffer_size)
+            : fossil_bluecrab_noshell_handle_first_document(db, id_buffer, buffer_size);
+        fossil_bluecrab_noshell_close(db);
+        return rc;
+    }
+
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_thread_mutex_lock(&f->mutex);
+    noshell_id_cache_t *c = NULL;
+    fossil_bluecrab_noshell_error_t rc = noshell_id_cache_get(f, &c);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        size_t at = NOSHELL_NO_DOC;
+        if (prev_id) {
+            at = noshell_table_find(&c->table, noshell_parse_id(prev_id));
+        }
+        size_t next = (prev_id && at == NOSHELL_NO_DOC) ? NOSHELL_NO_DOC : noshell_table_next(&c->table, at);
+        rc = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+        if (next != NOSHELL_NO_DOC) {
+            snprintf(id_buffer, buffer_size, "%016" PRIx64, c->table.docs[next].id);
+            rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+        }
+    }
+    fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+    noshell_file_release(f);
+    return rc;
+}
+
+static fossil_bluecrab_noshell_error_t noshell_path_find_by_id(const char *file_name, const char *id, char *result, size_t buffer_size) {
+    noshell_lsm_t *lsm;
+    fossil_bluecrab_noshell_error_t routed = noshell_lsm_acquire(file_name, &lsm);
+    if (lsm) {
+        routed = noshell_lsm_find_by_id(lsm, id, result, buffer_size);
+        noshell_lsm_release(lsm);
+    }
+    if (lsm || routed != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return routed;
+
+    fossil_bluecrab_noshell_t *db = noshell_handle_borrow(file_name);
+    if (db) {
+        fossil_bluecrab_noshell_error_t rc = fossil_bluecrab_noshell_handle_find_by_id(db, id, result, buffer_size);
+        fossil_bluecrab_noshell_close(db);
+        return rc;
+    }
+
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_thread_mutex_lock(&f->mutex);
+    noshell_id_cache_t *c = NULL;
+    fossil_bluecrab_noshell_error_t rc = noshell_id_cache_get(f, &c);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        size_t at = noshell_table_find(&c->table, noshell_parse_id(id));
+        rc = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+        FILE *fp = at == NOSHELL_NO_DOC ? NULL : fopen(f->key, "rb");
+        if (fp) {
+            char *line = NULL;
+            size_t cap = 0;
+            if (fseek(fp, (long)c->table.docs[at].offset, SEEK_SET) == 0 && noshell_getline(fp, &line, &cap) > 0) {
+                strncpy(result, line, buffer_size - 1);
+                result[buffer_size - 1] = '\0';
+                rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+            }
+            free(line);
+            fclose(fp);
+        }
+    }
+    fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+    noshell_file_release(f);
+    return rc;
+}
+
+/**
+ * Text-mode insert by file name with *id (the content hash) moved on to a
+ * free id, which is written back. An open handle appends and claims the id
+ * against its table. Otherwise the registry's id cache is used, and takes
+ * the new line afterwards when nothing else wrote in between, so a run of
+ * inserts does not rebuild it each time. The entry mutex is held from the
+ * claim until the line is in the cache, so concurrent inserts of equal
+ * documents cannot claim the same id. A file that cannot be read yet holds
+ * no ids; the append then creates it or fails.
+ */
+static fossil_bluecrab_noshell_error_t noshell_path_append(const char *file_name, const char *document, const char *param_list, const char *type, uint64_t *id) {
+    fossil_bluecrab_noshell_t *db = noshell_handle_borrow(file_name);
+    if (db) {
+        fossil_bluecrab_noshell_error_t rc = noshell_handle_append(db, document, param_list, type, id);
+        fossil_bluecrab_noshell_close(db);
+        return rc;
+    }
+
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_thread_mutex_lock(&f->mutex);
+    noshell_id_cache_t *c = NULL;
+    fossil_bluecrab_noshell_error_t rc = noshell_id_cache_get(f, &c);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS && rc != FOSSIL_NOSHELL_ERROR_IO) {
+        fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+        noshell_file_release(f);
+        return rc;
+    }
+    bool claimed = rc == FOSSIL_NOSHELL_ERROR_SUCCESS;
+    uint64_t stamp = 0;
+    size_t base = 0;
+    if (claimed) {
+        *id = noshell_table_free_id(&c->table, *id);
+        stamp = c->writes;
+        base = c->file_size;
+    }
+
+    FILE *fp = fopen(file_name, "a");
+    if (!fp) {
+        fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+        noshell_file_release(f);
+        return FOSSIL_NOSHELL_ERROR_IO;
+    }
+    int n = param_list && strlen(param_list) > 0
+        ? fprintf(fp, "%s %s #type=%s #id=%016" PRIx64 "\n", document, param_list, type, *id)
+        : fprintf(fp, "%s #type=%s #id=%016" PRIx64 "\n", document, type, *id);
+    bool written = n > 0 && fflush(fp) == 0;
+    rc = written ? noshell_durable_locked(f, fp) : FOSSIL_NOSHELL_ERROR_IO;
+    fclose(fp);
+
+    if (written && claimed) {
+        uint64_t writes;
+        noshell_file_counters(f, &writes, NULL);
+        struct stat sb;
+        c = f->ids;
+        if (c && c->valid && c->writes == stamp && writes == stamp + 1 &&
+            stat(f->key, &sb) == 0 && (size_t)sb.st_size == base + (size_t)n) {
+            noshell_doc_ref_t *ref = noshell_table_add(&c->table);
+            if (ref) {
+                ref->offset = base;
+                ref->length = (size_t)n;
+                ref->id = *id;
+                ref->has_id = true;
+            }
+            if (ref && noshell_table_commit(&c->table)) {
+                c->writes = writes;
+                c->file_size = (size_t)sb.st_size;
+                c->last_modified = sb.st_mtime;
+            } else {
+                c->valid = false;
+            }
+        }
+    }
+    fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+    noshell_file_release(f);
+    return rc;
+}
+
+// ===========================================================
+// Cursors
+// ===========================================================
+
+/**
+ * A cursor owns its own FILE (so its position survives between calls) and
+ * an arena the current batch of lines is read into. Views handed out point
+ * into the arena; line starts are kept as offsets while reading because the
+ * arena may move as it grows.
+ */
+struct fossil_bluecrab_noshell_cursor_t {
+    FILE   *file;
+    char   *read_buf;           // installed on file with setvbuf
+    char   *arena;
+    size_t  arena_cap;
+    size_t *starts;             // arena offset of each line in the batch
+    size_t  starts_cap;
+    char    type[32];           // filter, "" = all types
+    noshell_tombs_t tombs;      // as of open
+    uint64_t offset;            // of the next line read
+    bool    at_end;
+};
+
+/**
+ * Splits a document line in place into its views: the document is
+ * everything before the first " #type=" / " #id=" tag (param_list
+ * included), type and id are the tag values. Missing tags give empty
+ * views.
+ */
+static void noshell_cursor_split(char *line, size_t len, fossil_bluecrab_noshell_entry_t *entry) {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        line[--len] = '\0';
+
+    const char *type_tag = strstr(line, "#type=");
+    const char *id_tag = strstr(line, "#id=");
+    const char *end = line + len;
+    if (type_tag && type_tag < end) end = type_tag;
+    if (id_tag && id_tag < end) end = id_tag;
+    while (end > line && isspace((unsigned char)end[-1]))
+        end--;
+
+    entry->document.data = line;
+    entry->document.length = (size_t)(end - line);
+
+    entry->type.data = "";
+    entry->type.length = 0;
+    if (type_tag) {
+        entry->type.data = type_tag + 6;
+        entry->type.length = strcspn(type_tag + 6, " \t");
+    }
+
+    entry->id.data = "";
+    entry->id.length = 0;
+    if (id_tag) {
+        entry->id.data = id_tag + 4;
+        entry->id.length = strcspn(id_tag + 4, " \t");
+    }
+}
+
+fossil_bluecrab_noshell_cursor_t *fossil_bluecrab_noshell_cursor_open(
+    const char *file_name,
+    const char *type_id,
+    fossil_bluecrab_noshell_error_t *err
+) {
+    if (!file_name || !fossil_bluecrab_noshell_validate_extension(file_name)) {
+        if (err) *err = FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+        return NULL;
+    }
+    if (type_id && strlen(type_id) > 0 && !noshell_type_valid(type_id)) {
+        if (err) *err = FOSSIL_NOSHELL_ERROR_INVALID_TYPE;
+        return NULL;
+    }
+    if (noshell_lsm_enabled(file_name)) {
+        if (err) *err = FOSSIL_NOSHELL_ERROR_UNSUPPORTED;
+        return NULL;
+    }
+
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_noshell_cursor_t *cur = (fossil_bluecrab_noshell_cursor_t *)calloc(1, sizeof(*cur));
+    if (cur && (cur->read_buf = (char *)malloc(NOSHELL_READ_BUFFER)) != NULL) {
+        cur->file = fopen(file_name, "rb");
+        rc = cur->file ? FOSSIL_NOSHELL_ERROR_SUCCESS : FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND;
+    }
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        fossil_bluecrab_noshell_cursor_close(cur);
+        if (err) *err = rc;
+        return NULL;
+    }
+
+    setvbuf(cur->file, cur->read_buf, _IOFBF, NOSHELL_READ_BUFFER);
+    rc = noshell_tombs_load(file_name, cur->file, &cur->tombs);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS || fseek(cur->file, 0, SEEK_SET) != 0) {
+        fossil_bluecrab_noshell_cursor_close(cur);
+        if (err) *err = rc != FOSSIL_NOSHELL_ERROR_SUCCESS ? rc : FOSSIL_NOSHELL_ERROR_IO;
+        return NULL;
+    }
+    if (type_id)
+        snprintf(cur->type, sizeof(cur->type), "%s", type_id);
+    if (err) *err = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    return cur;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_cursor_next_batch(
+    fossil_bluecrab_noshell_cursor_t *cur,
+    fossil_bluecrab_noshell_entry_t *entries,
+    size_t max_entries,
+    size_t *fetched
+) {
+    if (fetched) *fetched = 0;
+    if (!cur || !entries || max_entries == 0)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    if (cur->starts_cap < max_entries) {
+        size_t *grown = (size_t *)realloc(cur->starts, max_entries * sizeof(size_t));
+        if (!grown)
+            return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        cur->starts = grown;
+        cur->starts_cap = max_entries;
+    }
+
+    // Read lines back to back into the arena; the previous batch's views
+    // are invalidated here
+    size_t used = 0, n = 0;
+    while (n < max_entries && !cur->at_end) {
+        size_t len = noshell_getline_at(cur->file, &cur->arena, &cur->arena_cap, used);
+        if (len == 0) {
+            cur->at_end = true;
+            break;
+        }
+        char *line = cur->arena + used;
+        uint64_t at = cur->offset;
+        cur->offset += len;
+        if (line[0] == '#' || !noshell_is_document(line) || noshell_tombs_has(&cur->tombs, at))
+            continue;
+        if (cur->type[0]) {
+            const char *tag = strstr(line, "#type=");
+            size_t type_len = strlen(cur->type);
+            if (!tag || strncmp(tag + 6, cur->type, type_len) != 0 ||
+                (tag[6 + type_len] != '\0' && !isspace((unsigned char)tag[6 + type_len])))
+                continue;
+        }
+        cur->starts[n++] = used;
+        used += len + 1;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        char *line = cur->arena + cur->starts[i];
+        noshell_cursor_split(line, strlen(line), &entries[i]);
+    }
+    if (fetched) *fetched = n;
+    return n > 0 ? FOSSIL_NOSHELL_ERROR_SUCCESS : FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_cursor_next(
+    fossil_bluecrab_noshell_cursor_t *cur,
+    fossil_bluecrab_noshell_entry_t *entry
+) {
+    return fossil_bluecrab_noshell_cursor_next_batch(cur, entry, 1, NULL);
+}
+
+void fossil_bluecrab_noshell_cursor_close(fossil_bluecrab_noshell_cursor_t *cur) {
+    if (!cur) return;
+    if (cur->file)
+        fclose(cur->file);
+    free(cur->read_buf);
+    free(cur->arena);
+    free(cur->starts);
+    noshell_tombs_free(&cur->tombs);
+    free(cur);
+}
+
+// ===========================================================
+// Secondary Field Indexes
+// ===========================================================
+
+/*
+ * Indexes are kept in memory in the file's registry entry (under its
+ * mutex; see "Per-File State"), for the life of the process, and
+ * map the value of one document field (see noshell_field_value) to the
+ * offsets of the lines carrying it. All indexes of a path share one scan
+ * position:
+ *
+ *   - appends (insert, and update/remove, which only append tombstones and
+ *     new versions) are picked up incrementally: when the file has only
+ *     grown and the last line indexed is still where it was (checked by
+ *     hash), only the new tail is read;
+ *   - rewrites (create, delete, restore, compaction) are counted by
+ *     noshell_file_invalidate and, like any other change the tail check
+ *     catches, make the next use rebuild from scratch.
+ *
+ * Entries of lines retired by a tombstone stay until the next rebuild;
+ * candidates are checked against the tombstone set.
+ *
+ * Entry values are classified like query literals: numbers compare
+ * numerically, everything else bytewise. Hash indexes key numbers by
+ * their normalized text, so 31, 31.0 and 031 share a chain; ordered
+ * indexes keep numbers before all other values. Text indexes map every
+ * byte trigram of the field (or of the whole line for "*") to a
+ * compressed posting list of document ordinals; a substring, LIKE run or
+ * string equality is answered by intersecting the lists of its trigrams.
+ * All kinds only narrow the candidates; every candidate line is re-read
+ * and the full query evaluated on it, so results are the same as a scan.
+ */
+
+typedef struct noshell_index_entry_t {
+    char     *value;                       // field text, quotes stripped
+    uint64_t  offset;                      // start of the document line
+    uint64_t  hash;                        // of the normalized value
+    bool      numeric;
+    bool      integral;
+    long long ival;
+    double    dval;
+    struct noshell_index_entry_t *chain;   // hash bucket chain
+} noshell_index_entry_t;
+
+/**
+ * Posting list of a text index: the ordinals of the documents containing
+ * one trigram, ascending, stored as LEB128 varints of the gaps.
+ */
+typedef struct {
+    uint32_t gram;                         // trigram + 1, 0 = empty slot
+    uint32_t count;                        // ordinals in the list
+    uint32_t last;                         // last ordinal appended
+    uint8_t *bytes;
+    size_t   len;
+    size_t   cap;
+} noshell_posting_t;
+
+typedef struct {
+    uint64_t *docs;                        // ordinal -> line offset
+    size_t    doc_count;
+    size_t    doc_cap;
+    noshell_posting_t *grams;              // open addressing, power of two
+    size_t    gram_slots;
+    size_t    gram_count;
+} noshell_text_index_t;
+
+typedef struct noshell_index_t {
+    char *field;                           // "*" (TEXT only) = whole line
+    fossil_bluecrab_noshell_index_kind_t kind;
+    noshell_index_entry_t **entries;       // HASH/ORDERED: owned, in file order
+    size_t count;
+    size_t cap;
+    noshell_index_entry_t **buckets;       // HASH: power of two
+    size_t bucket_count;
+    noshell_index_entry_t **order;         // ORDERED: sorted by value
+    size_t order_cap;
+    noshell_text_index_t text;             // TEXT
+    struct noshell_index_t *next;
+} noshell_index_t;
+
+struct noshell_index_set_t {
+    noshell_index_t *indexes;
+    size_t   file_size;                    // bytes indexed
+    time_t   last_modified;
+    uint64_t writes;                       // registry write count when refreshed
+    uint64_t tail_offset;                  // last line indexed
+    uint64_t tail_hash;
+    bool     has_tail;
+    bool     stale;
+};
+
+/** Number-aware classification shared by entries and query literals. */
+static void noshell_index_classify(noshell_index_entry_t *e, const char *value, size_t len) {
+    char number[64];
+    e->numeric = false;
+    if (len > 0 && len < sizeof(number)) {
+        memcpy(number, value, len);
+        number[len] = '\0';
+        e->numeric = fossil_bluecrab_query_parse_number(number, &e->integral, &e->ival, &e->dval);
+    }
+    if (e->numeric) {
+        if (!e->integral && e->dval >= -9.0e15 && e->dval <= 9.0e15 && e->dval == (double)(long long)e->dval) {
+            e->integral = true;
+            e->ival = (long long)e->dval;
+        }
+        char norm[64];
+        int n = e->integral ? snprintf(norm, sizeof(norm), "%lld", e->ival)
+                            : snprintf(norm, sizeof(norm), "%.17g", e->dval);
+        e->hash = fossil_bluecrab_hash64(norm, (size_t)n, 0);
+    } else {
+        e->hash = fossil_bluecrab_hash64(value, len, 0);
+    }
+}
+
+/** Orders numbers before text; numbers by value, text bytewise. */
+static int noshell_index_compare(const noshell_index_entry_t *a, const noshell_index_entry_t *b) {
+    if (a->numeric != b->numeric)
+        return a->numeric ? -1 : 1;
+    if (a->numeric) {
+        if (a->integral && b->integral)
+            return (a->ival > b->ival) - (a->ival < b->ival);
+        return (a->dval > b->dval) - (a->dval < b->dval);
+    }
+    return strcmp(a->value, b->value);
+}
+
+/** First position in idx->order whose entry is >= probe (> probe when upper). */
+static size_t noshell_index_bound(const noshell_index_t *idx, const noshell_index_entry_t *probe, bool upper) {
+    size_t lo = 0, hi = idx->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = noshell_index_compare(idx->order[mid], probe);
+        if (cmp < 0 || (upper && cmp == 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void noshell_index_clear(noshell_index_t *idx) {
+    for (size_t i = 0; i < idx->count; ++i) {
+        free(idx->entries[i]->value);
+        free(idx->entries[i]);
+    }
+    idx->count = 0;
+    if (idx->buckets)
+        memset(idx->buckets, 0, idx->bucket_count * sizeof(*idx->buckets));
+
+    noshell_text_index_t *t = &idx->text;
+    for (size_t i = 0; i < t->gram_slots; ++i)
+        free(t->grams[i].bytes);
+    free(t->grams);
+    t->grams = NULL;
+    t->gram_slots = 0;
+    t->gram_count = 0;
+    t->doc_count = 0;
+}
+
+static void noshell_index_free(noshell_index_t *idx) {
+    if (!idx) return;
+    noshell_index_clear(idx);
+    free(idx->entries);
+    free(idx->buckets);
+    free(idx->order);
+    free(idx->text.docs);
+    free(idx->field);
+    free(idx);
+}
+
+static bool noshell_index_rehash(noshell_index_t *idx) {
+    size_t bucket_count = idx->bucket_count ? idx->bucket_count * 2 : 64;
+    noshell_index_entry_t **buckets = (noshell_index_entry_t **)calloc(bucket_count, sizeof(*buckets));
+    if (!buckets)
+        return false;
+    for (size_t i = 0; i < idx->count; ++i) {
+        noshell_index_entry_t *e = idx->entries[i];
+        size_t b = (size_t)(e->hash & (bucket_count - 1));
+        e->chain = buckets[b];
+        buckets[b] = e;
+    }
+    free(idx->buckets);
+    idx->buckets = buckets;
+    idx->bucket_count = bucket_count;
+    return true;
+}
+
+static size_t noshell_gram_slot(uint32_t gram, size_t slots) {
+    return (size_t)((gram * 2654435761u) >> 7) & (slots - 1);
+}
+
+static noshell_posting_t *noshell_text_posting(const noshell_text_index_t *t, uint32_t gram) {
+    if (t->gram_slots == 0)
+        return NULL;
+    for (size_t i = noshell_gram_slot(gram, t->gram_slots);; i = (i + 1) & (t->gram_slots - 1)) {
+        if (t->grams[i].gram == gram + 1)
+            return &t->grams[i];
+        if (t->grams[i].gram == 0)
+            return NULL;
+    }
+}
+
+static bool noshell_text_grow(noshell_text_index_t *t) {
+    size_t slots = t->gram_slots ? t->gram_slots * 2 : 1024;
+    noshell_posting_t *grams = (noshell_posting_t *)calloc(slots, sizeof(*grams));
+    if (!grams)
+        return false;
+    for (size_t i = 0; i < t->gram_slots; ++i) {
+        if (t->grams[i].gram == 0)
+            continue;
+        size_t j = noshell_gram_slot(t->grams[i].gram - 1, slots);
+        while (grams[j].gram != 0) j = (j + 1) & (slots - 1);
+        grams[j] = t->grams[i];
+    }
+    free(t->grams);
+    t->grams = grams;
+    t->gram_slots = slots;
+    return true;
+}
+
+static bool noshell_posting_append(noshell_posting_t *p, uint32_t ordinal) {
+    if (p->count > 0 && p->last == ordinal)
+        return true;  // trigram repeats within the document
+    if (p->cap - p->len < 5) {
+        size_t cap = p->cap ? p->cap * 2 : 8;
+        uint8_t *grown = (uint8_t *)realloc(p->bytes, cap);
+        if (!grown)
+            return false;
+        p->bytes = grown;
+        p->cap = cap;
+    }
+    uint32_t gap = p->count > 0 ? ordinal - p->last : ordinal;
+    while (gap >= 0x80) {
+        p->bytes[p->len++] = (uint8_t)(gap | 0x80);
+        gap >>= 7;
+    }
+    p->bytes[p->len++] = (uint8_t)gap;
+    p->last = ordinal;
+    p->count++;
+    return true;
+}
+
+static uint32_t *noshell_posting_decode(const noshell_posting_t *p) {
+    uint32_t *out = (uint32_t *)malloc((p->count ? p->count : 1) * sizeof(*out));
+    if (!out)
+        return NULL;
+    uint32_t value = 0;
+    size_t at = 0;
+    for (uint32_t i = 0; i < p->count; ++i) {
+        uint32_t gap = 0;
+        int shift = 0;
+        uint8_t b;
+        do {
+            b = p->bytes[at++];
+            gap |= (uint32_t)(b & 0x7F) << shift;
+            shift += 7;
+        } while (b & 0x80);
+        value = i == 0 ? gap : value + gap;
+        out[i] = value;
+    }
+    return out;
+}
+
+/** Adds every trigram of text to the postings of a new document. */
+static bool noshell_text_add(noshell_text_index_t *t, const char *text, size_t len, uint64_t offset) {
+    if (t->doc_count == t->doc_cap) {
+        size_t cap = t->doc_cap ? t->doc_cap * 2 : 256;
+        uint64_t *grown = (uint64_t *)realloc(t->docs, cap * sizeof(*grown));
+        if (!grown)
+            return false;
+        t->docs = grown;
+        t->doc_cap = cap;
+    }
+    uint32_t ordinal = (uint32_t)t->doc_count;
+    t->docs[t->doc_count++] = offset;
+
+    for (size_t i = 0; i + 3 <= len; ++i) {
+        uint32_t gram = (uint32_t)(unsigned char)text[i] << 16 | (uint32_t)(unsigned char)text[i + 1] << 8 | (unsigned char)text[i + 2];
+        noshell_posting_t *p = noshell_text_posting(t, gram);
+        if (!p) {
+            if ((t->gram_count + 1) * 2 > t->gram_slots && !noshell_text_grow(t))
+                return false;
+            size_t j = noshell_gram_slot(gram, t->gram_slots);
+            while (t->grams[j].gram != 0) j = (j + 1) & (t->gram_slots - 1);
+            p = &t->grams[j];
+            p->gram = gram + 1;
+            t->gram_count++;
+        }
+        if (!noshell_posting_append(p, ordinal))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Intersects two ascending lists of distinct ordinals into out (which may
+ * alias a); returns the number written. Lists of very different lengths
+ * gallop through the longer one; similar lengths compare 4x4 blocks with
+ * SSE2/NEON where available.
+ */
+static size_t noshell_intersect_u32(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out) {
+    size_t i = 0, j = 0, n = 0;
+    if (na * 32 < nb || nb * 32 < na) {
+        if (na > nb) {
+            // Every write lands at or before the element of a it matched
+            for (; j < nb; ++j) {
+                size_t lo = i, hi = na;
+                while (lo < hi) {
+                    size_t mid = lo + (hi - lo) / 2;
+                    if (a[mid] < b[j]) lo = mid + 1; else hi = mid;
+                }
+                i = lo;
+                if (i < na && a[i] == b[j])
+                    out[n++] = b[j];
+            }
+            return n;
+        }
+        for (; i < na; ++i) {
+            size_t step = 1, lo = j, hi = j;
+            while (hi < nb && b[hi] < a[i]) {
+                lo = hi + 1;
+                hi += step;
+                step *= 2;
+            }
+            if (hi > nb) hi = nb;
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (b[mid] < a[i]) lo = mid + 1; else hi = mid;
+            }
+            j = lo;
+            if (j < nb && b[j] == a[i])
+                out[n++] = a[i];
+        }
+        return n;
+    }
+
+#if defined(NOSHELL_HAVE_SSE2)
+    while (i + 4 <= na && j + 4 <= nb) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+        __m128i m = _mm_cmpeq_epi32(va, vb);
+        vb = _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1));
+        m = _mm_or_si128(m, _mm_cmpeq_epi32(va, vb));
+        vb = _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1));
+        m = _mm_or_si128(m, _mm_cmpeq_epi32(va, vb));
+        vb = _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1));
+        m = _mm_or_si128(m, _mm_cmpeq_epi32(va, vb));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(m));
+        uint32_t block[4];
+        _mm_storeu_si128((__m128i *)block, va);
+        uint32_t amax = a[i + 3], bmax = b[j + 3];
+        for (int k = 0; k < 4; ++k) {
+            if (mask & (1 << k))
+                out[n++] = block[k];
+        }
+        if (amax <= bmax) i += 4;
+        if (bmax <= amax) j += 4;
+    }
+#elif defined(NOSHELL_HAVE_NEON)
+    while (i + 4 <= na && j + 4 <= nb) {
+        uint32x4_t va = vld1q_u32(a + i);
+        uint32x4_t vb = vld1q_u32(b + j);
+        uint32x4_t m = vceqq_u32(va, vb);
+        m = vorrq_u32(m, vceqq_u32(va, vextq_u32(vb, vb, 1)));
+        m = vorrq_u32(m, vceqq_u32(va, vextq_u32(vb, vb, 2)));
+        m = vorrq_u32(m, vceqq_u32(va, vextq_u32(vb, vb, 3)));
+        uint32_t block[4], hits[4];
+        vst1q_u32(block, va);
+        vst1q_u32(hits, m);
+        uint32_t amax = a[i + 3], bmax = b[j + 3];
+        for (int k = 0; k < 4; ++k) {
+            if (hits[k])
+                out[n++] = block[k];
+        }
+        if (amax <= bmax) i += 4;
+        if (bmax <= amax) j += 4;
+    }
+#endif
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            out[n++] = a[i];
+            i++;
+            j++;
+        }
+    }
+    return n;
+}
+
+static int noshell_posting_count_cmp(const void *a, const void *b) {
+    uint32_t x = (*(noshell_posting_t *const *)a)->count, y = (*(noshell_posting_t *const *)b)->count;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Ordinals of the documents containing every trigram of needle, shortest
+ * posting list first. needle must be at least 3 bytes.
+ */
+static bool noshell_text_lookup(const noshell_text_index_t *t, const char *needle, size_t len, uint32_t **out, size_t *count) {
+    size_t ngrams = len - 2;
+    noshell_posting_t **lists = (noshell_posting_t **)malloc(ngrams * sizeof(*lists));
+    if (!lists)
+        return false;
+    size_t nlists = 0;
+    for (size_t i = 0; i < ngrams; ++i) {
+        uint32_t gram = (uint32_t)(unsigned char)needle[i] << 16 | (uint32_t)(unsigned char)needle[i + 1] << 8 | (unsigned char)needle[i + 2];
+        noshell_posting_t *p = noshell_text_posting(t, gram);
+        if (!p) {
+            free(lists);
+            *out = NULL;
+            *count = 0;
+            return true;  // a trigram no document has
+        }
+        bool seen = false;
+        for (size_t k = 0; k < nlists && !seen; ++k) seen = lists[k] == p;
+        if (!seen)
+            lists[nlists++] = p;
+    }
+    qsort(lists, nlists, sizeof(*lists), noshell_posting_count_cmp);
+
+    uint32_t *acc = noshell_posting_decode(lists[0]);
+    size_t n = acc ? lists[0]->count : 0;
+    for (size_t k = 1; acc && k < nlists && n > 0; ++k) {
+        uint32_t *next = noshell_posting_decode(lists[k]);
+        if (!next) {
+            free(acc);
+            acc = NULL;
+            break;
+        }
+        n = noshell_intersect_u32(acc, n, next, lists[k]->count, acc);
+        free(next);
+    }
+    free(lists);
+    if (!acc)
+        return false;
+    *out = acc;
+    *count = n;
+    return true;
+}
+
+/** Indexes the field of one document line, if the line has it. */
+static bool noshell_index_add(noshell_index_t *idx, const char *line, uint64_t offset) {
+    const char *value;
+    size_t len;
+    if (idx->kind == FOSSIL_NOSHELL_INDEX_TEXT && strcmp(idx->field, "*") == 0) {
+        len = strcspn(line, "\r\n");
+        return noshell_text_add(&idx->text, line, len, offset);
+    }
+    if (!noshell_field_value(line, idx->field, &value, &len))
+        return true;
+    if (idx->kind == FOSSIL_NOSHELL_INDEX_TEXT)
+        return noshell_text_add(&idx->text, value, len, offset);
+
+    if (idx->count == idx->cap) {
+        size_t cap = idx->cap ? idx->cap * 2 : 64;
+        noshell_index_entry_t **grown = (noshell_index_entry_t **)realloc(idx->entries, cap * sizeof(*grown));
+        if (!grown)
+            return false;
+        idx->entries = grown;
+        idx->cap = cap;
+    }
+    if (idx->kind == FOSSIL_NOSHELL_INDEX_ORDERED && idx->order_cap < idx->cap) {
+        noshell_index_entry_t **grown = (noshell_index_entry_t **)realloc(idx->order, idx->cap * sizeof(*grown));
+        if (!grown)
+            return false;
+        idx->order = grown;
+        idx->order_cap = idx->cap;
+    }
+
+    noshell_index_entry_t *e = (noshell_index_entry_t *)calloc(1, sizeof(*e));
+    char *copy = e ? noshell_strndup(value, len) : NULL;
+    if (!copy) {
+        free(e);
+        return false;
+    }
+    e->value = copy;
+    e->offset = offset;
+    noshell_index_classify(e, value, len);
+
+    if (idx->kind == FOSSIL_NOSHELL_INDEX_HASH) {
+        if (idx->count + 1 > idx->bucket_count && !noshell_index_rehash(idx)) {
+            free(copy);
+            free(e);
+            return false;
+        }
+        size_t b = (size_t)(e->hash & (idx->bucket_count - 1));
+        e->chain = idx->buckets[b];
+        idx->buckets[b] = e;
+    } else {
+        // Appends mostly land at the end; memmove covers the rest
+        size_t at = noshell_index_bound(idx, e, true);
+        memmove(idx->order + at + 1, idx->order + at, (idx->count - at) * sizeof(*idx->order));
+        idx->order[at] = e;
+    }
+    idx->entries[idx->count++] = e;
+    return true;
+}
+
+/**
+ * Reads lines from 'from' to the end of the file into every index of the
+ * set. 'from' is 0 for a full rebuild (all indexes cleared first).
+ */
+static fossil_bluecrab_noshell_error_t noshell_index_scan(noshell_index_set_t *set, FILE *fp, uint64_t from) {
+    if (from == 0) {
+        for (noshell_index_t *idx = set->indexes; idx; idx = idx->next)
+            noshell_index_clear(idx);
+        set->has_tail = false;
+    }
+    if (fseek(fp, (long)from, SEEK_SET) != 0)
+        return FOSSIL_NOSHELL_ERROR_IO;
+
+    char *line = NULL;
+    size_t cap = 0, len;
+    uint64_t offset = from;
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    while (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && (len = noshell_getline(fp, &line, &cap)) > 0) {
+        if (line[0] != '#' && noshell_is_document(line)) {
+            for (noshell_index_t *idx = set->indexes; idx; idx = idx->next) {
+                if (!noshell_index_add(idx, line, offset)) {
+                    rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+                    break;
+                }
+            }
+        }
+        set->tail_offset = offset;
+        set->tail_hash = fossil_bluecrab_hash64(line, len, 0);
+        set->has_tail = true;
+        offset += len;
+    }
+    free(line);
+    set->file_size = (size_t)offset;
+    return rc;
+}
+
+/**
+ * True if the last line read (tail_offset, hashed to tail_hash) is still at
+ * its offset, unchanged, and ends at file_size: the file has at most been
+ * appended to since.
+ */
+static bool noshell_tail_intact(FILE *fp, bool has_tail, uint64_t tail_offset, uint64_t tail_hash, size_t file_size) {
+    if (!has_tail)
+        return file_size == 0;
+    if (fseek(fp, (long)tail_offset, SEEK_SET) != 0)
+        return false;
+    char *line = NULL;
+    size_t cap = 0;
+    size_t len = noshell_getline(fp, &line, &cap);
+    bool intact = len > 0 && tail_offset + len == file_size &&
+                  fossil_bluecrab_hash64(line, len, 0) == tail_hash;
+    free(line);
+    return intact;
+}
+
+/**
+ * Brings every index of f up to date with the file (entry mutex held).
+ * fp, if given, is an open stream on the same file.
+ */
+static fossil_bluecrab_noshell_error_t noshell_index_refresh(noshell_file_t *f, FILE *fp) {
+    noshell_index_set_t *set = f->indexes;
+    struct stat sb;
+    if (stat(f->key, &sb) != 0)
+        return FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND;
+    uint64_t writes, rewritten;
+    noshell_file_counters(f, &writes, &rewritten);
+    if (rewritten > set->writes)
+        set->stale = true;
+    set->writes = writes;
+    size_t size = (size_t)sb.st_size;
+    if (!set->stale && size == set->file_size && sb.st_mtime == set->last_modified)
+        return FOSSIL_NOSHELL_ERROR_SUCCESS;
+
+    FILE *own = NULL;
+    if (!fp) {
+        own = fopen(f->key, "rb");
+        if (!own)
+            return FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND;
+        fp = own;
+    }
+    fossil_bluecrab_noshell_error_t rc;
+    if (!set->stale && size > set->file_size &&
+        noshell_tail_intact(fp, set->has_tail, set->tail_offset, set->tail_hash, set->file_size))
+        rc = noshell_index_scan(set, fp, set->file_size);
+    else
+        rc = noshell_index_scan(set, fp, 0);
+    if (own)
+        fclose(own);
+
+    set->stale = rc != FOSSIL_NOSHELL_ERROR_SUCCESS;
+    set->last_modified = sb.st_mtime;
+    return rc;
+}
+
+static noshell_index_t *noshell_index_set_get(const noshell_index_set_t *set, const char *field) {
+    for (noshell_index_t *idx = set->indexes; idx; idx = idx->next) {
+        if (strcmp(idx->field, field) == 0)
+            return idx;
+    }
+    return NULL;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_create_index(
+    const char *file_name,
+    const char *field_path,
+    fossil_bluecrab_noshell_index_kind_t kind
+) {
+    if (!file_name || !field_path || !field_path[0] || !fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    if (kind != FOSSIL_NOSHELL_INDEX_HASH && kind != FOSSIL_NOSHELL_INDEX_ORDERED && kind != FOSSIL_NOSHELL_INDEX_TEXT)
+        return FOSSIL_NOSHELL_ERROR_UNSUPPORTED;
+    if (strcmp(field_path, "*") == 0 && kind != FOSSIL_NOSHELL_INDEX_TEXT)
+        return FOSSIL_NOSHELL_ERROR_UNSUPPORTED;
+    if (noshell_lsm_enabled(file_name))
+        return FOSSIL_NOSHELL_ERROR_UNSUPPORTED;
+    struct stat sb;
+    if (stat(file_name, &sb) != 0)
+        return FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND;
+
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_thread_mutex_lock(&f->mutex);
+    noshell_index_set_t *set = f->indexes;
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    if (set && noshell_index_set_get(set, field_path))
+        rc = FOSSIL_NOSHELL_ERROR_ALREADY_EXISTS;
+
+    // The first index keeps the entry
+    bool new_set = set == NULL;
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && new_set)
+        set = (noshell_index_set_t *)calloc(1, sizeof(*set));
+    noshell_index_t *idx = set && rc == FOSSIL_NOSHELL_ERROR_SUCCESS ? (noshell_index_t *)calloc(1, sizeof(*idx)) : NULL;
+    if (idx && !(idx->field = noshell_strdup(field_path))) {
+        free(idx);
+        idx = NULL;
+    }
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && !idx) {
+        if (new_set)
+            free(set);
+        rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        idx->kind = kind;
+        idx->next = set->indexes;
+        set->indexes = idx;
+        if (new_set) {
+            f->indexes = set;
+            noshell_file_retain(f);
+        }
+        // Build now so the first query doesn't pay for it
+        set->stale = true;
+        rc = noshell_index_refresh(f, NULL);
+    }
+    fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+    noshell_file_release(f);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_drop_index(const char *file_name, const char *field_path) {
+    if (!file_name || !field_path)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_thread_mutex_lock(&f->mutex);
+    noshell_index_t **idx = f->indexes ? &f->indexes->indexes : NULL;
+    while (idx && *idx && strcmp((*idx)->field, field_path) != 0) idx = &(*idx)->next;
+    bool found = idx && *idx;
+    bool emptied = false;
+    if (found) {
+        noshell_index_t *dead = *idx;
+        *idx = dead->next;
+        noshell_index_free(dead);
+        emptied = !f->indexes->indexes;
+        if (emptied) {
+            free(f->indexes);
+            f->indexes = NULL;
+        }
+    }
+    fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+    if (emptied)
+        noshell_file_release(f);
+    noshell_file_release(f);
+    return found ? FOSSIL_NOSHELL_ERROR_SUCCESS : FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+}
+
+/**
+ * Longest run of literal bytes in a LIKE pattern (between wildcards); every
+ * match contains it.
+ */
+static const char *noshell_like_run(const char *pattern, size_t *len) {
+    const char *best = pattern;
+    *len = 0;
+    while (*pattern) {
+        size_t n = strcspn(pattern, "%_");
+        if (n > *len) {
+            best = pattern;
+            *len = n;
+        }
+        pattern += n;
+        if (*pattern) pattern++;
+    }
+    return best;
+}
+
+/**
+ * How well an index answers one comparison: 3 equality on a hash or
+ * ordered index, 2 a trigram lookup on a text index, 1 a numeric range on
+ * an ordered index, 0 not at all.
+ */
+static int noshell_index_rank(const fossil_bluecrab_query_pred_t *pred, const noshell_index_t *idx) {
+    if (idx->kind == FOSSIL_NOSHELL_INDEX_TEXT) {
+        size_t run = 0;
+        if (pred->op == FOSSIL_QUERY_CMP_LIKE)
+            noshell_like_run(pred->literal, &run);
+        else if (pred->op == FOSSIL_QUERY_CMP_EQ && !pred->numeric)
+            run = strlen(pred->literal);
+        return run >= 3 ? 2 : 0;
+    }
+    if (pred->op == FOSSIL_QUERY_CMP_EQ)
+        return 3;
+    if (idx->kind == FOSSIL_NOSHELL_INDEX_ORDERED && pred->numeric && pred->op != FOSSIL_QUERY_CMP_NE && pred->op != FOSSIL_QUERY_CMP_LIKE)
+        return 1;
+    return 0;
+}
+
+/**
+ * Picks the top-level AND term the indexes of the set answer best (see
+ * noshell_index_rank); *rank is 0 if none applies.
+ */
+static const fossil_bluecrab_query_pred_t *noshell_index_plan(const fossil_bluecrab_query_pred_t *pred, const noshell_index_set_t *set, noshell_index_t **out, int *rank) {
+    *rank = 0;
+    if (pred->kind == FOSSIL_QUERY_PRED_AND) {
+        noshell_index_t *left_idx = NULL, *right_idx = NULL;
+        int left_rank, right_rank;
+        const fossil_bluecrab_query_pred_t *left = noshell_index_plan(pred->left, set, &left_idx, &left_rank);
+        const fossil_bluecrab_query_pred_t *right = noshell_index_plan(pred->right, set, &right_idx, &right_rank);
+        if (left_rank >= right_rank) {
+            *out = left_idx;
+            *rank = left_rank;
+            return left;
+        }
+        *out = right_idx;
+        *rank = right_rank;
+        return right;
+    }
+    if (pred->kind != FOSSIL_QUERY_PRED_CMP)
+        return NULL;
+    // A field may carry a text index next to a hash/ordered one
+    for (noshell_index_t *idx = set->indexes; idx; idx = idx->next) {
+        int r = strcmp(idx->field, pred->field) == 0 ? noshell_index_rank(pred, idx) : 0;
+        if (r > *rank) {
+            *rank = r;
+            *out = idx;
+        }
+    }
+    return *rank > 0 ? pred : NULL;
+}
+
+static int noshell_offset_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/** Line offsets of the documents whose indexed text holds every trigram of needle. */
+static bool noshell_index_text_candidates(const noshell_index_t *idx, const char *needle, size_t len, uint64_t **offsets, size_t *count) {
+    uint32_t *ordinals = NULL;
+    size_t n = 0;
+    if (!noshell_text_lookup(&idx->text, needle, len, &ordinals, &n))
+        return false;
+    uint64_t *out = (uint64_t *)malloc((n ? n : 1) * sizeof(*out));
+    if (!out) {
+        free(ordinals);
+        return false;
+    }
+    // Ordinals ascend with the file, so the offsets are already in order
+    for (size_t i = 0; i < n; ++i)
+        out[i] = idx->text.docs[ordinals[i]];
+    free(ordinals);
+    *offsets = out;
+    *count = n;
+    return true;
+}
+
+/**
+ * Collects the line offsets an index yields for one predicate, sorted
+ * into file order.
+ */
+static bool noshell_index_candidates(const noshell_index_t *idx, const fossil_bluecrab_query_pred_t *pred, uint64_t **offsets, size_t *count) {
+    if (idx->kind == FOSSIL_NOSHELL_INDEX_TEXT) {
+        size_t len = 0;
+        const char *needle = pred->op == FOSSIL_QUERY_CMP_LIKE ? noshell_like_run(pred->literal, &len) : pred->literal;
+        if (pred->op != FOSSIL_QUERY_CMP_LIKE)
+            len = strlen(needle);
+        return noshell_index_text_candidates(idx, needle, len, offsets, count);
+    }
+
+    noshell_index_entry_t probe;
+    memset(&probe, 0, sizeof(probe));
+    probe.value = pred->literal;
+    noshell_index_classify(&probe, pred->literal, strlen(pred->literal));
+
+    size_t n = 0, cap = 16;
+    uint64_t *out = (uint64_t *)malloc(cap * sizeof(*out));
+    if (!out)
+        return false;
+
+    if (idx->kind == FOSSIL_NOSHELL_INDEX_HASH) {
+        for (noshell_index_entry_t *e = idx->bucket_count ? idx->buckets[probe.hash & (idx->bucket_count - 1)] : NULL; e; e = e->chain) {
+            if (e->hash != probe.hash)
+                continue;
+            if (n == cap) {
+                uint64_t *grown = (uint64_t *)realloc(out, cap * 2 * sizeof(*out));
+                if (!grown) { free(out); return false; }
+                out = grown;
+                cap *= 2;
+            }
+            out[n++] = e->offset;
+        }
+    } else {
+        // Numeric ranges stay inside the numeric prefix of the order
+        noshell_index_entry_t text_start;
+        memset(&text_start, 0, sizeof(text_start));
+        text_start.value = "";
+        size_t numeric_end = noshell_index_bound(idx, &text_start, false);
+        size_t lo = 0, hi = 0;
+        switch (pred->op) {
+            case FOSSIL_QUERY_CMP_EQ: lo = noshell_index_bound(idx, &probe, false); hi = noshell_index_bound(idx, &probe, true); break;
+            case FOSSIL_QUERY_CMP_LT: lo = 0; hi = noshell_index_bound(idx, &probe, false); break;
+            case FOSSIL_QUERY_CMP_LE: lo = 0; hi = noshell_index_bound(idx, &probe, true); break;
+            case FOSSIL_QUERY_CMP_GT: lo = noshell_index_bound(idx, &probe, true); hi = numeric_end; break;
+            case FOSSIL_QUERY_CMP_GE: lo = noshell_index_bound(idx, &probe, false); hi = numeric_end; break;
+            default: break;
+        }
+        if (hi > lo) {
+            uint64_t *grown = (uint64_t *)realloc(out, (hi - lo) * sizeof(*out));
+            if (!grown) { free(out); return false; }
+            out = grown;
+            for (size_t i = lo; i < hi; ++i)
+                out[n++] = idx->order[i]->offset;
+        }
+    }
+    qsort(out, n, sizeof(*out), noshell_offset_cmp);
+    *offsets = out;
+    *count = n;
+    return true;
+}
+
+/**
+ * Answers a structured find from an index. Returns
+ * FOSSIL_NOSHELL_ERROR_UNSUPPORTED when no index applies (the caller
+ * scans), otherwise the find result. fp, if given, is an open stream on
+ * the file (a handle's).
+ */
+static fossil_bluecrab_noshell_error_t noshell_index_find(
+    const char *file_name,
+    FILE *fp,
+    const noshell_matcher_t *matcher,
+    const char *type_tag,
+    char *result,
+    size_t buffer_size
+) {
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_thread_mutex_lock(&f->mutex);
+    noshell_index_set_t *set = f->indexes;
+    noshell_index_t *idx = NULL;
+    const fossil_bluecrab_query_pred_t *pred = NULL;
+    int rank = 0;
+    if (set && matcher->compiled) {
+        pred = noshell_index_plan(matcher->compiled->where, set, &idx, &rank);
+    } else if (set && strlen(matcher->text) >= 3) {
+        // Plain substring: the whole-line text index, if there is one
+        idx = noshell_index_set_get(set, "*");
+    }
+    if (!pred && (!idx || idx->kind != FOSSIL_NOSHELL_INDEX_TEXT)) {
+        fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+        noshell_file_release(f);
+        return FOSSIL_NOSHELL_ERROR_UNSUPPORTED;
+    }
+    fossil_bluecrab_noshell_error_t rc = noshell_index_refresh(f, fp);
+    uint64_t *offsets = NULL;
+    size_t count = 0;
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        bool listed = pred ? noshell_index_candidates(idx, pred, &offsets, &count)
+                           : noshell_index_text_candidates(idx, matcher->text, strlen(matcher->text), &offsets, &count);
+        if (!listed)
+            rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    }
+
+    FILE *own = NULL;
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && count > 0 && !fp) {
+        own = fopen(file_name, "rb");
+        fp = own;
+        if (!own)
+            rc = FOSSIL_NOSHELL_ERROR_IO;
+    }
+    // Entries of retired lines stay until the next rebuild
+    noshell_tombs_t tombs = {0};
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && count > 0)
+        rc = noshell_tombs_load(file_name, fp, &tombs);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        rc = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+        char *line = NULL;
+        size_t cap = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if ((i > 0 && offsets[i] == offsets[i - 1]) || noshell_tombs_has(&tombs, offsets[i]))
+                continue;
+            if (fseek(fp, (long)offsets[i], SEEK_SET) != 0 || noshell_getline(fp, &line, &cap) == 0)
+                continue;
+            if (!noshell_is_document(line) || !noshell_matcher_test(matcher, line))
+                continue;
+            if (type_tag[0] && !strstr(line, type_tag))
+                continue;
+            strncpy(result, line, buffer_size - 1);
+            result[buffer_size - 1] = '\0';
+            rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+            break;
+        }
+        free(line);
+    }
+    noshell_tombs_free(&tombs);
+    if (own)
+        fclose(own);
+    fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+    noshell_file_release(f);
+    free(offsets);
+    return rc;
+}
+
+// ===========================================================
+// Tombstones and Compaction
+// ===========================================================
+
+/*
+ * update and remove never rewrite the file. Each document they retire gets
+ * a tombstone line appended,
+ *
+ *     #del=<offset>,<length> #id=<id>
+ *
+ * naming the line by where it starts and how long it is. The #id= is kept
+ * for reference only: files written before inserts claimed free ids may
+ * hold equal documents under one id, and the offset is what tells them
+ * apart. An update appends the new version, which carries the old #id=,
+ * followed by the tombstone, so a torn append never loses the document.
+ * Tombstones start with '#', so everything that skips header lines skips
+ * them; readers that must not see retired documents check line offsets
+ * against the path's tombstone set.
+ *
+ * Tombstone sets are cached in the file's registry entry (under its
+ * tomb_mutex; see "Per-File State") and kept current like the field
+ * indexes: appends are read incrementally, anything else rescans. Once dead bytes make up
+ * more than half of a file of at least NOSHELL_COMPACT_MIN_BYTES, the
+ * writer compacts it: live lines are streamed to a temporary file that is
+ * renamed over the original.
+ */
+
+struct noshell_tomb_cache_t {
+    noshell_tombs_t tombs;
+    size_t   file_size;                    // bytes scanned
+    time_t   last_modified;
+    uint64_t writes;                       // registry write count when refreshed
+    uint64_t tail_offset;                  // last line scanned
+    uint64_t tail_hash;
+    bool     has_tail;
+    bool     stale;
+};
+
+#define NOSHELL_COMPACT_MIN_BYTES (64 * 1024)
+
+static size_t noshell_tomb_slot(uint64_t offset, size_t slot_count) {
+    return (size_t)((offset * 0x9E3779B97F4A7C15ULL) >> 32) & (slot_count - 1);
+}
+
+static bool noshell_tombs_has(const noshell_tombs_t *t, uint64_t offset) {
+    if (!t->count)
+        return false;
+    size_t mask = t->slot_count - 1;
+    for (size_t i = noshell_tomb_slot(offset, t->slot_count);; i = (i + 1) & mask) {
+        if (t->slots[i] == 0)
+            return false;
+        if (t->slots[i] == offset + 1)
+            return true;
+    }
+}
+
+/** Adds offset to the set, keeping it at most half full. */
+static bool noshell_tombs_put(noshell_tombs_t *t, uint64_t offset) {
+    if ((t->count + 1) * 2 > t->slot_count) {
+        size_t slot_count = t->slot_count ? t->slot_count * 2 : 64;
+        uint64_t *slots = (uint64_t *)calloc(slot_count, sizeof(*slots));
+        if (!slots)
+            return false;
+        for (size_t i = 0; i < t->slot_count; ++i) {
+            if (!t->slots[i]) continue;
+            size_t j = noshell_tomb_slot(t->slots[i] - 1, slot_count);
+            while (slots[j]) j = (j + 1) & (slot_count - 1);
+            slots[j] = t->slots[i];
+        }
+        free(t->slots);
+        t->slots = slots;
+        t->slot_count = slot_count;
+    }
+    size_t mask = t->slot_count - 1;
+    size_t i = noshell_tomb_slot(offset, t->slot_count);
+    while (t->slots[i]) {
+        if (t->slots[i] == offset + 1)
+            return true;
+        i = (i + 1) & mask;
+    }
+    t->slots[i] = offset + 1;
+    t->count++;
+    return true;
+}
+
+static void noshell_tombs_free(noshell_tombs_t *t) {
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+static bool noshell_tombs_copy(noshell_tombs_t *dst, const noshell_tombs_t *src) {
+    *dst = *src;
+    if (!src->count) {
+        dst->slots = NULL;
+        dst->slot_count = 0;
+        return true;
+    }
+    dst->slots = (uint64_t *)malloc(src->slot_count * sizeof(*dst->slots));
+    if (!dst->slots) {
+        memset(dst, 0, sizeof(*dst));
+        return false;
+    }
+    memcpy(dst->slots, src->slots, src->slot_count * sizeof(*dst->slots));
+    return true;
+}
+
+/** Parses a "#del=<offset>,<length>" line. */
+static bool noshell_tomb_parse(const char *line, uint64_t *offset, uint64_t *length) {
+    if (strncmp(line, "#del=", 5) != 0 || !isdigit((unsigned char)line[5]))
+        return false;
+    char *end;
+    *offset = strtoull(line + 5, &end, 10);
+    if (*end != ',' || !isdigit((unsigned char)end[1]))
+        return false;
+    *length = strtoull(end + 1, &end, 10);
+    return *end == '\0' || isspace((unsigned char)*end);
+}
+
+/**
+ * Reads tombstones from 'from' to the end of the file into the cache
+ * entry; 'from' is 0 for a full rescan.
+ */
+static fossil_bluecrab_noshell_error_t noshell_tomb_scan(noshell_tomb_cache_t *c, FILE *fp, uint64_t from) {
+    if (from == 0) {
+        noshell_tombs_free(&c->tombs);
+        c->has_tail = false;
+    }
+    if (fseek(fp, (long)from, SEEK_SET) != 0)
+        return FOSSIL_NOSHELL_ERROR_IO;
+
+    char *line = NULL;
+    size_t cap = 0, len;
+    uint64_t offset = from;
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    while (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && (len = noshell_getline(fp, &line, &cap)) > 0) {
+        uint64_t dead_at, dead_len;
+        if (line[0] == '#' && noshell_tomb_parse(line, &dead_at, &dead_len)) {
+            if (!noshell_tombs_put(&c->tombs, dead_at))
+                rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+            c->tombs.dead_bytes += dead_len + len;
+        }
+        c->tail_offset = offset;
+        c->tail_hash = fossil_bluecrab_hash64(line, len, 0);
+        c->has_tail = true;
+        offset += len;
+    }
+    free(line);
+    c->file_size = (size_t)offset;
+    return rc;
+}
+
+static void noshell_tomb_cache_free(noshell_tomb_cache_t *c) {
+    if (!c) return;
+    noshell_tombs_free(&c->tombs);
+    free(c);
+}
+
+/** Brings the tombstone cache of f up to date with the file (tomb_mutex held). */
+static fossil_bluecrab_noshell_error_t noshell_tomb_refresh(noshell_file_t *f, FILE *fp) {
+    noshell_tomb_cache_t *c = f->tombs;
+    struct stat sb;
+    if (stat(f->key, &sb) != 0)
+        return FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND;
+    uint64_t writes, rewritten;
+    noshell_file_counters(f, &writes, &rewritten);
+    if (rewritten > c->writes)
+        c->stale = true;
+    c->writes = writes;
+    size_t size = (size_t)sb.st_size;
+    if (!c->stale && size == c->file_size && sb.st_mtime == c->last_modified)
+        return FOSSIL_NOSHELL_ERROR_SUCCESS;
+
+    fossil_bluecrab_noshell_error_t rc;
+    if (!c->stale && size > c->file_size &&
+        noshell_tail_intact(fp, c->has_tail, c->tail_offset, c->tail_hash, c->file_size))
+        rc = noshell_tomb_scan(c, fp, c->file_size);
+    else
+        rc = noshell_tomb_scan(c, fp, 0);
+    c->stale = rc != FOSSIL_NOSHELL_ERROR_SUCCESS;
+    c->last_modified = sb.st_mtime;
+    return rc;
+}
+
+/**
+ * Copies the current tombstone set of file_name into out (to be released
+ * with noshell_tombs_free). fp is an open stream on the file; its position
+ * is left anywhere.
+ */
+static fossil_bluecrab_noshell_error_t noshell_tombs_load(const char *file_name, FILE *fp, noshell_tombs_t *out) {
+    memset(out, 0, sizeof(*out));
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_thread_mutex_lock(&f->tomb_mutex);
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    if (!f->tombs) {
+        f->tombs = (noshell_tomb_cache_t *)calloc(1, sizeof(*f->tombs));
+        if (f->tombs)
+            f->tombs->stale = true;
+        else
+            rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+        rc = noshell_tomb_refresh(f, fp);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && !noshell_tombs_copy(out, &f->tombs->tombs))
+        rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_thread_mutex_unlock(&f->tomb_mutex);
+    noshell_file_release(f);
+    return rc;
+}
+
+static bool noshell_buf_append(char **buf, size_t *len, size_t *cap, const char *data, size_t n) {
+    if (*len + n + 1 > *cap) {
+        size_t grown_cap = *cap ? *cap * 2 : 1024;
+        while (grown_cap < *len + n + 1)
+            grown_cap *= 2;
+        char *grown = (char *)realloc(*buf, grown_cap);
+        if (!grown)
+            return false;
+        *buf = grown;
+        *cap = grown_cap;
+    }
+    memcpy(*buf + *len, data, n);
+    *len += n;
+    (*buf)[*len] = '\0';
+    return true;
+}
+
+/**
+ * Core of update and remove: appends a tombstone for every live document
+ * line of fp (open for reading and writing) that matches matcher and
+ * type_tag, each preceded by new_body plus the retired line's #id= when
+ * new_body is given. All records go out in one write at the end of the
+ * file. keep, if given, sees every live document line left standing and
+ * every new version, with its offset. *compact is set when dead bytes now
+ * call for compaction.
+ */
+static fossil_bluecrab_noshell_error_t noshell_tomb_apply(
+    const char *file_name,
+    FILE *fp,
+    const noshell_matcher_t *matcher,
+    const char *type_tag,
+    const char *new_body,
+    noshell_line_fn keep,
+    void *keep_ctx,
+    bool *compact
+) {
+    *compact = false;
+    noshell_tombs_t tombs;
+    fossil_bluecrab_noshell_error_t rc = noshell_tombs_load(file_name, fp, &tombs);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+
+    char *line = NULL, *out = NULL;
+    size_t line_cap = 0, out_len = 0, out_cap = 0;
+    size_t *versions = NULL, version_count = 0, version_cap = 0;   // starts in out
+    uint64_t offset = 0, killed = 0;
+    bool matched = false, newline_at_end = true;
+    size_t len;
+    fseek(fp, 0, SEEK_SET);
+    while (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && (len = noshell_getline(fp, &line, &line_cap)) > 0) {
+        uint64_t at = offset;
+        offset += len;
+        newline_at_end = line[len - 1] == '\n';
+        if (line[0] == '#' || !noshell_is_document(line) || noshell_tombs_has(&tombs, at))
+            continue;
+        if (!noshell_matcher_test(matcher, line) || (type_tag[0] && !strstr(line, type_tag))) {
+            if (keep && !keep(keep_ctx, at, line, len))
+                rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+            continue;
+        }
+        matched = true;
+
+        uint64_t id = 0;
+        bool has_id = noshell_line_id(line, len, &id);
+        char record[96];
+        int n;
+        if (new_body) {
+            if (version_count == version_cap) {
+                size_t cap = version_cap ? version_cap * 2 : 16;
+                size_t *grown = (size_t *)realloc(versions, cap * sizeof(*grown));
+                if (!grown) {
+                    rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+                    break;
+                }
+                versions = grown;
+                version_cap = cap;
+            }
+            versions[version_count++] = out_len;
+            n = has_id ? snprintf(record, sizeof(record), " #id=%016" PRIx64 "\n", id) : snprintf(record, sizeof(record), "\n");
+            if (!noshell_buf_append(&out, &out_len, &out_cap, new_body, strlen(new_body)) ||
+                !noshell_buf_append(&out, &out_len, &out_cap, record, (size_t)n)) {
+                rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+        }
+
+        // The tombstone follows the new version, so a torn write can leave
+        // both versions standing but never neither
+        n = has_id
+            ? snprintf(record, sizeof(record), "#del=%" PRIu64 ",%" PRIu64 " #id=%016" PRIx64 "\n", at, (uint64_t)len, id)
+            : snprintf(record, sizeof(record), "#del=%" PRIu64 ",%" PRIu64 "\n", at, (uint64_t)len);
+        if (!noshell_buf_append(&out, &out_len, &out_cap, record, (size_t)n)) {
+            rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        killed += len + (uint64_t)n;
+    }
+    free(line);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && !matched)
+        rc = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+
+    // A last line without its newline would swallow the first record
+    uint64_t base = offset + (newline_at_end ? 0 : 1);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        if (fseek(fp, 0, SEEK_END) != 0 ||
+            (!newline_at_end && fputc('\n', fp) == EOF) ||
+            fwrite(out, 1, out_len, fp) != out_len ||
+            fflush(fp) != 0)
+            rc = FOSSIL_NOSHELL_ERROR_IO;
+        else
+            rc = noshell_durable(file_name, fp);
+    }
+    for (size_t i = 0; keep && rc == FOSSIL_NOSHELL_ERROR_SUCCESS && i < version_count; ++i) {
+        size_t start = versions[i];
+        size_t end = start + strcspn(out + start, "\n") + 1;
+        char saved = out[end];
+        out[end] = '\0';
+        if (!keep(keep_ctx, base + start, out + start, end - start))
+            rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        out[end] = saved;
+    }
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        uint64_t size = base + out_len;
+        uint64_t dead = tombs.dead_bytes + killed;
+        *compact = size >= NOSHELL_COMPACT_MIN_BYTES && dead * 2 > size;
+    }
+    free(versions);
+    free(out);
+    noshell_tombs_free(&tombs);
+    return rc;
+}
+
+/**
+ * Streams the header and live document lines of in to out, dropping
+ * tombstones, the lines they name and anything that is neither. Returns
+ * false on a read or write error.
+ */
+static bool noshell_copy_live(FILE *in, FILE *out, const noshell_tombs_t *tombs) {
+    if (fseek(in, 0, SEEK_SET) != 0)
+        return false;
+    char *line = NULL;
+    size_t cap = 0, len;
+    uint64_t offset = 0;
+    bool ok = true;
+    while (ok && (len = noshell_getline(in, &line, &cap)) > 0) {
+        uint64_t at = offset;
+        offset += len;
+        uint64_t dead_at, dead_len;
+        if (line[0] == '#' ? noshell_tomb_parse(line, &dead_at, &dead_len)
+                           : !noshell_is_document(line) || noshell_tombs_has(tombs, at))
+            continue;
+        ok = fwrite(line, 1, len, out) == len;
+    }
+    free(line);
+    return ok && !ferror(in);
+}
+
+/**
+ * Rewrites file_name with only its live lines, through a temporary file
+ * renamed over it. Nothing may hold the file open on Windows.
+ */
+static fossil_bluecrab_noshell_error_t noshell_compact_path(const char *file_name) {
+    FILE *in = fopen(file_name, "rb");
+    if (!in)
+        return FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND;
+    noshell_tombs_t tombs;
+    fossil_bluecrab_noshell_error_t rc = noshell_tombs_load(file_name, in, &tombs);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        fclose(in);
+        return rc;
+    }
+
+    size_t tmp_len = strlen(file_name) + 5;
+    char *tmp_path = (char *)malloc(tmp_len);
+    FILE *out = NULL;
+    if (tmp_path) {
+        snprintf(tmp_path, tmp_len, "%s.tmp", file_name);
+        out = fopen(tmp_path, "wb");
+    }
+    if (!out) {
+        rc = tmp_path ? FOSSIL_NOSHELL_ERROR_IO : FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    } else {
+        if (!noshell_copy_live(in, out, &tombs) || fflush(out) != 0)
+            rc = FOSSIL_NOSHELL_ERROR_IO;
+        if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+            rc = noshell_durable(file_name, out);
+        fclose(out);
+    }
+    fclose(in);
+    noshell_tombs_free(&tombs);
+
+    bool replaced = false;
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+#if defined(_WIN32) || defined(_WIN64)
+        replaced = MoveFileExA(tmp_path, file_name, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        replaced = rename(tmp_path, file_name) == 0;
+#endif
+        if (!replaced)
+            rc = FOSSIL_NOSHELL_ERROR_IO;
+        else if (fossil_bluecrab_noshell_get_durability(file_name) == FOSSIL_NOSHELL_DURABILITY_FSYNC &&
+                 fossil_bluecrab_sync_parent_dir(file_name) != 0)
+            rc = FOSSIL_NOSHELL_ERROR_IO;  // replaced, but the rename may not survive a crash
+    }
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS && out && !replaced)
+        remove(tmp_path);
+    free(tmp_path);
+    noshell_file_invalidate(file_name);
+    return rc;
+}
+
+/**
+ * Compacts the file under an entered handle, which has to let go of its
+ * stream for the rename, and reloads the handle.
+ */
+static fossil_bluecrab_noshell_error_t noshell_handle_compact(fossil_bluecrab_noshell_t *db) {
+    if (db->file) {
+        fclose(db->file);
+        db->file = NULL;
+    }
+    fossil_bluecrab_noshell_error_t rc = noshell_compact_path(db->path);
+    fossil_bluecrab_noshell_error_t load_rc = noshell_handle_load(db);
+    if (load_rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        db->file_size = (size_t)-1;
+    return rc != FOSSIL_NOSHELL_ERROR_SUCCESS ? rc : load_rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_compact(const char *file_name) {
+    if (!file_name || !fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_lsm_t *lsm;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_acquire(file_name, &lsm);
+    if (lsm) {
+        rc = noshell_lsm_compact(lsm);
+        noshell_lsm_release(lsm);
+    }
+    if (lsm || rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+
+    fossil_bluecrab_noshell_t *db = noshell_handle_borrow(file_name);
+    if (!db)
+        return noshell_compact_path(file_name);
+    rc = noshell_handle_enter(db);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        rc = noshell_handle_compact(db);
+        noshell_handle_leave(db);
+    }
+    fossil_bluecrab_noshell_close(db);
+    return rc;
+}
+
+// ===========================================================
+// Document Statistics
+// ===========================================================
+
+/*
+ * count_documents and fossil_bluecrab_noshell_stats answer from a sidecar,
+ * "<path>.meta", holding one line:
+ *
+ *     #noshell_meta size=SIZE docs=N dead=BYTES tail=HASH types=N0,N1,...
+ *
+ * SIZE is how much of the file the counts cover (always the end of a
+ * whole line), HASH the legacy hash of the (up to) NOSHELL_META_WINDOW
+ * bytes before SIZE, and types one live document count per FSON type in
+ * noshell_fson_type_names order. Writers never rewrite a file in place, so
+ * a sidecar whose tail still matches is caught up by reading only the lines
+ * after SIZE: a document line with an #id= counts once, a tombstone takes
+ * back the line it names and adds both to the dead bytes. Without a usable
+ * sidecar the whole file is read once and the result stamped. create,
+ * delete, restore and compaction drop the sidecar (noshell_file_invalidate).
+ * Sidecar reads and writes hold the file's entry mutex.
+ */
+
+#define NOSHELL_META_WINDOW 4096
+
+static char *noshell_meta_path(const char *file_name, const char *suffix) {
+    size_t len = strlen(file_name) + strlen(suffix) + 1;
+    char *path = (char *)malloc(len);
+    if (path)
+        snprintf(path, len, "%s%s", file_name, suffix);
+    return path;
+}
+
+static bool noshell_meta_tail_hash(FILE *fp, uint64_t size, uint64_t *out) {
+    char window[NOSHELL_META_WINDOW];
+    size_t len = size < NOSHELL_META_WINDOW ? (size_t)size : NOSHELL_META_WINDOW;
+    if (fseek(fp, (long)(size - len), SEEK_SET) != 0 || fread(window, 1, len, fp) != len)
+        return false;
+    *out = fossil_bluecrab_hash64_legacy(window, len);
+    return true;
+}
+
+static bool noshell_meta_read(const char *file_name, noshell_meta_t *meta) {
+    char *path = noshell_meta_path(file_name, ".meta");
+    FILE *fp = path ? fopen(path, "rb") : NULL;
+    free(path);
+    if (!fp)
+        return false;
+    bool ok = fscanf(fp, "#noshell_meta size=%" SCNu64 " docs=%" SCNu64 " dead=%" SCNu64 " tail=%" SCNx64 " types=",
+                     &meta->size, &meta->docs, &meta->dead_bytes, &meta->tail) == 4;
+    for (size_t i = 0; ok && i < FOSSIL_NOSHELL_STATS_TYPES; ++i)
+        ok = fscanf(fp, i ? ",%" SCNu64 : "%" SCNu64, &meta->types[i]) == 1;
+    fclose(fp);
+    return ok && meta->dead_bytes <= meta->size;
+}
+
+/**
+ * Replaces the sidecar through a temporary file. A failed write leaves the
+ * old sidecar, which is still a valid (older) stamp.
+ */
+static void noshell_meta_write(const char *file_name, const noshell_meta_t *meta) {
+    char *path = noshell_meta_path(file_name, ".meta");
+    char *tmp_path = noshell_meta_path(file_name, ".meta.tmp");
+    FILE *fp = path && tmp_path ? fopen(tmp_path, "wb") : NULL;
+    if (fp) {
+        bool ok = fprintf(fp, "#noshell_meta size=%" PRIu64 " docs=%" PRIu64 " dead=%" PRIu64 " tail=%016" PRIx64 " types=",
+                          meta->size, meta->docs, meta->dead_bytes, meta->tail) >= 0;
+        for (size_t i = 0; ok && i < FOSSIL_NOSHELL_STATS_TYPES; ++i)
+            ok = fprintf(fp, i ? ",%" PRIu64 : "%" PRIu64, meta->types[i]) >= 0;
+        ok = ok && fputc('\n', fp) != EOF;
+        ok = fclose(fp) == 0 && ok;
+#if defined(_WIN32) || defined(_WIN64)
+        ok = ok && MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        ok = ok && rename(tmp_path, path) == 0;
+#endif
+        if (!ok)
+            remove(tmp_path);
+    }
+    free(path);
+    free(tmp_path);
+}
+
+/** Adds (or takes back) one line; only document lines with an #id= count. */
+static void noshell_meta_count(noshell_meta_t *meta, const char *line, size_t len, bool add) {
+    if (line[0] == '#' || !noshell_is_document(line) || !fossil_bluecrab_scan_find(line, len, "#id=", 4))
+        return;
+    size_t type = FOSSIL_NOSHELL_STATS_TYPES;
+    const char *name = fossil_bluecrab_scan_find(line, len, "#type=", 6);
+    if (name) {
+        name += 6;
+        size_t name_len = strcspn(name, " \t\r\n");
+        for (type = 0; type < FOSSIL_NOSHELL_STATS_TYPES; ++type) {
+            if (strlen(noshell_fson_type_names[type]) == name_len &&
+                memcmp(noshell_fson_type_names[type], name, name_len) == 0)
+                break;
+        }
+    }
+    if (add) {
+        meta->docs++;
+        if (type < FOSSIL_NOSHELL_STATS_TYPES)
+            meta->types[type]++;
+    } else {
+        if (meta->docs)
+            meta->docs--;
+        if (type < FOSSIL_NOSHELL_STATS_TYPES && meta->types[type])
+            meta->types[type]--;
+    }
+}
+
+/**
+ * Counts the lines from meta->size to the end of fp into meta. stamp gets
+ * the counts up to the end of the last whole line, which is all the
+ * sidecar may record; a last line still missing its newline is only in
+ * meta. Lines named by tombstones are read back through a second stream.
+ */
+static fossil_bluecrab_noshell_error_t noshell_meta_scan(const char *file_name, FILE *fp, noshell_meta_t *meta, noshell_meta_t *stamp) {
+    if (fseek(fp, (long)meta->size, SEEK_SET) != 0)
+        return FOSSIL_NOSHELL_ERROR_IO;
+    *stamp = *meta;
+
+    FILE *retired = NULL;
+    char *dead_line = NULL;
+    size_t dead_cap = 0;
+    noshell_reader_t reader;
+    noshell_reader_init(&reader, fp);
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    char *line;
+    size_t len;
+    while ((line = noshell_reader_next(&reader, &len)) != NULL) {
+        uint64_t dead_at, dead_len;
+        if (line[0] == '#' && noshell_tomb_parse(line, &dead_at, &dead_len)) {
+            if (!retired && !(retired = fopen(file_name, "rb"))) {
+                rc = FOSSIL_NOSHELL_ERROR_IO;
+                break;
+            }
+            size_t got = 0;
+            if (fseek(retired, (long)dead_at, SEEK_SET) == 0)
+                got = noshell_getline(retired, &dead_line, &dead_cap);
+            if (got > 0)
+                noshell_meta_count(meta, dead_line, got, false);
+            meta->dead_bytes += dead_len + len;
+        } else {
+            noshell_meta_count(meta, line, len, true);
+        }
+        meta->size += len;
+        if (line[len - 1] == '\n')
+            *stamp = *meta;
+    }
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && ferror(fp))
+        rc = FOSSIL_NOSHELL_ERROR_IO;
+    noshell_reader_free(&reader);
+    free(dead_line);
+    if (retired)
+        fclose(retired);
+    return rc;
+}
+
+/**
+ * Current statistics of file_name: the sidecar, caught up with whatever
+ * was appended since it was written (and re-stamped if anything was).
+ */
+static fossil_bluecrab_noshell_error_t noshell_meta_load(const char *file_name, noshell_meta_t *out) {
+    FILE *fp = fopen(file_name, "rb");
+    if (!fp)
+        return FOSSIL_NOSHELL_ERROR_IO;
+    if (fseek(fp, 0, SEEK_END) != 0) {
+        fclose(fp);
+        return FOSSIL_NOSHELL_ERROR_IO;
+    }
+    long end = ftell(fp);
+    if (end < 0) {
+        fclose(fp);
+        return FOSSIL_NOSHELL_ERROR_IO;
+    }
+    uint64_t size = (uint64_t)end;
+
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f) {
+        fclose(fp);
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    fossil_bluecrab_thread_mutex_lock(&f->mutex);
+    noshell_meta_t saved;
+    uint64_t tail;
+    memset(&saved, 0, sizeof(saved));
+    if (!noshell_meta_read(file_name, &saved) || saved.size > size ||
+        !noshell_meta_tail_hash(fp, saved.size, &tail) || tail != saved.tail)
+        memset(&saved, 0, sizeof(saved));
+
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    *out = saved;
+    if (saved.size < size) {
+        noshell_meta_t stamp;
+        rc = noshell_meta_scan(file_name, fp, out, &stamp);
+        if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && stamp.size > saved.size &&
+            noshell_meta_tail_hash(fp, stamp.size, &stamp.tail))
+            noshell_meta_write(file_name, &stamp);
+    }
+    fossil_bluecrab_thread_mutex_unlock(&f->mutex);
+    noshell_file_release(f);
+    fclose(fp);
+    return rc;
+}
+
+// ===========================================================
+// Binary FSON (FSON-B)
+// ===========================================================
+
+/*
+ * FSON-B is a binary image of a NoShell file. Export writes the header
+ * lines and live documents of a .noshell file; import turns them back
+ * into the same text, byte for byte. Queries and field reads over an
+ * image jump through offset tables instead of parsing FSON text, and type
+ * names and field names are stored once instead of in every document.
+ *
+ * Layout (integers little-endian):
+ *
+ *   "FSONB\0\1\0"
+ *   record*     u32 length, u8 kind, payload
+ *                 NOSHELL_FSONB_LINE  the line as text
+ *                 NOSHELL_FSONB_DOC   u32 body length, encoded body, then
+ *                                     the rest of the line (tags, newline)
+ *   dictionary  u32 count, count x (u32 length, name)
+ *   footer      u64 dictionary offset, u64 record count, "FSONB\0\1\0"
+ *
+ * An encoded value starts with a tag byte. Its low five bits hold the FSON
+ * type of the value's "type:" annotation (NOSHELL_FSONB_UNTYPED when it
+ * has none) and its high three bits the representation:
+ *
+ *   TEXT    u32 length, bytes    scalar as written
+ *   STRING  u32 length, bytes    double-quoted string without the quotes
+ *   INT     i64                  decimal integer
+ *   OBJECT  u32 size, u32 count, count x (u32 name id, u32 offset), values
+ *   ARRAY   u32 size, u32 count, count x u32 offset, values
+ *
+ * size covers everything after the size field and offsets count from the
+ * container's tag byte. Name ids index the dictionary. Decoding produces
+ * the spelling NoShell writes ("{ key: type: value, ... }", "[ a, b ]",
+ * "{ }"); export keeps any document that would not come back byte for
+ * byte (other spacing, quoted keys, ...) as a text record instead.
+ */
+
+#define NOSHELL_FSONB_MAGIC      "FSONB\0\1\0"
+#define NOSHELL_FSONB_MAGIC_LEN  8
+#define NOSHELL_FSONB_FOOTER_LEN (16 + NOSHELL_FSONB_MAGIC_LEN)
+#define NOSHELL_FSONB_UNTYPED    31
+#define NOSHELL_FSONB_MAX_DEPTH  64
+
+enum { NOSHELL_FSONB_LINE = 0, NOSHELL_FSONB_DOC = 1 };
+
+enum {
+    NOSHELL_FSONB_TEXT = 0,
+    NOSHELL_FSONB_STRING,
+    NOSHELL_FSONB_INT,
+    NOSHELL_FSONB_OBJECT,
+    NOSHELL_FSONB_ARRAY
+};
+
+#define NOSHELL_FSONB_TAG(rep, type) ((uint8_t)(((rep) << 5) | (type)))
+#define NOSHELL_FSONB_REP(tag)       ((tag) >> 5)
+#define NOSHELL_FSONB_TYPE(tag)      ((tag) & 31)
+
+typedef struct {
+    char   *data;
+    size_t  len;
+    size_t  cap;
+} noshell_bytes_t;
+
+static bool noshell_bytes_put(noshell_bytes_t *b, const void *data, size_t n) {
+    return noshell_buf_append(&b->data, &b->len, &b->cap, (const char *)data, n);
+}
+
+static bool noshell_bytes_put_u32(noshell_bytes_t *b, uint32_t v) {
+    uint8_t le[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    return noshell_bytes_put(b, le, sizeof(le));
+}
+
+static bool noshell_bytes_put_u64(noshell_bytes_t *b, uint64_t v) {
+    return noshell_bytes_put_u32(b, (uint32_t)v) && noshell_bytes_put_u32(b, (uint32_t)(v >> 32));
+}
+
+static uint32_t noshell_fsonb_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t noshell_fsonb_u64(const uint8_t *p) {
+    return (uint64_t)noshell_fsonb_u32(p) | ((uint64_t)noshell_fsonb_u32(p + 4) << 32);
+}
+
+/** Field-name dictionary: names in id order plus an open-addressed lookup. */
+typedef struct {
+    char     **names;
+    uint32_t  *lens;
+    uint32_t   count;
+    uint32_t   cap;
+    uint32_t  *slots;       // id + 1, 0 = empty
+    size_t     slot_count;  // power of two, or 0
+} noshell_fsonb_dict_t;
+
+static void noshell_fsonb_dict_free(noshell_fsonb_dict_t *d) {
+    for (uint32_t i = 0; i < d->count; ++i)
+        free(d->names[i]);
+    free(d->names);
+    free(d->lens);
+    free(d->slots);
+    memset(d, 0, sizeof(*d));
+}
+
+static bool noshell_fsonb_dict_find(const noshell_fsonb_dict_t *d, const char *name, size_t len, uint32_t *id) {
+    if (!d->slot_count)
+        return false;
+    size_t mask = d->slot_count - 1;
+    for (size_t i = (size_t)fossil_bluecrab_hash64(name, len, 0) & mask;; i = (i + 1) & mask) {
+        if (!d->slots[i])
+            return false;
+        uint32_t at = d->slots[i] - 1;
+        if (d->lens[at] == len && memcmp(d->names[at], name, len) == 0) {
+            *id = at;
+            return true;
+        }
+    }
+}
+
+/** Id of name, adding it if new. */
+static bool noshell_fsonb_dict_add(noshell_fsonb_dict_t *d, const char *name, size_t len, uint32_t *id) {
+    if (noshell_fsonb_dict_find(d, name, len, id))
+        return true;
+    if (d->count == d->cap) {
+        uint32_t cap = d->cap ? d->cap * 2 : 32;
+        char **names = (char **)realloc(d->names, cap * sizeof(*names));
+        if (!names)
+            return false;
+        d->names = names;
+        uint32_t *lens = (uint32_t *)realloc(d->lens, cap * sizeof(*lens));
+        if (!lens)
+            return false;
+        d->lens = lens;
+        d->cap = cap;
+    }
+    if ((d->count + 1) * 2 > d->slot_count) {
+        size_t slot_count = d->slot_count ? d->slot_count * 2 : 64;
+        uint32_t *slots = (uint32_t *)calloc(slot_count, sizeof(*slots));
+        if (!slots)
+            return false;
+        for (uint32_t i = 0; i < d->count; ++i) {
+            size_t j = (size_t)fossil_bluecrab_hash64(d->names[i], d->lens[i], 0) & (slot_count - 1);
+            while (slots[j]) j = (j + 1) & (slot_count - 1);
+            slots[j] = i + 1;
+        }
+        free(d->slots);
+        d->slots = slots;
+        d->slot_count = slot_count;
+    }
+    char *copy = noshell_strndup(name, len);
+    if (!copy)
+        return false;
+    size_t j = (size_t)fossil_bluecrab_hash64(name, len, 0) & (d->slot_count - 1);
+    while (d->slots[j]) j = (j + 1) & (d->slot_count - 1);
+    d->names[d->count] = copy;
+    d->lens[d->count] = (uint32_t)len;
+    d->slots[j] = d->count + 1;
+    *id = d->count++;
+    return true;
+}
+
+/** FSON type index of a "name:" annotation at p, or NOSHELL_FSONB_UNTYPED. */
+static uint8_t noshell_fsonb_annotation(const char *p, const char **after) {
+    const char *ann = p;
+    while (isalnum((unsigned char)*ann)) ann++;
+    if (ann == p || *ann != ':')
+        return NOSHELL_FSONB_UNTYPED;
+    for (uint8_t i = 0; i <= NOSHELL_FSON_TYPE_DURATION; ++i) {
+        if (strlen(noshell_fson_type_names[i]) == (size_t)(ann - p) &&
+            memcmp(noshell_fson_type_names[i], p, (size_t)(ann - p)) == 0) {
+            *after = ann + 1;
+            return i;
+        }
+    }
+    return NOSHELL_FSONB_UNTYPED;
+}
+
+static bool noshell_fsonb_encode_value(const char **pp, noshell_fsonb_dict_t *dict, noshell_bytes_t *out, int depth);
+
+/**
+ * Encodes the members of the object or array at *pp (on its opening
+ * bracket) with the given tag and advances *pp past the closing bracket.
+ */
+static bool noshell_fsonb_encode_container(const char **pp, uint8_t tag, noshell_fsonb_dict_t *dict, noshell_bytes_t *out, int depth) {
+    bool object = NOSHELL_FSONB_REP(tag) == NOSHELL_FSONB_OBJECT;
+    char close = object ? '}' : ']';
+    const char *p = *pp + 1;
+    noshell_bytes_t table = {0}, values = {0};
+    uint32_t count = 0;
+    bool ok = true;
+    for (;;) {
+        while (*p == ' ') p++;
+        if (*p == close && count == 0) {
+            p++;
+            break;
+        }
+        if (object) {
+            const char *key = p;
+            while (*p && !isspace((unsigned char)*p) && !strchr(":,{}[]\"'", *p)) p++;
+            uint32_t id = 0;
+            ok = p > key && *p == ':' && noshell_fsonb_dict_add(dict, key, (size_t)(p - key), &id) &&
+                 noshell_bytes_put_u32(&table, id);
+            if (!ok)
+                break;
+            p++;
+        }
+        ok = ok && noshell_bytes_put_u32(&table, (uint32_t)values.len) &&
+             noshell_fsonb_encode_value(&p, dict, &values, depth + 1);
+        if (!ok)
+            break;
+        count++;
+        while (*p == ' ') p++;
+        if (*p == ',') {
+            p++;
+        } else if (*p == close) {
+            p++;
+            break;
+        } else {
+            ok = false;
+            break;
+        }
+    }
+
+    // Offsets so far count from the start of the values
+    size_t entry = object ? 8 : 4;
+    size_t header = 1 + 4 + 4 + table.len;
+    for (uint32_t i = 0; ok && i < count; ++i) {
+        uint8_t *at = (uint8_t *)table.data + i * entry + entry - 4;
+        uint32_t offset = noshell_fsonb_u32(at) + (uint32_t)header;
+        at[0] = (uint8_t)offset;
+        at[1] = (uint8_t)(offset >> 8);
+        at[2] = (uint8_t)(offset >> 16);
+        at[3] = (uint8_t)(offset >> 24);
+    }
+    ok = ok && header + values.len <= UINT32_MAX &&
+         noshell_bytes_put(out, &tag, 1) &&
+         noshell_bytes_put_u32(out, (uint32_t)(4 + table.len + values.len)) &&
+         noshell_bytes_put_u32(out, count) &&
+         (table.len == 0 || noshell_bytes_put(out, table.data, table.len)) &&
+         (values.len == 0 || noshell_bytes_put(out, values.data, values.len));
+    free(table.data);
+    free(values.data);
+    *pp = p;
+    return ok;
+}
+
+/**
+ * Encodes the FSON value at *pp, with its optional "type:" annotation,
+ * onto out and advances *pp past it. Returns false for text it has no
+ * encoding for (or when out of memory).
+ */
+static bool noshell_fsonb_encode_value(const char **pp, noshell_fsonb_dict_t *dict, noshell_bytes_t *out, int depth) {
+    if (depth > NOSHELL_FSONB_MAX_DEPTH)
+        return false;
+    const char *p = *pp;
+    while (*p == ' ') p++;
+    uint8_t type = noshell_fsonb_annotation(p, &p);
+    while (*p == ' ') p++;
+
+    if (*p == '{' || *p == '[') {
+        *pp = p;
+        uint8_t rep = *p == '{' ? NOSHELL_FSONB_OBJECT : NOSHELL_FSONB_ARRAY;
+        return noshell_fsonb_encode_container(pp, NOSHELL_FSONB_TAG(rep, type), dict, out, depth);
+    }
+
+    const char *end;
+    if (*p == '"' || *p == '\'') {
+        end = noshell_fson_skip_value(p);
+    } else {
+        end = p;
+        while (*end && *end != ',' && *end != '}' && *end != ']' && *end != '\n' && *end != '\r') end++;
+        while (end > p && isspace((unsigned char)end[-1])) end--;
+    }
+    size_t len = (size_t)(end - p);
+    if (len == 0 || len > UINT32_MAX)
+        return false;
+    *pp = end;
+
+    uint8_t rep = NOSHELL_FSONB_TEXT;
+    long long ival = 0;
+    if (p[0] == '"' && len >= 2 && end[-1] == '"' && !memchr(p + 1, '\\', len - 2) && !memchr(p + 1, '"', len - 2)) {
+        rep = NOSHELL_FSONB_STRING;
+        p++;
+        len -= 2;
+    } else if (isdigit((unsigned char)p[0]) || (p[0] == '-' && len > 1)) {
+        char text[32], again[32];
+        if (len < sizeof(text)) {
+            memcpy(text, p, len);
+            text[len] = '\0';
+            char *stop;
+            errno = 0;
+            ival = strtoll(text, &stop, 10);
+            snprintf(again, sizeof(again), "%lld", ival);
+            if (errno == 0 && *stop == '\0' && strcmp(text, again) == 0)
+                rep = NOSHELL_FSONB_INT;
+        }
+    }
+
+    uint8_t tag = NOSHELL_FSONB_TAG(rep, type);
+    if (!noshell_bytes_put(out, &tag, 1))
+        return false;
+    if (rep == NOSHELL_FSONB_INT)
+        return noshell_bytes_put_u64(out, (uint64_t)ival);
+    return noshell_bytes_put_u32(out, (uint32_t)len) && noshell_bytes_put(out, p, len);
+}
+
+/**
+ * Appends the text of the value at v (which must end by end) to out,
+ * with its "type:" annotation when typed is set. Returns false when the
+ * encoding is damaged or out of memory.
+ */
+static bool noshell_fsonb_render(const uint8_t *v, const uint8_t *end, const noshell_fsonb_dict_t *dict, bool typed, noshell_bytes_t *out, int depth) {
+    if (depth > NOSHELL_FSONB_MAX_DEPTH || end - v < 1)
+        return false;
+    uint8_t type = NOSHELL_FSONB_TYPE(*v);
+    if (typed && type != NOSHELL_FSONB_UNTYPED) {
+        if (type > NOSHELL_FSON_TYPE_DURATION)
+            return false;
+        const char *name = noshell_fson_type_names[type];
+        if (!noshell_bytes_put(out, name, strlen(name)) || !noshell_bytes_put(out, ": ", 2))
+            return false;
+    }
+
+    switch (NOSHELL_FSONB_REP(*v)) {
+        case NOSHELL_FSONB_TEXT:
+        case NOSHELL_FSONB_STRING: {
+            if (end - v < 5 || (size_t)(end - v - 5) < noshell_fsonb_u32(v + 1))
+                return false;
+            bool quoted = NOSHELL_FSONB_REP(*v) == NOSHELL_FSONB_STRING;
+            return (!quoted || noshell_bytes_put(out, "\"", 1)) &&
+                   noshell_bytes_put(out, v + 5, noshell_fsonb_u32(v + 1)) &&
+                   (!quoted || noshell_bytes_put(out, "\"", 1));
+        }
+        case NOSHELL_FSONB_INT: {
+            if (end - v < 9)
+                return false;
+            char text[32];
+            int n = snprintf(text, sizeof(text), "%lld", (long long)noshell_fsonb_u64(v + 1));
+            return noshell_bytes_put(out, text, (size_t)n);
+        }
+        case NOSHELL_FSONB_OBJECT:
+        case NOSHELL_FSONB_ARRAY: {
+            bool object = NOSHELL_FSONB_REP(*v) == NOSHELL_FSONB_OBJECT;
+            size_t entry = object ? 8 : 4;
+            if (end - v < 9 || (size_t)(end - v - 5) < noshell_fsonb_u32(v + 1))
+                return false;
+            const uint8_t *stop = v + 5 + noshell_fsonb_u32(v + 1);
+            uint32_t count = noshell_fsonb_u32(v + 5);
+            if ((size_t)(stop - v - 9) / entry < count)
+                return false;
+            if (count == 0)
+                return noshell_bytes_put(out, object ? "{ }" : "[ ]", 3);
+            if (!noshell_bytes_put(out, object ? "{ " : "[ ", 2))
+                return false;
+            for (uint32_t i = 0; i < count; ++i) {
+                const uint8_t *at = v + 9 + i * entry;
+                if (i > 0 && !noshell_bytes_put(out, ", ", 2))
+                    return false;
+                if (object) {
+                    uint32_t id = noshell_fsonb_u32(at);
+                    if (id >= dict->count ||
+                        !noshell_bytes_put(out, dict->names[id], dict->lens[id]) ||
+                        !noshell_bytes_put(out, ": ", 2))
+                        return false;
+                }
+                uint32_t offset = noshell_fsonb_u32(at + entry - 4);
+                if (offset < 9 + count * entry || offset >= (size_t)(stop - v) ||
+                    !noshell_fsonb_render(v + offset, stop, dict, true, out, depth + 1))
+                    return false;
+            }
+            return noshell_bytes_put(out, object ? " }" : " ]", 2);
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * Finds the member named by 'path' (dotted for nested objects) in the
+ * object at v, which ends by *end. On success *end is narrowed to the
+ * member's container.
+ */
+static const uint8_t *noshell_fsonb_lookup(const uint8_t *v, const uint8_t **end, const noshell_fsonb_dict_t *dict, const char *path) {
+    for (;;) {
+        size_t seg_len = strcspn(path, ".");
+        uint32_t id;
+        if (*end - v < 9 || NOSHELL_FSONB_REP(*v) != NOSHELL_FSONB_OBJECT ||
+            (size_t)(*end - v - 5) < noshell_fsonb_u32(v + 1) ||
+            !noshell_fsonb_dict_find(dict, path, seg_len, &id))
+            return NULL;
+        const uint8_t *stop = v + 5 + noshell_fsonb_u32(v + 1);
+        uint32_t count = noshell_fsonb_u32(v + 5);
+        if ((size_t)(stop - v - 9) / 8 < count)
+            return NULL;
+        const uint8_t *member = NULL;
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint8_t *at = v + 9 + i * 8;
+            if (noshell_fsonb_u32(at) == id) {
+                uint32_t offset = noshell_fsonb_u32(at + 4);
+                if (offset < 9 + count * 8 || offset >= (size_t)(stop - v))
+                    return NULL;
+                member = v + offset;
+                break;
+            }
+        }
+        if (!member)
+            return NULL;
+        *end = stop;
+        if (path[seg_len] != '.')
+            return member;
+        v = member;
+        path += seg_len + 1;
+    }
+}
+
+/**
+ * The value at v as a view for comparisons, the way noshell_field_value
+ * sees it in text: no annotation, quotes stripped. Numbers and containers
+ * are rendered into scratch.
+ */
+static bool noshell_fsonb_view(const uint8_t *v, const uint8_t *end, const noshell_fsonb_dict_t *dict, noshell_bytes_t *scratch, const char **value, size_t *len) {
+    uint8_t rep = NOSHELL_FSONB_REP(*v);
+    if (rep == NOSHELL_FSONB_TEXT || rep == NOSHELL_FSONB_STRING) {
+        if (end - v < 5 || (size_t)(end - v - 5) < noshell_fsonb_u32(v + 1))
+            return false;
+        *value = (const char *)v + 5;
+        *len = noshell_fsonb_u32(v + 1);
+        if (rep == NOSHELL_FSONB_TEXT)
+            noshell_strip_quotes(value, len);
+        return true;
+    }
+    scratch->len = 0;
+    if (!noshell_fsonb_render(v, end, dict, false, scratch, 0))
+        return false;
+    *value = scratch->data;
+    *len = scratch->len;
+    return true;
+}
+
+/** One document record: encoded body and the text after it. */
+typedef struct {
+    const uint8_t *body;
+    const uint8_t *body_end;
+    const char    *trailer;     // NUL-terminated
+    size_t         trailer_len;
+} noshell_fsonb_doc_t;
+
+static bool noshell_fsonb_doc(const uint8_t *rec, size_t len, noshell_fsonb_doc_t *doc) {
+    if (len < 5 || rec[0] != NOSHELL_FSONB_DOC || noshell_fsonb_u32(rec + 1) > len - 5)
+        return false;
+    doc->body = rec + 5;
+    doc->body_end = doc->body + noshell_fsonb_u32(rec + 1);
+    doc->trailer = (const char *)doc->body_end;
+    doc->trailer_len = len - 5 - noshell_fsonb_u32(rec + 1);
+    return true;
+}
+
+static bool noshell_fsonb_pred_eval(const fossil_bluecrab_query_pred_t *pred, const noshell_fsonb_doc_t *doc, const noshell_fsonb_dict_t *dict, noshell_bytes_t *scratch) {
+    switch (pred->kind) {
+        case FOSSIL_QUERY_PRED_AND: return noshell_fsonb_pred_eval(pred->left, doc, dict, scratch) && noshell_fsonb_pred_eval(pred->right, doc, dict, scratch);
+        case FOSSIL_QUERY_PRED_OR:  return noshell_fsonb_pred_eval(pred->left, doc, dict, scratch) || noshell_fsonb_pred_eval(pred->right, doc, dict, scratch);
+        case FOSSIL_QUERY_PRED_NOT: return !noshell_fsonb_pred_eval(pred->left, doc, dict, scratch);
+        case FOSSIL_QUERY_PRED_CMP: break;
+    }
+
+    const char *value;
+    size_t len;
+    const char *tag = strcmp(pred->field, "_id") == 0 ? "#id=" : strcmp(pred->field, "_type") == 0 ? "#type=" : NULL;
+    if (tag) {
+        const char *pos = strstr(doc->trailer, tag);
+        if (!pos)
+            return false;
+        value = pos + strlen(tag);
+        len = strcspn(value, " \t\r\n");
+        noshell_strip_quotes(&value, &len);
+    } else {
+        const uint8_t *end = doc->body_end;
+        const uint8_t *member = noshell_fsonb_lookup(doc->body, &end, dict, pred->field);
+        if (!member || !noshell_fsonb_view(member, end, dict, scratch, &value, &len))
+            return false;
+    }
+    return fossil_bluecrab_query_compare(pred, value, len);
+}
+
+/** Appends the text line of a record (newline included) to out. */
+static bool noshell_fsonb_line(const uint8_t *rec, size_t len, const noshell_fsonb_dict_t *dict, noshell_bytes_t *out) {
+    if (len < 1)
+        return false;
+    if (rec[0] == NOSHELL_FSONB_LINE)
+        return noshell_bytes_put(out, rec + 1, len - 1);
+    noshell_fsonb_doc_t doc;
+    return noshell_fsonb_doc(rec, len, &doc) &&
+           noshell_fsonb_render(doc.body, doc.body_end, dict, true, out, 0) &&
+           (doc.trailer_len == 0 || noshell_bytes_put(out, doc.trailer, doc.trailer_len));
+}
+
+/** An open image: its dictionary and a cursor over the records. */
+typedef struct {
+    FILE                 *fp;
+    noshell_fsonb_dict_t  dict;
+    uint64_t              records_end;      // where the dictionary starts
+    uint64_t              pos;
+    uint8_t              *rec;              // current record, NUL-terminated
+    size_t                cap;
+} noshell_fsonb_file_t;
+
+static void noshell_fsonb_close(noshell_fsonb_file_t *f) {
+    if (f->fp)
+        fclose(f->fp);
+    noshell_fsonb_dict_free(&f->dict);
+    free(f->rec);
+    memset(f, 0, sizeof(*f));
+}
+
+static fossil_bluecrab_noshell_error_t noshell_fsonb_open(const char *path, noshell_fsonb_file_t *f) {
+    memset(f, 0, sizeof(*f));
+    f->fp = fopen(path, "rb");
+    if (!f->fp)
+        return FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND;
+
+    uint8_t head[NOSHELL_FSONB_MAGIC_LEN], foot[NOSHELL_FSONB_FOOTER_LEN];
+    long size = -1;
+    if (fread(head, 1, sizeof(head), f->fp) == sizeof(head) && fseek(f->fp, 0, SEEK_END) == 0)
+        size = ftell(f->fp);
+    if (size < (long)(sizeof(head) + 4 + sizeof(foot)) ||
+        memcmp(head, NOSHELL_FSONB_MAGIC, NOSHELL_FSONB_MAGIC_LEN) != 0 ||
+        fseek(f->fp, size - (long)sizeof(foot), SEEK_SET) != 0 ||
+        fread(foot, 1, sizeof(foot), f->fp) != sizeof(foot) ||
+        memcmp(foot + 16, NOSHELL_FSONB_MAGIC, NOSHELL_FSONB_MAGIC_LEN) != 0) {
+        noshell_fsonb_close(f);
+        return FOSSIL_NOSHELL_ERROR_SCHEMA_MISMATCH;
+    }
+
+    // Dictionary, between the records and the footer
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    uint64_t dict_at = noshell_fsonb_u64(foot);
+    uint64_t dict_end = (uint64_t)size - sizeof(foot);
+    uint8_t word[4];
+    if (dict_at < sizeof(head) || dict_at + 4 > dict_end ||
+        fseek(f->fp, (long)dict_at, SEEK_SET) != 0 || fread(word, 1, 4, f->fp) != 4)
+        rc = FOSSIL_NOSHELL_ERROR_CORRUPTED;
+    uint64_t at = dict_at + 4;
+    uint32_t count = rc == FOSSIL_NOSHELL_ERROR_SUCCESS ? noshell_fsonb_u32(word) : 0;
+    char *name = NULL;
+    for (uint32_t i = 0; rc == FOSSIL_NOSHELL_ERROR_SUCCESS && i < count; ++i) {
+        uint32_t len = 0, id;
+        if (at + 4 > dict_end || fread(word, 1, 4, f->fp) != 4 ||
+            (len = noshell_fsonb_u32(word), at + 4 + len > dict_end)) {
+            rc = FOSSIL_NOSHELL_ERROR_CORRUPTED;
+            break;
+        }
+        char *grown = (char *)realloc(name, (size_t)len + 1);
+        if (!grown) {
+            rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        name = grown;
+        if (fread(name, 1, len, f->fp) != len)
+            rc = FOSSIL_NOSHELL_ERROR_CORRUPTED;
+        else if (!noshell_fsonb_dict_add(&f->dict, name, len, &id))
+            rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        else if (id != i)
+            rc = FOSSIL_NOSHELL_ERROR_CORRUPTED;    // duplicate name
+        at += 4 + len;
+    }
+    free(name);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_fsonb_close(f);
+        return rc;
+    }
+    f->records_end = dict_at;
+    f->pos = sizeof(head);
+    if (fseek(f->fp, (long)f->pos, SEEK_SET) != 0) {
+        noshell_fsonb_close(f);
+        return FOSSIL_NOSHELL_ERROR_IO;
+    }
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+/**
+ * Reads the next record into f->rec. Returns NOT_FOUND after the last
+ * one.
+ */
+static fossil_bluecrab_noshell_error_t noshell_fsonb_next(noshell_fsonb_file_t *f, size_t *len) {
+    if (f->pos >= f->records_end)
+        return FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    uint8_t word[4];
+    if (f->pos + 4 > f->records_end || fread(word, 1, 4, f->fp) != 4)
+        return FOSSIL_NOSHELL_ERROR_CORRUPTED;
+    uint32_t n = noshell_fsonb_u32(word);
+    if (n == 0 || f->pos + 4 + n > f->records_end)
+        return FOSSIL_NOSHELL_ERROR_CORRUPTED;
+    if (f->cap < (size_t)n + 1) {
+        uint8_t *grown = (uint8_t *)realloc(f->rec, (size_t)n + 1);
+        if (!grown)
+            return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        f->rec = grown;
+        f->cap = (size_t)n + 1;
+    }
+    if (fread(f->rec, 1, n, f->fp) != n)
+        return FOSSIL_NOSHELL_ERROR_IO;
+    f->rec[n] = '\0';
+    f->pos += 4 + n;
+    *len = n;
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+/** Writes one record: its length, the kind byte and the payload pieces. */
+static bool noshell_fsonb_write_record(FILE *out, uint8_t kind, const void *a, size_t a_len, const void *b, size_t b_len) {
+    uint64_t n = 1 + (uint64_t)a_len + b_len;
+    uint8_t head[5] = { (uint8_t)n, (uint8_t)(n >> 8), (uint8_t)(n >> 16), (uint8_t)(n >> 24), kind };
+    return n <= UINT32_MAX &&
+           fwrite(head, 1, sizeof(head), out) == sizeof(head) &&
+           fwrite(a, 1, a_len, out) == a_len &&
+           (b_len == 0 || fwrite(b, 1, b_len, out) == b_len);
+}
+
+/**
+ * Writes one line as a DOC record when its body encodes and decodes back
+ * to the same bytes, otherwise as a LINE record. body and check are
+ * scratch buffers.
+ */
+static bool noshell_fsonb_export_line(FILE *out, const char *line, size_t len, noshell_fsonb_dict_t *dict, noshell_bytes_t *body, noshell_bytes_t *check) {
+    static const uint8_t no_size[4] = {0};
+    body->len = 0;
+    check->len = 0;
+    const char *p = line;
+    if ((*p == '{' || *p == '[') && noshell_bytes_put(body, no_size, sizeof(no_size)) &&
+        noshell_fsonb_encode_value(&p, dict, body, 0) &&
+        noshell_fsonb_render((const uint8_t *)body->data + 4, (const uint8_t *)body->data + body->len, dict, true, check, 0) &&
+        check->len == (size_t)(p - line) && memcmp(check->data, line, check->len) == 0) {
+        uint32_t n = (uint32_t)(body->len - 4);
+        uint8_t *size = (uint8_t *)body->data;
+        size[0] = (uint8_t)n;
+        size[1] = (uint8_t)(n >> 8);
+        size[2] = (uint8_t)(n >> 16);
+        size[3] = (uint8_t)(n >> 24);
+        return noshell_fsonb_write_record(out, NOSHELL_FSONB_DOC, body->data, body->len, p, len - (size_t)(p - line));
+    }
+    return noshell_fsonb_write_record(out, NOSHELL_FSONB_LINE, line, len, NULL, 0);
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_export_binary(const char *file_name, const char *binary_file) {
+    if (!file_name || !binary_file || !fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+    if (noshell_lsm_enabled(file_name))
+        return FOSSIL_NOSHELL_ERROR_UNSUPPORTED;
+
+    FILE *in = fopen(file_name, "rb");
+    if (!in)
+        return FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND;
+    noshell_tombs_t tombs;
+    fossil_bluecrab_noshell_error_t rc = noshell_tombs_load(file_name, in, &tombs);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        fclose(in);
+        return rc;
+    }
+    FILE *out = fopen(binary_file, "wb");
+    if (!out) {
+        noshell_tombs_free(&tombs);
+        fclose(in);
+        return FOSSIL_NOSHELL_ERROR_IO;
+    }
+
+    // Same lines noshell_copy_live keeps: headers and live documents
+    noshell_fsonb_dict_t dict = {0};
+    noshell_bytes_t body = {0}, check = {0};
+    uint64_t records = 0, offset = 0;
+    bool ok = fwrite(NOSHELL_FSONB_MAGIC, 1, NOSHELL_FSONB_MAGIC_LEN, out) == NOSHELL_FSONB_MAGIC_LEN &&
+              fseek(in, 0, SEEK_SET) == 0;
+    noshell_reader_t reader;
+    noshell_reader_init(&reader, in);
+    char *line;
+    size_t len;
+    while (ok && (line = noshell_reader_next(&reader, &len)) != NULL) {
+        uint64_t at = offset;
+        offset += len;
+        uint64_t dead_at, dead_len;
+        if (line[0] == '#' ? noshell_tomb_parse(line, &dead_at, &dead_len)
+                           : !noshell_is_document(line) || noshell_tombs_has(&tombs, at))
+            continue;
+        ok = noshell_fsonb_export_line(out, line, len, &dict, &body, &check);
+        records++;
+    }
+    ok = ok && !ferror(in);
+    noshell_reader_free(&reader);
+    noshell_tombs_free(&tombs);
+    fclose(in);
+
+    // Dictionary and footer
+    long dict_at = ok ? ftell(out) : -1;
+    body.len = 0;
+    ok = dict_at > 0 && noshell_bytes_put_u32(&body, dict.count);
+    for (uint32_t i = 0; ok && i < dict.count; ++i)
+        ok = noshell_bytes_put_u32(&body, dict.lens[i]) && noshell_bytes_put(&body, dict.names[i], dict.lens[i]);
+    ok = ok && noshell_bytes_put_u64(&body, (uint64_t)dict_at) && noshell_bytes_put_u64(&body, records) &&
+         noshell_bytes_put(&body, NOSHELL_FSONB_MAGIC, NOSHELL_FSONB_MAGIC_LEN) &&
+         fwrite(body.data, 1, body.len, out) == body.len;
+    ok = fclose(out) == 0 && ok;
+    noshell_fsonb_dict_free(&dict);
+    free(body.data);
+    free(check.data);
+    if (!ok) {
+        remove(binary_file);
+        return FOSSIL_NOSHELL_ERROR_IO;
+    }
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_import_binary(const char *binary_file, const char *file_name) {
+    if (!file_name || !binary_file || !fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_fsonb_file_t f;
+    fossil_bluecrab_noshell_error_t rc = noshell_fsonb_open(binary_file, &f);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+    noshell_lsm_drop(file_name);
+    FILE *out = fopen(file_name, "wb");
+    if (!out) {
+        noshell_fsonb_close(&f);
+        return FOSSIL_NOSHELL_ERROR_IO;
+    }
+
+    noshell_bytes_t text = {0};
+    size_t len;
+    while ((rc = noshell_fsonb_next(&f, &len)) == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        text.len = 0;
+        if (!noshell_fsonb_line(f.rec, len, &f.dict, &text)) {
+            rc = FOSSIL_NOSHELL_ERROR_CORRUPTED;
+            break;
+        }
+        if (fwrite(text.data, 1, text.len, out) != text.len) {
+            rc = FOSSIL_NOSHELL_ERROR_IO;
+            break;
+        }
+    }
+    if (rc == FOSSIL_NOSHELL_ERROR_NOT_FOUND)
+        rc = noshell_durable(file_name, out);
+    if (fclose(out) != 0 && rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+        rc = FOSSIL_NOSHELL_ERROR_IO;
+    free(text.data);
+    noshell_fsonb_close(&f);
+    noshell_file_invalidate(file_name);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_binary_find_cb(
+    const char *binary_file,
+    const char *query,
+    bool (*cb)(const char *document, void *userdata),
+    void *userdata
+) {
+    if (!binary_file || !cb)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_matcher_t matcher = { NULL, NULL };
+    fossil_bluecrab_noshell_error_t rc;
+    if (query && query[0] && (rc = noshell_matcher_init(&matcher, query)) != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+    noshell_fsonb_file_t f;
+    rc = noshell_fsonb_open(binary_file, &f);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_matcher_free(&matcher);
+        return rc;
+    }
+
+    // WHERE queries run on the encoding; only hits are turned into text
+    noshell_bytes_t text = {0}, scratch = {0};
+    size_t len;
+    bool stopped = false;
+    while (!stopped && (rc = noshell_fsonb_next(&f, &len)) == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_fsonb_doc_t doc;
+        bool is_doc = noshell_fsonb_doc(f.rec, len, &doc);
+        if (matcher.compiled && is_doc &&
+            !noshell_fsonb_pred_eval(matcher.compiled->where, &doc, &f.dict, &scratch))
+            continue;
+        text.len = 0;
+        if (!noshell_fsonb_line(f.rec, len, &f.dict, &text) || !noshell_bytes_put(&text, "", 1)) {
+            rc = FOSSIL_NOSHELL_ERROR_CORRUPTED;
+            break;
+        }
+        if (!is_doc && (text.data[0] == '#' || !noshell_is_document(text.data)))
+            continue;
+        if (matcher.text && !(is_doc && matcher.compiled) && !noshell_matcher_test(&matcher, text.data))
+            continue;
+        stopped = cb(text.data, userdata);
+    }
+    if (stopped)
+        rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    free(text.data);
+    free(scratch.data);
+    noshell_fsonb_close(&f);
+    noshell_matcher_free(&matcher);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_binary_get_field(
+    const char *binary_file,
+    const char *id,
+    const char *field,
+    char *value,
+    size_t buffer_size
+) {
+    if (!binary_file || !id || !field || !value || buffer_size == 0)
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_fsonb_file_t f;
+    fossil_bluecrab_noshell_error_t rc = noshell_fsonb_open(binary_file, &f);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+
+    size_t id_len = strlen(id), len;
+    noshell_bytes_t scratch = {0};
+    while ((rc = noshell_fsonb_next(&f, &len)) == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        // Documents kept as text records are read the text way
+        noshell_fsonb_doc_t doc;
+        bool is_doc = noshell_fsonb_doc(f.rec, len, &doc);
+        const char *line = (const char *)f.rec + 1;
+        const char *doc_id;
+        size_t doc_id_len;
+        if (is_doc) {
+            const char *tag = strstr(doc.trailer, "#id=");
+            if (!tag)
+                continue;
+            doc_id = tag + 4;
+            doc_id_len = strcspn(doc_id, " \t\r\n");
+        } else if (line[0] == '#' || !noshell_is_document(line) || !noshell_line_tag(line, "#id=", &doc_id, &doc_id_len)) {
+            continue;
+        }
+        if (doc_id_len != id_len || strncmp(doc_id, id, id_len) != 0)
+            continue;
+
+        const char *view;
+        size_t view_len;
+        bool found;
+        if (is_doc) {
+            const uint8_t *end = doc.body_end;
+            const uint8_t *member = noshell_fsonb_lookup(doc.body, &end, &f.dict, field);
+            found = member && noshell_fsonb_view(member, end, &f.dict, &scratch, &view, &view_len);
+        } else {
+            found = noshell_field_value(line, field, &view, &view_len);
+        }
+        if (!found) {
+            rc = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+        } else if (view_len >= buffer_size) {
+            rc = FOSSIL_NOSHELL_ERROR_BUFFER_TOO_SMALL;
+        } else {
+            memcpy(value, view, view_len);
+            value[view_len] = '\0';
+        }
+        break;
+    }
+    free(scratch.data);
+    noshell_fsonb_close(&f);
+    return rc;
+}
+
+// ===========================================================
+// LSM Engine
+// ===========================================================
+
+/*
+ * A database switched to the LSM engine keeps its documents in a
+ * log-structured merge tree keyed by document id instead of one
+ * append-only text file. The files of "db.noshell":
+ *
+ *   db.noshell             header and "#engine=lsm", no documents
+ *   db.noshell.lsm         manifest: options, next sequence number, live
+ *                          logs and the segments of each level
+ *   db.noshell.<seq>.wal   write-ahead log of a memtable: document lines as
+ *                          text mode writes them, "#del=<id>" for removals
+ *   db.noshell.<seq>.seg   immutable sorted segment
+ *
+ * Writes append to the log and go into the memtable (a hash on id). A
+ * full memtable is frozen and written out as a level-0 segment by the
+ * store's worker thread; a writer that finds the frozen one still there
+ * writes it out itself or waits, which bounds memory. Level-0 segments may
+ * overlap; levels 1 and up hold non-overlapping segments sorted by id,
+ * each level_ratio times the size of the one above. level0_segments
+ * level-0 segments are merged into the overlapping level-1 ones, and a
+ * level over its budget pushes one segment (round robin over the id
+ * space) into the next; the level furthest over its budget goes first.
+ * Writers wait while level 0 is NOSHELL_LSM_L0_STALL
+ * times over its trigger, which bounds the segments a read may touch.
+ * Removals stay tombstones until they reach the deepest populated level.
+ *
+ * Segment layout (integers little-endian):
+ *
+ *   "NSLSM\0\1\0"
+ *   entry*      u64 id, u32 length (NOSHELL_LSM_TOMB for a removal), line
+ *   fence       count x (u64 first id, u64 offset), one per ~4 KiB block
+ *   bloom       words x u64
+ *   footer      u64 fence offset, u64 fence count, u64 bloom words,
+ *               u64 entries, u64 min id, u64 max id, u32 bloom hashes,
+ *               u32 reserved, "NSLSM\0\1\0"
+ *
+ * A point read checks the memtables, each level-0 segment newest first and
+ * at most one segment per deeper level; a segment is skipped on its id
+ * range or bloom filter, and otherwise costs one block read through its
+ * fence. Scans merge all of them in id order, the newest version of an id
+ * winning, over a snapshot (copied memtables, referenced segments) so the
+ * callback runs without the store mutex. Segment files outlive their
+ * level while a scan or merge still references them.
+ *
+ * Stores are process-wide and keyed by path like handles. The file-name
+ * functions route to the store when the manifest exists, opening it on
+ * first use; it stays open until lsm_close, lsm_disable or
+ * delete_database. Only one process may write a store at a time.
+ */
+
+#define NOSHELL_LSM_MAGIC      "NSLSM\0\1\0"
+#define NOSHELL_LSM_MAGIC_LEN  8
+#define NOSHELL_LSM_FOOTER_LEN (56 + NOSHELL_LSM_MAGIC_LEN)
+#define NOSHELL_LSM_HEAD_LEN   12
+#define NOSHELL_LSM_BLOCK      4096
+#define NOSHELL_LSM_TOMB       UINT32_MAX
+#define NOSHELL_LSM_ENTRY_COST 48           // memtable bytes per entry besides its line
+#define NOSHELL_LSM_L0_STALL   3
+
+static const char noshell_lsm_header[] =
+    "#fson_types=null,bool,i8,i16,i32,i64,u8,u16,u32,u64,f32,f64,oct,hex,bin,char,cstr,array,object,enum,datetime,duration\n";
+
+typedef struct {
+    uint64_t id;
+    char    *line;          // NUL-terminated, NULL for a removal
+    size_t   len;
+} noshell_lsm_entry_t;
+
+typedef struct {
+    noshell_lsm_entry_t *entries;
+    size_t  count;
+    size_t  cap;
+    size_t *slots;          // entry index + 1, 0 = empty
+    size_t  slot_count;     // power of two, or 0
+    size_t  bytes;          // lines plus NOSHELL_LSM_ENTRY_COST per entry
+    bool    sorted;         // entries in id order
+} noshell_lsm_memtable_t;
+
+typedef struct {
+    uint64_t  seq;
+    char     *path;
+    FILE     *fp;           // point reads, under the store mutex
+    uint64_t  size;
+    uint64_t  count;
+    uint64_t  min_id;
+    uint64_t  max_id;
+    uint64_t  data_end;     // where the fence starts
+    uint64_t *fence;        // fence_count x (first id, offset)
+    size_t    fence_count;
+    uint64_t *bloom;
+    size_t    bloom_words;
+    unsigned  bloom_hashes;
+    size_t    refs;         // level membership, scans and merges
+    bool      obsolete;     // remove the file with the last reference
+} noshell_lsm_segment_t;
+
+typedef struct {
+    noshell_lsm_segment_t **segs;   // level 0 newest first, deeper levels by id
+    size_t count;
+    size_t cap;
+} noshell_lsm_level_t;
+
+struct noshell_lsm_t {
+    char    *path;
+    noshell_file_t *file;           // registry entry, referenced while open
+    size_t   refs;                  // registry and borrowers, under file->lsm_mutex
+    fossil_bluecrab_noshell_lsm_options_t options;
+    fossil_bluecrab_thread_mutex_t  mutex;
+    fossil_bluecrab_thread_cond_t   cond;          // worker wake-ups and writer stalls
+    fossil_bluecrab_thread_t thread;
+    bool     running;
+    bool     stop;
+    bool     dropping;              // files are about to go; skip the final flush
+    bool     flushing;
+    bool     merging;
+    fossil_bluecrab_noshell_error_t failed;   // background failure, returned to writers
+    noshell_lsm_memtable_t mem;
+    noshell_lsm_memtable_t imm;     // frozen, being written out
+    bool     has_imm;
+    uint64_t imm_wal;
+    FILE    *wal;
+    uint64_t wal_seq;
+    uint64_t next_seq;
+    noshell_lsm_level_t levels[FOSSIL_NOSHELL_LSM_LEVELS];
+    uint64_t cursor[FOSSIL_NOSHELL_LSM_LEVELS];     // round robin per level
+    size_t   flushes;
+    size_t   compactions;
+    char    *block;                 // point-read buffer
+    size_t   block_cap;
+};
+
+static char *noshell_lsm_file(const char *file_name, uint64_t seq, const char *kind) {
+    char suffix[48];
+    snprintf(suffix, sizeof(suffix), ".%" PRIu64 ".%s", seq, kind);
+    return noshell_meta_path(file_name, suffix);
+}
+
+static void noshell_lsm_remove_file(const char *file_name, uint64_t seq, const char *kind) {
+    char *path = noshell_lsm_file(file_name, seq, kind);
+    if (path)
+        remove(path);
+    free(path);
+}
+
+static bool noshell_lsm_replace(const char *tmp_path, const char *path) {
+#if defined(_WIN32) || defined(_WIN64)
+    return MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(tmp_path, path) == 0;
+#endif
+}
+
+static void noshell_lsm_le32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; ++i)
+        p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void noshell_lsm_le64(uint8_t *p, uint64_t v) {
+    noshell_lsm_le32(p, (uint32_t)v);
+    noshell_lsm_le32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint64_t noshell_lsm_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static void noshell_lsm_options_fix(fossil_bluecrab_noshell_lsm_options_t *o) {
+    if (!o->memtable_bytes) o->memtable_bytes = 4u << 20;
+    if (!o->segment_bytes) o->segment_bytes = 2u << 20;
+    if (!o->level0_segments) o->level0_segments = 4;
+    if (o->level_ratio < 2) o->level_ratio = 10;
+    if (!o->bloom_bits) o->bloom_bits = 10;
+    if (o->bloom_bits > 32) o->bloom_bits = 32;
+}
+
+// ---- memtable -------------------------------------------------------------
+
+static noshell_lsm_entry_t *noshell_lsm_mem_find(const noshell_lsm_memtable_t *m, uint64_t id) {
+    if (!m->slot_count)
+        return NULL;
+    size_t mask = m->slot_count - 1;
+    for (size_t i = (size_t)noshell_lsm_mix(id) & mask;; i = (i + 1) & mask) {
+        size_t slot = m->slots[i];
+        if (!slot)
+            return NULL;
+        if (m->entries[slot - 1].id == id)
+            return &m->entries[slot - 1];
+    }
+}
+
+static bool noshell_lsm_mem_rehash(noshell_lsm_memtable_t *m, size_t slot_count) {
+    size_t *slots = (size_t *)calloc(slot_count, sizeof(*slots));
+    if (!slots)
+        return false;
+    size_t mask = slot_count - 1;
+    for (size_t e = 0; e < m->count; ++e) {
+        size_t i = (size_t)noshell_lsm_mix(m->entries[e].id) & mask;
+        while (slots[i])
+            i = (i + 1) & mask;
+        slots[i] = e + 1;
+    }
+    free(m->slots);
+    m->slots = slots;
+    m->slot_count = slot_count;
+    return true;
+}
+
+/**
+ * Sets the version of id (line NULL for a removal). The memtable takes
+ * line, which must be malloc'd and NUL-terminated, unless this fails.
+ */
+static bool noshell_lsm_mem_put(noshell_lsm_memtable_t *m, uint64_t id, char *line, size_t len) {
+    noshell_lsm_entry_t *e = noshell_lsm_mem_find(m, id);
+    if (e) {
+        m->bytes = m->bytes - e->len + len;
+        free(e->line);
+        e->line = line;
+        e->len = len;
+        return true;
+    }
+    if ((m->count + 1) * 2 > m->slot_count && !noshell_lsm_mem_rehash(m, m->slot_count ? m->slot_count * 2 : 1024))
+        return false;
+    if (m->count == m->cap) {
+        size_t cap = m->cap ? m->cap * 2 : 512;
+        noshell_lsm_entry_t *grown = (noshell_lsm_entry_t *)realloc(m->entries, cap * sizeof(*grown));
+        if (!grown)
+            return false;
+        m->entries = grown;
+        m->cap = cap;
+    }
+    m->entries[m->count].id = id;
+    m->entries[m->count].line = line;
+    m->entries[m->count].len = len;
+    size_t mask = m->slot_count - 1;
+    size_t i = (size_t)noshell_lsm_mix(id) & mask;
+    while (m->slots[i])
+        i = (i + 1) & mask;
+    m->slots[i] = ++m->count;
+    m->bytes += len + NOSHELL_LSM_ENTRY_COST;
+    m->sorted = m->count == 1 || (m->sorted && m->entries[m->count - 2].id < id);
+    return true;
+}
+
+static int noshell_lsm_entry_cmp(const void *a, const void *b) {
+    uint64_t x = ((const noshell_lsm_entry_t *)a)->id;
+    uint64_t y = ((const noshell_lsm_entry_t *)b)->id;
+    return x < y ? -1 : x > y;
+}
+
+static void noshell_lsm_mem_sort(noshell_lsm_memtable_t *m) {
+    if (m->sorted || !m->count)
+        return;
+    qsort(m->entries, m->count, sizeof(*m->entries), noshell_lsm_entry_cmp);
+    // Same table size: slots are rebuilt in place
+    memset(m->slots, 0, m->slot_count * sizeof(*m->slots));
+    size_t mask = m->slot_count - 1;
+    for (size_t e = 0; e < m->count; ++e) {
+        size_t i = (size_t)noshell_lsm_mix(m->entries[e].id) & mask;
+        while (m->slots[i])
+            i = (i + 1) & mask;
+        m->slots[i] = e + 1;
+    }
+    m->sorted = true;
+}
+
+static void noshell_lsm_mem_free(noshell_lsm_memtable_t *m) {
+    for (size_t i = 0; i < m->count; ++i)
+        free(m->entries[i].line);
+    free(m->entries);
+    free(m->slots);
+    memset(m, 0, sizeof(*m));
+}
+
+/** Copies a sorted memtable into one entry array and one line arena. */
+static bool noshell_lsm_mem_copy(const noshell_lsm_memtable_t *m, noshell_lsm_entry_t **entries, char **arena) {
+    size_t bytes = 1;
+    for (size_t i = 0; i < m->count; ++i)
+        bytes += m->entries[i].len + 1;
+    *entries = (noshell_lsm_entry_t *)malloc(m->count * sizeof(**entries));
+    *arena = (char *)malloc(bytes);
+    if (!*entries || !*arena)
+        return false;
+    char *at = *arena;
+    for (size_t i = 0; i < m->count; ++i) {
+        (*entries)[i] = m->entries[i];
+        if (m->entries[i].line) {
+            memcpy(at, m->entries[i].line, m->entries[i].len + 1);
+            (*entries)[i].line = at;
+            at += m->entries[i].len + 1;
+        }
+    }
+    return true;
+}
+
+// ---- segments -------------------------------------------------------------
+
+static unsigned noshell_lsm_bloom_hashes(unsigned bits_per_key) {
+    unsigned k = bits_per_key * 69 / 100;
+    return k < 1 ? 1 : k > 16 ? 16 : k;
+}
+
+static void noshell_lsm_bloom_add(uint64_t *bloom, size_t words, unsigned hashes, uint64_t id) {
+    uint64_t h = noshell_lsm_mix(id), step = ((h >> 32) | (h << 32)) | 1, bits = (uint64_t)words * 64;
+    for (unsigned i = 0; i < hashes; ++i, h += step) {
+        uint64_t bit = h % bits;
+        bloom[bit >> 6] |= 1ULL << (bit & 63);
+    }
+}
+
+static bool noshell_lsm_bloom_test(const noshell_lsm_segment_t *seg, uint64_t id) {
+    uint64_t h = noshell_lsm_mix(id), step = ((h >> 32) | (h << 32)) | 1, bits = (uint64_t)seg->bloom_words * 64;
+    for (unsigned i = 0; i < seg->bloom_hashes; ++i, h += step) {
+        uint64_t bit = h % bits;
+        if (!(seg->bloom[bit >> 6] & (1ULL << (bit & 63))))
+            return false;
+    }
+    return true;
+}
+
+static void noshell_lsm_segment_free(noshell_lsm_segment_t *seg) {
+    if (seg->fp)
+        fclose(seg->fp);
+    if (seg->obsolete)
+        remove(seg->path);
+    free(seg->fence);
+    free(seg->bloom);
+    free(seg->path);
+    free(seg);
+}
+
+/** Drops one reference; call with the store mutex held once the store is shared. */
+static void noshell_lsm_segment_release(noshell_lsm_segment_t *seg) {
+    if (seg && --seg->refs == 0)
+        noshell_lsm_segment_free(seg);
+}
+
+/**
+ * Opens a segment file and loads its footer, fence and bloom filter. The
+ * segment starts with the reference of the level it goes into.
+ */
+static noshell_lsm_segment_t *noshell_lsm_segment_load(const char *path, uint64_t seq) {
+    noshell_lsm_segment_t *seg = (noshell_lsm_segment_t *)calloc(1, sizeof(*seg));
+    FILE *fp = seg ? fopen(path, "rb") : NULL;
+    uint8_t foot[NOSHELL_LSM_FOOTER_LEN];
+    bool ok = fp && fseek(fp, 0, SEEK_END) == 0;
+    long end = ok ? ftell(fp) : -1;
+    ok = ok && end >= (long)(NOSHELL_LSM_MAGIC_LEN + NOSHELL_LSM_FOOTER_LEN) &&
+         fseek(fp, end - NOSHELL_LSM_FOOTER_LEN, SEEK_SET) == 0 &&
+         fread(foot, 1, sizeof(foot), fp) == sizeof(foot) &&
+         memcmp(foot + 56, NOSHELL_LSM_MAGIC, NOSHELL_LSM_MAGIC_LEN) == 0;
+    uint64_t fence_count = 0, words = 0;
+    if (ok) {
+        seg->size = (uint64_t)end;
+        seg->data_end = noshell_fsonb_u64(foot);
+        fence_count = noshell_fsonb_u64(foot + 8);
+        words = noshell_fsonb_u64(foot + 16);
+        seg->count = noshell_fsonb_u64(foot + 24);
+        seg->min_id = noshell_fsonb_u64(foot + 32);
+        seg->max_id = noshell_fsonb_u64(foot + 40);
+        seg->bloom_hashes = noshell_fsonb_u32(foot + 48);
+        ok = seg->data_end >= NOSHELL_LSM_MAGIC_LEN && fence_count > 0 && words > 0 &&
+             fence_count <= seg->size / 16 && words <= seg->size / 8 &&
+             seg->bloom_hashes >= 1 && seg->bloom_hashes <= 16 && seg->min_id <= seg->max_id &&
+             seg->data_end + fence_count * 16 + words * 8 + NOSHELL_LSM_FOOTER_LEN == seg->size;
+    }
+    size_t table = (size_t)(fence_count * 16 + words * 8);
+    uint8_t *raw = ok ? (uint8_t *)malloc(table) : NULL;
+    if (raw) {
+        seg->fence_count = (size_t)fence_count;
+        seg->bloom_words = (size_t)words;
+        seg->fence = (uint64_t *)malloc(seg->fence_count * 2 * sizeof(uint64_t));
+        seg->bloom = (uint64_t *)malloc(seg->bloom_words * sizeof(uint64_t));
+        seg->path = noshell_strdup(path);
+    }
+    ok = raw && seg->fence && seg->bloom && seg->path &&
+         fseek(fp, (long)seg->data_end, SEEK_SET) == 0 && fread(raw, 1, table, fp) == table;
+    for (size_t i = 0; ok && i < seg->fence_count * 2; ++i)
+        seg->fence[i] = noshell_fsonb_u64(raw + i * 8);
+    for (size_t i = 0; ok && i < seg->bloom_words; ++i)
+        seg->bloom[i] = noshell_fsonb_u64(raw + seg->fence_count * 16 + i * 8);
+    free(raw);
+    if (!ok) {
+        if (fp)
+            fclose(fp);
+        if (seg) {
+            free(seg->fence);
+            free(seg->bloom);
+            free(seg->path);
+            free(seg);
+        }
+        return NULL;
+    }
+    seg->fp = fp;
+    seg->seq = seq;
+    seg->refs = 1;
+    return seg;
+}
+
+/** Index of the last block whose first id is <= id (0 when id is below all). */
+static size_t noshell_lsm_fence_find(const noshell_lsm_segment_t *seg, uint64_t id) {
+    size_t lo = 0, hi = seg->fence_count;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (seg->fence[2 * mid] <= id)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Point read in one segment through the store's block buffer (store mutex
+ * held). SUCCESS sets *line (NULL for a removal) and *len, NOT_FOUND means
+ * the segment holds no version of id.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_segment_get(
+    noshell_lsm_t *s, noshell_lsm_segment_t *seg, uint64_t id, const char **line, size_t *len
+) {
+    if (id < seg->min_id || id > seg->max_id || !noshell_lsm_bloom_test(seg, id))
+        return FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    size_t block = noshell_lsm_fence_find(seg, id);
+    uint64_t start = seg->fence[2 * block + 1];
+    uint64_t end = block + 1 < seg->fence_count ? seg->fence[2 * block + 3] : seg->data_end;
+    if (start < NOSHELL_LSM_MAGIC_LEN || end < start || end > seg->data_end)
+        return FOSSIL_NOSHELL_ERROR_CORRUPTED;
+    size_t n = (size_t)(end - start);
+    if (n + 1 > s->block_cap) {
+        char *grown = (char *)realloc(s->block, n + 1);
+        if (!grown)
+            return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        s->block = grown;
+        s->block_cap = n + 1;
+    }
+    if (fseek(seg->fp, (long)start, SEEK_SET) != 0 || fread(s->block, 1, n, seg->fp) != n)
+        return FOSSIL_NOSHELL_ERROR_IO;
+
+    const uint8_t *p = (const uint8_t *)s->block;
+    for (size_t at = 0; at + NOSHELL_LSM_HEAD_LEN <= n;) {
+        uint64_t entry_id = noshell_fsonb_u64(p + at);
+        uint32_t entry_len = noshell_fsonb_u32(p + at + 8);
+        size_t body = entry_len == NOSHELL_LSM_TOMB ? 0 : entry_len;
+        if (body > n - at - NOSHELL_LSM_HEAD_LEN)
+            return FOSSIL_NOSHELL_ERROR_CORRUPTED;
+        if (entry_id == id) {
+            *line = entry_len == NOSHELL_LSM_TOMB ? NULL : s->block + at + NOSHELL_LSM_HEAD_LEN;
+            *len = body;
+            return FOSSIL_NOSHELL_ERROR_SUCCESS;
+        }
+        if (entry_id > id)
+            break;
+        at += NOSHELL_LSM_HEAD_LEN + body;
+    }
+    return FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+}
+
+/** Streams sorted entries into a new segment file. */
+typedef struct {
+    FILE     *fp;
+    char     *path;
+    uint64_t  seq;
+    uint64_t  pos;
+    uint64_t  block_start;
+    noshell_bytes_t tail;   // fence, then bloom and footer
+    uint64_t *ids;
+    size_t    count;
+    size_t    id_cap;
+    uint64_t  min_id;
+    uint64_t  max_id;
+    bool      ok;
+} noshell_lsm_writer_t;
+
+static void noshell_lsm_writer_open(noshell_lsm_writer_t *w, const char *file_name, uint64_t seq) {
+    memset(w, 0, sizeof(*w));
+    w->seq = seq;
+    w->path = noshell_lsm_file(file_name, seq, "seg");
+    w->fp = w->path ? fopen(w->path, "wb") : NULL;
+    w->ok = w->fp && fwrite(NOSHELL_LSM_MAGIC, 1, NOSHELL_LSM_MAGIC_LEN, w->fp) == NOSHELL_LSM_MAGIC_LEN;
+    w->pos = NOSHELL_LSM_MAGIC_LEN;
+}
+
+static bool noshell_lsm_writer_add(noshell_lsm_writer_t *w, uint64_t id, const char *line, size_t len) {
+    if (w->ok && (w->count == 0 || w->pos - w->block_start >= NOSHELL_LSM_BLOCK)) {
+        w->block_start = w->pos;
+        w->ok = noshell_bytes_put_u64(&w->tail, id) && noshell_bytes_put_u64(&w->tail, w->pos);
+    }
+    if (w->ok && w->count == w->id_cap) {
+        size_t cap = w->id_cap ? w->id_cap * 2 : 1024;
+        uint64_t *grown = (uint64_t *)realloc(w->ids, cap * sizeof(*grown));
+        w->ok = grown != NULL;
+        if (grown) {
+            w->ids = grown;
+            w->id_cap = cap;
+        }
+    }
+    if (!w->ok || (line && len >= NOSHELL_LSM_TOMB))
+        return w->ok = false;
+    w->ids[w->count++] = id;
+    if (w->count == 1)
+        w->min_id = id;
+    w->max_id = id;
+
+    uint8_t head[NOSHELL_LSM_HEAD_LEN];
+    noshell_lsm_le64(head, id);
+    noshell_lsm_le32(head + 8, line ? (uint32_t)len : NOSHELL_LSM_TOMB);
+    w->ok = fwrite(head, 1, sizeof(head), w->fp) == sizeof(head) &&
+            (!line || fwrite(line, 1, len, w->fp) == len);
+    w->pos += sizeof(head) + (line ? len : 0);
+    return w->ok;
+}
+
+/**
+ * Writes fence, bloom filter and footer, syncs and loads the segment.
+ * *out is NULL when nothing was added; on failure the file is removed.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_writer_finish(noshell_lsm_writer_t *w, unsigned bloom_bits, noshell_lsm_segment_t **out) {
+    *out = NULL;
+    bool ok = w->ok;
+    if (ok && w->count) {
+        size_t words = (w->count * bloom_bits + 63) / 64;
+        unsigned hashes = noshell_lsm_bloom_hashes(bloom_bits);
+        uint64_t *bloom = (uint64_t *)calloc(words, sizeof(*bloom));
+        ok = bloom != NULL;
+        for (size_t i = 0; ok && i < w->count; ++i)
+            noshell_lsm_bloom_add(bloom, words, hashes, w->ids[i]);
+        uint64_t fence_count = w->tail.len / 16;
+        for (size_t i = 0; ok && i < words; ++i)
+            ok = noshell_bytes_put_u64(&w->tail, bloom[i]);
+        free(bloom);
+        ok = ok && noshell_bytes_put_u64(&w->tail, w->pos) && noshell_bytes_put_u64(&w->tail, fence_count) &&
+             noshell_bytes_put_u64(&w->tail, words) && noshell_bytes_put_u64(&w->tail, w->count) &&
+             noshell_bytes_put_u64(&w->tail, w->min_id) && noshell_bytes_put_u64(&w->tail, w->max_id) &&
+             noshell_bytes_put_u32(&w->tail, hashes) && noshell_bytes_put_u32(&w->tail, 0) &&
+             noshell_bytes_put(&w->tail, NOSHELL_LSM_MAGIC, NOSHELL_LSM_MAGIC_LEN);
+        ok = ok && fwrite(w->tail.data, 1, w->tail.len, w->fp) == w->tail.len && fossil_bluecrab_sync_file(w->fp) == 0;
+    }
+    if (w->fp && fclose(w->fp) != 0)
+        ok = false;
+    fossil_bluecrab_noshell_error_t rc = ok ? FOSSIL_NOSHELL_ERROR_SUCCESS
+                                            : (w->fp ? FOSSIL_NOSHELL_ERROR_IO : FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY);
+    if (ok && w->count && !(*out = noshell_lsm_segment_load(w->path, w->seq)))
+        rc = FOSSIL_NOSHELL_ERROR_IO;
+    if (!*out && w->path)
+        remove(w->path);
+    free(w->path);
+    free(w->ids);
+    free(w->tail.data);
+    memset(w, 0, sizeof(*w));
+    return rc;
+}
+
+// ---- levels and manifest --------------------------------------------------
+
+static bool noshell_lsm_level_insert(noshell_lsm_level_t *level, size_t at, noshell_lsm_segment_t *seg) {
+    if (level->count == level->cap) {
+        size_t cap = level->cap ? level->cap * 2 : 8;
+        noshell_lsm_segment_t **grown = (noshell_lsm_segment_t **)realloc(level->segs, cap * sizeof(*grown));
+        if (!grown)
+            return false;
+        level->segs = grown;
+        level->cap = cap;
+    }
+    memmove(level->segs + at + 1, level->segs + at, (level->count - at) * sizeof(*level->segs));
+    level->segs[at] = seg;
+    level->count++;
+    return true;
+}
+
+/** Position keeping a sorted level ordered by id. */
+static size_t noshell_lsm_level_slot(const noshell_lsm_level_t *level, uint64_t min_id) {
+    size_t at = 0;
+    while (at < level->count && level->segs[at]->min_id < min_id)
+        at++;
+    return at;
+}
+
+static bool noshell_lsm_level_remove(noshell_lsm_level_t *level, const noshell_lsm_segment_t *seg) {
+    for (size_t i = 0; i < level->count; ++i) {
+        if (level->segs[i] == seg) {
+            memmove(level->segs + i, level->segs + i + 1, (level->count - i - 1) * sizeof(*level->segs));
+            level->count--;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t noshell_lsm_level_bytes(const noshell_lsm_level_t *level) {
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < level->count; ++i)
+        bytes += level->segs[i]->size;
+    return bytes;
+}
+
+/**
+ * Rewrites the manifest through a temporary file (store mutex held once
+ * the store is shared). Logs are listed oldest first, level 0 newest first.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_manifest_write(noshell_lsm_t *s) {
+    char *path = noshell_meta_path(s->path, ".lsm");
+    char *tmp_path = noshell_meta_path(s->path, ".lsm.tmp");
+    FILE *fp = path && tmp_path ? fopen(tmp_path, "wb") : NULL;
+    bool ok = fp != NULL;
+    if (fp) {
+        const fossil_bluecrab_noshell_lsm_options_t *o = &s->options;
+        ok = fprintf(fp, "#noshell_lsm next=%" PRIu64 " memtable=%zu segment=%zu level0=%zu ratio=%zu bloom=%u\n",
+                     s->next_seq, o->memtable_bytes, o->segment_bytes, o->level0_segments, o->level_ratio, o->bloom_bits) > 0;
+        if (ok && s->has_imm)
+            ok = fprintf(fp, "wal %" PRIu64 "\n", s->imm_wal) > 0;
+        if (ok && s->wal)
+            ok = fprintf(fp, "wal %" PRIu64 "\n", s->wal_seq) > 0;
+        for (size_t l = 0; l < FOSSIL_NOSHELL_LSM_LEVELS; ++l) {
+            for (size_t i = 0; ok && i < s->levels[l].count; ++i)
+                ok = fprintf(fp, "seg %zu %" PRIu64 "\n", l, s->levels[l].segs[i]->seq) > 0;
+        }
+        ok = ok && fossil_bluecrab_sync_file(fp) == 0;
+        ok = fclose(fp) == 0 && ok;
+        ok = ok && noshell_lsm_replace(tmp_path, path);
+        if (!ok)
+            remove(tmp_path);
+    }
+    free(path);
+    free(tmp_path);
+    return ok ? FOSSIL_NOSHELL_ERROR_SUCCESS : FOSSIL_NOSHELL_ERROR_IO;
+}
+
+typedef struct {
+    uint64_t seq;
+    int      level;         // -1 for a log
+} noshell_lsm_file_t;
+
+typedef struct {
+    fossil_bluecrab_noshell_lsm_options_t options;
+    uint64_t next_seq;
+    noshell_lsm_file_t *files;
+    size_t   count;
+} noshell_lsm_manifest_t;
+
+static fossil_bluecrab_noshell_error_t noshell_lsm_manifest_read(const char *file_name, noshell_lsm_manifest_t *man) {
+    memset(man, 0, sizeof(*man));
+    char *path = noshell_meta_path(file_name, ".lsm");
+    FILE *fp = path ? fopen(path, "rb") : NULL;
+    free(path);
+    if (!fp)
+        return FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND;
+
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_CORRUPTED;
+    fossil_bluecrab_noshell_lsm_options_t *o = &man->options;
+    char *line = NULL;
+    size_t cap = 0, cap_files = 0;
+    if (noshell_getline(fp, &line, &cap) > 0 &&
+        sscanf(line, "#noshell_lsm next=%" SCNu64 " memtable=%zu segment=%zu level0=%zu ratio=%zu bloom=%u",
+               &man->next_seq, &o->memtable_bytes, &o->segment_bytes, &o->level0_segments, &o->level_ratio, &o->bloom_bits) == 6)
+        rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    while (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && noshell_getline(fp, &line, &cap) > 0) {
+        noshell_lsm_file_t f;
+        unsigned level;
+        if (sscanf(line, "wal %" SCNu64, &f.seq) == 1) {
+            f.level = -1;
+        } else if (sscanf(line, "seg %u %" SCNu64, &level, &f.seq) == 2 && level < FOSSIL_NOSHELL_LSM_LEVELS) {
+            f.level = (int)level;
+        } else {
+            rc = FOSSIL_NOSHELL_ERROR_CORRUPTED;
+            break;
+        }
+        if (man->count == cap_files) {
+            size_t grown_cap = cap_files ? cap_files * 2 : 16;
+            noshell_lsm_file_t *grown = (noshell_lsm_file_t *)realloc(man->files, grown_cap * sizeof(*grown));
+            if (!grown) {
+                rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+            man->files = grown;
+            cap_files = grown_cap;
+        }
+        man->files[man->count++] = f;
+    }
+    free(line);
+    fclose(fp);
+    noshell_lsm_options_fix(o);
+    return rc;
+}
+
+/** Removes the manifest first (the database is plain text from then on), then its files. */
+static void noshell_lsm_remove_files(const char *file_name) {
+    noshell_lsm_manifest_t man;
+    noshell_lsm_manifest_read(file_name, &man);
+    char *path = noshell_meta_path(file_name, ".lsm");
+    char *tmp_path = noshell_meta_path(file_name, ".lsm.tmp");
+    if (path)
+        remove(path);
+    if (tmp_path)
+        remove(tmp_path);
+    free(path);
+    free(tmp_path);
+    for (size_t i = 0; i < man.count; ++i)
+        noshell_lsm_remove_file(file_name, man.files[i].seq, man.files[i].level < 0 ? "wal" : "seg");
+    free(man.files);
+}
+
+static bool noshell_lsm_enabled(const char *file_name) {
+    char *path = noshell_meta_path(file_name, ".lsm");
+    struct stat sb;
+    bool enabled = path && stat(path, &sb) == 0;
+    free(path);
+    return enabled;
+}
+
+// ---- merging iteration ----------------------------------------------------
+
+/**
+ * One sorted input of a merge: a memtable (entries) or a run of
+ * non-overlapping segments read one after the other through a private
+ * stream.
+ */
+typedef struct {
+    const noshell_lsm_entry_t *entries;
+    size_t   entry_count;
+    size_t   entry_pos;
+    noshell_lsm_segment_t **segs;
+    size_t   seg_count;
+    size_t   seg_pos;
+    FILE    *fp;
+    uint64_t at;
+    uint64_t end;
+    char    *buf;
+    size_t   cap;
+    bool     valid;         // id, line and len hold an entry
+    bool     consumed;      // advance before the next merge step
+    uint64_t id;
+    const char *line;       // NULL for a removal
+    size_t   len;
+} noshell_lsm_source_t;
+
+static bool noshell_lsm_source_enter(noshell_lsm_source_t *src, const noshell_lsm_segment_t *seg, uint64_t offset) {
+    if (src->fp)
+        fclose(src->fp);
+    src->fp = fopen(seg->path, "rb");
+    src->at = offset;
+    src->end = seg->data_end;
+    return src->fp && fseek(src->fp, (long)offset, SEEK_SET) == 0;
+}
+
+/** Moves to the next entry; valid turns false at the end. false on a read error. */
+static bool noshell_lsm_source_next(noshell_lsm_source_t *src) {
+    src->valid = false;
+    if (!src->segs) {
+        if (src->entry_pos < src->entry_count) {
+            const noshell_lsm_entry_t *e = &src->entries[src->entry_pos++];
+            src->id = e->id;
+            src->line = e->line;
+            src->len = e->len;
+            src->valid = true;
+        }
+        return true;
+    }
+    while (!src->fp || src->at >= src->end) {
+        if (src->seg_pos == src->seg_count) {
+            if (src->fp)
+                fclose(src->fp);
+            src->fp = NULL;
+            return true;
+        }
+        if (!noshell_lsm_source_enter(src, src->segs[src->seg_pos++], NOSHELL_LSM_MAGIC_LEN))
+            return false;
+    }
+    uint8_t head[NOSHELL_LSM_HEAD_LEN];
+    if (src->end - src->at < NOSHELL_LSM_HEAD_LEN || fread(head, 1, sizeof(head), src->fp) != sizeof(head))
+        return false;
+    uint32_t n = noshell_fsonb_u32(head + 8);
+    size_t len = n == NOSHELL_LSM_TOMB ? 0 : n;
+    if (len > src->end - src->at - NOSHELL_LSM_HEAD_LEN)
+        return false;
+    if (len + 1 > src->cap) {
+        char *grown = (char *)realloc(src->buf, len + 1);
+        if (!grown)
+            return false;
+        src->buf = grown;
+        src->cap = len + 1;
+    }
+    if (len && fread(src->buf, 1, len, src->fp) != len)
+        return false;
+    src->buf[len] = '\0';
+    src->id = noshell_fsonb_u64(head);
+    src->line = n == NOSHELL_LSM_TOMB ? NULL : src->buf;
+    src->len = len;
+    src->at += NOSHELL_LSM_HEAD_LEN + len;
+    src->valid = true;
+    return true;
+}
+
+/** Positions the source on its first entry with an id >= from. */
+static bool noshell_lsm_source_start(noshell_lsm_source_t *src, uint64_t from) {
+    if (!src->segs) {
+        size_t lo = 0, hi = src->entry_count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (src->entries[mid].id < from)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        src->entry_pos = lo;
+        return noshell_lsm_source_next(src);
+    }
+    while (src->seg_pos < src->seg_count && src->segs[src->seg_pos]->max_id < from)
+        src->seg_pos++;
+    if (src->seg_pos < src->seg_count) {
+        const noshell_lsm_segment_t *seg = src->segs[src->seg_pos++];
+        if (!noshell_lsm_source_enter(src, seg, seg->fence[2 * noshell_lsm_fence_find(seg, from) + 1]))
+            return false;
+    }
+    do {
+        if (!noshell_lsm_source_next(src))
+            return false;
+    } while (src->valid && src->id < from);
+    return true;
+}
+
+static void noshell_lsm_source_free(noshell_lsm_source_t *src) {
+    if (src->fp)
+        fclose(src->fp);
+    free(src->buf);
+}
+
+/**
+ * Next id over all sources (newest first); the first source holding it
+ * wins and the others skip their older versions. NOT_FOUND at the end.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_merge_next(noshell_lsm_source_t *sources, size_t count, noshell_lsm_source_t **out) {
+    noshell_lsm_source_t *best = NULL;
+    for (size_t i = 0; i < count; ++i) {
+        noshell_lsm_source_t *src = &sources[i];
+        if (src->consumed) {
+            src->consumed = false;
+            if (!noshell_lsm_source_next(src))
+                return FOSSIL_NOSHELL_ERROR_IO;
+        }
+        if (src->valid && (!best || src->id < best->id))
+            best = src;
+    }
+    if (!best)
+        return FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    for (size_t i = 0; i < count; ++i) {
+        if (sources[i].valid && sources[i].id == best->id)
+            sources[i].consumed = true;
+    }
+    *out = best;
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+typedef struct {
+    noshell_lsm_source_t *sources;  // newest first
+    size_t count;
+    noshell_lsm_segment_t **held;   // segments a snapshot references
+    size_t held_count;
+    noshell_lsm_entry_t *copies[2]; // memtables of a snapshot
+    char *arenas[2];
+} noshell_lsm_scan_t;
+
+/** Releases a scan; the store mutex must be held when locked is true. */
+static void noshell_lsm_scan_close(noshell_lsm_t *s, noshell_lsm_scan_t *scan, bool locked) {
+    for (size_t i = 0; i < scan->count; ++i)
+        noshell_lsm_source_free(&scan->sources[i]);
+    free(scan->sources);
+    if (scan->held_count) {
+        if (!locked)
+            fossil_bluecrab_thread_mutex_lock(&s->mutex);
+        for (size_t i = 0; i < scan->held_count; ++i)
+            noshell_lsm_segment_release(scan->held[i]);
+        if (!locked)
+            fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+    }
+    free(scan->held);
+    for (int i = 0; i < 2; ++i) {
+        free(scan->copies[i]);
+        free(scan->arenas[i]);
+    }
+}
+
+/**
+ * Sets up one source per memtable, per level-0 segment and per deeper
+ * level (store mutex held). A snapshot copies the memtables and references
+ * the segments so it can be read after the mutex is released; otherwise
+ * the scan must finish under the mutex.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_scan_open(noshell_lsm_t *s, bool snapshot, noshell_lsm_scan_t *scan) {
+    memset(scan, 0, sizeof(*scan));
+    size_t total = 0;
+    for (size_t l = 0; l < FOSSIL_NOSHELL_LSM_LEVELS; ++l)
+        total += s->levels[l].count;
+    scan->sources = (noshell_lsm_source_t *)calloc(2 + total, sizeof(*scan->sources));
+    if (snapshot && total)
+        scan->held = (noshell_lsm_segment_t **)malloc(total * sizeof(*scan->held));
+    if (!scan->sources || (snapshot && total && !scan->held)) {
+        noshell_lsm_scan_close(s, scan, true);
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    }
+
+    noshell_lsm_mem_sort(&s->mem);
+    const noshell_lsm_memtable_t *mems[2] = { &s->mem, s->has_imm ? &s->imm : NULL };
+    for (int i = 0; i < 2; ++i) {
+        if (!mems[i] || !mems[i]->count)
+            continue;
+        noshell_lsm_source_t *src = &scan->sources[scan->count++];
+        src->entries = mems[i]->entries;
+        src->entry_count = mems[i]->count;
+        if (snapshot) {
+            if (!noshell_lsm_mem_copy(mems[i], &scan->copies[i], &scan->arenas[i])) {
+                noshell_lsm_scan_close(s, scan, true);
+                return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+            }
+            src->entries = scan->copies[i];
+        }
+    }
+    for (size_t l = 0; l < FOSSIL_NOSHELL_LSM_LEVELS; ++l) {
+        noshell_lsm_level_t *level = &s->levels[l];
+        if (!level->count)
+            continue;
+        noshell_lsm_segment_t **segs = level->segs;
+        if (snapshot) {
+            segs = scan->held + scan->held_count;
+            for (size_t i = 0; i < level->count; ++i) {
+                level->segs[i]->refs++;
+                scan->held[scan->held_count++] = level->segs[i];
+            }
+        }
+        if (l == 0) {
+            for (size_t i = 0; i < level->count; ++i) {
+                scan->sources[scan->count].segs = &segs[i];
+                scan->sources[scan->count++].seg_count = 1;
+            }
+        } else {
+            scan->sources[scan->count].segs = segs;
+            scan->sources[scan->count++].seg_count = level->count;
+        }
+    }
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+typedef bool (*noshell_lsm_visit_fn)(void *ctx, uint64_t id, const char *line, size_t len);
+
+/**
+ * Calls fn with each live document in id order on a snapshot; fn runs
+ * without the store mutex. SUCCESS when fn returned true, NOT_FOUND when
+ * the documents ran out.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_each(noshell_lsm_t *s, noshell_lsm_visit_fn fn, void *ctx) {
+    noshell_lsm_scan_t scan;
+    fossil_bluecrab_thread_mutex_lock(&s->mutex);
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_scan_open(s, true, &scan);
+    fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+
+    for (size_t i = 0; rc == FOSSIL_NOSHELL_ERROR_SUCCESS && i < scan.count; ++i) {
+        if (!noshell_lsm_source_start(&scan.sources[i], 0))
+            rc = FOSSIL_NOSHELL_ERROR_IO;
+    }
+    while (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_lsm_source_t *top;
+        rc = noshell_lsm_merge_next(scan.sources, scan.count, &top);
+        if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && top->line && fn(ctx, top->id, top->line, top->len))
+            break;
+    }
+    noshell_lsm_scan_close(s, &scan, false);
+    return rc;
+}
+
+// ---- writes, flushes and compaction ---------------------------------------
+
+static uint64_t noshell_lsm_take_seq(noshell_lsm_t *s) {
+    fossil_bluecrab_thread_mutex_lock(&s->mutex);
+    uint64_t seq = s->next_seq++;
+    fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+    return seq;
+}
+
+/**
+ * Writes a sorted memtable as segments of about split bytes into level
+ * (at the front of level 0, appended otherwise). Only for stores that are
+ * not shared yet.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_write_sorted(noshell_lsm_t *s, const noshell_lsm_memtable_t *m, size_t level, size_t split) {
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    size_t i = 0;
+    while (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && i < m->count) {
+        noshell_lsm_writer_t w;
+        noshell_lsm_writer_open(&w, s->path, s->next_seq++);
+        for (; i < m->count && w.pos < split; ++i)
+            noshell_lsm_writer_add(&w, m->entries[i].id, m->entries[i].line, m->entries[i].len);
+        noshell_lsm_segment_t *seg;
+        rc = noshell_lsm_writer_finish(&w, s->options.bloom_bits, &seg);
+        noshell_lsm_level_t *lv = &s->levels[level];
+        if (seg && !noshell_lsm_level_insert(lv, level == 0 ? 0 : lv->count, seg)) {
+            seg->obsolete = true;
+            noshell_lsm_segment_release(seg);
+            rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        }
+    }
+    return rc;
+}
+
+/**
+ * Freezes the memtable behind a new log (store mutex held) and wakes the
+ * worker to write it out.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_rotate(noshell_lsm_t *s) {
+    uint64_t seq = s->next_seq++;
+    char *path = noshell_lsm_file(s->path, seq, "wal");
+    FILE *wal = path ? fopen(path, "ab") : NULL;
+    free(path);
+    if (!wal)
+        return FOSSIL_NOSHELL_ERROR_IO;
+    noshell_lsm_mem_sort(&s->mem);
+    s->imm = s->mem;
+    memset(&s->mem, 0, sizeof(s->mem));
+    s->has_imm = true;
+    s->imm_wal = s->wal_seq;
+    fclose(s->wal);
+    s->wal = wal;
+    s->wal_seq = seq;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_manifest_write(s);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        s->failed = rc;
+    fossil_bluecrab_thread_cond_broadcast(&s->cond);
+    return rc;
+}
+
+/**
+ * Writes the frozen memtable out as the newest level-0 segment (store
+ * mutex held, released during the write) and drops its log.
+ */
+static void noshell_lsm_flush_imm(noshell_lsm_t *s) {
+    s->flushing = true;
+    uint64_t seq = s->next_seq++;
+    unsigned bloom_bits = s->options.bloom_bits;
+    fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+
+    noshell_lsm_writer_t w;
+    noshell_lsm_writer_open(&w, s->path, seq);
+    for (size_t i = 0; i < s->imm.count; ++i)
+        noshell_lsm_writer_add(&w, s->imm.entries[i].id, s->imm.entries[i].line, s->imm.entries[i].len);
+    noshell_lsm_segment_t *seg;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_writer_finish(&w, bloom_bits, &seg);
+
+    fossil_bluecrab_thread_mutex_lock(&s->mutex);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && seg && !noshell_lsm_level_insert(&s->levels[0], 0, seg)) {
+        seg->obsolete = true;
+        noshell_lsm_segment_release(seg);
+        rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        s->has_imm = false;
+        noshell_lsm_mem_free(&s->imm);
+        rc = noshell_lsm_manifest_write(s);
+        if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+            noshell_lsm_remove_file(s->path, s->imm_wal, "wal");
+        s->flushes++;
+    }
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        s->failed = rc;
+    s->flushing = false;
+    fossil_bluecrab_thread_cond_broadcast(&s->cond);
+}
+
+/**
+ * Makes room for a write (store mutex held): freezes a full memtable,
+ * writes out or waits for the previous one, and holds writers back while
+ * level 0 is far behind.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_make_room(noshell_lsm_t *s) {
+    for (;;) {
+        if (s->failed != FOSSIL_NOSHELL_ERROR_SUCCESS)
+            return s->failed;
+        if (s->mem.bytes >= s->options.memtable_bytes) {
+            if (!s->has_imm) {
+                fossil_bluecrab_noshell_error_t rc = noshell_lsm_rotate(s);
+                if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+                    return rc;
+            } else if (!s->flushing) {
+                noshell_lsm_flush_imm(s);
+            } else {
+                fossil_bluecrab_thread_cond_wait(&s->cond, &s->mutex);
+            }
+            continue;
+        }
+        if (s->levels[0].count >= s->options.level0_segments * NOSHELL_LSM_L0_STALL) {
+            fossil_bluecrab_thread_cond_wait(&s->cond, &s->mutex);
+            continue;
+        }
+        return FOSSIL_NOSHELL_ERROR_SUCCESS;
+    }
+}
+
+/**
+ * Logs and applies one version of id (store mutex held, room made); line
+ * NULL removes it. The memtable takes line, a malloc'd NUL-terminated copy
+ * ending in its newline, on success.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_log(noshell_lsm_t *s, uint64_t id, char *line, size_t len) {
+    bool logged = line ? fwrite(line, 1, len, s->wal) == len
+                       : fprintf(s->wal, "#del=%016" PRIx64 "\n", id) > 0;
+    fossil_bluecrab_noshell_error_t rc = logged && fflush(s->wal) == 0 ? noshell_durable(s->path, s->wal) : FOSSIL_NOSHELL_ERROR_IO;
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && !noshell_lsm_mem_put(&s->mem, id, line, len))
+        rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    return rc;
+}
+
+/** Logs and applies one version of id; line (with its newline) NULL removes it. */
+static fossil_bluecrab_noshell_error_t noshell_lsm_write(noshell_lsm_t *s, uint64_t id, const char *line, size_t len) {
+    char *copy = NULL;
+    if (line) {
+        copy = (char *)malloc(len + 1);
+        if (!copy)
+            return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        memcpy(copy, line, len);
+        copy[len] = '\0';
+    }
+    fossil_bluecrab_thread_mutex_lock(&s->mutex);
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_make_room(s);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+        rc = noshell_lsm_log(s, id, copy, len);
+    fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        free(copy);
+    return rc;
+}
+
+/** Inputs of one merge, grouped in runs (newest first) that are each sorted by id. */
+typedef struct {
+    noshell_lsm_segment_t **inputs;
+    size_t  *run_ends;
+    size_t   count;
+    size_t   run_count;
+    size_t   target;        // level receiving the output
+    bool     drop_tombs;    // nothing older lies below the target
+    bool     full;          // compact everything; never a plain move
+} noshell_lsm_plan_t;
+
+static void noshell_lsm_plan_run(noshell_lsm_plan_t *plan, noshell_lsm_segment_t **segs, size_t count) {
+    if (!count)
+        return;
+    for (size_t i = 0; i < count; ++i)
+        plan->inputs[plan->count++] = segs[i];
+    plan->run_ends[plan->run_count++] = plan->count;
+}
+
+/**
+ * Picks the next merge (store mutex held): level 0 into level 1 once it
+ * has level0_segments segments, or one segment of a level over its budget
+ * into the next; full merges every level into the deepest populated one.
+ * The inputs get a reference each.
+ */
+static bool noshell_lsm_plan_pick(noshell_lsm_t *s, bool full, noshell_lsm_plan_t *plan) {
+    memset(plan, 0, sizeof(*plan));
+    size_t total = 0, deepest = 0;
+    for (size_t l = 0; l < FOSSIL_NOSHELL_LSM_LEVELS; ++l) {
+        total += s->levels[l].count;
+        if (s->levels[l].count)
+            deepest = l;
+    }
+    // The level furthest over its budget goes first, so no level's debt
+    // grows without bound under a steady stream of flushes
+    size_t source = FOSSIL_NOSHELL_LSM_LEVELS;
+    if (!full) {
+        double best = 1.0, budget = (double)s->options.segment_bytes;
+        if (s->levels[0].count >= s->options.level0_segments) {
+            source = 0;
+            best = (double)s->levels[0].count / (double)s->options.level0_segments;
+        }
+        for (size_t l = 1; l + 1 < FOSSIL_NOSHELL_LSM_LEVELS; ++l) {
+            budget *= (double)s->options.level_ratio;
+            double score = (double)noshell_lsm_level_bytes(&s->levels[l]) / budget;
+            if (score > best) {
+                source = l;
+                best = score;
+            }
+        }
+    }
+    if (!total || (!full && source == FOSSIL_NOSHELL_LSM_LEVELS))
+        return false;
+    plan->inputs = (noshell_lsm_segment_t **)malloc(total * sizeof(*plan->inputs));
+    plan->run_ends = (size_t *)malloc(total * sizeof(*plan->run_ends));
+    if (!plan->inputs || !plan->run_ends) {
+        free(plan->inputs);
+        free(plan->run_ends);
+        return false;
+    }
+    plan->full = full;
+
+    uint64_t lo = UINT64_MAX, hi = 0;
+    if (full) {
+        plan->target = deepest ? deepest : 1;
+        for (size_t i = 0; i < s->levels[0].count; ++i)
+            noshell_lsm_plan_run(plan, &s->levels[0].segs[i], 1);
+        for (size_t l = 1; l < FOSSIL_NOSHELL_LSM_LEVELS; ++l)
+            noshell_lsm_plan_run(plan, s->levels[l].segs, s->levels[l].count);
+    } else {
+        noshell_lsm_level_t *from = &s->levels[source];
+        if (source == 0) {
+            for (size_t i = 0; i < from->count; ++i)
+                noshell_lsm_plan_run(plan, &from->segs[i], 1);
+        } else {
+            size_t pick = 0;
+            while (pick < from->count && from->segs[pick]->min_id <= s->cursor[source])
+                pick++;
+            if (pick == from->count)
+                pick = 0;
+            s->cursor[source] = from->segs[pick]->max_id;
+            noshell_lsm_plan_run(plan, &from->segs[pick], 1);
+        }
+        for (size_t i = 0; i < plan->count; ++i) {
+            if (plan->inputs[i]->min_id < lo) lo = plan->inputs[i]->min_id;
+            if (plan->inputs[i]->max_id > hi) hi = plan->inputs[i]->max_id;
+        }
+        plan->target = source + 1;
+        noshell_lsm_level_t *into = &s->levels[plan->target];
+        size_t first = 0, last;
+        while (first < into->count && into->segs[first]->max_id < lo)
+            first++;
+        for (last = first; last < into->count && into->segs[last]->min_id <= hi; ++last) {}
+        noshell_lsm_plan_run(plan, into->segs + first, last - first);
+    }
+    plan->drop_tombs = true;
+    for (size_t l = plan->target + 1; l < FOSSIL_NOSHELL_LSM_LEVELS; ++l) {
+        if (s->levels[l].count)
+            plan->drop_tombs = false;
+    }
+    for (size_t i = 0; i < plan->count; ++i)
+        plan->inputs[i]->refs++;
+    return true;
+}
+
+static size_t noshell_lsm_level_of(const noshell_lsm_t *s, const noshell_lsm_segment_t *seg) {
+    for (size_t l = 0; l < FOSSIL_NOSHELL_LSM_LEVELS; ++l) {
+        for (size_t i = 0; i < s->levels[l].count; ++i) {
+            if (s->levels[l].segs[i] == seg)
+                return l;
+        }
+    }
+    return FOSSIL_NOSHELL_LSM_LEVELS;
+}
+
+/**
+ * Runs a plan (store mutex held, released while merging): the inputs are
+ * merged into new target-level segments of about segment_bytes, which
+ * replace them in the manifest. A single input with nothing to merge
+ * against just moves down a level.
+ */
+static void noshell_lsm_merge(noshell_lsm_t *s, noshell_lsm_plan_t *plan) {
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    if (plan->count == 1 && !plan->full) {
+        noshell_lsm_segment_t *seg = plan->inputs[0];
+        noshell_lsm_level_t *into = &s->levels[plan->target];
+        size_t from = noshell_lsm_level_of(s, seg);
+        if (noshell_lsm_level_insert(into, noshell_lsm_level_slot(into, seg->min_id), seg)) {
+            noshell_lsm_level_remove(&s->levels[from], seg);
+            rc = noshell_lsm_manifest_write(s);
+        }
+        noshell_lsm_segment_release(seg);
+        if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+            s->failed = rc;
+        free(plan->inputs);
+        free(plan->run_ends);
+        fossil_bluecrab_thread_cond_broadcast(&s->cond);
+        return;
+    }
+
+    s->merging = true;
+    fossil_bluecrab_noshell_lsm_options_t options = s->options;
+    fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+
+    noshell_lsm_source_t *sources = (noshell_lsm_source_t *)calloc(plan->run_count, sizeof(*sources));
+    noshell_lsm_segment_t **outputs = NULL;
+    size_t output_count = 0, output_cap = 0;
+    if (!sources)
+        rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    for (size_t r = 0; rc == FOSSIL_NOSHELL_ERROR_SUCCESS && r < plan->run_count; ++r) {
+        size_t start = r ? plan->run_ends[r - 1] : 0;
+        sources[r].segs = plan->inputs + start;
+        sources[r].seg_count = plan->run_ends[r] - start;
+        if (!noshell_lsm_source_start(&sources[r], 0))
+            rc = FOSSIL_NOSHELL_ERROR_IO;
+    }
+
+    noshell_lsm_writer_t w;
+    bool writing = false;
+    while (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_lsm_source_t *top = NULL;
+        rc = noshell_lsm_merge_next(sources, plan->run_count, &top);
+        bool done = rc != FOSSIL_NOSHELL_ERROR_SUCCESS;
+        if (done && rc == FOSSIL_NOSHELL_ERROR_NOT_FOUND)
+            rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+        if (!done && !top->line && plan->drop_tombs)
+            continue;
+        if (writing && (done || w.pos >= options.segment_bytes)) {
+            if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+                w.ok = false;
+            noshell_lsm_segment_t *seg;
+            fossil_bluecrab_noshell_error_t finished = noshell_lsm_writer_finish(&w, options.bloom_bits, &seg);
+            writing = false;
+            if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+                rc = finished;
+            if (seg && output_count == output_cap) {
+                size_t cap = output_cap ? output_cap * 2 : 8;
+                noshell_lsm_segment_t **grown = (noshell_lsm_segment_t **)realloc(outputs, cap * sizeof(*grown));
+                if (grown) {
+                    outputs = grown;
+                    output_cap = cap;
+                }
+            }
+            if (seg && output_count < output_cap) {
+                outputs[output_count++] = seg;
+            } else if (seg) {
+                seg->obsolete = true;
+                noshell_lsm_segment_free(seg);
+                rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+            }
+        }
+        if (done || rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+            break;
+        if (!writing) {
+            noshell_lsm_writer_open(&w, s->path, noshell_lsm_take_seq(s));
+            writing = true;
+        }
+        if (!noshell_lsm_writer_add(&w, top->id, top->line, top->len))
+            rc = FOSSIL_NOSHELL_ERROR_IO;
+    }
+    if (writing) {
+        noshell_lsm_segment_t *seg;
+        w.ok = false;
+        noshell_lsm_writer_finish(&w, options.bloom_bits, &seg);
+    }
+    for (size_t r = 0; sources && r < plan->run_count; ++r)
+        noshell_lsm_source_free(&sources[r]);
+    free(sources);
+
+    fossil_bluecrab_thread_mutex_lock(&s->mutex);
+    noshell_lsm_level_t *into = &s->levels[plan->target];
+    size_t installed = 0;
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        for (size_t i = 0; i < plan->count; ++i) {
+            size_t level = noshell_lsm_level_of(s, plan->inputs[i]);
+            if (level < FOSSIL_NOSHELL_LSM_LEVELS)
+                noshell_lsm_level_remove(&s->levels[level], plan->inputs[i]);
+        }
+        for (; installed < output_count; ++installed) {
+            if (!noshell_lsm_level_insert(into, noshell_lsm_level_slot(into, outputs[installed]->min_id), outputs[installed]))
+                break;
+        }
+        rc = installed == output_count ? noshell_lsm_manifest_write(s) : FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        // The old files go once the manifest no longer names them
+        for (size_t i = 0; i < plan->count; ++i) {
+            plan->inputs[i]->obsolete = rc == FOSSIL_NOSHELL_ERROR_SUCCESS;
+            noshell_lsm_segment_release(plan->inputs[i]);
+        }
+        s->compactions++;
+    }
+    for (size_t i = installed; i < output_count; ++i) {
+        outputs[i]->obsolete = true;
+        noshell_lsm_segment_release(outputs[i]);
+    }
+    for (size_t i = 0; i < plan->count; ++i)
+        noshell_lsm_segment_release(plan->inputs[i]);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        s->failed = rc;
+    free(outputs);
+    free(plan->inputs);
+    free(plan->run_ends);
+    s->merging = false;
+    fossil_bluecrab_thread_cond_broadcast(&s->cond);
+}
+
+FOSSIL_THREAD_FN(noshell_lsm_worker) {
+    noshell_lsm_t *s = (noshell_lsm_t *)arg;
+    fossil_bluecrab_thread_mutex_lock(&s->mutex);
+    for (;;) {
+        noshell_lsm_plan_t plan;
+        bool healthy = s->failed == FOSSIL_NOSHELL_ERROR_SUCCESS;
+        if (healthy && s->has_imm && !s->flushing)
+            noshell_lsm_flush_imm(s);
+        else if (s->stop)
+            break;
+        else if (healthy && !s->merging && noshell_lsm_plan_pick(s, false, &plan))
+            noshell_lsm_merge(s, &plan);
+        else
+            fossil_bluecrab_thread_cond_wait(&s->cond, &s->mutex);
+    }
+    fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+    FOSSIL_THREAD_RETURN;
+}
+
+/** Freezes the memtable once and waits until nothing frozen is left. */
+static fossil_bluecrab_noshell_error_t noshell_lsm_flush(noshell_lsm_t *s) {
+    fossil_bluecrab_thread_mutex_lock(&s->mutex);
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    bool rotated = false;
+    for (;;) {
+        if (s->failed != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+            rc = s->failed;
+            break;
+        }
+        if (s->has_imm) {
+            if (!s->flushing)
+                noshell_lsm_flush_imm(s);
+            else
+                fossil_bluecrab_thread_cond_wait(&s->cond, &s->mutex);
+        } else if (!rotated && s->mem.count) {
+            rotated = true;
+            rc = noshell_lsm_rotate(s);
+            if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+                break;
+        } else {
+            break;
+        }
+    }
+    fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+    return rc;
+}
+
+/** Flushes, then merges every level into one without tombstones. */
+static fossil_bluecrab_noshell_error_t noshell_lsm_compact(noshell_lsm_t *s) {
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_flush(s);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+    fossil_bluecrab_thread_mutex_lock(&s->mutex);
+    while (s->merging)
+        fossil_bluecrab_thread_cond_wait(&s->cond, &s->mutex);
+    noshell_lsm_plan_t plan;
+    if (s->failed == FOSSIL_NOSHELL_ERROR_SUCCESS && noshell_lsm_plan_pick(s, true, &plan))
+        noshell_lsm_merge(s, &plan);
+    rc = s->failed;
+    fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+    return rc;
+}
+
+// ---- open and close -------------------------------------------------------
+
+static noshell_lsm_t *noshell_lsm_new(const char *file_name) {
+    noshell_lsm_t *s = (noshell_lsm_t *)calloc(1, sizeof(*s));
+    if (!s)
+        return NULL;
+    s->path = noshell_strdup(file_name);
+    if (!s->path) {
+        free(s);
+        return NULL;
+    }
+    fossil_bluecrab_thread_mutex_init(&s->mutex);
+    fossil_bluecrab_thread_cond_init(&s->cond);
+    s->next_seq = 1;
+    return s;
+}
+
+/**
+ * Stops the worker, writes the memtable out (unless the files are being
+ * dropped) and frees the store. Segment files stay.
+ */
+static void noshell_lsm_free(noshell_lsm_t *s) {
+    if (s->running) {
+        fossil_bluecrab_thread_mutex_lock(&s->mutex);
+        s->stop = true;
+        fossil_bluecrab_thread_cond_broadcast(&s->cond);
+        fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+        fossil_bluecrab_thread_join(s->thread);
+        s->running = false;
+    }
+    if (!s->dropping && s->wal && noshell_lsm_flush(s) == FOSSIL_NOSHELL_ERROR_SUCCESS && !s->has_imm) {
+        // Nothing left in a log: close without one
+        fclose(s->wal);
+        s->wal = NULL;
+        if (noshell_lsm_manifest_write(s) == FOSSIL_NOSHELL_ERROR_SUCCESS)
+            noshell_lsm_remove_file(s->path, s->wal_seq, "wal");
+    }
+    if (s->wal)
+        fclose(s->wal);
+    noshell_lsm_mem_free(&s->mem);
+    noshell_lsm_mem_free(&s->imm);
+    for (size_t l = 0; l < FOSSIL_NOSHELL_LSM_LEVELS; ++l) {
+        for (size_t i = 0; i < s->levels[l].count; ++i)
+            noshell_lsm_segment_release(s->levels[l].segs[i]);
+        free(s->levels[l].segs);
+    }
+    free(s->block);
+    fossil_bluecrab_thread_cond_destroy(&s->cond);
+    fossil_bluecrab_thread_mutex_destroy(&s->mutex);
+    noshell_file_release(s->file);
+    free(s->path);
+    free(s);
+}
+
+/**
+ * Replays a log into the memtable. A last line without its newline is a
+ * write that never finished; it is skipped and *clean cleared.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_replay(noshell_lsm_t *s, uint64_t seq, bool *clean) {
+    char *path = noshell_lsm_file(s->path, seq, "wal");
+    FILE *fp = path ? fopen(path, "rb") : NULL;
+    free(path);
+    if (!fp)
+        return FOSSIL_NOSHELL_ERROR_SUCCESS;
+
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    noshell_reader_t reader;
+    noshell_reader_init(&reader, fp);
+    char *line;
+    size_t len;
+    while (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && (line = noshell_reader_next(&reader, &len)) != NULL) {
+        if (line[len - 1] != '\n') {
+            *clean = false;
+            break;
+        }
+        uint64_t id;
+        char *copy = NULL;
+        if (strncmp(line, "#del=", 5) == 0) {
+            fossil_bluecrab_scan_hex64(line + 5, len - 5, &id);
+        } else if (noshell_is_document(line) && noshell_line_id(line, len, &id)) {
+            copy = (char *)malloc(len + 1);
+            if (!copy) {
+                rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+            memcpy(copy, line, len + 1);
+        } else {
+            continue;
+        }
+        if (!noshell_lsm_mem_put(&s->mem, id, copy, copy ? len : 0)) {
+            free(copy);
+            rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        }
+    }
+    noshell_reader_free(&reader);
+    fclose(fp);
+    return rc;
+}
+
+/**
+ * Opens the store of file_name from its manifest: loads the segments,
+ * replays the logs and starts the worker. One clean log is appended to as
+ * it is; several logs, or one with a torn last line, are written out as a
+ * level-0 segment first and replaced by a fresh log.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_open(const char *file_name, noshell_lsm_t **out) {
+    noshell_lsm_manifest_t man;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_manifest_read(file_name, &man);
+    noshell_lsm_t *s = rc == FOSSIL_NOSHELL_ERROR_SUCCESS ? noshell_lsm_new(file_name) : NULL;
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && !s)
+        rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    if (s) {
+        s->options = man.options;
+        s->next_seq = man.next_seq;
+    }
+
+    size_t logs = 0;
+    uint64_t last_log = 0;
+    bool clean = true;
+    for (size_t i = 0; rc == FOSSIL_NOSHELL_ERROR_SUCCESS && i < man.count; ++i) {
+        noshell_lsm_file_t *f = &man.files[i];
+        if (f->seq >= s->next_seq)
+            s->next_seq = f->seq + 1;
+        if (f->level < 0) {
+            logs++;
+            last_log = f->seq;
+            rc = noshell_lsm_replay(s, f->seq, &clean);
+            continue;
+        }
+        char *path = noshell_lsm_file(file_name, f->seq, "seg");
+        noshell_lsm_segment_t *seg = path ? noshell_lsm_segment_load(path, f->seq) : NULL;
+        free(path);
+        noshell_lsm_level_t *level = &s->levels[f->level];
+        if (!seg) {
+            rc = FOSSIL_NOSHELL_ERROR_CORRUPTED;
+        } else if (!noshell_lsm_level_insert(level, level->count, seg)) {
+            noshell_lsm_segment_release(seg);
+            rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        }
+    }
+
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && logs == 1 && clean) {
+        char *path = noshell_lsm_file(file_name, last_log, "wal");
+        s->wal = path ? fopen(path, "ab") : NULL;
+        s->wal_seq = last_log;
+        free(path);
+        if (!s->wal)
+            rc = FOSSIL_NOSHELL_ERROR_IO;
+    } else if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_lsm_mem_sort(&s->mem);
+        rc = noshell_lsm_write_sorted(s, &s->mem, 0, SIZE_MAX);
+        noshell_lsm_mem_free(&s->mem);
+        if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+            s->wal_seq = s->next_seq++;
+            char *path = noshell_lsm_file(file_name, s->wal_seq, "wal");
+            s->wal = path ? fopen(path, "ab") : NULL;
+            free(path);
+            if (!s->wal)
+                rc = FOSSIL_NOSHELL_ERROR_IO;
+        }
+        if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+            rc = noshell_lsm_manifest_write(s);
+        for (size_t i = 0; rc == FOSSIL_NOSHELL_ERROR_SUCCESS && i < man.count; ++i) {
+            if (man.files[i].level < 0)
+                noshell_lsm_remove_file(file_name, man.files[i].seq, "wal");
+        }
+    }
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        s->running = fossil_bluecrab_thread_start(&s->thread, noshell_lsm_worker, s);
+        if (!s->running)
+            rc = FOSSIL_NOSHELL_ERROR_UNKNOWN;
+    }
+    free(man.files);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        if (s) {
+            s->dropping = true;
+            noshell_lsm_free(s);
+        }
+        return rc;
+    }
+    *out = s;
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+/**
+ * Returns the store of file_name with an extra reference, opening it when
+ * the manifest exists, or NULL (with SUCCESS) for a plain text database.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_acquire(const char *file_name, noshell_lsm_t **out) {
+    *out = NULL;
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    fossil_bluecrab_thread_mutex_lock(&f->lsm_mutex);
+    noshell_lsm_t *s = f->lsm;
+    if (!s && noshell_lsm_enabled(file_name)) {
+        rc = noshell_lsm_open(file_name, &s);
+        if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+            s->refs = 1;
+            s->file = f;
+            noshell_file_retain(f);
+            f->lsm = s;
+        } else {
+            s = NULL;
+        }
+    }
+    if (s) {
+        s->refs++;
+        *out = s;
+    }
+    fossil_bluecrab_thread_mutex_unlock(&f->lsm_mutex);
+    noshell_file_release(f);
+    return rc;
+}
+
+static void noshell_lsm_release(noshell_lsm_t *s) {
+    fossil_bluecrab_thread_mutex_lock(&s->file->lsm_mutex);
+    bool last = --s->refs == 0;
+    fossil_bluecrab_thread_mutex_unlock(&s->file->lsm_mutex);
+    if (last)
+        noshell_lsm_free(s);
+}
+
+/** Takes the store of file_name out of the registry, keeping its reference. */
+static noshell_lsm_t *noshell_lsm_detach(const char *file_name) {
+    noshell_file_t *f = noshell_file_acquire(file_name);
+    if (!f)
+        return NULL;
+    fossil_bluecrab_thread_mutex_lock(&f->lsm_mutex);
+    noshell_lsm_t *s = f->lsm;
+    f->lsm = NULL;
+    fossil_bluecrab_thread_mutex_unlock(&f->lsm_mutex);
+    noshell_file_release(f);
+    return s;
+}
+
+/** Closes the store of file_name without writing anything and removes its files. */
+static void noshell_lsm_drop(const char *file_name) {
+    noshell_lsm_t *s = noshell_lsm_detach(file_name);
+    if (s) {
+        fossil_bluecrab_thread_mutex_lock(&s->mutex);
+        s->dropping = true;
+        fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+        noshell_lsm_release(s);
+    }
+    noshell_lsm_remove_files(file_name);
+}
+
+// ---- operations used by the file-name functions ---------------------------
+
+typedef struct {
+    const noshell_matcher_t *matcher;   // NULL matches every document
+    const char *type_tag;
+    size_t      type_tag_len;
+    char       *result;
+    size_t      buffer_size;
+    bool      (*cb)(const char *document, void *userdata);
+    void       *userdata;
+    uint64_t   *ids;
+    size_t      count;
+    size_t      cap;
+    bool        failed;
+} noshell_lsm_query_t;
+
+static bool noshell_lsm_query_test(const noshell_lsm_query_t *q, const char *line, size_t len) {
+    if (q->matcher && !noshell_matcher_test(q->matcher, line))
+        return false;
+    return !q->type_tag_len || fossil_bluecrab_scan_find(line, len, q->type_tag, q->type_tag_len) != NULL;
+}
+
+static bool noshell_lsm_first_visit(void *ctx, uint64_t id, const char *line, size_t len) {
+    noshell_lsm_query_t *q = (noshell_lsm_query_t *)ctx;
+    (void)id;
+    if (!noshell_lsm_query_test(q, line, len))
+        return false;
+    strncpy(q->result, line, q->buffer_size - 1);
+    q->result[q->buffer_size - 1] = '\0';
+    return true;
+}
+
+static bool noshell_lsm_cb_visit(void *ctx, uint64_t id, const char *line, size_t len) {
+    noshell_lsm_query_t *q = (noshell_lsm_query_t *)ctx;
+    (void)id;
+    return noshell_lsm_query_test(q, line, len) && q->cb(line, q->userdata);
+}
+
+static bool noshell_lsm_match_visit(void *ctx, uint64_t id, const char *line, size_t len) {
+    noshell_lsm_query_t *q = (noshell_lsm_query_t *)ctx;
+    if (!noshell_lsm_query_test(q, line, len))
+        return false;
+    if (q->count == q->cap) {
+        size_t cap = q->cap ? q->cap * 2 : 64;
+        uint64_t *grown = (uint64_t *)realloc(q->ids, cap * sizeof(*grown));
+        if (!grown)
+            return q->failed = true;
+        q->ids = grown;
+        q->cap = cap;
+    }
+    q->ids[q->count++] = id;
+    return false;
+}
+
+static bool noshell_lsm_count_visit(void *ctx, uint64_t id, const char *line, size_t len) {
+    noshell_meta_t *meta = (noshell_meta_t *)ctx;
+    (void)id;
+    noshell_meta_count(meta, line, len, true);
+    meta->size += len;
+    return false;
+}
+
+static bool noshell_lsm_write_visit(void *ctx, uint64_t id, const char *line, size_t len) {
+    (void)id;
+    return fwrite(line, 1, len, (FILE *)ctx) != len;
+}
+
+static fossil_bluecrab_noshell_error_t noshell_lsm_find(
+    noshell_lsm_t *s, const noshell_matcher_t *matcher, const char *type_tag, char *result, size_t buffer_size
+) {
+    noshell_lsm_query_t q = {0};
+    q.matcher = matcher;
+    q.type_tag = type_tag;
+    q.type_tag_len = strlen(type_tag);
+    q.result = result;
+    q.buffer_size = buffer_size;
+    return noshell_lsm_each(s, noshell_lsm_first_visit, &q);
+}
+
+static fossil_bluecrab_noshell_error_t noshell_lsm_find_cb(
+    noshell_lsm_t *s, const noshell_matcher_t *matcher, bool (*cb)(const char *document, void *userdata), void *userdata
+) {
+    noshell_lsm_query_t q = {0};
+    q.matcher = matcher;
+    q.cb = cb;
+    q.userdata = userdata;
+    return noshell_lsm_each(s, noshell_lsm_cb_visit, &q);
+}
+
+/**
+ * Newest version of key (store mutex held): SUCCESS sets *line (NULL for a
+ * removal, otherwise valid until the next read) and *len.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_lookup(noshell_lsm_t *s, uint64_t key, const char **line, size_t *len) {
+    fossil_bluecrab_noshell_error_t rc = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    const noshell_lsm_entry_t *e = noshell_lsm_mem_find(&s->mem, key);
+    if (!e && s->has_imm)
+        e = noshell_lsm_mem_find(&s->imm, key);
+    if (e) {
+        *line = e->line;
+        *len = e->len;
+        rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+    }
+    for (size_t i = 0; rc == FOSSIL_NOSHELL_ERROR_NOT_FOUND && i < s->levels[0].count; ++i)
+        rc = noshell_lsm_segment_get(s, s->levels[0].segs[i], key, line, len);
+    for (size_t l = 1; rc == FOSSIL_NOSHELL_ERROR_NOT_FOUND && l < FOSSIL_NOSHELL_LSM_LEVELS; ++l) {
+        // The one segment whose range can hold the id
+        const noshell_lsm_level_t *level = &s->levels[l];
+        size_t lo = 0, hi = level->count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (level->segs[mid]->max_id < key)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo < level->count)
+            rc = noshell_lsm_segment_get(s, level->segs[lo], key, line, len);
+    }
+    return rc;
+}
+
+static fossil_bluecrab_noshell_error_t noshell_lsm_find_by_id(noshell_lsm_t *s, const char *id, char *result, size_t buffer_size) {
+    const char *line = NULL;
+    size_t len = 0;
+    fossil_bluecrab_thread_mutex_lock(&s->mutex);
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_lookup(s, noshell_parse_id(id), &line, &len);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && !line)
+        rc = FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        size_t n = len < buffer_size - 1 ? len : buffer_size - 1;
+        memcpy(result, line, n);
+        result[n] = '\0';
+    }
+    fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+    return rc;
+}
+
+/**
+ * Inserts under *id, the content hash, or the next free id when that slot is
+ * taken (updates keep a document's original id, and the same document may be
+ * inserted twice), as text mode does. The id used is written back to *id.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_insert(
+    noshell_lsm_t *s, const char *document, const char *param_list, const char *type, uint64_t *id
+) {
+    bool has_params = param_list && strlen(param_list) > 0;
+    size_t size = strlen(document) + (has_params ? strlen(param_list) + 1 : 0) + strlen(type) + 32;
+    char *line = (char *)malloc(size);
+    if (!line)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+
+    fossil_bluecrab_thread_mutex_lock(&s->mutex);
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_make_room(s);
+    for (uint64_t key = *id; rc == FOSSIL_NOSHELL_ERROR_SUCCESS; ++key) {
+        const char *held = NULL;
+        size_t held_len = 0;
+        rc = noshell_lsm_lookup(s, key, &held, &held_len);
+        if (rc == FOSSIL_NOSHELL_ERROR_NOT_FOUND)
+            rc = FOSSIL_NOSHELL_ERROR_SUCCESS;
+        if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS || held)
+            continue;
+        int n = snprintf(line, size, "%s%s%s #type=%s #id=%016" PRIx64 "\n", document,
+                         has_params ? " " : "", has_params ? param_list : "", type, key);
+        rc = noshell_lsm_log(s, key, line, (size_t)n);
+        if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+            line = NULL;
+            *id = key;
+        }
+        break;
+    }
+    fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+    free(line);
+    return rc;
+}
+
+/**
+ * update/remove: collects the ids of matching documents, then writes a new
+ * version (new_body plus the id) or a removal for each.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_apply(
+    noshell_lsm_t *s, const noshell_matcher_t *matcher, const char *type_tag, const char *new_body
+) {
+    noshell_lsm_query_t q = {0};
+    q.matcher = matcher;
+    q.type_tag = type_tag;
+    q.type_tag_len = strlen(type_tag);
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_each(s, noshell_lsm_match_visit, &q);
+    if (rc == FOSSIL_NOSHELL_ERROR_NOT_FOUND || rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+        rc = q.failed ? FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY
+                      : (q.count ? FOSSIL_NOSHELL_ERROR_SUCCESS : FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+
+    size_t size = new_body ? strlen(new_body) + 24 : 0;
+    char *line = rc == FOSSIL_NOSHELL_ERROR_SUCCESS && new_body ? (char *)malloc(size) : NULL;
+    if (new_body && !line && rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+        rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    for (size_t i = 0; rc == FOSSIL_NOSHELL_ERROR_SUCCESS && i < q.count; ++i) {
+        if (new_body) {
+            int n = snprintf(line, size, "%s #id=%016" PRIx64 "\n", new_body, q.ids[i]);
+            rc = noshell_lsm_write(s, q.ids[i], line, (size_t)n);
+        } else {
+            rc = noshell_lsm_write(s, q.ids[i], NULL, 0);
+        }
+    }
+    free(line);
+    free(q.ids);
+    return rc;
+}
+
+/** First live id after prev_id (or the first of all), in id order. */
+static fossil_bluecrab_noshell_error_t noshell_lsm_step(noshell_lsm_t *s, const char *prev_id, char *id_buffer, size_t buffer_size) {
+    uint64_t from = 0;
+    if (prev_id) {
+        uint64_t prev = noshell_parse_id(prev_id);
+        if (prev == UINT64_MAX)
+            return FOSSIL_NOSHELL_ERROR_NOT_FOUND;
+        from = prev + 1;
+    }
+    fossil_bluecrab_thread_mutex_lock(&s->mutex);
+    noshell_lsm_scan_t scan;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_scan_open(s, false, &scan);
+    for (size_t i = 0; rc == FOSSIL_NOSHELL_ERROR_SUCCESS && i < scan.count; ++i) {
+        if (!noshell_lsm_source_start(&scan.sources[i], from))
+            rc = FOSSIL_NOSHELL_ERROR_IO;
+    }
+    while (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_lsm_source_t *top;
+        rc = noshell_lsm_merge_next(scan.sources, scan.count, &top);
+        if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && top->line) {
+            snprintf(id_buffer, buffer_size, "%016" PRIx64, top->id);
+            break;
+        }
+    }
+    if (scan.sources)
+        noshell_lsm_scan_close(s, &scan, true);
+    fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+    return rc;
+}
+
+/** Live counts (meta->size is the live document bytes) and bytes on disk. */
+static fossil_bluecrab_noshell_error_t noshell_lsm_stats(noshell_lsm_t *s, noshell_meta_t *meta, uint64_t *disk_bytes) {
+    memset(meta, 0, sizeof(*meta));
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_each(s, noshell_lsm_count_visit, meta);
+    if (rc != FOSSIL_NOSHELL_ERROR_NOT_FOUND)
+        return rc;
+
+    struct stat sb;
+    uint64_t bytes = stat(s->path, &sb) == 0 ? (uint64_t)sb.st_size : 0;
+    fossil_bluecrab_thread_mutex_lock(&s->mutex);
+    for (size_t l = 0; l < FOSSIL_NOSHELL_LSM_LEVELS; ++l)
+        bytes += noshell_lsm_level_bytes(&s->levels[l]);
+    uint64_t logs[2] = { s->wal_seq, s->imm_wal };
+    for (int i = 0; i < (s->has_imm ? 2 : 1); ++i) {
+        char *path = noshell_lsm_file(s->path, logs[i], "wal");
+        if (path && stat(path, &sb) == 0)
+            bytes += (uint64_t)sb.st_size;
+        free(path);
+    }
+    fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+    *disk_bytes = bytes;
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+/** Writes the database as a plain text file: header, "{ }", then the live documents. */
+static fossil_bluecrab_noshell_error_t noshell_lsm_write_text(noshell_lsm_t *s, FILE *out) {
+    if (fputs(noshell_lsm_header, out) == EOF || fputs("{ }\n", out) == EOF)
+        return FOSSIL_NOSHELL_ERROR_IO;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_each(s, noshell_lsm_write_visit, out);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return FOSSIL_NOSHELL_ERROR_IO;     // the writer stopped on an error
+    if (rc == FOSSIL_NOSHELL_ERROR_NOT_FOUND)
+        rc = fflush(out) == 0 ? FOSSIL_NOSHELL_ERROR_SUCCESS : FOSSIL_NOSHELL_ERROR_IO;
+    return rc;
+}
+
+/**
+ * Gives a text line that cannot keep its id in m (it has none, or an
+ * earlier line holds it) the next id m leaves free, counting up from its
+ * own id or, without one, from the hash of the text before its #type=
+ * tag. *out is a malloc'd copy with the #id= set and the newline kept.
+ */
+static fossil_bluecrab_noshell_error_t noshell_lsm_renumber(
+    const noshell_lsm_memtable_t *m, const char *line, char **out, size_t *out_len, uint64_t *out_id
+) {
+    size_t len = strlen(line);
+    const char *tag = strstr(line, "#id=");
+    const char *eol = line + strcspn(line, "\r\n");
+    uint64_t id;
+    if (tag) {
+        noshell_line_id(line, len, &id);
+    } else {
+        const char *end = strstr(line, " #type=");
+        id = fossil_bluecrab_hash64_legacy(line, (size_t)((end ? end : eol) - line));
+    }
+    while (noshell_lsm_mem_find(m, id))
+        id++;
+
+    // New digits replace the old ones, or a new tag goes before the line end
+    const char *cut = tag ? tag : eol;
+    const char *rest = tag ? tag + 4 + strspn(tag + 4, "0123456789abcdefABCDEF") : eol;
+    size_t size = len + 32;
+    char *copy = (char *)malloc(size);
+    if (!copy)
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    int n = snprintf(copy, size, "%.*s%s#id=%016" PRIx64 "%s", (int)(cut - line), line, tag ? "" : " ", id, rest);
+    *out = copy;
+    *out_len = (size_t)n;
+    *out_id = id;
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
+
+// ---- public API -----------------------------------------------------------
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_lsm_enable(const char *file_name, const fossil_bluecrab_noshell_lsm_options_t *options) {
+    if (!file_name || !fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_lsm_t *s;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_acquire(file_name, &s);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS)
+        return rc;
+    if (s) {
+        if (options) {
+            fossil_bluecrab_thread_mutex_lock(&s->mutex);
+            s->options = *options;
+            noshell_lsm_options_fix(&s->options);
+            rc = noshell_lsm_manifest_write(s);
+            fossil_bluecrab_thread_cond_broadcast(&s->cond);
+            fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+        }
+        noshell_lsm_release(s);
+        return rc;
+    }
+
+    // A handle would keep serving its own document table
+    fossil_bluecrab_noshell_t *db = noshell_handle_borrow(file_name);
+    if (db) {
+        fossil_bluecrab_noshell_close(db);
+        return FOSSIL_NOSHELL_ERROR_LOCKED;
+    }
+
+    FILE *fp = fopen(file_name, "rb");
+    if (!fp)
+        return FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND;
+    char header[16] = {0};
+    if (!fgets(header, sizeof(header), fp) || strncmp(header, "#fson_types=", 12) != 0) {
+        fclose(fp);
+        return FOSSIL_NOSHELL_ERROR_SCHEMA_MISMATCH;
+    }
+    noshell_tombs_t tombs;
+    rc = noshell_tombs_load(file_name, fp, &tombs);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        fclose(fp);
+        return rc;
+    }
+    s = noshell_lsm_new(file_name);
+    if (!s) {
+        noshell_tombs_free(&tombs);
+        fclose(fp);
+        return FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+    }
+    if (options)
+        s->options = *options;
+    noshell_lsm_options_fix(&s->options);
+
+    // Every live document moves; the first to carry an id keeps it
+    fseek(fp, 0, SEEK_SET);
+    noshell_reader_t reader;
+    noshell_reader_init(&reader, fp);
+    char *line;
+    size_t len;
+    uint64_t offset = 0;
+    char **moved = NULL;            // id-less or colliding lines, renumbered below
+    size_t moved_count = 0, moved_cap = 0;
+    while (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && (line = noshell_reader_next(&reader, &len)) != NULL) {
+        uint64_t at = offset, id = 0;
+        offset += len;
+        if (line[0] == '#' || !noshell_is_document(line) || noshell_tombs_has(&tombs, at))
+            continue;
+        bool has_id = noshell_line_id(line, len, &id);
+        if (!has_id && strncmp(line, "{ }", 3) == 0 && strspn(line + 3, "\r\n") == len - 3)
+            continue;   // create_database's placeholder, which lsm_disable writes back
+        bool keeps_id = has_id && !noshell_lsm_mem_find(&s->mem, id);
+        bool terminated = line[len - 1] == '\n';
+        char *copy = (char *)malloc(len + 2);
+        if (!copy) {
+            rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        memcpy(copy, line, len);
+        if (!terminated)
+            copy[len++] = '\n';
+        copy[len] = '\0';
+        if (keeps_id) {
+            if (!noshell_lsm_mem_put(&s->mem, id, copy, len)) {
+                free(copy);
+                rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+            }
+            continue;
+        }
+        if (moved_count == moved_cap) {
+            size_t cap = moved_cap ? moved_cap * 2 : 16;
+            char **grown = (char **)realloc(moved, cap * sizeof(*grown));
+            if (!grown) {
+                free(copy);
+                rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+            moved = grown;
+            moved_cap = cap;
+        }
+        moved[moved_count++] = copy;
+    }
+    noshell_reader_free(&reader);
+    noshell_tombs_free(&tombs);
+    fclose(fp);
+
+    // Only once every kept id is known, so no renumbered line takes one
+    for (size_t i = 0; i < moved_count; ++i) {
+        char *renumbered = NULL;
+        size_t renumbered_len = 0;
+        uint64_t id = 0;
+        if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+            rc = noshell_lsm_renumber(&s->mem, moved[i], &renumbered, &renumbered_len, &id);
+        if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && !noshell_lsm_mem_put(&s->mem, id, renumbered, renumbered_len)) {
+            free(renumbered);
+            rc = FOSSIL_NOSHELL_ERROR_OUT_OF_MEMORY;
+        }
+        free(moved[i]);
+    }
+    free(moved);
+
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_lsm_mem_sort(&s->mem);
+        rc = noshell_lsm_write_sorted(s, &s->mem, 1, s->options.segment_bytes);
+    }
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS)
+        rc = noshell_lsm_manifest_write(s);
+
+    // The manifest is in place: the text file shrinks to its header
+    char *tmp_path = rc == FOSSIL_NOSHELL_ERROR_SUCCESS ? noshell_meta_path(file_name, ".tmp") : NULL;
+    FILE *anchor = tmp_path ? fopen(tmp_path, "wb") : NULL;
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        bool ok = anchor && fputs(noshell_lsm_header, anchor) != EOF && fputs("#engine=lsm\n", anchor) != EOF;
+        ok = anchor && fclose(anchor) == 0 && ok;
+        if (!(ok && noshell_lsm_replace(tmp_path, file_name))) {
+            if (tmp_path)
+                remove(tmp_path);
+            rc = FOSSIL_NOSHELL_ERROR_IO;
+        }
+    }
+    free(tmp_path);
+    if (rc != FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        for (size_t l = 0; l < FOSSIL_NOSHELL_LSM_LEVELS; ++l) {
+            for (size_t i = 0; i < s->levels[l].count; ++i)
+                s->levels[l].segs[i]->obsolete = true;
+        }
+        char *path = noshell_meta_path(file_name, ".lsm");
+        if (path)
+            remove(path);
+        free(path);
+    }
+    noshell_lsm_free(s);
+    noshell_file_invalidate(file_name);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_lsm_disable(const char *file_name) {
+    if (!file_name || !fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_lsm_t *s;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_acquire(file_name, &s);
+    if (!s)
+        return rc;
+
+    // Text first: until the manifest goes, the engine stays authoritative
+    char *tmp_path = noshell_meta_path(file_name, ".tmp");
+    FILE *out = tmp_path ? fopen(tmp_path, "wb") : NULL;
+    rc = out ? noshell_lsm_write_text(s, out) : FOSSIL_NOSHELL_ERROR_IO;
+    if (out && fclose(out) != 0)
+        rc = FOSSIL_NOSHELL_ERROR_IO;
+    noshell_lsm_release(s);
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && !noshell_lsm_replace(tmp_path, file_name))
+        rc = FOSSIL_NOSHELL_ERROR_IO;
+    if (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        noshell_lsm_drop(file_name);
+    } else if (tmp_path) {
+        remove(tmp_path);
+    }
+    free(tmp_path);
+    noshell_file_invalidate(file_name);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_lsm_flush(const char *file_name) {
+    if (!file_name || !fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_lsm_t *s;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_acquire(file_name, &s);
+    if (!s)
+        return rc != FOSSIL_NOSHELL_ERROR_SUCCESS ? rc : FOSSIL_NOSHELL_ERROR_UNSUPPORTED;
+    rc = noshell_lsm_flush(s);
+    noshell_lsm_release(s);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_lsm_info(const char *file_name, fossil_bluecrab_noshell_lsm_info_t *info) {
+    if (!file_name || !info || !fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_lsm_t *s;
+    fossil_bluecrab_noshell_error_t rc = noshell_lsm_acquire(file_name, &s);
+    if (!s)
+        return rc != FOSSIL_NOSHELL_ERROR_SUCCESS ? rc : FOSSIL_NOSHELL_ERROR_UNSUPPORTED;
+    memset(info, 0, sizeof(*info));
+    fossil_bluecrab_thread_mutex_lock(&s->mutex);
+    info->memtable_entries = s->mem.count + (s->has_imm ? s->imm.count : 0);
+    info->memtable_bytes = s->mem.bytes + (s->has_imm ? s->imm.bytes : 0);
+    for (size_t l = 0; l < FOSSIL_NOSHELL_LSM_LEVELS; ++l) {
+        info->segments[l] = s->levels[l].count;
+        info->level_bytes[l] = (size_t)noshell_lsm_level_bytes(&s->levels[l]);
+    }
+    info->flushes = s->flushes;
+    info->compactions = s->compactions;
+    rc = s->failed;
+    fossil_bluecrab_thread_mutex_unlock(&s->mutex);
+    noshell_lsm_release(s);
+    return rc;
+}
+
+fossil_bluecrab_noshell_error_t fossil_bluecrab_noshell_lsm_close(const char *file_name) {
+    if (!file_name || !fossil_bluecrab_noshell_validate_extension(file_name))
+        return FOSSIL_NOSHELL_ERROR_INVALID_FILE;
+
+    noshell_lsm_t *s = noshell_lsm_detach(file_name);
+    if (s)
+        noshell_lsm_release(s);
+    return FOSSIL_NOSHELL_ERROR_SUCCESS;
+}
@@ -0,0 +1,310 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include "fossil/crabdb/query.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+void fossil_bluecrab_query_lex_next(fossil_bluecrab_query_lexer_t *lx) {
+    const char *p = lx->cur;
+    while (*p && isspace((unsigned char)*p)) p++;
+    lx->start = p;
+    if (!*p) {
+        lx->kind = FOSSIL_QUERY_TOK_END;
+        lx->len = 0;
+    } else if (isalpha((unsigned char)*p) || *p == '_') {
+        while (isalnum((unsigned char)*p) || *p == '_' || (*p && strchr(lx->syntax->ident_chars, *p))) p++;
+        lx->kind = FOSSIL_QUERY_TOK_IDENT;
+    } else if (*p == '\'' || *p == '"') {
+        char quote = *p++;
+        for (;;) {
+            if (!*p) {
+                lx->kind = FOSSIL_QUERY_TOK_ERROR;
+                break;
+            }
+            if (*p == quote) {
+                if (p[1] == quote) { p += 2; continue; }  // doubled quote escapes itself
+                p++;
+                lx->kind = FOSSIL_QUERY_TOK_STRING;
+                break;
+            }
+            p++;
+        }
+    } else if (isdigit((unsigned char)*p) || ((*p == '-' || *p == '+' || *p == '.') &&
+               (isdigit((unsigned char)p[1]) || (p[1] == '.' && isdigit((unsigned char)p[2]))))) {
+        char *end = NULL;
+        strtod(p, &end);
+        p = end > p ? end : p + 1;
+        lx->kind = FOSSIL_QUERY_TOK_NUMBER;
+    } else if ((p[0] == '!' && p[1] == '=') || (p[0] == '<' && (p[1] == '=' || p[1] == '>')) ||
+               (p[0] == '>' && p[1] == '=')) {
+        p += 2;
+        lx->kind = FOSSIL_QUERY_TOK_SYMBOL;
+    } else if (strchr(lx->syntax->symbols, *p)) {
+        p++;
+        lx->kind = FOSSIL_QUERY_TOK_SYMBOL;
+    } else {
+        lx->kind = FOSSIL_QUERY_TOK_ERROR;
+        p++;
+    }
+    lx->len = (size_t)(p - lx->start);
+    lx->cur = p;
+}
+
+void fossil_bluecrab_query_lex_init(fossil_bluecrab_query_lexer_t *lx, const char *text, const fossil_bluecrab_query_syntax_t *syntax) {
+    lx->syntax = syntax;
+    lx->cur = text;
+    lx->kind = FOSSIL_QUERY_TOK_END;
+    lx->start = text;
+    lx->len = 0;
+    lx->oom = false;
+    fossil_bluecrab_query_lex_next(lx);
+}
+
+bool fossil_bluecrab_query_lex_is(const fossil_bluecrab_query_lexer_t *lx, const char *word) {
+    size_t n = strlen(word);
+    if (lx->len != n || (lx->kind != FOSSIL_QUERY_TOK_IDENT && lx->kind != FOSSIL_QUERY_TOK_SYMBOL))
+        return false;
+    for (size_t i = 0; i < n; ++i) {
+        if (tolower((unsigned char)lx->start[i]) != tolower((unsigned char)word[i]))
+            return false;
+    }
+    return true;
+}
+
+bool fossil_bluecrab_query_lex_accept(fossil_bluecrab_query_lexer_t *lx, const char *word) {
+    if (!fossil_bluecrab_query_lex_is(lx, word))
+        return false;
+    fossil_bluecrab_query_lex_next(lx);
+    return true;
+}
+
+void fossil_bluecrab_query_pred_free(fossil_bluecrab_query_pred_t *pred) {
+    if (!pred) return;
+    fossil_bluecrab_query_pred_free(pred->left);
+    fossil_bluecrab_query_pred_free(pred->right);
+    free(pred->field);
+    free(pred->literal);
+    free(pred);
+}
+
+bool fossil_bluecrab_query_parse_number(const char *s, bool *integral, long long *ival, double *dval) {
+    char *end = NULL;
+    errno = 0;
+    long long i = strtoll(s, &end, 10);
+    if (end != s && errno == 0) {
+        while (isspace((unsigned char)*end)) end++;
+        if (*end == '\0') {
+            *integral = true;
+            *ival = i;
+            *dval = (double)i;
+            return true;
+        }
+    }
+    double d = strtod(s, &end);
+    if (end == s) return false;
+    while (isspace((unsigned char)*end)) end++;
+    if (*end != '\0') return false;
+    *integral = false;
+    *dval = d;
+    return true;
+}
+
+static fossil_bluecrab_query_pred_t *query_parse_or(fossil_bluecrab_query_lexer_t *lx, fossil_bluecrab_query_field_fn field);
+
+static fossil_bluecrab_query_pred_t *query_pred_node(fossil_bluecrab_query_lexer_t *lx, fossil_bluecrab_query_pred_kind_t kind,
+                                                     fossil_bluecrab_query_pred_t *left, fossil_bluecrab_query_pred_t *right) {
+    if (!left || (kind != FOSSIL_QUERY_PRED_NOT && !right)) {
+        fossil_bluecrab_query_pred_free(left);
+        fossil_bluecrab_query_pred_free(right);
+        return NULL;
+    }
+    fossil_bluecrab_query_pred_t *node = (fossil_bluecrab_query_pred_t *)calloc(1, sizeof(*node));
+    if (!node) {
+        lx->oom = true;
+        fossil_bluecrab_query_pred_free(left);
+        fossil_bluecrab_query_pred_free(right);
+        return NULL;
+    }
+    node->kind = kind;
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+static fossil_bluecrab_query_pred_t *query_parse_unary(fossil_bluecrab_query_lexer_t *lx, fossil_bluecrab_query_field_fn field) {
+    if (fossil_bluecrab_query_lex_accept(lx, "NOT"))
+        return query_pred_node(lx, FOSSIL_QUERY_PRED_NOT, query_parse_unary(lx, field), NULL);
+    if (fossil_bluecrab_query_lex_accept(lx, "(")) {
+        fossil_bluecrab_query_pred_t *inner = query_parse_or(lx, field);
+        if (inner && !fossil_bluecrab_query_lex_accept(lx, ")")) {
+            fossil_bluecrab_query_pred_free(inner);
+            return NULL;
+        }
+        return inner;
+    }
+
+    fossil_bluecrab_query_pred_t *pred = (fossil_bluecrab_query_pred_t *)calloc(1, sizeof(*pred));
+    if (!pred) {
+        lx->oom = true;
+        return NULL;
+    }
+    pred->kind = FOSSIL_QUERY_PRED_CMP;
+    if (!field(lx, pred)) {
+        fossil_bluecrab_query_pred_free(pred);
+        return NULL;
+    }
+
+    static const struct { const char *text; fossil_bluecrab_query_cmp_t op; } ops[] = {
+        { "=", FOSSIL_QUERY_CMP_EQ }, { "!=", FOSSIL_QUERY_CMP_NE }, { "<>", FOSSIL_QUERY_CMP_NE },
+        { "<", FOSSIL_QUERY_CMP_LT }, { "<=", FOSSIL_QUERY_CMP_LE }, { ">", FOSSIL_QUERY_CMP_GT },
+        { ">=", FOSSIL_QUERY_CMP_GE }, { "LIKE", FOSSIL_QUERY_CMP_LIKE }
+    };
+    size_t i = 0;
+    while (i < sizeof(ops) / sizeof(ops[0]) && !fossil_bluecrab_query_lex_is(lx, ops[i].text)) i++;
+    if (i == sizeof(ops) / sizeof(ops[0])) {
+        fossil_bluecrab_query_pred_free(pred);
+        return NULL;
+    }
+    fossil_bluecrab_query_lex_next(lx);
+
+    if (lx->kind != FOSSIL_QUERY_TOK_STRING && lx->kind != FOSSIL_QUERY_TOK_NUMBER && lx->kind != FOSSIL_QUERY_TOK_IDENT) {
+        fossil_bluecrab_query_pred_free(pred);
+        return NULL;
+    }
+
+    char *literal = (char *)malloc(lx->len + 1);
+    if (!literal) {
+        lx->oom = true;
+        fossil_bluecrab_query_pred_free(pred);
+        return NULL;
+    }
+    if (lx->kind == FOSSIL_QUERY_TOK_STRING) {
+        // Strip the quotes and collapse doubled quotes
+        char quote = lx->start[0];
+        size_t n = 0;
+        for (size_t k = 1; k + 1 < lx->len; ++k) {
+            literal[n++] = lx->start[k];
+            if (lx->start[k] == quote) k++;
+        }
+        literal[n] = '\0';
+    } else {
+        memcpy(literal, lx->start, lx->len);
+        literal[lx->len] = '\0';
+    }
+    pred->op = ops[i].op;
+    pred->literal = literal;
+    if (lx->kind == FOSSIL_QUERY_TOK_NUMBER && pred->op != FOSSIL_QUERY_CMP_LIKE) {
+        pred->numeric = fossil_bluecrab_query_parse_number(literal, &pred->integral, &pred->ival, &pred->dval);
+    }
+    fossil_bluecrab_query_lex_next(lx);
+    return pred;
+}
+
+static fossil_bluecrab_query_pred_t *query_parse_and(fossil_bluecrab_query_lexer_t *lx, fossil_bluecrab_query_field_fn field) {
+    fossil_bluecrab_query_pred_t *left = query_parse_unary(lx, field);
+    while (left && fossil_bluecrab_query_lex_accept(lx, "AND"))
+        left = query_pred_node(lx, FOSSIL_QUERY_PRED_AND, left, query_parse_unary(lx, field));
+    return left;
+}
+
+static fossil_bluecrab_query_pred_t *query_parse_or(fossil_bluecrab_query_lexer_t *lx, fossil_bluecrab_query_field_fn field) {
+    fossil_bluecrab_query_pred_t *left = query_parse_and(lx, field);
+    while (left && fossil_bluecrab_query_lex_accept(lx, "OR"))
+        left = query_pred_node(lx, FOSSIL_QUERY_PRED_OR, left, query_parse_and(lx, field));
+    return left;
+}
+
+fossil_bluecrab_query_pred_t *fossil_bluecrab_query_parse_where(fossil_bluecrab_query_lexer_t *lx, fossil_bluecrab_query_field_fn field) {
+    return query_parse_or(lx, field);
+}
+
+bool fossil_bluecrab_query_like(const char *s, size_t len, const char *pattern) {
+    const char *star = NULL;
+    size_t i = 0, resume = 0;
+    while (i < len) {
+        if (*pattern == '%') {
+            star = pattern++;
+            resume = i;
+        } else if (*pattern && (*pattern == '_' || *pattern == s[i])) {
+            pattern++;
+            i++;
+        } else if (star) {
+            pattern = star + 1;
+            i = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '%') pattern++;
+    return *pattern == '\0';
+}
+
+bool fossil_bluecrab_query_compare(const fossil_bluecrab_query_pred_t *pred, const char *value, size_t len) {
+    if (pred->op == FOSSIL_QUERY_CMP_LIKE)
+        return fossil_bluecrab_query_like(value, len, pred->literal);
+
+    int cmp;
+    bool integral = false;
+    long long ival = 0;
+    double dval = 0;
+    bool is_number = false;
+    if (pred->numeric) {
+        // Values are not terminated where they end; parse a copy
+        char stack[64];
+        char *number = len < sizeof(stack) ? stack : (char *)malloc(len + 1);
+        if (number) {
+            memcpy(number, value, len);
+            number[len] = '\0';
+            is_number = fossil_bluecrab_query_parse_number(number, &integral, &ival, &dval);
+            if (number != stack) free(number);
+        }
+    }
+    if (is_number) {
+        if (integral && pred->integral)
+            cmp = (ival > pred->ival) - (ival < pred->ival);
+        else
+            cmp = (dval > pred->dval) - (dval < pred->dval);
+    } else if (pred->numeric && pred->op != FOSSIL_QUERY_CMP_EQ && pred->op != FOSSIL_QUERY_CMP_NE) {
+        return false;  // ordering a non-number against a number
+    } else {
+        size_t lit_len = strlen(pred->literal);
+        cmp = memcmp(value, pred->literal, len < lit_len ? len : lit_len);
+        if (cmp == 0)
+            cmp = (len > lit_len) - (len < lit_len);
+    }
+
+    switch (pred->op) {
+        case FOSSIL_QUERY_CMP_EQ: return cmp == 0;
+        case FOSSIL_QUERY_CMP_NE: return cmp != 0;
+        case FOSSIL_QUERY_CMP_LT: return cmp < 0;
+        case FOSSIL_QUERY_CMP_LE: return cmp <= 0;
+        case FOSSIL_QUERY_CMP_GT: return cmp > 0;
+        case FOSSIL_QUERY_CMP_GE: return cmp >= 0;
+        default:                  return false;
+    }
+}
@@ -0,0 +1,416 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include "fossil/crabdb/scan.h"
+
+#include <string.h>
+
+/**
+ * @brief Shared byte-scanning kernels for the text file formats.
+ *
+ * Every MyShell and NoShell scan is the same few steps per line: find the
+ * newline, find a "#tag=" marker or '=' delimiter, parse a 16-digit hex
+ * hash or id. These kernels do each step a vector at a time:
+ *
+ *   byte search : compare 16 (SSE2, NEON) or 32 (AVX2) bytes against the
+ *                 target and take the lowest set bit of the match mask.
+ *   find        : the same, on two overlapping loads compared against the
+ *                 needle's first and second byte, so only positions where
+ *                 both match are compared in full.
+ *   hex64       : subtract '0' and 'a' from all 16 digits at once, range
+ *                 check both, select, then fold digit pairs into bytes.
+ *
+ * AVX2 is detected at load time on GCC/Clang x86 builds and used for
+ * ranges long enough to pay for the wider loads. All paths return what the
+ * scalar loops would. Define FOSSIL_BLUECRAB_SCAN_SCALAR to build without
+ * vector kernels.
+ */
+
+#if !defined(FOSSIL_BLUECRAB_SCAN_SCALAR)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FOSSIL_SCAN_HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#define FOSSIL_SCAN_HAVE_AVX2 1
+#include <immintrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define FOSSIL_SCAN_HAVE_AVX2 1
+#define FOSSIL_SCAN_AVX2_RUNTIME 1
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define FOSSIL_SCAN_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/** Ranges shorter than this skip the AVX2 run-time check. */
+#define SCAN_AVX2_MIN 64
+
+// ===========================================================
+// Primitives
+// ===========================================================
+
+static inline unsigned scan_ctz32(uint32_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctz(x);
+#elif defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward(&i, x);
+    return (unsigned)i;
+#else
+    unsigned n = 0;
+    while (!(x & 1u)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+#if defined(FOSSIL_SCAN_HAVE_NEON)
+/** Four bits per byte lane (0xF where the lane is set), lane 0 lowest. */
+static inline uint64_t scan_neon_mask(uint8x16_t eq) {
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+}
+
+static inline unsigned scan_ctz64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctzll(x);
+#elif defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (unsigned)i;
+#else
+    unsigned n = 0;
+    while (!(x & 1u)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+#endif
+
+static inline int scan_hex_digit(unsigned char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/** Compares the needle's tail (past its first two bytes) at a candidate. */
+static inline bool scan_tail_matches(const uint8_t *at, const uint8_t *needle, size_t needle_len) {
+    return needle_len <= 2 || memcmp(at + 2, needle + 2, needle_len - 2) == 0;
+}
+
+// ===========================================================
+// Kernels
+// ===========================================================
+
+/*
+ * Each kernel scans p[i..] a vector at a time while a full vector (plus,
+ * for the pair kernels, the one byte of lookahead) fits, returning the
+ * match offset or stopping with *pos at the first unscanned byte for the
+ * scalar tail.
+ */
+
+#if defined(FOSSIL_SCAN_HAVE_SSE2)
+static size_t scan_byte_sse2(const uint8_t *p, size_t len, uint8_t c, size_t *pos) {
+    __m128i target = _mm_set1_epi8((char)c);
+    size_t i = *pos;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, target));
+        if (mask)
+            return i + scan_ctz32(mask);
+    }
+    *pos = i;
+    return len;
+}
+
+static size_t scan_pair_sse2(const uint8_t *p, size_t len, const uint8_t *needle, size_t needle_len, size_t *pos) {
+    __m128i first = _mm_set1_epi8((char)needle[0]);
+    __m128i second = _mm_set1_epi8((char)needle[1]);
+    size_t i = *pos;
+    for (; i + 16 + needle_len - 1 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(p + i + 1));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, second)));
+        while (mask) {
+            size_t at = i + scan_ctz32(mask);
+            if (scan_tail_matches(p + at, needle, needle_len))
+                return at;
+            mask &= mask - 1;
+        }
+    }
+    *pos = i;
+    return len;
+}
+#endif
+
+#if defined(FOSSIL_SCAN_HAVE_AVX2)
+#ifdef FOSSIL_SCAN_AVX2_RUNTIME
+__attribute__((target("avx2")))
+#endif
+static size_t scan_byte_avx2(const uint8_t *p, size_t len, uint8_t c, size_t *pos) {
+    __m256i target = _mm256_set1_epi8((char)c);
+    size_t i = *pos;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, target));
+        if (mask)
+            return i + scan_ctz32(mask);
+    }
+    *pos = i;
+    return len;
+}
+
+#ifdef FOSSIL_SCAN_AVX2_RUNTIME
+__attribute__((target("avx2")))
+#endif
+static size_t scan_pair_avx2(const uint8_t *p, size_t len, const uint8_t *needle, size_t needle_len, size_t *pos) {
+    __m256i first = _mm256_set1_epi8((char)needle[0]);
+    __m256i second = _mm256_set1_epi8((char)needle[1]);
+    size_t i = *pos;
+    for (; i + 32 + needle_len - 1 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(p + i + 1));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, second)));
+        while (mask) {
+            size_t at = i + scan_ctz32(mask);
+            if (scan_tail_matches(p + at, needle, needle_len))
+                return at;
+            mask &= mask - 1;
+        }
+    }
+    *pos = i;
+    return len;
+}
+#endif
+
+#if defined(FOSSIL_SCAN_HAVE_NEON)
+static size_t scan_byte_neon(const uint8_t *p, size_t len, uint8_t c, size_t *pos) {
+    uint8x16_t target = vdupq_n_u8(c);
+    size_t i = *pos;
+    for (; i + 16 <= len; i += 16) {
+        uint64_t mask = scan_neon_mask(vceqq_u8(vld1q_u8(p + i), target));
+        if (mask)
+            return i + scan_ctz64(mask) / 4;
+    }
+    *pos = i;
+    return len;
+}
+
+static size_t scan_pair_neon(const uint8_t *p, size_t len, const uint8_t *needle, size_t needle_len, size_t *pos) {
+    uint8x16_t first = vdupq_n_u8(needle[0]);
+    uint8x16_t second = vdupq_n_u8(needle[1]);
+    size_t i = *pos;
+    for (; i + 16 + needle_len - 1 <= len; i += 16) {
+        uint8x16_t eq = vandq_u8(vceqq_u8(vld1q_u8(p + i), first), vceqq_u8(vld1q_u8(p + i + 1), second));
+        uint64_t mask = scan_neon_mask(eq);
+        while (mask) {
+            unsigned bit = scan_ctz64(mask);
+            size_t at = i + bit / 4;
+            if (scan_tail_matches(p + at, needle, needle_len))
+                return at;
+            mask &= ~((uint64_t)0xF << (bit & ~3u));
+        }
+    }
+    *pos = i;
+    return len;
+}
+#endif
+
+#if defined(FOSSIL_SCAN_AVX2_RUNTIME)
+/*
+ * The CPU is asked once, when the library loads; each scan only reads the
+ * answer. Scans run before that (from another constructor) take the SSE2
+ * path, which returns the same results.
+ */
+static bool scan_cpu_avx2 = false;
+
+__attribute__((constructor))
+static void scan_detect_cpu(void) {
+    __builtin_cpu_init();
+    scan_cpu_avx2 = __builtin_cpu_supports("avx2") != 0;
+}
+
+static bool scan_use_avx2(size_t len) {
+    return len >= SCAN_AVX2_MIN && scan_cpu_avx2;
+}
+#endif
+
+// ===========================================================
+// Public API
+// ===========================================================
+
+const char *fossil_bluecrab_scan_byte(const char *data, size_t len, char c) {
+    if (!data || len == 0)
+        return NULL;
+    const uint8_t *p = (const uint8_t *)data;
+    size_t i = 0, hit = len;
+#if defined(FOSSIL_SCAN_HAVE_AVX2) && !defined(FOSSIL_SCAN_AVX2_RUNTIME)
+    hit = scan_byte_avx2(p, len, (uint8_t)c, &i);
+#else
+#if defined(FOSSIL_SCAN_AVX2_RUNTIME)
+    if (scan_use_avx2(len))
+        hit = scan_byte_avx2(p, len, (uint8_t)c, &i);
+#endif
+#if defined(FOSSIL_SCAN_HAVE_SSE2)
+    if (hit == len)
+        hit = scan_byte_sse2(p, len, (uint8_t)c, &i);
+#elif defined(FOSSIL_SCAN_HAVE_NEON)
+    hit = scan_byte_neon(p, len, (uint8_t)c, &i);
+#endif
+#endif
+    if (hit < len)
+        return data + hit;
+    for (; i < len; ++i) {
+        if (p[i] == (uint8_t)c)
+            return data + i;
+    }
+    return NULL;
+}
+
+const char *fossil_bluecrab_scan_newline(const char *data, size_t len) {
+    return fossil_bluecrab_scan_byte(data, len, '\n');
+}
+
+const char *fossil_bluecrab_scan_find(const char *data, size_t len, const char *needle, size_t needle_len) {
+    if (needle_len == 0)
+        return data;
+    if (!data || !needle || needle_len > len)
+        return NULL;
+    if (needle_len == 1)
+        return fossil_bluecrab_scan_byte(data, len, needle[0]);
+
+    const uint8_t *p = (const uint8_t *)data;
+    const uint8_t *n = (const uint8_t *)needle;
+    size_t i = 0, hit = len;
+#if defined(FOSSIL_SCAN_HAVE_AVX2) && !defined(FOSSIL_SCAN_AVX2_RUNTIME)
+    hit = scan_pair_avx2(p, len, n, needle_len, &i);
+#else
+#if defined(FOSSIL_SCAN_AVX2_RUNTIME)
+    if (scan_use_avx2(len))
+        hit = scan_pair_avx2(p, len, n, needle_len, &i);
+#endif
+#if defined(FOSSIL_SCAN_HAVE_SSE2)
+    if (hit == len)
+        hit = scan_pair_sse2(p, len, n, needle_len, &i);
+#elif defined(FOSSIL_SCAN_HAVE_NEON)
+    hit = scan_pair_neon(p, len, n, needle_len, &i);
+#endif
+#endif
+    if (hit < len)
+        return data + hit;
+    for (; i + needle_len <= len; ++i) {
+        if (p[i] == n[0] && p[i + 1] == n[1] && scan_tail_matches(p + i, n, needle_len))
+            return data + i;
+    }
+    return NULL;
+}
+
+size_t fossil_bluecrab_scan_hex64(const char *text, size_t len, uint64_t *out) {
+    uint64_t value = 0;
+    if (!text) {
+        if (out) *out = 0;
+        return 0;
+    }
+#if defined(FOSSIL_SCAN_HAVE_SSE2)
+    if (len >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)text);
+        __m128i digit = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+        __m128i alpha = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        __m128i zero = _mm_setzero_si128();
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_subs_epu8(digit, _mm_set1_epi8(9)), zero);
+        __m128i is_alpha = _mm_cmpeq_epi8(_mm_subs_epu8(alpha, _mm_set1_epi8(5)), zero);
+        if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha)) == 0xFFFF) {
+            __m128i nibbles = _mm_or_si128(_mm_and_si128(is_digit, digit),
+                                           _mm_and_si128(is_alpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+            // Lane j holds digits 2j (low byte) and 2j+1; 2j is the high nibble
+            __m128i pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00FF)), 4),
+                                         _mm_srli_epi16(nibbles, 8));
+            uint8_t bytes[16];
+            _mm_storeu_si128((__m128i *)bytes, _mm_packus_epi16(pairs, pairs));
+            for (int k = 0; k < 8; ++k)
+                value = value << 8 | bytes[k];
+            if (out) *out = value;
+            return 16;
+        }
+    }
+#elif defined(FOSSIL_SCAN_HAVE_NEON)
+    if (len >= 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t *)text);
+        uint8x16_t digit = vsubq_u8(v, vdupq_n_u8('0'));
+        uint8x16_t alpha = vsubq_u8(vorrq_u8(v, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+        uint8x16_t is_digit = vcleq_u8(digit, vdupq_n_u8(9));
+        uint8x16_t is_alpha = vcleq_u8(alpha, vdupq_n_u8(5));
+        uint8x16_t valid = vorrq_u8(is_digit, is_alpha);
+        if (scan_neon_mask(valid) == UINT64_MAX) {
+            uint8x16_t nibbles = vbslq_u8(is_digit, digit, vaddq_u8(alpha, vdupq_n_u8(10)));
+            uint16x8_t lanes = vreinterpretq_u16_u8(nibbles);
+            uint16x8_t pairs = vorrq_u16(vshlq_n_u16(vandq_u16(lanes, vdupq_n_u16(0x00FF)), 4), vshrq_n_u16(lanes, 8));
+            uint8_t bytes[8];
+            vst1_u8(bytes, vmovn_u16(pairs));
+            for (int k = 0; k < 8; ++k)
+                value = value << 8 | bytes[k];
+            if (out) *out = value;
+            return 16;
+        }
+    }
+#endif
+    size_t n = 0;
+    for (; n < 16 && n < len; ++n) {
+        int d = scan_hex_digit((unsigned char)text[n]);
+        if (d < 0)
+            break;
+        value = value << 4 | (uint64_t)d;
+    }
+    if (out) *out = value;
+    return n;
+}
+
+const char *fossil_bluecrab_scan_backend(void) {
+#if defined(FOSSIL_SCAN_HAVE_AVX2) && !defined(FOSSIL_SCAN_AVX2_RUNTIME)
+    return "avx2";
+#else
+#if defined(FOSSIL_SCAN_AVX2_RUNTIME)
+    if (scan_use_avx2(SCAN_AVX2_MIN))
+        return "avx2";
+#endif
+#if defined(FOSSIL_SCAN_HAVE_SSE2)
+    return "sse2";
+#elif defined(FOSSIL_SCAN_HAVE_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+#endif
+}
@@ -0,0 +1,162 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#if !defined(_WIN32) && !defined(_WIN64) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include "fossil/crabdb/sync.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/** The policy: data plus size, not timestamps, wherever the platform can tell them apart. */
+#if !defined(_WIN32) && !defined(_WIN64)
+static int sync_fd(int fd) {
+#if defined(__linux__)
+    return fdatasync(fd);
+#else
+    return fsync(fd);
+#endif
+}
+#endif
+
+int fossil_bluecrab_sync_file(FILE *fp) {
+    if (fflush(fp) != 0)
+        return -1;
+#if defined(_WIN32) || defined(_WIN64)
+    return _commit(_fileno(fp));
+#else
+    return sync_fd(fileno(fp));
+#endif
+}
+
+void fossil_bluecrab_sync_path(const char *path) {
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE h = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h != INVALID_HANDLE_VALUE) {
+        FlushFileBuffers(h);
+        CloseHandle(h);
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        sync_fd(fd);
+        close(fd);
+    }
+#endif
+}
+
+int fossil_bluecrab_sync_parent_dir(const char *path) {
+#if defined(_WIN32) || defined(_WIN64)
+    (void)path;
+    return 0;
+#else
+    const char *slash = strrchr(path, '/');
+    size_t len = slash ? (size_t)(slash - path) : 1;
+    if (slash && len == 0) len = 1;
+    char *dir = (char *)malloc(len + 1);
+    if (!dir)
+        return -1;
+    if (slash) {
+        memcpy(dir, path, len);
+    } else {
+        dir[0] = '.';
+    }
+    dir[len] = '\0';
+    int fd = open(dir, O_RDONLY);
+    free(dir);
+    if (fd < 0)
+        return -1;
+    int rc = fsync(fd);  // directories have no data to separate from metadata
+    close(fd);
+    return rc == 0 ? 0 : -1;
+#endif
+}
+
+FOSSIL_THREAD_FN(sync_worker_main) {
+    fossil_bluecrab_sync_worker_t *w = (fossil_bluecrab_sync_worker_t *)arg;
+    fossil_bluecrab_thread_mutex_lock(&w->mutex);
+    while (!w->stop) {
+        fossil_bluecrab_thread_cond_timedwait(&w->cond, &w->mutex, w->interval_ms);
+        if (w->dirty) {
+            w->dirty = false;
+            fossil_bluecrab_thread_mutex_unlock(&w->mutex);
+            fossil_bluecrab_sync_path(w->path);
+            fossil_bluecrab_thread_mutex_lock(&w->mutex);
+        }
+    }
+    fossil_bluecrab_thread_mutex_unlock(&w->mutex);
+    FOSSIL_THREAD_RETURN;
+}
+
+fossil_bluecrab_sync_worker_t *fossil_bluecrab_sync_worker_start(const char *path, unsigned interval_ms) {
+    fossil_bluecrab_sync_worker_t *w = (fossil_bluecrab_sync_worker_t *)calloc(1, sizeof(*w));
+    size_t len = strlen(path);
+    if (w) w->path = (char *)malloc(len + 1);
+    if (!w || !w->path) {
+        free(w);
+        return NULL;
+    }
+    memcpy(w->path, path, len + 1);
+    w->interval_ms = interval_ms;
+    fossil_bluecrab_thread_mutex_init(&w->mutex);
+    fossil_bluecrab_thread_cond_init(&w->cond);
+    if (!fossil_bluecrab_thread_start(&w->thread, sync_worker_main, w)) {
+        fossil_bluecrab_thread_cond_destroy(&w->cond);
+        fossil_bluecrab_thread_mutex_destroy(&w->mutex);
+        free(w->path);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void fossil_bluecrab_sync_worker_mark(fossil_bluecrab_sync_worker_t *w) {
+    fossil_bluecrab_thread_mutex_lock(&w->mutex);
+    w->dirty = true;
+    fossil_bluecrab_thread_mutex_unlock(&w->mutex);
+}
+
+void fossil_bluecrab_sync_worker_stop(fossil_bluecrab_sync_worker_t *w) {
+    if (!w) return;
+    fossil_bluecrab_thread_mutex_lock(&w->mutex);
+    w->stop = true;
+    fossil_bluecrab_thread_cond_broadcast(&w->cond);
+    fossil_bluecrab_thread_mutex_unlock(&w->mutex);
+    fossil_bluecrab_thread_join(w->thread);
+    if (w->dirty)
+        fossil_bluecrab_sync_path(w->path);
+    fossil_bluecrab_thread_cond_destroy(&w->cond);
+    fossil_bluecrab_thread_mutex_destroy(&w->mutex);
+    free(w->path);
+    free(w);
+}
@@ -0,0 +1,278 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#if !defined(_WIN32) && !defined(_WIN64) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include "fossil/crabdb/thread.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32) || defined(_WIN64)
+
+void fossil_bluecrab_thread_mutex_init(fossil_bluecrab_thread_mutex_t *m)    { InitializeCriticalSection(m); }
+void fossil_bluecrab_thread_mutex_destroy(fossil_bluecrab_thread_mutex_t *m) { DeleteCriticalSection(m); }
+void fossil_bluecrab_thread_mutex_lock(fossil_bluecrab_thread_mutex_t *m)    { EnterCriticalSection(m); }
+void fossil_bluecrab_thread_mutex_unlock(fossil_bluecrab_thread_mutex_t *m)  { LeaveCriticalSection(m); }
+void fossil_bluecrab_thread_cond_init(fossil_bluecrab_thread_cond_t *c)      { InitializeConditionVariable(c); }
+void fossil_bluecrab_thread_cond_destroy(fossil_bluecrab_thread_cond_t *c)   { (void)c; }
+void fossil_bluecrab_thread_cond_broadcast(fossil_bluecrab_thread_cond_t *c) { WakeAllConditionVariable(c); }
+void fossil_bluecrab_thread_cond_signal(fossil_bluecrab_thread_cond_t *c)    { WakeConditionVariable(c); }
+
+void fossil_bluecrab_thread_cond_wait(fossil_bluecrab_thread_cond_t *c, fossil_bluecrab_thread_mutex_t *m) {
+    SleepConditionVariableCS(c, m, INFINITE);
+}
+
+void fossil_bluecrab_thread_cond_timedwait(fossil_bluecrab_thread_cond_t *c, fossil_bluecrab_thread_mutex_t *m, unsigned ms) {
+    SleepConditionVariableCS(c, m, ms);
+}
+
+bool fossil_bluecrab_thread_start(fossil_bluecrab_thread_t *t, fossil_bluecrab_thread_fn fn, void *arg) {
+    *t = CreateThread(NULL, 0, fn, arg, 0, NULL);
+    return *t != NULL;
+}
+
+void fossil_bluecrab_thread_join(fossil_bluecrab_thread_t t) {
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+}
+
+void fossil_bluecrab_thread_detach(fossil_bluecrab_thread_t t) {
+    CloseHandle(t);
+}
+
+fossil_bluecrab_thread_id_t fossil_bluecrab_thread_self(void) {
+    return GetCurrentThreadId();
+}
+
+bool fossil_bluecrab_thread_is_self(fossil_bluecrab_thread_id_t id) {
+    return id == GetCurrentThreadId();
+}
+
+size_t fossil_bluecrab_thread_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (size_t)info.dwNumberOfProcessors : 1;
+}
+
+size_t fossil_bluecrab_thread_fetch_inc(volatile size_t *counter) {
+#if defined(_WIN64)
+    return (size_t)InterlockedExchangeAdd64((volatile LONG64 *)counter, 1);
+#else
+    return (size_t)InterlockedExchangeAdd((volatile LONG *)counter, 1);
+#endif
+}
+
+#else
+
+void fossil_bluecrab_thread_mutex_init(fossil_bluecrab_thread_mutex_t *m)    { pthread_mutex_init(m, NULL); }
+void fossil_bluecrab_thread_mutex_destroy(fossil_bluecrab_thread_mutex_t *m) { pthread_mutex_destroy(m); }
+void fossil_bluecrab_thread_mutex_lock(fossil_bluecrab_thread_mutex_t *m)    { pthread_mutex_lock(m); }
+void fossil_bluecrab_thread_mutex_unlock(fossil_bluecrab_thread_mutex_t *m)  { pthread_mutex_unlock(m); }
+void fossil_bluecrab_thread_cond_init(fossil_bluecrab_thread_cond_t *c)      { pthread_cond_init(c, NULL); }
+void fossil_bluecrab_thread_cond_destroy(fossil_bluecrab_thread_cond_t *c)   { pthread_cond_destroy(c); }
+void fossil_bluecrab_thread_cond_broadcast(fossil_bluecrab_thread_cond_t *c) { pthread_cond_broadcast(c); }
+void fossil_bluecrab_thread_cond_signal(fossil_bluecrab_thread_cond_t *c)    { pthread_cond_signal(c); }
+
+void fossil_bluecrab_thread_cond_wait(fossil_bluecrab_thread_cond_t *c, fossil_bluecrab_thread_mutex_t *m) {
+    pthread_cond_wait(c, m);
+}
+
+void fossil_bluecrab_thread_cond_timedwait(fossil_bluecrab_thread_cond_t *c, fossil_bluecrab_thread_mutex_t *m, unsigned ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ms / 1000;
+    deadline.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(c, m, &deadline);
+}
+
+bool fossil_bluecrab_thread_start(fossil_bluecrab_thread_t *t, fossil_bluecrab_thread_fn fn, void *arg) {
+    return pthread_create(t, NULL, fn, arg) == 0;
+}
+
+void fossil_bluecrab_thread_join(fossil_bluecrab_thread_t t) {
+    pthread_join(t, NULL);
+}
+
+void fossil_bluecrab_thread_detach(fossil_bluecrab_thread_t t) {
+    pthread_detach(t);
+}
+
+fossil_bluecrab_thread_id_t fossil_bluecrab_thread_self(void) {
+    return pthread_self();
+}
+
+bool fossil_bluecrab_thread_is_self(fossil_bluecrab_thread_id_t id) {
+    return pthread_equal(id, pthread_self()) != 0;
+}
+
+size_t fossil_bluecrab_thread_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+}
+
+size_t fossil_bluecrab_thread_fetch_inc(volatile size_t *counter) {
+    return __atomic_fetch_add(counter, 1, __ATOMIC_SEQ_CST);
+}
+
+#endif
+
+// ===========================================================
+// Shared Worker Pool
+// ===========================================================
+
+typedef struct fossil_bluecrab_pool_task_t {
+    fossil_bluecrab_task_fn fn;
+    void *arg;
+    struct fossil_bluecrab_pool_task_t *next;
+} fossil_bluecrab_pool_task_t;
+
+static struct {
+    bool   initialized;
+    fossil_bluecrab_thread_mutex_t mutex;
+    fossil_bluecrab_thread_cond_t  cond;    // work queued, or a worker exited during quiesce
+    fossil_bluecrab_pool_task_t *head, *tail;
+    size_t queued;
+    size_t workers;
+    size_t idle;                            // workers waiting for work
+    size_t quiescing;                       // callers in fossil_bluecrab_pool_quiesce
+} fossil_bluecrab_pool;
+
+// Guards the pool's lazy initialisation
+#if defined(_WIN32) || defined(_WIN64)
+static SRWLOCK fossil_bluecrab_pool_init_lock = SRWLOCK_INIT;
+#define FOSSIL_POOL_INIT_LOCK()   AcquireSRWLockExclusive(&fossil_bluecrab_pool_init_lock)
+#define FOSSIL_POOL_INIT_UNLOCK() ReleaseSRWLockExclusive(&fossil_bluecrab_pool_init_lock)
+#else
+static pthread_mutex_t fossil_bluecrab_pool_init_lock = PTHREAD_MUTEX_INITIALIZER;
+#define FOSSIL_POOL_INIT_LOCK()   pthread_mutex_lock(&fossil_bluecrab_pool_init_lock)
+#define FOSSIL_POOL_INIT_UNLOCK() pthread_mutex_unlock(&fossil_bluecrab_pool_init_lock)
+#endif
+
+static void fossil_bluecrab_pool_init(void) {
+    FOSSIL_POOL_INIT_LOCK();
+    if (!fossil_bluecrab_pool.initialized) {
+        fossil_bluecrab_thread_mutex_init(&fossil_bluecrab_pool.mutex);
+        fossil_bluecrab_thread_cond_init(&fossil_bluecrab_pool.cond);
+        fossil_bluecrab_pool.initialized = true;
+    }
+    FOSSIL_POOL_INIT_UNLOCK();
+}
+
+FOSSIL_THREAD_FN(fossil_bluecrab_pool_worker) {
+    (void)arg;
+    fossil_bluecrab_thread_mutex_lock(&fossil_bluecrab_pool.mutex);
+    for (;;) {
+        fossil_bluecrab_pool_task_t *task = fossil_bluecrab_pool.head;
+        if (!task) {
+            if (fossil_bluecrab_pool.quiescing)
+                break;
+            fossil_bluecrab_pool.idle++;
+            fossil_bluecrab_thread_cond_timedwait(&fossil_bluecrab_pool.cond, &fossil_bluecrab_pool.mutex,
+                                                  FOSSIL_BLUECRAB_POOL_IDLE_MS);
+            fossil_bluecrab_pool.idle--;
+            // Woken without work: idle long enough, or another worker took it
+            if (!fossil_bluecrab_pool.head)
+                break;
+            continue;
+        }
+        fossil_bluecrab_pool.head = task->next;
+        if (!fossil_bluecrab_pool.head)
+            fossil_bluecrab_pool.tail = NULL;
+        fossil_bluecrab_pool.queued--;
+        fossil_bluecrab_thread_mutex_unlock(&fossil_bluecrab_pool.mutex);
+
+        task->fn(task->arg);
+        free(task);
+
+        fossil_bluecrab_thread_mutex_lock(&fossil_bluecrab_pool.mutex);
+    }
+    fossil_bluecrab_pool.workers--;
+    if (fossil_bluecrab_pool.quiescing)
+        fossil_bluecrab_thread_cond_broadcast(&fossil_bluecrab_pool.cond);
+    fossil_bluecrab_thread_mutex_unlock(&fossil_bluecrab_pool.mutex);
+    FOSSIL_THREAD_RETURN;
+}
+
+bool fossil_bluecrab_pool_submit(fossil_bluecrab_task_fn fn, void *arg) {
+    fossil_bluecrab_pool_task_t *task = (fossil_bluecrab_pool_task_t *)malloc(sizeof(*task));
+    if (!task)
+        return false;
+    task->fn = fn;
+    task->arg = arg;
+    task->next = NULL;
+    fossil_bluecrab_pool_init();
+
+    size_t cap = fossil_bluecrab_thread_cpu_count();
+    if (cap > FOSSIL_BLUECRAB_POOL_MAX)
+        cap = FOSSIL_BLUECRAB_POOL_MAX;
+
+    fossil_bluecrab_thread_mutex_lock(&fossil_bluecrab_pool.mutex);
+    if (fossil_bluecrab_pool.tail) fossil_bluecrab_pool.tail->next = task; else fossil_bluecrab_pool.head = task;
+    fossil_bluecrab_pool.tail = task;
+    fossil_bluecrab_pool.queued++;
+
+    // Start a worker unless an idle one can take the task
+    bool ok = true;
+    if (fossil_bluecrab_pool.queued > fossil_bluecrab_pool.idle && fossil_bluecrab_pool.workers < cap) {
+        fossil_bluecrab_thread_t thread;
+        if (fossil_bluecrab_thread_start(&thread, fossil_bluecrab_pool_worker, NULL)) {
+            fossil_bluecrab_thread_detach(thread);
+            fossil_bluecrab_pool.workers++;
+        } else if (fossil_bluecrab_pool.workers == 0) {
+            // Nobody would ever run it; only the task just queued can be waiting
+            fossil_bluecrab_pool.head = fossil_bluecrab_pool.tail = NULL;
+            fossil_bluecrab_pool.queued = 0;
+            free(task);
+            ok = false;
+        }
+    }
+    // A quiescing caller waits on the same condition; make sure a worker wakes
+    if (ok && fossil_bluecrab_pool.quiescing)
+        fossil_bluecrab_thread_cond_broadcast(&fossil_bluecrab_pool.cond);
+    else if (ok)
+        fossil_bluecrab_thread_cond_signal(&fossil_bluecrab_pool.cond);
+    fossil_bluecrab_thread_mutex_unlock(&fossil_bluecrab_pool.mutex);
+    return ok;
+}
+
+void fossil_bluecrab_pool_quiesce(void) {
+    fossil_bluecrab_pool_init();
+    fossil_bluecrab_thread_mutex_lock(&fossil_bluecrab_pool.mutex);
+    fossil_bluecrab_pool.quiescing++;
+    fossil_bluecrab_thread_cond_broadcast(&fossil_bluecrab_pool.cond);
+    while (fossil_bluecrab_pool.workers > 0)
+        fossil_bluecrab_thread_cond_wait(&fossil_bluecrab_pool.cond, &fossil_bluecrab_pool.mutex);
+    fossil_bluecrab_pool.quiescing--;
+    fossil_bluecrab_thread_mutex_unlock(&fossil_bluecrab_pool.mutex);
+}
@@ -0,0 +1,118 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include <fossil/pizza/framework.h>
+
+#include "fossil/crabdb/framework.h"
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Utilities
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// Setup steps for things like test fixtures and
+// mock objects are set here.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+FOSSIL_SUITE(c_hash_fixture);
+
+FOSSIL_SETUP(c_hash_fixture) {
+    // Setup the test fixture
+}
+
+FOSSIL_TEARDOWN(c_hash_fixture) {
+    // Teardown the test fixture
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Blue CrabDB Database
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+// Hash module tests
+
+FOSSIL_TEST(c_test_hash_legacy_matches_on_disk_values) {
+    // Values produced by the original myshell_hash64/noshell_hash64
+    ASSUME_ITS_TRUE(fossil_bluecrab_hash64_legacy("", 0) == 0x9bfae0a4e613fc3cULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_hash64_legacy("a", 1) == 0x081ccc83154666a7ULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_hash64_legacy("key", 3) == 0xc92ffb61d23bf5e5ULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_hash64_legacy("hello world", 11) == 0xf52edcf2f7ec4303ULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_hash64_legacy("0123456789abcdef!", 17) == 0xab00d4f74c836f6aULL);
+}
+
+FOSSIL_TEST(c_test_hash_vector_paths_match_reference) {
+    static uint8_t buf[4096 + 64];
+    for (size_t i = 0; i < sizeof(buf); ++i)
+        buf[i] = (uint8_t)(i * 131u + 7u);
+
+    // Cover short, stripe-tail and multi-block lengths plus unaligned starts
+    for (size_t len = 0; len <= 4096; len += (len < 300 ? 1 : 37)) {
+        for (size_t off = 0; off < 3; ++off) {
+            uint64_t seed = (uint64_t)len * 0x9E3779B97F4A7C15ULL;
+            ASSUME_ITS_TRUE(fossil_bluecrab_hash64(buf + off, len, seed) ==
+                            fossil_bluecrab_hash64_reference(buf + off, len, seed));
+        }
+    }
+    ASSUME_ITS_TRUE(fossil_bluecrab_hash_backend() != NULL);
+}
+
+FOSSIL_TEST(c_test_hash_fast_sensitivity) {
+    char a[600], b[600];
+    memset(a, 'x', sizeof(a));
+    memcpy(b, a, sizeof(b));
+    for (size_t len = 1; len <= sizeof(a); len += 41) {
+        b[len - 1] ^= 1;
+        ASSUME_ITS_TRUE(fossil_bluecrab_hash64(a, len, 0) != fossil_bluecrab_hash64(b, len, 0));
+        b[len - 1] ^= 1;
+        ASSUME_ITS_TRUE(fossil_bluecrab_hash64(a, len, 0) != fossil_bluecrab_hash64(a, len, 1));
+    }
+}
+
+FOSSIL_TEST(c_test_hash_batch_matches_single) {
+    char long_key[700];
+    memset(long_key, 'k', sizeof(long_key) - 1);
+    long_key[sizeof(long_key) - 1] = '\0';
+    const char *keys[] = { "", "a", "alpha", "a somewhat longer key of forty bytes....", long_key };
+    const size_t count = sizeof(keys) / sizeof(keys[0]);
+    uint64_t out[5], out_lens[5];
+    size_t lens[5];
+    for (size_t i = 0; i < count; ++i)
+        lens[i] = strlen(keys[i]);
+
+    fossil_bluecrab_hash64_batch(keys, NULL, count, 42, out);
+    fossil_bluecrab_hash64_batch(keys, lens, count, 42, out_lens);
+    for (size_t i = 0; i < count; ++i) {
+        ASSUME_ITS_TRUE(out[i] == fossil_bluecrab_hash64(keys[i], lens[i], 42));
+        ASSUME_ITS_TRUE(out_lens[i] == out[i]);
+    }
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Pool
+// * * * * * * * * * * * * * * * * * * * * * * * *
+FOSSIL_TEST_GROUP(c_hash_tests) {
+    FOSSIL_TEST_ADD(c_hash_fixture, c_test_hash_legacy_matches_on_disk_values);
+    FOSSIL_TEST_ADD(c_hash_fixture, c_test_hash_vector_paths_match_reference);
+    FOSSIL_TEST_ADD(c_hash_fixture, c_test_hash_fast_sensitivity);
+    FOSSIL_TEST_ADD(c_hash_fixture, c_test_hash_batch_matches_single);
+
+    FOSSIL_TEST_REGISTER(c_hash_fixture);
+} // end of tests
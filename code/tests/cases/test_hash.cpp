@@ -0,0 +1,80 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include <fossil/pizza/framework.h>
+
+#include "fossil/crabdb/framework.h"
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Utilities
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// Setup steps for things like test fixtures and
+// mock objects are set here.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+FOSSIL_SUITE(cpp_hash_fixture);
+
+FOSSIL_SETUP(cpp_hash_fixture) {
+    // Setup the test fixture
+}
+
+FOSSIL_TEARDOWN(cpp_hash_fixture) {
+    // Teardown the test fixture
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Blue CrabDB Database
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+using fossil::bluecrab::Hash;
+
+// Hash module tests
+
+FOSSIL_TEST(cpp_test_hash_wrappers) {
+    ASSUME_ITS_TRUE(Hash::legacy("hello world") == 0xf52edcf2f7ec4303ULL);
+
+    std::string big(5000, 'z');
+    ASSUME_ITS_TRUE(Hash::fast(big, 7) == fossil_bluecrab_hash64_reference(big.data(), big.size(), 7));
+    ASSUME_ITS_TRUE(!Hash::backend().empty());
+}
+
+FOSSIL_TEST(cpp_test_hash_batch) {
+    std::vector<std::string> keys = { "one", "two", std::string(1, '\0') + "embedded", std::string(300, 'q') };
+    auto hashes = Hash::batch(keys, 3);
+    ASSUME_ITS_TRUE(hashes.size() == keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        ASSUME_ITS_TRUE(hashes[i] == Hash::fast(keys[i], 3));
+    // Explicit lengths keep bytes past an embedded NUL
+    ASSUME_ITS_TRUE(hashes[2] != Hash::fast(std::string(), 3));
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Pool
+// * * * * * * * * * * * * * * * * * * * * * * * *
+FOSSIL_TEST_GROUP(cpp_hash_tests) {
+    FOSSIL_TEST_ADD(cpp_hash_fixture, cpp_test_hash_wrappers);
+    FOSSIL_TEST_ADD(cpp_hash_fixture, cpp_test_hash_batch);
+
+    FOSSIL_TEST_REGISTER(cpp_hash_fixture);
+} // end of tests
@@ -365,6 +365,926 @@ FOSSIL_TEST(c_test_myshell_check_integrity_null) {
     ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_INVALID_FILE);
 }
 
+FOSSIL_TEST(c_test_myshell_stage_commit) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *file_name = "test_stage_commit.myshell";
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+
+    // Stage many keys, restaging one of them, then drop another
+    for (int i = 0; i < 1000; ++i) {
+        char key[32];
+        snprintf(key, sizeof(key), "staged_%d", i);
+        err = fossil_myshell_stage(db, key, "i32", "1");
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    }
+    err = fossil_myshell_stage(db, "staged_0", "i32", "2");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_unstage(db, "staged_1");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    err = fossil_myshell_commit(db, "Staged commit");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    // The staging area is cleared once committed
+    err = fossil_myshell_unstage(db, "staged_2");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_NOT_FOUND);
+
+    fossil_myshell_close(db);
+
+    // Staged entries are persisted ahead of the commit line
+    FILE *fp = fopen(file_name, "r");
+    ASSUME_ITS_TRUE(fp != NULL);
+    char line[1024];
+    size_t staged = 0;
+    bool saw_restaged = false;
+    bool saw_commit = false;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "#stage ", 7) == 0) {
+            ASSUME_ITS_FALSE(saw_commit);
+            staged++;
+            if (strncmp(line, "#stage staged_0=2 ", 18) == 0) saw_restaged = true;
+        } else if (strncmp(line, "#commit ", 8) == 0) {
+            saw_commit = true;
+        }
+    }
+    fclose(fp);
+    ASSUME_ITS_TRUE(staged == 999);
+    ASSUME_ITS_TRUE(saw_restaged);
+    ASSUME_ITS_TRUE(saw_commit);
+
+    remove(file_name);
+}
+
+FOSSIL_TEST(c_test_myshell_txn_commit_rollback) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *file_name = "test_txn.myshell";
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+
+    err = fossil_myshell_put(db, "keep", "cstr", "old");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_put(db, "drop", "cstr", "gone");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    // No transaction active yet
+    err = fossil_myshell_txn_put(db, "a", "i32", "1");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_INVALID_QUERY);
+
+    err = fossil_myshell_txn_begin(db);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_txn_begin(db);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_CONCURRENCY);
+
+    err = fossil_myshell_txn_put(db, "keep", "cstr", "new");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_txn_put(db, "a", "i32", "1");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_txn_put(db, "b", "bogus", "1");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_INVALID_TYPE);
+    err = fossil_myshell_txn_del(db, "drop");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    // Reads see the pending writes
+    char value[64];
+    err = fossil_myshell_get(db, "keep", value, sizeof(value));
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("new", value);
+    err = fossil_myshell_get(db, "drop", value, sizeof(value));
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_NOT_FOUND);
+
+    err = fossil_myshell_txn_commit(db);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    err = fossil_myshell_get(db, "keep", value, sizeof(value));
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("new", value);
+    err = fossil_myshell_get(db, "a", value, sizeof(value));
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("1", value);
+    err = fossil_myshell_get(db, "drop", value, sizeof(value));
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_NOT_FOUND);
+
+    // Rolled back operations never reach the file
+    err = fossil_myshell_txn_begin(db);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_txn_del(db, "keep");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_txn_rollback(db);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_txn_commit(db);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_INVALID_QUERY);
+    err = fossil_myshell_get(db, "keep", value, sizeof(value));
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    err = fossil_myshell_check_integrity(db);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    fossil_myshell_close(db);
+    remove(file_name);
+}
+
+FOSSIL_TEST(c_test_myshell_cache_hits_invalidation) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *file_name = "test_cache.myshell";
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+
+    uint64_t hits = 0, misses = 0;
+    err = fossil_myshell_cache_stats(db, &hits, &misses);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_NOT_FOUND);
+
+    err = fossil_myshell_cache_enable(db, 4096);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_put(db, "hot", "cstr", "v1");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    char value[64];
+    for (int i = 0; i < 10; ++i) {
+        err = fossil_myshell_get(db, "hot", value, sizeof(value));
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+        ASSUME_ITS_EQUAL_CSTR("v1", value);
+    }
+    err = fossil_myshell_cache_stats(db, &hits, &misses);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(hits == 9);
+    ASSUME_ITS_TRUE(misses == 1);
+
+    // Writes invalidate the cached value
+    err = fossil_myshell_put(db, "hot", "cstr", "v2");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_get(db, "hot", value, sizeof(value));
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("v2", value);
+    err = fossil_myshell_del(db, "hot");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_get(db, "hot", value, sizeof(value));
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_NOT_FOUND);
+
+    // A tiny budget keeps evicting instead of growing
+    err = fossil_myshell_cache_enable(db, 200);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    for (int i = 0; i < 20; ++i) {
+        char key[32];
+        snprintf(key, sizeof(key), "k%d", i);
+        err = fossil_myshell_put(db, key, "i32", "1");
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+        err = fossil_myshell_get(db, key, value, sizeof(value));
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    }
+
+    err = fossil_myshell_cache_enable(db, 0);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_close(db);
+    remove(file_name);
+}
+
+typedef struct {
+    char messages[8][32];
+    size_t count;
+} c_myshell_log_collect_t;
+
+static bool c_myshell_log_collect(const char *commit_hash, const char *message, void *user) {
+    (void)commit_hash;
+    c_myshell_log_collect_t *out = (c_myshell_log_collect_t *)user;
+    if (out->count < 8) {
+        // Keep only the first word of "MESSAGE TIMESTAMP #type=enum"
+        sscanf(message, "%31s", out->messages[out->count]);
+    }
+    out->count++;
+    return true;
+}
+
+FOSSIL_TEST(c_test_myshell_log_range) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *file_name = "test_log_range.myshell";
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+
+    for (int i = 0; i < 30; ++i) {
+        char message[32];
+        snprintf(message, sizeof(message), "c%d", i);
+        err = fossil_myshell_commit(db, message);
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    }
+
+    // Newest first
+    c_myshell_log_collect_t out = {0};
+    err = fossil_myshell_log_range(db, NULL, 3, FOSSIL_MYSHELL_LOG_BACKWARD, c_myshell_log_collect, &out);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(out.count == 3);
+    ASSUME_ITS_EQUAL_CSTR("c29", out.messages[0]);
+    ASSUME_ITS_EQUAL_CSTR("c27", out.messages[2]);
+
+    // Commits appended after the index was built are picked up
+    err = fossil_myshell_commit(db, "c30");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    char head[17];
+    snprintf(head, sizeof(head), "%016" PRIx64, db->commit_head);
+    memset(&out, 0, sizeof(out));
+    err = fossil_myshell_log_range(db, head, 2, FOSSIL_MYSHELL_LOG_BACKWARD, c_myshell_log_collect, &out);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(out.count == 2);
+    ASSUME_ITS_EQUAL_CSTR("c30", out.messages[0]);
+    ASSUME_ITS_EQUAL_CSTR("c29", out.messages[1]);
+
+    // Forward from the oldest, unlimited
+    memset(&out, 0, sizeof(out));
+    err = fossil_myshell_log_range(db, NULL, 0, FOSSIL_MYSHELL_LOG_FORWARD, c_myshell_log_collect, &out);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(out.count == 31);
+    ASSUME_ITS_EQUAL_CSTR("c0", out.messages[0]);
+
+    err = fossil_myshell_log_range(db, "00000000deadbeef", 1, FOSSIL_MYSHELL_LOG_BACKWARD, c_myshell_log_collect, &out);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_NOT_FOUND);
+
+    fossil_myshell_close(db);
+    remove(file_name);
+}
+
+FOSSIL_TEST(c_test_myshell_log_range_after_rewrite) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *file_name = "test_log_rewrite.myshell";
+    const char *meta_name = "test_log_rewrite.myshell.meta";
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+
+    // Records interleaved with commits, so rewrites move the commit lines
+    for (int i = 0; i < 10; ++i) {
+        char key[16], message[32];
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(message, sizeof(message), "c%d", i);
+        err = fossil_myshell_put(db, key, "cstr", "some value");
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+        err = fossil_myshell_commit(db, message);
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    }
+
+    c_myshell_log_collect_t out = {0};
+    err = fossil_myshell_log_range(db, NULL, 2, FOSSIL_MYSHELL_LOG_BACKWARD, c_myshell_log_collect, &out);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("c9", out.messages[0]);
+
+    // Shrink and grow records ahead of the commits; the index follows
+    err = fossil_myshell_del(db, "k0");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_put(db, "k1", "cstr", "a much longer value than before");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(db->commit_index != NULL);
+    memset(&out, 0, sizeof(out));
+    err = fossil_myshell_log_range(db, NULL, 0, FOSSIL_MYSHELL_LOG_FORWARD, c_myshell_log_collect, &out);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(out.count == 10);
+    ASSUME_ITS_EQUAL_CSTR("c0", out.messages[0]);
+    ASSUME_ITS_EQUAL_CSTR("c7", out.messages[7]);
+    fossil_myshell_close(db);
+
+    // The sidecar carries the index into the next open
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(db->commit_index != NULL);
+    err = fossil_myshell_commit(db, "c10");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    memset(&out, 0, sizeof(out));
+    err = fossil_myshell_log_range(db, NULL, 3, FOSSIL_MYSHELL_LOG_BACKWARD, c_myshell_log_collect, &out);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(out.count == 3);
+    ASSUME_ITS_EQUAL_CSTR("c10", out.messages[0]);
+    ASSUME_ITS_EQUAL_CSTR("c9", out.messages[1]);
+    ASSUME_ITS_EQUAL_CSTR("c8", out.messages[2]);
+
+    fossil_myshell_close(db);
+    remove(file_name);
+    remove(meta_name);
+}
+
+FOSSIL_TEST(c_test_myshell_open_trusts_sidecar) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *file_name = "test_sidecar.myshell";
+    const char *meta_name = "test_sidecar.myshell.meta";
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    err = fossil_myshell_put(db, "a", "i32", "1");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_commit(db, "first");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_close(db);
+
+    FILE *fp = fopen(meta_name, "r");
+    ASSUME_ITS_TRUE(fp != NULL);
+    fclose(fp);
+
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(db->record_count == 3);
+    fossil_myshell_close(db);
+
+    // A valid line appended behind our back is validated and counted
+    fp = fopen(file_name, "ab");
+    ASSUME_ITS_TRUE(fp != NULL);
+    fputs("b=2 #type=i32\n", fp);
+    fclose(fp);
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(db->record_count == 4);
+    fossil_myshell_close(db);
+
+    // An invalid appended line is still rejected
+    fp = fopen(file_name, "ab");
+    ASSUME_ITS_TRUE(fp != NULL);
+    fputs("c=3 #type=bogus\n", fp);
+    fclose(fp);
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db == NULL);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_CONFIG_INVALID);
+
+    remove(file_name);
+    remove(meta_name);
+}
+
+FOSSIL_TEST(c_test_myshell_long_path_sidecar) {
+    // 299 characters: "<path>.meta" no longer fits a 300-byte buffer
+    char file_name[300] = {0}, meta_name[310];
+    while (strlen(file_name) < 299 - strlen("test_long.myshell"))
+        strcat(file_name, strlen(file_name) % 2 ? "/" : ".");
+    strcat(file_name, "test_long.myshell");
+    ASSUME_ITS_TRUE(strlen(file_name) == 299);
+    snprintf(meta_name, sizeof(meta_name), "%s.meta", file_name);
+
+    fossil_bluecrab_myshell_error_t err;
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "a", "i32", "1") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "b", "i32", "2") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_del(db, "b") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_close(db);
+
+    FILE *fp = fopen(meta_name, "r");
+    ASSUME_ITS_TRUE(fp != NULL);
+    if (fp) fclose(fp);
+
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    char value[32];
+    ASSUME_ITS_TRUE(fossil_myshell_get(db, "a", value, sizeof(value)) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("1", value);
+    fossil_myshell_close(db);
+
+    remove(file_name);
+    remove(meta_name);
+}
+
+FOSSIL_TEST(c_test_myshell_durability_modes) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *file_name = "test_durability.myshell";
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+
+    err = fossil_myshell_set_durability(db, FOSSIL_MYSHELL_DURABILITY_PERIODIC, 0);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_INVALID_QUERY);
+
+    // Every mode keeps the data readable through the handle
+    const fossil_bluecrab_myshell_durability_t modes[] = {
+        FOSSIL_MYSHELL_DURABILITY_NONE,
+        FOSSIL_MYSHELL_DURABILITY_FLUSH,
+        FOSSIL_MYSHELL_DURABILITY_FSYNC,
+        FOSSIL_MYSHELL_DURABILITY_PERIODIC
+    };
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+        err = fossil_myshell_set_durability(db, modes[i], 5);
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+        char key[16];
+        snprintf(key, sizeof(key), "k%zu", i);
+        err = fossil_myshell_put(db, key, "i32", "1");
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+        err = fossil_myshell_commit(db, key);
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+        char value[16];
+        err = fossil_myshell_get(db, key, value, sizeof(value));
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    }
+
+    // Closing a PERIODIC handle stops the worker after a final sync
+    fossil_myshell_close(db);
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    char value[16];
+    err = fossil_myshell_get(db, "k3", value, sizeof(value));
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_close(db);
+    remove(file_name);
+    remove("test_durability.myshell.meta");
+}
+
+typedef struct {
+    size_t ok;
+    size_t not_found;
+    char last_value[32];
+} c_myshell_async_tally_t;
+
+static void c_myshell_async_done(fossil_bluecrab_myshell_error_t err, const char *key, const char *value, void *user) {
+    (void)key;
+    c_myshell_async_tally_t *tally = (c_myshell_async_tally_t *)user;
+    if (err == FOSSIL_MYSHELL_ERROR_SUCCESS) {
+        tally->ok++;
+        snprintf(tally->last_value, sizeof(tally->last_value), "%s", value);
+    } else if (err == FOSSIL_MYSHELL_ERROR_NOT_FOUND) {
+        tally->not_found++;
+    }
+}
+
+FOSSIL_TEST(c_test_myshell_async_submit) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *file_name = "test_async.myshell";
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+
+    c_myshell_async_tally_t tally = {0};
+    for (int i = 0; i < 16; ++i) {
+        char key[16], value[16];
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(value, sizeof(value), "%d", i);
+        err = fossil_myshell_submit_put(db, key, "i32", value, c_myshell_async_done, &tally);
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    }
+    // A get sees every put submitted before it
+    err = fossil_myshell_submit_get(db, "k15", c_myshell_async_done, &tally);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_submit_get(db, "missing", c_myshell_async_done, &tally);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = fossil_myshell_submit_put(db, "bad", "bogus", "1", c_myshell_async_done, &tally);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_INVALID_TYPE);
+
+    size_t dispatched = fossil_myshell_async_wait(db);
+    dispatched += fossil_myshell_async_poll(db);
+    ASSUME_ITS_TRUE(dispatched == 18);
+    ASSUME_ITS_TRUE(tally.ok == 17);
+    ASSUME_ITS_TRUE(tally.not_found == 1);
+    ASSUME_ITS_EQUAL_CSTR("15", tally.last_value);
+
+    // Gets run side by side, and synchronous calls may interleave with them
+    ASSUME_ITS_TRUE(fossil_myshell_cache_enable(db, 4096) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    memset(&tally, 0, sizeof(tally));
+    for (int i = 0; i < 64; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%d", i % 16);
+        err = fossil_myshell_submit_get(db, key, c_myshell_async_done, &tally);
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+        if (i == 32) {
+            ASSUME_ITS_TRUE(fossil_myshell_put(db, "sync", "i32", "99") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+        }
+    }
+    char value[16];
+    ASSUME_ITS_TRUE(fossil_myshell_get(db, "k3", value, sizeof(value)) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("3", value);
+    ASSUME_ITS_TRUE(fossil_myshell_async_wait(db) == 64);
+    ASSUME_ITS_TRUE(tally.ok == 64);
+    ASSUME_ITS_TRUE(fossil_myshell_get(db, "sync", value, sizeof(value)) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    fossil_myshell_close(db);
+    remove(file_name);
+    remove("test_async.myshell.meta");
+}
+
+typedef struct {
+    size_t rows;
+    char keys[256];
+    bool saw_type;
+} c_myshell_query_rows_t;
+
+static bool c_myshell_query_collect(const char *key, const char *type, const char *value, void *user) {
+    c_myshell_query_rows_t *rows = (c_myshell_query_rows_t *)user;
+    (void)value;
+    rows->rows++;
+    if (type) rows->saw_type = true;
+    if (key) {
+        strncat(rows->keys, key, sizeof(rows->keys) - strlen(rows->keys) - 2);
+        strcat(rows->keys, ",");
+    }
+    return true;
+}
+
+FOSSIL_TEST(c_test_myshell_query) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *file_name = "test_query.myshell";
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "a", "i32", "50") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "b", "i32", "150") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "c", "i32", "250") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "name", "cstr", "crab") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "nick", "cstr", "it's") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    c_myshell_query_rows_t rows = {0};
+    err = fossil_myshell_query(db, "SELECT key, value WHERE type = 'i32' AND value > 100", c_myshell_query_collect, &rows);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("b,c,", rows.keys);
+    ASSUME_ITS_FALSE(rows.saw_type);
+
+    memset(&rows, 0, sizeof(rows));
+    err = fossil_myshell_query(db, "select * where value > 100 or key like 'n%' limit 2", c_myshell_query_collect, &rows);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("b,c,", rows.keys);
+    ASSUME_ITS_TRUE(rows.saw_type);
+
+    memset(&rows, 0, sizeof(rows));
+    err = fossil_myshell_query(db, "SELECT key WHERE NOT (type = i32) AND value = 'it''s';", c_myshell_query_collect, &rows);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("nick,", rows.keys);
+
+    memset(&rows, 0, sizeof(rows));
+    err = fossil_myshell_query(db, "SELECT key FROM kv WHERE key = 'a' AND value <= 50", c_myshell_query_collect, &rows);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("a,", rows.keys);
+
+    // A number compares numerically, so it can match several keys
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "1", "cstr", "one") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "01", "cstr", "uno") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    memset(&rows, 0, sizeof(rows));
+    err = fossil_myshell_query(db, "SELECT key WHERE key = 1.0", c_myshell_query_collect, &rows);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("1,01,", rows.keys);
+    memset(&rows, 0, sizeof(rows));
+    err = fossil_myshell_query(db, "SELECT key WHERE key = '1'", c_myshell_query_collect, &rows);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("1,", rows.keys);
+
+    memset(&rows, 0, sizeof(rows));
+    err = fossil_myshell_query(db, "SELECT key LIMIT 0", c_myshell_query_collect, &rows);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(rows.rows == 0);
+
+    ASSUME_ITS_TRUE(fossil_myshell_query(db, "SELECT", c_myshell_query_collect, &rows) == FOSSIL_MYSHELL_ERROR_INVALID_QUERY);
+    ASSUME_ITS_TRUE(fossil_myshell_query(db, "SELECT key WHERE value >", c_myshell_query_collect, &rows) == FOSSIL_MYSHELL_ERROR_INVALID_QUERY);
+    ASSUME_ITS_TRUE(fossil_myshell_query(db, "SELECT key WHERE (key = 'a'", c_myshell_query_collect, &rows) == FOSSIL_MYSHELL_ERROR_INVALID_QUERY);
+    ASSUME_ITS_TRUE(fossil_myshell_query(db, "SELECT key LIMIT -1", c_myshell_query_collect, &rows) == FOSSIL_MYSHELL_ERROR_INVALID_QUERY);
+    ASSUME_ITS_TRUE(fossil_myshell_query(db, "SELECT key WHERE key = 'x' junk", c_myshell_query_collect, &rows) == FOSSIL_MYSHELL_ERROR_INVALID_QUERY);
+
+    fossil_myshell_close(db);
+    remove(file_name);
+    remove("test_query.myshell.meta");
+}
+
+typedef struct {
+    size_t rows;
+    char keys[256];
+} c_myshell_index_rows_t;
+
+static bool c_myshell_index_collect(const char *key, const char *type, const char *value, void *user) {
+    c_myshell_index_rows_t *rows = (c_myshell_index_rows_t *)user;
+    (void)type;
+    (void)value;
+    rows->rows++;
+    strncat(rows->keys, key, sizeof(rows->keys) - strlen(rows->keys) - 2);
+    strcat(rows->keys, ",");
+    return true;
+}
+
+FOSSIL_TEST(c_test_myshell_secondary_index) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *file_name = "test_index.myshell";
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "s1", "object", "{ user: cstr: \"alice\", ttl: i32: 30 }") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "s2", "object", "{ user: cstr: \"bob\", ttl: i32: 5 }") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "s3", "object", "{ user: cstr: \"alice\", ttl: i32: 120 }") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "n1", "i32", "100") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "n2", "i32", "9") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "by_user", "object", fossil_myshell_index_fson_field, "user") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "nums", "i32", NULL, NULL) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "nums", NULL, NULL, NULL) == FOSSIL_MYSHELL_ERROR_ALREADY_EXISTS);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "bad name", NULL, NULL, NULL) == FOSSIL_MYSHELL_ERROR_INVALID_QUERY);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "t", "nosuchtype", NULL, NULL) == FOSSIL_MYSHELL_ERROR_INVALID_TYPE);
+
+    c_myshell_index_rows_t rows = {0};
+    ASSUME_ITS_TRUE(fossil_myshell_index_lookup(db, "by_user", "alice", c_myshell_index_collect, &rows) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("s1,s3,", rows.keys);
+
+    // Numeric order: 9 < 100 even though "100" < "9" as text
+    memset(&rows, 0, sizeof(rows));
+    ASSUME_ITS_TRUE(fossil_myshell_index_range(db, "nums", "5", NULL, c_myshell_index_collect, &rows) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("n2,n1,", rows.keys);
+
+    // Writes keep the index consistent
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "s1", "object", "{ user: cstr: \"bob\", ttl: i32: 30 }") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_del(db, "s3") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_txn_begin(db) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_txn_put(db, "s4", "object", "{ user: cstr: \"alice\" }") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_txn_commit(db) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    memset(&rows, 0, sizeof(rows));
+    fossil_myshell_index_lookup(db, "by_user", "alice", c_myshell_index_collect, &rows);
+    ASSUME_ITS_EQUAL_CSTR("s4,", rows.keys);
+    memset(&rows, 0, sizeof(rows));
+    fossil_myshell_index_lookup(db, "by_user", "bob", c_myshell_index_collect, &rows);
+    ASSUME_ITS_EQUAL_CSTR("s1,s2,", rows.keys);
+    fossil_myshell_close(db);
+
+    // Reopen: the saved index is reused; a drop removes it
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    FILE *idx_file = fopen("test_index.myshell.by_user.idx", "rb");
+    ASSUME_ITS_TRUE(idx_file != NULL);
+    if (idx_file) fclose(idx_file);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "by_user", "object", fossil_myshell_index_fson_field, "user") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    memset(&rows, 0, sizeof(rows));
+    fossil_myshell_index_lookup(db, "by_user", "bob", c_myshell_index_collect, &rows);
+    ASSUME_ITS_EQUAL_CSTR("s1,s2,", rows.keys);
+    ASSUME_ITS_TRUE(fossil_myshell_drop_index(db, "by_user") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_index_lookup(db, "by_user", "bob", c_myshell_index_collect, &rows) == FOSSIL_MYSHELL_ERROR_NOT_FOUND);
+    idx_file = fopen("test_index.myshell.by_user.idx", "rb");
+    ASSUME_ITS_TRUE(idx_file == NULL);
+
+    // A write made while the "nums" index was not loaded forces a rebuild
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "n3", "i32", "50") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_close(db);
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "nums", "i32", NULL, NULL) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    memset(&rows, 0, sizeof(rows));
+    fossil_myshell_index_range(db, "nums", "10", "100", c_myshell_index_collect, &rows);
+    ASSUME_ITS_EQUAL_CSTR("n3,n1,", rows.keys);
+
+    fossil_myshell_close(db);
+    remove(file_name);
+    remove("test_index.myshell.meta");
+    remove("test_index.myshell.nums.idx");
+}
+
+FOSSIL_TEST(c_test_myshell_index_long_path) {
+    // 511 characters: "<path>.nums.idx" no longer fits a 512-byte buffer
+    char file_name[512] = {0}, idx_name[530], meta_name[530];
+    while (strlen(file_name) < 511 - strlen("test_index_long.myshell"))
+        strcat(file_name, strlen(file_name) % 2 ? "/" : ".");
+    strcat(file_name, "test_index_long.myshell");
+    ASSUME_ITS_TRUE(strlen(file_name) == 511);
+    snprintf(idx_name, sizeof(idx_name), "%s.nums.idx", file_name);
+    snprintf(meta_name, sizeof(meta_name), "%s.meta", file_name);
+
+    fossil_bluecrab_myshell_error_t err;
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "n1", "i32", "100") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "n2", "i32", "9") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "nums", "i32", NULL, NULL) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_close(db);
+
+    FILE *fp = fopen(idx_name, "rb");
+    ASSUME_ITS_TRUE(fp != NULL);
+    if (fp) fclose(fp);
+
+    // The saved index is reused and the records survived
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "nums", "i32", NULL, NULL) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    c_myshell_index_rows_t rows = {0};
+    ASSUME_ITS_TRUE(fossil_myshell_index_range(db, "nums", "5", NULL, c_myshell_index_collect, &rows) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("n2,n1,", rows.keys);
+    char value[32];
+    ASSUME_ITS_TRUE(fossil_myshell_get(db, "n1", value, sizeof(value)) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("100", value);
+    ASSUME_ITS_TRUE(fossil_myshell_drop_index(db, "nums") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fp = fopen(idx_name, "rb");
+    ASSUME_ITS_TRUE(fp == NULL);
+    if (fp) fclose(fp);
+    fossil_myshell_close(db);
+
+    remove(file_name);
+    remove(meta_name);
+}
+
+// Indexes every record under the string passed as user
+static bool c_myshell_index_constant(const char *key, const char *type, const char *value, char *out, size_t out_size, void *user) {
+    (void)key;
+    (void)type;
+    (void)value;
+    snprintf(out, out_size, "%s", (const char *)user);
+    return true;
+}
+
+FOSSIL_TEST(c_test_myshell_index_extractor_change) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *file_name = "test_index_extractor.myshell";
+    const char *idx_name = "test_index_extractor.myshell.by.idx";
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, "s1", "object", "{ user: cstr: \"alice\", ttl: i32: 30 }") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "by", "object", fossil_myshell_index_fson_field, "user") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_close(db);
+
+    // Another field rebuilds instead of serving the saved "user" values
+    c_myshell_index_rows_t rows = {0};
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "by", "object", fossil_myshell_index_fson_field, "ttl") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_index_lookup(db, "by", "30", c_myshell_index_collect, &rows);
+    ASSUME_ITS_EQUAL_CSTR("s1,", rows.keys);
+    fossil_myshell_close(db);
+
+    // So does the whole value
+    memset(&rows, 0, sizeof(rows));
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "by", "object", NULL, NULL) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_index_lookup(db, "by", "30", c_myshell_index_collect, &rows);
+    ASSUME_ITS_TRUE(rows.rows == 0);
+    fossil_myshell_close(db);
+
+    // A custom extractor loads only under the tag it was saved with
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index_versioned(db, "by", NULL, c_myshell_index_constant, "x", "v1") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_close(db);
+    memset(&rows, 0, sizeof(rows));
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index_versioned(db, "by", NULL, c_myshell_index_constant, "y", "v2") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_index_lookup(db, "by", "y", c_myshell_index_collect, &rows);
+    ASSUME_ITS_EQUAL_CSTR("s1,", rows.keys);
+    fossil_myshell_close(db);
+
+    // ...and without a tag is neither loaded nor saved
+    memset(&rows, 0, sizeof(rows));
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "by", NULL, c_myshell_index_constant, "z") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_index_lookup(db, "by", "z", c_myshell_index_collect, &rows);
+    ASSUME_ITS_EQUAL_CSTR("s1,", rows.keys);
+    fossil_myshell_close(db);
+    FILE *idx_file = fopen(idx_name, "rb");
+    ASSUME_ITS_TRUE(idx_file == NULL);
+    if (idx_file) fclose(idx_file);
+
+    remove(file_name);
+    remove("test_index_extractor.myshell.meta");
+    remove(idx_name);
+}
+
+FOSSIL_TEST(c_test_myshell_aggregate) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *file_name = "test_aggregate.myshell";
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+
+    // Enough values to fill more than one batch
+    ASSUME_ITS_TRUE(fossil_myshell_txn_begin(db) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    for (int i = 1; i <= 2500; ++i) {
+        char key[32], value[32];
+        snprintf(key, sizeof(key), "hits.%d", i);
+        snprintf(value, sizeof(value), "%d", i % 2 ? i : -i);
+        ASSUME_ITS_TRUE(fossil_myshell_txn_put(db, key, "i64", value) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    }
+    ASSUME_ITS_TRUE(fossil_myshell_txn_put(db, "other", "i64", "1000000") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_txn_put(db, "big.a", "u64", "18446744073709551615") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_txn_put(db, "big.b", "u64", "1") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_txn_put(db, "temp.a", "f64", "1.5") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_txn_put(db, "temp.b", "f64", "-2.25") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_txn_put(db, "temp.c", "f64", "4") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_txn_commit(db) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    fossil_myshell_agg_result_t r;
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, "hits.", "i64", FOSSIL_MYSHELL_AGG_COUNT, &r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.count == 2500 && r.u64 == 2500);
+    // Odd values are positive, even values negative: sum = -1250
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, "hits.", "i64", FOSSIL_MYSHELL_AGG_SUM, &r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.i64 == -1250);
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, "hits.", "i64", FOSSIL_MYSHELL_AGG_MIN, &r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.i64 == -2500);
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, "hits.", "i64", FOSSIL_MYSHELL_AGG_MAX, &r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.i64 == 2499);
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, NULL, "i64", FOSSIL_MYSHELL_AGG_MAX, &r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.i64 == 1000000);
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, "hits.", "i64", FOSSIL_MYSHELL_AGG_AVG, &r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.f64 == -0.5);
+
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, "big.", "u64", FOSSIL_MYSHELL_AGG_MAX, &r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.u64 == UINT64_MAX);
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, "big.", "u64", FOSSIL_MYSHELL_AGG_MIN, &r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.u64 == 1);
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, "big.", "u64", FOSSIL_MYSHELL_AGG_SUM, &r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.u64 == 0);  // wraps
+
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, "temp.", "f64", FOSSIL_MYSHELL_AGG_SUM, &r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.f64 == 3.25);
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, "temp.", "f64", FOSSIL_MYSHELL_AGG_MIN, &r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.f64 == -2.25);
+
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, "none.", "f64", FOSSIL_MYSHELL_AGG_MAX, &r) == FOSSIL_MYSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, "none.", "f64", FOSSIL_MYSHELL_AGG_COUNT, &r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.count == 0);
+    ASSUME_ITS_TRUE(fossil_myshell_aggregate(db, NULL, "cstr", FOSSIL_MYSHELL_AGG_SUM, &r) == FOSSIL_MYSHELL_ERROR_INVALID_TYPE);
+
+    fossil_myshell_close(db);
+    remove(file_name);
+    remove("test_aggregate.myshell.meta");
+}
+
+static bool c_myshell_count_rows(const char *key, const char *type, const char *value, void *user) {
+    (void)key; (void)type; (void)value;
+    (*(size_t *)user)++;
+    return true;
+}
+
+static void c_myshell_remove_sharded(const char *dir, size_t nshards) {
+    char path[128];
+    for (size_t i = 0; i < nshards; ++i) {
+        snprintf(path, sizeof(path), "%s/shard-%04zu.myshell", dir, i);
+        remove(path);
+        snprintf(path, sizeof(path), "%s/shard-%04zu.myshell.meta", dir, i);
+        remove(path);
+    }
+    snprintf(path, sizeof(path), "%s/shards.manifest", dir);
+    remove(path);
+    remove(dir);
+}
+
+FOSSIL_TEST(c_test_myshell_sharded) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *dir = "test_sharded_c.d";
+    fossil_bluecrab_myshell_sharded_t *db = fossil_myshell_open_sharded(dir, 4, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(db->nshards == 4);
+
+    size_t per_shard[4] = {0};
+    for (int i = 0; i < 200; ++i) {
+        char key[32], value[32];
+        snprintf(key, sizeof(key), "user.%d", i);
+        snprintf(value, sizeof(value), "%d", i % 10);
+        ASSUME_ITS_TRUE(fossil_myshell_sharded_put(db, key, "i32", value) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+        per_shard[fossil_myshell_sharded_shard_of(db, key)]++;
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        ASSUME_ITS_TRUE(per_shard[i] > 0);
+    }
+
+    char out[64];
+    ASSUME_ITS_TRUE(fossil_myshell_sharded_get(db, "user.42", out, sizeof(out)) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(out, "2") == 0);
+    ASSUME_ITS_TRUE(fossil_myshell_sharded_del(db, "user.42") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_sharded_get(db, "user.42", out, sizeof(out)) == FOSSIL_MYSHELL_ERROR_NOT_FOUND);
+
+    size_t rows = 0;
+    ASSUME_ITS_TRUE(fossil_myshell_sharded_query(db, "SELECT key WHERE value = '3'", c_myshell_count_rows, &rows) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(rows == 20);
+    rows = 0;
+    ASSUME_ITS_TRUE(fossil_myshell_sharded_query(db, "SELECT * LIMIT 7", c_myshell_count_rows, &rows) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(rows == 7);
+    rows = 0;
+    ASSUME_ITS_TRUE(fossil_myshell_sharded_query(db, "SELECT value WHERE key = 'user.7'", c_myshell_count_rows, &rows) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(rows == 1);
+    // A numeric key literal is not routed by its spelling
+    ASSUME_ITS_TRUE(fossil_myshell_sharded_put(db, "7", "i32", "7") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_sharded_shard_of(db, "7") != fossil_myshell_sharded_shard_of(db, "7.0"));
+    rows = 0;
+    ASSUME_ITS_TRUE(fossil_myshell_sharded_query(db, "SELECT value WHERE key = 7.0", c_myshell_count_rows, &rows) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(rows == 1);
+    ASSUME_ITS_TRUE(fossil_myshell_sharded_query(db, "SELEC", c_myshell_count_rows, &rows) == FOSSIL_MYSHELL_ERROR_INVALID_QUERY);
+    ASSUME_ITS_TRUE(fossil_myshell_sharded_check_integrity(db) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_close_sharded(db);
+
+    // The recorded shard count wins; a different count is refused
+    db = fossil_myshell_open_sharded(dir, 0, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(db->nshards == 4);
+    ASSUME_ITS_TRUE(fossil_myshell_sharded_get(db, "user.199", out, sizeof(out)) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(out, "9") == 0);
+    fossil_myshell_close_sharded(db);
+    ASSUME_ITS_TRUE(fossil_myshell_open_sharded(dir, 8, &err) == NULL);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SCHEMA_MISMATCH);
+
+    c_myshell_remove_sharded(dir, 4);
+}
+
+FOSSIL_TEST(c_test_myshell_index_reload_whitespace) {
+    fossil_bluecrab_myshell_error_t err;
+    const char *file_name = "test_index_ws.myshell";
+    fossil_bluecrab_myshell_t *db = fossil_myshell_create(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+
+    // Values and keys starting with blanks survive the saved index file
+    ASSUME_ITS_TRUE(fossil_myshell_put(db, " k1", "cstr", " hello") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "words", "cstr", NULL, NULL) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    fossil_myshell_close(db);
+
+    db = fossil_myshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_myshell_create_index(db, "words", "cstr", NULL, NULL) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    c_myshell_index_rows_t rows = {0};
+    ASSUME_ITS_TRUE(fossil_myshell_index_lookup(db, "words", " hello", c_myshell_index_collect, &rows) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR(" k1,", rows.keys);
+    memset(&rows, 0, sizeof(rows));
+    ASSUME_ITS_TRUE(fossil_myshell_index_range(db, "words", " ", " z", c_myshell_index_collect, &rows) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR(" k1,", rows.keys);
+
+    fossil_myshell_close(db);
+    remove(file_name);
+    remove("test_index_ws.myshell.meta");
+    remove("test_index_ws.myshell.words.idx");
+}
+
 // * * * * * * * * * * * * * * * * * * * * * * * *
 // * Fossil Logic Test Pool
 // * * * * * * * * * * * * * * * * * * * * * * * *
@@ -386,6 +1306,22 @@ FOSSIL_TEST_GROUP(c_myshell_database_tests) {
     FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_backup_restore_null_args);
     FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_diff_null_args);
     FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_check_integrity_null);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_stage_commit);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_txn_commit_rollback);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_cache_hits_invalidation);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_log_range);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_log_range_after_rewrite);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_open_trusts_sidecar);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_long_path_sidecar);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_durability_modes);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_async_submit);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_query);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_secondary_index);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_index_long_path);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_index_extractor_change);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_aggregate);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_sharded);
+    FOSSIL_TEST_ADD(c_myshell_fixture, c_test_myshell_index_reload_whitespace);
 
     FOSSIL_TEST_REGISTER(c_myshell_fixture);
 } // end of tests
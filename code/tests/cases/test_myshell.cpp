@@ -25,6 +25,9 @@
 #include <fossil/pizza/framework.h>
 
 #include "fossil/crabdb/framework.h"
+#include <atomic>
+#include <thread>
+#include <vector>
 
 // * * * * * * * * * * * * * * * * * * * * * * * *
 // * Fossil Logic Test Utilities
@@ -366,6 +369,307 @@ FOSSIL_TEST(cpp_test_myshell_check_integrity_null) {
     ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_INVALID_FILE);
 }
 
+FOSSIL_TEST(cpp_test_myshell_stage_commit) {
+    fossil_bluecrab_myshell_error_t err;
+    const std::string file_name = "test_stage_commit.myshell";
+    auto db = fossil::bluecrab::MyShell::create(file_name, err);
+    ASSUME_ITS_TRUE(db.is_open());
+
+    for (int i = 0; i < 1000; ++i) {
+        err = db.stage("staged_" + std::to_string(i), "i32", "1");
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    }
+    err = db.unstage("staged_1");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    err = db.commit("Staged commit");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    // The staging area is cleared once committed
+    err = db.unstage("staged_2");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_NOT_FOUND);
+
+    db.close();
+    remove(file_name.c_str());
+}
+
+FOSSIL_TEST(cpp_test_myshell_txn_commit_rollback) {
+    fossil_bluecrab_myshell_error_t err;
+    const std::string file_name = "test_txn.myshell";
+    auto db = fossil::bluecrab::MyShell::create(file_name, err);
+    ASSUME_ITS_TRUE(db.is_open());
+
+    err = db.put("keep", "cstr", "old");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    err = db.txn_begin();
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = db.txn_put("keep", "cstr", "new");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = db.txn_put("added", "i32", "7");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = db.txn_commit();
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    std::string value;
+    err = db.get("keep", value);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(value == "new");
+
+    err = db.txn_begin();
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = db.txn_del("added");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = db.txn_rollback();
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    err = db.get("added", value);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(value == "7");
+
+    db.close();
+    remove(file_name.c_str());
+}
+
+FOSSIL_TEST(cpp_test_myshell_cache_hits_invalidation) {
+    fossil_bluecrab_myshell_error_t err;
+    const std::string file_name = "test_cache.myshell";
+    auto db = fossil::bluecrab::MyShell::create(file_name, err);
+    ASSUME_ITS_TRUE(db.is_open());
+
+    err = db.cache_enable(4096);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = db.put("hot", "cstr", "v1");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    std::string value;
+    err = db.get("hot", value);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = db.get("hot", value);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(value == "v1");
+
+    uint64_t hits = 0, misses = 0;
+    err = db.cache_stats(hits, misses);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(hits == 1);
+    ASSUME_ITS_TRUE(misses == 1);
+
+    err = db.put("hot", "cstr", "v2");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = db.get("hot", value);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(value == "v2");
+
+    db.close();
+    remove(file_name.c_str());
+}
+
+static bool cpp_myshell_log_count(const char *, const char *, void *user) {
+    ++*static_cast<size_t *>(user);
+    return true;
+}
+
+FOSSIL_TEST(cpp_test_myshell_log_range) {
+    fossil_bluecrab_myshell_error_t err;
+    const std::string file_name = "test_log_range.myshell";
+    auto db = fossil::bluecrab::MyShell::create(file_name, err);
+    ASSUME_ITS_TRUE(db.is_open());
+
+    for (int i = 0; i < 10; ++i) {
+        err = db.commit("c" + std::to_string(i));
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    }
+
+    size_t count = 0;
+    err = db.log_range("", 4, FOSSIL_MYSHELL_LOG_BACKWARD, cpp_myshell_log_count, &count);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 4);
+
+    db.close();
+    remove(file_name.c_str());
+}
+
+FOSSIL_TEST(cpp_test_myshell_open_trusts_sidecar) {
+    fossil_bluecrab_myshell_error_t err;
+    const std::string file_name = "test_sidecar.myshell";
+    {
+        auto db = fossil::bluecrab::MyShell::create(file_name, err);
+        ASSUME_ITS_TRUE(db.is_open());
+        err = db.put("a", "i32", "1");
+        ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    }
+
+    fossil::bluecrab::MyShell db(file_name, err);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    std::string value;
+    err = db.get("a", value);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(value == "1");
+    db.close();
+
+    remove(file_name.c_str());
+    remove((file_name + ".meta").c_str());
+}
+
+FOSSIL_TEST(cpp_test_myshell_durability_modes) {
+    fossil_bluecrab_myshell_error_t err;
+    const std::string file_name = "test_durability.myshell";
+    auto db = fossil::bluecrab::MyShell::create(file_name, err);
+    ASSUME_ITS_TRUE(db.is_open());
+
+    err = db.set_durability(FOSSIL_MYSHELL_DURABILITY_FSYNC);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = db.put("a", "i32", "1");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = db.set_durability(FOSSIL_MYSHELL_DURABILITY_PERIODIC, 5);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = db.commit("periodic");
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    db.close();
+    remove(file_name.c_str());
+    remove((file_name + ".meta").c_str());
+}
+
+static void cpp_myshell_async_count(fossil_bluecrab_myshell_error_t err, const char *, const char *, void *user) {
+    if (err == FOSSIL_MYSHELL_ERROR_SUCCESS) ++*static_cast<size_t *>(user);
+}
+
+FOSSIL_TEST(cpp_test_myshell_async_submit) {
+    fossil_bluecrab_myshell_error_t err;
+    const std::string file_name = "test_async.myshell";
+    auto db = fossil::bluecrab::MyShell::create(file_name, err);
+    ASSUME_ITS_TRUE(db.is_open());
+
+    size_t ok = 0;
+    err = db.submit_put("a", "cstr", "x", cpp_myshell_async_count, &ok);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    err = db.submit_get("a", cpp_myshell_async_count, &ok);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    db.async_wait();
+    ASSUME_ITS_TRUE(ok == 2);
+
+    db.close();
+    remove(file_name.c_str());
+    remove((file_name + ".meta").c_str());
+}
+
+static bool cpp_myshell_query_stop_after_one(const char *, const char *, const char *value, void *user) {
+    *static_cast<std::string *>(user) = value ? value : "";
+    return false;
+}
+
+FOSSIL_TEST(cpp_test_myshell_query) {
+    fossil_bluecrab_myshell_error_t err;
+    const std::string file_name = "test_query.myshell";
+    auto db = fossil::bluecrab::MyShell::create(file_name, err);
+    ASSUME_ITS_TRUE(db.is_open());
+    ASSUME_ITS_TRUE(db.put("x", "f64", "1.5") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(db.put("y", "f64", "2.5") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    std::string value;
+    err = db.query("SELECT value WHERE value >= 1.0", cpp_myshell_query_stop_after_one, &value);
+    ASSUME_ITS_TRUE(err == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_EQUAL_CSTR("1.5", value.c_str());
+
+    db.close();
+    remove(file_name.c_str());
+    remove((file_name + ".meta").c_str());
+}
+
+static bool cpp_myshell_index_count(const char *, const char *, const char *, void *user) {
+    ++*static_cast<size_t *>(user);
+    return true;
+}
+
+FOSSIL_TEST(cpp_test_myshell_secondary_index) {
+    fossil_bluecrab_myshell_error_t err;
+    const std::string file_name = "test_index_cpp.myshell";
+    auto db = fossil::bluecrab::MyShell::create(file_name, err);
+    ASSUME_ITS_TRUE(db.is_open());
+    ASSUME_ITS_TRUE(db.put("a", "cstr", "red") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(db.put("b", "cstr", "blue") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(db.put("c", "cstr", "red") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(db.create_index("colour", "") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    size_t count = 0;
+    ASSUME_ITS_TRUE(db.index_lookup("colour", "red", cpp_myshell_index_count, &count) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 2);
+    count = 0;
+    ASSUME_ITS_TRUE(db.index_range("colour", "", "c", cpp_myshell_index_count, &count) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 1);
+    ASSUME_ITS_TRUE(db.drop_index("colour") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    db.close();
+    remove(file_name.c_str());
+    remove((file_name + ".meta").c_str());
+}
+
+FOSSIL_TEST(cpp_test_myshell_aggregate) {
+    fossil_bluecrab_myshell_error_t err;
+    const std::string file_name = "test_aggregate_cpp.myshell";
+    auto db = fossil::bluecrab::MyShell::create(file_name, err);
+    ASSUME_ITS_TRUE(db.is_open());
+    ASSUME_ITS_TRUE(db.put("c.1", "u32", "7") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(db.put("c.2", "u32", "5") == FOSSIL_MYSHELL_ERROR_SUCCESS);
+
+    fossil_myshell_agg_result_t r{};
+    ASSUME_ITS_TRUE(db.aggregate("c.", "u32", FOSSIL_MYSHELL_AGG_SUM, r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.u64 == 12 && r.count == 2);
+    ASSUME_ITS_TRUE(db.aggregate("c.", "u32", FOSSIL_MYSHELL_AGG_AVG, r) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(r.f64 == 6.0);
+
+    db.close();
+    remove(file_name.c_str());
+    remove((file_name + ".meta").c_str());
+}
+
+FOSSIL_TEST(cpp_test_myshell_sharded_threads) {
+    fossil_bluecrab_myshell_error_t err;
+    const std::string dir = "test_sharded_cpp.d";
+    {
+        fossil::bluecrab::ShardedMyShell db(dir, 3, err);
+        ASSUME_ITS_TRUE(db.is_open());
+        ASSUME_ITS_TRUE(db.shard_count() == 3);
+
+        // Concurrent writers on one handle
+        std::vector<std::thread> writers;
+        std::atomic<int> failures{0};
+        for (int t = 0; t < 4; ++t) {
+            writers.emplace_back([&db, &failures, t]() {
+                for (int i = 0; i < 25; ++i) {
+                    std::string key = "w" + std::to_string(t) + "." + std::to_string(i);
+                    if (db.put(key, "i32", std::to_string(i)) != FOSSIL_MYSHELL_ERROR_SUCCESS) {
+                        failures++;
+                    }
+                }
+            });
+        }
+        for (auto& w : writers) w.join();
+        ASSUME_ITS_TRUE(failures == 0);
+
+        std::string value;
+        ASSUME_ITS_TRUE(db.get("w3.24", value) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+        ASSUME_ITS_TRUE(value == "24");
+        size_t rows = 0;
+        ASSUME_ITS_TRUE(db.query("SELECT key", [](const char*, const char*, const char*, void* u) {
+            (*static_cast<size_t*>(u))++;
+            return true;
+        }, &rows) == FOSSIL_MYSHELL_ERROR_SUCCESS);
+        ASSUME_ITS_TRUE(rows == 100);
+        ASSUME_ITS_TRUE(db.check_integrity() == FOSSIL_MYSHELL_ERROR_SUCCESS);
+    }
+    for (int i = 0; i < 3; ++i) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s/shard-%04d.myshell", dir.c_str(), i);
+        remove(name);
+        remove((std::string(name) + ".meta").c_str());
+    }
+    remove((dir + "/shards.manifest").c_str());
+    remove(dir.c_str());
+}
+
 // * * * * * * * * * * * * * * * * * * * * * * * *
 // * Fossil Logic Test Pool
 // * * * * * * * * * * * * * * * * * * * * * * * *
@@ -387,6 +691,17 @@ FOSSIL_TEST_GROUP(cpp_myshell_database_tests) {
     FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_backup_restore_null_args);
     FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_diff_null_args);
     FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_check_integrity_null);
+    FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_stage_commit);
+    FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_txn_commit_rollback);
+    FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_cache_hits_invalidation);
+    FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_log_range);
+    FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_open_trusts_sidecar);
+    FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_durability_modes);
+    FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_async_submit);
+    FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_query);
+    FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_secondary_index);
+    FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_aggregate);
+    FOSSIL_TEST_ADD(cpp_myshell_fixture, cpp_test_myshell_sharded_threads);
 
     FOSSIL_TEST_REGISTER(cpp_myshell_fixture);
 } // end of tests
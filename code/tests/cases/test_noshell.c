@@ -25,6 +25,7 @@
 #include <fossil/pizza/framework.h>
 
 #include "fossil/crabdb/framework.h"
+#include "fossil/crabdb/thread.h"
 
 // * * * * * * * * * * * * * * * * * * * * * * * *
 // * Fossil Logic Test Utilities
@@ -263,6 +264,1151 @@ FOSSIL_TEST(c_test_noshell_lock_unlock_is_locked) {
     fossil_bluecrab_noshell_delete_database(file_name);
 }
 
+FOSSIL_TEST(c_test_noshell_durability_modes) {
+    fossil_bluecrab_noshell_error_t err;
+    const char *file_name = "test_noshell_durability.noshell";
+
+    err = fossil_bluecrab_noshell_create_database(file_name);
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_get_durability(file_name) == FOSSIL_NOSHELL_DURABILITY_FLUSH);
+
+    err = fossil_bluecrab_noshell_set_durability(file_name, FOSSIL_NOSHELL_DURABILITY_PERIODIC, 0);
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_INVALID_QUERY);
+
+    err = fossil_bluecrab_noshell_set_durability(file_name, FOSSIL_NOSHELL_DURABILITY_FSYNC, 0);
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_get_durability(file_name) == FOSSIL_NOSHELL_DURABILITY_FSYNC);
+    err = fossil_bluecrab_noshell_insert(file_name, "{ a: i32: 1 }", NULL, "object");
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    err = fossil_bluecrab_noshell_set_durability(file_name, FOSSIL_NOSHELL_DURABILITY_PERIODIC, 5);
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    err = fossil_bluecrab_noshell_insert(file_name, "{ b: i32: 2 }", NULL, "object");
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // Switching back to the default stops the worker
+    err = fossil_bluecrab_noshell_set_durability(file_name, FOSSIL_NOSHELL_DURABILITY_FLUSH, 0);
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    char result[128];
+    err = fossil_bluecrab_noshell_find(file_name, "b: i32: 2", result, sizeof(result), "object");
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+static void c_noshell_async_count(fossil_bluecrab_noshell_error_t err, const char *result, void *user) {
+    if (err == FOSSIL_NOSHELL_ERROR_SUCCESS && result) ++*(size_t *)user;
+}
+
+FOSSIL_TEST(c_test_noshell_async_submit) {
+    const char *files[] = { "test_noshell_async_a.noshell", "test_noshell_async_b.noshell" };
+    size_t ok = 0;
+
+    for (size_t f = 0; f < 2; ++f) {
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(files[f]) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        for (int i = 0; i < 8; ++i) {
+            char doc[64];
+            snprintf(doc, sizeof(doc), "{ n: i32: %d }", i);
+            fossil_bluecrab_noshell_error_t err = fossil_bluecrab_noshell_submit_insert(files[f], doc, NULL, "object", c_noshell_async_count, &ok);
+            ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        }
+        // Runs after the inserts on the same file
+        fossil_bluecrab_noshell_error_t err = fossil_bluecrab_noshell_submit_find(files[f], "n: i32: 7", "object", c_noshell_async_count, &ok);
+        ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+
+    size_t dispatched = fossil_bluecrab_noshell_async_wait();
+    ASSUME_ITS_TRUE(dispatched == 18);
+    ASSUME_ITS_TRUE(ok == 18);
+
+    // With no inserts pending, finds on one file run side by side
+    ok = 0;
+    for (int i = 0; i < 32; ++i) {
+        char query[32];
+        snprintf(query, sizeof(query), "n: i32: %d", i % 8);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_submit_find(files[0], query, "object", c_noshell_async_count, &ok) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_async_wait() == 32);
+    ASSUME_ITS_TRUE(ok == 32);
+
+    fossil_bluecrab_noshell_async_shutdown();
+    fossil_bluecrab_noshell_delete_database(files[0]);
+    fossil_bluecrab_noshell_delete_database(files[1]);
+}
+
+FOSSIL_TEST(c_test_noshell_handle) {
+    fossil_bluecrab_noshell_error_t err;
+    const char *file_name = "test_noshell_handle.noshell";
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_open(file_name, &err) == NULL);
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    fossil_bluecrab_noshell_t *db = fossil_bluecrab_noshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    // Opens of one path share a handle
+    fossil_bluecrab_noshell_t *again = fossil_bluecrab_noshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(again == db && db->refs == 2);
+    fossil_bluecrab_noshell_close(again);
+
+    char id1[17], id2[17], id[17];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert_with_id(db, "{ name: cstr: \"ann\" }", NULL, "object", id1, sizeof(id1)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert_with_id(db, "{ name: cstr: \"ben\" }", NULL, "object", id2, sizeof(id2)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert(db, "not a document", NULL, "object") == FOSSIL_NOSHELL_ERROR_INVALID_TYPE);
+
+    char result[128];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_find(db, "ben", result, sizeof(result), "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, id2) != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_find(db, "ben", result, sizeof(result), "array") == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+
+    size_t count = 0;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_count_documents(db, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 2);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_first_document(db, id, sizeof(id)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(id, id1) == 0);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_next_document(db, id, id, sizeof(id)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(id, id2) == 0);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_next_document(db, id, id, sizeof(id)) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+
+    // Writes through the file-name API are picked up by the handle
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ name: cstr: \"cat\" }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_count_documents(db, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 3);
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_update(db, "ann", "{ name: cstr: \"anna\" }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_find(db, "anna", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_remove(db, "ben") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_remove(db, "ben") == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_find(db, "ben", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+
+    // And handle writes are visible to the file-name API
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "anna", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 2); // anna kept ann's #id=
+
+    fossil_bluecrab_noshell_close(db);
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+FOSSIL_TEST(c_test_noshell_id_index) {
+    const char *file_name = "test_noshell_id_index.noshell";
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    char ids[300][17];
+    for (int i = 0; i < 300; ++i) {
+        char doc[64];
+        snprintf(doc, sizeof(doc), "{ n: i32: %d }", i);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert_with_id(file_name, doc, NULL, "object", ids[i], sizeof(ids[i])) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+
+    // Full walk in file order
+    char id[17];
+    int seen = 0;
+    fossil_bluecrab_noshell_error_t err = fossil_bluecrab_noshell_first_document(file_name, id, sizeof(id));
+    while (err == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        ASSUME_ITS_TRUE(seen < 300 && strcmp(id, ids[seen]) == 0);
+        seen++;
+        err = fossil_bluecrab_noshell_next_document(file_name, id, id, sizeof(id));
+    }
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(seen == 300);
+
+    char result[128];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, ids[123], result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "n: i32: 123 }") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, "0000000000000000", result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+
+    // Writes invalidate the cached index
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_remove(file_name, "n: i32: 123 }") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, ids[123], result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_next_document(file_name, ids[122], id, sizeof(id)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(id, ids[124]) == 0);
+
+    // Handles answer from their own table
+    fossil_bluecrab_noshell_t *db = fossil_bluecrab_noshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_find_by_id(db, ids[299], result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "n: i32: 299 }") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, ids[0], result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil_bluecrab_noshell_close(db);
+
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+FOSSIL_TEST(c_test_noshell_cursor) {
+    const char *file_name = "test_noshell_cursor.noshell";
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    char first_id[17];
+    for (int i = 0; i < 50; ++i) {
+        char doc[64], id[17];
+        snprintf(doc, sizeof(doc), "{ n: i32: %d }", i);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert_with_id(file_name, doc, NULL, i % 5 == 0 ? "array" : "object", id, sizeof(id)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        if (i == 0) memcpy(first_id, id, sizeof(id));
+    }
+
+    // Single steps: views of document, type and id
+    fossil_bluecrab_noshell_error_t err;
+    fossil_bluecrab_noshell_cursor_t *cur = fossil_bluecrab_noshell_cursor_open(file_name, "array", &err);
+    ASSUME_ITS_TRUE(cur != NULL && err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil_bluecrab_noshell_entry_t entry;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_cursor_next(cur, &entry) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(entry.document.length == strlen("{ n: i32: 0 }") && memcmp(entry.document.data, "{ n: i32: 0 }", entry.document.length) == 0);
+    ASSUME_ITS_TRUE(entry.type.length == 5 && memcmp(entry.type.data, "array", 5) == 0);
+    ASSUME_ITS_TRUE(entry.id.length == 16 && memcmp(entry.id.data, first_id, 16) == 0);
+    int arrays = 1;
+    while (fossil_bluecrab_noshell_cursor_next(cur, &entry) == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        ASSUME_ITS_TRUE(entry.type.length == 5);
+        arrays++;
+    }
+    ASSUME_ITS_TRUE(arrays == 10);
+    fossil_bluecrab_noshell_cursor_close(cur);
+
+    // Batches of 8 over everything, including the untagged "{ }" line
+    cur = fossil_bluecrab_noshell_cursor_open(file_name, NULL, &err);
+    ASSUME_ITS_TRUE(cur != NULL);
+    fossil_bluecrab_noshell_entry_t batch[8];
+    size_t fetched = 0, total = 0, with_id = 0;
+    while (fossil_bluecrab_noshell_cursor_next_batch(cur, batch, 8, &fetched) == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        ASSUME_ITS_TRUE(fetched > 0 && fetched <= 8);
+        for (size_t i = 0; i < fetched; ++i) {
+            ASSUME_ITS_TRUE(batch[i].document.data[0] == '{');
+            if (batch[i].id.length == 16) with_id++;
+        }
+        total += fetched;
+    }
+    ASSUME_ITS_TRUE(fetched == 0);
+    ASSUME_ITS_TRUE(total == 51 && with_id == 50);
+    fossil_bluecrab_noshell_cursor_close(cur);
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_cursor_open(file_name, "bogus", &err) == NULL);
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_INVALID_TYPE);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_cursor_open("missing_cursor.noshell", NULL, &err) == NULL);
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_FILE_NOT_FOUND);
+
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+FOSSIL_TEST(c_test_noshell_structured_query) {
+    const char *file_name = "test_noshell_structured_query.noshell";
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ name: cstr: \"ann\", age: i32: 31, addr: object: { city: cstr: \"Oslo\" } }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ name: cstr: \"ben\", age: i32: 9, addr: object: { city: cstr: \"Rome\" } }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ name: cstr: \"type\" }", NULL, "array") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    char result[256];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE age > 10", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "\"ann\"") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "where addr.city = 'Rome' and age < 10", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "\"ben\"") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE name LIKE 'b%' OR age >= 100", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "\"ben\"") != NULL);
+
+    // Fields are matched, not the #type=/#id= tags; _type reads the tag
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE name = 'object'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE _type = 'array'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "\"type\"") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE missing = 1", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE age >", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_INVALID_QUERY);
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_update(file_name, "WHERE name = 'ben'", "{ name: cstr: \"ben\", age: i32: 10 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE age = 10", result, sizeof(result), "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_remove(file_name, "WHERE age >= 20") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "ann", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+
+    // Handles take the same queries
+    fossil_bluecrab_noshell_error_t err;
+    fossil_bluecrab_noshell_t *db = fossil_bluecrab_noshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_find(db, "WHERE name = \"ben\"", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_remove(db, "WHERE _type = 'array'") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_find(db, "\"type\"", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    fossil_bluecrab_noshell_close(db);
+
+    // Compiled once, reused
+    fossil_bluecrab_noshell_query_t *q = fossil_bluecrab_noshell_query_compile("age >= 5 AND age <= 15", &err);
+    ASSUME_ITS_TRUE(q != NULL && err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_query_match(q, "{ age: i32: 7 } #type=object"));
+    ASSUME_ITS_TRUE(!fossil_bluecrab_noshell_query_match(q, "{ age: i32: 70 } #type=object"));
+    ASSUME_ITS_TRUE(!fossil_bluecrab_noshell_query_match(q, "{ other: i32: 7 }"));
+    fossil_bluecrab_noshell_query_free(q);
+
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+FOSSIL_TEST(c_test_noshell_field_index) {
+    const char *file_name = "test_noshell_field_index.noshell";
+    static const char *statuses[] = { "open", "closed", "hold" };
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    for (int i = 0; i < 200; ++i) {
+        char doc[128];
+        snprintf(doc, sizeof(doc), "{ status: cstr: \"%s\", owner: cstr: \"u%d\", created: i64: %d }", statuses[i % 3], i % 7, 1000 + i);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, doc, NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_index(file_name, "status", FOSSIL_NOSHELL_INDEX_HASH) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_index(file_name, "created", FOSSIL_NOSHELL_INDEX_ORDERED) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_index(file_name, "status", FOSSIL_NOSHELL_INDEX_ORDERED) == FOSSIL_NOSHELL_ERROR_ALREADY_EXISTS);
+
+    // First match in file order, same as a scan
+    char result[256];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE status = 'hold' AND owner = 'u4'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "created: i64: 1011 }") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE created >= 1198", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "created: i64: 1198 }") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE created < 1000.5 AND status = 'open'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "created: i64: 1000 }") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE created = 1000.0", result, sizeof(result), "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE created > 5000", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE status = 'gone'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+
+    // Appends are picked up incrementally, rewrites rebuild
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ status: cstr: \"gone\", created: i64: 9000 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE status = 'gone'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE created > 5000", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_update(file_name, "WHERE status = 'gone'", "{ status: cstr: \"back\", created: i64: 9001 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE status = 'gone'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE created = 9001", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_remove(file_name, "WHERE created = 9001") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE created > 5000", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+
+    // Handles use the same indexes
+    fossil_bluecrab_noshell_error_t err;
+    fossil_bluecrab_noshell_t *db = fossil_bluecrab_noshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert(db, "{ status: cstr: \"new\", created: i64: 7 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_find(db, "WHERE status = 'new' AND created <= 7", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil_bluecrab_noshell_close(db);
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_drop_index(file_name, "status") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_drop_index(file_name, "status") == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_drop_index(file_name, "created") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE status = 'hold' AND owner = 'u4'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "created: i64: 1011 }") != NULL);
+
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+FOSSIL_TEST(c_test_noshell_text_index) {
+    const char *file_name = "test_noshell_text_index.noshell";
+    static const char *words[] = { "alpha", "bravo", "charlie", "delta", "echo" };
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    for (int i = 0; i < 300; ++i) {
+        char doc[160];
+        snprintf(doc, sizeof(doc), "{ title: cstr: \"%s note %d\", body: cstr: \"%s-%s\" }", words[i % 5], i, words[(i + 1) % 5], words[(i + 3) % 5]);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, doc, NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_index(file_name, "*", FOSSIL_NOSHELL_INDEX_HASH) == FOSSIL_NOSHELL_ERROR_UNSUPPORTED);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_index(file_name, "*", FOSSIL_NOSHELL_INDEX_TEXT) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_index(file_name, "title", FOSSIL_NOSHELL_INDEX_TEXT) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // Plain substring finds go through the whole-line index
+    char result[256];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "charlie note 27", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "\"charlie note 27\"") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "echo-bravo", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "\"delta note 3\"") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "foxtrot", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+
+    // LIKE and equality on the indexed field
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE title LIKE '%ta note 1%'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "\"delta note 13\"") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE title = 'bravo note 201'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE title = 'bravo note 20'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE title LIKE 'echo%' AND body LIKE 'alpha%'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "\"echo note 4\"") != NULL);
+
+    // Appends are indexed incrementally, rewrites rebuild
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ title: cstr: \"zulu memo\" }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "zulu memo", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE title LIKE '%ulu%'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_update(file_name, "zulu memo", "{ title: cstr: \"yankee memo\" }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "zulu memo", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE title LIKE '%yankee%'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_drop_index(file_name, "*") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_drop_index(file_name, "title") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "charlie note 27", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+static size_t c_noshell_count_tombstones(const char *file_name) {
+    FILE *fp = fopen(file_name, "r");
+    char line[256];
+    size_t n = 0;
+    while (fp && fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "#del=", 5) == 0) n++;
+    }
+    if (fp) fclose(fp);
+    return n;
+}
+
+static bool c_noshell_ends_with_tombstone(const char *file_name) {
+    FILE *fp = fopen(file_name, "r");
+    char line[256] = {0};
+    while (fp && fgets(line, sizeof(line), fp)) {}
+    if (fp) fclose(fp);
+    return strncmp(line, "#del=", 5) == 0;
+}
+
+FOSSIL_TEST(c_test_noshell_tombstones) {
+    const char *file_name = "test_noshell_tombstones.noshell";
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    char id[17], result[256];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert_with_id(file_name, "{ k: cstr: \"a\", v: i32: 1 }", NULL, "object", id, sizeof(id)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ k: cstr: \"b\", v: i32: 2 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ k: cstr: \"c\", v: i32: 3 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    size_t size_before = 0, size_after = 0, count = 0;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_get_file_size(file_name, &size_before) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // An update appends the new version, which keeps the id, then a tombstone
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_update(file_name, "WHERE k = 'a'", "{ k: cstr: \"a\", v: i32: 10 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_get_file_size(file_name, &size_after) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(size_after > size_before);
+    ASSUME_ITS_TRUE(c_noshell_count_tombstones(file_name) == 1);
+    ASSUME_ITS_TRUE(c_noshell_ends_with_tombstone(file_name));
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, id, result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "v: i32: 10") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "v: i32: 1 }", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_update(file_name, "v: i32: 1 }", "{ k: cstr: \"z\" }", NULL, NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+
+    // Removed documents disappear from every reader
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_remove(file_name, "WHERE k = 'b'") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_remove(file_name, "WHERE k = 'b'") == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(c_noshell_count_tombstones(file_name) == 2);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 2);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_verify_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    fossil_bluecrab_noshell_error_t err;
+    fossil_bluecrab_noshell_cursor_t *cur = fossil_bluecrab_noshell_cursor_open(file_name, "object", &err);
+    ASSUME_ITS_TRUE(cur != NULL);
+    fossil_bluecrab_noshell_entry_t entries[8];
+    size_t fetched = 0;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_cursor_next_batch(cur, entries, 8, &fetched) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fetched == 2);
+    ASSUME_ITS_TRUE(strncmp(entries[0].document.data, "{ k: cstr: \"c\"", 14) == 0);
+    ASSUME_ITS_TRUE(strncmp(entries[1].document.data, "{ k: cstr: \"a\", v: i32: 10 }", entries[1].document.length) == 0);
+    fossil_bluecrab_noshell_cursor_close(cur);
+
+    // Handles see the same state and write tombstones too
+    fossil_bluecrab_noshell_t *db = fossil_bluecrab_noshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_count_documents(db, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 2);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_find(db, "WHERE k = 'b'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_remove(db, "WHERE k = 'c'") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_count_documents(db, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 1);
+    char first[17];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_first_document(db, first, sizeof(first)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(first, id) == 0);
+
+    // Compaction drops retired lines and tombstones, through the handle
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_compact(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(c_noshell_count_tombstones(file_name) == 0);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_get_file_size(file_name, &size_after) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(size_after < size_before);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_find_by_id(db, id, result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "v: i32: 10") != NULL);
+    fossil_bluecrab_noshell_close(db);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 1);
+
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+#define C_NOSHELL_RACE_THREADS 8
+#define C_NOSHELL_RACE_INSERTS 16
+
+typedef struct {
+    const char *file_name;
+    char ids[C_NOSHELL_RACE_INSERTS][17];
+    bool ok;
+} c_noshell_race_t;
+
+FOSSIL_THREAD_FN(c_noshell_race_insert) {
+    c_noshell_race_t *race = (c_noshell_race_t *)arg;
+    race->ok = true;
+    for (int i = 0; i < C_NOSHELL_RACE_INSERTS; ++i) {
+        if (fossil_bluecrab_noshell_insert_with_id(race->file_name, "{ same: cstr: \"doc\" }", NULL, "object",
+                                                   race->ids[i], sizeof(race->ids[i])) != FOSSIL_NOSHELL_ERROR_SUCCESS)
+            race->ok = false;
+    }
+    FOSSIL_THREAD_RETURN;
+}
+
+FOSSIL_TEST(c_test_noshell_concurrent_insert_ids) {
+    const char *file_name = "test_noshell_race.noshell";
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // Equal documents inserted at once still get one id each
+    static c_noshell_race_t races[C_NOSHELL_RACE_THREADS];
+    fossil_bluecrab_thread_t threads[C_NOSHELL_RACE_THREADS];
+    for (int t = 0; t < C_NOSHELL_RACE_THREADS; ++t) {
+        memset(&races[t], 0, sizeof(races[t]));
+        races[t].file_name = file_name;
+        ASSUME_ITS_TRUE(fossil_bluecrab_thread_start(&threads[t], c_noshell_race_insert, &races[t]));
+    }
+    for (int t = 0; t < C_NOSHELL_RACE_THREADS; ++t)
+        fossil_bluecrab_thread_join(threads[t]);
+
+    size_t total = C_NOSHELL_RACE_THREADS * C_NOSHELL_RACE_INSERTS, duplicates = 0;
+    for (size_t a = 0; a < total; ++a) {
+        c_noshell_race_t *ra = &races[a / C_NOSHELL_RACE_INSERTS];
+        ASSUME_ITS_TRUE(ra->ok);
+        for (size_t b = a + 1; b < total; ++b) {
+            c_noshell_race_t *rb = &races[b / C_NOSHELL_RACE_INSERTS];
+            if (strcmp(ra->ids[a % C_NOSHELL_RACE_INSERTS], rb->ids[b % C_NOSHELL_RACE_INSERTS]) == 0)
+                duplicates++;
+        }
+    }
+    ASSUME_ITS_TRUE(duplicates == 0);
+    size_t count = 0;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == total);
+
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+FOSSIL_TEST(c_test_noshell_auto_compaction) {
+    const char *file_name = "test_noshell_auto_compaction.noshell";
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    for (int i = 0; i < 2000; ++i) {
+        char doc[128];
+        snprintf(doc, sizeof(doc), "{ n: i32: %d, pad: cstr: \"xxxxxxxxxxxxxxxxxxxxxxxx\" }", i);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, doc, NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_index(file_name, "n", FOSSIL_NOSHELL_INDEX_ORDERED) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // Retiring most of the file triggers a compaction on the way
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_remove(file_name, "WHERE n >= 100") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(c_noshell_count_tombstones(file_name) == 0);
+    size_t count = 0, size = 0;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 100);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_get_file_size(file_name, &size) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(size < 16 * 1024);
+
+    char result[256];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE n = 99", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE n = 100", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_update(file_name, "WHERE n = 5", "{ n: i32: 5000 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE n = 5", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE n > 1000", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_drop_index(file_name, "n") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+FOSSIL_TEST(c_test_noshell_insert_many) {
+    const char *file_name = "test_noshell_insert_many.noshell";
+    fossil_bluecrab_noshell_error_t err;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil_bluecrab_noshell_t *db = fossil_bluecrab_noshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+
+    // Large enough to take the threaded path
+    enum { BATCH = 5000 };
+    static char bodies[BATCH][48];
+    static const char *docs[BATCH];
+    static char ids[BATCH][17];
+    for (int i = 0; i < BATCH; ++i) {
+        snprintf(bodies[i], sizeof(bodies[i]), "{ n: i32: %d }", i);
+        docs[i] = bodies[i];
+    }
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert_many(db, docs, BATCH, NULL, "object", ids) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    size_t count = 0;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_count_documents(db, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == BATCH);
+    char result[128];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_find_by_id(db, ids[4321], result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "{ n: i32: 4321 }") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_first_document(db, result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(result, ids[0]) == 0);
+
+    // One bad document rejects the whole batch
+    const char *mixed[] = { "{ n: i32: -1 }", "not a document" };
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert_many(db, mixed, 2, NULL, "object", NULL) == FOSSIL_NOSHELL_ERROR_INVALID_TYPE);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert_many(db, docs, 1, NULL, "nope", NULL) == FOSSIL_NOSHELL_ERROR_INVALID_TYPE);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_count_documents(db, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == BATCH);
+
+    // Params are written like a single insert's
+    const char *tagged[] = { "{ n: i32: 9001 }" };
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert_many(db, tagged, 1, "#tag=batch", "object", NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil_bluecrab_noshell_close(db);
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "9001", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "{ n: i32: 9001 } #tag=batch #type=object #id=") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_verify_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+typedef struct {
+    int  seen;
+    int  last;
+    bool ordered;
+    int  stop_after;
+} c_noshell_scan_state_t;
+
+static bool c_noshell_scan_cb(const char *document, void *userdata) {
+    c_noshell_scan_state_t *st = (c_noshell_scan_state_t *)userdata;
+    const char *n = strstr(document, "i32: ");
+    int value = n ? atoi(n + 5) : -1;
+    if (value <= st->last)
+        st->ordered = false;
+    st->last = value;
+    return ++st->seen == st->stop_after;
+}
+
+static bool c_noshell_scan_first(const char *document, void *userdata) {
+    (void)document;
+    (void)userdata;
+    return true;
+}
+
+FOSSIL_TEST(c_test_noshell_find_cb_parallel) {
+    const char *file_name = "test_noshell_find_cb_parallel.noshell";
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    for (int i = 0; i < 2000; ++i) {
+        char doc[64];
+        snprintf(doc, sizeof(doc), "{ n: i32: %d, kind: cstr: \"%s\" }", i, i % 10 == 0 ? "ten" : "other");
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, doc, NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_remove(file_name, "WHERE n = 500") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // Ordered: every live document (and create_database's "{ }"), in file order
+    c_noshell_scan_state_t st = { 0, -2, true, 0 };
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_cb_parallel(file_name, NULL, FOSSIL_NOSHELL_SCAN_ORDERED, 4, c_noshell_scan_cb, &st) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(st.seen == 2000 && st.ordered);
+
+    // Filter runs on the workers; returning true stops the scan
+    c_noshell_scan_state_t filtered = { 0, -1, true, 50 };
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_cb_parallel(file_name, "WHERE kind = 'ten'", FOSSIL_NOSHELL_SCAN_ORDERED, 3, c_noshell_scan_cb, &filtered) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(filtered.seen == 50 && filtered.ordered && filtered.last == 490);
+
+    // Unordered
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_cb_parallel(file_name, "i32: 1999,", FOSSIL_NOSHELL_SCAN_UNORDERED, 4, c_noshell_scan_first, NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_cb_parallel(file_name, "WHERE n = 500", FOSSIL_NOSHELL_SCAN_UNORDERED, 4, c_noshell_scan_first, NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_cb_parallel(file_name, NULL, (fossil_bluecrab_noshell_scan_mode_t)7, 4, c_noshell_scan_first, NULL) == FOSSIL_NOSHELL_ERROR_INVALID_QUERY);
+
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+FOSSIL_TEST(c_test_noshell_scan_long_lines) {
+    const char *file_name = "test_noshell_scan_long_lines.noshell";
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // Lines longer than the scan block, next to short ones
+    size_t big = 150 * 1024;
+    char *doc = (char *)malloc(big + 64);
+    ASSUME_ITS_TRUE(doc != NULL);
+    strcpy(doc, "{ blob: cstr: \"");
+    size_t at = strlen(doc);
+    memset(doc + at, 'x', big);
+    strcpy(doc + at + big, "end\" }");
+    for (int i = 0; i < 3; ++i) {
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ small: i32: 1 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, doc, NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+    free(doc);
+
+    size_t count = 0;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 6);
+    char result[64];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "xend\"", result, sizeof(result), "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "xend\"", result, sizeof(result), "array") == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_verify_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // A last line without its newline is still read
+    FILE *fp = fopen(file_name, "ab");
+    ASSUME_ITS_TRUE(fp != NULL);
+    fputs("{ tail: i32: 2 } #type=object #id=00000000000000aa", fp);
+    fclose(fp);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 7);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, "00000000000000aa", result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "tail", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+FOSSIL_TEST(c_test_noshell_stats) {
+    const char *file_name = "test_noshell_stats.noshell";
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    for (int i = 0; i < 3; ++i) {
+        char doc[64];
+        snprintf(doc, sizeof(doc), "{ n: i32: %d }", i);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, doc, NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "[ 1, 2 ]", NULL, "array") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "[ 3, 4 ]", NULL, "array") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    fossil_bluecrab_noshell_stats_t stats;
+    size_t size = 0, count = 0;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_stats(file_name, &stats) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_get_file_size(file_name, &size) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(stats.documents == 5 && stats.type_counts[NOSHELL_FSON_TYPE_OBJECT] == 3 && stats.type_counts[NOSHELL_FSON_TYPE_ARRAY] == 2);
+    ASSUME_ITS_TRUE(stats.file_size == size && stats.dead_bytes == 0 && stats.live_bytes == size);
+
+    // The counts are stamped into the sidecar and caught up after each change
+    FILE *meta = fopen("test_noshell_stats.noshell.meta", "rb");
+    ASSUME_ITS_TRUE(meta != NULL);
+    if (meta) fclose(meta);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_update(file_name, "WHERE n = 1", "{ n: i32: 10 }", NULL, NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_remove(file_name, "WHERE _type = 'array'") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_stats(file_name, &stats) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 3);
+    ASSUME_ITS_TRUE(stats.documents == 3 && stats.type_counts[NOSHELL_FSON_TYPE_OBJECT] == 2);
+    ASSUME_ITS_TRUE(stats.type_counts[NOSHELL_FSON_TYPE_ARRAY] == 0); // the new version carries no #type=
+    ASSUME_ITS_TRUE(stats.dead_bytes > 0 && stats.live_bytes + stats.dead_bytes == stats.file_size);
+
+    // A damaged sidecar is ignored and rewritten
+    meta = fopen("test_noshell_stats.noshell.meta", "wb");
+    ASSUME_ITS_TRUE(meta != NULL);
+    if (meta) {
+        fputs("#noshell_meta size=12 docs=99", meta);
+        fclose(meta);
+    }
+    fossil_bluecrab_noshell_stats_t again;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_stats(file_name, &again) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(memcmp(&again, &stats, sizeof(stats)) == 0);
+
+    // Handle writes append to the same file
+    fossil_bluecrab_noshell_error_t err;
+    fossil_bluecrab_noshell_t *db = fossil_bluecrab_noshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert(db, "{ via: cstr: \"handle\" }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil_bluecrab_noshell_close(db);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_stats(file_name, &stats) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(stats.documents == 4 && stats.type_counts[NOSHELL_FSON_TYPE_OBJECT] == 3);
+
+    // Compaction drops the dead bytes
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_compact(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_stats(file_name, &stats) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(stats.documents == 4 && stats.dead_bytes == 0 && stats.live_bytes == stats.file_size);
+
+    fossil_bluecrab_noshell_delete_database(file_name);
+    meta = fopen("test_noshell_stats.noshell.meta", "rb");
+    ASSUME_ITS_TRUE(meta == NULL);
+    if (meta) fclose(meta);
+}
+
+static bool c_noshell_count_cb(const char *document, void *userdata) {
+    (void)document;
+    (*(size_t *)userdata)++;
+    return false;
+}
+
+static char *c_noshell_slurp(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    char *data = NULL;
+    *len = 0;
+    if (fp && fseek(fp, 0, SEEK_END) == 0) {
+        long size = ftell(fp);
+        data = size >= 0 ? (char *)malloc((size_t)size + 1) : NULL;
+        if (data && fseek(fp, 0, SEEK_SET) == 0)
+            *len = fread(data, 1, (size_t)size, fp);
+    }
+    if (fp) fclose(fp);
+    return data;
+}
+
+FOSSIL_TEST(c_test_noshell_binary_fson) {
+    const char *file_name = "test_noshell_fsonb.noshell";
+    const char *copy_name = "test_noshell_fsonb_copy.noshell";
+    const char *image = "test_noshell_fsonb.fsonb";
+    static const char *docs[] = {
+        "{ name: cstr: \"ann\", age: i32: 31, address: object: { city: cstr: \"Oslo\", zip: i32: 150 } }",
+        "{ name: cstr: \"bob\", age: i32: 25, tags: array: [ cstr: \"a\", cstr: \"b\" ], empty: object: { } }",
+        "{ name: cstr: \"cy\", age: i32: 40, score: f64: 2.50, ok: bool: true, note: cstr: \"say \\\"hi\\\"\" }",
+        "{name:cstr:\"odd\", age: i32: 50}",
+        "{ name: 'dee', age: 007, low: i64: -9223372036854775808, high: u64: 18446744073709551615 }",
+        "[ 1, 2, [ 3, { deep: i8: 4 } ] ]",
+        "{ name: cstr: \"gone\", age: i32: 99 }"
+    };
+    char ann_id[17] = {0};
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert_with_id(file_name, docs[0], NULL, "object", ann_id, sizeof(ann_id)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    for (size_t i = 1; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, docs[i], i == 3 ? "#tag=x" : NULL, docs[i][0] == '[' ? "array" : "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_remove(file_name, "WHERE name = 'gone'") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // Export skips dead lines; import gives back the compacted file exactly
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_export_binary(file_name, image) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_import_binary(image, copy_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_compact(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    size_t text_len = 0, copy_len = 0;
+    char *text = c_noshell_slurp(file_name, &text_len);
+    char *copy = c_noshell_slurp(copy_name, &copy_len);
+    ASSUME_ITS_TRUE(text && copy && text_len > 0 && text_len == copy_len && memcmp(text, copy, text_len) == 0);
+    free(text);
+    free(copy);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_verify_database(copy_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // Queries give what they give on the text file
+    static const char *queries[] = {
+        NULL, "WHERE age >= 30", "WHERE address.city = 'Oslo'", "WHERE name = 'odd'",
+        "WHERE name = 'dee' AND age = 7", "WHERE _type = 'array'", "WHERE note LIKE 'say%'", "bob"
+    };
+    static const size_t expected[] = { 7, 3, 1, 1, 1, 1, 1, 1 };
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); ++i) {
+        size_t in_text = 0, in_image = 0;
+        fossil_bluecrab_noshell_find_cb_parallel(file_name, queries[i], FOSSIL_NOSHELL_SCAN_ORDERED, 1, c_noshell_count_cb, &in_text);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_binary_find_cb(image, queries[i], c_noshell_count_cb, &in_image) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+        ASSUME_ITS_TRUE(in_image == in_text && in_image == expected[i]);
+    }
+
+    // Field reads
+    char value[64];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_binary_get_field(image, ann_id, "address.city", value, sizeof(value)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(value, "Oslo") == 0);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_binary_get_field(image, ann_id, "age", value, sizeof(value)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(value, "31") == 0);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_binary_get_field(image, ann_id, "address", value, sizeof(value)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(value, "{ city: cstr: \"Oslo\", zip: i32: 150 }") == 0);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_binary_get_field(image, ann_id, "missing", value, sizeof(value)) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_binary_get_field(image, ann_id, "address", value, 8) == FOSSIL_NOSHELL_ERROR_BUFFER_TOO_SMALL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_binary_get_field(image, "0000000000000000", "age", value, sizeof(value)) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+
+    // Anything else is refused
+    size_t none = 0;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_binary_find_cb(file_name, NULL, c_noshell_count_cb, &none) == FOSSIL_NOSHELL_ERROR_SCHEMA_MISMATCH);
+
+    fossil_bluecrab_noshell_delete_database(file_name);
+    fossil_bluecrab_noshell_delete_database(copy_name);
+    remove(image);
+}
+
+FOSSIL_TEST(c_test_noshell_lsm) {
+    const char *file_name = "test_noshell_lsm.noshell";
+    const char *backup_name = "test_noshell_lsm_backup.noshell";
+    enum { DOCS = 400 };
+    static char ids[DOCS][17];
+    char doc[128], result[256], id[17];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    for (int i = 0; i < 20; ++i) {
+        snprintf(doc, sizeof(doc), "{ n: i32: %d, kind: cstr: \"text\" }", i);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert_with_id(file_name, doc, NULL, "object", ids[i], sizeof(ids[i])) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_remove(file_name, "WHERE n = 19") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // Small tables so the test crosses flushes and merges
+    fossil_bluecrab_noshell_lsm_info_t info;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_lsm_info(file_name, &info) == FOSSIL_NOSHELL_ERROR_UNSUPPORTED);
+    fossil_bluecrab_noshell_lsm_options_t options = {0};
+    options.memtable_bytes = 4096;
+    options.segment_bytes = 8192;
+    options.level0_segments = 2;
+    options.level_ratio = 2;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_lsm_enable(file_name, &options) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_open_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    size_t count = 0;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 19);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, ids[19], result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+
+    for (int i = 20; i < DOCS; ++i) {
+        snprintf(doc, sizeof(doc), "{ n: i32: %d, kind: cstr: \"%s\" }", i, i % 2 ? "odd" : "even");
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert_with_id(file_name, doc, "#src=lsm", "object", ids[i], sizeof(ids[i])) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ n: i32: 20, kind: cstr: \"even\" }", "#src=lsm", "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_update(file_name, "WHERE n = 7", "{ n: i32: 7, kind: cstr: \"seven\" }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_remove(file_name, "WHERE kind = 'odd' AND n < 100") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_remove(file_name, "WHERE n = 100000") == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_lsm_flush(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_lsm_info(file_name, &info) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(info.flushes > 0 && info.memtable_entries == 0);
+
+    // 19 old, 380 new, a second copy of n = 20, 40 odd ones under 100 gone
+    const size_t live = 19 + (DOCS - 20) + 1 - 40;
+    size_t scanned = 0;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == live);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_cb(file_name, c_noshell_count_cb, &scanned) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(scanned == live);
+    scanned = 0;
+    fossil_bluecrab_noshell_find_cb_parallel(file_name, "WHERE kind = 'even'", FOSSIL_NOSHELL_SCAN_ORDERED, 4, c_noshell_count_cb, &scanned);
+    ASSUME_ITS_TRUE(scanned == (DOCS - 20) / 2 + 1);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE n = 7", result, sizeof(result), "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "seven") && strstr(result, ids[7]));
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE n = 7", result, sizeof(result), "array") == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+
+    // Iteration is in id order and sees every live document once
+    size_t steps = 0;
+    char prev[17] = {0};
+    bool ordered = true;
+    fossil_bluecrab_noshell_error_t rc = fossil_bluecrab_noshell_first_document(file_name, id, sizeof(id));
+    while (rc == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        ordered = ordered && (steps == 0 || strcmp(prev, id) < 0);
+        memcpy(prev, id, sizeof(prev));
+        steps++;
+        rc = fossil_bluecrab_noshell_next_document(file_name, prev, id, sizeof(id));
+    }
+    ASSUME_ITS_TRUE(rc == FOSSIL_NOSHELL_ERROR_NOT_FOUND && ordered && steps == live);
+
+    // Full compaction leaves one level and no tombstones
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_compact(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_lsm_info(file_name, &info) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(info.segments[0] == 0 && info.compactions > 0);
+    fossil_bluecrab_noshell_stats_t stats;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_stats(file_name, &stats) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(stats.documents == live && stats.type_counts[NOSHELL_FSON_TYPE_OBJECT] == live);
+    ASSUME_ITS_TRUE(stats.file_size == stats.live_bytes + stats.dead_bytes);
+
+    // Unflushed writes come back from the log after a reopen
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_remove(file_name, "WHERE n = 0") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_lsm_close(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    for (int i = 1; i < DOCS; ++i) {
+        bool gone = i == 19 || (i % 2 && i >= 20 && i < 100);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, ids[i], result, sizeof(result)) ==
+                        (gone ? FOSSIL_NOSHELL_ERROR_NOT_FOUND : FOSSIL_NOSHELL_ERROR_SUCCESS));
+    }
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, ids[0], result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_verify_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // Handles and cursors read the text file only
+    fossil_bluecrab_noshell_error_t err;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_open(file_name, &err) == NULL && err == FOSSIL_NOSHELL_ERROR_UNSUPPORTED);
+
+    // Backups and disable give plain text with the same documents
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_backup_database(file_name, backup_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(backup_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == live - 1);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_lsm_disable(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_lsm_info(file_name, &info) == FOSSIL_NOSHELL_ERROR_UNSUPPORTED);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == live - 1);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, ids[7], result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "seven") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_verify_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    FILE *manifest = fopen("test_noshell_lsm.noshell.lsm", "rb");
+    ASSUME_ITS_TRUE(manifest == NULL);
+    if (manifest) fclose(manifest);
+
+    // delete_database removes every file of a store
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_lsm_enable(file_name, &options) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ n: i32: -1 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_delete_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    manifest = fopen("test_noshell_lsm.noshell.lsm", "rb");
+    ASSUME_ITS_TRUE(manifest == NULL);
+    if (manifest) fclose(manifest);
+    fossil_bluecrab_noshell_delete_database(backup_name);
+}
+
+FOSSIL_TEST(c_test_noshell_lsm_updated_id) {
+    const char *file_name = "test_noshell_lsm_ids.noshell";
+    char first[17] = {0}, again[17] = {0}, result[256];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_lsm_enable(file_name, NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // The update keeps the id the original content hashes to
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert_with_id(file_name, "{ a: i32: 1 }", NULL, "object", first, sizeof(first)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_update(file_name, "WHERE a = 1", "{ a: i32: 2 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert_with_id(file_name, "{ a: i32: 1 }", NULL, "object", again, sizeof(again)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(first, again) != 0);
+
+    // Both documents survive, as they do in a text file
+    size_t count = 0;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 2);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE a = 2", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, first) != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, again, result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strncmp(result, "{ a: i32: 1 }", 13) == 0);
+
+    // Inserting the same document again stores another copy
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ a: i32: 1 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 3);
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+FOSSIL_TEST(c_test_noshell_lsm_duplicate_insert) {
+    const char *text_name = "test_noshell_dup_text.noshell";
+    const char *lsm_name = "test_noshell_dup_lsm.noshell";
+    char first[17] = {0}, again[17] = {0}, result[256];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(text_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(lsm_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_lsm_enable(lsm_name, NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // The same inserts give the same count in both engines
+    const char *names[] = { text_name, lsm_name };
+    size_t counts[2] = {0};
+    for (size_t i = 0; i < 2; ++i) {
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(names[i], "{ a: i32: 1 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(names[i], "{ a: i32: 1 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(names[i], "{ b: i32: 2 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(names[i], &counts[i]) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+    ASSUME_ITS_TRUE(counts[0] == 3);
+    ASSUME_ITS_TRUE(counts[1] == counts[0]);
+
+    // Each copy has its own id
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert_with_id(lsm_name, "{ c: i32: 3 }", NULL, "object", first, sizeof(first)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert_with_id(lsm_name, "{ c: i32: 3 }", NULL, "object", again, sizeof(again)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(first, again) != 0);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(lsm_name, again, result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strncmp(result, "{ c: i32: 3 }", 13) == 0);
+    fossil_bluecrab_noshell_delete_database(text_name);
+    fossil_bluecrab_noshell_delete_database(lsm_name);
+}
+
+FOSSIL_TEST(c_test_noshell_lsm_enable_keeps_every_document) {
+    const char *file_name = "test_noshell_lsm_migrate.noshell";
+    char id[17] = {0}, result[256];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert_with_id(file_name, "{ a: i32: 1 }", NULL, "object", id, sizeof(id)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // An id-less line as older updates wrote, and a second document under the same id
+    FILE *fp = fopen(file_name, "a");
+    ASSUME_ITS_TRUE(fp != NULL);
+    if (fp) {
+        fprintf(fp, "{ b: i32: 2 } #type=object\n");
+        fprintf(fp, "{ c: i32: 3 } #type=object #id=%s\n", id);
+        fclose(fp);
+    }
+    size_t count = 0, scanned = 0;
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_lsm_enable(file_name, NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 3);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_cb(file_name, c_noshell_count_cb, &scanned) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(scanned == 3);
+
+    // The first line keeps its id; the others got free ones
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, id, result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strncmp(result, "{ a: i32: 1 }", 13) == 0);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE b = 2", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, "#id=") != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE c = 3", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strstr(result, id) == NULL);
+
+    // And all three come back as text
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_lsm_disable(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 3);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE b = 2", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+FOSSIL_TEST(c_test_noshell_updated_id) {
+    const char *file_name = "test_noshell_text_ids.noshell";
+    char first[17] = {0}, again[17] = {0}, third[17] = {0}, result[256];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // The update keeps the id the original content hashes to
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert_with_id(file_name, "{ a: i32: 1 }", NULL, "object", first, sizeof(first)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_update(file_name, "WHERE a = 1", "{ a: i32: 2 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert_with_id(file_name, "{ a: i32: 1 }", NULL, "object", again, sizeof(again)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(first, again) != 0);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, first, result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strncmp(result, "{ a: i32: 2 }", 13) == 0);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find_by_id(file_name, again, result, sizeof(result)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strncmp(result, "{ a: i32: 1 }", 13) == 0);
+
+    // A text file keeps a repeated document, under an id of its own
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ a: i32: 1 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // Handles and batches claim free ids the same way
+    fossil_bluecrab_noshell_error_t err;
+    fossil_bluecrab_noshell_t *db = fossil_bluecrab_noshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert_with_id(db, "{ a: i32: 1 }", NULL, "object", third, sizeof(third)) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(third, first) != 0 && strcmp(third, again) != 0);
+    const char *batch[] = { "{ a: i32: 1 }", "{ a: i32: 1 }" };
+    char batch_ids[2][17];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert_many(db, batch, 2, NULL, "object", batch_ids) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(strcmp(batch_ids[0], batch_ids[1]) != 0 && strcmp(batch_ids[0], third) != 0);
+    fossil_bluecrab_noshell_close(db);
+
+    // Iteration visits every document once and ends
+    size_t count = 0, visited = 0;
+    char id[17];
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 6);
+    fossil_bluecrab_noshell_error_t rc = fossil_bluecrab_noshell_first_document(file_name, id, sizeof(id));
+    while (rc == FOSSIL_NOSHELL_ERROR_SUCCESS && visited <= count) {
+        visited++;
+        char next[17];
+        rc = fossil_bluecrab_noshell_next_document(file_name, id, next, sizeof(next));
+        memcpy(id, next, sizeof(id));
+    }
+    ASSUME_ITS_TRUE(visited == count);
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+FOSSIL_TEST(c_test_noshell_handle_survives_compaction) {
+    fossil_bluecrab_noshell_error_t err;
+    const char *file_name = "test_noshell_handle_compact.noshell";
+    size_t count = 0;
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil_bluecrab_noshell_t *db = fossil_bluecrab_noshell_open(file_name, &err);
+    ASSUME_ITS_TRUE(db != NULL);
+    // Another spelling of the path shares the handle
+    fossil_bluecrab_noshell_t *again = fossil_bluecrab_noshell_open("./test_noshell_handle_compact.noshell", &err);
+    ASSUME_ITS_TRUE(again == db);
+    fossil_bluecrab_noshell_close(again);
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert(db, "{ a: i32: 1 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    // Compaction renames a new file over the one the handle has open
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_compact("./test_noshell_handle_compact.noshell") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert(db, "{ a: i32: 2 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // So does anyone else's: an identical copy renamed over it leaves size
+    // and contents alone, only the file changes
+    char buf[4096];
+    FILE *in = fopen(file_name, "rb");
+    FILE *out = fopen("test_noshell_handle_compact.noshell.tmp", "wb");
+    ASSUME_ITS_TRUE(in != NULL && out != NULL);
+    size_t n = fread(buf, 1, sizeof(buf), in);
+    ASSUME_ITS_TRUE(fwrite(buf, 1, n, out) == n);
+    fclose(in);
+    fclose(out);
+    ASSUME_ITS_TRUE(rename("test_noshell_handle_compact.noshell.tmp", file_name) == 0);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_handle_insert(db, "{ a: i32: 3 }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil_bluecrab_noshell_close(db);
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_count_documents(file_name, &count) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(count == 3);
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
+FOSSIL_TEST(c_test_noshell_state_shared_by_path) {
+    const char *file_name = "test_noshell_state_shared.noshell";
+    const char *alias = "./test_noshell_state_shared.noshell";
+    char result[512];
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(file_name, "{ status: cstr: \"old\" }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    // Settings and indexes made through one spelling are seen through another
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_set_durability(alias, FOSSIL_NOSHELL_DURABILITY_FSYNC, 0) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_get_durability(file_name) == FOSSIL_NOSHELL_DURABILITY_FSYNC);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_index(alias, "status", FOSSIL_NOSHELL_INDEX_HASH) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_index(file_name, "status", FOSSIL_NOSHELL_INDEX_HASH) == FOSSIL_NOSHELL_ERROR_ALREADY_EXISTS);
+
+    // Both outlive the state of files used since
+    for (int i = 0; i < 12; ++i) {
+        char other[64];
+        snprintf(other, sizeof(other), "test_noshell_state_other%d.noshell", i);
+        ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(other) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        fossil_bluecrab_noshell_delete_database(other);
+    }
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_get_durability(alias) == FOSSIL_NOSHELL_DURABILITY_FSYNC);
+
+    // A rewrite through the alias is seen by the index of the other spelling
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_delete_database(alias) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_create_database(alias) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_insert(alias, "{ status: cstr: \"new\" }", NULL, "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE status = 'old'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_find(file_name, "WHERE status = 'new'", result, sizeof(result), NULL) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_drop_index(alias, "status") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_set_durability(file_name, FOSSIL_NOSHELL_DURABILITY_FLUSH, 0) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil_bluecrab_noshell_get_durability(alias) == FOSSIL_NOSHELL_DURABILITY_FLUSH);
+    fossil_bluecrab_noshell_delete_database(file_name);
+}
+
 // * * * * * * * * * * * * * * * * * * * * * * * *
 // * Fossil Logic Test Pool
 // * * * * * * * * * * * * * * * * * * * * * * * *
@@ -277,6 +1423,29 @@ FOSSIL_TEST_GROUP(c_noshell_database_tests) {
     FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_verify_database);
     FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_validate_helpers);
     FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_lock_unlock_is_locked);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_durability_modes);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_async_submit);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_handle);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_id_index);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_cursor);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_structured_query);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_field_index);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_text_index);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_tombstones);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_concurrent_insert_ids);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_auto_compaction);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_insert_many);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_find_cb_parallel);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_scan_long_lines);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_stats);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_binary_fson);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_lsm);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_lsm_updated_id);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_lsm_duplicate_insert);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_lsm_enable_keeps_every_document);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_updated_id);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_handle_survives_compaction);
+    FOSSIL_TEST_ADD(c_noshell_fixture, c_test_noshell_state_shared_by_path);
 
     FOSSIL_TEST_REGISTER(c_noshell_fixture);
 } // end of tests
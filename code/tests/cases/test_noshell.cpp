@@ -260,6 +260,313 @@ FOSSIL_TEST(cpp_test_noshell_lock_unlock_is_locked) {
     NoShell::delete_database(file_name);
 }
 
+FOSSIL_TEST(cpp_test_noshell_durability_modes) {
+    const std::string file_name = "test_noshell_durability.noshell";
+    fossil_bluecrab_noshell_error_t err = fossil::bluecrab::NoShell::create_database(file_name);
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    err = fossil::bluecrab::NoShell::set_durability(file_name, FOSSIL_NOSHELL_DURABILITY_FSYNC);
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(fossil::bluecrab::NoShell::get_durability(file_name) == FOSSIL_NOSHELL_DURABILITY_FSYNC);
+    err = fossil::bluecrab::NoShell::insert(file_name, "{ a: i32: 1 }", "", "object");
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    err = fossil::bluecrab::NoShell::set_durability(file_name, FOSSIL_NOSHELL_DURABILITY_FLUSH);
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil::bluecrab::NoShell::delete_database(file_name);
+}
+
+static void cpp_noshell_async_count(fossil_bluecrab_noshell_error_t err, const char *, void *user) {
+    if (err == FOSSIL_NOSHELL_ERROR_SUCCESS) ++*static_cast<size_t *>(user);
+}
+
+FOSSIL_TEST(cpp_test_noshell_async_submit) {
+    const std::string file_name = "test_noshell_async_cpp.noshell";
+    ASSUME_ITS_TRUE(fossil::bluecrab::NoShell::create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    size_t ok = 0;
+    auto err = fossil::bluecrab::NoShell::submit_insert(file_name, "{ n: i32: 1 }", "", "object", cpp_noshell_async_count, &ok);
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    err = fossil::bluecrab::NoShell::submit_find(file_name, "n: i32: 1", "", cpp_noshell_async_count, &ok);
+    ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil::bluecrab::NoShell::async_wait();
+    ASSUME_ITS_TRUE(ok == 2);
+
+    fossil::bluecrab::NoShell::delete_database(file_name);
+}
+
+FOSSIL_TEST(cpp_test_noshell_handle) {
+    using fossil::bluecrab::NoShell;
+    const std::string file_name = "test_noshell_handle_cpp.noshell";
+    ASSUME_ITS_TRUE(NoShell::create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    {
+        fossil_bluecrab_noshell_error_t err;
+        NoShell::Handle db(file_name, err);
+        ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS && db.is_open());
+
+        std::string id;
+        ASSUME_ITS_TRUE(db.insert_with_id("{ city: cstr: \"oslo\" }", "", "object", id) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        ASSUME_ITS_TRUE(db.insert("{ city: cstr: \"rome\" }", "", "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+        std::string result;
+        ASSUME_ITS_TRUE(db.find("rome", result) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        std::string first, next;
+        ASSUME_ITS_TRUE(db.first_document(first) == FOSSIL_NOSHELL_ERROR_SUCCESS && first == id);
+        ASSUME_ITS_TRUE(db.next_document(first, next) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        size_t count = 0;
+        ASSUME_ITS_TRUE(db.count_documents(count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 2);
+        ASSUME_ITS_TRUE(db.remove("oslo") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        ASSUME_ITS_TRUE(db.count_documents(count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 1);
+    }
+    NoShell::delete_database(file_name);
+}
+
+FOSSIL_TEST(cpp_test_noshell_find_by_id) {
+    using fossil::bluecrab::NoShell;
+    const std::string file_name = "test_noshell_find_by_id_cpp.noshell";
+    ASSUME_ITS_TRUE(NoShell::create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    std::string id;
+    ASSUME_ITS_TRUE(NoShell::insert_with_id(file_name, "{ tag: cstr: \"x\" }", "", "object", id) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    std::string result;
+    ASSUME_ITS_TRUE(NoShell::find_by_id(file_name, id, result) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(result.find("tag: cstr: \"x\"") != std::string::npos);
+    {
+        fossil_bluecrab_noshell_error_t err;
+        NoShell::Handle db(file_name, err);
+        result.clear();
+        ASSUME_ITS_TRUE(db.find_by_id(id, result) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        ASSUME_ITS_TRUE(!result.empty());
+    }
+    NoShell::delete_database(file_name);
+}
+
+FOSSIL_TEST(cpp_test_noshell_cursor) {
+    using fossil::bluecrab::NoShell;
+    const std::string file_name = "test_noshell_cursor_cpp.noshell";
+    ASSUME_ITS_TRUE(NoShell::create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    for (int i = 0; i < 10; ++i) {
+        ASSUME_ITS_TRUE(NoShell::insert(file_name, "{ n: i32: " + std::to_string(i) + " }", "", "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+
+    fossil_bluecrab_noshell_error_t err;
+    NoShell::Cursor cursor(file_name, err, "object");
+    ASSUME_ITS_TRUE(cursor.is_open());
+    std::vector<NoShell::Entry> batch;
+    size_t total = 0;
+    while (cursor.next_batch(batch, 4) == FOSSIL_NOSHELL_ERROR_SUCCESS) {
+        for (const NoShell::Entry& e : batch) {
+            ASSUME_ITS_TRUE(e.type == "object");
+            ASSUME_ITS_TRUE(e.document == "{ n: i32: " + std::to_string(total) + " }");
+            total++;
+        }
+    }
+    ASSUME_ITS_TRUE(total == 10);
+    NoShell::delete_database(file_name);
+}
+
+FOSSIL_TEST(cpp_test_noshell_structured_query) {
+    using fossil::bluecrab::NoShell;
+    const std::string file_name = "test_noshell_structured_query_cpp.noshell";
+    ASSUME_ITS_TRUE(NoShell::create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(NoShell::insert(file_name, "{ sku: cstr: \"a-1\", qty: u32: 4 }", "", "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(NoShell::insert(file_name, "{ sku: cstr: \"b-2\", qty: u32: 40 }", "", "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    std::string result;
+    ASSUME_ITS_TRUE(NoShell::find(file_name, "WHERE qty > 10", result) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(result.find("b-2") != std::string::npos);
+
+    fossil_bluecrab_noshell_error_t err;
+    NoShell::Query query("sku LIKE 'a-%'", err);
+    ASSUME_ITS_TRUE(query.is_valid());
+    ASSUME_ITS_TRUE(query.matches("{ sku: cstr: \"a-9\" }"));
+    ASSUME_ITS_TRUE(!query.matches(result));
+
+    NoShell::Query bad("qty >>", err);
+    ASSUME_ITS_TRUE(!bad.is_valid() && err == FOSSIL_NOSHELL_ERROR_INVALID_QUERY);
+    NoShell::delete_database(file_name);
+}
+
+FOSSIL_TEST(cpp_test_noshell_field_index) {
+    using fossil::bluecrab::NoShell;
+    const std::string file_name = "test_noshell_field_index_cpp.noshell";
+    ASSUME_ITS_TRUE(NoShell::create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    for (int i = 0; i < 50; ++i) {
+        ASSUME_ITS_TRUE(NoShell::insert(file_name, "{ owner: cstr: \"o" + std::to_string(i % 5) + "\", n: i32: " + std::to_string(i) + " }", "", "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+    ASSUME_ITS_TRUE(NoShell::create_index(file_name, "owner", FOSSIL_NOSHELL_INDEX_HASH) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    std::string result;
+    ASSUME_ITS_TRUE(NoShell::find(file_name, "WHERE owner = 'o3' AND n > 20", result) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(result.find("n: i32: 23 }") != std::string::npos);
+    ASSUME_ITS_TRUE(NoShell::drop_index(file_name, "owner") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    NoShell::delete_database(file_name);
+}
+
+FOSSIL_TEST(cpp_test_noshell_text_index) {
+    using fossil::bluecrab::NoShell;
+    const std::string file_name = "test_noshell_text_index_cpp.noshell";
+    ASSUME_ITS_TRUE(NoShell::create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    for (int i = 0; i < 50; ++i) {
+        ASSUME_ITS_TRUE(NoShell::insert(file_name, "{ name: cstr: \"item-" + std::to_string(i) + "-tag\" }", "", "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+    ASSUME_ITS_TRUE(NoShell::create_index(file_name, "name", FOSSIL_NOSHELL_INDEX_TEXT) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    std::string result;
+    ASSUME_ITS_TRUE(NoShell::find(file_name, "WHERE name LIKE '%-42-%'", result) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(result.find("item-42-tag") != std::string::npos);
+    ASSUME_ITS_TRUE(NoShell::find(file_name, "WHERE name LIKE '%-99-%'", result) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(NoShell::drop_index(file_name, "name") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    NoShell::delete_database(file_name);
+}
+
+FOSSIL_TEST(cpp_test_noshell_tombstones) {
+    using fossil::bluecrab::NoShell;
+    const std::string file_name = "test_noshell_tombstones_cpp.noshell";
+    ASSUME_ITS_TRUE(NoShell::create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    std::string id;
+    ASSUME_ITS_TRUE(NoShell::insert_with_id(file_name, "{ k: cstr: \"x\" }", "", "object", id) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(NoShell::insert(file_name, "{ k: cstr: \"y\" }", "", "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(NoShell::update(file_name, "WHERE k = 'x'", "{ k: cstr: \"x2\" }", "", "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(NoShell::remove(file_name, "WHERE k = 'y'") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    std::string result;
+    ASSUME_ITS_TRUE(NoShell::find_by_id(file_name, id, result) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(result.find("x2") != std::string::npos);
+    ASSUME_ITS_TRUE(NoShell::compact(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    size_t count = 0;
+    ASSUME_ITS_TRUE(NoShell::count_documents(file_name, count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 1);
+    ASSUME_ITS_TRUE(NoShell::find(file_name, "WHERE k = 'y'", result) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    NoShell::delete_database(file_name);
+}
+
+FOSSIL_TEST(cpp_test_noshell_insert_many) {
+    using fossil::bluecrab::NoShell;
+    const std::string file_name = "test_noshell_insert_many_cpp.noshell";
+    ASSUME_ITS_TRUE(NoShell::create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    {
+        fossil_bluecrab_noshell_error_t err;
+        NoShell::Handle db(file_name, err);
+        ASSUME_ITS_TRUE(err == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        std::vector<std::string> docs;
+        for (int i = 0; i < 100; ++i) {
+            docs.push_back("{ city: cstr: \"c" + std::to_string(i) + "\" }");
+        }
+        std::vector<std::string> ids;
+        ASSUME_ITS_TRUE(db.insert_many(docs, "", "object", &ids) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        ASSUME_ITS_TRUE(ids.size() == docs.size());
+        std::string first;
+        ASSUME_ITS_TRUE(db.first_document(first) == FOSSIL_NOSHELL_ERROR_SUCCESS && first == ids[0]);
+        size_t count = 0;
+        ASSUME_ITS_TRUE(db.count_documents(count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 100);
+        std::string result;
+        ASSUME_ITS_TRUE(db.find("\"c57\"", result) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        ASSUME_ITS_TRUE(result.find(ids[57]) != std::string::npos);
+    }
+    NoShell::delete_database(file_name);
+}
+
+FOSSIL_TEST(cpp_test_noshell_find_cb_parallel) {
+    using fossil::bluecrab::NoShell;
+    const std::string file_name = "test_noshell_find_cb_parallel_cpp.noshell";
+    ASSUME_ITS_TRUE(NoShell::create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    for (int i = 0; i < 200; ++i) {
+        ASSUME_ITS_TRUE(NoShell::insert(file_name, "{ n: i32: " + std::to_string(i) + " }", "", "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+    std::vector<std::string> seen;
+    auto collect = [](const char* document, void* userdata) -> bool {
+        static_cast<std::vector<std::string>*>(userdata)->emplace_back(document);
+        return false;
+    };
+    ASSUME_ITS_TRUE(NoShell::find_cb_parallel(file_name, "", FOSSIL_NOSHELL_SCAN_ORDERED, 4, collect, &seen) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(seen.size() == 201); // the "{ }" create_database writes, then the inserts
+    ASSUME_ITS_TRUE(seen[1].find("i32: 0 ") != std::string::npos && seen.back().find("i32: 199 ") != std::string::npos);
+    NoShell::delete_database(file_name);
+}
+
+FOSSIL_TEST(cpp_test_noshell_stats) {
+    using fossil::bluecrab::NoShell;
+    const std::string file_name = "test_noshell_stats_cpp.noshell";
+    ASSUME_ITS_TRUE(NoShell::create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    for (int i = 0; i < 10; ++i) {
+        ASSUME_ITS_TRUE(NoShell::insert(file_name, "{ n: i32: " + std::to_string(i) + " }", "", i < 7 ? "object" : "i32") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    }
+    ASSUME_ITS_TRUE(NoShell::remove(file_name, "WHERE n < 2") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil_bluecrab_noshell_stats_t stats;
+    size_t count = 0;
+    ASSUME_ITS_TRUE(NoShell::stats(file_name, stats) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(NoShell::count_documents(file_name, count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 8);
+    ASSUME_ITS_TRUE(stats.documents == 8 && stats.type_counts[NOSHELL_FSON_TYPE_OBJECT] == 5 && stats.type_counts[NOSHELL_FSON_TYPE_I32] == 3);
+    ASSUME_ITS_TRUE(stats.dead_bytes > 0 && stats.live_bytes + stats.dead_bytes == stats.file_size);
+    NoShell::delete_database(file_name);
+}
+
+FOSSIL_TEST(cpp_test_noshell_binary_fson) {
+    using fossil::bluecrab::NoShell;
+    const std::string file_name = "test_noshell_fsonb_cpp.noshell";
+    const std::string copy_name = "test_noshell_fsonb_copy_cpp.noshell";
+    const std::string image = "test_noshell_fsonb_cpp.fsonb";
+    ASSUME_ITS_TRUE(NoShell::create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    std::string id;
+    ASSUME_ITS_TRUE(NoShell::insert_with_id(file_name, "{ user: object: { name: cstr: \"ann\" }, n: i32: 1 }", "", "object", id) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(NoShell::insert(file_name, "{ n: i32: 2 }", "", "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(NoShell::export_binary(file_name, image) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    std::string value;
+    ASSUME_ITS_TRUE(NoShell::binary_get_field(image, id, "user.name", value) == FOSSIL_NOSHELL_ERROR_SUCCESS && value == "ann");
+    std::vector<std::string> seen;
+    auto collect = [](const char* document, void* userdata) -> bool {
+        static_cast<std::vector<std::string>*>(userdata)->emplace_back(document);
+        return false;
+    };
+    ASSUME_ITS_TRUE(NoShell::binary_find_cb(image, "WHERE n > 1", collect, &seen) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    ASSUME_ITS_TRUE(seen.size() == 1 && seen[0].rfind("{ n: i32: 2 } #type=object #id=", 0) == 0);
+
+    ASSUME_ITS_TRUE(NoShell::import_binary(image, copy_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    size_t count = 0;
+    ASSUME_ITS_TRUE(NoShell::count_documents(copy_name, count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 2);
+    NoShell::delete_database(file_name);
+    NoShell::delete_database(copy_name);
+    std::remove(image.c_str());
+}
+
+FOSSIL_TEST(cpp_test_noshell_lsm) {
+    using fossil::bluecrab::NoShell;
+    const std::string file_name = "test_noshell_lsm_cpp.noshell";
+    ASSUME_ITS_TRUE(NoShell::create_database(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    fossil_bluecrab_noshell_lsm_options_t options = {};
+    options.memtable_bytes = 2048;
+    options.level0_segments = 2;
+    ASSUME_ITS_TRUE(NoShell::lsm_enable(file_name, &options) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    std::vector<std::string> ids;
+    for (int i = 0; i < 100; ++i) {
+        std::string id;
+        ASSUME_ITS_TRUE(NoShell::insert_with_id(file_name, "{ n: i32: " + std::to_string(i) + " }", "", "object", id) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+        ids.push_back(id);
+    }
+    ASSUME_ITS_TRUE(NoShell::update(file_name, "WHERE n = 5", "{ n: i32: 500 }", "", "object") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(NoShell::remove(file_name, "WHERE n < 3") == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(NoShell::lsm_flush(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+
+    fossil_bluecrab_noshell_lsm_info_t info;
+    ASSUME_ITS_TRUE(NoShell::lsm_info(file_name, info) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(info.flushes > 1 && info.memtable_entries == 0);
+    std::string document;
+    ASSUME_ITS_TRUE(NoShell::find_by_id(file_name, ids[5], document) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(document.rfind("{ n: i32: 500 } #type=object #id=" + ids[5], 0) == 0);
+    ASSUME_ITS_TRUE(NoShell::find_by_id(file_name, ids[1], document) == FOSSIL_NOSHELL_ERROR_NOT_FOUND);
+    size_t count = 0;
+    ASSUME_ITS_TRUE(NoShell::count_documents(file_name, count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 97);
+
+    ASSUME_ITS_TRUE(NoShell::lsm_close(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(NoShell::lsm_disable(file_name) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    ASSUME_ITS_TRUE(NoShell::lsm_info(file_name, info) == FOSSIL_NOSHELL_ERROR_UNSUPPORTED);
+    ASSUME_ITS_TRUE(NoShell::count_documents(file_name, count) == FOSSIL_NOSHELL_ERROR_SUCCESS && count == 97);
+    ASSUME_ITS_TRUE(NoShell::find_by_id(file_name, ids[99], document) == FOSSIL_NOSHELL_ERROR_SUCCESS);
+    NoShell::delete_database(file_name);
+}
+
 // * * * * * * * * * * * * * * * * * * * * * * * *
 // * Fossil Logic Test Pool
 // * * * * * * * * * * * * * * * * * * * * * * * *
@@ -274,6 +581,20 @@ FOSSIL_TEST_GROUP(cpp_noshell_database_tests) {
     FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_verify_database);
     FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_validate_helpers);
     FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_lock_unlock_is_locked);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_durability_modes);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_async_submit);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_handle);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_find_by_id);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_cursor);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_structured_query);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_field_index);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_text_index);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_tombstones);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_insert_many);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_find_cb_parallel);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_stats);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_binary_fson);
+    FOSSIL_TEST_ADD(cpp_noshell_fixture, cpp_test_noshell_lsm);
 
     FOSSIL_TEST_REGISTER(cpp_noshell_fixture);
 } // end of tests
@@ -0,0 +1,158 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include <fossil/pizza/framework.h>
+
+#include "fossil/crabdb/framework.h"
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Utilities
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// Setup steps for things like test fixtures and
+// mock objects are set here.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+FOSSIL_SUITE(c_query_fixture);
+
+FOSSIL_SETUP(c_query_fixture) {
+    // Setup the test fixture
+}
+
+FOSSIL_TEARDOWN(c_query_fixture) {
+    // Teardown the test fixture
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Blue CrabDB Database
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+// Query module tests
+
+static const fossil_bluecrab_query_syntax_t c_query_syntax = { ".", "=<>(),;" };
+
+static bool c_query_name_field(fossil_bluecrab_query_lexer_t *lx, fossil_bluecrab_query_pred_t *pred) {
+    if (lx->kind != FOSSIL_QUERY_TOK_IDENT)
+        return false;
+    pred->column = (int)lx->len;
+    fossil_bluecrab_query_lex_next(lx);
+    return true;
+}
+
+static fossil_bluecrab_query_pred_t *c_query_parse(const char *text) {
+    fossil_bluecrab_query_lexer_t lx;
+    fossil_bluecrab_query_lex_init(&lx, text, &c_query_syntax);
+    fossil_bluecrab_query_pred_t *pred = fossil_bluecrab_query_parse_where(&lx, c_query_name_field);
+    if (pred && lx.kind != FOSSIL_QUERY_TOK_END) {
+        fossil_bluecrab_query_pred_free(pred);
+        return NULL;
+    }
+    return pred;
+}
+
+FOSSIL_TEST(c_test_query_lexer_syntax) {
+    fossil_bluecrab_query_lexer_t lx;
+    fossil_bluecrab_query_lex_init(&lx, "a.b , 'it''s' -1.5e3 <> ;", &c_query_syntax);
+    ASSUME_ITS_TRUE(lx.kind == FOSSIL_QUERY_TOK_IDENT && lx.len == 3);
+    fossil_bluecrab_query_lex_next(&lx);
+    ASSUME_ITS_TRUE(fossil_bluecrab_query_lex_accept(&lx, ","));
+    ASSUME_ITS_TRUE(lx.kind == FOSSIL_QUERY_TOK_STRING && lx.len == 7);
+    fossil_bluecrab_query_lex_next(&lx);
+    ASSUME_ITS_TRUE(lx.kind == FOSSIL_QUERY_TOK_NUMBER && lx.len == 6);
+    fossil_bluecrab_query_lex_next(&lx);
+    ASSUME_ITS_TRUE(fossil_bluecrab_query_lex_accept(&lx, "<>"));
+    ASSUME_ITS_TRUE(fossil_bluecrab_query_lex_accept(&lx, ";"));
+    ASSUME_ITS_TRUE(lx.kind == FOSSIL_QUERY_TOK_END);
+
+    // Identifier characters and symbols come from the syntax
+    static const fossil_bluecrab_query_syntax_t plain = { "", "=" };
+    fossil_bluecrab_query_lex_init(&lx, "a.b", &plain);
+    ASSUME_ITS_TRUE(lx.kind == FOSSIL_QUERY_TOK_IDENT && lx.len == 1);
+    fossil_bluecrab_query_lex_init(&lx, ",", &plain);
+    ASSUME_ITS_TRUE(lx.kind == FOSSIL_QUERY_TOK_ERROR);
+    fossil_bluecrab_query_lex_init(&lx, "'open", &plain);
+    ASSUME_ITS_TRUE(lx.kind == FOSSIL_QUERY_TOK_ERROR);
+}
+
+FOSSIL_TEST(c_test_query_parse_where) {
+    fossil_bluecrab_query_pred_t *pred = c_query_parse("NOT (ab = 'x''y' or abc > 2) And a like 'q%'");
+    ASSUME_ITS_TRUE(pred != NULL);
+    ASSUME_ITS_TRUE(pred->kind == FOSSIL_QUERY_PRED_AND);
+    ASSUME_ITS_TRUE(pred->left->kind == FOSSIL_QUERY_PRED_NOT);
+    const fossil_bluecrab_query_pred_t *or_node = pred->left->left;
+    ASSUME_ITS_TRUE(or_node->kind == FOSSIL_QUERY_PRED_OR);
+    ASSUME_ITS_TRUE(or_node->left->column == 2 && or_node->left->op == FOSSIL_QUERY_CMP_EQ);
+    ASSUME_ITS_EQUAL_CSTR("x'y", or_node->left->literal);
+    ASSUME_ITS_FALSE(or_node->left->numeric);
+    ASSUME_ITS_TRUE(or_node->right->column == 3 && or_node->right->op == FOSSIL_QUERY_CMP_GT);
+    ASSUME_ITS_TRUE(or_node->right->numeric && or_node->right->integral && or_node->right->ival == 2);
+    ASSUME_ITS_TRUE(pred->right->op == FOSSIL_QUERY_CMP_LIKE && !pred->right->numeric);
+    fossil_bluecrab_query_pred_free(pred);
+
+    ASSUME_ITS_TRUE(c_query_parse("a =") == NULL);
+    ASSUME_ITS_TRUE(c_query_parse("a ~ 1") == NULL);
+    ASSUME_ITS_TRUE(c_query_parse("(a = 1") == NULL);
+    ASSUME_ITS_TRUE(c_query_parse("a = 1 AND") == NULL);
+    ASSUME_ITS_TRUE(c_query_parse("= 1") == NULL);
+}
+
+FOSSIL_TEST(c_test_query_compare) {
+    fossil_bluecrab_query_pred_t *pred = c_query_parse("a >= 10");
+    ASSUME_ITS_TRUE(pred != NULL);
+    // Numbers order numerically; a non-number fails an ordering
+    ASSUME_ITS_TRUE(fossil_bluecrab_query_compare(pred, "10", 2));
+    ASSUME_ITS_TRUE(fossil_bluecrab_query_compare(pred, "9.5e1", 5));
+    ASSUME_ITS_FALSE(fossil_bluecrab_query_compare(pred, "9", 1));
+    ASSUME_ITS_FALSE(fossil_bluecrab_query_compare(pred, "abc", 3));
+    // The value ends at len, not at a terminator
+    ASSUME_ITS_FALSE(fossil_bluecrab_query_compare(pred, "1000", 1));
+    fossil_bluecrab_query_pred_free(pred);
+
+    pred = c_query_parse("a = 1");
+    ASSUME_ITS_TRUE(fossil_bluecrab_query_compare(pred, "1.0", 3));
+    ASSUME_ITS_FALSE(fossil_bluecrab_query_compare(pred, "one", 3));
+    fossil_bluecrab_query_pred_free(pred);
+
+    pred = c_query_parse("a <= 'b'");
+    ASSUME_ITS_TRUE(fossil_bluecrab_query_compare(pred, "a", 1));
+    ASSUME_ITS_TRUE(fossil_bluecrab_query_compare(pred, "bcd", 1));
+    ASSUME_ITS_FALSE(fossil_bluecrab_query_compare(pred, "bcd", 2));
+    fossil_bluecrab_query_pred_free(pred);
+
+    ASSUME_ITS_TRUE(fossil_bluecrab_query_like("crab", 4, "c%b"));
+    ASSUME_ITS_TRUE(fossil_bluecrab_query_like("crab", 4, "_r%"));
+    ASSUME_ITS_TRUE(fossil_bluecrab_query_like("crabs", 4, "%b"));
+    ASSUME_ITS_FALSE(fossil_bluecrab_query_like("crab", 4, "c_b"));
+    ASSUME_ITS_TRUE(fossil_bluecrab_query_like("", 0, "%"));
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Pool
+// * * * * * * * * * * * * * * * * * * * * * * * *
+FOSSIL_TEST_GROUP(c_query_tests) {
+    FOSSIL_TEST_ADD(c_query_fixture, c_test_query_lexer_syntax);
+    FOSSIL_TEST_ADD(c_query_fixture, c_test_query_parse_where);
+    FOSSIL_TEST_ADD(c_query_fixture, c_test_query_compare);
+
+    FOSSIL_TEST_REGISTER(c_query_fixture);
+} // end of tests
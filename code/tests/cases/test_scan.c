@@ -0,0 +1,122 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include <fossil/pizza/framework.h>
+
+#include "fossil/crabdb/framework.h"
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Utilities
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// Setup steps for things like test fixtures and
+// mock objects are set here.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+FOSSIL_SUITE(c_scan_fixture);
+
+FOSSIL_SETUP(c_scan_fixture) {
+    // Setup the test fixture
+}
+
+FOSSIL_TEARDOWN(c_scan_fixture) {
+    // Teardown the test fixture
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Blue CrabDB Database
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+// Scan module tests
+
+FOSSIL_TEST(c_test_scan_byte_matches_memchr) {
+    static char buf[300];
+    for (size_t i = 0; i < sizeof(buf); ++i)
+        buf[i] = (char)('a' + i % 23);
+
+    // Every match position and length, from unaligned starts, crossing vector widths
+    for (size_t len = 0; len <= 200; ++len) {
+        for (size_t off = 0; off < 3; ++off) {
+            for (size_t at = 0; at <= len; at += (len < 40 ? 1 : 13)) {
+                char saved = buf[off + at];
+                if (at < len) buf[off + at] = '\n';
+                const char *expect = (const char *)memchr(buf + off, '\n', len);
+                ASSUME_ITS_TRUE(fossil_bluecrab_scan_newline(buf + off, len) == expect);
+                buf[off + at] = saved;
+            }
+        }
+    }
+    ASSUME_ITS_TRUE(fossil_bluecrab_scan_byte(buf, sizeof(buf), '!') == NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_scan_byte(NULL, 0, 'a') == NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_scan_backend() != NULL);
+}
+
+FOSSIL_TEST(c_test_scan_find_tags) {
+    char line[256];
+    const char *tail = " #type=object #id=0123456789abcdef\n";
+    for (size_t pad = 0; pad < 120; ++pad) {
+        memset(line, '#', pad);  // near misses: '#' without the second byte
+        strcpy(line + pad, tail);
+        size_t len = strlen(line);
+        ASSUME_ITS_TRUE(fossil_bluecrab_scan_find(line, len, "#id=", 4) == strstr(line, "#id="));
+        ASSUME_ITS_TRUE(fossil_bluecrab_scan_find(line, len, "#type=", 6) == strstr(line, "#type="));
+        ASSUME_ITS_TRUE(fossil_bluecrab_scan_find(line, len, "#hash=", 6) == NULL);
+        // The needle may not run past len
+        ASSUME_ITS_TRUE(fossil_bluecrab_scan_find(line, len - 19, "#id=", 4) == NULL);
+    }
+    ASSUME_ITS_TRUE(fossil_bluecrab_scan_find("abc", 3, "", 0) != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_scan_find("abc", 3, "c", 1) != NULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_scan_find("ab", 2, "abc", 3) == NULL);
+}
+
+FOSSIL_TEST(c_test_scan_hex64) {
+    uint64_t v = 1;
+    ASSUME_ITS_TRUE(fossil_bluecrab_scan_hex64("0123456789abcdef", 16, &v) == 16 && v == 0x0123456789abcdefULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_scan_hex64("FEDCBA9876543210 tail", 21, &v) == 16 && v == 0xfedcba9876543210ULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_scan_hex64("ffffffffffffffff", 16, &v) == 16 && v == UINT64_MAX);
+    // Short and interrupted runs parse like strtoull over at most 16 digits
+    ASSUME_ITS_TRUE(fossil_bluecrab_scan_hex64("abc", 3, &v) == 3 && v == 0xabc);
+    ASSUME_ITS_TRUE(fossil_bluecrab_scan_hex64("12345678g0000000", 16, &v) == 8 && v == 0x12345678);
+    ASSUME_ITS_TRUE(fossil_bluecrab_scan_hex64("0123456789abcdef01", 18, &v) == 16 && v == 0x0123456789abcdefULL);
+    ASSUME_ITS_TRUE(fossil_bluecrab_scan_hex64("xyz", 3, &v) == 0 && v == 0);
+    // Bytes next to the digit ranges are rejected
+    const char *edges = "/:@G`g";
+    for (size_t i = 0; edges[i]; ++i) {
+        char text[17];
+        memset(text, 'a', 16);
+        text[16] = '\0';
+        text[5] = edges[i];
+        ASSUME_ITS_TRUE(fossil_bluecrab_scan_hex64(text, 16, &v) == 5 && v == 0xaaaaa);
+    }
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Pool
+// * * * * * * * * * * * * * * * * * * * * * * * *
+FOSSIL_TEST_GROUP(c_scan_tests) {
+    FOSSIL_TEST_ADD(c_scan_fixture, c_test_scan_byte_matches_memchr);
+    FOSSIL_TEST_ADD(c_scan_fixture, c_test_scan_find_tags);
+    FOSSIL_TEST_ADD(c_scan_fixture, c_test_scan_hex64);
+
+    FOSSIL_TEST_REGISTER(c_scan_fixture);
+} // end of tests
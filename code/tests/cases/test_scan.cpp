@@ -0,0 +1,71 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include <fossil/pizza/framework.h>
+
+#include "fossil/crabdb/framework.h"
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Utilities
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// Setup steps for things like test fixtures and
+// mock objects are set here.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+FOSSIL_SUITE(cpp_scan_fixture);
+
+FOSSIL_SETUP(cpp_scan_fixture) {
+    // Setup the test fixture
+}
+
+FOSSIL_TEARDOWN(cpp_scan_fixture) {
+    // Teardown the test fixture
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Blue CrabDB Database
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+using fossil::bluecrab::Scan;
+
+// Scan module tests
+
+FOSSIL_TEST(cpp_test_scan_wrappers) {
+    std::string line = "{ a: i32: 1 } #type=object #id=00000000000000ff\n";
+    ASSUME_ITS_TRUE(Scan::find_byte(line, '\n') == line.size() - 1);
+    ASSUME_ITS_TRUE(Scan::find(line, "#id=") == line.find("#id="));
+    ASSUME_ITS_TRUE(Scan::find(line, "#hash=") == std::string_view::npos);
+    uint64_t id = 0;
+    ASSUME_ITS_TRUE(Scan::hex64(std::string_view(line).substr(line.find("#id=") + 4), id) == 16 && id == 0xff);
+    ASSUME_ITS_TRUE(!Scan::backend().empty());
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Pool
+// * * * * * * * * * * * * * * * * * * * * * * * *
+FOSSIL_TEST_GROUP(cpp_scan_tests) {
+    FOSSIL_TEST_ADD(cpp_scan_fixture, cpp_test_scan_wrappers);
+
+    FOSSIL_TEST_REGISTER(cpp_scan_fixture);
+} // end of tests
@@ -0,0 +1,92 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include <fossil/pizza/framework.h>
+
+#include "fossil/crabdb/framework.h"
+#include "fossil/crabdb/sync.h"
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Utilities
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// Setup steps for things like test fixtures and
+// mock objects are set here.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+FOSSIL_SUITE(c_sync_fixture);
+
+FOSSIL_SETUP(c_sync_fixture) {
+    // Setup the test fixture
+}
+
+FOSSIL_TEARDOWN(c_sync_fixture) {
+    // Teardown the test fixture
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Blue CrabDB Database
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+// Sync module tests
+
+FOSSIL_TEST(c_test_sync_file_and_path) {
+    const char *file_name = "test_sync_file.tmp";
+    FILE *fp = fopen(file_name, "wb");
+    ASSUME_ITS_TRUE(fp != NULL);
+    ASSUME_ITS_TRUE(fputs("line\n", fp) >= 0);
+    ASSUME_ITS_TRUE(fossil_bluecrab_sync_file(fp) == 0);
+    fclose(fp);
+
+    // Path syncs tolerate files and directories that are not there
+    fossil_bluecrab_sync_path(file_name);
+    fossil_bluecrab_sync_path("test_sync_missing.tmp");
+    ASSUME_ITS_TRUE(fossil_bluecrab_sync_parent_dir(file_name) == 0);
+    fossil_bluecrab_sync_parent_dir("no_such_dir/file.tmp");
+    remove(file_name);
+}
+
+FOSSIL_TEST(c_test_sync_worker) {
+    const char *file_name = "test_sync_worker.tmp";
+    FILE *fp = fopen(file_name, "wb");
+    ASSUME_ITS_TRUE(fp != NULL);
+    fclose(fp);
+
+    fossil_bluecrab_sync_worker_t *w = fossil_bluecrab_sync_worker_start(file_name, 5);
+    ASSUME_ITS_TRUE(w != NULL);
+    fossil_bluecrab_sync_worker_mark(w);
+    // Stopping with a write still marked syncs it before returning
+    fossil_bluecrab_sync_worker_stop(w);
+    fossil_bluecrab_sync_worker_stop(NULL);
+    remove(file_name);
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Pool
+// * * * * * * * * * * * * * * * * * * * * * * * *
+FOSSIL_TEST_GROUP(c_sync_tests) {
+    FOSSIL_TEST_ADD(c_sync_fixture, c_test_sync_file_and_path);
+    FOSSIL_TEST_ADD(c_sync_fixture, c_test_sync_worker);
+
+    FOSSIL_TEST_REGISTER(c_sync_fixture);
+} // end of tests
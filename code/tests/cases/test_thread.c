@@ -0,0 +1,120 @@
+/**
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop
+ * high-performance, cross-platform applications and libraries. The code
+ * contained herein is licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License. You may obtain
+ * a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ * Date: 04/05/2014
+ *
+ * Copyright (C) 2014-2025 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include <fossil/pizza/framework.h>
+
+#include "fossil/crabdb/framework.h"
+#include "fossil/crabdb/thread.h"
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Utilities
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// Setup steps for things like test fixtures and
+// mock objects are set here.
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+FOSSIL_SUITE(c_thread_fixture);
+
+FOSSIL_SETUP(c_thread_fixture) {
+    // Setup the test fixture
+}
+
+FOSSIL_TEARDOWN(c_thread_fixture) {
+    // Teardown the test fixture
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Blue CrabDB Database
+// * * * * * * * * * * * * * * * * * * * * * * * *
+
+// Thread module tests
+
+typedef struct {
+    fossil_bluecrab_thread_mutex_t mutex;
+    fossil_bluecrab_thread_cond_t  cond;
+    int  counter;
+    bool go;
+} c_thread_shared_t;
+
+FOSSIL_THREAD_FN(c_thread_counter) {
+    c_thread_shared_t *shared = (c_thread_shared_t *)arg;
+    fossil_bluecrab_thread_mutex_lock(&shared->mutex);
+    while (!shared->go)
+        fossil_bluecrab_thread_cond_wait(&shared->cond, &shared->mutex);
+    fossil_bluecrab_thread_mutex_unlock(&shared->mutex);
+    for (int i = 0; i < 1000; ++i) {
+        fossil_bluecrab_thread_mutex_lock(&shared->mutex);
+        shared->counter++;
+        fossil_bluecrab_thread_mutex_unlock(&shared->mutex);
+    }
+    FOSSIL_THREAD_RETURN;
+}
+
+FOSSIL_TEST(c_test_thread_start_join) {
+    c_thread_shared_t shared = {0};
+    fossil_bluecrab_thread_mutex_init(&shared.mutex);
+    fossil_bluecrab_thread_cond_init(&shared.cond);
+
+    fossil_bluecrab_thread_t threads[4];
+    for (size_t i = 0; i < 4; ++i)
+        ASSUME_ITS_TRUE(fossil_bluecrab_thread_start(&threads[i], c_thread_counter, &shared));
+
+    // Workers wait for the broadcast before counting
+    fossil_bluecrab_thread_mutex_lock(&shared.mutex);
+    ASSUME_ITS_TRUE(shared.counter == 0);
+    shared.go = true;
+    fossil_bluecrab_thread_cond_broadcast(&shared.cond);
+    fossil_bluecrab_thread_mutex_unlock(&shared.mutex);
+
+    for (size_t i = 0; i < 4; ++i)
+        fossil_bluecrab_thread_join(threads[i]);
+    ASSUME_ITS_TRUE(shared.counter == 4000);
+    fossil_bluecrab_thread_cond_destroy(&shared.cond);
+    fossil_bluecrab_thread_mutex_destroy(&shared.mutex);
+}
+
+FOSSIL_TEST(c_test_thread_cond_timedwait) {
+    fossil_bluecrab_thread_mutex_t mutex;
+    fossil_bluecrab_thread_cond_t cond;
+    fossil_bluecrab_thread_mutex_init(&mutex);
+    fossil_bluecrab_thread_cond_init(&cond);
+
+    // Nobody signals: the wait returns on its own
+    fossil_bluecrab_thread_mutex_lock(&mutex);
+    fossil_bluecrab_thread_cond_timedwait(&cond, &mutex, 10);
+    fossil_bluecrab_thread_mutex_unlock(&mutex);
+
+    fossil_bluecrab_thread_cond_destroy(&cond);
+    fossil_bluecrab_thread_mutex_destroy(&mutex);
+}
+
+// * * * * * * * * * * * * * * * * * * * * * * * *
+// * Fossil Logic Test Pool
+// * * * * * * * * * * * * * * * * * * * * * * * *
+FOSSIL_TEST_GROUP(c_thread_tests) {
+    FOSSIL_TEST_ADD(c_thread_fixture, c_test_thread_start_join);
+    FOSSIL_TEST_ADD(c_thread_fixture, c_test_thread_cond_timedwait);
+
+    FOSSIL_TEST_REGISTER(c_thread_fixture);
+} // end of tests